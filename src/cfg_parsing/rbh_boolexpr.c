@@ -1013,6 +1013,7 @@ static int print_condition( const compare_triplet_t * p_triplet, char *out_str,
     case CRITERIA_PATH:
     case CRITERIA_FILENAME:
     case CRITERIA_FILECLASS:
+    case CRITERIA_STATUS:
 #ifdef _LUSTRE
     case CRITERIA_POOL:
 #endif
@@ -32,6 +32,8 @@
 #include "global_config.h"
 #include "rbh_cfg_helpers.h"
 #include "chglog_reader.h"
+#include "chglog_source.h"
+#include "rbh_events.h"
 
 #include <pthread.h>
 #include <errno.h>
@@ -94,8 +96,11 @@ typedef struct reader_thr_info_t
     /** thread was asked to stop */
     unsigned int force_stop : 1;
 
-    /** log handler */
-    void * chglog_hdlr;
+    /** source of changelog records */
+    cl_source_t source;
+
+    /** changelog recorder (if record_file is set) */
+    cl_recorder_t recorder;
 
     /** Queue of pending changelogs to push to the pipeline. */
     struct rh_list_head op_queue;
@@ -145,7 +150,7 @@ static int log_close( reader_thr_info_t * p_info )
     int rc;
 
     /* close the log and clear input buffers */
-    rc = llapi_changelog_fini(&p_info->chglog_hdlr);
+    rc = cl_source_fini(&p_info->source);
 
     if ( rc )
         DisplayLog(LVL_CRIT, CHGLOG_TAG, "Error %d closing changelog: %s",
@@ -201,7 +206,7 @@ static int clear_changelog_records(reader_thr_info_t * p_info)
                cl_reader_config.mdt_def[p_info->thr_index].reader_id,
                p_info->last_committed_record);
 
-    rc = llapi_changelog_clear(p_info->mdtdevice,
+    rc = cl_source_clear(&p_info->source, p_info->mdtdevice,
                     cl_reader_config.mdt_def[p_info->thr_index].reader_id,
                     p_info->last_committed_record);
 
@@ -776,6 +781,13 @@ static int process_log_rec( reader_thr_info_t * p_info, CL_REC_TYPE * p_rec )
     /* display the log record in debug mode */
     dump_record(LVL_DEBUG, mdtname(p_info), p_rec);
 
+    rbh_evt_changelog(mdtname(p_info), p_rec->cr_index, p_rec->cr_type,
+                      p_rec->cr_flags & CLF_FLAGMASK,
+                      cltime2sec(p_rec->cr_time), cltime2nsec(p_rec->cr_time),
+                      (entry_id_t *)&p_rec->cr_tfid,
+                      (entry_id_t *)&p_rec->cr_pfid,
+                      rh_get_cl_cr_name(p_rec), p_rec->cr_namelen);
+
     /* update stats */
     opnum = p_rec->cr_type ;
     if ((opnum >= 0) && (opnum < CL_LAST))
@@ -980,6 +992,25 @@ static inline void cl_update_stats(reader_thr_info_t * info, CL_REC_TYPE * p_rec
 }
 
 
+/** stop recording changelog records after an error */
+static void cl_stop_recording(reader_thr_info_t *info, int err)
+{
+    DisplayLog(LVL_CRIT, CHGLOG_TAG, "ERROR writing changelog journal '%s': %s. "
+               "Changelog recording is stopped.",
+               cl_reader_config.mdt_def[info->thr_index].record_file,
+               strerror(err));
+    cl_recorder_close(&info->recorder);
+}
+
+/** append a record to the changelog journal */
+static inline void cl_record(reader_thr_info_t *info, const CL_REC_TYPE *p_rec)
+{
+    int rc = cl_recorder_write(&info->recorder, p_rec);
+
+    if (rc)
+        cl_stop_recording(info, rc);
+}
+
 /* get a changelog line (with retries) */
 typedef enum {cl_ok, cl_continue, cl_stop} cl_status_e;
 
@@ -988,7 +1019,7 @@ static cl_status_e cl_get_one(reader_thr_info_t * info,  CL_REC_TYPE ** pp_rec)
     int rc;
 
     /* get next record */
-    rc = llapi_changelog_recv(info->chglog_hdlr, pp_rec);
+    rc = cl_source_recv(&info->source, pp_rec);
 
     if (!EMPTY_STRING(log_config.changelogs_file) && rc != 0 && rc != 1)
     {
@@ -1003,6 +1034,9 @@ static cl_status_e cl_get_one(reader_thr_info_t * info,  CL_REC_TYPE ** pp_rec)
          * should never be NULL. */
         cl_update_stats(info, *pp_rec);
 
+        if (info->recorder.stream != NULL)
+            cl_record(info, *pp_rec);
+
         return cl_ok;
 
     case 1:                     /* EOF */
@@ -1019,6 +1053,16 @@ static cl_status_e cl_get_one(reader_thr_info_t * info,  CL_REC_TYPE ** pp_rec)
         if (one_shot)
             return cl_stop;
 
+        /* the source doesn't need to be reopened: wait for new records */
+        if (rc == 1 && cl_source_follow_eof(&info->source))
+        {
+            DisplayLog(LVL_FULL, CHGLOG_TAG,
+                       "EOF reached on changelog from %s, reading again in %ld sec",
+                       info->mdtdevice, cl_reader_config.polling_interval);
+            rh_sleep(cl_reader_config.polling_interval);
+            return cl_continue;
+        }
+
         /* Close, wait and open the log again (from last_read_record + 1) */
         log_close(info);
 
@@ -1040,8 +1084,8 @@ static cl_status_e cl_get_one(reader_thr_info_t * info,  CL_REC_TYPE ** pp_rec)
 
         info->nb_reopen ++;
 
-        rc = llapi_changelog_start( &info->chglog_hdlr, info->flags,
-                                    info->mdtdevice, info->last_read_record + 1 );
+        rc = cl_source_start(&info->source, info->flags,
+                             info->mdtdevice, info->last_read_record + 1);
         if (rc) {
             /* will try to recover from this error */
             rh_sleep(1);
@@ -1090,6 +1134,14 @@ static void * chglog_reader_thr( void *  arg )
 
             if (!EMPTY_STRING(log_config.changelogs_file))
                 FlushLogs();
+
+            if (info->recorder.stream != NULL)
+            {
+                int rc = cl_recorder_flush(&info->recorder);
+
+                if (rc)
+                    cl_stop_recording(info, rc);
+            }
         }
 
         st = cl_get_one(info, &p_rec);
@@ -1105,6 +1157,9 @@ static void * chglog_reader_thr( void *  arg )
     /* Stopping. Flush the internal queue. */
     process_op_queue(info, true);
 
+    if (info->recorder.stream != NULL)
+        cl_recorder_close(&info->recorder);
+
     DisplayLog(LVL_CRIT, CHGLOG_TAG, "Changelog reader thread terminating");
     FlushLogs();
     return NULL;
@@ -1258,9 +1313,13 @@ int cl_reader_start(run_flags_t flags, int mdt_index)
         /* open the changelog (if we are in one_shot mode,
          * don't use the CHANGELOG_FLAG_FOLLOW flag)
          */
-        rc = llapi_changelog_start(&info->chglog_hdlr,
-                                   info->flags,
-                                   info->mdtdevice, last_rec);
+        cl_source_init(&info->source, cl_reader_config.mdt_def[i].source_file);
+        if (info->source.path != NULL)
+            DisplayLog(LVL_MAJOR, CHGLOG_TAG, "Reading records for %s from "
+                       "changelog journal '%s'", mdtdevice, info->source.path);
+
+        rc = cl_source_start(&info->source, info->flags,
+                             info->mdtdevice, last_rec);
 
         if ( rc )
         {
@@ -1270,6 +1329,14 @@ int cl_reader_start(run_flags_t flags, int mdt_index)
                 return abs(rc);
         }
 
+        if (!EMPTY_STRING(cl_reader_config.mdt_def[i].record_file))
+        {
+            rc = cl_recorder_open(&info->recorder,
+                                  cl_reader_config.mdt_def[i].record_file);
+            if (rc)
+                return rc;
+        }
+
         /* then create the thread that manages it */
         if ( pthread_create(&info->thr_id, NULL, chglog_reader_thr, info) )
         {
@@ -42,7 +42,9 @@ chglog_reader_config_t cl_reader_config;
 static mdt_def_t default_mdt_def =
     {
         .mdt_name  = "MDT0000",
-        .reader_id = "cl1"
+        .reader_id = "cl1",
+        .source_file = "",
+        .record_file = ""
     };
 
 
@@ -73,6 +75,8 @@ static void cl_reader_write_default(FILE *output)
     print_begin_block(output, 1, MDT_DEF_BLOCK, NULL);
     print_line(output, 2, "mdt_name    :  \"%s\"", default_mdt_def.mdt_name);
     print_line(output, 2, "reader_id   :  \"%s\"", default_mdt_def.reader_id);
+    print_line(output, 2, "source_file :  \"\" (MDT changelog)");
+    print_line(output, 2, "record_file :  \"\" (disabled)");
     print_end_block(output, 1);
 
     print_line(output, 1, "batch_ack_count  : 1024");
@@ -102,6 +106,12 @@ static void cl_reader_write_template(FILE *output)
     print_line( output, 2, "# id of the persistent changelog reader");
     print_line( output, 2, "# as returned by \"lctl changelog_register\" command");
     print_line( output, 2, "reader_id = \"cl1\" ;" );
+    fprintf( output, "\n" );
+    print_line( output, 2, "# uncomment to append all read records to a changelog journal");
+    print_line( output, 2, "#record_file = \"/var/lib/robinhood/MDT0000.cljournal\" ;" );
+    print_line( output, 2, "# uncomment to replay records from a changelog journal (file or FIFO)");
+    print_line( output, 2, "# instead of reading the MDT changelog");
+    print_line( output, 2, "#source_file = \"/var/lib/robinhood/MDT0000.cljournal\" ;" );
 
     print_end_block( output, 1 );
 
@@ -149,8 +159,18 @@ static int parse_mdt_block( config_item_t config_blk, const char *block_name,
     char *str;
     bool  unique;
 
-    /* 2 variables expected : 'mdt_name' and 'reader_id' */
-    static const char *expected_vars[] = { "mdt_name","reader_id", NULL };
+    /* expected variables: 'mdt_name', 'reader_id' and optional journal files */
+    static const char *expected_vars[] = { "mdt_name", "reader_id",
+                                           "source_file", "record_file", NULL };
+
+    const cfg_param_t cfg_params[] = {
+        {"source_file", PT_STRING, PFLG_ABSOLUTE_PATH | PFLG_NO_WILDCARDS,
+            p_mdt_def->source_file, sizeof(p_mdt_def->source_file)},
+        {"record_file", PT_STRING, PFLG_ABSOLUTE_PATH | PFLG_NO_WILDCARDS,
+            p_mdt_def->record_file, sizeof(p_mdt_def->record_file)},
+        END_OF_PARAMS
+    };
+    int rc;
 
     /* get 'mdt_name' value */
     unique = true;
@@ -205,6 +225,20 @@ static int parse_mdt_block( config_item_t config_blk, const char *block_name,
         strcpy(p_mdt_def->reader_id, str);
     }
 
+    /* get optional changelog journal files */
+    p_mdt_def->source_file[0] = '\0';
+    p_mdt_def->record_file[0] = '\0';
+    rc = read_scalar_params(config_blk, block_name, cfg_params, msg_out);
+    if (rc)
+        return rc;
+
+    if (!EMPTY_STRING(p_mdt_def->source_file)
+        && !strcmp(p_mdt_def->source_file, p_mdt_def->record_file))
+    {
+        sprintf(msg_out, "%s: source_file and record_file must be different", block_name);
+        return EINVAL;
+    }
+
     /* display warnings for unknown parameters */
     CheckUnknownParameters(config_blk, block_name, expected_vars);
 
@@ -352,6 +386,10 @@ static int cl_reader_reload_cfg(chglog_reader_config_t *cfg)
                 NO_PARAM_UPDT_MSG(CHGLOG_CFG_BLOCK"::"MDT_DEF_BLOCK, "mdt_name");
             if (strcmp(cfg->mdt_def[i].reader_id, cl_reader_config.mdt_def[i].reader_id))
                 NO_PARAM_UPDT_MSG(CHGLOG_CFG_BLOCK"::"MDT_DEF_BLOCK, "reader_id");
+            if (strcmp(cfg->mdt_def[i].source_file, cl_reader_config.mdt_def[i].source_file))
+                NO_PARAM_UPDT_MSG(CHGLOG_CFG_BLOCK"::"MDT_DEF_BLOCK, "source_file");
+            if (strcmp(cfg->mdt_def[i].record_file, cl_reader_config.mdt_def[i].record_file))
+                NO_PARAM_UPDT_MSG(CHGLOG_CFG_BLOCK"::"MDT_DEF_BLOCK, "record_file");
         }
     }
 
@@ -0,0 +1,382 @@
+/* -*- mode: c; c-basic-offset: 4; indent-tabs-mode: nil; -*-
+ * vim:expandtab:shiftwidth=4:tabstop=4:
+ */
+/*
+ * Copyright (C) 2016 CEA/DAM
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the CeCILL License.
+ *
+ * The fact that you are presently reading this means that you have had
+ * knowledge of the CeCILL license (http://www.cecill.info) and that you
+ * accept its terms.
+ */
+
+/**
+ * \file    chglog_source.c
+ * \brief   Sources of changelog records and changelog recorder.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include "chglog_source.h"
+#include "rbh_logs.h"
+#include "rbh_misc.h"
+#include "Memory.h"
+
+#include <errno.h>
+#include <string.h>
+#include <stdlib.h>
+#include <sys/stat.h>
+
+#define CLSRC_TAG  "ChangeLog"
+
+/** I/O buffer size for journal streams */
+#define CL_JOURNAL_BUFSZ    (1024 * 1024)
+
+/* identify the record format, as it depends on the Lustre version */
+#if defined(HAVE_FLEX_CL)
+#define CL_JOURNAL_REC_FORMAT   3
+#elif defined(HAVE_CHANGELOG_EXTEND_REC)
+#define CL_JOURNAL_REC_FORMAT   2
+#else
+#define CL_JOURNAL_REC_FORMAT   1
+#endif
+
+/** size of a record, including name and extensions */
+static inline size_t cl_rec_size(const CL_REC_TYPE *rec)
+{
+    return (rh_get_cl_cr_name(rec) - (const char *)rec) + rec->cr_namelen;
+}
+
+/* -------- Lustre MDT changelog -------- */
+
+static int llapi_src_start(cl_source_t *src, int flags, const char *mdtdevice,
+                           long long startrec)
+{
+    return llapi_changelog_start(&src->priv, flags, mdtdevice, startrec);
+}
+
+static int llapi_src_recv(cl_source_t *src, CL_REC_TYPE **rec)
+{
+    return llapi_changelog_recv(src->priv, rec);
+}
+
+static int llapi_src_clear(cl_source_t *src, const char *mdtdevice,
+                           const char *reader_id, long long endrec)
+{
+    return llapi_changelog_clear(mdtdevice, reader_id, endrec);
+}
+
+static int llapi_src_fini(cl_source_t *src)
+{
+    return llapi_changelog_fini(&src->priv);
+}
+
+static const cl_source_ops_t llapi_src_ops = {
+    .name  = "llapi",
+    .follow_eof = false,
+    .start = llapi_src_start,
+    .recv  = llapi_src_recv,
+    .clear = llapi_src_clear,
+    .fini  = llapi_src_fini,
+};
+
+/* -------- changelog journal file -------- */
+
+/** Read a record from a journal stream.
+ * At EOF, the stream is left ready for reading records that are appended
+ * later. If the journal is a regular file, a record that is only partly
+ * written is also reported as EOF, and read again from its beginning
+ * by the next call.
+ * @return 0 on success, 1 on EOF, negative error code on error.
+ */
+static int journal_read_rec(FILE *stream, CL_REC_TYPE **rec)
+{
+    uint32_t size;
+    CL_REC_TYPE *r;
+    off_t pos;
+
+    /* -1 for FIFOs */
+    pos = ftello(stream);
+
+    if (fread(&size, sizeof(size), 1, stream) != 1)
+        goto eof;
+
+    if (size < sizeof(CL_REC_TYPE) || size > CL_JOURNAL_REC_MAX)
+    {
+        DisplayLog(LVL_CRIT, CLSRC_TAG, "Invalid record size %u in changelog journal",
+                   size);
+        return -EPROTO;
+    }
+
+    /* allocated by malloc, as llapi_changelog_free() will release it */
+    r = malloc(size);
+    if (r == NULL)
+        return -ENOMEM;
+
+    if (fread(r, size, 1, stream) != 1)
+    {
+        free(r);
+        if (ferror(stream) || pos != -1)
+            goto eof;
+
+        DisplayLog(LVL_MAJOR, CLSRC_TAG, "Truncated record in changelog journal");
+        clearerr(stream);
+        return -EPROTO;
+    }
+
+    if (cl_rec_size(r) > size)
+    {
+        DisplayLog(LVL_CRIT, CLSRC_TAG, "Inconsistent record #%llu in changelog journal "
+                   "(namelen=%u, size=%u)", r->cr_index, r->cr_namelen, size);
+        free(r);
+        return -EPROTO;
+    }
+
+    *rec = r;
+    return 0;
+
+eof:
+    if (ferror(stream))
+        return -EIO;
+
+    /* go back to the beginning of the incomplete record */
+    if (pos != -1 && fseeko(stream, pos, SEEK_SET) != 0)
+        return -errno;
+
+    /* EOF is sticky: clear it to read new records */
+    clearerr(stream);
+    return 1;
+}
+
+/** private data of the journal file source */
+struct file_src {
+    FILE        *stream;
+    /** first record to be returned, read while skipping old records */
+    CL_REC_TYPE *pending;
+};
+
+static int file_src_start(cl_source_t *src, int flags, const char *mdtdevice,
+                          long long startrec)
+{
+    struct cl_journal_header hdr;
+    struct file_src *fsrc;
+    int rc;
+
+    fsrc = MemCalloc(1, sizeof(*fsrc));
+    if (fsrc == NULL)
+        return -ENOMEM;
+
+    /* opening a FIFO blocks until a writer opens it */
+    fsrc->stream = fopen(src->path, "r");
+    if (fsrc->stream == NULL)
+    {
+        rc = -errno;
+        DisplayLog(LVL_CRIT, CLSRC_TAG, "Failed to open changelog journal '%s': %s",
+                   src->path, strerror(-rc));
+        goto free_src;
+    }
+    setvbuf(fsrc->stream, NULL, _IOFBF, CL_JOURNAL_BUFSZ);
+
+    if (fread(&hdr, sizeof(hdr), 1, fsrc->stream) != 1
+        || memcmp(hdr.magic, CL_JOURNAL_MAGIC, CL_JOURNAL_MAGIC_LEN))
+    {
+        DisplayLog(LVL_CRIT, CLSRC_TAG, "'%s' is not a changelog journal", src->path);
+        rc = -EINVAL;
+        goto close;
+    }
+    if (hdr.rec_format != CL_JOURNAL_REC_FORMAT
+        || hdr.rec_base_size != sizeof(CL_REC_TYPE))
+    {
+        DisplayLog(LVL_CRIT, CLSRC_TAG, "Changelog journal '%s' was recorded with an "
+                   "incompatible Lustre version (record format %u, expected %u)",
+                   src->path, hdr.rec_format, CL_JOURNAL_REC_FORMAT);
+        rc = -EINVAL;
+        goto close;
+    }
+
+    /* skip records before startrec */
+    if (startrec > 0)
+    {
+        CL_REC_TYPE *rec;
+        unsigned long long skipped = 0;
+
+        for (;;)
+        {
+            rc = journal_read_rec(fsrc->stream, &rec);
+            if (rc < 0)
+                goto close;
+            else if (rc == 1)
+                break;
+
+            if (rec->cr_index >= startrec)
+            {
+                fsrc->pending = rec;
+                break;
+            }
+            free(rec);
+            skipped++;
+        }
+        if (skipped > 0)
+            DisplayLog(LVL_EVENT, CLSRC_TAG, "%s: skipped %llu records from changelog "
+                       "journal (start_rec=%llu)", mdtdevice, skipped, startrec);
+    }
+
+    src->priv = fsrc;
+    return 0;
+
+close:
+    fclose(fsrc->stream);
+free_src:
+    MemFree(fsrc);
+    return rc;
+}
+
+static int file_src_recv(cl_source_t *src, CL_REC_TYPE **rec)
+{
+    struct file_src *fsrc = src->priv;
+
+    /* source was closed, and reopening it failed */
+    if (fsrc == NULL)
+        return -EINVAL;
+
+    if (fsrc->pending != NULL)
+    {
+        *rec = fsrc->pending;
+        fsrc->pending = NULL;
+        return 0;
+    }
+    return journal_read_rec(fsrc->stream, rec);
+}
+
+static int file_src_clear(cl_source_t *src, const char *mdtdevice,
+                          const char *reader_id, long long endrec)
+{
+    /* nothing to acknowledge */
+    return 0;
+}
+
+static int file_src_fini(cl_source_t *src)
+{
+    struct file_src *fsrc = src->priv;
+    int rc = 0;
+
+    if (fsrc == NULL)
+        return 0;
+
+    free(fsrc->pending);
+    if (fclose(fsrc->stream) != 0)
+        rc = -errno;
+    MemFree(fsrc);
+    src->priv = NULL;
+    return rc;
+}
+
+static const cl_source_ops_t file_src_ops = {
+    .name  = "file",
+    .follow_eof = true,
+    .start = file_src_start,
+    .recv  = file_src_recv,
+    .clear = file_src_clear,
+    .fini  = file_src_fini,
+};
+
+void cl_source_init(cl_source_t *src, const char *path)
+{
+    src->priv = NULL;
+    if (path == NULL || EMPTY_STRING(path))
+    {
+        src->ops = &llapi_src_ops;
+        src->path = NULL;
+    }
+    else
+    {
+        src->ops = &file_src_ops;
+        src->path = path;
+    }
+}
+
+/* -------- changelog recorder -------- */
+
+int cl_recorder_open(cl_recorder_t *rec, const char *path)
+{
+    struct stat st;
+    int rc;
+
+    rec->stream = fopen(path, "a");
+    if (rec->stream == NULL)
+    {
+        rc = errno;
+        DisplayLog(LVL_CRIT, CLSRC_TAG, "Failed to open changelog journal '%s' "
+                   "for recording: %s", path, strerror(rc));
+        return rc;
+    }
+    setvbuf(rec->stream, NULL, _IOFBF, CL_JOURNAL_BUFSZ);
+
+    if (fstat(fileno(rec->stream), &st) != 0)
+    {
+        rc = errno;
+        goto err;
+    }
+
+    /* write the header to new journals, and to FIFOs */
+    if (!S_ISREG(st.st_mode) || st.st_size == 0)
+    {
+        struct cl_journal_header hdr;
+
+        memset(&hdr, 0, sizeof(hdr));
+        memcpy(hdr.magic, CL_JOURNAL_MAGIC, CL_JOURNAL_MAGIC_LEN);
+        hdr.rec_format = CL_JOURNAL_REC_FORMAT;
+        hdr.rec_base_size = sizeof(CL_REC_TYPE);
+
+        if (fwrite(&hdr, sizeof(hdr), 1, rec->stream) != 1)
+        {
+            rc = errno ? errno : EIO;
+            goto err;
+        }
+    }
+
+    DisplayLog(LVL_EVENT, CLSRC_TAG, "Recording changelog records to '%s'", path);
+    return 0;
+
+err:
+    DisplayLog(LVL_CRIT, CLSRC_TAG, "Failed to initialize changelog journal '%s': %s",
+               path, strerror(rc));
+    fclose(rec->stream);
+    rec->stream = NULL;
+    return rc;
+}
+
+int cl_recorder_write(cl_recorder_t *rec, const CL_REC_TYPE *logrec)
+{
+    uint32_t size = cl_rec_size(logrec);
+
+    if (fwrite(&size, sizeof(size), 1, rec->stream) != 1
+        || fwrite(logrec, size, 1, rec->stream) != 1)
+        return errno ? errno : EIO;
+
+    return 0;
+}
+
+int cl_recorder_flush(cl_recorder_t *rec)
+{
+    if (fflush(rec->stream) != 0)
+        return errno;
+    return 0;
+}
+
+int cl_recorder_close(cl_recorder_t *rec)
+{
+    int rc = 0;
+
+    if (rec->stream == NULL)
+        return 0;
+
+    if (fclose(rec->stream) != 0)
+        rc = errno;
+    rec->stream = NULL;
+    return rc;
+}
@@ -0,0 +1,128 @@
+/* -*- mode: c; c-basic-offset: 4; indent-tabs-mode: nil; -*-
+ * vim:expandtab:shiftwidth=4:tabstop=4:
+ */
+/*
+ * Copyright (C) 2016 CEA/DAM
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the CeCILL License.
+ *
+ * The fact that you are presently reading this means that you have had
+ * knowledge of the CeCILL license (http://www.cecill.info) and that you
+ * accept its terms.
+ */
+
+/**
+ * \file    chglog_source.h
+ * \brief   Sources of changelog records: Lustre MDT changelog (llapi),
+ *          or a changelog journal file (for replay and load tests).
+ *
+ * Journal file format (host byte order):
+ * - a header (struct cl_journal_header).
+ * - a sequence of records, each made of a uint32_t record size followed
+ *   by the raw CL_REC_TYPE record (including its name and extensions).
+ *
+ * Records returned by all sources are allocated by malloc(), so they can
+ * be released by llapi_changelog_free() whatever their source.
+ */
+#ifndef _CHGLOG_SOURCE_H
+#define _CHGLOG_SOURCE_H
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include "lustre_extended_types.h"
+
+#define CL_JOURNAL_MAGIC     "RBHCLJ01"
+#define CL_JOURNAL_MAGIC_LEN 8
+
+/** maximum size of a journal record */
+#define CL_JOURNAL_REC_MAX   (64 * 1024)
+
+struct cl_journal_header {
+    char     magic[CL_JOURNAL_MAGIC_LEN];
+    /** format of records, depending on the Lustre version */
+    uint32_t rec_format;
+    /** sizeof(CL_REC_TYPE) of the recording host */
+    uint32_t rec_base_size;
+};
+
+typedef struct cl_source cl_source_t;
+
+/** operations of a changelog source (same semantics as llapi calls) */
+typedef struct cl_source_ops {
+    const char *name;
+    /** the source remains open at EOF, and returns the records
+     *  that are appended later: there is no need to reopen it */
+    bool follow_eof;
+
+    /** open the source, starting at record 'startrec' */
+    int (*start)(cl_source_t *src, int flags, const char *mdtdevice,
+                 long long startrec);
+    /** get next record: 0 on success, 1 on EOF, negative errno on error */
+    int (*recv)(cl_source_t *src, CL_REC_TYPE **rec);
+    /** acknowledge records up to 'endrec' */
+    int (*clear)(cl_source_t *src, const char *mdtdevice,
+                 const char *reader_id, long long endrec);
+    /** close the source */
+    int (*fini)(cl_source_t *src);
+} cl_source_ops_t;
+
+struct cl_source {
+    const cl_source_ops_t *ops;
+    /** llapi changelog handle, or journal source data */
+    void *priv;
+    /** journal file to read records from (file source) */
+    const char *path;
+};
+
+/**
+ * Initialize a changelog source.
+ * @param path journal file to read records from,
+ *             or NULL/empty for the Lustre MDT changelog.
+ */
+void cl_source_init(cl_source_t *src, const char *path);
+
+static inline int cl_source_start(cl_source_t *src, int flags,
+                                  const char *mdtdevice, long long startrec)
+{
+    return src->ops->start(src, flags, mdtdevice, startrec);
+}
+
+static inline int cl_source_recv(cl_source_t *src, CL_REC_TYPE **rec)
+{
+    return src->ops->recv(src, rec);
+}
+
+static inline int cl_source_clear(cl_source_t *src, const char *mdtdevice,
+                                  const char *reader_id, long long endrec)
+{
+    return src->ops->clear(src, mdtdevice, reader_id, endrec);
+}
+
+static inline int cl_source_fini(cl_source_t *src)
+{
+    return src->ops->fini(src);
+}
+
+/** check if the source can be read again after EOF without reopening it */
+static inline bool cl_source_follow_eof(const cl_source_t *src)
+{
+    return src->ops->follow_eof && src->priv != NULL;
+}
+
+/** Changelog recorder: appends records to a journal file. */
+typedef struct cl_recorder {
+    FILE *stream;
+} cl_recorder_t;
+
+/** open a journal for writing (records are appended to existing ones) */
+int cl_recorder_open(cl_recorder_t *rec, const char *path);
+/** append a record to the journal */
+int cl_recorder_write(cl_recorder_t *rec, const CL_REC_TYPE *logrec);
+/** flush buffered records to the journal */
+int cl_recorder_flush(cl_recorder_t *rec);
+/** flush and close the journal */
+int cl_recorder_close(cl_recorder_t *rec);
+
+#endif
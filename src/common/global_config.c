@@ -19,6 +19,7 @@
 #include "rbh_cfg_helpers.h"
 #include "rbh_misc.h"
 #include "rbh_logs.h"
+#include "uidgidcache.h"
 #include <errno.h>
 
 #define GLOBAL_CONFIG_BLOCK "General"
@@ -53,6 +54,8 @@ static void global_cfg_set_default(void *module_config)
     conf->check_mounted = true;
     conf->last_access_only_atime = false;
     conf->uid_gid_as_numbers = false;
+    conf->uid_gid_cache_ttl = UG_DEFAULT_TTL;
+    conf->uid_gid_cache_negative_ttl = UG_DEFAULT_NEG_TTL;
     conf->fs_key = FSKEY_FSNAME;
 
 #if defined( _LUSTRE ) && defined( _MDS_STAT_SUPPORT )
@@ -74,6 +77,8 @@ static void global_cfg_write_default(FILE *output)
     print_line(output, 1, "check_mounted :  yes");
     print_line(output, 1, "last_access_only_atime :  no" );
     print_line(output, 1, "uid_gid_as_numbers     :  no" );
+    print_line(output, 1, "uid_gid_cache_ttl      :  1h" );
+    print_line(output, 1, "uid_gid_cache_negative_ttl :  5min" );
 
 #if defined(_LUSTRE) && defined(_MDS_STAT_SUPPORT)
     print_line(output, 1, "direct_mds_stat :   no");
@@ -91,7 +96,8 @@ static int global_cfg_read(config_file_t config, void *module_config,
     static const char *allowed_params[] = {
         "fs_path", "fs_type", "stay_in_fs", "check_mounted",
         "direct_mds_stat", "fs_key", "last_access_only_atime",
-        "uid_gid_as_numbers", NULL
+        "uid_gid_as_numbers", "uid_gid_cache_ttl",
+        "uid_gid_cache_negative_ttl", NULL
     };
     const cfg_param_t cfg_params[] = {
         {"fs_path", PT_STRING, PFLG_MANDATORY | PFLG_ABSOLUTE_PATH |
@@ -106,6 +112,10 @@ static int global_cfg_read(config_file_t config, void *module_config,
         {"check_mounted", PT_BOOL, 0, &conf->check_mounted, 0},
         {"last_access_only_atime", PT_BOOL, 0, &conf->last_access_only_atime, 0},
         {"uid_gid_as_numbers", PT_BOOL, 0, &conf->uid_gid_as_numbers, 0},
+        {"uid_gid_cache_ttl", PT_DURATION, PFLG_POSITIVE,
+            &conf->uid_gid_cache_ttl, 0},
+        {"uid_gid_cache_negative_ttl", PT_DURATION, PFLG_POSITIVE,
+            &conf->uid_gid_cache_negative_ttl, 0},
 #if defined( _LUSTRE ) && defined( _MDS_STAT_SUPPORT )
         {"direct_mds_stat", PT_BOOL, 0, &conf->direct_mds_stat, 0},
 #endif
@@ -162,6 +172,8 @@ static int global_cfg_set(void *module_config, bool reload)
     {
         /* copy the whole structure content */
         global_config = *conf;
+        UidGidCache_SetTTL(conf->uid_gid_cache_ttl,
+                           conf->uid_gid_cache_negative_ttl);
         return 0;
     }
 
@@ -205,6 +217,24 @@ static int global_cfg_set(void *module_config, bool reload)
     if (global_config.uid_gid_as_numbers)
         DisplayLog(LVL_VERB, "GlobalConfig", "UID and GID stored as numbers");
 
+    if (global_config.uid_gid_cache_ttl != conf->uid_gid_cache_ttl
+        || global_config.uid_gid_cache_negative_ttl
+            != conf->uid_gid_cache_negative_ttl)
+    {
+        DisplayLog(LVL_EVENT, "GlobalConfig", GLOBAL_CONFIG_BLOCK
+                   "::uid_gid_cache_ttl/uid_gid_cache_negative_ttl updated: "
+                   "%lu/%lu->%lu/%lu",
+                   (unsigned long)global_config.uid_gid_cache_ttl,
+                   (unsigned long)global_config.uid_gid_cache_negative_ttl,
+                   (unsigned long)conf->uid_gid_cache_ttl,
+                   (unsigned long)conf->uid_gid_cache_negative_ttl);
+        global_config.uid_gid_cache_ttl = conf->uid_gid_cache_ttl;
+        global_config.uid_gid_cache_negative_ttl =
+            conf->uid_gid_cache_negative_ttl;
+        UidGidCache_SetTTL(conf->uid_gid_cache_ttl,
+                           conf->uid_gid_cache_negative_ttl);
+    }
+
 #if defined(_LUSTRE) && defined(_MDS_STAT_SUPPORT)
     if (conf->direct_mds_stat != global_config.direct_mds_stat)
     {
@@ -248,6 +278,12 @@ static void global_cfg_write_template(FILE *output)
     print_line(output, 1, "# There are no guarantees that all filesystems will correctly store atime");
     print_line(output, 1, "last_access_only_atime = no ;");
     print_line(output, 1, "uid_gid_as_numbers = no ;");
+    fprintf(output, "\n");
+    print_line(output, 1, "# user and group names are cached, and refreshed in background");
+    print_line(output, 1, "# when they get older than uid_gid_cache_ttl (0 = never).");
+    print_line(output, 1, "# unknown uids/gids are cached for uid_gid_cache_negative_ttl.");
+    print_line(output, 1, "uid_gid_cache_ttl = 1h ;");
+    print_line(output, 1, "uid_gid_cache_negative_ttl = 5min ;");
 
 #if defined(_LUSTRE) && defined(_MDS_STAT_SUPPORT)
     fprintf(output, "\n");
@@ -14,7 +14,12 @@
 
 /**
  * Module for handling queue of items with feedback management.
- * The algorithm is based on a cyclic queue.
+ * The algorithm is based on a lock-free bounded cyclic queue: each slot
+ * holds a sequence number telling producers and consumers if it can be
+ * written or read. Semaphores count free and filled slots, so threads
+ * only block when the queue is full or empty.
+ * Status and feedback counters are striped by thread to avoid contention
+ * between workers, and they are summed when they are read.
  */
 #ifdef HAVE_CONFIG_H
 #include "config.h"
@@ -26,17 +31,38 @@
 #include "rbh_misc.h"
 
 #include <pthread.h>
+#include <sched.h>
+#include <errno.h>
 
 #define QUEUE_TAG "Queue"
 
-/* cyclic queue utilities */
-#define is_empty(pq) ( (pq)->first_index == (pq)->last_index )
-#define is_full(pq)  ( (pq)->first_index == ( (pq)->last_index + 1 ) % (pq)->array_size )
-#define nb_items(pq) ( ( (pq)->last_index - (pq)->first_index ) % (pq)->array_size )
+/* counters stripes are aligned on cache lines */
+#define CACHE_LINE  64
 
-#define lockq( pq ) pthread_mutex_lock( &((pq)->queue_lock ) )
-#define unlockq( pq ) pthread_mutex_unlock( &((pq)->queue_lock ) )
+#define atomic_load(_p)         __atomic_load_n((_p), __ATOMIC_ACQUIRE)
+#define atomic_store(_p, _v)    __atomic_store_n((_p), (_v), __ATOMIC_RELEASE)
+#define atomic_add(_p, _v)      __atomic_add_fetch((_p), (_v), __ATOMIC_RELAXED)
+#define atomic_cas(_p, _old, _new) __atomic_compare_exchange_n((_p), (_old), (_new), \
+                                        false, __ATOMIC_ACQ_REL, __ATOMIC_RELAXED)
 
+/** stripe of counters used by the current thread */
+static __thread int thr_slot = -1;
+static unsigned int next_slot = 0;
+
+static inline unsigned int stat_slot(void)
+{
+    if (thr_slot == -1)
+        thr_slot = atomic_add(&next_slot, 1) % QUEUE_STAT_SLOTS;
+    return thr_slot;
+}
+
+/** round up 'count' items of size 'size' to a multiple of cache line */
+static inline unsigned int stride(unsigned int count, size_t size)
+{
+    unsigned int per_line = CACHE_LINE / size;
+
+    return ((count + per_line - 1) / per_line) * per_line;
+}
 
 /**
  * Initialize a queue.
@@ -45,6 +71,7 @@ int CreateQueue( entry_queue_t * p_queue, unsigned int queue_size,
                  unsigned int max_status, unsigned int feedback_count )
 {
     int            rc;
+    unsigned int   i;
 
     if ( !p_queue )
         return EFAULT;
@@ -52,30 +79,37 @@ int CreateQueue( entry_queue_t * p_queue, unsigned int queue_size,
     /* number of slots that can be used */
     p_queue->queue_size = queue_size;
 
-    /* array must be 1 slot larger than queue_size because 1 slot is lost in cyclic queue management */
-    p_queue->array_size = queue_size + 1;
+    /* array size is a power of 2 >= queue_size
+     * (the number of items is limited to queue_size by sem_empty) */
+    for ( p_queue->array_size = 1; p_queue->array_size < queue_size;
+          p_queue->array_size <<= 1 )
+        ;
 
     p_queue->first_index = 0;
     p_queue->last_index = 0;
 
     /* allocates array of entries and stats */
-    p_queue->queue = MemCalloc( p_queue->array_size, sizeof( void * ) );
+    p_queue->queue = MemCalloc( p_queue->array_size, sizeof( queue_cell_t ) );
     if ( p_queue->queue == NULL )
         return ENOMEM;
 
+    for ( i = 0; i < p_queue->array_size; i++ )
+        p_queue->queue[i].seq = i;
+
     p_queue->status_count = max_status + 1;
-    p_queue->status_array = MemCalloc( max_status + 1, sizeof( unsigned int ) );
+    p_queue->status_stride = stride( p_queue->status_count, sizeof( unsigned int ) );
+    p_queue->status_array = MemCalloc( QUEUE_STAT_SLOTS * p_queue->status_stride,
+                                       sizeof( unsigned int ) );
     if ( p_queue->status_array == NULL )
         return ENOMEM;
 
     p_queue->feedback_count = feedback_count;
-    p_queue->feedback_array = MemCalloc( feedback_count, sizeof( unsigned long long ) );
-    if ( p_queue->feedback_array == NULL )
+    p_queue->feedback_stride = stride( feedback_count, sizeof( unsigned long long ) );
+    p_queue->feedback_array = MemCalloc( QUEUE_STAT_SLOTS * p_queue->feedback_stride,
+                                         sizeof( unsigned long long ) );
+    if ( p_queue->feedback_array == NULL && feedback_count > 0 )
         return ENOMEM;
 
-    /* init locks */
-    pthread_mutex_init( &p_queue->queue_lock, NULL );
-
     rc = sem_init( &p_queue->sem_empty, 0, queue_size );
     if ( rc )
         return rc;
@@ -93,19 +127,33 @@ int CreateQueue( entry_queue_t * p_queue, unsigned int queue_size,
     return 0;
 }
 
+/**
+ * Release the resources of a queue.
+ * The queue must be empty and no thread must be using it.
+ */
+void DestroyQueue( entry_queue_t * p_queue )
+{
+    sem_destroy( &p_queue->sem_empty );
+    sem_destroy( &p_queue->sem_full );
+
+    MemFree( p_queue->queue );
+    p_queue->queue = NULL;
+    MemFree( p_queue->status_array );
+    p_queue->status_array = NULL;
+    MemFree( p_queue->feedback_array );
+    p_queue->feedback_array = NULL;
+}
+
 /**
  * Reset status info
  */
 void Reset_StatusCount( entry_queue_t * p_queue )
 {
-    unsigned int   i;
-
-    lockq( p_queue );
-
-    for ( i = 0; i < p_queue->status_count; i++ )
-        p_queue->status_array[i] = 0;
+    unsigned int   i, s;
 
-    unlockq( p_queue );
+    for ( s = 0; s < QUEUE_STAT_SLOTS; s++ )
+        for ( i = 0; i < p_queue->status_count; i++ )
+            atomic_store( &p_queue->status_array[s * p_queue->status_stride + i], 0 );
 }
 
 /**
@@ -113,6 +161,8 @@ void Reset_StatusCount( entry_queue_t * p_queue )
  */
 void Reset_Feedback( entry_queue_t * p_queue, unsigned int feedback_index )
 {
+    unsigned int   s;
+
     if ( feedback_index >= p_queue->feedback_count )
     {
         DisplayLog( LVL_CRIT, QUEUE_TAG,
@@ -121,12 +171,86 @@ void Reset_Feedback( entry_queue_t * p_queue, unsigned int feedback_index )
         return;
     }
 
-    lockq( p_queue );
+    for ( s = 0; s < QUEUE_STAT_SLOTS; s++ )
+        atomic_store( &p_queue->feedback_array[s * p_queue->feedback_stride
+                                                + feedback_index], 0 );
+}
 
-    p_queue->feedback_array[feedback_index] = 0;
+/**
+ * Write an entry to the next free slot.
+ * The caller must own a token of sem_empty, so there is always a free slot.
+ */
+static void queue_push( entry_queue_t * p_queue, void *entry )
+{
+    unsigned long  pos = atomic_load( &p_queue->last_index );
+    queue_cell_t  *cell;
 
-    unlockq( p_queue );
+    for ( ;; )
+    {
+        long diff;
+
+        cell = &p_queue->queue[pos & ( p_queue->array_size - 1 )];
+        diff = (long)atomic_load( &cell->seq ) - (long)pos;
+
+        if ( diff == 0 )
+        {
+            /* slot is free: try to reserve it */
+            if ( atomic_cas( &p_queue->last_index, &pos, pos + 1 ) )
+                break;
+            /* else, pos has been updated by atomic_cas */
+        }
+        else if ( diff < 0 )
+        {
+            /* slot not yet released by the consumer of the previous round */
+            sched_yield(  );
+            pos = atomic_load( &p_queue->last_index );
+        }
+        else
+            pos = atomic_load( &p_queue->last_index );
+    }
 
+    cell->data = entry;
+    /* publish the entry */
+    atomic_store( &cell->seq, pos + 1 );
+}
+
+/**
+ * Read an entry from the next filled slot.
+ * The caller must own a token of sem_full, so there is always an entry.
+ */
+static void *queue_pop( entry_queue_t * p_queue )
+{
+    unsigned long  pos = atomic_load( &p_queue->first_index );
+    queue_cell_t  *cell;
+    void          *entry;
+
+    for ( ;; )
+    {
+        long diff;
+
+        cell = &p_queue->queue[pos & ( p_queue->array_size - 1 )];
+        diff = (long)atomic_load( &cell->seq ) - (long)( pos + 1 );
+
+        if ( diff == 0 )
+        {
+            /* slot is filled: try to reserve it */
+            if ( atomic_cas( &p_queue->first_index, &pos, pos + 1 ) )
+                break;
+        }
+        else if ( diff < 0 )
+        {
+            /* entry is being written by a producer */
+            sched_yield(  );
+            pos = atomic_load( &p_queue->first_index );
+        }
+        else
+            pos = atomic_load( &p_queue->first_index );
+    }
+
+    entry = cell->data;
+    /* release the slot for the next round */
+    atomic_store( &cell->seq, pos + p_queue->array_size );
+    return entry;
 }
 
 /**
@@ -135,44 +259,19 @@ void Reset_Feedback( entry_queue_t * p_queue, unsigned int feedback_index )
  */
 int Queue_Insert( entry_queue_t * p_queue, void *entry )
 {
-
     if ( p_queue == NULL )
         return EFAULT;
 
     sem_wait_safe( &p_queue->sem_empty ); /* wait for free places */
 
-    lockq( p_queue );           /* enter into the critical section */
-
-    /* The queue should not be full */
-    if ( is_full( p_queue ) )
-    {
-
-        unlockq( p_queue );
-        DisplayLog( LVL_CRIT, QUEUE_TAG, "UNEXPECTED ERROR: queue should not be full!" );
-        return EFAULT;
-    }
-    else
-    {
-
-        /* Inserts data into the queue */
-        p_queue->queue[p_queue->last_index] = entry;
-        p_queue->last_index = ( p_queue->last_index + 1 ) % p_queue->array_size;
-
-    }
-
-    p_queue->last_submitted = time( NULL );
-
-    unlockq( p_queue );
+    queue_push( p_queue, entry );
+    atomic_store( &p_queue->last_submitted, time( NULL ) );
 
     sem_post_safe( &p_queue->sem_full );  /* increase filled places */
 
     return 0;
-
 }
 
-
-
-
 /**
  * Get an entry from the queue.
  * The call is blocking until there is an element available
@@ -180,71 +279,122 @@ int Queue_Insert( entry_queue_t * p_queue, void *entry )
  */
 int Queue_Get( entry_queue_t * p_queue, void **p_ptr )
 {
-    lockq( p_queue );
-    p_queue->nb_thr_waiting++;
-    unlockq( p_queue );
-
+    atomic_add( &p_queue->nb_thr_waiting, 1 );
     sem_wait_safe( &p_queue->sem_full );  /* wait for filled places */
+    atomic_add( &p_queue->nb_thr_waiting, -1 );
 
-    lockq( p_queue );           /* enters into the critical section */
-
-    p_queue->nb_thr_waiting--;
+    *p_ptr = queue_pop( p_queue );
+    atomic_store( &p_queue->last_unqueued, time( NULL ) );
 
-    /* The queue should not be empty */
-    if ( is_empty( p_queue ) )
-    {
+    sem_post_safe( &p_queue->sem_empty ); /* increase free places */
 
-        unlockq( p_queue );
-        DisplayLog( LVL_CRIT, QUEUE_TAG, "UNEXPECTED ERROR: queue should not be empty!" );
-        return EFAULT;
-    }
-    else
-    {
-        /* retrieves data into the queue */
-        *p_ptr = p_queue->queue[p_queue->first_index];
-        p_queue->first_index = ( p_queue->first_index + 1 ) % p_queue->array_size;
-    }
+    return 0;
+}
 
-    p_queue->last_unqueued = time( NULL );
+/**
+ * Get an entry from the queue, if there is one available.
+ * \retval EAGAIN if the queue is empty.
+ */
+int Queue_TryGet( entry_queue_t * p_queue, void **p_ptr )
+{
+    if ( sem_trywait( &p_queue->sem_full ) != 0 )
+        return ( errno == EINTR ) ? EAGAIN : errno;
 
-    unlockq( p_queue );
+    *p_ptr = queue_pop( p_queue );
+    atomic_store( &p_queue->last_unqueued, time( NULL ) );
 
     sem_post_safe( &p_queue->sem_empty ); /* increase free places */
 
     return 0;
-
 }
 
-
 /**
- * Acknwoledge when an entry has been handled.
- * Indicates the status and optionnal feedback info (as unsigned long long array).
- * (to be called by the worker thread)
+ * Get up to 'max' entries from the queue.
+ * If 'block' is true, the call is blocking until there is at least
+ * one element available in the queue.
+ * \retval EAGAIN if the queue is empty and 'block' is false.
  */
-void Queue_Acknowledge( entry_queue_t * p_queue, unsigned int status,
-                        unsigned long long *feedback_array, unsigned int feedback_count )
+int Queue_GetBatch( entry_queue_t * p_queue, void **p_ptrs,
+                    unsigned int max, unsigned int *count, bool block )
 {
-    unsigned int   i;
+    int rc;
+
+    *count = 0;
+    if ( max == 0 )
+        return 0;
+
+    if ( block )
+        rc = Queue_Get( p_queue, &p_ptrs[0] );
+    else
+        rc = Queue_TryGet( p_queue, &p_ptrs[0] );
+    if ( rc )
+        return rc;
+
+    for ( *count = 1; *count < max; ( *count )++ )
+    {
+        if ( Queue_TryGet( p_queue, &p_ptrs[*count] ) != 0 )
+            break;
+    }
+    return 0;
+}
 
-    lockq( p_queue );
+/** account acknowledgement of an entry in the thread stripe */
+static inline void ack_one( entry_queue_t * p_queue, unsigned int slot,
+                            unsigned int status,
+                            const unsigned long long *feedback_array,
+                            unsigned int feedback_count )
+{
+    unsigned int   i;
 
     if ( status >= p_queue->status_count )
         DisplayLog( LVL_CRIT, QUEUE_TAG, "ERROR: status overflow (status=%u, max=%u)", status,
                     p_queue->status_count - 1 );
     else
-        p_queue->status_array[status]++;
+        atomic_add( &p_queue->status_array[slot * p_queue->status_stride + status], 1 );
 
     if ( feedback_count > p_queue->feedback_count )
         DisplayLog( LVL_CRIT, QUEUE_TAG,
                     "ERROR: feedback_array overflow (feedback_count=%u, max=%u)", feedback_count,
                     p_queue->feedback_count );
 
+    if ( feedback_array == NULL )
+        return;
+
     for ( i = 0; i < MIN2( feedback_count, p_queue->feedback_count ); i++ )
-        p_queue->feedback_array[i] += feedback_array[i];
+        if ( feedback_array[i] != 0 )
+            atomic_add( &p_queue->feedback_array[slot * p_queue->feedback_stride + i],
+                        feedback_array[i] );
+}
 
-    p_queue->last_ack = time( NULL );
+/**
+ * Acknwoledge when an entry has been handled.
+ * Indicates the status and optionnal feedback info (as unsigned long long array).
+ * (to be called by the worker thread)
+ */
+void Queue_Acknowledge( entry_queue_t * p_queue, unsigned int status,
+                        unsigned long long *feedback_array, unsigned int feedback_count )
+{
+    ack_one( p_queue, stat_slot(  ), status, feedback_array, feedback_count );
+    atomic_store( &p_queue->last_ack, time( NULL ) );
+}
+
+/**
+ * Acknowledge a set of entries at once.
+ */
+void Queue_AcknowledgeBatch( entry_queue_t * p_queue, unsigned int count,
+                             const unsigned int *status,
+                             const unsigned long long *feedback_array,
+                             unsigned int feedback_count )
+{
+    unsigned int   slot = stat_slot(  );
+    unsigned int   i;
 
-    unlockq( p_queue );
+    for ( i = 0; i < count; i++ )
+        ack_one( p_queue, slot, status[i],
+                 feedback_array ? feedback_array + i * feedback_count : NULL,
+                 feedback_count );
+
+    atomic_store( &p_queue->last_ack, time( NULL ) );
 }
 
 
@@ -253,27 +403,39 @@ void RetrieveQueueStats( entry_queue_t * p_queue, unsigned int *p_nb_thr_wait,
                          time_t * p_last_unqueued, time_t * p_last_ack, unsigned int *status_array,
                          unsigned long long *feedback_array )
 {
-    unsigned int   i;
-    lockq( p_queue );
+    unsigned int   i, s;
 
     if ( p_nb_thr_wait )
-        *p_nb_thr_wait = p_queue->nb_thr_waiting;
+        *p_nb_thr_wait = atomic_load( &p_queue->nb_thr_waiting );
     if ( p_nb_items )
-        *p_nb_items = nb_items( p_queue );
+    {
+        unsigned long first = atomic_load( &p_queue->first_index );
+        unsigned long last = atomic_load( &p_queue->last_index );
+
+        /* entries being written are counted */
+        *p_nb_items = ( last > first ) ? ( unsigned int )( last - first ) : 0;
+    }
     if ( p_last_submitted )
-        *p_last_submitted = p_queue->last_submitted;
+        *p_last_submitted = atomic_load( &p_queue->last_submitted );
     if ( p_last_unqueued )
-        *p_last_unqueued = p_queue->last_unqueued;
+        *p_last_unqueued = atomic_load( &p_queue->last_unqueued );
     if ( p_last_ack )
-        *p_last_ack = p_queue->last_ack;
+        *p_last_ack = atomic_load( &p_queue->last_ack );
 
+    /* sum counters of all stripes */
     if ( status_array )
         for ( i = 0; i < p_queue->status_count; i++ )
-            status_array[i] = p_queue->status_array[i];
+        {
+            status_array[i] = 0;
+            for ( s = 0; s < QUEUE_STAT_SLOTS; s++ )
+                status_array[i] += atomic_load( &p_queue->status_array[s * p_queue->status_stride + i] );
+        }
 
     if ( feedback_array )
         for ( i = 0; i < p_queue->feedback_count; i++ )
-            feedback_array[i] = p_queue->feedback_array[i];
-
-    unlockq( p_queue );
+        {
+            feedback_array[i] = 0;
+            for ( s = 0; s < QUEUE_STAT_SLOTS; s++ )
+                feedback_array[i] += atomic_load( &p_queue->feedback_array[s * p_queue->feedback_stride + i] );
+        }
 }
@@ -0,0 +1,403 @@
+/* -*- mode: c; c-basic-offset: 4; indent-tabs-mode: nil; -*-
+ * vim:expandtab:shiftwidth=4:tabstop=4:
+ */
+/*
+ * Copyright (C) 2016 CEA/DAM
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the CeCILL License.
+ *
+ * The fact that you are presently reading this means that you have had
+ * knowledge of the CeCILL license (http://www.cecill.info) and that you
+ * accept its terms.
+ */
+
+/**
+ * \file    rbh_events.c
+ * \brief   Encoding and decoding of binary event records.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include "rbh_events.h"
+#include "rbh_logs.h"
+
+#include <ctype.h>
+#include <errno.h>
+#include <string.h>
+#include <inttypes.h>
+#include <sys/time.h>
+#include <time.h>
+
+#define EVT_ALIGN(_s)  (((_s) + 7) & ~((size_t)7))
+
+static inline uint64_t evt_now(void)
+{
+    struct timeval tv;
+
+    gettimeofday(&tv, NULL);
+    return (uint64_t)tv.tv_sec * 1000000 + tv.tv_usec;
+}
+
+static void evt_id_set(struct rbh_evt_id *eid, const entry_id_t *id)
+{
+    memset(eid, 0, sizeof(*eid));
+    if (id == NULL)
+        return;
+#ifdef FID_PK
+    eid->seq = id->f_seq;
+    eid->oid = id->f_oid;
+    eid->ver = id->f_ver;
+#else
+    eid->seq = id->fs_key;
+    eid->oid = id->inode;
+    eid->ver = id->validator;
+#endif
+}
+
+/** record being built */
+struct evt_buf {
+    char   data[RBH_EVT_MAX_SIZE];
+    size_t len;
+};
+
+/** initialize a record with its header and body */
+static void *evt_start(struct evt_buf *b, rbh_evt_type_t type, size_t body_size)
+{
+    struct rbh_evt_hdr *hdr = (struct rbh_evt_hdr *)b->data;
+
+    memset(b->data, 0, sizeof(*hdr) + body_size);
+    hdr->type = type;
+    hdr->time = evt_now();
+    b->len = sizeof(*hdr) + body_size;
+
+    return hdr + 1;
+}
+
+/** append a string to a record.
+ * @return the appended length (the string is truncated if needed).
+ */
+static uint16_t evt_append_str(struct evt_buf *b, const char *str, size_t len)
+{
+    size_t max = RBH_EVT_MAX_SIZE - 8 - b->len;
+
+    if (str == NULL)
+        return 0;
+    if (len > max)
+        len = max;
+    if (len > UINT16_MAX)
+        len = UINT16_MAX;
+
+    memcpy(b->data + b->len, str, len);
+    b->len += len;
+    return len;
+}
+
+/** pad the record and write it to the event log */
+static void evt_commit(struct evt_buf *b)
+{
+    struct rbh_evt_hdr *hdr = (struct rbh_evt_hdr *)b->data;
+    size_t              size = EVT_ALIGN(b->len);
+
+    memset(b->data + b->len, 0, size - b->len);
+    hdr->size = size;
+    LogEvent(b->data, size);
+}
+
+void rbh_evt_changelog(const char *mdt, uint64_t index, uint32_t cl_type,
+                       uint32_t cl_flags, uint64_t time_sec, uint32_t time_nsec,
+                       const entry_id_t *tfid, const entry_id_t *pfid,
+                       const char *name, unsigned int name_len)
+{
+    struct evt_buf            b;
+    struct rbh_evt_changelog *body;
+
+    if (!EventLogEnabled())
+        return;
+
+    body = evt_start(&b, RBH_EVT_CHANGELOG, sizeof(*body));
+    body->index = index;
+    body->time_sec = time_sec;
+    body->time_nsec = time_nsec;
+    body->cl_type = cl_type;
+    body->cl_flags = cl_flags;
+    evt_id_set(&body->tfid, tfid);
+    evt_id_set(&body->pfid, pfid);
+    body->mdt_len = evt_append_str(&b, mdt, mdt ? strlen(mdt) : 0);
+    body->name_len = evt_append_str(&b, name, name_len);
+
+    evt_commit(&b);
+}
+
+void rbh_evt_db_op(const entry_id_t *id, operation_type_e op, int rc,
+                   uint64_t cl_index)
+{
+    struct evt_buf        b;
+    struct rbh_evt_db_op *body;
+
+    if (!EventLogEnabled())
+        return;
+
+    body = evt_start(&b, RBH_EVT_DB_OP, sizeof(*body));
+    evt_id_set(&body->id, id);
+    body->op = op;
+    body->rc = rc;
+    body->cl_index = cl_index;
+
+    evt_commit(&b);
+}
+
+void rbh_evt_action(const char *policy, const char *rule, const entry_id_t *id,
+                    const char *path, uint64_t size, int rc,
+                    uint64_t duration)
+{
+    struct evt_buf         b;
+    struct rbh_evt_action *body;
+
+    if (!EventLogEnabled())
+        return;
+
+    body = evt_start(&b, RBH_EVT_ACTION, sizeof(*body));
+    evt_id_set(&body->id, id);
+    body->size = size;
+    body->duration = duration;
+    body->rc = rc;
+    body->policy_len = evt_append_str(&b, policy, policy ? strlen(policy) : 0);
+    body->rule_len = evt_append_str(&b, rule, rule ? strlen(rule) : 0);
+    body->path_len = evt_append_str(&b, path, path ? strlen(path) : 0);
+
+    evt_commit(&b);
+}
+
+void rbh_evt_file_hdr_init(struct rbh_evt_file_hdr *hdr)
+{
+    memset(hdr, 0, sizeof(*hdr));
+    memcpy(hdr->magic, RBH_EVT_MAGIC, RBH_EVT_MAGIC_LEN);
+    hdr->version = RBH_EVT_VERSION;
+#ifdef FID_PK
+    hdr->flags |= RBH_EVT_FILE_FID;
+#endif
+    hdr->create_time = evt_now();
+}
+
+/* -------- readers -------- */
+
+int rbh_evt_read_file_hdr(FILE *stream, struct rbh_evt_file_hdr *hdr)
+{
+    if (fread(hdr, sizeof(*hdr), 1, stream) != 1)
+        return ferror(stream) ? EIO : EINVAL;
+
+    if (memcmp(hdr->magic, RBH_EVT_MAGIC, RBH_EVT_MAGIC_LEN))
+        return EINVAL;
+    if (hdr->version > RBH_EVT_VERSION)
+        return EPROTO;
+    return 0;
+}
+
+int rbh_evt_read(FILE *stream, struct rbh_evt_hdr *buf)
+{
+    if (fread(buf, sizeof(*buf), 1, stream) != 1)
+        return ferror(stream) ? -EIO : 1;
+
+    if (buf->size < sizeof(*buf) || buf->size > RBH_EVT_MAX_SIZE
+        || buf->size % 8 != 0)
+        return -EPROTO;
+
+    if (fread(buf + 1, buf->size - sizeof(*buf), 1, stream) != 1)
+        return ferror(stream) ? -EIO : -EPROTO;
+
+    return 0;
+}
+
+/** Lustre changelog record types */
+static const char *cl_type_names[] = {
+    "MARK", "CREAT", "MKDIR", "HLINK", "SLINK", "MKNOD", "UNLNK", "RMDIR",
+    "RENME", "RNMTO", "OPEN", "CLOSE", "LYOUT", "TRUNC", "SATTR", "XATTR",
+    "HSM", "MTIME", "CTIME", "ATIME", "MIGRT"
+};
+
+static const char *db_op_names[] = {
+    "noop", "insert", "update", "remove_name", "remove_last", "soft_remove"
+};
+
+static void print_id(FILE *out, const struct rbh_evt_file_hdr *file_hdr,
+                     const struct rbh_evt_id *id)
+{
+    if (file_hdr->flags & RBH_EVT_FILE_FID)
+        fprintf(out, "[0x%"PRIx64":0x%"PRIx64":0x%x]", id->seq, id->oid, id->ver);
+    else
+        fprintf(out, "%"PRIx64"/%"PRIu64, id->seq, id->oid);
+}
+
+/** print a string, escaped for JSON.
+ * In text mode, non-printable characters are replaced with '?',
+ * like in text logs. */
+static void print_str(FILE *out, const char *str, size_t len, bool json)
+{
+    size_t i;
+
+    if (!json)
+    {
+        for (i = 0; i < len; i++)
+            fputc(isprint((unsigned char)str[i]) ? str[i] : '?', out);
+        return;
+    }
+
+    fputc('"', out);
+    for (i = 0; i < len; i++)
+    {
+        unsigned char c = str[i];
+
+        if (c == '"' || c == '\\')
+            fprintf(out, "\\%c", c);
+        else if (c < 0x20)
+            fprintf(out, "\\u%04x", c);
+        else
+            fputc(c, out);
+    }
+    fputc('"', out);
+}
+
+/** print the name of a record field: ' name=' or ',"name":' */
+#define print_field(_out, _json, _name) \
+            fprintf((_out), (_json) ? ",\"%s\":" : " %s=", (_name))
+
+static void print_id_field(FILE *out, const struct rbh_evt_file_hdr *file_hdr,
+                           const char *name, const struct rbh_evt_id *id,
+                           bool json)
+{
+    print_field(out, json, name);
+    if (json)
+        fputc('"', out);
+    print_id(out, file_hdr, id);
+    if (json)
+        fputc('"', out);
+}
+
+void rbh_evt_print(FILE *out, const struct rbh_evt_file_hdr *file_hdr,
+                   const struct rbh_evt_hdr *rec, rbh_evt_format_t format)
+{
+    bool        json = (format == RBH_EVT_FMT_JSON);
+    const char *body = (const char *)(rec + 1);
+    size_t      body_size = rec->size - sizeof(*rec);
+    const char *str;
+    time_t      sec = rec->time / 1000000;
+    struct tm   date;
+    char        date_str[128];
+
+    localtime_r(&sec, &date);
+    strftime(date_str, sizeof(date_str), "%Y/%m/%d %H:%M:%S", &date);
+
+    switch (rec->type)
+    {
+        case RBH_EVT_CHANGELOG:
+        {
+            const struct rbh_evt_changelog *cl = (const void *)body;
+
+            if (body_size < sizeof(*cl)
+                || body_size < sizeof(*cl) + cl->mdt_len + cl->name_len)
+                return;
+            str = body + sizeof(*cl);
+
+            if (json)
+                fprintf(out, "{\"time\":%"PRIu64",\"event\":\"changelog\"",
+                        rec->time);
+            else
+                fprintf(out, "%s.%06u changelog", date_str,
+                        (unsigned int)(rec->time % 1000000));
+
+            print_field(out, json, "mdt");
+            print_str(out, str, cl->mdt_len, json);
+            print_field(out, json, "index");
+            fprintf(out, "%"PRIu64, cl->index);
+            print_field(out, json, "type");
+            if (cl->cl_type < sizeof(cl_type_names) / sizeof(char *))
+                print_str(out, cl_type_names[cl->cl_type],
+                          strlen(cl_type_names[cl->cl_type]), json);
+            else
+                fprintf(out, "%u", cl->cl_type);
+            print_field(out, json, "flags");
+            fprintf(out, json ? "%u" : "0x%x", cl->cl_flags);
+            print_field(out, json, "cl_time");
+            fprintf(out, "%"PRIu64".%09u", cl->time_sec, cl->time_nsec);
+            print_id_field(out, file_hdr, "target", &cl->tfid, json);
+            print_id_field(out, file_hdr, "parent", &cl->pfid, json);
+            print_field(out, json, "name");
+            print_str(out, str + cl->mdt_len, cl->name_len, json);
+            break;
+        }
+
+        case RBH_EVT_DB_OP:
+        {
+            const struct rbh_evt_db_op *op = (const void *)body;
+
+            if (body_size < sizeof(*op))
+                return;
+
+            if (json)
+                fprintf(out, "{\"time\":%"PRIu64",\"event\":\"db_op\"",
+                        rec->time);
+            else
+                fprintf(out, "%s.%06u db_op", date_str,
+                        (unsigned int)(rec->time % 1000000));
+
+            print_id_field(out, file_hdr, "id", &op->id, json);
+            print_field(out, json, "op");
+            if (op->op < sizeof(db_op_names) / sizeof(char *))
+                print_str(out, db_op_names[op->op], strlen(db_op_names[op->op]),
+                          json);
+            else
+                fprintf(out, "%u", op->op);
+            print_field(out, json, "rc");
+            fprintf(out, "%d", op->rc);
+            if (op->cl_index != 0)
+            {
+                print_field(out, json, "cl_index");
+                fprintf(out, "%"PRIu64, op->cl_index);
+            }
+            break;
+        }
+
+        case RBH_EVT_ACTION:
+        {
+            const struct rbh_evt_action *act = (const void *)body;
+
+            if (body_size < sizeof(*act)
+                || body_size < sizeof(*act) + act->policy_len + act->rule_len
+                                + act->path_len)
+                return;
+            str = body + sizeof(*act);
+
+            if (json)
+                fprintf(out, "{\"time\":%"PRIu64",\"event\":\"action\"",
+                        rec->time);
+            else
+                fprintf(out, "%s.%06u action", date_str,
+                        (unsigned int)(rec->time % 1000000));
+
+            print_field(out, json, "policy");
+            print_str(out, str, act->policy_len, json);
+            print_field(out, json, "rule");
+            print_str(out, str + act->policy_len, act->rule_len, json);
+            print_id_field(out, file_hdr, "id", &act->id, json);
+            print_field(out, json, "path");
+            print_str(out, str + act->policy_len + act->rule_len,
+                      act->path_len, json);
+            print_field(out, json, "size");
+            fprintf(out, "%"PRIu64, act->size);
+            print_field(out, json, "rc");
+            fprintf(out, "%d", act->rc);
+            print_field(out, json, "duration_us");
+            fprintf(out, "%"PRIu64, act->duration);
+            break;
+        }
+
+        default:
+            /* unknown record type (newer version) */
+            return;
+    }
+
+    fprintf(out, json ? "}\n" : "\n");
+}
@@ -23,6 +23,7 @@
 #include "rbh_cfg_helpers.h"
 #include "rbh_logs.h"
 #include "rbh_misc.h"
+#include "rbh_events.h"
 #include "xplatform_print.h"
 
 #include <stdio.h>
@@ -30,12 +31,15 @@
 #include <sys/param.h>
 #include <sys/types.h>
 #include <sys/stat.h>
+#include <sys/uio.h>
 #include <unistd.h>
 #include <sys/utsname.h>
 #include <string.h>
 #include <errno.h>
 #include <stdlib.h>
 #include <ctype.h>
+#include <stdint.h>
+#include <inttypes.h>
 #include <glib.h>
 
 #define SYSLOG_NAMES /* to get the array of syslog facilities */
@@ -53,6 +57,10 @@
 #define MAX_MAIL_LEN      4096
 
 static bool log_initialized = false;
+/* set if log lines are written by a dedicated thread */
+static bool async_enabled = false;
+static int  async_init(void);
+static void async_drain(void);
 
 log_config_t log_config = {
     .debug_level = LVL_EVENT, /* used for non-initialized logging */
@@ -87,6 +95,11 @@ static log_stream_t alert   = RBH_LOG_INITIALIZER;
 #ifdef HAVE_CHANGELOGS
 static log_stream_t chglogs = RBH_LOG_INITIALIZER;
 #endif
+/* binary event log */
+static log_stream_t events  = RBH_LOG_INITIALIZER;
+/* size of the current event file */
+static uint64_t     events_size = 0;
+static void events_opened(void);
 
 /* syslog info */
 static bool syslog_opened = false;
@@ -358,6 +371,30 @@ int InitializeLogs(const char *program_name)
     }
 #endif
 
+    if (!EMPTY_STRING(log_config.events_file))
+    {
+        rc = init_log_descr(log_config.events_file, &events);
+        if (rc)
+            return rc;
+
+        /* don't write binary records to stderr if the file can't be opened */
+        if (events.log_type != RBH_LOG_REGFILE
+            && strcasecmp(log_config.events_file, "stdout"))
+        {
+            fprintf(stderr, "Event logging is disabled.\n");
+            events.f_log = NULL;
+        }
+        else
+            events_opened();
+    }
+
+    if (log_config.async_logging)
+    {
+        rc = async_init();
+        if (rc)
+            return rc;
+    }
+
     /* Update log level for external components we get logs from (LLAPI...) */
     rbh_adjust_log_level_external();
 
@@ -392,12 +429,16 @@ void FlushLogs( void )
 {
     log_init_check(  );
 
+    if ( async_enabled )
+        async_drain(  );
+
     flush_log_descr( &log );
     flush_log_descr( &report );
     flush_log_descr( &alert );
 #ifdef HAVE_CHANGELOGS
     flush_log_descr( &chglogs );
 #endif
+    flush_log_descr( &events );
 }
 
 
@@ -427,7 +468,9 @@ static void test_log_descr( const char * logname, log_stream_t * p_log )
             fclose( p_log->f_log );
             p_log->f_log = fopen( logname, "a" );
 
-            if ( fstat( fileno( p_log->f_log ), &filestat ) != -1 )
+            if ( p_log == &events )
+                events_opened();
+            else if ( fstat( fileno( p_log->f_log ), &filestat ) != -1 )
                 p_log->f_ino = filestat.st_ino;
         }
     }
@@ -439,6 +482,9 @@ static void test_log_descr( const char * logname, log_stream_t * p_log )
         fclose( p_log->f_log );
         p_log->f_log = fopen( logname, "a" );
         p_log->f_ino = filestat.st_ino;
+
+        if ( p_log == &events )
+            events_opened();
     }
 
     pthread_rwlock_unlock( &p_log->f_lock );
@@ -461,6 +507,9 @@ static void test_file_names( void )
     if ( !EMPTY_STRING( log_config.changelogs_file ) )
         test_log_descr( log_config.changelogs_file, &chglogs );
 #endif
+
+    if ( events.f_log != NULL )
+        test_log_descr( log_config.events_file, &events );
 }
 
 
@@ -499,6 +548,625 @@ static void clean_str(char *str)
 }
 
 
+/* date of log lines: localtime is only computed once per second and thread */
+static __thread time_t    date_cache_time = 0;
+static __thread struct tm date_cache;
+
+static inline void log_localtime(time_t now, struct tm *date)
+{
+    if (now != date_cache_time)
+    {
+        localtime_r(&now, &date_cache);
+        date_cache_time = now;
+    }
+    *date = date_cache;
+}
+
+/* ---------------- Asynchronous logging -------------------- */
+
+/* When async_logging is enabled, lines of the log and changelog streams
+ * are formatted by the calling thread and appended to a ring buffer owned
+ * by this thread (single producer, single consumer, no lock).
+ * A dedicated writer thread drains all buffers and writes their contents
+ * in batches (one writev per stream). Reports and alerts are still written
+ * synchronously.
+ */
+
+#define atomic_load(_p)         __atomic_load_n((_p), __ATOMIC_ACQUIRE)
+#define atomic_store(_p, _v)    __atomic_store_n((_p), (_v), __ATOMIC_RELEASE)
+#define atomic_add(_p, _v)      __atomic_add_fetch((_p), (_v), __ATOMIC_RELAXED)
+
+/** streams that can be written asynchronously */
+enum async_stream {
+    ASYNC_LOG = 0,
+#ifdef HAVE_CHANGELOGS
+    ASYNC_CHGLOGS,
+#endif
+    ASYNC_EVENTS,
+    ASYNC_STREAM_COUNT
+};
+
+static log_stream_t *const async_streams[ASYNC_STREAM_COUNT] = {
+    [ASYNC_LOG] = &log,
+#ifdef HAVE_CHANGELOGS
+    [ASYNC_CHGLOGS] = &chglogs,
+#endif
+    [ASYNC_EVENTS] = &events,
+};
+
+/** header of records in ring buffers (records are 8 bytes aligned,
+ * so a header never wraps around the end of the buffer) */
+typedef struct async_rec_hdr {
+    uint32_t len;     /* line length, including the final '\n' */
+    uint32_t stream;  /* enum async_stream */
+} async_rec_hdr_t;
+
+#define ASYNC_ALIGN(_s)  (((_s) + 7) & ~((uint64_t)7))
+#define ASYNC_MIN_BUFFER (8 * (MAX_LINE_LEN + 64))
+
+/** per-thread ring buffer */
+typedef struct async_ring {
+    char               *buf;
+    uint64_t            size;   /* multiple of 8 */
+    uint64_t            head;   /* written by the owner thread */
+    uint64_t            tail;   /* written by the draining thread */
+    uint64_t            scan;   /* end of the batch being written */
+    bool                dead;   /* the owner thread has exited */
+    struct async_ring  *next;
+} async_ring_t;
+
+/* polling interval of the writer thread (ms) */
+#define ASYNC_POLL_MS      100
+/* delay between checks for free space, when a buffer is full (us) */
+#define ASYNC_BLOCK_DELAY  1000
+/* max number of iovec per stream in a batch */
+#define ASYNC_IOV_MAX      512
+/* max number of passes to flush buffers */
+#define ASYNC_FLUSH_PASSES 16
+
+static bool            async_writer_running = false;
+static pthread_t       async_writer;
+static pthread_mutex_t async_start_lock = PTHREAD_MUTEX_INITIALIZER;
+
+static pthread_key_t   async_key;
+static __thread async_ring_t *async_ring = NULL;
+
+/* list of rings (only modified by ring creation and draining) */
+static async_ring_t   *async_rings = NULL;
+static pthread_mutex_t async_list_lock = PTHREAD_MUTEX_INITIALIZER;
+/* serializes drain passes (writer thread, FlushLogs, process exit) */
+static pthread_mutex_t async_drain_lock = PTHREAD_MUTEX_INITIALIZER;
+
+/* to wake up the writer thread */
+static pthread_mutex_t async_wake_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t  async_wake_cond = PTHREAD_COND_INITIALIZER;
+static bool            async_wake_req = false;
+
+static uint64_t        async_dropped = 0;
+
+static int async_stream_index(const log_stream_t *p_log)
+{
+    int i;
+
+    for (i = 0; i < ASYNC_STREAM_COUNT; i++)
+        if (async_streams[i] == p_log)
+            return i;
+    return -1;
+}
+
+static void async_wake(void)
+{
+    /* avoid taking the lock if a wake-up is already pending */
+    if (atomic_load(&async_wake_req))
+        return;
+
+    pthread_mutex_lock(&async_wake_lock);
+    async_wake_req = true;
+    pthread_cond_signal(&async_wake_cond);
+    pthread_mutex_unlock(&async_wake_lock);
+}
+
+/* called at thread exit: the ring is released by the writer,
+ * once all its records are written */
+static void async_ring_release(void *arg)
+{
+    async_ring_t *ring = arg;
+
+    async_ring = NULL;
+    atomic_store(&ring->dead, true);
+}
+
+/** get (or create) the ring of the current thread */
+static async_ring_t *async_ring_get(void)
+{
+    async_ring_t *ring = async_ring;
+
+    if (ring != NULL)
+        return ring;
+
+    ring = calloc(1, sizeof(*ring));
+    if (ring == NULL)
+        return NULL;
+
+    ring->size = ASYNC_ALIGN(log_config.async_buffer_size);
+    if (ring->size < ASYNC_MIN_BUFFER)
+        ring->size = ASYNC_MIN_BUFFER;
+
+    ring->buf = malloc(ring->size);
+    if (ring->buf == NULL)
+    {
+        free(ring);
+        return NULL;
+    }
+
+    pthread_setspecific(async_key, ring);
+
+    pthread_mutex_lock(&async_list_lock);
+    ring->next = async_rings;
+    async_rings = ring;
+    pthread_mutex_unlock(&async_list_lock);
+
+    async_ring = ring;
+    return ring;
+}
+
+/** Append a line to the ring of the current thread.
+ * @return false if the line must be written synchronously.
+ */
+static bool async_push(int stream, const char *line, size_t len)
+{
+    async_ring_t    *ring = async_ring_get();
+    async_rec_hdr_t *hdr;
+    uint64_t         head, need, pos, first;
+    int              waited = 0;
+
+    if (ring == NULL)
+        return false;
+
+    need = ASYNC_ALIGN(sizeof(*hdr) + len);
+    head = ring->head;
+
+    /* backpressure: wait for the writer, up to async_block_ms */
+    while (ring->size - (head - atomic_load(&ring->tail)) < need)
+    {
+        if (log_config.async_drop || waited >= log_config.async_block_ms)
+        {
+            atomic_add(&async_dropped, 1);
+            return true;
+        }
+        async_wake();
+        rh_usleep(ASYNC_BLOCK_DELAY);
+        waited++;
+    }
+
+    pos = head % ring->size;
+    hdr = (async_rec_hdr_t *)(ring->buf + pos);
+    hdr->len = len;
+    hdr->stream = stream;
+
+    pos = (pos + sizeof(*hdr)) % ring->size;
+    first = MIN(len, ring->size - pos);
+    memcpy(ring->buf + pos, line, first);
+    if (first < len)
+        memcpy(ring->buf, line + first, len - first);
+
+    atomic_store(&ring->head, head + need);
+
+    /* wake up the writer early if the buffer is getting full */
+    if (head + need - atomic_load(&ring->tail) > ring->size / 2)
+        async_wake();
+
+    return true;
+}
+
+/** write a batch of records to a stream */
+static void async_writev(log_stream_t *p_log, struct iovec *iov, int cnt)
+{
+    ssize_t rc;
+    int     fd;
+    uint64_t written = 0;
+
+    pthread_rwlock_rdlock(&p_log->f_lock);
+    if (p_log->f_log == NULL)
+        goto out;
+
+    /* first write lines that were written synchronously */
+    fflush(p_log->f_log);
+    fd = fileno(p_log->f_log);
+
+    while (cnt > 0)
+    {
+        rc = writev(fd, iov, MIN(cnt, IOV_MAX));
+        if (rc < 0)
+        {
+            if (errno == EINTR)
+                continue;
+            break;
+        }
+        written += rc;
+
+        /* skip written vectors, and handle partial writes */
+        while (cnt > 0 && (size_t)rc >= iov->iov_len)
+        {
+            rc -= iov->iov_len;
+            iov++;
+            cnt--;
+        }
+        if (cnt > 0)
+        {
+            iov->iov_base = (char *)iov->iov_base + rc;
+            iov->iov_len -= rc;
+        }
+    }
+out:
+    pthread_rwlock_unlock(&p_log->f_lock);
+
+    if (p_log == &events)
+        atomic_add(&events_size, written);
+}
+
+/** Write pending records of all rings.
+ * Must be called with async_drain_lock held.
+ * @return the number of written records.
+ */
+static unsigned int async_drain_pass(void)
+{
+    static struct iovec iov[ASYNC_STREAM_COUNT][ASYNC_IOV_MAX];
+    int           cnt[ASYNC_STREAM_COUNT] = { 0 };
+    async_ring_t *ring, **prev;
+    unsigned int  nb = 0;
+    int           i;
+
+    /* build the batch (rings cannot be freed meanwhile, as it is done
+     * by this function, under the protection of async_drain_lock) */
+    pthread_mutex_lock(&async_list_lock);
+    ring = async_rings;
+    pthread_mutex_unlock(&async_list_lock);
+
+    for (; ring != NULL; ring = ring->next)
+    {
+        uint64_t head = atomic_load(&ring->head);
+        uint64_t pos = ring->tail;
+
+        while (pos < head)
+        {
+            async_rec_hdr_t *hdr = (async_rec_hdr_t *)(ring->buf
+                                                       + pos % ring->size);
+            uint64_t off = (pos + sizeof(*hdr)) % ring->size;
+            uint64_t first = MIN(hdr->len, ring->size - off);
+            int      s = hdr->stream;
+
+            if (cnt[s] + 2 > ASYNC_IOV_MAX)
+                break;
+
+            iov[s][cnt[s]].iov_base = ring->buf + off;
+            iov[s][cnt[s]].iov_len = first;
+            cnt[s]++;
+            if (first < hdr->len)
+            {
+                iov[s][cnt[s]].iov_base = ring->buf;
+                iov[s][cnt[s]].iov_len = hdr->len - first;
+                cnt[s]++;
+            }
+            pos += ASYNC_ALIGN(sizeof(*hdr) + hdr->len);
+            nb++;
+        }
+        ring->scan = pos;
+    }
+
+    for (i = 0; i < ASYNC_STREAM_COUNT; i++)
+        if (cnt[i] > 0)
+            async_writev(async_streams[i], iov[i], cnt[i]);
+
+    /* release written records, and free the rings of exited threads */
+    pthread_mutex_lock(&async_list_lock);
+    prev = &async_rings;
+    while ((ring = *prev) != NULL)
+    {
+        /* rings created after the batch was built have scan == tail == 0 */
+        atomic_store(&ring->tail, ring->scan);
+
+        if (atomic_load(&ring->dead) && ring->scan == atomic_load(&ring->head))
+        {
+            *prev = ring->next;
+            free(ring->buf);
+            free(ring);
+            continue;
+        }
+        prev = &ring->next;
+    }
+    pthread_mutex_unlock(&async_list_lock);
+
+    return nb;
+}
+
+/** write all buffered records */
+static void async_drain(void)
+{
+    int i;
+
+    pthread_mutex_lock(&async_drain_lock);
+    for (i = 0; i < ASYNC_FLUSH_PASSES; i++)
+        if (async_drain_pass() == 0)
+            break;
+    pthread_mutex_unlock(&async_drain_lock);
+}
+
+static void events_check_rotate(void);
+
+static void *async_writer_thr(void *arg)
+{
+    uint64_t        reported = 0;
+    uint64_t        dropped;
+    time_t          last_test = time(NULL);
+    time_t          last_report = 0;
+    time_t          now;
+    struct timespec ts;
+
+    for (;;)
+    {
+        clock_gettime(CLOCK_REALTIME, &ts);
+        ts.tv_nsec += ASYNC_POLL_MS * 1000000L;
+        if (ts.tv_nsec >= 1000000000L)
+        {
+            ts.tv_sec++;
+            ts.tv_nsec -= 1000000000L;
+        }
+
+        pthread_mutex_lock(&async_wake_lock);
+        if (!async_wake_req)
+            pthread_cond_timedwait(&async_wake_cond, &async_wake_lock, &ts);
+        async_wake_req = false;
+        pthread_mutex_unlock(&async_wake_lock);
+
+        pthread_mutex_lock(&async_drain_lock);
+        async_drain_pass();
+        pthread_mutex_unlock(&async_drain_lock);
+
+        events_check_rotate();
+
+        /* log rotation is only checked by this thread */
+        now = time(NULL);
+        if (now - last_test > TIME_TEST_FILE)
+        {
+            test_file_names();
+            last_test = now;
+        }
+
+        /* report dropped records (at most once per second) */
+        dropped = atomic_load(&async_dropped);
+        if (dropped != reported && now != last_report)
+        {
+            DisplayLog(LVL_MAJOR, "Logs", "%"PRIu64" log records dropped "
+                       "(asynchronous log buffers full)", dropped - reported);
+            reported = dropped;
+            last_report = now;
+        }
+    }
+    return NULL;
+}
+
+/** start the writer thread, on first use after the process started
+ * (it is not inherited by fork()). */
+static bool async_start_writer(void)
+{
+    int rc;
+
+    if (atomic_load(&async_writer_running))
+        return true;
+
+    pthread_mutex_lock(&async_start_lock);
+    if (!async_writer_running)
+    {
+        rc = pthread_create(&async_writer, NULL, async_writer_thr, NULL);
+        if (rc)
+        {
+            fprintf(stderr, "Error %d creating log writer thread: %s. "
+                    "Switching to synchronous logging.\n", rc, strerror(rc));
+            async_enabled = false;
+        }
+        else
+        {
+            pthread_detach(async_writer);
+            atomic_store(&async_writer_running, true);
+        }
+    }
+    pthread_mutex_unlock(&async_start_lock);
+
+    return async_enabled;
+}
+
+/* all log streams, whose locks are taken at fork time */
+static log_stream_t *const fork_streams[] = {
+    &log, &report, &alert,
+#ifdef HAVE_CHANGELOGS
+    &chglogs,
+#endif
+    &events,
+};
+
+/* Take all locks that other threads may hold while forking,
+ * so that they are in a consistent state in the child.
+ * Stream locks are taken after async_drain_lock, as the writer thread
+ * does when it writes records. */
+static void async_atfork_prepare(void)
+{
+    int i;
+
+    pthread_mutex_lock(&async_drain_lock);
+    pthread_mutex_lock(&async_list_lock);
+    pthread_mutex_lock(&async_wake_lock);
+    for (i = 0; i < G_N_ELEMENTS(fork_streams); i++)
+        pthread_rwlock_wrlock(&fork_streams[i]->f_lock);
+}
+
+static void async_atfork_parent(void)
+{
+    int i;
+
+    for (i = G_N_ELEMENTS(fork_streams) - 1; i >= 0; i--)
+        pthread_rwlock_unlock(&fork_streams[i]->f_lock);
+    pthread_mutex_unlock(&async_wake_lock);
+    pthread_mutex_unlock(&async_list_lock);
+    pthread_mutex_unlock(&async_drain_lock);
+}
+
+static void async_atfork_child(void)
+{
+    async_ring_t *ring;
+    int           i;
+
+    /* only the calling thread exists in the child: other rings
+     * are released when drained, and a new writer must be started */
+    for (ring = async_rings; ring != NULL; ring = ring->next)
+        if (ring != async_ring)
+            ring->dead = true;
+
+    async_writer_running = false;
+    async_wake_req = false;
+
+    /* the writer thread doesn't exist anymore: reset its locks
+     * and condition instead of releasing them */
+    for (i = 0; i < G_N_ELEMENTS(fork_streams); i++)
+        pthread_rwlock_init(&fork_streams[i]->f_lock, NULL);
+    pthread_cond_init(&async_wake_cond, NULL);
+    pthread_mutex_init(&async_wake_lock, NULL);
+    pthread_mutex_init(&async_list_lock, NULL);
+    pthread_mutex_init(&async_drain_lock, NULL);
+}
+
+static int async_init(void)
+{
+    int rc;
+
+    rc = pthread_key_create(&async_key, async_ring_release);
+    if (rc)
+        return rc;
+
+    rc = pthread_atfork(async_atfork_prepare, async_atfork_parent,
+                        async_atfork_child);
+    if (rc)
+        return rc;
+
+    /* write buffered lines at exit */
+    if (atexit(async_drain))
+        return ENOMEM;
+
+    async_enabled = true;
+    return 0;
+}
+
+unsigned long long LogDroppedCount(void)
+{
+    return atomic_load(&async_dropped);
+}
+
+/* ---------------- Binary event log -------------------- */
+
+/* Must be called after the event file is (re)opened, with events.f_lock
+ * held for writing (or at initialization): write the header to new files. */
+static void events_opened(void)
+{
+    struct stat             st;
+    struct rbh_evt_file_hdr hdr;
+
+    if (events.f_log == NULL)
+        return;
+
+    if (fstat(fileno(events.f_log), &st) != 0)
+        return;
+    if (events.log_type == RBH_LOG_REGFILE)
+        events.f_ino = st.st_ino;
+
+    /* file is new, or is not a regular file */
+    if (!S_ISREG(st.st_mode) || st.st_size == 0)
+    {
+        rbh_evt_file_hdr_init(&hdr);
+        if (fwrite(&hdr, sizeof(hdr), 1, events.f_log) == 1)
+            fflush(events.f_log);
+        atomic_store(&events_size, sizeof(hdr));
+    }
+    else
+        atomic_store(&events_size, st.st_size);
+}
+
+/* Rotate the event file when it exceeds events_rotate_size:
+ * it is renamed to <events_file>.<date>, and a new file is opened. */
+static void events_check_rotate(void)
+{
+    char        newname[RBH_PATH_MAX + 64];
+    struct stat st;
+    struct tm   date;
+    time_t      now;
+    int         len, i;
+
+    if (log_config.events_rotate_size == 0
+        || events.log_type != RBH_LOG_REGFILE
+        || atomic_load(&events_size) < log_config.events_rotate_size)
+        return;
+
+    /* another thread is doing it */
+    if (pthread_rwlock_trywrlock(&events.f_lock) != 0)
+        return;
+
+    if (events.f_log == NULL || events_size < log_config.events_rotate_size)
+        goto out;
+
+    now = time(NULL);
+    localtime_r(&now, &date);
+    len = snprintf(newname, sizeof(newname), "%s.%.4d%.2d%.2d-%.2d%.2d%.2d",
+                   log_config.events_file, 1900 + date.tm_year,
+                   date.tm_mon + 1, date.tm_mday, date.tm_hour, date.tm_min,
+                   date.tm_sec);
+
+    /* don't overwrite a file rotated in the same second */
+    for (i = 1; stat(newname, &st) == 0 && i < 100; i++)
+        snprintf(newname + len, sizeof(newname) - len, ".%d", i);
+
+    fflush(events.f_log);
+    if (rename(log_config.events_file, newname) != 0)
+    {
+        fprintf(stderr, "Failed to rotate event file %s: %s\n",
+                log_config.events_file, strerror(errno));
+        /* don't retry at each event */
+        atomic_store(&events_size, 0);
+        goto out;
+    }
+
+    fclose(events.f_log);
+    events.f_log = fopen(log_config.events_file, "a");
+    if (events.f_log == NULL)
+        fprintf(stderr, "Error opening event file %s: %s\n",
+                log_config.events_file, strerror(errno));
+    events_opened();
+
+out:
+    pthread_rwlock_unlock(&events.f_lock);
+}
+
+bool EventLogEnabled(void)
+{
+    return log_initialized && events.f_log != NULL;
+}
+
+void LogEvent(const void *rec, size_t len)
+{
+    if (!EventLogEnabled())
+        return;
+
+    /* written by the writer thread */
+    if (async_enabled && async_start_writer() && async_push(ASYNC_EVENTS, rec, len))
+        return;
+
+    pthread_rwlock_rdlock(&events.f_lock);
+    if (events.f_log != NULL && fwrite(rec, len, 1, events.f_log) == 1)
+        atomic_add(&events_size, len);
+    pthread_rwlock_unlock(&events.f_lock);
+
+    events_check_rotate();
+}
+
+
 static void display_line_log( log_stream_t * p_log, const char * tag,
                        const char *format, va_list arglist )
 {
@@ -508,8 +1176,12 @@ static void display_line_log( log_stream_t * p_log, const char * tag,
     unsigned int   th = GetThreadIndex(  );
     struct tm      date;
     int            would_print;
+    int            stream = -1;
+    char           async_line[MAX_LINE_LEN + 64];
+    int            async_len = 0;
 
-    if ( log_initialized )
+    /* with asynchronous logging, this is done by the writer thread */
+    if ( log_initialized && !async_enabled )
     {
         /* periodically check if log files have been renamed */
         if ( now - last_time_test > TIME_TEST_FILE )
@@ -556,7 +1228,7 @@ static void display_line_log( log_stream_t * p_log, const char * tag,
     }
     else /* log to a file */
     {
-        localtime_r( &now, &date );
+        log_localtime( now, &date );
 
         written =
             snprintf(line_log, MAX_LINE_LEN,
@@ -572,7 +1244,19 @@ static void display_line_log( log_stream_t * p_log, const char * tag,
         would_print = vsnprintf(line_log + written, MAX_LINE_LEN - written, format, arglist);
         clean_str(line_log);
 
-        if ( p_log->f_log != NULL )
+        if ( async_enabled && (stream = async_stream_index(p_log)) >= 0 )
+        {
+            /* the line is written later by the writer thread */
+            if (would_print >= MAX_LINE_LEN - written)
+                async_len = snprintf(async_line, sizeof(async_line),
+                                     "%s... <Line truncated. Original size=%u>\n",
+                                     line_log, would_print);
+            else
+                async_len = snprintf(async_line, sizeof(async_line), "%s\n",
+                                     line_log);
+            async_len = MIN(async_len, sizeof(async_line) - 1);
+        }
+        else if ( p_log->f_log != NULL )
         {
         if (would_print >= MAX_LINE_LEN - written)
             fprintf(p_log->f_log, "%s... <Line truncated. Original size=%u>\n", line_log, would_print);
@@ -581,6 +1265,17 @@ static void display_line_log( log_stream_t * p_log, const char * tag,
         }
     }
     pthread_rwlock_unlock( &p_log->f_lock );
+
+    /* done out of the stream lock, as it may wait for the writer thread */
+    if ( async_len > 0
+         && (!async_start_writer() || !async_push(stream, async_line, async_len)) )
+    {
+        /* could not buffer the line: write it directly */
+        pthread_rwlock_rdlock( &p_log->f_lock );
+        if ( p_log->f_log != NULL )
+            fputs(async_line, p_log->f_log);
+        pthread_rwlock_unlock( &p_log->f_lock );
+    }
 }
 
 
@@ -615,6 +1310,15 @@ void vDisplayLogFn(log_level debug_level, const char *tag, const char *format,
     {
         display_line_log(&log, tag, format, ap);
 
+        if (async_enabled)
+        {
+            /* lines are written directly by the writer thread:
+             * just make it write major errors immediately */
+            if (debug_level <= LVL_MAJOR)
+                async_wake();
+            return;
+        }
+
         /* test if it's time to flush.
          * Also flush major errors, to display it immediately. */
         if ((now - last_time_flush_log) > TIME_FLUSH_LOG || debug_level >= LVL_MAJOR)
@@ -1007,6 +1711,8 @@ static void log_cfg_set_default(void *module_config)
 #ifdef HAVE_CHANGELOGS
     conf->changelogs_file[0] = '\0';
 #endif
+    conf->events_file[0] = '\0';
+    conf->events_rotate_size = 1024LL * 1024 * 1024; /* 1GB */
 
     conf->syslog_facility = LOG_LOCAL1;
     conf->syslog_priority = LOG_INFO;
@@ -1018,6 +1724,11 @@ static void log_cfg_set_default(void *module_config)
 
     conf->log_process = 0;
     conf->log_host = 0;
+
+    conf->async_logging = false;
+    conf->async_buffer_size = 1024 * 1024;
+    conf->async_drop = false;
+    conf->async_block_ms = 100;
 }
 
 static void log_cfg_write_default(FILE * output)
@@ -1027,12 +1738,18 @@ static void log_cfg_write_default(FILE * output)
     print_line(output, 1, "log_file       :   \"/var/log/robinhood.log\"");
     print_line(output, 1, "report_file    :   \"/var/log/robinhood_actions.log\"");
     print_line(output, 1, "alert_file     :   \"/var/log/robinhood_alerts.log\"");
+    print_line(output, 1, "events_file    :   \"\" (disabled)");
+    print_line(output, 1, "events_rotate_size: 1GB");
     print_line(output, 1, "syslog_facility:   local1.info");
     print_line(output, 1, "stats_interval :   15min");
     print_line(output, 1, "batch_alert_max:   1 (no batching)");
     print_line(output, 1, "alert_show_attrs: no");
     print_line(output, 1, "log_procname: no");
     print_line(output, 1, "log_hostname: no");
+    print_line(output, 1, "async_logging    :   no");
+    print_line(output, 1, "async_buffer_size:   1MB");
+    print_line(output, 1, "async_overflow   :   block");
+    print_line(output, 1, "async_block_ms   :   100");
     print_end_block(output, 0);
 }
 
@@ -1058,6 +1775,12 @@ static void log_cfg_write_template(FILE * output)
     print_line(output, 1, "# File to dump changelogs into");
     print_line(output, 1, "changelogs_file = \"/var/log/robinhood_cl.log\" ;");
 #endif
+    fprintf(output, "\n");
+    print_line(output, 1, "# Binary log of changelog records, database operations and");
+    print_line(output, 1, "# policy actions (use rbh-events to convert it to text or JSON)");
+    print_line(output, 1, "#events_file = \"/var/log/robinhood_events.bin\" ;");
+    print_line(output, 1, "# rotate the event file when it exceeds this size (0 = never)");
+    print_line(output, 1, "events_rotate_size = 1GB ;");
     fprintf(output, "\n");
     print_line(output, 1, "# Interval for dumping stats (to logfile)");
     print_line(output, 1, "stats_interval = 20min ;");
@@ -1073,6 +1796,16 @@ static void log_cfg_write_template(FILE * output)
     print_line(output, 1, "log_procname = yes;");
     print_line(output, 1, "# whether the host name appears in the log line");
     print_line(output, 1, "log_hostname = yes;");
+    fprintf(output, "\n");
+    print_line(output, 1, "# Write log lines from a dedicated thread, to avoid");
+    print_line(output, 1, "# blocking processing threads on log file I/O.");
+    print_line(output, 1, "async_logging = no ;");
+    print_line(output, 1, "# Size of the log buffer of each thread");
+    print_line(output, 1, "async_buffer_size = 1MB ;");
+    print_line(output, 1, "# When a buffer is full: 'drop' log lines immediately,");
+    print_line(output, 1, "# or 'block' up to async_block_ms milliseconds before dropping them.");
+    print_line(output, 1, "async_overflow = block ;");
+    print_line(output, 1, "async_block_ms = 100 ;");
     print_end_block(output, 0);
 }
 
@@ -1088,6 +1821,8 @@ static int log_cfg_read(config_file_t config, void *module_config, char *msg_out
     static const char *allowed_params[] = { "debug_level", "log_file", "report_file",
         "alert_file", "alert_mail", "stats_interval", "batch_alert_max",
         "alert_show_attrs", "syslog_facility", "log_procname", "log_hostname",
+        "async_logging", "async_buffer_size", "async_overflow", "async_block_ms",
+        "events_file", "events_rotate_size",
 #ifdef HAVE_CHANGELOGS
         "changelogs_file",
 #endif
@@ -1109,6 +1844,11 @@ static int log_cfg_read(config_file_t config, void *module_config, char *msg_out
             PFLG_ABSOLUTE_PATH | PFLG_NO_WILDCARDS | PFLG_STDIO_ALLOWED,
             conf->changelogs_file, sizeof(conf->changelogs_file)},
 #endif
+        {"events_file", PT_STRING,
+            PFLG_ABSOLUTE_PATH | PFLG_NO_WILDCARDS | PFLG_STDIO_ALLOWED,
+            conf->events_file, sizeof(conf->events_file)},
+        {"events_rotate_size", PT_SIZE, PFLG_POSITIVE,
+            &conf->events_rotate_size, 0},
             /* TODO add cfg flag: clean if not found */
         {"stats_interval", PT_DURATION, PFLG_POSITIVE | PFLG_NOT_NULL,
             &conf->stats_interval, 0},
@@ -1116,6 +1856,10 @@ static int log_cfg_read(config_file_t config, void *module_config, char *msg_out
         {"alert_show_attrs", PT_BOOL,    0, &conf->alert_show_attrs, 0},
         {"log_procname",     PT_BOOL,    0, &conf->log_process, 0},
         {"log_hostname",     PT_BOOL,    0, &conf->log_host, 0},
+        {"async_logging",    PT_BOOL,    0, &conf->async_logging, 0},
+        {"async_buffer_size", PT_SIZE,   PFLG_POSITIVE | PFLG_NOT_NULL,
+            &conf->async_buffer_size, 0},
+        {"async_block_ms",   PT_INT,     PFLG_POSITIVE, &conf->async_block_ms, 0},
 
         {NULL, 0, 0, NULL, 0}
     };
@@ -1168,6 +1912,34 @@ static int log_cfg_read(config_file_t config, void *module_config, char *msg_out
         }
     }
 
+    if ( !strcasecmp( conf->events_file, "syslog" )
+         || !strcasecmp( conf->events_file, "stderr" ) )
+    {
+        sprintf( msg_out, RBH_LOG_CONFIG_BLOCK "::events_file: "
+                 "binary events can only be written to a file or stdout" );
+        return EINVAL;
+    }
+
+    rc = GetStringParam( log_block, RBH_LOG_CONFIG_BLOCK, "async_overflow",
+                         PFLG_NO_WILDCARDS, tmpstr, 1024, NULL, NULL, msg_out );
+    if ( ( rc != 0 ) && ( rc != ENOENT ) )
+        return rc;
+    else if ( rc == 0 )
+    {
+        if ( !strcasecmp( tmpstr, "drop" ) )
+            conf->async_drop = true;
+        else if ( !strcasecmp( tmpstr, "block" ) )
+            conf->async_drop = false;
+        else
+        {
+            sprintf( msg_out,
+                     "Invalid value for " RBH_LOG_CONFIG_BLOCK
+                     "::async_overflow: '%s'. 'block' or 'drop' expected",
+                     tmpstr );
+            return EINVAL;
+        }
+    }
+
     CheckUnknownParameters( log_block, RBH_LOG_CONFIG_BLOCK, allowed_params );
 
     return 0;
@@ -1235,6 +2007,19 @@ static int log_cfg_reload(log_config_t *conf)
     }
 #endif
 
+    if ( strcmp( conf->events_file, log_config.events_file ) )
+        DisplayLog( LVL_MAJOR, "LogConfig",
+                    RBH_LOG_CONFIG_BLOCK
+                    "::events_file changed in config file, but cannot be modified dynamically" );
+
+    if ( conf->events_rotate_size != log_config.events_rotate_size )
+    {
+        DisplayLog( LVL_MAJOR, "LogConfig",
+                    RBH_LOG_CONFIG_BLOCK "::events_rotate_size modified: '%llu'->'%llu'",
+                    log_config.events_rotate_size, conf->events_rotate_size );
+        log_config.events_rotate_size = conf->events_rotate_size;
+    }
+
     if ( conf->stats_interval != log_config.stats_interval )
     {
         DisplayLog( LVL_MAJOR, "LogConfig",
@@ -1279,6 +2064,37 @@ static int log_cfg_reload(log_config_t *conf)
         log_config.log_host = conf->log_host;
     }
 
+    if (conf->async_logging != log_config.async_logging)
+        DisplayLog(LVL_MAJOR, "LogConfig",
+                   RBH_LOG_CONFIG_BLOCK "::async_logging changed in config file, "
+                   "but cannot be modified dynamically");
+
+    if (conf->async_buffer_size != log_config.async_buffer_size)
+    {
+        DisplayLog(LVL_MAJOR, "LogConfig",
+                   RBH_LOG_CONFIG_BLOCK "::async_buffer_size modified: "
+                   "'%llu'->'%llu' (applies to new threads)",
+                   log_config.async_buffer_size, conf->async_buffer_size);
+        log_config.async_buffer_size = conf->async_buffer_size;
+    }
+
+    if (conf->async_drop != log_config.async_drop)
+    {
+        DisplayLog(LVL_MAJOR, "LogConfig",
+                   RBH_LOG_CONFIG_BLOCK "::async_overflow modified: '%s'->'%s'",
+                   log_config.async_drop ? "drop" : "block",
+                   conf->async_drop ? "drop" : "block");
+        log_config.async_drop = conf->async_drop;
+    }
+
+    if (conf->async_block_ms != log_config.async_block_ms)
+    {
+        DisplayLog(LVL_MAJOR, "LogConfig",
+                   RBH_LOG_CONFIG_BLOCK "::async_block_ms modified: '%d'->'%d'",
+                   log_config.async_block_ms, conf->async_block_ms);
+        log_config.async_block_ms = conf->async_block_ms;
+    }
+
     rbh_adjust_log_level_external();
     return 0;
 }
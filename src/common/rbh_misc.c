@@ -435,11 +435,7 @@ notfound:
 
 char *uid2str(uid_t uid, char *username)
 {
-    const struct passwd *p = GetPwUid(uid);
-
-    if (p != NULL)
-        snprintf(username, RBH_LOGIN_MAX, "%s", p->pw_name);
-    else
+    if (GetPwName(uid, username, RBH_LOGIN_MAX) == NULL)
         snprintf(username, RBH_LOGIN_MAX, "%d", (int)uid);
 
     return username;
@@ -447,11 +443,7 @@ char *uid2str(uid_t uid, char *username)
 
 char *gid2str(gid_t gid, char *groupname)
 {
-    const struct group *g = GetGrGid(gid);
-
-    if (g != NULL)
-        snprintf(groupname, RBH_LOGIN_MAX, "%s",  g->gr_name);
-    else
+    if (GetGrName(gid, groupname, RBH_LOGIN_MAX) == NULL)
         snprintf(groupname, RBH_LOGIN_MAX, "%d", (int)gid);
 
     return groupname;
@@ -212,3 +212,31 @@ int rbh_params_copy(struct rbh_params *tgt, const struct rbh_params *src)
 {
     return rbh_params_foreach(src, add_cb, tgt);
 }
+
+/** helper callback to check a parameter has the same value in another set */
+static int cmp_cb(const char *key, const char *val, void *udata)
+{
+    const char *other = rbh_param_get((const struct rbh_params *)udata, key);
+
+    if (other == NULL || strcmp(val, other) != 0)
+        return 1;
+    return 0;
+}
+
+static inline unsigned int param_count(const struct rbh_params *params)
+{
+    if (params == NULL || params->param_set == NULL)
+        return 0;
+    return g_hash_table_size(params->param_set);
+}
+
+bool rbh_params_equal(const struct rbh_params *p1, const struct rbh_params *p2)
+{
+    if (param_count(p1) != param_count(p2))
+        return false;
+
+    if (param_count(p1) == 0)
+        return true;
+
+    return rbh_params_foreach(p1, cmp_cb, (void *)p2) == 0;
+}
@@ -0,0 +1,798 @@
+/* -*- mode: c; c-basic-offset: 4; indent-tabs-mode: nil; -*-
+ * vim:expandtab:shiftwidth=4:tabstop=4:
+ */
+/*
+ * Copyright (C) 2016 CEA/DAM
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the CeCILL License.
+ *
+ * The fact that you are presently reading this means that you have had
+ * knowledge of the CeCILL license (http://www.cecill.info) and that you
+ * accept its terms.
+ */
+
+/**
+ * Read/write column-oriented snapshot files (see rbh_snapshot.h).
+ */
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include "rbh_snapshot.h"
+#include "rbh_logs.h"
+#include "rbh_misc.h"
+#include "Memory.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <inttypes.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <fnmatch.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <zlib.h>
+
+#define SNAP_TAG "Snapshot"
+
+/** round up to a multiple of 8 bytes */
+#define ALIGN8(_s) (((_s) + 7) & ~((uint64_t)7))
+
+/** size of the validity bitmap for the given row count */
+#define BITMAP_SIZE(_n) ALIGN8(((_n) + 7) / 8)
+
+/* ------------------------- writer ------------------------- */
+
+/** buffered values of a column for the current row group */
+struct snap_col_buf {
+    snap_col_type_e type;
+    uint8_t        *valid;
+    int64_t        *ints;
+    uint64_t       *offsets;
+    char           *data;
+    size_t          data_len;
+    size_t          data_size;
+};
+
+struct snap_writer {
+    int                  fd;
+    char                *path;
+    char                *tmp_path;
+    unsigned int         col_count;
+    unsigned int         group_rows;
+    bool                 compress;
+    struct snap_col_buf *cols;
+
+    uint64_t             rows;       /**< rows in the current group */
+    uint64_t             total_rows;
+    uint64_t             offset;     /**< current offset in file */
+
+    uint64_t            *index;      /**< offsets of group headers */
+    uint64_t             group_count;
+    uint64_t             index_size;
+};
+
+static int snap_write(snap_writer_t *w, const void *buf, size_t len)
+{
+    const char *ptr = buf;
+
+    while (len > 0)
+    {
+        ssize_t sz = write(w->fd, ptr, len);
+
+        if (sz < 0)
+        {
+            if (errno == EINTR)
+                continue;
+            return errno;
+        }
+        ptr += sz;
+        len -= sz;
+        w->offset += sz;
+    }
+    return 0;
+}
+
+/** pad the file to a 8-byte aligned offset */
+static int snap_pad(snap_writer_t *w)
+{
+    static const char zero[8] = {0};
+
+    if (w->offset % 8 == 0)
+        return 0;
+
+    return snap_write(w, zero, 8 - (w->offset % 8));
+}
+
+static void snap_free_cols(snap_writer_t *w)
+{
+    int i;
+
+    for (i = 0; i < w->col_count; i++)
+    {
+        MemFree(w->cols[i].valid);
+        if (w->cols[i].ints != NULL)
+            MemFree(w->cols[i].ints);
+        if (w->cols[i].offsets != NULL)
+            MemFree(w->cols[i].offsets);
+        if (w->cols[i].data != NULL)
+            MemFree(w->cols[i].data);
+    }
+    MemFree(w->cols);
+}
+
+snap_writer_t *snap_writer_create(const char *path, unsigned int col_count,
+                                  const char **col_names,
+                                  const snap_col_type_e *col_types,
+                                  unsigned int group_rows, bool compress,
+                                  int *err)
+{
+    snap_writer_t      *w;
+    struct snap_header  hdr;
+    int                 i;
+
+    w = MemCalloc(1, sizeof(*w));
+    if (w == NULL)
+    {
+        *err = ENOMEM;
+        return NULL;
+    }
+
+    w->col_count = col_count;
+    w->group_rows = (group_rows > 0) ? group_rows : SNAP_DEFAULT_GROUP_ROWS;
+    w->compress = compress;
+    w->fd = -1;
+
+    w->path = strdup(path);
+    if (w->path == NULL || asprintf(&w->tmp_path, "%s.tmp", path) < 0)
+    {
+        *err = ENOMEM;
+        w->tmp_path = NULL;
+        goto free_w;
+    }
+
+    w->cols = MemCalloc(col_count, sizeof(*w->cols));
+    if (w->cols == NULL)
+    {
+        *err = ENOMEM;
+        goto free_w;
+    }
+
+    for (i = 0; i < col_count; i++)
+    {
+        struct snap_col_buf *col = &w->cols[i];
+
+        col->type = col_types[i];
+        col->valid = MemCalloc(BITMAP_SIZE(w->group_rows), 1);
+        if (col->type == SNAP_COL_INT64)
+            col->ints = MemCalloc(w->group_rows, sizeof(int64_t));
+        else
+        {
+            col->offsets = MemCalloc(w->group_rows + 1, sizeof(uint64_t));
+            col->data_size = 4096;
+            col->data = MemAlloc(col->data_size);
+        }
+
+        if (col->valid == NULL || (col->ints == NULL && col->offsets == NULL)
+            || (col->type == SNAP_COL_STR && col->data == NULL))
+        {
+            *err = ENOMEM;
+            goto free_cols;
+        }
+    }
+
+    w->fd = open(w->tmp_path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (w->fd < 0)
+    {
+        *err = errno;
+        DisplayLog(LVL_CRIT, SNAP_TAG, "Failed to create '%s': %s",
+                   w->tmp_path, strerror(*err));
+        goto free_cols;
+    }
+
+    /* write header and column definitions */
+    memset(&hdr, 0, sizeof(hdr));
+    memcpy(hdr.magic, SNAP_MAGIC, SNAP_MAGIC_LEN);
+    hdr.version = SNAP_VERSION;
+    hdr.col_count = col_count;
+    hdr.snap_time = time(NULL);
+
+    *err = snap_write(w, &hdr, sizeof(hdr));
+    for (i = 0; i < col_count && *err == 0; i++)
+    {
+        struct snap_col_def def;
+
+        memset(&def, 0, sizeof(def));
+        rh_strncpy(def.name, col_names[i], sizeof(def.name));
+        def.type = col_types[i];
+        *err = snap_write(w, &def, sizeof(def));
+    }
+    if (*err)
+    {
+        DisplayLog(LVL_CRIT, SNAP_TAG, "Failed to write to '%s': %s",
+                   w->tmp_path, strerror(*err));
+        close(w->fd);
+        unlink(w->tmp_path);
+        goto free_cols;
+    }
+
+    return w;
+
+free_cols:
+    snap_free_cols(w);
+free_w:
+    free(w->path);
+    free(w->tmp_path);
+    MemFree(w);
+    return NULL;
+}
+
+int snap_writer_set_int(snap_writer_t *w, unsigned int col, int64_t val)
+{
+    struct snap_col_buf *c;
+
+    if (col >= w->col_count || w->cols[col].type != SNAP_COL_INT64)
+        return EINVAL;
+    c = &w->cols[col];
+
+    c->ints[w->rows] = val;
+    c->valid[w->rows / 8] |= (1 << (w->rows % 8));
+    return 0;
+}
+
+int snap_writer_set_str(snap_writer_t *w, unsigned int col, const char *val)
+{
+    struct snap_col_buf *c;
+    size_t len = strlen(val);
+
+    if (col >= w->col_count || w->cols[col].type != SNAP_COL_STR)
+        return EINVAL;
+    c = &w->cols[col];
+
+    if (c->data_len + len > c->data_size)
+    {
+        size_t new_size = c->data_size;
+        char  *new_data;
+
+        while (c->data_len + len > new_size)
+            new_size *= 2;
+
+        new_data = MemRealloc(c->data, new_size);
+        if (new_data == NULL)
+            return ENOMEM;
+        c->data = new_data;
+        c->data_size = new_size;
+    }
+
+    memcpy(c->data + c->data_len, val, len);
+    c->data_len += len;
+    c->valid[w->rows / 8] |= (1 << (w->rows % 8));
+    return 0;
+}
+
+/** write a column chunk, compressing it if requested */
+static int snap_write_chunk(snap_writer_t *w, const struct snap_col_buf *c,
+                            struct snap_chunk *chunk)
+{
+    uint64_t  bm_size = BITMAP_SIZE(w->rows);
+    uint64_t  values_size;
+    char     *raw;
+    int       rc;
+
+    if (c->type == SNAP_COL_INT64)
+        values_size = w->rows * sizeof(int64_t);
+    else
+        values_size = (w->rows + 1) * sizeof(uint64_t) + c->data_len;
+
+    rc = snap_pad(w);
+    if (rc)
+        return rc;
+
+    memset(chunk, 0, sizeof(*chunk));
+    chunk->offset = w->offset;
+    chunk->raw_size = bm_size + values_size;
+
+    /* build contiguous raw data */
+    raw = MemAlloc(chunk->raw_size);
+    if (raw == NULL)
+        return ENOMEM;
+
+    memcpy(raw, c->valid, bm_size);
+    if (c->type == SNAP_COL_INT64)
+        memcpy(raw + bm_size, c->ints, values_size);
+    else
+    {
+        memcpy(raw + bm_size, c->offsets, (w->rows + 1) * sizeof(uint64_t));
+        memcpy(raw + bm_size + (w->rows + 1) * sizeof(uint64_t), c->data,
+               c->data_len);
+    }
+
+    if (w->compress)
+    {
+        uLongf  zlen = compressBound(chunk->raw_size);
+        Bytef  *zbuf = MemAlloc(zlen);
+
+        if (zbuf != NULL
+            && compress2(zbuf, &zlen, (Bytef *)raw, chunk->raw_size,
+                         Z_BEST_SPEED) == Z_OK
+            && zlen < chunk->raw_size)
+        {
+            chunk->compressed = 1;
+            chunk->stored_size = zlen;
+            rc = snap_write(w, zbuf, zlen);
+            MemFree(zbuf);
+            MemFree(raw);
+            return rc;
+        }
+        /* not compressible: store raw data */
+        if (zbuf != NULL)
+            MemFree(zbuf);
+    }
+
+    chunk->stored_size = chunk->raw_size;
+    rc = snap_write(w, raw, chunk->raw_size);
+    MemFree(raw);
+    return rc;
+}
+
+/** write the current row group */
+static int snap_flush_group(snap_writer_t *w)
+{
+    struct snap_group_header  ghdr;
+    struct snap_chunk        *chunks;
+    int                       i, rc = 0;
+
+    if (w->rows == 0)
+        return 0;
+
+    chunks = MemCalloc(w->col_count, sizeof(*chunks));
+    if (chunks == NULL)
+        return ENOMEM;
+
+    for (i = 0; i < w->col_count && rc == 0; i++)
+        rc = snap_write_chunk(w, &w->cols[i], &chunks[i]);
+    if (rc)
+        goto out;
+
+    /* grow group index if needed */
+    if (w->group_count == w->index_size)
+    {
+        uint64_t  new_size = w->index_size ? 2 * w->index_size : 64;
+        uint64_t *new_index = MemRealloc(w->index, new_size * sizeof(uint64_t));
+
+        if (new_index == NULL)
+        {
+            rc = ENOMEM;
+            goto out;
+        }
+        w->index = new_index;
+        w->index_size = new_size;
+    }
+
+    rc = snap_pad(w);
+    if (rc)
+        goto out;
+
+    w->index[w->group_count] = w->offset;
+    ghdr.row_count = w->rows;
+
+    rc = snap_write(w, &ghdr, sizeof(ghdr));
+    if (rc == 0)
+        rc = snap_write(w, chunks, w->col_count * sizeof(*chunks));
+    if (rc)
+        goto out;
+
+    w->group_count++;
+    w->total_rows += w->rows;
+
+    /* reset buffers */
+    for (i = 0; i < w->col_count; i++)
+    {
+        memset(w->cols[i].valid, 0, BITMAP_SIZE(w->group_rows));
+        w->cols[i].data_len = 0;
+    }
+    w->rows = 0;
+
+out:
+    MemFree(chunks);
+    return rc;
+}
+
+int snap_writer_end_row(snap_writer_t *w)
+{
+    int i;
+
+    for (i = 0; i < w->col_count; i++)
+    {
+        struct snap_col_buf *c = &w->cols[i];
+
+        if (c->type == SNAP_COL_STR)
+            c->offsets[w->rows + 1] = c->data_len;
+        else if (!(c->valid[w->rows / 8] & (1 << (w->rows % 8))))
+            c->ints[w->rows] = 0;
+    }
+    w->rows++;
+
+    if (w->rows == w->group_rows)
+        return snap_flush_group(w);
+
+    return 0;
+}
+
+int snap_writer_close(snap_writer_t *w, bool commit)
+{
+    struct snap_footer footer;
+    int                rc = 0;
+
+    if (!commit)
+        goto discard;
+
+    rc = snap_flush_group(w);
+    if (rc == 0)
+        rc = snap_pad(w);
+    if (rc)
+        goto discard;
+
+    memset(&footer, 0, sizeof(footer));
+    footer.index_offset = w->offset;
+    footer.group_count = w->group_count;
+    footer.row_count = w->total_rows;
+    memcpy(footer.magic, SNAP_MAGIC, SNAP_MAGIC_LEN);
+
+    if (w->group_count > 0)
+        rc = snap_write(w, w->index, w->group_count * sizeof(uint64_t));
+    if (rc == 0)
+        rc = snap_write(w, &footer, sizeof(footer));
+    if (rc == 0 && fsync(w->fd) != 0)
+        rc = errno;
+    if (rc)
+        goto discard;
+
+    if (close(w->fd) != 0)
+    {
+        rc = errno;
+        w->fd = -1;
+        goto discard;
+    }
+    w->fd = -1;
+
+    if (rename(w->tmp_path, w->path) != 0)
+    {
+        rc = errno;
+        goto discard;
+    }
+    goto free_w;
+
+discard:
+    if (rc)
+        DisplayLog(LVL_CRIT, SNAP_TAG, "Failed to write snapshot file '%s': %s",
+                   w->tmp_path, strerror(rc));
+    if (w->fd >= 0)
+        close(w->fd);
+    unlink(w->tmp_path);
+
+free_w:
+    snap_free_cols(w);
+    if (w->index != NULL)
+        MemFree(w->index);
+    free(w->path);
+    free(w->tmp_path);
+    MemFree(w);
+    return rc;
+}
+
+/* ------------------------- reader ------------------------- */
+
+struct snap_reader {
+    const uint8_t             *map;
+    size_t                     size;
+    const struct snap_header  *hdr;
+    const struct snap_col_def *cols;
+    const struct snap_footer  *footer;
+    const uint64_t            *index;
+};
+
+snap_reader_t *snap_reader_open(const char *path, int *err)
+{
+    snap_reader_t *r;
+    struct stat    st;
+    int            fd;
+    uint64_t       cols_end;
+
+    fd = open(path, O_RDONLY);
+    if (fd < 0)
+    {
+        *err = errno;
+        return NULL;
+    }
+
+    if (fstat(fd, &st) != 0)
+    {
+        *err = errno;
+        close(fd);
+        return NULL;
+    }
+
+    if (st.st_size < sizeof(struct snap_header) + sizeof(struct snap_footer))
+    {
+        *err = EINVAL;
+        close(fd);
+        return NULL;
+    }
+
+    r = MemCalloc(1, sizeof(*r));
+    if (r == NULL)
+    {
+        *err = ENOMEM;
+        close(fd);
+        return NULL;
+    }
+
+    r->size = st.st_size;
+    r->map = mmap(NULL, r->size, PROT_READ, MAP_SHARED, fd, 0);
+    /* the mapping remains valid after closing the file */
+    close(fd);
+    if (r->map == MAP_FAILED)
+    {
+        *err = errno;
+        MemFree(r);
+        return NULL;
+    }
+
+    r->hdr = (const struct snap_header *)r->map;
+    r->cols = (const struct snap_col_def *)(r->hdr + 1);
+    r->footer = (const struct snap_footer *)(r->map + r->size
+                                             - sizeof(struct snap_footer));
+    cols_end = sizeof(struct snap_header)
+               + (uint64_t)r->hdr->col_count * sizeof(struct snap_col_def);
+
+    if (memcmp(r->hdr->magic, SNAP_MAGIC, SNAP_MAGIC_LEN)
+        || memcmp(r->footer->magic, SNAP_MAGIC, SNAP_MAGIC_LEN)
+        || r->hdr->version != SNAP_VERSION
+        || cols_end > r->size
+        || r->footer->index_offset % sizeof(uint64_t) != 0
+        || r->footer->index_offset > r->size - sizeof(struct snap_footer)
+        || r->footer->group_count > (r->size - sizeof(struct snap_footer)
+                                     - r->footer->index_offset)
+                                    / sizeof(uint64_t))
+    {
+        DisplayLog(LVL_CRIT, SNAP_TAG, "'%s' is not a valid snapshot file",
+                   path);
+        *err = EINVAL;
+        snap_reader_close(r);
+        return NULL;
+    }
+
+    r->index = (const uint64_t *)(r->map + r->footer->index_offset);
+    return r;
+}
+
+void snap_reader_close(snap_reader_t *r)
+{
+    munmap((void *)r->map, r->size);
+    MemFree(r);
+}
+
+uint64_t snap_reader_row_count(const snap_reader_t *r)
+{
+    return r->footer->row_count;
+}
+
+uint64_t snap_reader_group_count(const snap_reader_t *r)
+{
+    return r->footer->group_count;
+}
+
+time_t snap_reader_time(const snap_reader_t *r)
+{
+    return r->hdr->snap_time;
+}
+
+int snap_reader_col_index(const snap_reader_t *r, const char *name)
+{
+    int i;
+
+    for (i = 0; i < r->hdr->col_count; i++)
+        if (strncmp(r->cols[i].name, name, SNAP_COL_NAME_LEN) == 0)
+            return i;
+    return -1;
+}
+
+/**
+ * Check that the contents of a column chunk are consistent with its size,
+ * so that values can be accessed without reading out of the chunk.
+ */
+static bool snap_chunk_check(snap_col_type_e type, uint64_t row_count,
+                             const uint8_t *base, uint64_t size)
+{
+    const uint64_t *offsets;
+    uint64_t        bm_size, data_size, i;
+
+    /* avoid overflows in the following computations */
+    if (row_count > size)
+        return false;
+
+    bm_size = BITMAP_SIZE(row_count);
+    if (bm_size > size)
+        return false;
+    size -= bm_size;
+
+    if (type == SNAP_COL_INT64)
+        return row_count <= size / sizeof(int64_t);
+
+    if (type != SNAP_COL_STR || row_count + 1 > size / sizeof(uint64_t))
+        return false;
+
+    /* string offsets must be ordered and within string data */
+    offsets = (const uint64_t *)(base + bm_size);
+    data_size = size - (row_count + 1) * sizeof(uint64_t);
+    for (i = 0; i < row_count; i++)
+        if (offsets[i] > offsets[i+1])
+            return false;
+
+    return offsets[row_count] <= data_size;
+}
+
+int snap_reader_load(snap_reader_t *r, uint64_t group, unsigned int col,
+                     snap_col_data_t *data)
+{
+    const struct snap_group_header *ghdr;
+    const struct snap_chunk        *chunk;
+    const uint8_t                  *base;
+    uint64_t                        bm_size, size;
+
+    memset(data, 0, sizeof(*data));
+
+    if (group >= r->footer->group_count || col >= r->hdr->col_count)
+        return EINVAL;
+
+    if (r->index[group] % sizeof(uint64_t) != 0
+        || r->index[group] > r->size
+        || sizeof(*ghdr) + (uint64_t)r->hdr->col_count * sizeof(*chunk)
+            > r->size - r->index[group])
+        return EINVAL;
+
+    ghdr = (const struct snap_group_header *)(r->map + r->index[group]);
+    chunk = (const struct snap_chunk *)(ghdr + 1) + col;
+
+    if (chunk->offset > r->size || chunk->stored_size > r->size - chunk->offset)
+        return EINVAL;
+
+    /* uncompressed values are accessed in place */
+    if (!chunk->compressed && (chunk->offset % sizeof(uint64_t) != 0
+                               || chunk->raw_size != chunk->stored_size))
+        return EINVAL;
+
+    if (chunk->compressed)
+    {
+        uLongf len = chunk->raw_size;
+
+        data->buffer = MemAlloc(chunk->raw_size);
+        if (data->buffer == NULL)
+            return ENOMEM;
+
+        if (uncompress(data->buffer, &len, r->map + chunk->offset,
+                       chunk->stored_size) != Z_OK || len != chunk->raw_size)
+        {
+            snap_col_data_release(data);
+            return EIO;
+        }
+        base = data->buffer;
+    }
+    else
+        base = r->map + chunk->offset;
+
+    size = chunk->raw_size;
+    if (!snap_chunk_check(r->cols[col].type, ghdr->row_count, base, size))
+    {
+        DisplayLog(LVL_MAJOR, SNAP_TAG, "Inconsistent chunk for column '%.*s' "
+                   "in row group %"PRIu64, SNAP_COL_NAME_LEN,
+                   r->cols[col].name, group);
+        snap_col_data_release(data);
+        return EINVAL;
+    }
+
+    data->type = r->cols[col].type;
+    data->row_count = ghdr->row_count;
+    bm_size = BITMAP_SIZE(data->row_count);
+    data->valid = base;
+
+    if (data->type == SNAP_COL_INT64)
+        data->int_values = (const int64_t *)(base + bm_size);
+    else
+    {
+        data->str_offsets = (const uint64_t *)(base + bm_size);
+        data->str_data = (const char *)(data->str_offsets
+                                        + data->row_count + 1);
+    }
+    return 0;
+}
+
+void snap_col_data_release(snap_col_data_t *data)
+{
+    if (data->buffer != NULL)
+        MemFree(data->buffer);
+    data->buffer = NULL;
+}
+
+/* ------------------------- filters ------------------------- */
+
+static inline void sel_clear(uint8_t *sel, uint64_t row)
+{
+    sel[row / 8] &= ~(1 << (row % 8));
+}
+
+static inline bool sel_test(const uint8_t *sel, uint64_t row)
+{
+    return (sel[row / 8] >> (row % 8)) & 1;
+}
+
+void snap_filter_int(const snap_col_data_t *data, snap_compar_e op,
+                     int64_t val, uint8_t *sel)
+{
+    uint64_t i;
+
+    for (i = 0; i < data->row_count; i++)
+    {
+        int64_t v = data->int_values[i];
+        bool    match;
+
+        if (!sel_test(sel, i))
+            continue;
+
+        if (!snap_is_valid(data, i))
+        {
+            sel_clear(sel, i);
+            continue;
+        }
+
+        switch (op)
+        {
+            case SNAP_EQ: match = (v == val); break;
+            case SNAP_NE: match = (v != val); break;
+            case SNAP_LT: match = (v < val); break;
+            case SNAP_LE: match = (v <= val); break;
+            case SNAP_GT: match = (v > val); break;
+            case SNAP_GE: match = (v >= val); break;
+            default:      match = false;
+        }
+        if (!match)
+            sel_clear(sel, i);
+    }
+}
+
+void snap_filter_str(const snap_col_data_t *data, const char *pattern,
+                     bool negate, uint8_t *sel)
+{
+    char     buff[RBH_PATH_MAX];
+    uint64_t i;
+
+    for (i = 0; i < data->row_count; i++)
+    {
+        uint64_t len;
+        bool     match;
+
+        if (!sel_test(sel, i))
+            continue;
+
+        if (!snap_is_valid(data, i))
+        {
+            sel_clear(sel, i);
+            continue;
+        }
+
+        /* values are not null-terminated */
+        len = data->str_offsets[i+1] - data->str_offsets[i];
+        if (len >= sizeof(buff))
+            len = sizeof(buff) - 1;
+        memcpy(buff, data->str_data + data->str_offsets[i], len);
+        buff[len] = '\0';
+
+        match = (fnmatch(pattern, buff, 0) == 0);
+        if (match == negate)
+            sel_clear(sel, i);
+    }
+}
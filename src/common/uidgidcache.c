@@ -37,7 +37,12 @@
 #   include <string.h>
 #endif
 
+#include <errno.h>
+#include <pthread.h>
+#include <stdint.h>
 #include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
 #include <unistd.h>
 
 #include <glib.h>
@@ -52,264 +57,650 @@ size_t group_memb_sz;
 
 #define LOGTAG  "UidGidCache"
 
+/** number of shards of each cache */
+#define UG_SHARD_BITS   6
+#define UG_SHARDS       (1 << UG_SHARD_BITS)
+
+/** maximum number of threads resolving ids for a prefetch */
+#define UG_PREFETCH_THREADS 8
+/** minimum number of ids to be resolved by each prefetch thread */
+#define UG_PREFETCH_MIN     16
+
+/** bounds of the delay between 2 passes of the refresh thread (sec) */
+#define UG_REFRESH_MIN  1
+#define UG_REFRESH_MAX  60
+
+/** delay before a name replaced by a refresh is freed (sec) */
+#define UG_RETIRE_DELAY 300
+
+/* time-to-live of cached entries (0 = never expire) */
+static time_t ug_ttl = UG_DEFAULT_TTL;
+static time_t ug_neg_ttl = UG_DEFAULT_NEG_TTL;
+
 /* -------------- cache and hashtables management ------------ */
 
-typedef struct pw_cacheent__
-{
-    struct passwd  pw;
-} pw_cacheent_t;
+typedef enum {
+    UG_USER = 0,
+    UG_GROUP = 1,
+} ug_kind_t;
 
-typedef struct gr_cacheent__
+typedef struct ug_cacheent__
 {
-    struct group  gr;
-} gr_cacheent_t;
-
-/* cache of PW entries */
-static struct
+    union {
+        struct passwd pw;
+        struct group  gr;
+    };
+    /** last time the entry was resolved */
+    time_t        fetch_time;
+    /** the id is unknown to the system */
+    bool          negative;
+} ug_cacheent_t;
+
+/* each cache is split into shards with their own lock,
+ * so that concurrent lookups of different ids don't contend */
+typedef struct ug_shard__
 {
     rw_lock_t   lock;
     GHashTable *cache;
-} pw_hash;
+} ug_shard_t;
 
-/* cache of group entries */
-static struct
-{
-    rw_lock_t   lock;
-    GHashTable *cache;
-} gr_hash;
+static ug_shard_t ug_cache[2][UG_SHARDS];
 
 /* stats about the cache */
 unsigned int pw_nb_set = 0;
 unsigned int pw_nb_get = 0;
+unsigned int pw_nb_neg = 0;
 unsigned int gr_nb_set = 0;
 unsigned int gr_nb_get = 0;
+unsigned int gr_nb_neg = 0;
 
-/* ------------ exported functions ------------ */
+static inline ug_shard_t *ug_shard(ug_kind_t kind, unsigned int id)
+{
+    /* spread consecutive ids over shards */
+    return &ug_cache[kind][(uint32_t)(id * 2654435761U) >> (32 - UG_SHARD_BITS)];
+}
 
+static inline char **ug_name(ug_kind_t kind, ug_cacheent_t *ent)
+{
+    return kind == UG_USER ? &ent->pw.pw_name : &ent->gr.gr_name;
+}
 
-/* Initialization of pwent and grent caches */
-int InitUidGid_Cache(void)
+static inline void ug_count(ug_kind_t kind, bool hit, bool negative)
 {
-    long res;
+    if (hit)
+        (*(kind == UG_USER ? &pw_nb_get : &gr_nb_get))++;
+    else if (negative)
+        (*(kind == UG_USER ? &pw_nb_neg : &gr_nb_neg))++;
+    else
+        (*(kind == UG_USER ? &pw_nb_set : &gr_nb_set))++;
+}
 
-    /* initialize locks on hash table slots */
-    rw_lock_init(&pw_hash.lock);
-    pw_hash.cache = g_hash_table_new(NULL, NULL);
+/**
+ * Ask the system for the name of a user or a group.
+ * @param[out] name allocated name (to be freed by the caller).
+ * @return 0 on success, ENOENT if the id is unknown, another error code else.
+ */
+static int ug_resolve(ug_kind_t kind, unsigned int id, char **name)
+{
+    struct passwd  pw;
+    struct passwd *pw_res;
+    struct group   gr;
+    struct group  *gr_res;
+    char          *buffer;
+    size_t         buf_size;
+    void          *found;
+    int            rc;
 
-    rw_lock_init(&gr_hash.lock);
-    gr_hash.cache = g_hash_table_new(NULL, NULL);
+    buf_size = (kind == UG_USER) ? alt_groups_sz : group_memb_sz;
+    buffer = malloc(buf_size);
+    if (buffer == NULL)
+        return ENOMEM;
 
-    /* Try to size the memory needed to get the strings for getpwuid_r
-     * and getgrgid_r. */
-    res = sysconf(_SC_GETPW_R_SIZE_MAX);
-    if (res == -1 || res > 4096)
-        alt_groups_sz = 4096;
+retry:
+    if (kind == UG_USER)
+    {
+        rc = getpwuid_r(id, &pw, buffer, buf_size, &pw_res);
+        found = pw_res;
+    }
     else
-        alt_groups_sz = res;
+    {
+        rc = getgrgid_r(id, &gr, buffer, buf_size, &gr_res);
+        found = gr_res;
+    }
 
-    res = sysconf(_SC_GETGR_R_SIZE_MAX);
-    if (res == -1 || res > 4096)
-        group_memb_sz = 4096;
-    else
-        group_memb_sz = res;
+    if (rc != 0 || found == NULL)
+    {
+        /* try with larger buff */
+        if (rc == ERANGE)
+        {
+            char *newbuf;
+
+            buf_size *= 2;
+            DisplayLog(LVL_FULL, LOGTAG,
+                       "got ERANGE error from %s: trying with buf_size=%zu",
+                       kind == UG_USER ? "getpwuid_r" : "getgrgid_r",
+                       buf_size);
+            newbuf = realloc(buffer, buf_size);
+            if (newbuf == NULL)
+            {
+                free(buffer);
+                return ENOMEM;
+            }
+            buffer = newbuf;
+            goto retry;
+        }
 
-    return 0;
+        free(buffer);
+
+        /* id not found */
+        if (rc == 0 || rc == ENOENT || rc == ESRCH || rc == EBADF
+            || rc == EPERM)
+            return ENOENT;
+
+        DisplayLog(LVL_CRIT, LOGTAG, "ERROR %d in %s: %s", rc,
+                   kind == UG_USER ? "getpwuid_r" : "getgrgid_r",
+                   strerror(rc));
+        return rc;
+    }
+
+    /* We only care about the name */
+    *name = strdup(kind == UG_USER ? pw.pw_name : gr.gr_name);
+    free(buffer);
+
+    return (*name == NULL) ? ENOMEM : 0;
 }
 
-/* get user name for the given uid */
-const struct passwd *GetPwUid(uid_t owner)
+/* ------------ background refresh ------------ */
+
+static pthread_mutex_t ug_refresh_lock = PTHREAD_MUTEX_INITIALIZER;
+static bool            ug_refresh_started = false;
+
+/** name replaced by a refresh, waiting to be freed */
+typedef struct ug_retired__
 {
-    struct passwd *result;
-    pw_cacheent_t *p_pwcacheent;
-    pw_cacheent_t *entry2;
-    int            rc;
-    char           *buffer;
-    int            buf_size;
+    struct ug_retired__ *next;
+    time_t               time;
+    char                *name;
+} ug_retired_t;
+
+/* FIFO of retired names (only accessed by the refresh thread) */
+static ug_retired_t  *ug_retired_first = NULL;
+static ug_retired_t **ug_retired_last = &ug_retired_first;
+
+/** keep a replaced name until callers of GetPwUid()/GetGrGid()
+ * are done with it */
+static void ug_retire(char *name, time_t now)
+{
+    ug_retired_t *r;
 
-    /* is the entry in the cache? */
-    P_r(&pw_hash.lock);
-    p_pwcacheent = g_hash_table_lookup(pw_hash.cache, (void *)(uintptr_t)owner);
-    V_r(&pw_hash.lock);
+    if (name == NULL)
+        return;
 
-    if (p_pwcacheent)
-        pw_nb_get++;
+    r = malloc(sizeof(*r));
+    if (r == NULL)
+    {
+        /* rather leak it than free it too early */
+        DisplayLog(LVL_MAJOR, LOGTAG, "Cannot allocate memory to retire "
+                   "name '%s'", name);
+        return;
+    }
+    r->next = NULL;
+    r->time = now;
+    r->name = name;
+    *ug_retired_last = r;
+    ug_retired_last = &r->next;
+}
 
-    /* if no, allocate a pw cache entry
-     * and ask the system to fill it */
-    if (p_pwcacheent == NULL)
+/** free names retired for more than UG_RETIRE_DELAY */
+static void ug_retired_free(time_t now)
+{
+    while (ug_retired_first != NULL
+           && now - ug_retired_first->time >= UG_RETIRE_DELAY)
     {
-        /* entry allocation */
-        p_pwcacheent = calloc(1, sizeof(pw_cacheent_t));
-        if (p_pwcacheent == NULL)
-            return NULL;
+        ug_retired_t *r = ug_retired_first;
 
-        buf_size = alt_groups_sz;
-        buffer = malloc(buf_size);
-        if (buffer == NULL)
-            goto out_free;
+        ug_retired_first = r->next;
+        if (ug_retired_first == NULL)
+            ug_retired_last = &ug_retired_first;
 
-retry:
-        rc = getpwuid_r(owner, &p_pwcacheent->pw, buffer, buf_size, &result);
-        if (rc != 0 || result == NULL)
+        free(r->name);
+        free(r);
+    }
+}
+
+static bool ug_expired(const ug_cacheent_t *ent, time_t now)
+{
+    time_t ttl = ent->negative ? ug_neg_ttl : ug_ttl;
+
+    return ttl != 0 && now - ent->fetch_time >= ttl;
+}
+
+/** delay between 2 passes of the refresh thread */
+static unsigned int ug_refresh_period(void)
+{
+    time_t period = UG_REFRESH_MAX;
+
+    if (ug_ttl != 0 && ug_ttl / 2 < period)
+        period = ug_ttl / 2;
+    if (ug_neg_ttl != 0 && ug_neg_ttl / 2 < period)
+        period = ug_neg_ttl / 2;
+    if (period < UG_REFRESH_MIN)
+        period = UG_REFRESH_MIN;
+
+    return period;
+}
+
+/**
+ * Resolve again the expired entries of a shard.
+ * The system is queried without holding the shard lock.
+ * A replaced name is only freed after UG_RETIRE_DELAY, as it may still
+ * be referenced by callers of GetPwUid()/GetGrGid().
+ */
+static void ug_refresh_shard(ug_kind_t kind, ug_shard_t *shard, time_t now)
+{
+    GHashTableIter iter;
+    gpointer       key, value;
+    GArray        *expired;
+    unsigned int   i;
+
+    expired = g_array_new(FALSE, FALSE, sizeof(unsigned int));
+
+    P_r(&shard->lock);
+    g_hash_table_iter_init(&iter, shard->cache);
+    while (g_hash_table_iter_next(&iter, &key, &value))
+    {
+        if (ug_expired(value, now))
         {
-            /* try with larger buff */
-            if (rc == ERANGE)
-            {
-                buf_size *= 2;
-                DisplayLog(LVL_FULL, LOGTAG,
-                           "got ERANGE error from getpwuid_r: trying with buf_size=%u",
-                           buf_size );
-                buffer = realloc(buffer, buf_size);
-                if (buffer == NULL)
-                    goto out_free;
-                else
-                    goto retry;
-            }
-            if (rc != 0 && rc != ENOENT && rc != ESRCH &&
-                rc != EBADF && rc != EPERM)
-                DisplayLog(LVL_CRIT, LOGTAG, "ERROR %d in getpwuid_r: %s",
-                           rc, strerror(rc));
-            goto out_free;
+            unsigned int id = (uintptr_t)key;
+
+            g_array_append_val(expired, id);
         }
+    }
+    V_r(&shard->lock);
 
-        /* We only care about the name */
-        p_pwcacheent->pw.pw_name = strdup(p_pwcacheent->pw.pw_name);
-        if (p_pwcacheent->pw.pw_name == NULL)
-            goto out_free;
+    for (i = 0; i < expired->len; i++)
+    {
+        unsigned int   id = g_array_index(expired, unsigned int, i);
+        ug_cacheent_t *ent;
+        char          *name = NULL;
+        char         **p_name;
+        int            rc;
 
-        p_pwcacheent->pw.pw_passwd = NULL;
-        p_pwcacheent->pw.pw_gecos = NULL;
-        p_pwcacheent->pw.pw_dir = NULL;
-        p_pwcacheent->pw.pw_shell = NULL;
+        rc = ug_resolve(kind, id, &name);
 
-        free(buffer);
+        P_w(&shard->lock);
+        ent = g_hash_table_lookup(shard->cache, (void *)(uintptr_t)id);
+        if (ent != NULL)
+        {
+            p_name = ug_name(kind, ent);
+
+            if (rc == 0)
+            {
+                if (ent->negative || *p_name == NULL
+                    || strcmp(*p_name, name) != 0)
+                {
+                    DisplayLog(LVL_FULL, LOGTAG, "%s %u resolved to '%s'",
+                               kind == UG_USER ? "uid" : "gid", id, name);
+                    ug_retire(*p_name, now);
+                    /* readers of GetPwUid()/GetGrGid() don't take the lock */
+                    __atomic_store_n(p_name, name, __ATOMIC_RELEASE);
+                    name = NULL;
+                }
+                ent->negative = false;
+            }
+            else if (rc == ENOENT)
+                ent->negative = true;
+            /* on other errors, keep the previous value until next expiry */
 
-        /* insert it to hash table */
-        P_w(&pw_hash.lock);
-
-        /* Another thread may have inserted it in the meantime. Check
-         * again. */
-        entry2 = g_hash_table_lookup(pw_hash.cache, (void *)(uintptr_t)owner);
-        if (entry2) {
-            free(p_pwcacheent->pw.pw_name);
-            free(p_pwcacheent);
-            p_pwcacheent = entry2;
-            pw_nb_get++;
-        } else {
-            g_hash_table_insert(pw_hash.cache,
-                                (void *)(uintptr_t)p_pwcacheent->pw.pw_uid,
-                                p_pwcacheent);
-            pw_nb_set++;
+            ent->fetch_time = now;
         }
-        V_w(&pw_hash.lock);
+        V_w(&shard->lock);
+
+        free(name);
     }
 
-    return &p_pwcacheent->pw;
+    g_array_free(expired, TRUE);
+}
 
-out_free:
-    if (p_pwcacheent != NULL)
+static void *ug_refresh_thr(void *arg)
+{
+    for (;;)
     {
-        free(buffer);
-        free(p_pwcacheent);
+        ug_kind_t    kind;
+        unsigned int i;
+        time_t       now;
+
+        sleep(ug_refresh_period());
+
+        now = time(NULL);
+        for (kind = UG_USER; kind <= UG_GROUP; kind++)
+            for (i = 0; i < UG_SHARDS; i++)
+                ug_refresh_shard(kind, &ug_cache[kind][i], now);
+
+        ug_retired_free(now);
     }
     return NULL;
 }
 
-const struct group *GetGrGid(gid_t grid)
+/** Start the refresh thread at the first insertion in the cache
+ * (after the process possibly daemonized). */
+static void ug_start_refresh(void)
+{
+    pthread_attr_t attr;
+    pthread_t      thread;
+    int            rc;
+
+    if (ug_refresh_started)
+        return;
+
+    P(ug_refresh_lock);
+    if (!ug_refresh_started)
+    {
+        pthread_attr_init(&attr);
+        pthread_attr_setdetachstate(&attr, PTHREAD_CREATE_DETACHED);
+        rc = pthread_create(&thread, &attr, ug_refresh_thr, NULL);
+        if (rc)
+            DisplayLog(LVL_MAJOR, LOGTAG, "ERROR %d creating cache refresh "
+                       "thread: %s", rc, strerror(rc));
+        pthread_attr_destroy(&attr);
+        /* don't retry on error: cached entries just won't be refreshed */
+        ug_refresh_started = true;
+    }
+    V(ug_refresh_lock);
+}
+
+/** the refresh thread doesn't survive a fork: restart it in the child */
+static void ug_atfork_child(void)
+{
+    pthread_mutex_init(&ug_refresh_lock, NULL);
+    ug_refresh_started = false;
+}
+
+/* ------------ lookups ------------ */
+
+/**
+ * Get the cache entry for an id, resolving it if it is not cached.
+ * @return the entry, or NULL if the id is unknown.
+ */
+static ug_cacheent_t *ug_get(ug_kind_t kind, unsigned int id)
 {
-    struct group  *result;
-    gr_cacheent_t *p_grcacheent;
-    gr_cacheent_t *entry2;
+    ug_shard_t    *shard = ug_shard(kind, id);
+    ug_cacheent_t *ent;
+    ug_cacheent_t *entry2;
+    char          *name = NULL;
+    bool           negative;
     int            rc;
-    char           *buffer;
-    int            buf_size;
 
     /* is the entry in the cache? */
-    P_r(&gr_hash.lock);
-    p_grcacheent = g_hash_table_lookup(gr_hash.cache, (void *)(uintptr_t)grid);
-    V_r(&gr_hash.lock);
+    P_r(&shard->lock);
+    ent = g_hash_table_lookup(shard->cache, (void *)(uintptr_t)id);
+    negative = (ent != NULL && ent->negative);
+    V_r(&shard->lock);
 
-    if (p_grcacheent)
-        gr_nb_get++;
+    if (ent != NULL)
+    {
+        ug_count(kind, true, negative);
+        return negative ? NULL : ent;
+    }
+
+    /* if no, ask the system */
+    rc = ug_resolve(kind, id, &name);
+    if (rc != 0 && rc != ENOENT)
+        /* don't cache transient errors */
+        return NULL;
 
-    /* if no, allocate a gr cache entry
-     * and ask the system to fill it */
-    if (p_grcacheent == NULL)
+    ent = calloc(1, sizeof(*ent));
+    if (ent == NULL)
     {
-        /* entry allocation */
-        p_grcacheent = calloc(1, sizeof(gr_cacheent_t));
-        if (p_grcacheent == NULL)
-            return NULL;
+        free(name);
+        return NULL;
+    }
 
-        buf_size = group_memb_sz;
-        buffer = malloc(buf_size);
-        if (buffer == NULL)
-            goto out_free;
+    if (kind == UG_USER)
+        ent->pw.pw_uid = id;
+    else
+        ent->gr.gr_gid = id;
+    *ug_name(kind, ent) = name;
+    ent->negative = (rc == ENOENT);
+    ent->fetch_time = time(NULL);
+
+    /* insert it to hash table */
+    P_w(&shard->lock);
+
+    /* Another thread may have inserted it in the meantime. Check
+     * again. */
+    entry2 = g_hash_table_lookup(shard->cache, (void *)(uintptr_t)id);
+    if (entry2)
+    {
+        free(name);
+        free(ent);
+        ent = entry2;
+        ug_count(kind, true, ent->negative);
+    }
+    else
+    {
+        g_hash_table_insert(shard->cache, (void *)(uintptr_t)id, ent);
+        ug_count(kind, false, ent->negative);
+    }
+    negative = ent->negative;
+    V_w(&shard->lock);
 
-retry:
-        rc = getgrgid_r(grid, &p_grcacheent->gr, buffer, buf_size, &result);
-        if (rc != 0 || result == NULL)
-        {
-            /* try with larger buff */
-            if (rc == ERANGE)
-            {
-                buf_size *= 2;
-                DisplayLog(LVL_FULL, LOGTAG,
-                           "got ERANGE error from getgrgid_r: trying with buf_size=%u",
-                           buf_size);
-                buffer = realloc(buffer, buf_size);
-                if ( buffer == NULL )
-                    goto out_free;
-                else
-                    goto retry;
-            }
+    ug_start_refresh();
 
-            if (rc != 0 && rc != ENOENT && rc != ESRCH &&
-                rc != EBADF && rc != EPERM)
-                DisplayLog(LVL_CRIT, LOGTAG, "ERROR %d in getgrgid_r : %s",
-                           rc, strerror(rc));
+    return negative ? NULL : ent;
+}
 
-            /* gid not found */
-            goto out_free;
-        }
+/** check if an id is in the cache (positive or negative entry) */
+static bool ug_cached(ug_kind_t kind, unsigned int id)
+{
+    ug_shard_t *shard = ug_shard(kind, id);
+    bool        found;
 
-        /* We only care about the name */
-        p_grcacheent->gr.gr_name = strdup(p_grcacheent->gr.gr_name);
-        if (p_grcacheent->gr.gr_name == NULL)
-            goto out_free;
+    P_r(&shard->lock);
+    found = (g_hash_table_lookup(shard->cache, (void *)(uintptr_t)id) != NULL);
+    V_r(&shard->lock);
 
-        p_grcacheent->gr.gr_passwd = NULL;
-        p_grcacheent->gr.gr_mem = NULL;
+    return found;
+}
+
+/* ------------ exported functions ------------ */
 
-        free(buffer);
 
-        /* insert it to hash table */
-        P_w(&gr_hash.lock);
-
-        /* Another thread may have inserted it in the meantime. Check
-         * again. */
-        entry2 = g_hash_table_lookup(gr_hash.cache, (void *)(uintptr_t)grid);
-        if (entry2) {
-            free(p_grcacheent->gr.gr_name);
-            free(p_grcacheent);
-            p_grcacheent = entry2;
-            gr_nb_get++;
-        } else {
-            g_hash_table_insert(gr_hash.cache,
-                                (void *)(uintptr_t)p_grcacheent->gr.gr_gid,
-                                p_grcacheent);
-            gr_nb_set++;
+/* Initialization of pwent and grent caches */
+int InitUidGid_Cache(void)
+{
+    ug_kind_t kind;
+    long      res;
+    int       i;
+
+    /* initialize locks on hash table shards */
+    for (kind = UG_USER; kind <= UG_GROUP; kind++)
+    {
+        for (i = 0; i < UG_SHARDS; i++)
+        {
+            rw_lock_init(&ug_cache[kind][i].lock);
+            ug_cache[kind][i].cache = g_hash_table_new(NULL, NULL);
         }
-        V_w(&gr_hash.lock);
     }
 
-    return &p_grcacheent->gr;
+    /* Try to size the memory needed to get the strings for getpwuid_r
+     * and getgrgid_r. */
+    res = sysconf(_SC_GETPW_R_SIZE_MAX);
+    if (res == -1 || res > 4096)
+        alt_groups_sz = 4096;
+    else
+        alt_groups_sz = res;
+
+    res = sysconf(_SC_GETGR_R_SIZE_MAX);
+    if (res == -1 || res > 4096)
+        group_memb_sz = 4096;
+    else
+        group_memb_sz = res;
 
-out_free:
-    if (p_grcacheent != NULL)
+    pthread_atfork(NULL, NULL, ug_atfork_child);
+
+    return 0;
+}
+
+void UidGidCache_SetTTL(time_t ttl, time_t neg_ttl)
+{
+    ug_ttl = ttl;
+    ug_neg_ttl = neg_ttl;
+}
+
+/* get user name for the given uid */
+const struct passwd *GetPwUid(uid_t owner)
+{
+    ug_cacheent_t *ent = ug_get(UG_USER, owner);
+
+    return ent ? &ent->pw : NULL;
+}
+
+/* get group name for the given gid */
+const struct group *GetGrGid(gid_t grid)
+{
+    ug_cacheent_t *ent = ug_get(UG_GROUP, grid);
+
+    return ent ? &ent->gr : NULL;
+}
+
+/** copy the name of a cached entry under the shard lock,
+ * so that it is not replaced by a refresh in the meantime */
+static char *ug_copy_name(ug_kind_t kind, unsigned int id, char *buf,
+                          size_t size)
+{
+    ug_shard_t    *shard = ug_shard(kind, id);
+    ug_cacheent_t *ent = ug_get(kind, id);
+    bool           found = false;
+
+    if (ent == NULL)
+        return NULL;
+
+    P_r(&shard->lock);
+    if (!ent->negative && *ug_name(kind, ent) != NULL)
     {
-        free(buffer);
-        free(p_grcacheent);
+        snprintf(buf, size, "%s", *ug_name(kind, ent));
+        found = true;
     }
+    V_r(&shard->lock);
+
+    return found ? buf : NULL;
+}
+
+/* copy user name for the given uid */
+char *GetPwName(uid_t owner, char *buf, size_t size)
+{
+    return ug_copy_name(UG_USER, owner, buf, size);
+}
+
+/* copy group name for the given gid */
+char *GetGrName(gid_t grid, char *buf, size_t size)
+{
+    return ug_copy_name(UG_GROUP, grid, buf, size);
+}
+
+/* ------------ prefetch ------------ */
+
+typedef struct ug_prefetch_item__
+{
+    ug_kind_t    kind;
+    unsigned int id;
+} ug_prefetch_item_t;
+
+typedef struct ug_prefetch_arg__
+{
+    const ug_prefetch_item_t *items;
+    unsigned int              count;
+    unsigned int              first;
+    unsigned int              step;
+} ug_prefetch_arg_t;
+
+static void *ug_prefetch_thr(void *arg)
+{
+    ug_prefetch_arg_t *pf = arg;
+    unsigned int       i;
+
+    for (i = pf->first; i < pf->count; i += pf->step)
+        ug_get(pf->items[i].kind, pf->items[i].id);
+
     return NULL;
 }
+
+/** append the distinct ids that are not cached yet */
+static void ug_prefetch_add(GArray *items, GHashTable *seen, ug_kind_t kind,
+                            const unsigned int *ids, unsigned int count)
+{
+    unsigned int i;
+
+    for (i = 0; i < count; i++)
+    {
+        ug_prefetch_item_t item = {.kind = kind, .id = ids[i]};
+        /* distinct keys for users and groups */
+        gpointer key = (gpointer)(((uintptr_t)ids[i] << 1) | kind);
+
+        if (g_hash_table_lookup_extended(seen, key, NULL, NULL))
+            continue;
+        g_hash_table_insert(seen, key, NULL);
+
+        if (!ug_cached(kind, ids[i]))
+            g_array_append_val(items, item);
+    }
+}
+
+void UidGidCache_Prefetch(const uid_t *uids, unsigned int nb_uids,
+                          const gid_t *gids, unsigned int nb_gids)
+{
+    ug_prefetch_arg_t  args[UG_PREFETCH_THREADS];
+    pthread_t          threads[UG_PREFETCH_THREADS];
+    unsigned int       nb_thr, i, started;
+    GHashTable        *seen;
+    GArray            *items;
+
+    items = g_array_new(FALSE, FALSE, sizeof(ug_prefetch_item_t));
+    seen = g_hash_table_new(NULL, NULL);
+
+    ug_prefetch_add(items, seen, UG_USER, (const unsigned int *)uids, nb_uids);
+    ug_prefetch_add(items, seen, UG_GROUP, (const unsigned int *)gids,
+                    nb_gids);
+    g_hash_table_destroy(seen);
+
+    if (items->len == 0)
+        goto out;
+
+    /* resolve ids in parallel, as name services (LDAP...)
+     * may have a high latency */
+    nb_thr = items->len / UG_PREFETCH_MIN;
+    if (nb_thr > UG_PREFETCH_THREADS)
+        nb_thr = UG_PREFETCH_THREADS;
+    if (nb_thr < 1)
+        nb_thr = 1;
+
+    for (i = 0; i < nb_thr; i++)
+    {
+        args[i].items = (ug_prefetch_item_t *)items->data;
+        args[i].count = items->len;
+        args[i].first = i;
+        args[i].step = nb_thr;
+    }
+
+    /* the current thread takes the first part */
+    started = 0;
+    for (i = 1; i < nb_thr; i++)
+    {
+        if (pthread_create(&threads[i], NULL, ug_prefetch_thr, &args[i]) != 0)
+            break;
+        started = i;
+    }
+    /* resolve parts with no thread from the current thread */
+    for (i = started + 1; i < nb_thr; i++)
+        ug_prefetch_thr(&args[i]);
+    ug_prefetch_thr(&args[0]);
+
+    for (i = 1; i <= started; i++)
+        pthread_join(threads[i], NULL);
+
+    DisplayLog(LVL_FULL, LOGTAG, "%u uid/gid prefetched using %u threads",
+               items->len, started + 1);
+out:
+    g_array_free(items, TRUE);
+}
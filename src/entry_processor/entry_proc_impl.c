@@ -24,10 +24,12 @@
 #include "rbh_logs.h"
 #include "rbh_misc.h"
 #include "list.h"
+#include "usage_cache.h"
 #include <semaphore.h>
 #include <pthread.h>
 #include <errno.h>
 #include <stdlib.h>
+#include <inttypes.h>
 
 static sem_t pipeline_token;
 
@@ -253,6 +255,8 @@ int EntryProcessor_Init(pipeline_flavor_e flavor, run_flags_t flags, void *arg)
             entry_proc_pipeline = std_pipeline; /* pointer */
             entry_proc_descr = std_pipeline_descr; /* full copy */
             /* arg is a diff_mask */
+            /* the pipeline applies usage changes to the usage cache */
+            usage_cache_set_maintained();
             break;
         case DIFF_PIPELINE:
             entry_proc_pipeline = diff_pipeline; /* pointer */
@@ -783,6 +787,13 @@ static entry_proc_op_t **next_work_avail(bool *p_empty, int *op_count)
                         else if (p_next->being_processed || (p_next->pipeline_stage != i))
                             /* entry is already beeing processed or is at a different stage */
                             break;
+                        else if ((entry_proc_pipeline[i].stage_flags & STAGE_FLAG_ID_CONSTRAINT)
+                                 && (!p_curr->entry_id_is_set
+                                     || !p_next->entry_id_is_set
+                                     || !id_constraint_is_first_op(p_next)))
+                            /* special operation, or not the first operation
+                             * for this id */
+                            break;
 
                         if (entry_proc_pipeline[i].test_batchable(p_curr, p_next, &batch_mask))
                         {
@@ -898,14 +909,18 @@ void EntryProcessor_Release( entry_proc_op_t * p_op )
 
 /**
  * Acknownledge a batch of operations.
+ * @param per_op indicates if next_stage and remove are arrays with one item
+ *               per operation, or single values for the whole batch.
  */
-int EntryProcessor_AcknowledgeBatch(entry_proc_op_t ** ops, unsigned int count,
-                                    unsigned int next_stage, bool remove)
+static int acknowledge_ops(entry_proc_op_t **ops, unsigned int count,
+                           const unsigned int *next_stage, const bool *remove,
+                           bool per_op)
 {
     const unsigned int   curr_stage = ops[0]->pipeline_stage;
     list_by_stage_t *pl = &pipeline[curr_stage];
     int            nb_moved;
     struct timeval now, diff;
+    bool           removed = false;
     int i;
 
     gettimeofday(&now, NULL);
@@ -930,12 +945,15 @@ int EntryProcessor_AcknowledgeBatch(entry_proc_op_t ** ops, unsigned int count,
 
     for (i = 0; i < count; i++)
     {
+        unsigned int op_next = next_stage[per_op ? i : 0];
+        bool         op_remove = remove[per_op ? i : 0];
+
         /* sanity check */
-        if ((!remove) && (ops[i]->pipeline_stage >= next_stage))
+        if ((!op_remove) && (ops[i]->pipeline_stage >= op_next))
         {
             DisplayLog(LVL_CRIT, ENTRYPROC_TAG, "CRITICAL: entry is already"
                        " in a higher pipeline stage %u >= %u !!!",
-                       ops[i]->pipeline_stage, next_stage);
+                       ops[i]->pipeline_stage, op_next);
 
             V(pl->stage_mutex);
             RBH_BUG("Entry is already in a higher pipeline stage.");
@@ -943,11 +961,12 @@ int EntryProcessor_AcknowledgeBatch(entry_proc_op_t ** ops, unsigned int count,
 
         /* update their status */
         ops[i]->being_processed = 0;
-        ops[i]->pipeline_stage = next_stage;
+        ops[i]->pipeline_stage = op_next;
 
         /* remove the entry, if it must be */
-        if (remove)
+        if (op_remove)
         {
+            removed = true;
             /* update stage info. */
             pl->nb_processed_entries--;
             rh_list_del_init(&ops[i]->list);
@@ -974,7 +993,7 @@ int EntryProcessor_AcknowledgeBatch(entry_proc_op_t ** ops, unsigned int count,
      * so it must have been moved.
      */
     /* @TODO check configuration for max_thread_count */
-    if (remove || (nb_moved > 0) || (entry_proc_pipeline[curr_stage].max_thread_count != 0))
+    if (removed || (nb_moved > 0) || (entry_proc_pipeline[curr_stage].max_thread_count != 0))
     {
         P(work_avail_lock);
         if (nb_waiting_threads > 0)
@@ -983,10 +1002,13 @@ int EntryProcessor_AcknowledgeBatch(entry_proc_op_t ** ops, unsigned int count,
     }
 
     /* free entry resources if asked */
-    if (remove)
+    if (removed)
     {
         for (i = 0; i < count; i++)
         {
+            if (!remove[per_op ? i : 0])
+                continue;
+
             /* If a limit of pending operations is specified, release a token */
             if (entry_proc_conf.max_pending_operations > 0)
                 sem_post(&pipeline_token);
@@ -998,6 +1020,19 @@ int EntryProcessor_AcknowledgeBatch(entry_proc_op_t ** ops, unsigned int count,
     return 0;
 }
 
+int EntryProcessor_AcknowledgeBatch(entry_proc_op_t **ops, unsigned int count,
+                                    unsigned int next_stage, bool remove)
+{
+    return acknowledge_ops(ops, count, &next_stage, &remove, false);
+}
+
+int EntryProcessor_AcknowledgeEach(entry_proc_op_t **ops, unsigned int count,
+                                   const unsigned int *next_stage,
+                                   const bool *remove)
+{
+    return acknowledge_ops(ops, count, next_stage, remove, true);
+}
+
 /**
  * Advise that the entry is ready for next step of the pipeline.
  * @param next_stage The next stage to be performed for this entry
@@ -1057,12 +1092,30 @@ static void print_op_stats(entry_proc_op_t * p_op, unsigned int stage, const cha
 }
 
 
+/** Number of operations currently in the pipeline */
+unsigned int EntryProcessor_PendingOps(void)
+{
+    unsigned int i;
+    unsigned int count = 0;
+
+    if (!entry_proc_pipeline)
+        return 0; /* not initialized */
+
+    /* no locks here, as an approximate value is enough */
+    for (i = 0; i < entry_proc_descr.stage_count; i++)
+        count += pipeline[i].nb_current_entries + pipeline[i].nb_unprocessed_entries
+                 + pipeline[i].nb_processed_entries;
+
+    return count;
+}
+
 void EntryProcessor_DumpCurrentStages( void )
 {
     unsigned int   i;
     double         tpe = 0.0;
     bool           is_pending_op = false;
     unsigned int nb_get, nb_ins, nb_upd,nb_rm;
+    lmgr_cache_stats_t cache_stats;
 
     if (!entry_proc_pipeline)
         return; /* not initialized */
@@ -1128,6 +1181,20 @@ void EntryProcessor_DumpCurrentStages( void )
         }
         DisplayLog( LVL_MAJOR, "STATS", "DB ops: get=%u/ins=%u/upd=%u/rm=%u",
                     nb_get, nb_ins, nb_upd, nb_rm );
+
+        ListMgr_EntryCacheStats(&cache_stats);
+        if (cache_stats.max_count > 0)
+        {
+            uint64_t total = cache_stats.hits + cache_stats.misses;
+
+            DisplayLog(LVL_MAJOR, "STATS", "Entry cache: %u/%u entries, "
+                       "hits=%"PRIu64"/misses=%"PRIu64" (%.2f%% hits), "
+                       "evictions=%"PRIu64", invalidations=%"PRIu64,
+                       cache_stats.count, cache_stats.max_count,
+                       cache_stats.hits, cache_stats.misses,
+                       total ? 100.0 * cache_stats.hits / total : 0.0,
+                       cache_stats.evictions, cache_stats.invalidations);
+        }
     }
 
     if ( TestDisplayLevel( LVL_EVENT ) )
@@ -27,6 +27,8 @@
 #include "policy_rules.h"
 #include "update_params.h"
 #include "status_manager.h"
+#include "rbh_events.h"
+#include "usage_cache.h"
 #include <errno.h>
 #include <time.h>
 #include <unistd.h>
@@ -38,6 +40,7 @@
 /* forward declaration of EntryProc functions of pipeline */
 static int  EntryProc_get_fid( struct entry_proc_op_t *, lmgr_t * );
 static int  EntryProc_get_info_db( struct entry_proc_op_t *, lmgr_t * );
+static int  EntryProc_get_info_db_batch(struct entry_proc_op_t **, int, lmgr_t *);
 static int  EntryProc_get_info_fs( struct entry_proc_op_t *, lmgr_t * );
 static int  EntryProc_pre_apply(struct entry_proc_op_t *, lmgr_t *);
 static int  EntryProc_db_apply(struct entry_proc_op_t *, lmgr_t *);
@@ -49,6 +52,8 @@ static int  EntryProc_rm_old_entries( struct entry_proc_op_t *, lmgr_t * );
 
 /* forward declaration to check batchable operations for db_apply stage */
 static bool dbop_is_batchable(struct entry_proc_op_t *, struct entry_proc_op_t *, attr_mask_t *);
+/* forward declaration to check batchable operations for get_info_db stage */
+static bool getdb_is_batchable(struct entry_proc_op_t *, struct entry_proc_op_t *, attr_mask_t *);
 
 /** pipeline stages */
 enum {
@@ -80,7 +85,8 @@ const pipeline_descr_t std_pipeline_descr =
 pipeline_stage_t std_pipeline[] = {
     {STAGE_GET_FID, "STAGE_GET_FID", EntryProc_get_fid, NULL, NULL,
      STAGE_FLAG_PARALLEL | STAGE_FLAG_SYNC, 0},
-    {STAGE_GET_INFO_DB, "STAGE_GET_INFO_DB", EntryProc_get_info_db, NULL, NULL,
+    {STAGE_GET_INFO_DB, "STAGE_GET_INFO_DB", EntryProc_get_info_db,
+        EntryProc_get_info_db_batch, getdb_is_batchable, /* batched DB lookups */
      STAGE_FLAG_PARALLEL | STAGE_FLAG_SYNC | STAGE_FLAG_ID_CONSTRAINT, 0},
     {STAGE_GET_INFO_FS, "STAGE_GET_INFO_FS", EntryProc_get_info_fs, NULL, NULL,
      STAGE_FLAG_PARALLEL | STAGE_FLAG_SYNC, 0},
@@ -89,8 +95,8 @@ pipeline_stage_t std_pipeline[] = {
     {STAGE_DB_APPLY, "STAGE_DB_APPLY", EntryProc_db_apply,
         EntryProc_db_batch_apply, dbop_is_batchable, /* batched ops management */
 #if defined( _SQLITE )
-     /* SQLite locks the whole file for modifications...
-     * So, 1 single threads is enough at this step.
+     /* SQLite has a single writer (readers of previous stages are not
+     * blocked in WAL mode). So, 1 single threads is enough at this step.
      */
      STAGE_FLAG_MAX_THREADS | STAGE_FLAG_SYNC, 1},
 #else
@@ -751,20 +757,18 @@ static bool is_lustre_special(const struct entry_proc_op_t *p_op)
 
 
 /**
- * check if the entry exists in the database and what info
- * must be retrieved.
+ * First part of the GET_INFO_DB stage: determine what attributes must be
+ * retrieved from the database (set in p_op->db_attrs.attr_mask).
+ * @param[out] status_scope status mask of the policies the entry matches.
+ * @return false if the entry must be dropped.
  */
-int EntryProc_get_info_db( struct entry_proc_op_t *p_op, lmgr_t * lmgr )
+static bool get_info_db_prepare(struct entry_proc_op_t *p_op, lmgr_t *lmgr,
+                                uint32_t *status_scope)
 {
-    int      rc = 0;
-    int      next_stage = -1; /* -1 = skip */
     attr_mask_t attr_allow_cached = null_mask;
-    attr_mask_t attr_need_fresh = null_mask;
-    uint32_t status_scope = 0; /* status mask */
     attr_mask_t tmp;
 
-    const pipeline_stage_t *stage_info =
-        &entry_proc_pipeline[p_op->pipeline_stage];
+    *status_scope = 0;
 
     /* always ignore root */
     if (p_op->entry_id_is_set &&
@@ -772,15 +776,13 @@ int EntryProc_get_info_db( struct entry_proc_op_t *p_op, lmgr_t * lmgr )
     {
         DisplayLog(LVL_DEBUG, ENTRYPROC_TAG, "Ignoring record for root directory");
         /* drop the entry */
-        next_stage = -1;
-        goto next_step;
+        return false;
     }
 
     /* ignore special files */
     if (is_lustre_special(p_op)) {
         /* drop the entry */
-        next_stage = -1;
-        goto next_step;
+        return false;
     }
 
 #ifdef HAVE_CHANGELOGS
@@ -788,6 +790,7 @@ int EntryProc_get_info_db( struct entry_proc_op_t *p_op, lmgr_t * lmgr )
     if ( p_op->extra_info.is_changelog_record )
     {
         obj_type_t type_clue = TYPE_NONE;
+        int        rc;
 
         CL_REC_TYPE *logrec = p_op->extra_info.log_record.p_log_rec;
 
@@ -841,8 +844,7 @@ int EntryProc_get_info_db( struct entry_proc_op_t *p_op, lmgr_t * lmgr )
                 /* Not found. Skip the entry */
                 DisplayLog( LVL_FULL, ENTRYPROC_TAG,
                             "Warning: parent/filename for UNLINK not found" );
-                next_stage = -1;
-                goto next_step;
+                return false;
             }
         }
 
@@ -892,12 +894,12 @@ int EntryProc_get_info_db( struct entry_proc_op_t *p_op, lmgr_t * lmgr )
         }
 
         /* check if entry is in policies scope */
-        add_matching_scopes_mask(&p_op->entry_id, &p_op->fs_attrs, true, &status_scope);
+        add_matching_scopes_mask(&p_op->entry_id, &p_op->fs_attrs, true, status_scope);
 
         /* get missing attributes to check the scopes:
          * db_attr_need |= <attrs_for_status> and not <fs_attrs>
          */
-        tmp = attrs_for_status_mask(status_scope, false);
+        tmp = attrs_for_status_mask(*status_scope, false);
         tmp = attr_mask_and_not(&tmp, &p_op->fs_attrs.attr_mask);
         p_op->db_attr_need = attr_mask_or(&p_op->db_attr_need, &tmp);
 
@@ -923,32 +925,124 @@ int EntryProc_get_info_db( struct entry_proc_op_t *p_op, lmgr_t * lmgr )
             }
         }
 
+        /* previous usage, to maintain the usage cache of triggers */
+        if (usage_cache_enabled())
+            p_op->db_attr_need.std |= USAGE_CACHE_ATTR_MASK;
+
         /* attributes to be retrieved */
         p_op->db_attrs.attr_mask = p_op->db_attr_need;
+        return true;
+    }
+#endif
 
-        rc = ListMgr_Get( lmgr, &p_op->entry_id, &p_op->db_attrs );
+    /* scan is expected to provide full path and attributes. */
+    if (!ATTR_MASK_TEST( &p_op->fs_attrs, fullpath ))
+    {
+        DisplayLog( LVL_CRIT, ENTRYPROC_TAG,
+                    "Error: missing info from FS scan" );
+        /* skip the entry */
+        return false;
+    }
 
-        if (rc == DB_SUCCESS )
-        {
-            p_op->db_exists = 1;
-            /* attr mask has been set by ListMgr_Get */
-        }
-        else if (rc == DB_NOT_EXISTS )
+    /* check if entry is in policies scope */
+    add_matching_scopes_mask(&p_op->entry_id, &p_op->fs_attrs, true, status_scope);
+
+    p_op->db_attr_need = attr_mask_or(&p_op->db_attr_need, &diff_mask);
+    /* retrieve missing attributes for diff */
+    tmp = attr_mask_and_not(&diff_mask, &p_op->fs_attrs.attr_mask);
+    p_op->fs_attr_need = attr_mask_or(&p_op->fs_attr_need, &tmp);
+
+    if (entry_proc_conf.detect_fake_mtime)
+        attr_mask_set_index(&p_op->db_attr_need, ATTR_INDEX_creation_time);
+
+    /* get all needed attributes for status */
+    attr_allow_cached = attrs_for_status_mask(*status_scope, false);
+
+    /* what must be retrieved from DB: */
+    tmp = attr_mask_and_not(&attr_allow_cached, &p_op->fs_attrs.attr_mask);
+    p_op->db_attr_need = attr_mask_or(&p_op->db_attr_need, &tmp);
+
+    /* no dircount for non-dirs */
+    if (ATTR_MASK_TEST(&p_op->fs_attrs, type) &&
+        strcmp(ATTR(&p_op->fs_attrs, type), STR_TYPE_DIR))
+        attr_mask_unset_index(&p_op->db_attr_need, ATTR_INDEX_dircount);
+
+    /* no readlink for non symlinks */
+    if (ATTR_MASK_TEST(&p_op->fs_attrs, type)) /* likely */
+    {
+        if (!strcmp(ATTR(&p_op->fs_attrs, type), STR_TYPE_LINK))
         {
-            p_op->db_exists = 0;
-            /* no attrs from DB */
-            ATTR_MASK_INIT( &p_op->db_attrs );
+            attr_mask_set_index(&p_op->db_attr_need, ATTR_INDEX_link); /* check if it is known */
+            /* no stripe for symlinks */
+            attr_mask_unset_index(&p_op->db_attr_need, ATTR_INDEX_stripe_info);
+            attr_mask_unset_index(&p_op->db_attr_need, ATTR_INDEX_stripe_items);
         }
         else
-        {
-            /* ERROR */
-            DisplayLog(LVL_CRIT, ENTRYPROC_TAG,
-                       "Error %d retrieving entry "DFID" from DB: %s.", rc,
-                       PFID(&p_op->entry_id), lmgr_err2str(rc));
-            p_op->db_exists = 0;
-            /* no attrs from DB */
-            ATTR_MASK_INIT( &p_op->db_attrs );
-        }
+            attr_mask_unset_index(&p_op->db_attr_need, ATTR_INDEX_link);
+    }
+
+    if (entry_proc_conf.match_classes)
+    {
+        if (updt_params.fileclass.when != UPDT_ALWAYS)
+            attr_mask_set_index(&p_op->db_attr_need, ATTR_INDEX_class_update);
+
+        tmp = attr_mask_and_not(&policies.global_fileset_mask,
+                                &p_op->fs_attrs.attr_mask);
+        p_op->db_attr_need = attr_mask_or(&p_op->db_attr_need, &tmp);
+    }
+
+    /* previous usage, to maintain the usage cache of triggers */
+    if (usage_cache_enabled())
+        p_op->db_attr_need.std |= USAGE_CACHE_ATTR_MASK;
+
+    /* attributes to be retrieved (if none, only check the entry exists) */
+    p_op->db_attrs.attr_mask = p_op->db_attr_need;
+    return true;
+}
+
+/**
+ * Set the DB status of an entry from the result of its DB lookup.
+ */
+static void get_info_db_status(struct entry_proc_op_t *p_op, int rc)
+{
+    if (rc == DB_SUCCESS )
+    {
+        p_op->db_exists = 1;
+        /* attr mask has been set by ListMgr_Get */
+    }
+    else if (rc == DB_NOT_EXISTS )
+    {
+        p_op->db_exists = 0;
+        /* no attrs from DB */
+        ATTR_MASK_INIT( &p_op->db_attrs );
+    }
+    else
+    {
+        /* ERROR */
+        DisplayLog(LVL_CRIT, ENTRYPROC_TAG,
+                   "Error %d retrieving entry "DFID" from DB: %s.", rc,
+                   PFID(&p_op->entry_id), lmgr_err2str(rc));
+        p_op->db_exists = 0;
+        /* no attrs from DB */
+        ATTR_MASK_INIT( &p_op->db_attrs );
+    }
+}
+
+/**
+ * Last part of the GET_INFO_DB stage, once the entry has been looked up
+ * in the database: decide what info must be retrieved from the filesystem.
+ * @return the next pipeline stage for the entry.
+ */
+static int get_info_db_finish(struct entry_proc_op_t *p_op, lmgr_t *lmgr,
+                              uint32_t status_scope)
+{
+    int      next_stage = -1;
+    attr_mask_t tmp;
+
+#ifdef HAVE_CHANGELOGS
+    if ( p_op->extra_info.is_changelog_record )
+    {
+        CL_REC_TYPE *logrec = p_op->extra_info.log_record.p_log_rec;
 
         /* Retrieve info from the log record, and decide what info must be
          * retrieved from filesystem. */
@@ -973,93 +1067,13 @@ int EntryProc_get_info_db( struct entry_proc_op_t *p_op, lmgr_t * lmgr )
     else /* entry from FS scan */
     {
 #endif
-        /* scan is expected to provide full path and attributes. */
-        if (!ATTR_MASK_TEST( &p_op->fs_attrs, fullpath ))
-        {
-            DisplayLog( LVL_CRIT, ENTRYPROC_TAG,
-                        "Error: missing info from FS scan" );
-            /* skip the entry */
-            next_stage = -1;
-            goto next_step;
-        }
-
-        /* check if entry is in policies scope */
-        add_matching_scopes_mask(&p_op->entry_id, &p_op->fs_attrs, true, &status_scope);
-
-        p_op->db_attr_need = attr_mask_or(&p_op->db_attr_need, &diff_mask);
-        /* retrieve missing attributes for diff */
-        tmp = attr_mask_and_not(&diff_mask, &p_op->fs_attrs.attr_mask);
-        p_op->fs_attr_need = attr_mask_or(&p_op->fs_attr_need, &tmp);
+        attr_mask_t attr_need_fresh = attrs_for_status_mask(status_scope, true);
 
-        if (entry_proc_conf.detect_fake_mtime)
-            attr_mask_set_index(&p_op->db_attr_need, ATTR_INDEX_creation_time);
-
-        /* get all needed attributes for status */
-        attr_allow_cached = attrs_for_status_mask(status_scope, false);
-        attr_need_fresh = attrs_for_status_mask(status_scope, true);
-
-        /* what must be retrieved from DB: */
-        tmp = attr_mask_and_not(&attr_allow_cached, &p_op->fs_attrs.attr_mask);
-        p_op->db_attr_need = attr_mask_or(&p_op->db_attr_need, &tmp);
-
-        /* no dircount for non-dirs */
-        if (ATTR_MASK_TEST(&p_op->fs_attrs, type) &&
-            strcmp(ATTR(&p_op->fs_attrs, type), STR_TYPE_DIR))
-            attr_mask_unset_index(&p_op->db_attr_need, ATTR_INDEX_dircount);
-
-        /* no readlink for non symlinks */
-        if (ATTR_MASK_TEST(&p_op->fs_attrs, type)) /* likely */
-        {
-            if (!strcmp(ATTR(&p_op->fs_attrs, type), STR_TYPE_LINK))
-            {
-                attr_mask_set_index(&p_op->db_attr_need, ATTR_INDEX_link); /* check if it is known */
-                /* no stripe for symlinks */
-                attr_mask_unset_index(&p_op->db_attr_need, ATTR_INDEX_stripe_info);
-                attr_mask_unset_index(&p_op->db_attr_need, ATTR_INDEX_stripe_items);
-            }
-            else
-                attr_mask_unset_index(&p_op->db_attr_need, ATTR_INDEX_link);
-        }
-
-        if (entry_proc_conf.match_classes)
-        {
-            if (updt_params.fileclass.when != UPDT_ALWAYS)
-                attr_mask_set_index(&p_op->db_attr_need, ATTR_INDEX_class_update);
-
-            tmp = attr_mask_and_not(&policies.global_fileset_mask,
-                                    &p_op->fs_attrs.attr_mask);
-            p_op->db_attr_need = attr_mask_or(&p_op->db_attr_need, &tmp);
-        }
-
-        if (!attr_mask_is_null(p_op->db_attr_need))
-        {
-            p_op->db_attrs.attr_mask = p_op->db_attr_need;
-            rc = ListMgr_Get(lmgr, &p_op->entry_id, &p_op->db_attrs);
-
-            if (rc == DB_SUCCESS)
-            {
-                p_op->db_exists = 1;
-                tmp = attr_mask_and_not(&p_op->db_attr_need, &p_op->db_attrs.attr_mask);
-                p_op->fs_attr_need = attr_mask_or(&p_op->fs_attr_need, &tmp);
-            }
-            else if (rc == DB_NOT_EXISTS )
-            {
-                p_op->db_exists = 0;
-                ATTR_MASK_INIT( &p_op->db_attrs );
-            }
-            else
-            {
-                /* ERROR */
-                DisplayLog(LVL_CRIT, ENTRYPROC_TAG,
-                           "Error %d retrieving entry "DFID" from DB: %s.", rc,
-                           PFID(&p_op->entry_id), lmgr_err2str(rc));
-                p_op->db_exists = 0;
-                ATTR_MASK_INIT( &p_op->db_attrs );
-            }
-        }
-        else
+        /* attributes missing in DB must be retrieved from the filesystem */
+        if (p_op->db_exists)
         {
-            p_op->db_exists = ListMgr_Exists( lmgr, &p_op->entry_id );
+            tmp = attr_mask_and_not(&p_op->db_attr_need, &p_op->db_attrs.attr_mask);
+            p_op->fs_attr_need = attr_mask_or(&p_op->fs_attr_need, &tmp);
         }
 
         /* get status for all policies */
@@ -1163,7 +1177,30 @@ int EntryProc_get_info_db( struct entry_proc_op_t *p_op, lmgr_t * lmgr )
         next_stage = STAGE_PRE_APPLY;
     #endif
 
-next_step:
+    return next_stage;
+}
+
+/**
+ * check if the entry exists in the database and what info
+ * must be retrieved.
+ */
+int EntryProc_get_info_db( struct entry_proc_op_t *p_op, lmgr_t * lmgr )
+{
+    int      rc;
+    int      next_stage = -1; /* -1 = skip */
+    uint32_t status_scope; /* status mask */
+
+    const pipeline_stage_t *stage_info =
+        &entry_proc_pipeline[p_op->pipeline_stage];
+
+    if (get_info_db_prepare(p_op, lmgr, &status_scope))
+    {
+        rc = ListMgr_CachedGet(lmgr, &p_op->entry_id, &p_op->db_attrs);
+        get_info_db_status(p_op, rc);
+
+        next_stage = get_info_db_finish(p_op, lmgr, status_scope);
+    }
+
     if ( next_stage == -1 )
         /* drop the entry */
         rc = EntryProcessor_Acknowledge(p_op, -1, true);
@@ -1178,6 +1215,116 @@ next_step:
     return rc;
 }
 
+/**
+ * Operations at GET_INFO_DB stage can always be processed together
+ * (the pipeline only batches the first operation for each entry id).
+ */
+static bool getdb_is_batchable(struct entry_proc_op_t *first,
+                               struct entry_proc_op_t *next,
+                               attr_mask_t *full_attr_mask)
+{
+    return true;
+}
+
+/**
+ * Process a batch of operations at GET_INFO_DB stage:
+ * entries that need the same attributes are retrieved from the database
+ * using a single request.
+ */
+int EntryProc_get_info_db_batch(struct entry_proc_op_t **ops, int count,
+                                lmgr_t *lmgr)
+{
+    int            i, j, n, rc = 0;
+    const pipeline_stage_t *stage_info = &entry_proc_pipeline[ops[0]->pipeline_stage];
+    uint32_t      *scopes = NULL;
+    unsigned int  *next_stages = NULL;
+    bool          *remove = NULL;
+    bool          *done = NULL;
+    const entry_id_t **ids = NULL;
+    attr_set_t   **attrs = NULL;
+    int           *rcs = NULL;
+    int           *idx = NULL;
+
+    scopes = MemCalloc(count, sizeof(*scopes));
+    next_stages = MemCalloc(count, sizeof(*next_stages));
+    remove = MemCalloc(count, sizeof(*remove));
+    done = MemCalloc(count, sizeof(*done));
+    ids = MemCalloc(count, sizeof(*ids));
+    attrs = MemCalloc(count, sizeof(*attrs));
+    rcs = MemCalloc(count, sizeof(*rcs));
+    idx = MemCalloc(count, sizeof(*idx));
+    if (!scopes || !next_stages || !remove || !done || !ids || !attrs
+        || !rcs || !idx)
+    {
+        rc = -ENOMEM;
+        goto free_arrays;
+    }
+
+    /* determine what must be retrieved for each entry */
+    for (i = 0; i < count; i++)
+    {
+        if (!get_info_db_prepare(ops[i], lmgr, &scopes[i]))
+        {
+            /* drop the entry */
+            next_stages[i] = -1;
+            remove[i] = true;
+            done[i] = true;
+        }
+    }
+
+    /* retrieve entries that need the same attributes at once */
+    for (i = 0; i < count; i++)
+    {
+        if (done[i])
+            continue;
+
+        n = 0;
+        for (j = i; j < count; j++)
+        {
+            if (done[j] || !attr_mask_equal(&ops[j]->db_attrs.attr_mask,
+                                            &ops[i]->db_attrs.attr_mask))
+                continue;
+
+            ids[n] = &ops[j]->entry_id;
+            attrs[n] = &ops[j]->db_attrs;
+            idx[n] = j;
+            n++;
+        }
+
+        DisplayLog(LVL_FULL, ENTRYPROC_TAG, "BatchGet(%u ops: "DFID"...)",
+                   n, PFID(ids[0]));
+
+        rc = ListMgr_CachedBatchGet(lmgr, n, ids, attrs, rcs);
+        for (j = 0; j < n; j++)
+        {
+            struct entry_proc_op_t *p_op = ops[idx[j]];
+
+            get_info_db_status(p_op, rc ? rc : rcs[j]);
+
+            next_stages[idx[j]] = get_info_db_finish(p_op, lmgr,
+                                                     scopes[idx[j]]);
+            remove[idx[j]] = (next_stages[idx[j]] == -1);
+            done[idx[j]] = true;
+        }
+    }
+
+    rc = EntryProcessor_AcknowledgeEach(ops, count, next_stages, remove);
+    if (rc)
+        DisplayLog(LVL_CRIT, ENTRYPROC_TAG, "Error %d acknowledging stage %s.",
+                   rc, stage_info->stage_name);
+
+free_arrays:
+    MemFree(idx);
+    MemFree(rcs);
+    MemFree(attrs);
+    MemFree(ids);
+    MemFree(done);
+    MemFree(remove);
+    MemFree(next_stages);
+    MemFree(scopes);
+    return rc;
+}
+
 /** skip_record a record by acknowledging current operation */
 static int skip_record(struct entry_proc_op_t *p_op)
 {
@@ -1666,6 +1813,42 @@ skip_record:
 #endif
 }
 
+/** Log a database operation to the binary event log. */
+static void db_op_event(const struct entry_proc_op_t *p_op, int rc)
+{
+    uint64_t cl_index = 0;
+
+    if (!EventLogEnabled())
+        return;
+
+#ifdef HAVE_CHANGELOGS
+    if (p_op->extra_info.is_changelog_record)
+        cl_index = p_op->extra_info.log_record.p_log_rec->cr_index;
+#endif
+    rbh_evt_db_op(&p_op->entry_id, p_op->db_op_type, rc, cl_index);
+}
+
+/** Apply the usage change of a database operation to the usage cache. */
+static void db_op_usage(const struct entry_proc_op_t *p_op)
+{
+    switch (p_op->db_op_type)
+    {
+    case OP_TYPE_INSERT:
+        usage_cache_update(NULL, &p_op->fs_attrs);
+        break;
+    case OP_TYPE_UPDATE:
+        usage_cache_update(&p_op->db_attrs, &p_op->fs_attrs);
+        break;
+    case OP_TYPE_REMOVE_LAST:
+    case OP_TYPE_SOFT_REMOVE:
+        usage_cache_update(&p_op->db_attrs, NULL);
+        break;
+    default:
+        /* no change: other names of the entry remain */
+        break;
+    }
+}
+
 /**
  * Perform a single operation on the database.
  */
@@ -1735,6 +1918,10 @@ int EntryProc_db_apply(struct entry_proc_op_t *p_op, lmgr_t * lmgr)
     if (rc)
         DisplayLog(LVL_CRIT, ENTRYPROC_TAG, "Error %d performing database operation: %s.",
                    rc, lmgr_err2str(rc));
+    else if (usage_cache_enabled())
+        db_op_usage(p_op);
+
+    db_op_event(p_op, rc);
 
     /* Acknowledge the operation if there is a callback */
 #ifdef HAVE_CHANGELOGS
@@ -1806,6 +1993,12 @@ int EntryProc_db_batch_apply(struct entry_proc_op_t **ops, int count,
     if (rc)
         DisplayLog(LVL_CRIT, ENTRYPROC_TAG, "Error %d performing batch database operation: %s.",
                    rc, lmgr_err2str(rc));
+    else if (usage_cache_enabled())
+        for (i = 0; i < count; i++)
+            db_op_usage(ops[i]);
+
+    for (i = 0; i < count; i++)
+        db_op_event(ops[i], rc);
 
     /* Acknowledge the operation if there is a callback */
 #ifdef HAVE_CHANGELOGS
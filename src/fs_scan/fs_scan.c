@@ -54,6 +54,8 @@ const char      *partial_scan_root = NULL;
 
 static bool     is_lustre_fs = false;
 static bool     is_first_scan = false;
+/** the DB is in bulk-load mode for the current scan */
+static bool     bulk_loading = false;
 
 
 /* information about scanning thread */
@@ -293,6 +295,41 @@ static bool ignore_entry(char *fullpath, char *name, unsigned int depth, struct
     return ( rc != POLICY_NO_MATCH );
 }
 
+/** Can unseen entries be removed by generation, out of the pipeline? */
+static bool gc_by_generation(void)
+{
+    /* Not for partial scans (entries may have moved to another part of the
+     * namespace), nor when removed entries are displayed (diff). */
+    return fs_scan_gc_enabled() && (partial_scan_root == NULL)
+           && (entry_proc_pipeline == std_pipeline)
+           && attr_mask_is_null(*(attr_mask_t *)entry_proc_arg);
+}
+
+/** Switch the DB back to normal mode at the end of an initial scan */
+static void end_bulk_load(void)
+{
+    lmgr_t lmgr;
+    int    rc;
+
+    bulk_loading = false;
+
+    rc = ListMgr_InitAccess(&lmgr);
+    if (rc != DB_SUCCESS)
+    {
+        DisplayLog(LVL_CRIT, FSSCAN_TAG, "ERROR: failed to connect to DB to "
+                   "terminate bulk load: normal mode will be restored at "
+                   "next startup");
+        return;
+    }
+
+    rc = ListMgr_BulkLoadEnd(&lmgr);
+    if (rc)
+        DisplayLog(LVL_CRIT, FSSCAN_TAG, "ERROR %d terminating bulk load: %s",
+                   rc, lmgr_err2str(rc));
+
+    ListMgr_CloseAccess(&lmgr);
+}
+
 /* Terminate a filesystem scan (called by the thread
  * that terminates the last task of scan, and merge
  * itself to the mother task).
@@ -336,8 +373,11 @@ static int TerminateScan(int scan_complete, time_t end)
         ListMgr_CloseAccess(&lmgr);
     }
 
-    /* if scan is incomplete (aborted or failed), don't remove old entries in DB. */
-    if (scan_complete)
+    /* Flush the pipeline, and remove entries not seen during the scan.
+     * If the scan is incomplete (aborted or failed), don't remove old entries
+     * in DB, but the pipeline must still be flushed before ending
+     * the bulk load. */
+    if (scan_complete || bulk_loading)
     {
         entry_proc_op_t *op;
 
@@ -356,8 +396,10 @@ static int TerminateScan(int scan_complete, time_t end)
 
         ATTR_MASK_INIT( &op->fs_attrs );
 
-        /* if this is an initial scan, don't rm old entries (but flush pipeline still) */
-        if (fsscan_nogc || (is_first_scan && !partial_scan_root))
+        /* if this is an initial scan, don't rm old entries (but flush pipeline still).
+         * With generation GC, old entries are removed after the flush. */
+        if (!scan_complete || fsscan_nogc
+            || (is_first_scan && !partial_scan_root) || gc_by_generation())
         {
             op->gc_entries = 0;
             op->gc_names = 0;
@@ -401,6 +443,14 @@ static int TerminateScan(int scan_complete, time_t end)
 #endif
     }
 
+    /* the pipeline has been flushed: all entries are loaded */
+    if (bulk_loading)
+        end_bulk_load();
+
+    /* remove entries of previous generations */
+    if (scan_complete && !fsscan_nogc && !is_first_scan && gc_by_generation())
+        fs_scan_gc_request(scan_start_time, !fs_scan_config.gc_background);
+
     /* take a lock on scan info */
     P( lock_scan );
 
@@ -1523,6 +1573,10 @@ int Robinhood_InitScanModule( void )
     if ( !thread_list )
         return ENOMEM;
 
+    rc = fs_scan_gc_init();
+    if (rc)
+        return rc;
+
     /* creating scanning threads  */
 
     for ( i = 0; i < fs_scan_config.nb_threads_scan; i++ )
@@ -1582,6 +1636,9 @@ void Robinhood_StopScanModule( void )
 
     DisplayLog( LVL_EVENT, FSSCAN_TAG, "Stop request has been sent to all scan threads" );
 
+    /* interrupt garbage collection (it is resumed at next startup) */
+    fs_scan_gc_stop();
+
     /* if there are still threads doing something, wait for them */
     if ( !all_threads_idle() )
         wait_scan_finished();
@@ -1692,6 +1749,11 @@ static int StartScan( void )
         if ((rc == DB_SUCCESS) && (count == 0)) {
             is_first_scan = true;
             DisplayLog(LVL_EVENT, FSSCAN_TAG, "Notice: this is the first scan (DB is empty)");
+
+            /* fill the empty DB in bulk-load mode (full scans only) */
+            if (fs_scan_config.bulk_load && !partial_scan_root
+                && ListMgr_BulkLoadStart(&lmgr) == DB_SUCCESS)
+                bulk_loading = true;
         }
         else if (rc)
              DisplayLog(LVL_MAJOR, FSSCAN_TAG, "Failed to retrieve entry count from DB: error %d", rc);
@@ -2042,6 +2104,8 @@ void Robinhood_StatsScan( robinhood_fsscan_stat_t * p_stats )
     p_stats->scan_complete = last_scan_complete;
     p_stats->current_scan_interval = scan_interval;
 
+    fs_scan_gc_stats(p_stats);
+
     if ( root_task != NULL )
     {
         unsigned int   i;
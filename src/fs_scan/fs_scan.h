@@ -53,6 +53,13 @@ typedef struct robinhood_fsscan_stat__
     double         avg_ms_per_entry;
     double         curr_ms_per_entry;
 
+    /* garbage collection progression */
+    time_t         gc_generation; /* 0 if no GC is running */
+    time_t         gc_start_time;
+    uint64_t       gc_estimated;  /* estimated number of entries to remove */
+    uint64_t       gc_rm_entries;
+    uint64_t       gc_rm_names;
+
 } robinhood_fsscan_stat_t;
 
 /**
@@ -96,4 +103,20 @@ int            Robinhood_CheckScanDeadlines( void );
  */
 void           Robinhood_StatsScan( robinhood_fsscan_stat_t * p_stats );
 
+/* Garbage collection of entries not seen during a scan (fs_scan_gc.c) */
+
+/** start the garbage collection thread (if enabled) */
+int  fs_scan_gc_init(void);
+/** stop the garbage collection thread (pending GC is resumed at restart) */
+void fs_scan_gc_stop(void);
+/** indicate if garbage collection by generation is running */
+bool fs_scan_gc_enabled(void);
+/**
+ * Request garbage collection of entries older than generation 'gen'.
+ * @param wait wait for the garbage collection to complete.
+ */
+void fs_scan_gc_request(time_t gen, bool wait);
+/** get garbage collection progress */
+void fs_scan_gc_stats(robinhood_fsscan_stat_t *p_stats);
+
 #endif
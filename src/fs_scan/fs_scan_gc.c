@@ -0,0 +1,275 @@
+/* -*- mode: c; c-basic-offset: 4; indent-tabs-mode: nil; -*-
+ * vim:expandtab:shiftwidth=4:tabstop=4:
+ */
+/*
+ * Copyright (C) 2016 CEA/DAM
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the CeCILL License.
+ *
+ * The fact that you are presently reading this means that you have had
+ * knowledge of the CeCILL license (http://www.cecill.info) and that you
+ * accept its terms.
+ */
+/**
+ * Garbage collection of entries that were not seen during a scan.
+ *
+ * Each full scan is a generation, identified by its start time: all entries
+ * and names seen by the scan have md_update and path_update >= generation.
+ * When the scan completes, older entries are removed in bounded chunks
+ * (one short transaction each) by a background thread, that yields to the
+ * entry processor when it is busy. The pending generation is stored in the
+ * DB, so an interrupted garbage collection is resumed at next startup.
+ */
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include "fs_scan.h"
+#include "entry_processor.h"
+#include "list_mgr.h"
+#include "policy_rules.h"
+#include "rbh_logs.h"
+#include "rbh_misc.h"
+
+#include <errno.h>
+#include <inttypes.h>
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define GC_TAG "FS_Scan_GC"
+
+/** delay between checks of the pipeline load (usec) */
+#define GC_YIELD_DELAY  100000
+
+static pthread_t       gc_thread;
+static bool            gc_started = false;
+static pthread_mutex_t gc_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t  gc_cond = PTHREAD_COND_INITIALIZER;
+static bool            gc_terminate = false;
+
+/** generation to be collected (0 if none) */
+static time_t          gc_pending = 0;
+/** last collected generation */
+static time_t          gc_done = 0;
+
+/* progress of the current garbage collection */
+static time_t          gc_current = 0;
+static time_t          gc_start_time = 0;
+static uint64_t        gc_estimated = 0;
+static uint64_t        gc_rm_entries = 0;
+static uint64_t        gc_rm_names = 0;
+
+static bool gc_must_stop(void)
+{
+    bool stop;
+
+    P(gc_lock);
+    stop = gc_terminate;
+    V(gc_lock);
+    return stop;
+}
+
+/** Wait for the pipeline load to be low enough */
+static void gc_yield(void)
+{
+    while (EntryProcessor_PendingOps() > fs_scan_config.gc_chunk_size
+           && !gc_must_stop())
+        rh_usleep(GC_YIELD_DELAY);
+}
+
+/** Collect entries of generations older than 'gen'.
+ * @return 0 when complete, -1 if interrupted, or a DB error.
+ */
+static int gc_collect(lmgr_t *lmgr, time_t gen)
+{
+    unsigned int  nb_entries, nb_names;
+    lmgr_gc_pos_t pos;
+    uint64_t      count = 0;
+    char          value[128];
+    int           rc;
+
+    /* record the pending generation to resume it if interrupted */
+    snprintf(value, sizeof(value), "%lu", (unsigned long)gen);
+    rc = ListMgr_SetVar(lmgr, GC_GENERATION_VAR, value);
+    if (rc)
+        return rc;
+
+    if (ListMgr_GCCount(lmgr, gen, &count) != DB_SUCCESS)
+        count = 0;
+
+    P(gc_lock);
+    gc_current = gen;
+    gc_start_time = time(NULL);
+    gc_estimated = count;
+    gc_rm_entries = gc_rm_names = 0;
+    V(gc_lock);
+
+    DisplayLog(LVL_EVENT, GC_TAG, "Removing entries not seen since %lu "
+               "(about %"PRIu64" entries)", (unsigned long)gen, count);
+
+    memset(&pos, 0, sizeof(pos));
+
+    do {
+        gc_yield();
+        if (gc_must_stop())
+            return -1;
+
+        rc = ListMgr_GCChunk(lmgr, gen, has_deletion_policy(), time(NULL),
+                             fs_scan_config.gc_chunk_size, NULL, &pos,
+                             &nb_entries, &nb_names);
+        if (rc)
+            return rc;
+
+        P(gc_lock);
+        gc_rm_entries += nb_entries;
+        gc_rm_names += nb_names;
+        V(gc_lock);
+
+    } while (!pos.names_done);
+
+    DisplayLog(LVL_EVENT, GC_TAG, "Garbage collection complete: %"PRIu64
+               " entries and %"PRIu64" names removed in %lus", gc_rm_entries,
+               gc_rm_names, (unsigned long)(time(NULL) - gc_start_time));
+    return 0;
+}
+
+static void *gc_thr(void *arg)
+{
+    lmgr_t lmgr;
+    time_t gen;
+    char   value[1024];
+    int    rc;
+
+    rc = ListMgr_InitAccess(&lmgr);
+    if (rc)
+    {
+        DisplayLog(LVL_CRIT, GC_TAG, "Error %d connecting to database: "
+                   "garbage collection is disabled", rc);
+        P(gc_lock);
+        gc_terminate = true;
+        pthread_cond_broadcast(&gc_cond);
+        V(gc_lock);
+        return NULL;
+    }
+
+    /* resume an interrupted garbage collection */
+    if (ListMgr_GetVar(&lmgr, GC_GENERATION_VAR, value, sizeof(value)) == DB_SUCCESS)
+    {
+        gen = strtoul(value, NULL, 10);
+        DisplayLog(LVL_EVENT, GC_TAG, "Resuming garbage collection of generation %lu",
+                   (unsigned long)gen);
+        P(gc_lock);
+        if (gen > gc_pending)
+            gc_pending = gen;
+        V(gc_lock);
+    }
+
+    P(gc_lock);
+    while (!gc_terminate)
+    {
+        if (gc_pending == 0)
+        {
+            pthread_cond_wait(&gc_cond, &gc_lock);
+            continue;
+        }
+        gen = gc_pending;
+        V(gc_lock);
+
+        rc = gc_collect(&lmgr, gen);
+        if (rc > 0)
+            DisplayLog(LVL_CRIT, GC_TAG, "Garbage collection failed with error %d: %s",
+                       rc, lmgr_err2str(rc));
+
+        P(gc_lock);
+        gc_current = 0;
+        if (rc == 0)
+        {
+            gc_done = gen;
+            /* a newer generation includes the older ones */
+            if (gc_pending == gen)
+            {
+                gc_pending = 0;
+                V(gc_lock);
+                ListMgr_SetVar(&lmgr, GC_GENERATION_VAR, NULL);
+                P(gc_lock);
+            }
+        }
+        else if (rc > 0 && gc_pending == gen)
+        {
+            /* don't loop on errors: retry at next scan or restart */
+            gc_pending = 0;
+            gc_done = gen;
+        }
+        pthread_cond_broadcast(&gc_cond);
+    }
+    V(gc_lock);
+
+    ListMgr_CloseAccess(&lmgr);
+    return NULL;
+}
+
+int fs_scan_gc_init(void)
+{
+    int rc;
+
+    /* only the standard pipeline updates the DB with scan results */
+    if (fs_scan_config.gc_chunk_size == 0 || entry_proc_pipeline != std_pipeline)
+        return 0;
+
+    rc = pthread_create(&gc_thread, NULL, gc_thr, NULL);
+    if (rc)
+    {
+        DisplayLog(LVL_CRIT, GC_TAG, "ERROR %d creating garbage collection thread: %s",
+                   rc, strerror(rc));
+        return rc;
+    }
+    gc_started = true;
+    return 0;
+}
+
+void fs_scan_gc_stop(void)
+{
+    if (!gc_started)
+        return;
+
+    P(gc_lock);
+    gc_terminate = true;
+    pthread_cond_broadcast(&gc_cond);
+    V(gc_lock);
+
+    pthread_join(gc_thread, NULL);
+    gc_started = false;
+}
+
+bool fs_scan_gc_enabled(void)
+{
+    return gc_started;
+}
+
+void fs_scan_gc_request(time_t gen, bool wait)
+{
+    P(gc_lock);
+    if (gen > gc_pending)
+        gc_pending = gen;
+    pthread_cond_broadcast(&gc_cond);
+
+    if (wait)
+    {
+        while (gc_done < gen && !gc_terminate)
+            pthread_cond_wait(&gc_cond, &gc_lock);
+    }
+    V(gc_lock);
+}
+
+void fs_scan_gc_stats(robinhood_fsscan_stat_t *p_stats)
+{
+    P(gc_lock);
+    p_stats->gc_generation = gc_current;
+    p_stats->gc_start_time = gc_start_time;
+    p_stats->gc_estimated = gc_estimated;
+    p_stats->gc_rm_entries = gc_rm_entries;
+    p_stats->gc_rm_names = gc_rm_names;
+    V(gc_lock);
+}
@@ -27,6 +27,7 @@
 #include <pthread.h>
 #include <errno.h>
 #include <unistd.h>
+#include <inttypes.h>
 
 static pthread_t scan_starter_thread;
 static pthread_attr_t starter_attr;
@@ -149,6 +150,15 @@ void FSScan_StoreStats( lmgr_t * lmgr )
     sprintf(tmp_buff, "%u", stats.nb_hang);
     ListMgr_SetVar( lmgr, LAST_SCAN_TIMEOUTS, tmp_buff);
 
+    if (stats.gc_generation != 0)
+    {
+        sprintf(tmp_buff, "%"PRIu64"/%"PRIu64, stats.gc_rm_entries,
+                stats.gc_estimated);
+        ListMgr_SetVar(lmgr, GC_PROGRESS_VAR, tmp_buff);
+    }
+    else
+        ListMgr_SetVar(lmgr, GC_PROGRESS_VAR, NULL);
+
 }
 
 
@@ -224,6 +234,29 @@ void FSScan_DumpStats( void )
     if (stats.nb_hang > 0)
         DisplayLog( LVL_MAJOR, "STATS", "scan operation timeouts = %u", stats.nb_hang );
 
+    if (stats.gc_generation != 0)
+    {
+        time_t   now = time(NULL);
+        uint64_t done = stats.gc_rm_entries;
+
+        DisplayLog(LVL_MAJOR, "STATS", "garbage collection is running:");
+        strftime(tmp_buff, 256, "%Y/%m/%d %T", localtime_r(&stats.gc_generation, &paramtm));
+        DisplayLog(LVL_MAJOR, "STATS", "     removing entries not seen since %s", tmp_buff);
+        DisplayLog(LVL_MAJOR, "STATS", "     progress   : %"PRIu64"/%"PRIu64" entries, "
+                   "%"PRIu64" names removed", done, stats.gc_estimated,
+                   stats.gc_rm_names);
+
+        if (done > 0 && done < stats.gc_estimated && now > stats.gc_start_time)
+        {
+            double rate = (double)done / (double)(now - stats.gc_start_time);
+
+            FormatDurationFloat(tmp_buff, 256,
+                                (time_t)((double)(stats.gc_estimated - done) / rate));
+            DisplayLog(LVL_MAJOR, "STATS", "     speed      : %.2f entries/sec "
+                       "(ETA: %s)", rate, tmp_buff);
+        }
+    }
+
 }
 
 /* ------------ Config management functions --------------- */
@@ -252,6 +285,9 @@ static void fs_scan_cfg_set_default(void *module_config)
     conf->nb_threads_scan = 2;
     conf->scan_op_timeout = 0;
     conf->exit_on_timeout = false;
+    conf->bulk_load = false;
+    conf->gc_chunk_size = 10000;
+    conf->gc_background = false;
     conf->spooler_check_interval = MINUTE;
     conf->nb_prealloc_tasks = 256;
 
@@ -274,6 +310,9 @@ static void fs_scan_cfg_write_default(FILE *output)
     print_line(output, 1, "nb_threads_scan        :     2");
     print_line(output, 1, "scan_op_timeout        :     0 (disabled)");
     print_line(output, 1, "exit_on_timeout        :    no");
+    print_line(output, 1, "bulk_load              :    no");
+    print_line(output, 1, "gc_chunk_size          : 10000");
+    print_line(output, 1, "gc_background          :    no");
     print_line(output, 1, "spooler_check_interval :  1min");
     print_line(output, 1, "nb_prealloc_tasks      :   256");
     print_line(output, 1, "ignore                 :  NONE");
@@ -301,7 +340,7 @@ static int fs_scan_cfg_read(config_file_t config, void *module_config, char *msg
         "scan_interval", "min_scan_interval", "max_scan_interval",
         "scan_retry_delay", "nb_threads_scan", "scan_op_timeout",
         "exit_on_timeout", "spooler_check_interval", "nb_prealloc_tasks",
-		"completion_command",
+		"completion_command", "bulk_load", "gc_chunk_size", "gc_background",
         IGNORE_BLOCK, NULL
     };
 
@@ -312,6 +351,9 @@ static int fs_scan_cfg_read(config_file_t config, void *module_config, char *msg
             &conf->scan_retry_delay, 0},
         {"scan_op_timeout", PT_DURATION, PFLG_POSITIVE, &conf->scan_op_timeout, 0},
         {"exit_on_timeout", PT_BOOL, 0, &conf->exit_on_timeout, 0},
+        {"bulk_load", PT_BOOL, 0, &conf->bulk_load, 0},
+        {"gc_chunk_size", PT_INT, PFLG_POSITIVE, &conf->gc_chunk_size, 0},
+        {"gc_background", PT_BOOL, 0, &conf->gc_background, 0},
         {"spooler_check_interval", PT_DURATION, PFLG_POSITIVE | PFLG_NOT_NULL,
             &conf->spooler_check_interval, 0},
         {"nb_prealloc_tasks", PT_INT, PFLG_POSITIVE | PFLG_NOT_NULL,
@@ -526,6 +568,38 @@ static int fs_scan_cfg_reload(fs_scan_config_t *conf)
     }
 
 
+    if (conf->bulk_load != fs_scan_config.bulk_load)
+    {
+        DisplayLog(LVL_EVENT, "FS_Scan_Config",
+                   FSSCAN_CONFIG_BLOCK "::bulk_load updated: %s->%s",
+                   bool2str(fs_scan_config.bulk_load), bool2str(conf->bulk_load));
+        fs_scan_config.bulk_load = conf->bulk_load;
+    }
+
+    if (conf->gc_background != fs_scan_config.gc_background)
+    {
+        DisplayLog(LVL_EVENT, "FS_Scan_Config",
+                   FSSCAN_CONFIG_BLOCK "::gc_background updated: %s->%s",
+                   bool2str(fs_scan_config.gc_background), bool2str(conf->gc_background));
+        fs_scan_config.gc_background = conf->gc_background;
+    }
+
+    /* GC thread is only started if gc_chunk_size != 0 */
+    if (conf->gc_chunk_size != fs_scan_config.gc_chunk_size)
+    {
+        if ((conf->gc_chunk_size == 0) != (fs_scan_config.gc_chunk_size == 0))
+            DisplayLog(LVL_MAJOR, "FS_Scan_Config",
+                       FSSCAN_CONFIG_BLOCK "::gc_chunk_size enabled or disabled "
+                       "in config file, but this cannot be modified dynamically");
+        else
+        {
+            DisplayLog(LVL_EVENT, "FS_Scan_Config",
+                       FSSCAN_CONFIG_BLOCK "::gc_chunk_size updated: %u->%u",
+                       fs_scan_config.gc_chunk_size, conf->gc_chunk_size);
+            fs_scan_config.gc_chunk_size = conf->gc_chunk_size;
+        }
+    }
+
     /* Parameters that canNOT be modified dynamically */
 
     if ( conf->nb_threads_scan != fs_scan_config.nb_threads_scan )
@@ -595,6 +669,18 @@ static void fs_scan_cfg_write_template(FILE *output)
     print_line( output, 1, "# {fspath} = path to managed filesystem");
     print_line( output, 1, "#completion_command     =    \"/path/to/my/script.sh -f {cfg} -p {fspath}\" ;" );
     fprintf( output, "\n" );
+    print_line( output, 1, "# Initial scan of an empty database: drop accounting triggers and");
+    print_line( output, 1, "# secondary indexes during the load, and build them at the end.");
+    print_line( output, 1, "# No other robinhood instance should run on this DB meanwhile.");
+    print_line( output, 1, "#bulk_load              =    yes ;" );
+    fprintf( output, "\n" );
+    print_line( output, 1, "# Entries not seen during a scan are removed by chunks of");
+    print_line( output, 1, "# gc_chunk_size entries (0 to remove them in a single transaction).");
+    print_line( output, 1, "# If gc_background is enabled, the scan terminates without waiting");
+    print_line( output, 1, "# for their removal.");
+    print_line( output, 1, "#gc_chunk_size          =    10000 ;" );
+    print_line( output, 1, "#gc_background          =    yes ;" );
+    fprintf( output, "\n" );
 
     print_line( output, 1,
                 "# Internal scheduler granularity (for testing and of scan, hangs, ...)" );
@@ -38,6 +38,10 @@ typedef struct mdt_def_t
 {
     char           mdt_name[MDT_NAME_MAX];
     char           reader_id[READER_ID_MAX];
+    /** read records from this changelog journal instead of the MDT */
+    char           source_file[RBH_PATH_MAX];
+    /** append read records to this changelog journal */
+    char           record_file[RBH_PATH_MAX];
 } mdt_def_t;
 
 /** Configuration for ChangeLog reader Module */
@@ -26,6 +26,7 @@
 
 #include "rbh_const.h"
 #include <stdbool.h>
+#include <time.h>
 
 #ifdef _MYSQL
 
@@ -55,19 +56,40 @@ typedef struct db_config_t
 
 #include <sqlite3.h>
 
-typedef sqlite3 *db_conn_t;
+struct sqlite_stmt_cache;
+
+typedef struct db_conn_t
+{
+    sqlite3                  *db;
+    /* prepared statements kept for reuse */
+    struct sqlite_stmt_cache *stmt_cache;
+    /* used by path functions (one_path, this_path) */
+    sqlite3_stmt             *names_stmt;
+} db_conn_t;
+
 typedef struct result_handle_t
 {
+    /* results are streamed from this statement */
+    sqlite3_stmt  *stmt;
+    int            step_rc; /* result of the last sqlite3_step() */
+    bool           pending; /* current row was not returned yet */
+    int            nb_cols;
+
+    /* remaining rows, copied when their count is requested */
     char         **result_array;
     unsigned int   curr_row;
     int            nb_rows;
-    int            nb_cols;
 } result_handle_t;
 
 typedef struct db_config_t
 {
     char           filepath[RBH_PATH_MAX];
     unsigned int   retry_delay_microsec;         /* retry time when busy */
+    time_t         busy_timeout;  /* give up waiting for a lock (0=never) */
+    char           journal_mode[16];
+    char           synchronous[16];
+    unsigned long long cache_size; /* page cache size (bytes) */
+    unsigned int   stmt_cache_size; /* prepared statements per connection */
 } db_config_t;
 
 
@@ -20,6 +20,7 @@
 #define _ENTRY_PROC_HASH_H
 
 #include <glib.h>
+#include "rbh_misc.h"
 
 /* A hash table slot. */
 struct id_hash_slot {
@@ -48,29 +49,6 @@ void id_hash_stats(struct id_hash *id_hash, const char *log_str);
 void id_hash_dump(struct id_hash *id_hash, bool parent);
 
 
-/**
- * Murmur3 uint64 finalizer
- * from: https://github.com/aappleby/smhasher/blob/master/src/MurmurHash3.cpp
- */
-static inline uint64_t __hash64(uint64_t k)
-{
-    k ^= k >> 33;
-    k *= 0xff51afd7ed558ccdLLU;
-    k ^= k >> 33;
-    k *= 0xc4ceb9fe1a85ec53LLU;
-    k ^= k >> 33;
-    return k;
-}
-
-static inline uint64_t id_hash64(const entry_id_t * p_id)
-{
-#ifdef FID_PK
-    return __hash64(p_id->f_seq ^ p_id->f_oid);
-#else
-    return __hash64(p_id->fs_key ^ p_id->inode);
-#endif
-}
-
 static inline unsigned int hash_id(const entry_id_t * p_id, unsigned int modulo)
 {
     return id_hash64(p_id) % modulo;
@@ -246,6 +246,16 @@ int            EntryProcessor_Acknowledge(entry_proc_op_t * p_op,
 int EntryProcessor_AcknowledgeBatch(entry_proc_op_t **p_op, unsigned int count,
                                     unsigned int next_stage, bool remove);
 
+/**
+ * Acknowledge a batch of operations that go to different stages.
+ * @param next_stage next stage of each operation
+ * @param remove     indicates for each operation if it must be removed
+ *                   from the pipeline.
+ */
+int EntryProcessor_AcknowledgeEach(entry_proc_op_t **p_op, unsigned int count,
+                                   const unsigned int *next_stage,
+                                   const bool *remove);
+
 /**
  * Set entry id.
  */
@@ -267,6 +277,12 @@ entry_proc_op_t * EntryProcessor_Get( void );
  */
 void EntryProcessor_Release( entry_proc_op_t * p_op );
 
+/**
+ * Number of operations currently in the pipeline
+ * (to let background tasks yield to entry processing).
+ */
+unsigned int EntryProcessor_PendingOps(void);
+
 /**
  * Dump info about pipeline stages
  */
@@ -57,6 +57,15 @@ typedef struct fs_scan_config_t
     time_t       scan_op_timeout;
     bool         exit_on_timeout;
 
+    /** load the initial scan into an empty DB in bulk mode */
+    bool         bulk_load;
+
+    /** number of entries removed per transaction by garbage collection
+     * of entries not seen during a scan (0 for a single mass removal) */
+    unsigned int gc_chunk_size;
+    /** don't wait for garbage collection to complete at the end of scans */
+    bool         gc_background;
+
     /**
      * interval of the spooler (checks for audits to be launched,
      * thread hangs, ...) */
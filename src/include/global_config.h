@@ -53,6 +53,11 @@ typedef struct global_config_t
     bool          last_access_only_atime;
     bool          uid_gid_as_numbers;
 
+    /* time-to-live of cached user/group names */
+    time_t        uid_gid_cache_ttl;
+    /* time-to-live of cached unknown uids/gids */
+    time_t        uid_gid_cache_negative_ttl;
+
 #if defined( _LUSTRE ) && defined ( _MDS_STAT_SUPPORT )
     /** Direct stat to MDS on Lustre filesystems */
     bool          direct_mds_stat;
@@ -162,6 +162,16 @@ typedef enum {
     OPCOUNT
 } op_idx_e;
 
+/** tables whose changes are counted, to invalidate cached reports */
+typedef enum {
+    CHGIDX_MAIN,
+    CHGIDX_ANNEX,
+    CHGIDX_NAMES,
+    CHGIDX_STRIPE,
+
+    CHGCOUNT
+} chg_idx_e;
+
 /** Connection related information for a thread */
 typedef struct lmgr_t
 {
@@ -177,6 +187,9 @@ typedef struct lmgr_t
     /* operation statistics */
     unsigned int nbop[OPCOUNT];
 
+    /* changes not yet reported to the persistent change counters */
+    unsigned int chg_pending[CHGCOUNT];
+
 } lmgr_t;
 
 /** List manager configuration */
@@ -189,6 +202,26 @@ typedef struct lmgr_config_t
 
     /** enable accounting */
     bool acct;
+
+    /** time attribute indexed per OST in OST_LRU table
+     * (ATTR_INDEX_FLG_UNSPEC if disabled) */
+    unsigned int ost_lru_attr;
+
+    /** cache report results in the database, until the tables they
+     * depend on are modified. Modifications are only counted by processes
+     * that have it enabled, so it must be set for all processes
+     * updating the database. */
+    bool report_cache;
+
+    /** number of DB connections to compute large reports
+     * (1 to disable parallel reports) */
+    unsigned int report_parallel;
+
+    /** max number of entries in the in-memory entry cache (0 to disable) */
+    unsigned int entry_cache_size;
+    /** max age of entry cache entries (to limit the effect of DB changes
+     * made by other processes) */
+    time_t entry_cache_max_age;
 } lmgr_config_t;
 
 /** config handlers */
@@ -217,6 +250,15 @@ typedef struct lmgr_iter_opt_t
     unsigned int   list_count_max;               /* max entries to be returned by iterator or report */
     unsigned int   force_no_acct:1;              /* don't use acct table for reports */
     unsigned int   allow_no_attr:1;              /* allow returning entries if no attr is available */
+
+    /* Keyset pagination (iterators only): entries are sorted by
+     * (sort attribute, id), and if after_set is specified, only entries
+     * following the given one in this order are returned. */
+    unsigned int   keyset:1;
+    unsigned int   after_set:1;
+    unsigned int   after_null:1;                 /* sort value of 'after' entry is NULL */
+    long long      after_val;                    /* sort value of 'after' entry */
+    entry_id_t     after_id;
 } lmgr_iter_opt_t;
 #define LMGR_ITER_OPT_INIT {.list_count_max = 0, .force_no_acct = 0, .allow_no_attr = 0}
 
@@ -597,6 +639,21 @@ int            ListMgr_InitAccess( lmgr_t * p_mgr );
 /** Close a connection to the database */
 int            ListMgr_CloseAccess( lmgr_t * p_mgr );
 
+/**
+ * Switch an empty database to bulk-load mode, for its initial filling:
+ * accounting triggers, accounting table and secondary indexes are dropped.
+ * If the load is interrupted, normal mode is restored by the next
+ * ListMgr_Init().
+ * @return DB_NOT_ALLOWED if the database is not empty.
+ */
+int            ListMgr_BulkLoadStart(lmgr_t *p_mgr);
+
+/**
+ * Leave bulk-load mode: build indexes, then build accounting table
+ * from the database contents and re-create triggers.
+ */
+int            ListMgr_BulkLoadEnd(lmgr_t *p_mgr);
+
 /**
  * Set force commit behavior.
  * Default is false;
@@ -610,6 +667,14 @@ void           ListMgr_ForceCommitFlag(lmgr_t * p_mgr, bool force_commit);
  */
 bool           ListMgr_GetCommitStatus(lmgr_t *p_mgr);
 
+/**
+ * Start a read-only transaction so that all following requests
+ * see a consistent snapshot of the database.
+ * Must be terminated by ListMgr_EndSnapshot().
+ */
+int            ListMgr_BeginSnapshot(lmgr_t *p_mgr);
+int            ListMgr_EndSnapshot(lmgr_t *p_mgr);
+
 
 /**
  * Tests if this entry exists in the database.
@@ -649,6 +714,43 @@ int            ListMgr_SetStripe( lmgr_t * p_mgr, const entry_id_t * p_id,
  */
 int            ListMgr_Get( lmgr_t * p_mgr, const entry_id_t * p_id, attr_set_t * p_info );
 
+/**
+ * Same as ListMgr_Get(), but get the entry from the in-memory entry cache
+ * if all the requested attributes are cached (see entry_cache_size).
+ */
+int            ListMgr_CachedGet(lmgr_t *p_mgr, const entry_id_t *p_id,
+                                 attr_set_t *p_info);
+
+/**
+ * Retrieve several entries from database, with a single request per table.
+ * All attribute sets must request the same attributes, and entry ids
+ * must be distinct.
+ * @param[out] rcs status for each entry (DB_SUCCESS, DB_NOT_EXISTS...).
+ * @return DB_SUCCESS, or an error that applies to the whole batch.
+ */
+int            ListMgr_BatchGet(lmgr_t *p_mgr, unsigned int count,
+                                const entry_id_t **ids, attr_set_t **attrs,
+                                int *rcs);
+
+/** Same as ListMgr_BatchGet(), using the in-memory entry cache. */
+int            ListMgr_CachedBatchGet(lmgr_t *p_mgr, unsigned int count,
+                                      const entry_id_t **ids,
+                                      attr_set_t **attrs, int *rcs);
+
+/** entry cache statistics */
+typedef struct lmgr_cache_stats_t
+{
+    unsigned int count;
+    unsigned int max_count;
+    uint64_t     hits;
+    uint64_t     misses;
+    uint64_t     evictions;
+    uint64_t     invalidations;
+} lmgr_cache_stats_t;
+
+/** get entry cache statistics (all zero if the cache is disabled) */
+void           ListMgr_EntryCacheStats(lmgr_cache_stats_t *stats);
+
 /**
  * Retrieve the FID from the database given the parent FID and the
  * file name.
@@ -730,11 +832,56 @@ int ListMgr_SoftRemove(lmgr_t *p_mgr, const entry_id_t *p_id,
 int ListMgr_MassSoftRemove(lmgr_t *p_mgr, const lmgr_filter_t *p_filter,
                            time_t rm_time, rm_cb_func_t);
 
+/** Position of a garbage collection pass between chunks.
+ * Must be zeroed before the first call to ListMgr_GCChunk().
+ */
+typedef struct lmgr_gc_pos_t {
+    entry_id_t  last_id;       /**< last entry id processed */
+    bool        id_set;        /**< last_id is set */
+    bool        entries_done;  /**< all entries have been processed */
+    char        last_pkn[64];  /**< last name key processed ("" if none) */
+    bool        names_done;    /**< all names have been processed */
+} lmgr_gc_pos_t;
+
+/**
+ * Garbage-collect a bounded chunk of entries that were not seen
+ * by the scan of generation 'gen' (i.e. md_update < gen), then of names
+ * (path_update < gen) once all such entries are removed.
+ * Each call runs in its own short transaction, so that garbage collection
+ * can be interrupted and resumed at any time.
+ * Entries and names are walked in key order from the position saved in
+ * p_pos, so each chunk only reads the next range of keys. The generation
+ * is checked again when deleting, so an item updated in the meantime
+ * (e.g. by changelog processing) is kept.
+ * @param soft_rm move removed entries to the SOFT_RM table.
+ * @param max_count maximum number of items to process.
+ * @param[in,out] p_pos position of garbage collection, updated on success.
+ *                Garbage collection is complete when p_pos->names_done is set.
+ * @param[out] rm_entries number of removed entries.
+ * @param[out] rm_names number of removed names.
+ */
+int ListMgr_GCChunk(lmgr_t *p_mgr, time_t gen, bool soft_rm, time_t rm_time,
+                    unsigned int max_count, rm_cb_func_t cb_func,
+                    lmgr_gc_pos_t *p_pos, unsigned int *rm_entries,
+                    unsigned int *rm_names);
+
+/**
+ * Count entries not seen since generation 'gen'
+ * (to estimate the progress of garbage collection).
+ */
+int ListMgr_GCCount(lmgr_t *p_mgr, time_t gen, uint64_t *count);
+
 /**
  * Definitely remove an entry from the delayed removal table.
  */
 int ListMgr_SoftRemove_Discard(lmgr_t *p_mgr, const entry_id_t *p_id);
 
+/**
+ * Definitely remove a set of entries from the delayed removal table.
+ */
+int ListMgr_SoftRemove_DiscardBatch(lmgr_t *p_mgr, const entry_id_t *p_ids,
+                                    unsigned int count);
+
 /**
  * Initialize a list of items removed 'softly', sorted by expiration time.
  * Selecting 'expired' entries is done using an rm_time criteria in p_filter
@@ -1073,6 +1220,9 @@ void           ListMgr_CloseProfile( struct lmgr_profile_t *p_iter );
 #define LAST_POLICY_END_SUFFIX      "_end"
 #define LAST_POLICY_TRIGGER_SUFFIX  "_trigger" /* trigger type and target */
 #define LAST_POLICY_STATUS_SUFFIX   "_status"  /* status & stats about last run */
+#define LAST_POLICY_STATS_SUFFIX    "_run_stats" /* machine-readable stats about last run */
+/* <action count>;<volume>;<duration>;<nb_threads> */
+#define LAST_POLICY_STATS_FMT       "%llu;%llu;%u;%u"
 #define CURR_POLICY_START_SUFFIX    "_start_current" /* start of current run */
 #define CURR_POLICY_TRIGGER_SUFFIX  "_trigger_current" /* trigger of current run */
 
@@ -1094,6 +1244,11 @@ void           ListMgr_CloseProfile( struct lmgr_profile_t *p_iter );
 #define LAST_SCAN_CURMSPE     "LastScanCurMsPerEntry"
 #define LAST_SCAN_NB_THREADS  "LastScanNbThreads"
 
+/* generation of the pending garbage collection (scan start time) */
+#define GC_GENERATION_VAR     "GCGeneration"
+/* progress of garbage collection (removed/estimated entries) */
+#define GC_PROGRESS_VAR       "GCProgress"
+
 #define PREV_SCAN_START_TIME  "PrevScanStartTime"
 #define PREV_SCAN_END_TIME    "PrevScanEndTime"
 
@@ -1190,6 +1345,76 @@ int convert_boolexpr_to_simple_filter(struct bool_node_t *boolexpr, lmgr_filter_
                                       const struct time_modifier *time_mod,
                                       int flags);
 
+/** Result of lmgr_pushdown_boolexpr() */
+typedef struct lmgr_pushdown {
+    /** part of the expression to be checked locally (NULL if none) */
+    struct bool_node_t *residual;
+    /* nodes allocated to build the residual expression */
+    struct bool_node_t *nodes;
+    unsigned int        node_count;
+} lmgr_pushdown_t;
+
+/** flags for lmgr_pushdown_boolexpr() */
+#define PUSHDOWN_SKIP_NAMES 0x00000001 /* names are not filtered by the request
+                                          (e.g. ListMgr_GetChild) */
+
+/**
+ * Translate a boolean expression to a DB filter, so that as few entries as
+ * possible have to be matched locally with entry_matches().
+ *
+ * The top-level expression is split into AND-ed terms (NOT are propagated
+ * to conditions). Each term is either:
+ *  - pushed to the DB, when the DB condition is exactly the same;
+ *  - pushed to the DB as a pre-filter (the DB returns a larger set)
+ *    and also checked locally, e.g. for some patterns;
+ *  - only checked locally (no DB field, OR across several tables...).
+ * OR of conditions are pushed if they all apply to the same table,
+ * so that the filter can be used with any listmgr call.
+ * Like entry_matches(), an entry with a missing attribute doesn't match.
+ *
+ * @param[in]     boolexpr  the boolean expression to be converted.
+ * @param[in,out] filter    the output filter to be appended.
+ * @param[in]     smi       the current status manager (if any).
+ * @param[in]     time_mod  time modifier for maintenance mode.
+ * @param[in]     flags     PUSHDOWN_* flags.
+ * @param[out]    pd        if not NULL, set to the expression to be checked
+ *                          locally. It refers to parts of boolexpr and must
+ *                          be released with lmgr_pushdown_free().
+ * @param[out]    explain   if not NULL, a description of what is pushed to
+ *                          the DB is appended to it.
+ */
+int lmgr_pushdown_boolexpr(struct bool_node_t *boolexpr, lmgr_filter_t *filter,
+                           const struct sm_instance *smi,
+                           const struct time_modifier *time_mod, int flags,
+                           lmgr_pushdown_t *pd, GString *explain);
+
+/** release the residual expression of lmgr_pushdown_boolexpr() */
+void lmgr_pushdown_free(lmgr_pushdown_t *pd);
+
+/** Expression of lmgr_pushdown_or() */
+typedef struct lmgr_or_expr {
+    struct bool_node_t         *boolexpr;
+    const struct sm_instance   *smi;      /* status manager (if any) */
+    const struct time_modifier *time_mod; /* time modifier (if any) */
+} lmgr_or_expr_t;
+
+/**
+ * Append to a filter a DB condition returning (at least) the entries
+ * matching any of the given expressions, e.g. the scopes of several policies.
+ * As filters only support one level of parenthesing, and OR of conditions
+ * on a single table, each expression is represented by one of its AND-ed
+ * conditions on the main table: the filter returns a larger set, so entries
+ * must still be matched locally.
+ * @return DB_INVALID_ARG if an expression has no such condition
+ *         (nothing is appended to the filter in this case).
+ */
+int lmgr_pushdown_or(const lmgr_or_expr_t *exprs, unsigned int count,
+                     lmgr_filter_t *filter);
+
+/** Append the SQL condition of a filter to a string (for information) */
+int lmgr_filter2sql(lmgr_t *p_mgr, const lmgr_filter_t *p_filter,
+                    GString *where);
+
 /** Set a complex filter structure */
 int            lmgr_set_filter_expression( lmgr_filter_t * p_filter, struct bool_node_t *boolexpr );
 
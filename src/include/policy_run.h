@@ -98,6 +98,15 @@ typedef struct trigger_item_t
     /* min time to wait between 2 trigger applications */
     time_t         post_trigger_wait;
 
+    /* predictive mode: start a policy run when usage is expected to reach
+     * the high threshold within this delay (0 = disabled).
+     * Early runs only apply to global_usage triggers: for ost_usage and
+     * pool_usage, the prediction (made on the fullest target) only makes
+     * usage sampled more often as the threshold comes closer. */
+    time_t         predict_horizon;
+    /* min interval between 2 usage samples in predictive mode */
+    time_t         min_check_interval;
+
     /* trigger options: */
     /* raise alert when it is triggered */
     bool alert_hw;
@@ -146,10 +155,31 @@ typedef struct policy_run_config_t
     unsigned int   nb_threads;
     unsigned int   queue_size;
     unsigned int   db_request_limit;
+    /** max number of entries a worker submits at once to a status manager
+     * that supports batched actions (1 = no batching). */
+    unsigned int   action_batch_size;
+    /** number of queued entries checked in advance (lstat, status...)
+     * by prefetch threads while workers run actions (0 = disabled). */
+    unsigned int   check_prefetch;
+
+    /** priority of the policy to get action slots, when the number of
+     * running actions is limited for all policies (higher first). */
+    unsigned int   priority;
+    /** list candidates together with other policies running at
+     * the same time (shared DB scan). */
+    bool           shared_scan;
 
     unsigned int   max_action_nbr; /* can also be specified in each trigger */
     ull_t          max_action_vol; /* can also be specified in each trigger */
 
+    /* sustained rate limits while a policy run proceeds (0 = no limit) */
+    double         max_action_rate; /**< actions per second */
+    ull_t          max_bandwidth;   /**< volume of processed entries per second */
+    double         max_db_op_rate;  /**< DB operations of workers per second */
+    /** reduce the number of running actions when their average latency
+     * exceeds this value, in seconds (0 = disabled) */
+    double         target_action_latency;
+
     trigger_item_t *trigger_list;
     unsigned int   trigger_count;
 
@@ -159,6 +189,11 @@ typedef struct policy_run_config_t
     /** interval for reporting progress of current policy run */
     time_t         report_interval;
 
+    /** user/group usage for checking triggers is kept in memory and
+     * updated by the entry processor. This is the max delay before
+     * reloading it from the DB (0 = always query the DB) */
+    time_t         usage_cache_max_age;
+
     /* maintenance related option */
     /** is this policy influenced by maintenance mecanism */
     bool           maintenance_sensitive;
@@ -262,6 +297,30 @@ typedef enum
     TRIG_UNSUPPORTED                             /* Trigger not supported in this mode */
 } trigger_status_t;
 
+/** number of usage samples kept to estimate the fill rate of a target */
+#define USAGE_SAMPLES_MAX   32
+
+typedef struct usage_sample_t
+{
+    time_t  time;
+    double  value; /* in the unit of the trigger high threshold */
+} usage_sample_t;
+
+/** usage history of a predictive trigger */
+typedef struct usage_model_t
+{
+    usage_sample_t samples[USAGE_SAMPLES_MAX]; /* circular buffer */
+    unsigned int   first;
+    unsigned int   count;
+
+    time_t         next_sample;
+    time_t         last_early_run;
+
+    /* last estimation */
+    double         fill_rate;  /* threshold unit per second */
+    time_t         hw_eta;     /* expected time to reach high threshold (0=never) */
+} usage_model_t;
+
 /* Info about each trigger */
 typedef struct trigger_status__
 {
@@ -277,9 +336,35 @@ typedef struct trigger_status__
     double         last_usage;
     /* for inode based thresholds */
     ull_t          last_count;
+
+    /* for predictive triggers */
+    usage_model_t  model;
 } trigger_info_t;
 
 
+/** token bucket */
+typedef struct rate_limiter_t {
+    pthread_mutex_t lock;
+    double          tokens;
+    struct timeval  last;  /**< last refill */
+    ull_t           total; /**< amount taken since the beginning of the run */
+} rate_limiter_t;
+
+/** throttling of policy actions */
+typedef struct policy_throttle_t {
+    rate_limiter_t  actions;
+    rate_limiter_t  bytes;
+    rate_limiter_t  db_ops;
+
+    /* number of running actions, adapted to action latency */
+    pthread_mutex_t lock;
+    pthread_cond_t  cond;
+    unsigned int    running;
+    unsigned int    admit_max;
+    double          latency; /**< moving average of action latency (sec) */
+    time_t          last_adjust;
+} policy_throttle_t;
+
 /* policy runtime information */
 typedef struct policy_info_t
 {
@@ -287,16 +372,20 @@ typedef struct policy_info_t
     policy_run_config_t *config; /* policy run configuration */
     const action_params_t *trigger_action_params; /* action parameters from trigger */
     entry_queue_t    queue;  /* processing queue */
+    entry_queue_t    checked_queue; /* entries checked in advance (prefetch) */
     pthread_t       *threads; /* worker threads array (size in config) */
+    pthread_t       *prefetch_threads; /* check prefetch threads (size nb_threads) */
     pthread_t        trigger_thr; /* trigger checker thread */
     lmgr_t           lmgr; /* db connexion for triggers */
     trigger_info_t  *trigger_info; /* stats about policy triggers */
     dev_t            fs_dev; /* to check if filesystem is unmounted */
     action_summary_t progress;
+    policy_throttle_t throttle;
     time_t           first_eligible;
     time_modifier_t *time_modifier;
     time_t           gcd_interval; /* gcd of check intervals (gcd(triggers))*/
     run_flags_t      flags; /* from policy_opt */
+    unsigned int     sched_waiting; /* workers waiting for an action slot */
     unsigned int     aborted:1; /* abort status */
     volatile unsigned int waiting:1; /* a thread is already trying to join the trigger thread */
 } policy_info_t;
@@ -305,6 +394,15 @@ typedef struct policy_info_t
 typedef struct policy_run_config_list_t {
     policy_run_config_t *configs;
     unsigned int count;
+
+    /* 'policy_scheduler' parameters, common to all policies */
+
+    /** max number of actions running at once for all policies
+     * (0 = no limit, each policy runs up to nb_threads actions) */
+    unsigned int max_running_actions;
+    /** time a policy run waits for other policies to join
+     * its candidate scan */
+    time_t       shared_scan_delay;
 } policy_run_config_list_t;
 /** defined in policies/policy_run_cfg.c */
 extern policy_run_config_list_t run_cfgs;
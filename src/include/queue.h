@@ -20,23 +20,34 @@
 #include <semaphore.h>
 #include <time.h>
 #include <pthread.h>
+#include <stdbool.h>
 
 #ifndef _QUEUE_MNGMT_H
 #define _QUEUE_MNGMT_H
 
+/** number of stripes for status and feedback counters:
+ * threads update the counters of their own stripe, and counters
+ * are summed on read. */
+#define QUEUE_STAT_SLOTS  16
+
+/** slot of the cyclic array */
+typedef struct queue_cell_t
+{
+    /** sequence number of the slot, to synchronize producers and consumers */
+    unsigned long  seq;
+    void          *data;
+} queue_cell_t;
+
 typedef struct entry_queue_t
 {
-    /* cyclic array of entries */
-    void         **queue;
+    /* cyclic array of entries (lock-free multi-producer/multi-consumer) */
+    queue_cell_t  *queue;
 
     /* size and indexes */
-    unsigned int   array_size;
+    unsigned int   array_size; /* power of 2 */
     unsigned int   queue_size;
-    unsigned int   first_index;
-    unsigned int   last_index;
-
-    /* mutex for accessing the queue */
-    pthread_mutex_t queue_lock;
+    unsigned long  first_index; /* next slot to be read */
+    unsigned long  last_index;  /* next slot to be written */
 
     /* token for free slots */
     sem_t          sem_empty;
@@ -52,14 +63,15 @@ typedef struct entry_queue_t
     /* idle threads */
     unsigned int   nb_thr_waiting;
 
-    /* array of status count */
+    /* array of status count (QUEUE_STAT_SLOTS stripes) */
     unsigned int  *status_array;
     unsigned int   status_count;
+    unsigned int   status_stride;
 
-    /* special fields for counting feedback info */
+    /* special fields for counting feedback info (QUEUE_STAT_SLOTS stripes) */
     unsigned long long *feedback_array;
     unsigned int   feedback_count;
-
+    unsigned int   feedback_stride;
 
 } entry_queue_t;
 
@@ -73,6 +85,12 @@ typedef struct entry_queue_t
 int            CreateQueue( entry_queue_t * p_queue, unsigned int queue_size,
                             unsigned int max_status, unsigned int feedback_count );
 
+/**
+ * Release the resources of a queue.
+ * The queue must be empty and no thread must be using it.
+ */
+void           DestroyQueue( entry_queue_t * p_queue );
+
 /**
  * Reset status info
  */
@@ -100,6 +118,25 @@ int            Queue_Insert( entry_queue_t * p_queue, void *entry );
 int            Queue_Get( entry_queue_t * p_queue, void **p_ptr );
 
 
+/**
+ * Get an entry from the queue without blocking.
+ * Returns EAGAIN if the queue is empty.
+ */
+int            Queue_TryGet( entry_queue_t * p_queue, void **p_ptr );
+
+
+/**
+ * Get up to 'max' entries from the queue.
+ * If 'block' is true, the call is blocking until there is at least
+ * one element available in the queue.
+ * Returns EAGAIN if the queue is empty and 'block' is false.
+ * @param[out] count number of returned entries.
+ */
+int            Queue_GetBatch( entry_queue_t * p_queue, void **p_ptrs,
+                               unsigned int max, unsigned int *count,
+                               bool block );
+
+
 /**
  * Acknwoledge when an entry has been handled.
  * Indicates the status and optionnal feedback info (as unsigned long long array).
@@ -109,6 +146,17 @@ void           Queue_Acknowledge( entry_queue_t * p_queue, unsigned int status,
                                   unsigned long long *feedback_array, unsigned int feedback_count );
 
 
+/**
+ * Acknowledge a set of entries at once.
+ * @param status array of 'count' status.
+ * @param feedback_array array of count * feedback_count values (may be NULL).
+ */
+void           Queue_AcknowledgeBatch( entry_queue_t * p_queue, unsigned int count,
+                                       const unsigned int *status,
+                                       const unsigned long long *feedback_array,
+                                       unsigned int feedback_count );
+
+
 void           RetrieveQueueStats( entry_queue_t * p_queue, unsigned int *p_nb_thr_wait,
                                    unsigned int *p_nb_items, time_t * p_last_submitted,
                                    time_t * p_last_unqueued, time_t * p_last_ack,
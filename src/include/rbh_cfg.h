@@ -65,6 +65,7 @@ typedef enum run_flags {
     RUNFLG_CHECK_ONLY = (1 << 4), /* only check triggers, don't purge */
     RUNFLG_NO_GC      = (1 << 5), /* don't clean orphan entries after scan */
     RUNFLG_FORCE_RUN  = (1 << 6), /* force running policy even if no scan was complete */
+    RUNFLG_SIMULATE   = (1 << 7), /* only forecast policy runs, no action nor DB update */
 } run_flags_t;
 
 /* Config module masks:
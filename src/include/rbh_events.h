@@ -0,0 +1,165 @@
+/* -*- mode: c; c-basic-offset: 4; indent-tabs-mode: nil; -*-
+ * vim:expandtab:shiftwidth=4:tabstop=4:
+ */
+/*
+ * Copyright (C) 2016 CEA/DAM
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the CeCILL License.
+ *
+ * The fact that you are presently reading this means that you have had
+ * knowledge of the CeCILL license (http://www.cecill.info) and that you
+ * accept its terms.
+ */
+
+/**
+ * \file    rbh_events.h
+ * \brief   Binary event log: compact records of processed changelog records,
+ *          database operations of the entry processor and policy actions.
+ *
+ * File format (host byte order):
+ * - a header (struct rbh_evt_file_hdr).
+ * - a sequence of records, each made of a common header (struct rbh_evt_hdr),
+ *   a body depending on the record type, then the strings of the record
+ *   (not NUL-terminated, their lengths are given in the body).
+ *
+ * Records are 8 bytes aligned, and their size is given in their header.
+ * The schema is only extended by adding record types or by appending fields
+ * to bodies: readers skip unknown record types and ignore unknown trailing
+ * fields.
+ */
+#ifndef _RBH_EVENTS_H
+#define _RBH_EVENTS_H
+
+#include "rbh_misc.h"
+#include <stdio.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+#define RBH_EVT_MAGIC       "RBHEVT01"
+#define RBH_EVT_MAGIC_LEN   8
+#define RBH_EVT_VERSION     1
+
+/** maximum size of a record */
+#define RBH_EVT_MAX_SIZE    (16 * 1024)
+
+/** entry ids are Lustre FIDs (else: fs_key/inode/validator) */
+#define RBH_EVT_FILE_FID    0x1
+
+struct rbh_evt_file_hdr {
+    char     magic[RBH_EVT_MAGIC_LEN];
+    uint32_t version;
+    uint32_t flags;
+    /** file creation time (usec since Epoch) */
+    uint64_t create_time;
+};
+
+typedef enum {
+    RBH_EVT_CHANGELOG = 1, /**< changelog record read from a MDT */
+    RBH_EVT_DB_OP     = 2, /**< database operation of the entry processor */
+    RBH_EVT_ACTION    = 3, /**< policy action */
+} rbh_evt_type_t;
+
+/** common record header */
+struct rbh_evt_hdr {
+    uint16_t type;
+    uint16_t padding;
+    /** record size, including this header */
+    uint32_t size;
+    /** event time (usec since Epoch) */
+    uint64_t time;
+};
+
+/** entry identifier: FID (seq, oid, ver) or (fs_key, inode, validator) */
+struct rbh_evt_id {
+    uint64_t seq;
+    uint64_t oid;
+    uint32_t ver;
+    uint32_t padding;
+};
+
+/** followed by the MDT name and the entry name */
+struct rbh_evt_changelog {
+    uint64_t          index;
+    uint64_t          time_sec;
+    uint32_t          time_nsec;
+    uint32_t          cl_type;  /**< Lustre changelog record type */
+    uint32_t          cl_flags;
+    uint16_t          mdt_len;
+    uint16_t          name_len;
+    struct rbh_evt_id tfid;
+    struct rbh_evt_id pfid;
+};
+
+struct rbh_evt_db_op {
+    struct rbh_evt_id id;
+    /** operation type (operation_type_e: 0=none, 1=insert, 2=update,
+     * 3=remove name, 4=remove last name, 5=soft remove) */
+    uint32_t          op;
+    /** database return code */
+    int32_t           rc;
+    /** index of the changelog record it comes from (0 if none) */
+    uint64_t          cl_index;
+};
+
+/** followed by the policy name, the rule name and the entry path */
+struct rbh_evt_action {
+    struct rbh_evt_id id;
+    uint64_t          size;
+    uint64_t          duration;  /**< usec */
+    /** action status: 0 on success, else the action error code */
+    int32_t           rc;
+    uint16_t          policy_len;
+    uint16_t          rule_len;
+    uint16_t          path_len;
+    uint16_t          padding[3];
+};
+
+/* -------- producers -------- */
+
+/** Indicate if events are logged (Log::events_file is set). */
+bool EventLogEnabled(void);
+
+/** Append a record to the event log (implemented in rbh_logs.c). */
+void LogEvent(const void *rec, size_t len);
+
+/** Log a changelog record. */
+void rbh_evt_changelog(const char *mdt, uint64_t index, uint32_t cl_type,
+                       uint32_t cl_flags, uint64_t time_sec, uint32_t time_nsec,
+                       const entry_id_t *tfid, const entry_id_t *pfid,
+                       const char *name, unsigned int name_len);
+
+/** Log a database operation of the entry processor. */
+void rbh_evt_db_op(const entry_id_t *id, operation_type_e op, int rc,
+                   uint64_t cl_index);
+
+/** Log the result of a policy action. */
+void rbh_evt_action(const char *policy, const char *rule, const entry_id_t *id,
+                    const char *path, uint64_t size, int rc,
+                    uint64_t duration);
+
+/** Fill the header of a new event file. */
+void rbh_evt_file_hdr_init(struct rbh_evt_file_hdr *hdr);
+
+/* -------- readers -------- */
+
+/** Read and check the header of an event file.
+ * @return 0 on success, a positive error code else.
+ */
+int rbh_evt_read_file_hdr(FILE *stream, struct rbh_evt_file_hdr *hdr);
+
+/** Read the next record into buf (RBH_EVT_MAX_SIZE bytes).
+ * @return 0 on success, 1 on EOF, a negative error code on error.
+ */
+int rbh_evt_read(FILE *stream, struct rbh_evt_hdr *buf);
+
+typedef enum {
+    RBH_EVT_FMT_TEXT,
+    RBH_EVT_FMT_JSON,
+} rbh_evt_format_t;
+
+/** Print a record (as a single line). Unknown record types are ignored. */
+void rbh_evt_print(FILE *out, const struct rbh_evt_file_hdr *file_hdr,
+                   const struct rbh_evt_hdr *rec, rbh_evt_format_t format);
+
+#endif
@@ -47,6 +47,11 @@ typedef struct log_config__
 
     char           changelogs_file[RBH_PATH_MAX];
 
+    /* binary event log (see rbh_events.h) */
+    char           events_file[RBH_PATH_MAX];
+    /* size of event files before they are rotated (0 = never) */
+    unsigned long long events_rotate_size;
+
     int            syslog_facility;
     int            syslog_priority;
 
@@ -62,6 +67,16 @@ typedef struct log_config__
     bool log_process; /* display process name in the log line header */
     bool log_host;    /* display hostname in the log line header */
 
+    /* asynchronous logging: log lines are buffered per thread
+     * and written by a dedicated thread */
+    bool async_logging;
+    /* size of per-thread log buffers (bytes) */
+    unsigned long long async_buffer_size;
+    /* when a buffer is full: drop records immediately,
+     * or wait up to async_block_ms for free space before dropping them */
+    bool async_drop;
+    int  async_block_ms;
+
 } log_config_t;
 
 /* Allow forcing log files etc... */
@@ -86,9 +101,12 @@ int            TestDisplayLevel(log_level level);
  */
 int InitializeLogs(const char *prog_name);
 
-/* flush logs */
+/* flush logs (including log lines buffered for asynchronous logging) */
 void           FlushLogs(void);
 
+/** number of log records dropped because asynchronous log buffers were full */
+unsigned long long LogDroppedCount(void);
+
 /**
  * Adjust log levels of external components (such as libraries) we get
  * messages from.
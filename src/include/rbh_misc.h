@@ -196,6 +196,30 @@ dev_t          get_fsdev(void);
 uint64_t       get_fskey(void);
 const entry_id_t *get_root_id(void);
 
+/**
+ * Murmur3 uint64 finalizer
+ * from: https://github.com/aappleby/smhasher/blob/master/src/MurmurHash3.cpp
+ */
+static inline uint64_t __hash64(uint64_t k)
+{
+    k ^= k >> 33;
+    k *= 0xff51afd7ed558ccdLLU;
+    k ^= k >> 33;
+    k *= 0xc4ceb9fe1a85ec53LLU;
+    k ^= k >> 33;
+    return k;
+}
+
+/** hash an entry id (for hash tables) */
+static inline uint64_t id_hash64(const entry_id_t * p_id)
+{
+#ifdef FID_PK
+    return __hash64(p_id->f_seq ^ p_id->f_oid);
+#else
+    return __hash64(p_id->fs_key ^ p_id->inode);
+#endif
+}
+
 /**
  * extract relative path from full path.
  */
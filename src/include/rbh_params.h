@@ -95,4 +95,9 @@ int rbh_params_foreach(const struct rbh_params *params, rbh_params_iter_t cb,
  */
 int rbh_params_copy(struct rbh_params *tgt, const struct rbh_params *src);
 
+/**
+ * check if two parameter sets have the same keys and values.
+ */
+bool rbh_params_equal(const struct rbh_params *p1, const struct rbh_params *p2);
+
 #endif
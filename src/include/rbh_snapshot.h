@@ -0,0 +1,170 @@
+/* -*- mode: c; c-basic-offset: 4; indent-tabs-mode: nil; -*-
+ * vim:expandtab:shiftwidth=4:tabstop=4:
+ */
+/*
+ * Copyright (C) 2016 CEA/DAM
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the CeCILL License.
+ *
+ * The fact that you are presently reading this means that you have had
+ * knowledge of the CeCILL license (http://www.cecill.info) and that you
+ * accept its terms.
+ */
+/**
+ * \file rbh_snapshot.h
+ * \brief Column-oriented snapshot files of robinhood database contents.
+ *
+ * File layout (all integers are in host byte order):
+ * - a header (struct snap_header) followed by column definitions
+ *   (struct snap_col_def[col_count]).
+ * - a sequence of row groups. Each group is made of one data chunk per
+ *   column, followed by a group header (struct snap_group_header) and
+ *   chunk descriptors (struct snap_chunk[col_count]).
+ * - a group index (uint64_t[group_count]: offsets of group headers).
+ * - a footer (struct snap_footer).
+ *
+ * All chunks start at 8-byte aligned offsets, so uncompressed chunks can be
+ * used in place from a memory mapping of the file.
+ * Chunk contents (before compression):
+ * - a validity bitmap (1 bit per row, 0 for NULL values), padded to 8 bytes.
+ * - for SNAP_COL_INT64 columns: int64_t values[row_count].
+ * - for SNAP_COL_STR columns: uint64_t offsets[row_count+1] followed by
+ *   string data (value i is data[offsets[i]] to data[offsets[i+1]], with
+ *   no null terminator).
+ */
+#ifndef _RBH_SNAPSHOT_H
+#define _RBH_SNAPSHOT_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <time.h>
+
+#define SNAP_MAGIC          "RBHSNAP1"
+#define SNAP_MAGIC_LEN      8
+#define SNAP_VERSION        1
+#define SNAP_COL_NAME_LEN   64
+
+/** default number of rows per row group */
+#define SNAP_DEFAULT_GROUP_ROWS 65536
+
+/** column value types */
+typedef enum {
+    SNAP_COL_INT64 = 1,
+    SNAP_COL_STR   = 2,
+} snap_col_type_e;
+
+struct snap_header {
+    char     magic[SNAP_MAGIC_LEN];
+    uint32_t version;
+    uint32_t col_count;
+    uint64_t snap_time;  /**< time of the snapshot */
+};
+
+struct snap_col_def {
+    char     name[SNAP_COL_NAME_LEN];
+    uint32_t type;       /**< snap_col_type_e */
+    uint32_t padding;
+};
+
+struct snap_group_header {
+    uint64_t row_count;
+};
+
+struct snap_chunk {
+    uint64_t offset;      /**< offset of chunk data in the file */
+    uint64_t raw_size;    /**< size of uncompressed data */
+    uint64_t stored_size; /**< size of data in the file */
+    uint32_t compressed;  /**< data is zlib-compressed */
+    uint32_t padding;
+};
+
+struct snap_footer {
+    uint64_t index_offset; /**< offset of the group index */
+    uint64_t group_count;
+    uint64_t row_count;
+    char     magic[SNAP_MAGIC_LEN];
+};
+
+/* -------- writer -------- */
+
+typedef struct snap_writer snap_writer_t;
+
+/**
+ * Create a snapshot file. The file is written to a temporary file and
+ * atomically renamed when snap_writer_close() succeeds.
+ * @param group_rows number of rows per row group (0 for default).
+ * @param compress compress column chunks.
+ * @param[out] err set to a positive errno on failure.
+ */
+snap_writer_t *snap_writer_create(const char *path, unsigned int col_count,
+                                  const char **col_names,
+                                  const snap_col_type_e *col_types,
+                                  unsigned int group_rows, bool compress,
+                                  int *err);
+
+/** set an integer value in the current row */
+int snap_writer_set_int(snap_writer_t *w, unsigned int col, int64_t val);
+/** set a string value in the current row */
+int snap_writer_set_str(snap_writer_t *w, unsigned int col, const char *val);
+/** terminate the current row (values that were not set are NULL) */
+int snap_writer_end_row(snap_writer_t *w);
+
+/**
+ * Flush pending rows, write the footer and close the file.
+ * @param commit if false, the file is discarded.
+ */
+int snap_writer_close(snap_writer_t *w, bool commit);
+
+/* -------- reader -------- */
+
+typedef struct snap_reader snap_reader_t;
+
+/** column data for a row group */
+typedef struct snap_col_data {
+    snap_col_type_e type;
+    uint64_t        row_count;
+    const uint8_t  *valid;      /**< validity bitmap */
+    const int64_t  *int_values; /**< SNAP_COL_INT64 */
+    const uint64_t *str_offsets;/**< SNAP_COL_STR */
+    const char     *str_data;   /**< SNAP_COL_STR */
+    void           *buffer;     /**< decompressed data (internal) */
+} snap_col_data_t;
+
+/** map a snapshot file */
+snap_reader_t *snap_reader_open(const char *path, int *err);
+void snap_reader_close(snap_reader_t *r);
+
+uint64_t snap_reader_row_count(const snap_reader_t *r);
+uint64_t snap_reader_group_count(const snap_reader_t *r);
+time_t   snap_reader_time(const snap_reader_t *r);
+
+/** get column index from its name, -1 if it doesn't exist */
+int snap_reader_col_index(const snap_reader_t *r, const char *name);
+
+/** load column data of a row group */
+int snap_reader_load(snap_reader_t *r, uint64_t group, unsigned int col,
+                     snap_col_data_t *data);
+/** release column data */
+void snap_col_data_release(snap_col_data_t *data);
+
+static inline bool snap_is_valid(const snap_col_data_t *data, uint64_t row)
+{
+    return (data->valid[row / 8] >> (row % 8)) & 1;
+}
+
+/* -------- vectorized filters --------
+ * Filters apply to a whole column chunk and clear the bits of the
+ * selection bitmap 'sel' for rows that don't match. NULL values never match.
+ */
+typedef enum {
+    SNAP_EQ, SNAP_NE, SNAP_LT, SNAP_LE, SNAP_GT, SNAP_GE
+} snap_compar_e;
+
+void snap_filter_int(const snap_col_data_t *data, snap_compar_e op,
+                     int64_t val, uint8_t *sel);
+/** @param pattern shell pattern (fnmatch) */
+void snap_filter_str(const snap_col_data_t *data, const char *pattern,
+                     bool negate, uint8_t *sel);
+
+#endif
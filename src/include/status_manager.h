@@ -60,6 +60,26 @@ typedef int (*sm_executor_func_t)(struct sm_instance *smi,
                                   post_action_e *what_after,
                                   db_cb_func_t db_cb_fn, void *db_cb_arg);
 
+/** function prototype for status manager "batch executor":
+ * run the same action with the same parameters on a set of entries.
+ * @param[in]     count      number of entries in the batch
+ * @param[in]     ids        array of 'count' entry ids
+ * @param[in,out] attrs      array of 'count' entry attributes
+ * @param[out]    rcs        array of 'count' action status (one per entry)
+ * @param[out]    what_after array of 'count' post actions (one per entry)
+ * @return 0 if the batch has been processed (per-entry status are in rcs),
+ *         -ENOTSUP if the action can't be batched (the caller must run it
+ *         entry per entry), another negative value on error.
+ */
+typedef int (*sm_batch_executor_func_t)(struct sm_instance *smi,
+                                        const char *implements,
+                                        const policy_action_t *action,
+                                        const action_params_t *params,
+                                        unsigned int count,
+                                        const entry_id_t **ids,
+                                        attr_set_t **attrs,
+                                        int *rcs, post_action_e *what_after);
+
 /** function prototype for action callbacks
  * @param[in,out] smi        status manager instance
  * @param[in]     implements action type name
@@ -153,6 +173,13 @@ typedef struct status_manager {
     /** If provided, the status manager wraps the action run */
     sm_executor_func_t  executor;
 
+    /** If provided, the status manager can run an action on several entries
+     * at once. batch_check indicates if a given action can be batched.
+     * Action callback (action_cb) is then called for each entry of the batch.
+     */
+    bool (*batch_check)(const char *implements, const policy_action_t *action);
+    sm_batch_executor_func_t batch_executor;
+
     /* ---- mask and function to manage deleted entries ---- */
 
     /** needed attributes to determine if the entry is to be moved to softrm */
@@ -441,6 +468,16 @@ static inline bool smi_multi_action(sm_instance_t *smi)
     return (smi->sm->flags & SM_MULTI_ACTION); /* the status manager handles multiple types of actions */
 }
 
+/** indicate if the status manager can run the given action in batches */
+static inline bool smi_batch_action(sm_instance_t *smi, const char *implements,
+                                    const policy_action_t *action)
+{
+    if (smi == NULL || smi->sm->batch_executor == NULL
+        || smi->sm->batch_check == NULL)
+        return false;
+    return smi->sm->batch_check(implements, action);
+}
+
 /** check the status manager knows the given action name */
 static inline bool smi_support_action(sm_instance_t *smi, const char *name)
 {
@@ -32,15 +32,57 @@
 #include <grp.h>
 #include <pwd.h>
 
+#include <time.h>
+
+/** default time-to-live of cached names (sec) */
+#define UG_DEFAULT_TTL      3600
+/** default time-to-live of unknown uids/gids (sec) */
+#define UG_DEFAULT_NEG_TTL  300
+
 int InitUidGid_Cache(void);
 
+/**
+ * Set the time-to-live of cached entries (0 = never expire).
+ * Expired entries are resolved again by a background thread,
+ * lookups always return the cached value.
+ * @param ttl     TTL of resolved uids/gids.
+ * @param neg_ttl TTL of unknown uids/gids.
+ */
+void UidGidCache_SetTTL(time_t ttl, time_t neg_ttl);
+
+/**
+ * Return user info for the given uid, or NULL if it is unknown.
+ * Only pw_name and pw_uid are set. The returned structure remains
+ * valid during the whole life of the process, but its name can be
+ * replaced by a background refresh: a replaced name is only freed
+ * a few minutes later. Use GetPwName() to keep a copy of the name.
+ */
 const struct passwd *GetPwUid(uid_t owner);
+/** Same as GetPwUid() for groups (only gr_name and gr_gid are set). */
 const struct group *GetGrGid(gid_t gid);
 
+/**
+ * Copy the name of the given uid to buf.
+ * @return buf, or NULL if the uid is unknown.
+ */
+char *GetPwName(uid_t owner, char *buf, size_t size);
+/** Same as GetPwName() for groups. */
+char *GetGrName(gid_t gid, char *buf, size_t size);
+
+/**
+ * Resolve the given uids and gids that are not cached yet (in parallel),
+ * typically before displaying a set of entries.
+ * Ids can be repeated.
+ */
+void UidGidCache_Prefetch(const uid_t *uids, unsigned int nb_uids,
+                          const gid_t *gids, unsigned int nb_gids);
+
 /* Cache statistics */
 extern unsigned int pw_nb_set;
 extern unsigned int pw_nb_get;
+extern unsigned int pw_nb_neg; /* unknown uids */
 extern unsigned int gr_nb_set;
 extern unsigned int gr_nb_get;
+extern unsigned int gr_nb_neg; /* unknown gids */
 
 #endif
@@ -0,0 +1,75 @@
+/* -*- mode: c; c-basic-offset: 4; indent-tabs-mode: nil; -*-
+ * vim:expandtab:shiftwidth=4:tabstop=4:
+ */
+/*
+ * Copyright (C) 2016 CEA/DAM
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the CeCILL License.
+ *
+ * The fact that you are presently reading this means that you have had
+ * knowledge of the CeCILL license (http://www.cecill.info) and that you
+ * accept its terms.
+ */
+/**
+ * \file    usage_cache.h
+ * \brief   In-memory user/group usage for checking quota triggers.
+ *
+ * The usage tables are loaded from the DB by a single report,
+ * then kept current by the entry processor, which applies
+ * the usage delta of each entry it writes to the DB.
+ */
+#ifndef _USAGE_CACHE_H
+#define _USAGE_CACHE_H
+
+#include "policy_run.h"
+#include "list_mgr.h"
+
+/** attributes needed to compute usage deltas */
+#define USAGE_CACHE_ATTR_MASK   (ATTR_MASK_uid | ATTR_MASK_gid | \
+                                 ATTR_MASK_blocks)
+
+/** usage of a user or a group */
+typedef struct usage_item {
+    db_type_u           id;     /**< uid/gid (as number or as name) */
+    char               *name;   /**< printable user/group name */
+    unsigned long long  count;  /**< number of entries */
+    unsigned long long  blocks; /**< number of 512B blocks */
+} usage_item_t;
+
+/** The entry processor runs in this process and can maintain the cache. */
+void usage_cache_set_maintained(void);
+bool usage_cache_maintained(void);
+
+/** A policy uses the usage cache: the entry processor must maintain it. */
+void usage_cache_enable(void);
+bool usage_cache_enabled(void);
+
+/**
+ * Apply the usage delta of an entry change.
+ * @param old_attrs previous attributes of the entry (NULL for a new entry)
+ * @param new_attrs new attributes of the entry (NULL for a removed entry).
+ *                  Attributes missing in new_attrs are unchanged.
+ */
+void usage_cache_update(const attr_set_t *old_attrs,
+                        const attr_set_t *new_attrs);
+
+/** Force reloading the usage of a user or group at next check
+ * (e.g. after a policy run on its entries). */
+void usage_cache_invalidate(policy_target_t target_type, const char *name);
+
+/**
+ * Get the users or groups over the high threshold of a trigger,
+ * ordered by decreasing usage.
+ * The table is loaded from the DB the first time, and reloaded
+ * when it is older than max_age.
+ * @param[out] items  allocated list of matching items (to be freed by
+ *                    usage_items_free()).
+ */
+int usage_cache_select(lmgr_t *lmgr, const trigger_item_t *trig,
+                       time_t max_age, unsigned long long high_blk512,
+                       usage_item_t **items, unsigned int *count);
+
+void usage_items_free(usage_item_t *items, unsigned int count);
+
+#endif
@@ -21,6 +21,7 @@
 #define ANNEX_TABLE	        "ANNEX_INFO"
 #define STRIPE_INFO_TABLE	"STRIPE_INFO"
 #define STRIPE_ITEMS_TABLE	"STRIPE_ITEMS"
+#define OST_LRU_TABLE       "OST_LRU"
 #define SOFT_RM_TABLE       "SOFT_RM"
 #define VAR_TABLE           "VARS"
 #define ACCT_TABLE          "ACCT_STAT"
@@ -56,6 +57,25 @@ char * sz_field[SZ_PROFIL_COUNT] =
 
 extern lmgr_config_t lmgr_config;
 
+/** is the per-OST LRU index maintained? */
+static inline bool ost_lru_enabled(void)
+{
+#ifdef _LUSTRE
+    return lmgr_config.ost_lru_attr != ATTR_INDEX_FLG_UNSPEC;
+#else
+    return false;
+#endif
+}
+
+/** statement starting a transaction that modifies the DB */
+#ifdef _SQLITE
+/* take the write lock at the beginning of the transaction: waiting for it
+ * then is safe, whereas upgrading a read lock may fail with a deadlock */
+#define DB_BEGIN_WRITE  "BEGIN IMMEDIATE"
+#else
+#define DB_BEGIN_WRITE  "BEGIN"
+#endif
+
 /* -------------------- Connexion management ---------------- */
 
 /* create client connection */
@@ -135,6 +155,9 @@ int db_list_table_info(db_conn_t * conn, const char *table,
 /* id of the last inserted row */
 unsigned long long db_last_id( db_conn_t * conn );
 
+/* number of rows changed by the last INSERT, UPDATE or DELETE */
+unsigned long long db_affected_rows(db_conn_t *conn);
+
 typedef enum { TRANS_NEXT, TRANS_SESSION } what_trans_e;
 typedef enum { TXL_SERIALIZABLE,
                TXL_REPEATABLE_RD,
@@ -0,0 +1,586 @@
+/* -*- mode: c; c-basic-offset: 4; indent-tabs-mode: nil; -*-
+ * vim:expandtab:shiftwidth=4:tabstop=4:
+ */
+/*
+ * Copyright (C) 2016 CEA/DAM
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the CeCILL License.
+ *
+ * The fact that you are presently reading this means that you have had
+ * knowledge of the CeCILL license (http://www.cecill.info) and that you
+ * accept its terms.
+ */
+/**
+ * In-memory cache of entry attributes, in front of the database.
+ *
+ * The cache is write-through: entries are populated by database reads
+ * (ListMgr_CachedGet), inserts and updates done in this process, and
+ * invalidated when entries are removed or renamed.
+ * Only attributes from MAIN, ANNEX and NAMES tables are cached (no stripe,
+ * no generated or function attributes).
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include "list_mgr.h"
+#include "listmgr_common.h"
+#include "rbh_logs.h"
+#include "rbh_misc.h"
+#include "Memory.h"
+#include "list.h"
+#include <pthread.h>
+
+#define ECACHE_TAG "EntryCache"
+
+/** number of independently locked shards */
+#define ECACHE_SHARDS   64
+
+/** a cached attribute value */
+struct ecache_val {
+    unsigned int attr_index;
+    db_type_u    val;
+};
+
+struct ecache_entry {
+    struct rh_list_head hash_list;
+    struct rh_list_head lru_list;
+
+    entry_id_t   id;
+    time_t       load_time;
+
+    /** attributes whose value in DB is known (possibly NULL) */
+    attr_mask_t  known;
+    /** non-NULL attribute values */
+    unsigned int val_count;
+    struct ecache_val *vals;
+};
+
+struct ecache_shard {
+    pthread_mutex_t      lock;
+    struct rh_list_head *buckets;
+    unsigned int         bucket_count;
+    /** most recently used first */
+    struct rh_list_head  lru;
+    unsigned int         count;
+    unsigned int         max_count;
+    /** incremented each time the shard is modified by a write */
+    uint64_t             write_gen;
+
+    /* stats */
+    uint64_t             hits;
+    uint64_t             misses;
+    uint64_t             evictions;
+    uint64_t             invalidations;
+};
+
+static struct ecache_shard *shards = NULL;
+
+/** attributes that can be cached */
+static attr_mask_t cacheable_mask;
+
+static inline bool ecache_enabled(void)
+{
+    return shards != NULL;
+}
+
+static inline struct ecache_shard *id2shard(const entry_id_t *p_id,
+                                            struct rh_list_head **bucket)
+{
+    uint64_t h = id_hash64(p_id);
+    struct ecache_shard *s = &shards[h % ECACHE_SHARDS];
+
+    *bucket = &s->buckets[(h / ECACHE_SHARDS) % s->bucket_count];
+    return s;
+}
+
+/** indicate if the union of the given type points to a string */
+static inline bool val_is_str(db_type_e type)
+{
+    return type == DB_TEXT || type == DB_ENUM_FTYPE
+        || (type == DB_UIDGID && !global_config.uid_gid_as_numbers);
+}
+
+static inline void *entry_attr_address(attr_set_t *attrs, int attr_index)
+{
+    return (char *)&attrs->attr_values + field_infos[attr_index].offset;
+}
+
+static void ecache_free_vals(struct ecache_entry *e)
+{
+    unsigned int i;
+
+    for (i = 0; i < e->val_count; i++)
+    {
+        /* status values are static strings */
+        if (!is_status_field(e->vals[i].attr_index)
+            && val_is_str(field_type(e->vals[i].attr_index)))
+            free((char *)e->vals[i].val.val_str);
+    }
+    MemFree(e->vals);
+    e->vals = NULL;
+    e->val_count = 0;
+}
+
+static void ecache_entry_free(struct ecache_shard *s, struct ecache_entry *e)
+{
+    rh_list_del(&e->hash_list);
+    rh_list_del(&e->lru_list);
+    s->count--;
+    ecache_free_vals(e);
+    MemFree(e);
+}
+
+static struct ecache_entry *ecache_find(struct rh_list_head *bucket,
+                                        const entry_id_t *p_id)
+{
+    struct ecache_entry *e;
+
+    rh_list_for_each_entry(e, bucket, hash_list)
+    {
+        if (entry_id_equal(&e->id, p_id))
+            return e;
+    }
+    return NULL;
+}
+
+/** get the value of an attribute as a union (from an attr set) */
+static void attr_get_union(const attr_set_t *attrs, unsigned int i,
+                           db_type_u *u)
+{
+    if (is_status_field(i))
+        u->val_str = attrs->attr_values.sm_status[attr2status_index(i)];
+    else if (is_sm_info_field(i))
+        assign_union(u, field_type(i),
+                     attrs->attr_values.sm_info[attr2sminfo_index(i)]);
+    else
+        assign_union(u, field_infos[i].db_type,
+                     (const char *)&attrs->attr_values + field_infos[i].offset);
+}
+
+/**
+ * Set attribute values in a cache entry.
+ * @param known  attributes whose DB value is known.
+ * @param attrs  values of known attributes (unset attributes are NULL).
+ */
+static int ecache_merge(struct ecache_entry *e, const attr_mask_t *known,
+                        const attr_set_t *attrs)
+{
+    attr_mask_t newk = attr_mask_and(known, &cacheable_mask);
+    struct ecache_val *vals;
+    unsigned int j, n;
+    int i, cookie;
+
+    /* drop previous values of updated attributes */
+    for (j = 0, n = 0; j < e->val_count; j++)
+    {
+        if (attr_mask_test_index(&newk, e->vals[j].attr_index))
+        {
+            if (!is_status_field(e->vals[j].attr_index)
+                && val_is_str(field_type(e->vals[j].attr_index)))
+                free((char *)e->vals[j].val.val_str);
+        }
+        else
+            e->vals[n++] = e->vals[j];
+    }
+    e->val_count = n;
+
+    /* count new values */
+    n = 0;
+    cookie = -1;
+    while ((i = attr_index_iter(0, &cookie)) != -1)
+        if (attr_mask_test_index(&newk, i)
+            && attr_mask_test_index(&attrs->attr_mask, i))
+            n++;
+
+    vals = MemRealloc(e->vals, (e->val_count + n) * sizeof(*vals));
+    if (vals == NULL && (e->val_count + n) > 0)
+        return ENOMEM;
+    e->vals = vals;
+
+    cookie = -1;
+    j = e->val_count;
+    while ((i = attr_index_iter(0, &cookie)) != -1)
+    {
+        db_type_u u;
+
+        if (!attr_mask_test_index(&newk, i)
+            || !attr_mask_test_index(&attrs->attr_mask, i))
+            continue;
+
+        attr_get_union(attrs, i, &u);
+        if (!is_status_field(i) && val_is_str(field_type(i)))
+        {
+            u.val_str = strdup(u.val_str);
+            if (u.val_str == NULL)
+            {
+                e->val_count = j;
+                return ENOMEM;
+            }
+        }
+        e->vals[j].attr_index = i;
+        e->vals[j].val = u;
+        j++;
+    }
+    e->val_count = j;
+    e->known = attr_mask_or(&e->known, &newk);
+    return 0;
+}
+
+/** fill an attribute set from a cache entry */
+static void ecache_fill_attrs(const struct ecache_entry *e, attr_set_t *attrs)
+{
+    attr_mask_t need = attrs->attr_mask;
+    unsigned int k;
+
+    ATTR_MASK_INIT(attrs);
+
+    for (k = 0; k < e->val_count; k++)
+    {
+        unsigned int i = e->vals[k].attr_index;
+
+        if (!attr_mask_test_index(&need, i))
+            continue;
+
+        if (is_status_field(i))
+        {
+            sm_status_ensure_alloc(&attrs->attr_values.sm_status);
+            attrs->attr_values.sm_status[attr2status_index(i)]
+                = e->vals[k].val.val_str;
+        }
+        else if (is_sm_info_field(i))
+        {
+            unsigned int idx = attr2sminfo_index(i);
+
+            sm_info_ensure_alloc(&attrs->attr_values.sm_info);
+            free(attrs->attr_values.sm_info[idx]);
+            attrs->attr_values.sm_info[idx] = dup_value(field_type(i),
+                                                        e->vals[k].val);
+        }
+        else
+            union_get_value(entry_attr_address(attrs, i),
+                            field_infos[i].db_type, &e->vals[k].val);
+
+        attr_mask_set_index(&attrs->attr_mask, i);
+    }
+}
+
+/** create a new entry in the given shard (lock must be held) */
+static struct ecache_entry *ecache_new(struct ecache_shard *s,
+                                       struct rh_list_head *bucket,
+                                       const entry_id_t *p_id)
+{
+    struct ecache_entry *e;
+
+    /* evict least recently used entries */
+    while (s->count >= s->max_count && !rh_list_empty(&s->lru))
+    {
+        ecache_entry_free(s, rh_list_last_entry(&s->lru, struct ecache_entry,
+                                                lru_list));
+        s->evictions++;
+    }
+
+    e = MemCalloc(1, sizeof(*e));
+    if (e == NULL)
+        return NULL;
+
+    e->id = *p_id;
+    e->load_time = time(NULL);
+    rh_list_add(&e->hash_list, bucket);
+    rh_list_add(&e->lru_list, &s->lru);
+    s->count++;
+    return e;
+}
+
+int ecache_init(void)
+{
+    unsigned int i, j;
+
+    if (shards != NULL || lmgr_config.entry_cache_size == 0)
+        return 0;
+
+    cacheable_mask = attr_mask_or(&main_attr_set, &annex_attr_set);
+    cacheable_mask = attr_mask_or(&cacheable_mask, &names_attr_set);
+    cacheable_mask = attr_mask_and_not(&cacheable_mask, &readonly_attr_set);
+    cacheable_mask = attr_mask_and_not(&cacheable_mask, &gen_attr_set);
+    cacheable_mask = attr_mask_and_not(&cacheable_mask, &stripe_attr_set);
+
+    shards = MemCalloc(ECACHE_SHARDS, sizeof(*shards));
+    if (shards == NULL)
+        return DB_NO_MEMORY;
+
+    for (i = 0; i < ECACHE_SHARDS; i++)
+    {
+        struct ecache_shard *s = &shards[i];
+
+        pthread_mutex_init(&s->lock, NULL);
+        rh_list_init(&s->lru);
+        s->max_count = lmgr_config.entry_cache_size / ECACHE_SHARDS;
+        if (s->max_count == 0)
+            s->max_count = 1;
+        s->bucket_count = s->max_count;
+        s->buckets = MemAlloc(s->bucket_count * sizeof(*s->buckets));
+        if (s->buckets == NULL)
+            return DB_NO_MEMORY;
+        for (j = 0; j < s->bucket_count; j++)
+            rh_list_init(&s->buckets[j]);
+    }
+
+    DisplayLog(LVL_VERB, ECACHE_TAG, "Entry cache initialized (%u entries, "
+               "%u shards)", lmgr_config.entry_cache_size, ECACHE_SHARDS);
+    return 0;
+}
+
+/**
+ * Lookup an entry in the cache.
+ * @param[in,out] p_info  attr mask indicates the requested attributes.
+ * @param[out] gen  shard write generation, to be passed to ecache_fill().
+ * @return true if all requested attributes were found in cache.
+ */
+static bool ecache_lookup(const entry_id_t *p_id, attr_set_t *p_info,
+                          uint64_t *gen)
+{
+    struct rh_list_head *bucket;
+    struct ecache_shard *s = id2shard(p_id, &bucket);
+    struct ecache_entry *e;
+    attr_mask_t missing;
+    bool hit = false;
+
+    P(s->lock);
+    e = ecache_find(bucket, p_id);
+    if (e != NULL)
+    {
+        missing = attr_mask_and_not(&p_info->attr_mask, &e->known);
+
+        if (time(NULL) - e->load_time > lmgr_config.entry_cache_max_age)
+            ecache_entry_free(s, e);
+        else if (attr_mask_is_null(missing))
+        {
+            ecache_fill_attrs(e, p_info);
+            /* move to LRU head */
+            rh_list_del(&e->lru_list);
+            rh_list_add(&e->lru_list, &s->lru);
+            hit = true;
+        }
+    }
+
+    if (hit)
+        s->hits++;
+    else
+        s->misses++;
+    *gen = s->write_gen;
+    V(s->lock);
+
+    return hit;
+}
+
+/**
+ * Store attributes read from the database, if the entry was not modified
+ * since the lookup.
+ */
+static void ecache_fill(const entry_id_t *p_id, const attr_mask_t *known,
+                        const attr_set_t *p_info, uint64_t gen)
+{
+    struct rh_list_head *bucket;
+    struct ecache_shard *s = id2shard(p_id, &bucket);
+    struct ecache_entry *e;
+
+    P(s->lock);
+    /* a write may have happened in the meantime: what we read from the
+     * DB may be outdated */
+    if (s->write_gen != gen)
+        goto out;
+
+    e = ecache_find(bucket, p_id);
+    if (e == NULL)
+        e = ecache_new(s, bucket, p_id);
+    if (e == NULL)
+        goto out;
+
+    if (ecache_merge(e, known, p_info))
+        ecache_entry_free(s, e);
+out:
+    V(s->lock);
+}
+
+void ecache_store(const entry_id_t *p_id, const attr_set_t *p_attrs,
+                  bool replace)
+{
+    struct rh_list_head *bucket;
+    struct ecache_shard *s;
+    struct ecache_entry *e;
+
+    if (!ecache_enabled())
+        return;
+
+    s = id2shard(p_id, &bucket);
+
+    P(s->lock);
+    s->write_gen++;
+
+    e = ecache_find(bucket, p_id);
+    if (e != NULL && replace)
+    {
+        ecache_entry_free(s, e);
+        e = NULL;
+    }
+    /* only update entries that are already cached, unless this is
+     * a new entry */
+    if (e == NULL && replace)
+        e = ecache_new(s, bucket, p_id);
+    if (e == NULL)
+        goto out;
+
+    if (ecache_merge(e, &p_attrs->attr_mask, p_attrs))
+        ecache_entry_free(s, e);
+out:
+    V(s->lock);
+}
+
+void ecache_invalidate(const entry_id_t *p_id)
+{
+    unsigned int i;
+
+    if (!ecache_enabled())
+        return;
+
+    if (p_id != NULL)
+    {
+        struct rh_list_head *bucket;
+        struct ecache_shard *s = id2shard(p_id, &bucket);
+        struct ecache_entry *e;
+
+        P(s->lock);
+        s->write_gen++;
+        e = ecache_find(bucket, p_id);
+        if (e != NULL)
+        {
+            ecache_entry_free(s, e);
+            s->invalidations++;
+        }
+        V(s->lock);
+        return;
+    }
+
+    /* invalidate all */
+    for (i = 0; i < ECACHE_SHARDS; i++)
+    {
+        struct ecache_shard *s = &shards[i];
+
+        P(s->lock);
+        s->write_gen++;
+        while (!rh_list_empty(&s->lru))
+        {
+            ecache_entry_free(s, rh_list_first_entry(&s->lru,
+                              struct ecache_entry, lru_list));
+            s->invalidations++;
+        }
+        V(s->lock);
+    }
+}
+
+int ListMgr_CachedGet(lmgr_t *p_mgr, const entry_id_t *p_id,
+                      attr_set_t *p_info)
+{
+    attr_mask_t known;
+    uint64_t gen;
+    int rc;
+
+    if (!ecache_enabled())
+        return ListMgr_Get(p_mgr, p_id, p_info);
+
+    if (ecache_lookup(p_id, p_info, &gen))
+        return DB_SUCCESS;
+
+    known = p_info->attr_mask;
+    rc = ListMgr_Get(p_mgr, p_id, p_info);
+    if (rc == DB_SUCCESS)
+        ecache_fill(p_id, &known, p_info, gen);
+
+    return rc;
+}
+
+int ListMgr_CachedBatchGet(lmgr_t *p_mgr, unsigned int count,
+                           const entry_id_t **ids, attr_set_t **attrs,
+                           int *rcs)
+{
+    const entry_id_t **miss_ids;
+    attr_set_t       **miss_attrs;
+    int               *miss_rcs;
+    unsigned int      *miss_idx;
+    uint64_t          *gens;
+    attr_mask_t        known;
+    unsigned int       i, nb_miss = 0;
+    int                rc;
+
+    if (!ecache_enabled() || count == 0)
+        return ListMgr_BatchGet(p_mgr, count, ids, attrs, rcs);
+
+    miss_ids = MemAlloc(count * sizeof(*miss_ids));
+    miss_attrs = MemAlloc(count * sizeof(*miss_attrs));
+    miss_rcs = MemAlloc(count * sizeof(*miss_rcs));
+    miss_idx = MemAlloc(count * sizeof(*miss_idx));
+    gens = MemAlloc(count * sizeof(*gens));
+    if (!miss_ids || !miss_attrs || !miss_rcs || !miss_idx || !gens)
+    {
+        rc = DB_NO_MEMORY;
+        goto out;
+    }
+
+    known = attrs[0]->attr_mask;
+
+    for (i = 0; i < count; i++)
+    {
+        if (ecache_lookup(ids[i], attrs[i], &gens[nb_miss]))
+        {
+            rcs[i] = DB_SUCCESS;
+            continue;
+        }
+        miss_ids[nb_miss] = ids[i];
+        miss_attrs[nb_miss] = attrs[i];
+        miss_idx[nb_miss] = i;
+        nb_miss++;
+    }
+
+    rc = ListMgr_BatchGet(p_mgr, nb_miss, miss_ids, miss_attrs, miss_rcs);
+    if (rc)
+        goto out;
+
+    for (i = 0; i < nb_miss; i++)
+    {
+        rcs[miss_idx[i]] = miss_rcs[i];
+        if (miss_rcs[i] == DB_SUCCESS)
+            ecache_fill(miss_ids[i], &known, miss_attrs[i], gens[i]);
+    }
+
+out:
+    MemFree(gens);
+    MemFree(miss_idx);
+    MemFree(miss_rcs);
+    MemFree(miss_attrs);
+    MemFree(miss_ids);
+    return rc;
+}
+
+void ListMgr_EntryCacheStats(lmgr_cache_stats_t *stats)
+{
+    unsigned int i;
+
+    memset(stats, 0, sizeof(*stats));
+    if (!ecache_enabled())
+        return;
+
+    stats->max_count = lmgr_config.entry_cache_size;
+
+    /* no lock, just for information */
+    for (i = 0; i < ECACHE_SHARDS; i++)
+    {
+        stats->count += shards[i].count;
+        stats->hits += shards[i].hits;
+        stats->misses += shards[i].misses;
+        stats->evictions += shards[i].evictions;
+        stats->invalidations += shards[i].invalidations;
+    }
+}
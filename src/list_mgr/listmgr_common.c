@@ -1665,7 +1665,7 @@ int _lmgr_begin(lmgr_t *p_mgr, int behavior)
         return DB_SUCCESS;
     else if (behavior == 1)
         /* commit every transaction */
-        return db_exec_sql(&p_mgr->conn, "BEGIN", NULL);
+        return db_exec_sql(&p_mgr->conn, DB_BEGIN_WRITE, NULL);
     else
     {
         int rc = DB_SUCCESS;
@@ -1673,7 +1673,7 @@ int _lmgr_begin(lmgr_t *p_mgr, int behavior)
         /* if last operation was committed, issue a begin statement */
         if (p_mgr->last_commit == 0)
         {
-            rc = db_exec_sql(&p_mgr->conn, "BEGIN", NULL);
+            rc = db_exec_sql(&p_mgr->conn, DB_BEGIN_WRITE, NULL);
             if (rc)
                 return rc;
         }
@@ -1702,7 +1702,15 @@ int _lmgr_commit(lmgr_t * p_mgr, int behavior)
     if (behavior == 0)
         return DB_SUCCESS;
     else if (behavior == 1)
-        return db_exec_sql(&p_mgr->conn, "COMMIT", NULL);
+    {
+        int            rc;
+        rc = db_exec_sql(&p_mgr->conn, "COMMIT", NULL);
+        if (rc)
+            return rc;
+
+        /* report changes of the committed transaction */
+        lmgr_flush_changes(p_mgr);
+    }
     else
     {
         /* if the transaction count is reached:
@@ -1716,6 +1724,7 @@ int _lmgr_commit(lmgr_t * p_mgr, int behavior)
                 return rc;
 
             p_mgr->last_commit = 0;
+            lmgr_flush_changes(p_mgr);
         }
     }
     return DB_SUCCESS;
@@ -1750,16 +1759,47 @@ int _lmgr_flush_commit(lmgr_t *p_mgr, int behavior)
             return rc;
 
         p_mgr->last_commit = 0;
+        lmgr_flush_changes(p_mgr);
         return DB_SUCCESS;
     }
     else
         return DB_SUCCESS;
 }
 
+/**
+ * Start a read-only transaction, so that all following requests
+ * see the same consistent view of the database.
+ */
+int ListMgr_BeginSnapshot(lmgr_t *p_mgr)
+{
+    int rc;
+
+    rc = lmgr_flush_commit(p_mgr);
+    if (rc)
+        return rc;
+
+#ifdef _MYSQL
+    rc = db_transaction_level(&p_mgr->conn, TRANS_NEXT, TXL_REPEATABLE_RD);
+    if (rc)
+        return rc;
+
+    return db_exec_sql(&p_mgr->conn, "START TRANSACTION WITH CONSISTENT SNAPSHOT",
+                       NULL);
+#else
+    return db_exec_sql(&p_mgr->conn, "BEGIN", NULL);
+#endif
+}
+
+/** Terminate a transaction started by ListMgr_BeginSnapshot() */
+int ListMgr_EndSnapshot(lmgr_t *p_mgr)
+{
+    return db_exec_sql(&p_mgr->conn, "COMMIT", NULL);
+}
+
 int lmgr_table_count(db_conn_t *pconn, const char *table, uint64_t *count)
 {
     char            *str_count = NULL;
-    result_handle_t  result = NULL;
+    result_handle_t  result;
     char            *sql;
     int              rc;
 
@@ -1772,15 +1812,13 @@ int lmgr_table_count(db_conn_t *pconn, const char *table, uint64_t *count)
         goto out_free;
 
     rc = db_next_record(pconn, &result, &str_count, 1);
-    if (rc)
-        goto out_free;
-
-    if (sscanf(str_count, "%"SCNu64, count) != 1)
+    if (rc == DB_SUCCESS
+        && (str_count == NULL || sscanf(str_count, "%"SCNu64, count) != 1))
         rc = DB_REQUEST_FAILED;
 
+    db_result_free(pconn, &result);
+
 out_free:
-    if (result != NULL)
-        db_result_free(pconn, &result);
     free(sql);
     return rc;
 }
@@ -582,6 +582,23 @@ int _lmgr_delayed_retry(lmgr_t *lmgr, int errcode, const char *func, int line);
 int lmgr_get_var(db_conn_t *pconn, const char *varname, char *value, int bufsize);
 int lmgr_set_var(db_conn_t *pconn, const char *varname, const char *value);
 
+/* change counters, to invalidate cached reports */
+void lmgr_count_changes(lmgr_t *p_mgr, const attr_mask_t *attr_mask,
+                        unsigned int count);
+int lmgr_flush_changes(lmgr_t *p_mgr);
+int lmgr_change_gen(db_conn_t *pconn, unsigned int chg_mask, uint64_t *gen);
+
+/* in-memory entry cache */
+int ecache_init(void);
+/** update cached attributes of an entry.
+ * @param replace the entry is new: create it in cache. Else, only update
+ *                it if it is already cached.
+ */
+void ecache_store(const entry_id_t *p_id, const attr_set_t *p_attrs,
+                  bool replace);
+/** drop an entry from cache (all entries if p_id is NULL) */
+void ecache_invalidate(const entry_id_t *p_id);
+
 int fullpath_attr2db(const char *attr, char *db);
 void fullpath_db2attr(const char *db, char *attr);
 
@@ -58,9 +58,19 @@ static void lmgr_cfg_set_default(void *module_config)
 #elif defined (_SQLITE)
     strcpy( conf->db_config.filepath, "/var/robinhood/robinhood_sqlite_db" );
     conf->db_config.retry_delay_microsec = 1000;        /* 1ms */
+    conf->db_config.busy_timeout = 0; /* wait forever */
+    strcpy(conf->db_config.journal_mode, "WAL");
+    strcpy(conf->db_config.synchronous, "NORMAL");
+    conf->db_config.cache_size = 1024LL * 1024 * 1024; /* 1GB */
+    conf->db_config.stmt_cache_size = 64;
 #endif
 
      conf->acct = true;
+     conf->ost_lru_attr = ATTR_INDEX_FLG_UNSPEC; /* disabled */
+     conf->report_cache = false;
+     conf->report_parallel = 1;
+     conf->entry_cache_size = 0; /* disabled */
+     conf->entry_cache_max_age = 60;
 }
 
 static void lmgr_cfg_write_default(FILE *output)
@@ -70,6 +80,13 @@ static void lmgr_cfg_write_default(FILE *output)
     print_line( output, 1, "connect_retry_interval_min  : 1s" );
     print_line( output, 1, "connect_retry_interval_max  : 30s" );
     print_line( output, 1, "accounting  : enabled" );
+#ifdef _LUSTRE
+    print_line( output, 1, "ost_lru_attr: none" );
+#endif
+    print_line( output, 1, "report_cache    : no" );
+    print_line( output, 1, "report_parallel : 1" );
+    print_line( output, 1, "entry_cache_size    : 0 (disabled)" );
+    print_line( output, 1, "entry_cache_max_age : 1min" );
     fprintf( output, "\n" );
 
 #ifdef _MYSQL
@@ -86,6 +103,11 @@ static void lmgr_cfg_write_default(FILE *output)
     print_begin_block( output, 1, SQLITE_CONFIG_BLOCK, NULL );
     print_line( output, 2, "db_file              :  \"/var/robinhood/robinhood_sqlite_db\"" );
     print_line( output, 2, "retry_delay_microsec :  1000 (1 millisec)" );
+    print_line( output, 2, "busy_timeout         :  0 (wait forever)" );
+    print_line( output, 2, "journal_mode         :  WAL" );
+    print_line( output, 2, "synchronous          :  NORMAL" );
+    print_line( output, 2, "cache_size           :  1GB" );
+    print_line( output, 2, "stmt_cache_size      :  64" );
     print_end_block( output, 1 );
 #endif
 
@@ -105,7 +127,9 @@ static int lmgr_cfg_read(config_file_t config, void *module_config, char *msg_ou
 
     static const char *lmgr_allowed[] = {
         "commit_behavior", "connect_retry_interval_min",
-        "connect_retry_interval_max", "accounting",
+        "connect_retry_interval_max", "accounting", "ost_lru_attr",
+        "report_cache", "report_parallel", "entry_cache_size",
+        "entry_cache_max_age",
         MYSQL_CONFIG_BLOCK, SQLITE_CONFIG_BLOCK,
         "user_acct", "group_acct", /* deprecated => accounting */
         NULL
@@ -117,6 +141,13 @@ static int lmgr_cfg_read(config_file_t config, void *module_config, char *msg_ou
         {"connect_retry_interval_max", PT_DURATION, PFLG_POSITIVE |
          PFLG_NOT_NULL, &conf->connect_retry_max, 0},
         {"accounting", PT_BOOL, 0, &conf->acct, 0},
+        {"report_cache", PT_BOOL, 0, &conf->report_cache, 0},
+        {"report_parallel", PT_INT, PFLG_POSITIVE | PFLG_NOT_NULL,
+         &conf->report_parallel, 0},
+        {"entry_cache_size", PT_INT, PFLG_POSITIVE,
+         &conf->entry_cache_size, 0},
+        {"entry_cache_max_age", PT_DURATION, PFLG_POSITIVE,
+         &conf->entry_cache_max_age, 0},
         END_OF_PARAMS
     };
 
@@ -145,7 +176,8 @@ static int lmgr_cfg_read(config_file_t config, void *module_config, char *msg_ou
     };
 #elif defined (_SQLITE)
     static const char *db_allowed[] = {
-        "db_file", "retry_delay_microsec",
+        "db_file", "retry_delay_microsec", "busy_timeout", "journal_mode",
+        "synchronous", "cache_size", "stmt_cache_size",
         NULL
     };
     const cfg_param_t db_params[] = {
@@ -153,6 +185,16 @@ static int lmgr_cfg_read(config_file_t config, void *module_config, char *msg_ou
          conf->db_config.filepath, sizeof(conf->db_config.filepath)},
         {"retry_delay_microsec", PT_INT, PFLG_POSITIVE | PFLG_NOT_NULL,
          (int*)&conf->db_config.retry_delay_microsec, 0},
+        {"busy_timeout", PT_DURATION, PFLG_POSITIVE,
+         &conf->db_config.busy_timeout, 0},
+        {"journal_mode", PT_STRING, PFLG_NO_WILDCARDS,
+         conf->db_config.journal_mode, sizeof(conf->db_config.journal_mode)},
+        {"synchronous", PT_STRING, PFLG_NO_WILDCARDS,
+         conf->db_config.synchronous, sizeof(conf->db_config.synchronous)},
+        {"cache_size", PT_SIZE, PFLG_POSITIVE,
+         &conf->db_config.cache_size, 0},
+        {"stmt_cache_size", PT_INT, PFLG_POSITIVE,
+         (int*)&conf->db_config.stmt_cache_size, 0},
         END_OF_PARAMS
     };
 #endif
@@ -227,6 +269,33 @@ static int lmgr_cfg_read(config_file_t config, void *module_config, char *msg_ou
         conf->acct = bval;
     }
 
+#ifdef _LUSTRE
+    /* time attribute to be indexed per OST */
+    rc = GetStringParam(lmgr_block, LMGR_CONFIG_BLOCK, "ost_lru_attr",
+                        PFLG_NO_WILDCARDS, tmpstr, sizeof(tmpstr), NULL, NULL,
+                        msg_out);
+    if ((rc != 0) && (rc != ENOENT))
+        return rc;
+    else if (rc != ENOENT)
+    {
+        if (!strcasecmp(tmpstr, "none"))
+            conf->ost_lru_attr = ATTR_INDEX_FLG_UNSPEC;
+        else if (!strcasecmp(tmpstr, "last_access"))
+            conf->ost_lru_attr = ATTR_INDEX_last_access;
+        else if (!strcasecmp(tmpstr, "last_mod"))
+            conf->ost_lru_attr = ATTR_INDEX_last_mod;
+        else if (!strcasecmp(tmpstr, "creation"))
+            conf->ost_lru_attr = ATTR_INDEX_creation_time;
+        else
+        {
+            sprintf(msg_out, "Invalid value for '" LMGR_CONFIG_BLOCK
+                    "::ost_lru_attr': '%s' (expected: none, last_access, "
+                    "last_mod, creation)", tmpstr);
+            return EINVAL;
+        }
+    }
+#endif
+
     CheckUnknownParameters( lmgr_block, LMGR_CONFIG_BLOCK, lmgr_allowed );
 
     /* Database parameters */
@@ -315,6 +384,41 @@ static int lmgr_cfg_reload(lmgr_config_t *conf)
                    LMGR_CONFIG_BLOCK
                    "::accounting changed in config file, but cannot be modified dynamically");
 
+    if (conf->ost_lru_attr != lmgr_config.ost_lru_attr)
+        DisplayLog(LVL_MAJOR, TAG,
+                   LMGR_CONFIG_BLOCK
+                   "::ost_lru_attr changed in config file, but cannot be modified dynamically");
+
+    if (conf->report_cache != lmgr_config.report_cache)
+    {
+        DisplayLog(LVL_EVENT, TAG,
+                   LMGR_CONFIG_BLOCK "::report_cache updated: %s->%s",
+                   bool2str(lmgr_config.report_cache),
+                   bool2str(conf->report_cache));
+        lmgr_config.report_cache = conf->report_cache;
+    }
+
+    if (conf->report_parallel != lmgr_config.report_parallel)
+    {
+        DisplayLog(LVL_EVENT, TAG,
+                   LMGR_CONFIG_BLOCK "::report_parallel updated: %u->%u",
+                   lmgr_config.report_parallel, conf->report_parallel);
+        lmgr_config.report_parallel = conf->report_parallel;
+    }
+
+    if (conf->entry_cache_size != lmgr_config.entry_cache_size)
+        DisplayLog(LVL_MAJOR, TAG,
+                   LMGR_CONFIG_BLOCK
+                   "::entry_cache_size changed in config file, but cannot be modified dynamically");
+
+    if (conf->entry_cache_max_age != lmgr_config.entry_cache_max_age)
+    {
+        DisplayLog(LVL_EVENT, TAG,
+                   LMGR_CONFIG_BLOCK "::entry_cache_max_age updated: %ld->%ld",
+                   lmgr_config.entry_cache_max_age, conf->entry_cache_max_age);
+        lmgr_config.entry_cache_max_age = conf->entry_cache_max_age;
+    }
+
     if ( conf->connect_retry_min != lmgr_config.connect_retry_min )
     {
         DisplayLog( LVL_EVENT, TAG,
@@ -367,6 +471,24 @@ static int lmgr_cfg_reload(lmgr_config_t *conf)
         lmgr_config.db_config.retry_delay_microsec = conf->db_config.retry_delay_microsec;
     }
 
+    if (conf->db_config.busy_timeout != lmgr_config.db_config.busy_timeout)
+    {
+        DisplayLog(LVL_EVENT, TAG, SQLITE_CONFIG_BLOCK
+                   "::busy_timeout updated: %lu->%lu",
+                   (unsigned long)lmgr_config.db_config.busy_timeout,
+                   (unsigned long)conf->db_config.busy_timeout);
+        lmgr_config.db_config.busy_timeout = conf->db_config.busy_timeout;
+    }
+
+    /* connection settings */
+    if (strcasecmp(conf->db_config.journal_mode, lmgr_config.db_config.journal_mode)
+        || strcasecmp(conf->db_config.synchronous, lmgr_config.db_config.synchronous)
+        || conf->db_config.cache_size != lmgr_config.db_config.cache_size
+        || conf->db_config.stmt_cache_size != lmgr_config.db_config.stmt_cache_size)
+        DisplayLog(LVL_MAJOR, TAG, SQLITE_CONFIG_BLOCK
+                   "::journal_mode, synchronous, cache_size or stmt_cache_size "
+                   "changed in config file, but cannot be modified dynamically");
+
 #endif
 
     return 0;
@@ -407,6 +529,20 @@ static void lmgr_cfg_write_template(FILE *output)
     print_line( output, 1, "# disable the following options if you are not interested in" );
     print_line( output, 1, "# user or group stats (to speed up scan)" );
     print_line( output, 1, "accounting  = enabled ;" );
+#ifdef _LUSTRE
+    fprintf( output, "\n" );
+    print_line( output, 1, "# maintain a per-OST index of entries sorted by the given" );
+    print_line( output, 1, "# time attribute, to speed up OST-targeted policy runs" );
+    print_line( output, 1, "# sorted by the same attribute (none, last_access, last_mod, creation)." );
+    print_line( output, 1, "# ost_lru_attr = last_access ;" );
+#endif
+    fprintf( output, "\n" );
+    print_line( output, 1, "# keep attributes of recently processed entries in memory" );
+    print_line( output, 1, "# to save DB requests when processing changelogs." );
+    print_line( output, 1, "# Only enable it if a single robinhood process modifies the DB," );
+    print_line( output, 1, "# or set a short entry_cache_max_age." );
+    print_line( output, 1, "# entry_cache_size = 100000 ;" );
+    print_line( output, 1, "# entry_cache_max_age = 1min ;" );
     fprintf( output, "\n" );
 #ifdef _MYSQL
     print_begin_block( output, 1, MYSQL_CONFIG_BLOCK, NULL );
@@ -422,6 +558,14 @@ static void lmgr_cfg_write_template(FILE *output)
     print_begin_block( output, 1, SQLITE_CONFIG_BLOCK, NULL );
     print_line( output, 2, "db_file = \"/var/robinhood/robinhood_sqlite_db\" ;" );
     print_line( output, 2, "retry_delay_microsec = 1000 ;" );
+    print_line( output, 2, "# give up waiting for a lock after this delay (0 = never)" );
+    print_line( output, 2, "busy_timeout = 0 ;" );
+    print_line( output, 2, "# WAL allows reading the DB while it is modified" );
+    print_line( output, 2, "journal_mode = WAL ;" );
+    print_line( output, 2, "synchronous = NORMAL ;" );
+    print_line( output, 2, "cache_size = 1GB ;" );
+    print_line( output, 2, "# number of prepared statements kept per DB connection" );
+    print_line( output, 2, "stmt_cache_size = 64 ;" );
     print_end_block( output, 1 );
 #endif
 
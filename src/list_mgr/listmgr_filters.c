@@ -21,6 +21,7 @@
 #include "rbh_misc.h"
 #include "listmgr_common.h"
 #include <stdlib.h>
+#include <ctype.h>
 
 #define FILTER_PREALLOC_INIT 2
 
@@ -579,6 +580,616 @@ int convert_boolexpr_to_simple_filter(bool_node_t *boolexpr, lmgr_filter_t *filt
                               0, BOOL_AND);
 }
 
+/* ------------ push-down of boolean expressions to the DB ------------ */
+
+/** how a term of an expression is processed */
+typedef enum {
+    PD_LOCAL = 0,   /**< only evaluated locally */
+    PD_PREFILTER,   /**< DB returns a larger set: also checked locally */
+    PD_EXACT,       /**< fully evaluated by the DB */
+} pd_class_e;
+
+static const char *pd_class2str(pd_class_e cls)
+{
+    switch (cls)
+    {
+        case PD_EXACT:      return "db";
+        case PD_PREFILTER:  return "db+local";
+        default:            return "local";
+    }
+}
+
+/** DB condition built from a leaf of the expression */
+struct pd_cond {
+    unsigned int        index;
+    filter_comparator_t comp;
+    filter_value_t      val;
+    int                 flags;
+};
+
+/** operand of an AND (or OR) expression, after NOT propagation */
+struct pd_term {
+    bool_node_t *node;
+    bool         neg;
+};
+
+/** upper bound of the number of terms of an expression */
+static unsigned int pd_count_nodes(const bool_node_t *node)
+{
+    switch (node->node_type)
+    {
+        case NODE_UNARY_EXPR:
+            return 1 + pd_count_nodes(node->content_u.bool_expr.expr1);
+        case NODE_BINARY_EXPR:
+            return 1 + pd_count_nodes(node->content_u.bool_expr.expr1)
+                     + pd_count_nodes(node->content_u.bool_expr.expr2);
+        default:
+            return 1;
+    }
+}
+
+/**
+ * Collect the operands of a 'op' expression.
+ * NOT are propagated using De Morgan's laws: e.g. NOT (x OR y) is collected
+ * as the operands 'NOT x' and 'NOT y' of an AND expression.
+ */
+static void pd_collect(bool_node_t *node, bool neg, bool_op_t op,
+                       struct pd_term *terms, unsigned int *count)
+{
+    if (node->node_type == NODE_UNARY_EXPR
+        && node->content_u.bool_expr.bool_op == BOOL_NOT)
+    {
+        pd_collect(node->content_u.bool_expr.expr1, !neg, op, terms, count);
+        return;
+    }
+
+    if (node->node_type == NODE_BINARY_EXPR)
+    {
+        /* AND for a non-negated expression, OR for a negated one */
+        bool_op_t eff_op = node->content_u.bool_expr.bool_op;
+
+        if (neg && eff_op == BOOL_AND)
+            eff_op = BOOL_OR;
+        else if (neg && eff_op == BOOL_OR)
+            eff_op = BOOL_AND;
+
+        if (eff_op == op)
+        {
+            pd_collect(node->content_u.bool_expr.expr1, neg, op, terms, count);
+            pd_collect(node->content_u.bool_expr.expr2, neg, op, terms, count);
+            return;
+        }
+    }
+
+    terms[*count].node = node;
+    terms[*count].neg = neg;
+    (*count)++;
+}
+
+/** is the term an OR expression (after NOT propagation)? */
+static bool pd_is_or(const struct pd_term *term)
+{
+    if (term->node->node_type != NODE_BINARY_EXPR)
+        return false;
+
+    if (term->neg)
+        return term->node->content_u.bool_expr.bool_op == BOOL_AND;
+    else
+        return term->node->content_u.bool_expr.bool_op == BOOL_OR;
+}
+
+/** opposite comparator (NOT (x <comp> val)) */
+static filter_comparator_t pd_negate_comp(filter_comparator_t comp)
+{
+    switch (comp)
+    {
+        case EQUAL:             return NOTEQUAL;
+        case NOTEQUAL:          return EQUAL;
+        case LESSTHAN:          return MORETHAN_STRICT;
+        case MORETHAN:          return LESSTHAN_STRICT;
+        case LESSTHAN_STRICT:   return MORETHAN;
+        case MORETHAN_STRICT:   return LESSTHAN;
+        case LIKE:              return UNLIKE;
+        case UNLIKE:            return LIKE;
+        case ILIKE:             return IUNLIKE;
+        case IUNLIKE:           return ILIKE;
+        case IN:                return NOTIN;
+        case NOTIN:             return IN;
+        case ISNULL:            return NOTNULL;
+        case NOTNULL:           return ISNULL;
+        default:                return comp; /* caller sets FILTER_FLAG_NOT */
+    }
+}
+
+static bool pd_negative_comp(filter_comparator_t comp)
+{
+    return comp == NOTEQUAL || comp == UNLIKE || comp == IUNLIKE
+           || comp == NOTIN;
+}
+
+/**
+ * Check if the LIKE pattern converted by convert_regexp() matches
+ * the same strings as the shell pattern.
+ */
+static bool pd_like_exact(const char *pattern)
+{
+    /* classes are converted to '_' and '%', '_', '\' are not escaped */
+    if (strpbrk(pattern, "[]%_\\") != NULL)
+        return false;
+
+#ifdef _SQLITE
+    /* SQLite LIKE is case insensitive */
+    {
+        const char *c;
+
+        for (c = pattern; *c != '\0'; c++)
+            if (isalpha(*c))
+                return false;
+    }
+#endif
+    return true;
+}
+
+/** DB table of an attribute (T_NONE if it can't be filtered) */
+static table_enum pd_table(unsigned int index)
+{
+    if (is_names_field(index))
+        return T_DNAMES;
+    if (is_stripe_field(index))
+        return (field_type(index) == DB_STRIPE_INFO) ? T_STRIPE_INFO
+                                                     : T_STRIPE_ITEMS;
+    if (is_main_field(index))
+        return T_MAIN;
+    if (is_annex_field(index))
+        return T_ANNEX;
+    return T_NONE;
+}
+
+/**
+ * Translate a condition to a DB condition.
+ * @param reason set to a description when the condition is not exact.
+ */
+static pd_class_e pd_condition(const compare_triplet_t *triplet, bool neg,
+                               int flags, const sm_instance_t *smi,
+                               const time_modifier_t *time_mod,
+                               struct pd_cond *cond, table_enum *table,
+                               const char **reason)
+{
+    bool        must_free = false;
+    bool        negative, is_str, exact = true;
+    attr_mask_t tmp;
+
+    cond->index = ATTR_INDEX_FLG_UNSPEC;
+    cond->flags = 0;
+
+    if (criteria2filter(triplet, &cond->index, &cond->comp, &cond->val,
+                        &must_free, smi, time_mod) != 0
+        || (cond->index & ATTR_INDEX_FLG_UNSPEC))
+    {
+        *reason = "no DB field";
+        goto local;
+    }
+    if (must_free)
+        cond->flags |= FILTER_FLAG_ALLOC_STR;
+
+    tmp = null_mask;
+    attr_mask_set_index(&tmp, cond->index);
+    *table = pd_table(cond->index);
+    if (readonly_fields(tmp) || *table == T_NONE)
+    {
+        *reason = "not stored in DB";
+        goto local;
+    }
+    if (*table == T_DNAMES && (flags & PUSHDOWN_SKIP_NAMES))
+    {
+        *reason = "names not filtered in this mode";
+        goto local;
+    }
+
+    if (neg)
+    {
+        filter_comparator_t comp = pd_negate_comp(cond->comp);
+
+        if (comp == cond->comp)
+            cond->flags |= FILTER_FLAG_NOT;
+        else
+            cond->comp = comp;
+    }
+    negative = pd_negative_comp(cond->comp)
+               ^ !!(cond->flags & FILTER_FLAG_NOT);
+
+    is_str = (field_type(cond->index) == DB_TEXT
+              || field_type(cond->index) == DB_ENUM_FTYPE);
+
+    if (*table == T_STRIPE_INFO || *table == T_STRIPE_ITEMS)
+    {
+        *reason = "stripe condition";
+        exact = false;
+    }
+    else if (triplet->flags & (CMP_FLG_INSENSITIVE | CMP_FLG_ANY_LEVEL))
+    {
+        *reason = "pattern flags";
+        exact = false;
+    }
+    else if (is_str && (cond->comp == LIKE || cond->comp == UNLIKE)
+             && !pd_like_exact(cond->val.value.val_str))
+    {
+        *reason = "pattern not exactly translated to SQL";
+        exact = false;
+    }
+    else if (is_str && (cond->comp == EQUAL || cond->comp == NOTEQUAL)
+             && !is_status_field(cond->index)
+             && cond->index != ATTR_INDEX_type
+             && strpbrk(cond->val.value.val_str, "*?[") != NULL)
+    {
+        /* locally matched as a pattern, literally compared in DB */
+        *reason = "wildcards in equality";
+        goto local;
+    }
+    else if (is_sepdlist(cond->index)
+             && strpbrk(cond->val.value.val_str, "*?[]%_\\") != NULL)
+    {
+        *reason = "pattern in list";
+        goto local;
+    }
+
+    /* the negation of a larger set is a smaller set */
+    if (!exact && negative)
+        goto local;
+
+    /* missing status is locally matched as an empty status.
+     * Other entries with a missing attribute don't match. */
+    if (is_str && allow_null(cond->index, &cond->comp, &cond->val))
+    {
+        cond->flags |= FILTER_FLAG_ALLOW_NULL;
+        if (!is_status_field(cond->index))
+        {
+            *reason = "NULL values";
+            exact = false;
+        }
+    }
+
+    return exact ? PD_EXACT : PD_PREFILTER;
+
+local:
+    if (must_free)
+        MemFree((char *)cond->val.value.val_str);
+    cond->flags = 0;
+    return PD_LOCAL;
+}
+
+/** Translate a term (condition, or OR of conditions) to DB conditions. */
+static pd_class_e pd_term(const struct pd_term *term, int flags,
+                          const sm_instance_t *smi,
+                          const time_modifier_t *time_mod,
+                          struct pd_cond *conds, unsigned int *cond_count,
+                          struct pd_term *ors, const char **reason)
+{
+    unsigned int i, count = 0;
+    table_enum   table = T_NONE, first = T_NONE;
+    pd_class_e   cls = PD_EXACT, c;
+
+    *cond_count = 0;
+    *reason = NULL;
+
+    if (pd_is_or(term))
+        pd_collect(term->node, term->neg, BOOL_OR, ors, &count);
+    else
+    {
+        ors[0] = *term;
+        count = 1;
+    }
+
+    for (i = 0; i < count; i++)
+    {
+        if (ors[i].node->node_type == NODE_CONSTANT)
+        {
+            *reason = "constant";
+            cls = PD_LOCAL;
+            break;
+        }
+        else if (ors[i].node->node_type != NODE_CONDITION)
+        {
+            *reason = "nested expression";
+            cls = PD_LOCAL;
+            break;
+        }
+
+        c = pd_condition(ors[i].node->content_u.condition, ors[i].neg,
+                         flags, smi, time_mod, &conds[i], &table, reason);
+        if (c == PD_LOCAL)
+        {
+            cls = PD_LOCAL;
+            break;
+        }
+        (*cond_count)++;
+
+        /* filters are built table by table */
+        if (i == 0)
+            first = table;
+        else if (table != first)
+        {
+            *reason = "OR across several tables";
+            cls = PD_LOCAL;
+            break;
+        }
+
+        if (c < cls)
+            cls = c;
+    }
+
+    if (cls == PD_LOCAL)
+    {
+        /* release conditions built so far */
+        for (i = 0; i < *cond_count; i++)
+            if (conds[i].flags & FILTER_FLAG_ALLOC_STR)
+                MemFree((char *)conds[i].val.value.val_str);
+        *cond_count = 0;
+    }
+    return cls;
+}
+
+/** append a term to a residual expression */
+static bool_node_t *pd_residual_append(lmgr_pushdown_t *pd, bool_node_t *res,
+                                       const struct pd_term *term)
+{
+    bool_node_t *node = term->node;
+
+    if (term->neg)
+    {
+        node = &pd->nodes[pd->node_count++];
+        node->node_type = NODE_UNARY_EXPR;
+        node->content_u.bool_expr.bool_op = BOOL_NOT;
+        node->content_u.bool_expr.expr1 = term->node;
+        node->content_u.bool_expr.expr2 = NULL;
+        node->content_u.bool_expr.owner = 0;
+    }
+    if (res == NULL)
+        return node;
+
+    pd->nodes[pd->node_count].node_type = NODE_BINARY_EXPR;
+    pd->nodes[pd->node_count].content_u.bool_expr.bool_op = BOOL_AND;
+    pd->nodes[pd->node_count].content_u.bool_expr.expr1 = res;
+    pd->nodes[pd->node_count].content_u.bool_expr.expr2 = node;
+    pd->nodes[pd->node_count].content_u.bool_expr.owner = 0;
+    return &pd->nodes[pd->node_count++];
+}
+
+static void pd_explain(GString *explain, const struct pd_term *term,
+                       pd_class_e cls, const char *reason)
+{
+    char str[RBH_PATH_MAX];
+
+    if (BoolExpr2str(term->node, str, sizeof(str)) < 0)
+        rh_strncpy(str, "?", sizeof(str));
+
+    g_string_append_printf(explain, "%-9s %s%s%s", pd_class2str(cls),
+                           term->neg ? "NOT (" : "", str,
+                           term->neg ? ")" : "");
+    if (cls != PD_EXACT && reason != NULL)
+        g_string_append_printf(explain, "    [%s]", reason);
+    g_string_append_c(explain, '\n');
+}
+
+int lmgr_pushdown_boolexpr(bool_node_t *boolexpr, lmgr_filter_t *filter,
+                           const sm_instance_t *smi,
+                           const time_modifier_t *time_mod, int flags,
+                           lmgr_pushdown_t *pd, GString *explain)
+{
+    struct pd_term *terms, *ors;
+    struct pd_cond *conds;
+    unsigned int    max, count = 0, cond_count, i, j;
+    bool_node_t    *res = NULL;
+    const char     *reason;
+    pd_class_e      cls;
+    int             rc = 0;
+
+    max = pd_count_nodes(boolexpr);
+    terms = MemCalloc(max, sizeof(*terms));
+    ors = MemCalloc(max, sizeof(*ors));
+    conds = MemCalloc(max, sizeof(*conds));
+    if (pd != NULL)
+    {
+        memset(pd, 0, sizeof(*pd));
+        /* at most a NOT and an AND node per term */
+        pd->nodes = MemCalloc(2 * max, sizeof(*pd->nodes));
+    }
+    if (terms == NULL || ors == NULL || conds == NULL
+        || (pd != NULL && pd->nodes == NULL))
+    {
+        rc = DB_NO_MEMORY;
+        goto out;
+    }
+
+    pd_collect(boolexpr, false, BOOL_AND, terms, &count);
+
+    for (i = 0; i < count; i++)
+    {
+        cls = pd_term(&terms[i], flags, smi, time_mod, conds, &cond_count,
+                      ors, &reason);
+
+        for (j = 0; j < cond_count; j++)
+        {
+            int flg = conds[j].flags;
+
+            /* (x OR y OR z) */
+            if (cond_count > 1)
+            {
+                if (j == 0)
+                    flg |= FILTER_FLAG_BEGIN;
+                else
+                    flg |= FILTER_FLAG_OR;
+                if (j == cond_count - 1)
+                    flg |= FILTER_FLAG_END;
+            }
+
+            DisplayLog(LVL_FULL, LISTMGR_TAG, "Appending filter on \"%s\", "
+                       "flags=%#X", field_name(conds[j].index), flg);
+
+            rc = lmgr_simple_filter_add(filter, conds[j].index, conds[j].comp,
+                                        conds[j].val, flg);
+            if (rc)
+            {
+                /* release the remaining strings */
+                for (j = j + 1; j < cond_count; j++)
+                    if (conds[j].flags & FILTER_FLAG_ALLOC_STR)
+                        MemFree((char *)conds[j].val.value.val_str);
+                goto out;
+            }
+        }
+
+        if (cls != PD_EXACT && pd != NULL)
+            res = pd_residual_append(pd, res, &terms[i]);
+
+        if (explain != NULL)
+            pd_explain(explain, &terms[i], cls, reason);
+    }
+
+out:
+    if (pd != NULL)
+    {
+        if (rc)
+            lmgr_pushdown_free(pd);
+        else
+            pd->residual = res;
+    }
+    if (terms != NULL)
+        MemFree(terms);
+    if (ors != NULL)
+        MemFree(ors);
+    if (conds != NULL)
+        MemFree(conds);
+    return rc;
+}
+
+void lmgr_pushdown_free(lmgr_pushdown_t *pd)
+{
+    /* nodes of the residual expression don't own their children */
+    if (pd->nodes != NULL)
+        MemFree(pd->nodes);
+    memset(pd, 0, sizeof(*pd));
+}
+
+/** release the strings of DB conditions */
+static void pd_conds_free(struct pd_cond *conds, unsigned int count)
+{
+    unsigned int i;
+
+    for (i = 0; i < count; i++)
+        if (conds[i].flags & FILTER_FLAG_ALLOC_STR)
+            MemFree((char *)conds[i].val.value.val_str);
+}
+
+/** get the best AND-ed condition of an expression on the main table */
+static pd_class_e pd_main_cond(const lmgr_or_expr_t *expr,
+                               struct pd_cond *best)
+{
+    struct pd_term *terms;
+    struct pd_cond  cond;
+    unsigned int    count = 0, i;
+    table_enum      table;
+    const char     *reason;
+    pd_class_e      cls, best_cls = PD_LOCAL;
+
+    terms = MemCalloc(pd_count_nodes(expr->boolexpr), sizeof(*terms));
+    if (terms == NULL)
+        return PD_LOCAL;
+
+    pd_collect(expr->boolexpr, false, BOOL_AND, terms, &count);
+
+    for (i = 0; i < count && best_cls != PD_EXACT; i++)
+    {
+        if (terms[i].node->node_type != NODE_CONDITION)
+            continue;
+
+        table = T_NONE;
+        cls = pd_condition(terms[i].node->content_u.condition, terms[i].neg,
+                           0, expr->smi, expr->time_mod, &cond, &table,
+                           &reason);
+        if (cls == PD_LOCAL)
+            continue;
+
+        if (table != T_MAIN || cls <= best_cls)
+        {
+            pd_conds_free(&cond, 1);
+            continue;
+        }
+
+        if (best_cls != PD_LOCAL)
+            pd_conds_free(best, 1);
+        *best = cond;
+        best_cls = cls;
+    }
+
+    MemFree(terms);
+    return best_cls;
+}
+
+int lmgr_pushdown_or(const lmgr_or_expr_t *exprs, unsigned int count,
+                     lmgr_filter_t *filter)
+{
+    struct pd_cond *conds;
+    unsigned int    i;
+    int             rc = 0;
+
+    if (count == 0)
+        return DB_INVALID_ARG;
+
+    conds = MemCalloc(count, sizeof(*conds));
+    if (conds == NULL)
+        return DB_NO_MEMORY;
+
+    for (i = 0; i < count; i++)
+    {
+        if (pd_main_cond(&exprs[i], &conds[i]) == PD_LOCAL)
+        {
+            pd_conds_free(conds, i);
+            rc = DB_INVALID_ARG;
+            goto out;
+        }
+    }
+
+    for (i = 0; i < count; i++)
+    {
+        int flg = conds[i].flags;
+
+        /* (x OR y OR z) */
+        if (count > 1)
+        {
+            if (i == 0)
+                flg |= FILTER_FLAG_BEGIN;
+            else
+                flg |= FILTER_FLAG_OR;
+            if (i == count - 1)
+                flg |= FILTER_FLAG_END;
+        }
+
+        DisplayLog(LVL_FULL, LISTMGR_TAG, "Appending filter on \"%s\", "
+                   "flags=%#X", field_name(conds[i].index), flg);
+
+        rc = lmgr_simple_filter_add(filter, conds[i].index, conds[i].comp,
+                                    conds[i].val, flg);
+        if (rc)
+        {
+            /* release the remaining strings */
+            pd_conds_free(&conds[i + 1], count - i - 1);
+            goto out;
+        }
+    }
+
+out:
+    MemFree(conds);
+    return rc;
+}
+
+int lmgr_filter2sql(lmgr_t *p_mgr, const lmgr_filter_t *p_filter,
+                    GString *where)
+{
+    struct field_count counts = {0};
+
+    return filter_where(p_mgr, p_filter, &counts, where, 0);
+}
+
 
 /** Set a complex filter structure */
 int lmgr_set_filter_expression( lmgr_filter_t * p_filter, struct bool_node_t *boolexpr )
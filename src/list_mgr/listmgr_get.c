@@ -23,6 +23,7 @@
 #include "database.h"
 #include "rbh_logs.h"
 #include "rbh_misc.h"
+#include "Memory.h"
 
 #include <stdio.h>
 #include <stdlib.h>
@@ -447,6 +448,190 @@ retry:
 }
 
 
+/**
+ * Retrieve the same set of attributes for several entries,
+ * with a single request to the database.
+ */
+static int listmgr_batch_get(lmgr_t *p_mgr, unsigned int count,
+                             const entry_id_t **ids, attr_set_t **attrs,
+                             int *rcs)
+{
+    int             rc;
+    unsigned int    i;
+    GString        *req, *from;
+    pktype         *pks;
+    GHashTable     *pk_index;
+    /* 1 field for id + attribute count (up to 1 per bit, x2 for bullet
+     * proofing) */
+    char           *result_tab[1 + 2*8*sizeof(attr_mask_t)];
+    result_handle_t result;
+    attr_mask_t     mask = attrs[0]->attr_mask;
+    attr_mask_t     gen = gen_fields(mask);
+    int             main_count  = 0,
+                    annex_count = 0,
+                    name_count  = 0;
+
+    pks = MemAlloc(count * sizeof(*pks));
+    if (pks == NULL)
+        return DB_NO_MEMORY;
+
+    pk_index = g_hash_table_new(g_str_hash, g_str_equal);
+    req = g_string_new("SELECT "MAIN_TABLE".id");
+    from = g_string_new(" FROM "MAIN_TABLE);
+
+    add_source_fields_for_gen(&mask.std);
+    supported_bits_only(&mask);
+
+    /* Always query MAIN table first, as it indicates if the entry exists */
+    main_count = attrmask2fieldlist(req, mask, T_MAIN, "", "", AOF_LEADING_SEP);
+    if (main_count < 0)
+    {
+        rc = -main_count;
+        goto free_str;
+    }
+
+    annex_count = attrmask2fieldlist(req, mask, T_ANNEX, "", "", AOF_LEADING_SEP);
+    if (annex_count < 0)
+    {
+        rc = -annex_count;
+        goto free_str;
+    }
+    else if (annex_count > 0)
+        g_string_append(from, " LEFT JOIN "ANNEX_TABLE" ON "MAIN_TABLE".id="
+                        ANNEX_TABLE".id");
+
+    name_count = attrmask2fieldlist(req, mask, T_DNAMES, "", "", AOF_LEADING_SEP);
+    if (name_count < 0)
+    {
+        rc = -name_count;
+        goto free_str;
+    }
+    else if (name_count > 0)
+        /* an entry with multiple paths returns several records:
+         * only the first one is taken into account (see listmgr_get_by_pk) */
+        g_string_append(from, " LEFT JOIN "DNAMES_TABLE" ON "MAIN_TABLE".id="
+                        DNAMES_TABLE".id");
+
+    g_string_append_printf(req, "%s WHERE "MAIN_TABLE".id IN (", from->str);
+    for (i = 0; i < count; i++)
+    {
+        entry_id2pk(ids[i], PTR_PK(pks[i]));
+        g_hash_table_insert(pk_index, pks[i], GUINT_TO_POINTER(i + 1));
+
+        g_string_append_printf(req, i == 0 ? DPK : ","DPK, pks[i]);
+
+        /* not found until we get a record for it */
+        rcs[i] = DB_NOT_EXISTS;
+        memset(&attrs[i]->attr_values, 0, sizeof(entry_info_t));
+    }
+    g_string_append(req, ")");
+
+    rc = db_exec_sql(&p_mgr->conn, req->str, &result);
+    if (rc)
+        goto free_str;
+
+    while ((rc = db_next_record(&p_mgr->conn, &result, result_tab,
+                                1 + main_count + annex_count + name_count))
+           == DB_SUCCESS)
+    {
+        int          shift = 1;
+        attr_set_t  *p_info;
+
+        if (result_tab[0] == NULL)
+            continue;
+
+        i = GPOINTER_TO_UINT(g_hash_table_lookup(pk_index, result_tab[0]));
+        /* unexpected id, or entry already set from a previous record */
+        if (i == 0 || rcs[i - 1] != DB_NOT_EXISTS)
+            continue;
+        i--;
+        p_info = attrs[i];
+
+        p_info->attr_mask = mask;
+        rcs[i] = DB_SUCCESS;
+
+        if (main_count)
+        {
+            rcs[i] = result2attrset(T_MAIN, result_tab + shift, main_count,
+                                    p_info);
+            shift += main_count;
+        }
+        if (annex_count && rcs[i] == DB_SUCCESS)
+        {
+            rcs[i] = result2attrset(T_ANNEX, result_tab + shift, annex_count,
+                                    p_info);
+            shift += annex_count;
+        }
+        if (name_count && rcs[i] == DB_SUCCESS)
+        {
+            rcs[i] = result2attrset(T_DNAMES, result_tab + shift, name_count,
+                                    p_info);
+            shift += name_count;
+        }
+        if (rcs[i] != DB_SUCCESS)
+            continue;
+
+        /* restore generated fields in attr mask */
+        p_info->attr_mask = attr_mask_or(&p_info->attr_mask, &gen);
+        /* generate them */
+        generate_fields(p_info);
+
+        /* update operation stats */
+        p_mgr->nbop[OPIDX_GET]++;
+    }
+    db_result_free(&p_mgr->conn, &result);
+
+    if (rc == DB_END_OF_LIST)
+        rc = DB_SUCCESS;
+
+    /* no attrs for missing entries */
+    for (i = 0; i < count; i++)
+        if (rcs[i] == DB_NOT_EXISTS)
+            clean_std_table_bits(&attrs[i]->attr_mask);
+
+free_str:
+    g_string_free(req, TRUE);
+    g_string_free(from, TRUE);
+    g_hash_table_destroy(pk_index);
+    MemFree(pks);
+    return rc;
+}
+
+int ListMgr_BatchGet(lmgr_t *p_mgr, unsigned int count,
+                     const entry_id_t **ids, attr_set_t **attrs, int *rcs)
+{
+    attr_mask_t req_mask, mask;
+    unsigned int i;
+    int rc;
+
+    if (count == 0)
+        return DB_SUCCESS;
+
+    req_mask = mask = attrs[0]->attr_mask;
+    supported_bits_only(&mask);
+
+    /* stripe and directory attributes are not in main, annex and names
+     * tables: get them entry by entry. */
+    if (count == 1 || stripe_fields(mask) || dirattr_fields(mask))
+    {
+        for (i = 0; i < count; i++)
+            rcs[i] = ListMgr_Get(p_mgr, ids[i], attrs[i]);
+        return DB_SUCCESS;
+    }
+
+retry:
+    rc = listmgr_batch_get(p_mgr, count, ids, attrs, rcs);
+    if (lmgr_delayed_retry(p_mgr, rc))
+    {
+        /* restore the requested mask for the retry */
+        for (i = 0; i < count; i++)
+            attrs[i]->attr_mask = req_mask;
+        goto retry;
+    }
+    return rc;
+}
+
+
 /* Retrieve the FID from the database given the parent FID and the file name. */
 int ListMgr_Get_FID_from_Path( lmgr_t * p_mgr, const entry_id_t * parent_fid,
                                const char *name, entry_id_t * fid)
@@ -23,6 +23,8 @@
 #include "rbh_logs.h"
 #include "rbh_misc.h"
 #include <stdio.h>
+#include <inttypes.h>
+#include <time.h>
 #include <pwd.h>
 #include <grp.h>
 
@@ -1375,6 +1377,115 @@ static int run_create_index(db_conn_t *pconn, const char *table_name,
     return DB_SUCCESS;
 }
 
+/** check if an index exists */
+static int check_index(db_conn_t *pconn, const char *table_name,
+                       const char *index_name)
+{
+    GString        *req;
+    result_handle_t result;
+    char           *res;
+    int             rc;
+
+#ifdef _MYSQL
+    req = g_string_new(NULL);
+    g_string_printf(req, "SELECT INDEX_NAME FROM INFORMATION_SCHEMA.STATISTICS "
+                    "WHERE TABLE_SCHEMA='%s' AND TABLE_NAME='%s' AND INDEX_NAME='%s'",
+                    lmgr_config.db_config.db, table_name, index_name);
+#else
+    req = g_string_new(NULL);
+    g_string_printf(req, "SELECT name FROM sqlite_master WHERE type='index' "
+                    "AND tbl_name='%s' AND name='%s'", table_name, index_name);
+#endif
+
+    rc = db_exec_sql(pconn, req->str, &result);
+    if (rc == DB_SUCCESS)
+    {
+        rc = db_next_record(pconn, &result, &res, 1);
+        if (rc == DB_END_OF_LIST)
+            rc = DB_NOT_EXISTS;
+        db_result_free(pconn, &result);
+    }
+    g_string_free(req, TRUE);
+    return rc;
+}
+
+/**
+ * Create indexes on the indexed fields of a table.
+ * @param if_missing only create indexes that don't exist yet.
+ */
+static int create_field_indexes(db_conn_t *pconn, table_enum table,
+                                const char *table_name, bool if_missing)
+{
+    GString *request = g_string_new(NULL);
+    char     index_name[128];
+    int      i, rc = DB_SUCCESS, cookie;
+
+    cookie = -1;
+    while ((i = attr_index_iter(0, &cookie)) != -1)
+    {
+        if (!match_table(table, i) || !is_indexed_field(i))
+            continue;
+
+        snprintf(index_name, sizeof(index_name), "%s_index", field_name(i));
+
+        if (if_missing)
+        {
+            rc = check_index(pconn, table_name, index_name);
+            if (rc == DB_SUCCESS)
+                continue;
+            else if (rc != DB_NOT_EXISTS)
+                break;
+            DisplayLog(LVL_EVENT, LISTMGR_TAG, "Building index %s on %s...",
+                       index_name, table_name);
+        }
+
+        g_string_printf(request, "CREATE INDEX %s ON %s(%s)", index_name,
+                        table_name, field_name(i));
+        rc = run_create_index(pconn, table_name, field_name(i), request->str);
+        if (rc)
+            break;
+    }
+
+    g_string_free(request, TRUE);
+    return rc;
+}
+
+/** Drop indexes on the indexed fields of a table */
+static int drop_field_indexes(db_conn_t *pconn, table_enum table,
+                              const char *table_name)
+{
+    GString *request = g_string_new(NULL);
+    char     errmsg[1024];
+    int      i, rc = DB_SUCCESS, cookie;
+
+    cookie = -1;
+    while ((i = attr_index_iter(0, &cookie)) != -1)
+    {
+        if (!match_table(table, i) || !is_indexed_field(i))
+            continue;
+
+#ifdef _MYSQL
+        g_string_printf(request, "DROP INDEX %s_index ON %s", field_name(i),
+                        table_name);
+#else
+        g_string_printf(request, "DROP INDEX IF EXISTS %s_index", field_name(i));
+#endif
+        rc = db_exec_sql(pconn, request->str, NULL);
+        if (rc)
+        {
+            DisplayLog(LVL_CRIT, LISTMGR_TAG, "Failed to drop index of %s(%s): Error: %s",
+                       table_name, field_name(i),
+                       db_errmsg(pconn, errmsg, sizeof(errmsg)));
+            break;
+        }
+        DisplayLog(LVL_VERB, LISTMGR_TAG, "Index on %s(%s) dropped", table_name,
+                   field_name(i));
+    }
+
+    g_string_free(request, TRUE);
+    return rc;
+}
+
 static void append_engine(GString *request)
 {
 #ifdef _MYSQL
@@ -1491,19 +1602,7 @@ static int create_table_main(db_conn_t *pconn, bool *affects_trig)
         goto free_str;
 
     /* create indexes on this table */
-    cookie = -1;
-    while ((i = attr_index_iter(0, &cookie)) != -1)
-    {
-        if (is_main_field(i) && is_indexed_field(i))
-        {
-            g_string_printf(request, "CREATE INDEX %s_index ON " MAIN_TABLE "(%s)",
-                            field_name(i), field_name(i));
-            rc = run_create_index(pconn, MAIN_TABLE, field_name(i), request->str);
-            if (rc)
-                goto free_str;
-        }
-    }
-    rc = DB_SUCCESS;
+    rc = create_field_indexes(pconn, T_MAIN, MAIN_TABLE, false);
 
 free_str:
     g_string_free(request, TRUE);
@@ -1575,18 +1674,9 @@ static int create_table_dnames(db_conn_t *pconn, bool *affects_trig)
         goto free_str;
 
     /* create indexes on this table */
-    cookie = -1;
-    while ((i = attr_index_iter(0, &cookie)) != -1)
-    {
-        if (is_names_field(i) && is_indexed_field(i))
-        {
-            g_string_printf(request, "CREATE INDEX %s_index ON " DNAMES_TABLE "(%s)",
-                            field_name(i), field_name(i));
-            rc = run_create_index(pconn, DNAMES_TABLE, field_name(i), request->str);
-            if (rc)
-                goto free_str;
-        }
-    }
+    rc = create_field_indexes(pconn, T_DNAMES, DNAMES_TABLE, false);
+    if (rc)
+        goto free_str;
 
     /* this index is needed to build the fullpath of entries */
     rc = run_create_index(pconn, DNAMES_TABLE, "id",
@@ -1667,19 +1757,7 @@ static int create_table_annex(db_conn_t *pconn, bool *affects_trig)
         goto free_str;
 
     /* create indexes on this table */
-    cookie = -1;
-    while ((i = attr_index_iter(0, &cookie)) != -1)
-    {
-        if (is_annex_field(i) && is_indexed_field(i))
-        {
-            g_string_printf(request, "CREATE INDEX %s_index ON " ANNEX_TABLE "(%s)",
-                            field_name(i), field_name(i));
-            rc = run_create_index(pconn, ANNEX_TABLE, field_name(i), request->str);
-            if (rc)
-                goto free_str;
-        }
-    }
-    rc = DB_SUCCESS;
+    rc = create_field_indexes(pconn, T_ANNEX, ANNEX_TABLE, false);
 
 free_str:
     g_string_free(request, TRUE);
@@ -1828,6 +1906,151 @@ static int create_table_stripe_items(db_conn_t *pconn, bool *affects_trig)
                           "CREATE INDEX ost_index ON "STRIPE_ITEMS_TABLE"(ostidx)");
     return rc;
 }
+
+/* name of the time attribute indexed in OST_LRU */
+#define VAR_OST_LRU_ATTR    "OSTLRUAttr"
+
+/** fill OST_LRU table from the current contents of STRIPE_ITEMS */
+static int populate_ost_lru(db_conn_t *pconn)
+{
+    GString *request;
+    char     err_buf[1024];
+    char     timestr[256] = "";
+    char     t[128];
+    time_t   estimated;
+    int      rc;
+
+    estimated = estimated_time(pconn, STRIPE_ITEMS_TABLE, 50000);
+    if (estimated > 0)
+        snprintf(timestr, sizeof(timestr), " (estim. duration: ~%s)",
+                 FormatDurationFloat(t, sizeof(t), estimated));
+
+    DisplayLog(LVL_MAJOR, LISTMGR_TAG, "Populating "OST_LRU_TABLE" table from "
+               "existing DB contents. This can take a while...%s", timestr);
+    FlushLogs();
+
+    rc = db_exec_sql(pconn, "DELETE FROM "OST_LRU_TABLE, NULL);
+    if (rc)
+        goto err;
+
+    request = g_string_new(NULL);
+    g_string_printf(request, "INSERT INTO "OST_LRU_TABLE"(id,ostidx,lru) "
+                    "SELECT DISTINCT S.id,S.ostidx,M.%s FROM "STRIPE_ITEMS_TABLE
+                    " S INNER JOIN "MAIN_TABLE" M ON S.id=M.id",
+                    field_name(lmgr_config.ost_lru_attr));
+    rc = db_exec_sql(pconn, request->str, NULL);
+    g_string_free(request, TRUE);
+    if (rc)
+        goto err;
+
+    rc = lmgr_set_var(pconn, VAR_OST_LRU_ATTR,
+                      field_name(lmgr_config.ost_lru_attr));
+    if (rc)
+        goto err;
+
+    return DB_SUCCESS;
+
+err:
+    DisplayLog(LVL_CRIT, LISTMGR_TAG,
+               "Failed to populate "OST_LRU_TABLE" table: Error: %s",
+               db_errmsg(pconn, err_buf, sizeof(err_buf)));
+    return rc;
+}
+
+static int check_table_ost_lru(db_conn_t *pconn, bool *affects_trig)
+{
+    int   rc;
+    char  strbuf[4096];
+    char *fieldtab[MAX_DB_FIELDS];
+
+    rc = db_list_table_info(pconn, OST_LRU_TABLE, fieldtab, NULL, NULL,
+                            MAX_DB_FIELDS, strbuf, sizeof(strbuf));
+
+    if (rc == DB_SUCCESS)
+    {
+        int curr_field_index = 0;
+
+        /* The table is not maintained when the feature is disabled:
+         * drop it, else it may become inconsistent. */
+        if (!ost_lru_enabled())
+        {
+            if (report_only)
+                return DB_SUCCESS;
+
+            DisplayLog(LVL_MAJOR, LISTMGR_TAG,
+                       "OST LRU index is disabled: dropping table "OST_LRU_TABLE);
+            rc = db_drop_component(pconn, DBOBJ_TABLE, OST_LRU_TABLE);
+            if (rc != DB_SUCCESS)
+                DisplayLog(LVL_CRIT, LISTMGR_TAG,
+                           "Failed to drop table: Error: %s",
+                           db_errmsg(pconn, strbuf, sizeof(strbuf)));
+            return rc;
+        }
+
+        if (check_field_name("id", &curr_field_index, OST_LRU_TABLE, fieldtab))
+            return DB_BAD_SCHEMA;
+        if (check_field_name("ostidx", &curr_field_index, OST_LRU_TABLE, fieldtab))
+            return DB_BAD_SCHEMA;
+        if (check_field_name("lru", &curr_field_index, OST_LRU_TABLE, fieldtab))
+            return DB_BAD_SCHEMA;
+        if (has_extra_field(curr_field_index, OST_LRU_TABLE, fieldtab, true))
+            return DB_BAD_SCHEMA;
+
+        /* has the indexed attribute changed? */
+        rc = lmgr_get_var(pconn, VAR_OST_LRU_ATTR, strbuf, sizeof(strbuf));
+        if (rc == DB_SUCCESS
+            && !strcmp(strbuf, field_name(lmgr_config.ost_lru_attr)))
+            return DB_SUCCESS;
+        else if (rc != DB_SUCCESS && rc != DB_NOT_EXISTS)
+            return rc;
+
+        if (report_only)
+        {
+            DisplayLog(LVL_MAJOR, LISTMGR_TAG, "WARNING: "OST_LRU_TABLE
+                       " table is not indexed by %s",
+                       field_name(lmgr_config.ost_lru_attr));
+            return DB_SUCCESS;
+        }
+        return populate_ost_lru(pconn);
+    }
+    else if (rc == DB_NOT_EXISTS)
+    {
+        /* only create the table if the feature is enabled */
+        if (!ost_lru_enabled())
+            return DB_SUCCESS;
+    }
+    else
+    {
+            DisplayLog(LVL_CRIT, LISTMGR_TAG,
+                       "Error checking database schema: %s",
+                       db_errmsg(pconn, strbuf, sizeof(strbuf)));
+    }
+    return rc;
+}
+
+static int create_table_ost_lru(db_conn_t *pconn, bool *affects_trig)
+{
+    GString *request;
+    int  rc;
+
+    request = g_string_new("CREATE TABLE "OST_LRU_TABLE
+                           " (id "PK_TYPE", ostidx INT UNSIGNED, "
+                           "lru INT UNSIGNED, PRIMARY KEY (id, ostidx))");
+    append_engine(request);
+
+    rc = run_create_table(pconn, OST_LRU_TABLE, request->str);
+    g_string_free(request, TRUE);
+    if (rc)
+        return rc;
+
+    /* candidates of a given OST are listed by lru order */
+    rc = run_create_index(pconn, OST_LRU_TABLE, "ostidx,lru",
+                          "CREATE INDEX ost_lru_index ON "OST_LRU_TABLE"(ostidx,lru)");
+    if (rc)
+        return rc;
+
+    return populate_ost_lru(pconn);
+}
 #endif
 
 static void disable_acct(void)
@@ -2435,6 +2658,28 @@ static int check_trig_acct_update(db_conn_t *pconn, bool *affects_trig)
                               acct_info_table);
 }
 
+/** append the upsert clause of accounting triggers
+ * (trigger bodies are not translated by the SQLite wrapper). */
+static void append_acct_upsert(GString *request)
+{
+#ifdef _SQLITE
+    g_string_append(request, " ON CONFLICT(");
+    attrmask2fieldlist(request, acct_pk_attr_set, T_ACCT, "", "", 0);
+    g_string_append(request, ") DO UPDATE SET ");
+#else
+    g_string_append(request, " ON DUPLICATE KEY UPDATE ");
+#endif
+}
+
+#ifdef _SQLITE
+/* SQLite triggers have no local variable: compute size ranges inline */
+#define SZRANGE_NEW  SZRANGE_FUNC"(NEW.size)"
+#define SZRANGE_OLD  SZRANGE_FUNC"(OLD.size)"
+#else
+#define SZRANGE_NEW  "val_new"
+#define SZRANGE_OLD  "val_old"
+#endif
+
 static int create_trig_acct_insert(db_conn_t *pconn, bool *affects_trig)
 {
     int      rc;
@@ -2442,9 +2687,13 @@ static int create_trig_acct_insert(db_conn_t *pconn, bool *affects_trig)
     char     errbuf[1024];
 
     /* Trigger on insert */
-    request = g_string_new("DECLARE val INT;"
-                           "SET val="SZRANGE_FUNC"(NEW.size);"
+#ifdef _SQLITE
+    request = g_string_new("INSERT INTO " ACCT_TABLE "(");
+#else
+    request = g_string_new("DECLARE val_new INT;"
+                           "SET val_new="SZRANGE_FUNC"(NEW.size);"
                            "INSERT INTO " ACCT_TABLE "(");
+#endif
     /* INSERT(list of fields... */
     attrmask2fieldlist(request, acct_pk_attr_set, T_ACCT, "", "", 0);
     attrmask2fieldlist(request, acct_attr_set, T_ACCT, "", "", AOF_LEADING_SEP);
@@ -2457,13 +2706,14 @@ static int create_trig_acct_insert(db_conn_t *pconn, bool *affects_trig)
     attrmask2fieldlist(request, acct_attr_set, T_ACCT, "NEW.", "",
                        AOF_LEADING_SEP);
     g_string_append(request, ",1");
-    append_size_range_val(request, true, "NEW.", "val");
-    g_string_append(request, ") ON DUPLICATE KEY UPDATE ");
+    append_size_range_val(request, true, "NEW.", SZRANGE_NEW);
+    g_string_append(request, ")");
+    append_acct_upsert(request);
 
     /* on duplicate key update... */
     attrmask2fieldoperation(request, acct_attr_set, T_ACCT, "NEW.", ADD);
     g_string_append(request, ", " ACCT_FIELD_COUNT "=" ACCT_FIELD_COUNT "+1");
-    append_size_range_op(request, true, "NEW.", "val", ADD);
+    append_size_range_op(request, true, "NEW.", SZRANGE_NEW, ADD);
     g_string_append(request, ";");
 
     rc = db_drop_component(pconn, DBOBJ_TRIGGER, ACCT_TRIGGER_INSERT);
@@ -2499,13 +2749,17 @@ static int create_trig_acct_delete(db_conn_t *pconn, bool *affects_trig)
     char     err_buf[1024];
 
     /* Trigger on delete */
-    request = g_string_new("DECLARE val INT;"
-                           "SET val="SZRANGE_FUNC"(OLD.size);"
+#ifdef _SQLITE
+    request = g_string_new("UPDATE " ACCT_TABLE " SET ");
+#else
+    request = g_string_new("DECLARE val_old INT;"
+                           "SET val_old="SZRANGE_FUNC"(OLD.size);"
                            "UPDATE " ACCT_TABLE " SET ");
+#endif
     /* update ACCT_TABLE SET ... */
     attrmask2fieldoperation(request, acct_attr_set, T_ACCT, "OLD.", SUBTRACT);
     g_string_append(request, ", " ACCT_FIELD_COUNT  "=" ACCT_FIELD_COUNT  "-1");
-    append_size_range_op(request, true, "OLD.", "val", SUBTRACT);
+    append_size_range_op(request, true, "OLD.", SZRANGE_OLD, SUBTRACT);
 
     /* ... WHERE ... */
     g_string_append(request, " WHERE ");
@@ -2552,6 +2806,11 @@ static int create_trig_acct_update(db_conn_t *pconn, bool *affects_trig)
      * and add new information to the new raw.
      */
     /* Simple case: owner and group are still the same */
+#ifdef _SQLITE
+    /* no control flow in SQLite triggers: each statement of the body
+     * only applies to its case thanks to its WHERE clause */
+    request = g_string_new("UPDATE " ACCT_TABLE " SET ");
+#else
     request = g_string_new("DECLARE val_old,val_new INT;"
                            "SET val_old="SZRANGE_FUNC"(OLD.size);"
                            "SET val_new="SZRANGE_FUNC"(NEW.size);"
@@ -2563,6 +2822,7 @@ static int create_trig_acct_update(db_conn_t *pconn, bool *affects_trig)
     /* generate comparison like NEW.size<>=OLD.size OR NEW.blocks<>OLD.blocks */
     attrmask2fieldcomparison(request, acct_attr_set, T_ACCT, "NEW.", "OLD.", "<>", "OR");
     g_string_append(request, "THEN \n\t\t UPDATE " ACCT_TABLE " SET ");
+#endif
 
     cookie = -1;
     while ((i = attr_index_iter(0, &cookie)) != -1)
@@ -2587,50 +2847,79 @@ static int create_trig_acct_update(db_conn_t *pconn, bool *affects_trig)
     is_first_field = false;
     for (i = 1; i < SZ_PROFIL_COUNT-1; i++) /* 2nd to before the last */
     {
-        g_string_append_printf(request, ",%s=CAST(%s as SIGNED)-CAST((val_old=%u) as SIGNED)+CAST((val_new=%u) as SIGNED)",
+        g_string_append_printf(request, ",%s=CAST(%s as SIGNED)-CAST(("SZRANGE_OLD"=%u) as SIGNED)+CAST(("SZRANGE_NEW"=%u) as SIGNED)",
                                sz_field[i], sz_field[i], i-1, i-1);
     }
     /* last */
-    g_string_append_printf(request, ",%s=CAST(%s as SIGNED)-CAST((val_old>=%u) as SIGNED)+CAST((val_new>=%u) as SIGNED)",
+    g_string_append_printf(request, ",%s=CAST(%s as SIGNED)-CAST(("SZRANGE_OLD">=%u) as SIGNED)+CAST(("SZRANGE_NEW">=%u) as SIGNED)",
                            sz_field[i], sz_field[i], i-1, i-1);
     g_string_append(request, " WHERE ");
     /* generate comparison as follows: owner=NEW.uid AND gid=NEW.gid */
     attrmask2fieldcomparison(request, acct_pk_attr_set, T_ACCT, "", "NEW.", "=", "AND");
+#ifdef _SQLITE
+    g_string_append(request, "AND (");
+    attrmask2fieldcomparison(request, acct_pk_attr_set, T_ACCT, "NEW.", "OLD.", "=", "AND");
+    g_string_append(request, ") AND (");
+    attrmask2fieldcomparison(request, acct_attr_set, T_ACCT, "NEW.", "OLD.", "<>", "OR");
+    g_string_append(request, ");\n");
+
+    /* tricky case: owner and/or group changed */
+    g_string_append(request, "INSERT INTO " ACCT_TABLE "(");
+#else
     g_string_append(request, "; \n\t END IF; \nELSEIF ");
 
     /* tricky case: owner and/or group changed */
 
     attrmask2fieldcomparison(request, acct_pk_attr_set, T_ACCT, "NEW.", "OLD.", "<>", "OR");
     g_string_append(request, "THEN \n\tINSERT INTO " ACCT_TABLE "(");
+#endif
     /* generate fields as follows: owner, gid */
     attrmask2fieldlist(request, acct_pk_attr_set, T_ACCT, "", "", 0);
     /* generate fields as follows: , size, blocks */
     attrmask2fieldlist(request, acct_attr_set, T_ACCT, "", "", AOF_LEADING_SEP);
     g_string_append(request, ", " ACCT_FIELD_COUNT);
     append_size_range_fields(request, true, "");
+#ifdef _SQLITE
+    g_string_append(request, ") SELECT ");
+#else
     g_string_append(request, ") VALUES (");
+#endif
     /* generate fields as follows: NEW.uid, NEW.gid */
     attrmask2fieldlist(request, acct_pk_attr_set, T_ACCT, "NEW.", "", 0);
     attrmask2fieldlist(request, acct_attr_set, T_ACCT, "NEW.", "", AOF_LEADING_SEP);
     g_string_append(request, ",1");
-    append_size_range_val(request, true, "NEW.", "val_new");
+    append_size_range_val(request, true, "NEW.", SZRANGE_NEW);
 
-    g_string_append(request, ") \n\tON DUPLICATE KEY UPDATE ");
+#ifdef _SQLITE
+    /* the WHERE clause also avoids the parsing ambiguity of
+     * INSERT ... SELECT ... ON CONFLICT */
+    g_string_append(request, " WHERE ");
+    attrmask2fieldcomparison(request, acct_pk_attr_set, T_ACCT, "NEW.", "OLD.", "<>", "OR");
+#else
+    g_string_append(request, ") \n\t");
+#endif
+    append_acct_upsert(request);
     /* generate operations as follows: size=size+New.size, blocks=blocks+NEW.blocks */
     attrmask2fieldoperation(request, acct_attr_set, T_ACCT, "NEW.", ADD);
     g_string_append(request, ", " ACCT_FIELD_COUNT "=" ACCT_FIELD_COUNT  "+1");
     /* update size range values */
-    append_size_range_op(request, true, "NEW.", "val_new", ADD);
+    append_size_range_op(request, true, "NEW.", SZRANGE_NEW, ADD);
     g_string_append(request, ";\n"
                     "\tUPDATE " ACCT_TABLE " SET ");
 
     /* generate operations as follows: size=size-Old.size, blocks=blocks-Old.blocks */
     attrmask2fieldoperation(request, acct_attr_set, T_ACCT, "OLD.", SUBTRACT);
     g_string_append(request, ", " ACCT_FIELD_COUNT "=" ACCT_FIELD_COUNT "-1 ");
-    append_size_range_op(request, true, "OLD.", "val_old", SUBTRACT);
+    append_size_range_op(request, true, "OLD.", SZRANGE_OLD, SUBTRACT);
     g_string_append(request, " WHERE ");
     attrmask2fieldcomparison(request, acct_pk_attr_set, T_ACCT, "", "OLD.", "=", "AND");
+#ifdef _SQLITE
+    g_string_append(request, "AND (");
+    attrmask2fieldcomparison(request, acct_pk_attr_set, T_ACCT, "NEW.", "OLD.", "<>", "OR");
+    g_string_append(request, ");\n");
+#else
     g_string_append(request, ";\nEND IF;\n");
+#endif
 
     rc = db_drop_component(pconn, DBOBJ_TRIGGER, ACCT_TRIGGER_UPDATE);
     if (rc != DB_SUCCESS && rc != DB_TRG_NOT_EXISTS)
@@ -2840,6 +3129,8 @@ static const dbobj_descr_t  o_list[] = {
                                       create_table_stripe_info},
     {DBOBJ_TABLE, STRIPE_ITEMS_TABLE, check_table_stripe_items,
                                       create_table_stripe_items},
+    {DBOBJ_TABLE, OST_LRU_TABLE,      check_table_ost_lru,
+                                      create_table_ost_lru},
 #endif
     {DBOBJ_TABLE, SOFT_RM_TABLE, check_table_softrm, create_table_softrm},
 
@@ -2861,41 +3152,21 @@ static const dbobj_descr_t  o_list[] = {
 
 
 /**
- * Initialize the database access module and
- * check and create the schema.
+ * Check the database schema, and create missing objects
+ * (tables, functions, triggers...).
  */
-int ListMgr_Init(enum lmgr_init_flags flags)
+static int check_create_schema(db_conn_t *pconn)
 {
-    int            rc;
-    db_conn_t      conn;
+    int            rc = DB_SUCCESS;
     const dbobj_descr_t *o;
     bool create_all_functions = false;
     bool create_all_triggers = false;
     bool dummy;
 
-    /* store the parameter as a global variable */
-    init_flags = flags;
-
-    /* initialize attr masks for each table */
-    init_attrset_masks(&lmgr_config);
-
-    init_default_field_values();
-
-    /* determine source tables for accounting */
-    acct_info_table = acct_table();
-
-    /* create a database access */
-    rc = db_connect(&conn);
-    if (rc)
-        return rc;
-
-    /* check if tables exist, and check their schema */
-    DisplayLog(LVL_DEBUG, LISTMGR_TAG, "Checking database schema");
-
     /* check function and trigger version: if wrong, drop and re-create them all */
-    if (check_functions_version(&conn) != DB_SUCCESS)
+    if (check_functions_version(pconn) != DB_SUCCESS)
         create_all_functions = true;
-    if (check_triggers_version(&conn, &dummy) != DB_SUCCESS)
+    if (check_triggers_version(pconn, &dummy) != DB_SUCCESS)
         create_all_triggers = true;
 
     for (o = o_list; o->o_name != NULL; o++)
@@ -2903,6 +3174,11 @@ int ListMgr_Init(enum lmgr_init_flags flags)
         /* don't care about triggers for report-only */
         if (report_only && (o->o_type == DBOBJ_TRIGGER))
             continue;
+#ifdef _SQLITE
+        /* functions are registered by the SQLite wrapper at connection */
+        if (o->o_type == DBOBJ_FUNCTION)
+            continue;
+#endif
 
         /* force re-creating triggers and functions, if needed */
         if ((o->o_type == DBOBJ_TRIGGER) && create_all_triggers)
@@ -2910,7 +3186,7 @@ int ListMgr_Init(enum lmgr_init_flags flags)
         else if ((o->o_type == DBOBJ_FUNCTION) && create_all_functions)
             rc = DB_NOT_EXISTS;
         else
-            rc = o->o_check(&conn, &create_all_triggers);
+            rc = o->o_check(pconn, &create_all_triggers);
 
         switch(rc)
         {
@@ -2925,9 +3201,9 @@ int ListMgr_Init(enum lmgr_init_flags flags)
                 {
                     DisplayLog(LVL_EVENT, LISTMGR_TAG, "%s %s does not exist (or wrong version):"
                                " creating it.", dbobj2str(o->o_type), o->o_name);
-                    rc = o->o_create(&conn, &create_all_triggers);
+                    rc = o->o_create(pconn, &create_all_triggers);
                     if (rc != DB_SUCCESS)
-                        goto close_conn;
+                        return rc;
                 }
                 break;
 
@@ -2936,29 +3212,194 @@ int ListMgr_Init(enum lmgr_init_flags flags)
                     DisplayLog(LVL_MAJOR, LISTMGR_TAG, "WARNING: ALTER required on %s %s",
                                dbobj2str(o->o_type), o->o_name);
                 else
-                    goto close_conn;
+                    return rc;
                 break;
 
             default: /* error */
-                goto close_conn;
+                return rc;
         }
     }
 
     if (create_all_triggers && !report_only)
     {
-        rc = set_triggers_version(&conn, &dummy);
+        rc = set_triggers_version(pconn, &dummy);
         if (rc)
-            goto close_conn;
+            return rc;
     }
 
     if (create_all_functions && !report_only)
     {
-        rc = set_functions_version(&conn);
+        rc = set_functions_version(pconn);
+        if (rc)
+            return rc;
+    }
+
+    return DB_SUCCESS;
+}
+
+/* -------- bulk-load mode for the initial scan -------- */
+
+/** set while the DB is in bulk-load mode */
+#define VAR_BULK_LOAD       "BulkLoadStart"
+
+/** tables whose secondary indexes are dropped in bulk-load mode */
+static const struct {
+    table_enum  table;
+    const char *name;
+} bulk_load_tables[] = {
+    {T_MAIN,   MAIN_TABLE},
+    {T_ANNEX,  ANNEX_TABLE},
+    {T_DNAMES, DNAMES_TABLE},
+};
+#define BULK_LOAD_TABLE_COUNT \
+            (sizeof(bulk_load_tables) / sizeof(bulk_load_tables[0]))
+
+/** Build indexes, accounting table and triggers dropped for bulk-load */
+static int bulk_load_finish(db_conn_t *pconn)
+{
+    int rc;
+    unsigned int i;
+
+    DisplayLog(LVL_MAJOR, LISTMGR_TAG, "Leaving bulk-load mode: building "
+               "indexes and accounting info. This can take a while...");
+    FlushLogs();
+
+    for (i = 0; i < BULK_LOAD_TABLE_COUNT; i++)
+    {
+        rc = create_field_indexes(pconn, bulk_load_tables[i].table,
+                                  bulk_load_tables[i].name, true);
+        if (rc)
+            return rc;
+    }
+
+    /* re-create (and populate) accounting table, and triggers */
+    rc = check_create_schema(pconn);
+    if (rc)
+        return rc;
+
+    rc = lmgr_set_var(pconn, VAR_BULK_LOAD, NULL);
+    if (rc)
+        return rc;
+
+    DisplayLog(LVL_MAJOR, LISTMGR_TAG, "Database is back to normal mode");
+    return DB_SUCCESS;
+}
+
+int ListMgr_BulkLoadStart(lmgr_t *p_mgr)
+{
+    uint64_t     count = 0;
+    char         val[128];
+    unsigned int i;
+    int          rc;
+
+    rc = ListMgr_EntryCount(p_mgr, &count);
+    if (rc)
+        return rc;
+    if (count > 0)
+    {
+        DisplayLog(LVL_MAJOR, LISTMGR_TAG, "Bulk-load mode is only allowed "
+                   "on an empty database (%"PRIu64" entries in DB)", count);
+        return DB_NOT_ALLOWED;
+    }
+
+    /* This is remembered in DB, so the normal mode is restored at next
+     * startup if the load is interrupted. */
+    snprintf(val, sizeof(val), "%lu", (unsigned long)time(NULL));
+    rc = lmgr_set_var(&p_mgr->conn, VAR_BULK_LOAD, val);
+    if (rc)
+        return rc;
+
+    DisplayLog(LVL_MAJOR, LISTMGR_TAG, "Entering bulk-load mode: accounting "
+               "and secondary indexes are disabled until the end of the load");
+
+    if (lmgr_config.acct)
+    {
+        const char *trig[] = {ACCT_TRIGGER_INSERT, ACCT_TRIGGER_DELETE,
+                              ACCT_TRIGGER_UPDATE, NULL};
+        const char **t;
+
+        for (t = trig; *t != NULL; t++)
+        {
+            rc = db_drop_component(&p_mgr->conn, DBOBJ_TRIGGER, *t);
+            if (rc != DB_SUCCESS && rc != DB_TRG_NOT_EXISTS)
+                goto err;
+        }
+        /* it is fully rebuilt at the end of the load */
+        rc = db_drop_component(&p_mgr->conn, DBOBJ_TABLE, ACCT_TABLE);
+        if (rc)
+            goto err;
+    }
+
+    for (i = 0; i < BULK_LOAD_TABLE_COUNT; i++)
+    {
+        rc = drop_field_indexes(&p_mgr->conn, bulk_load_tables[i].table,
+                                bulk_load_tables[i].name);
+        if (rc)
+            goto err;
+    }
+    return DB_SUCCESS;
+
+err:
+    DisplayLog(LVL_CRIT, LISTMGR_TAG, "Failed to enter bulk-load mode: "
+               "restoring normal mode");
+    bulk_load_finish(&p_mgr->conn);
+    return rc;
+}
+
+int ListMgr_BulkLoadEnd(lmgr_t *p_mgr)
+{
+    return bulk_load_finish(&p_mgr->conn);
+}
+
+/**
+ * Initialize the database access module and
+ * check and create the schema.
+ */
+int ListMgr_Init(enum lmgr_init_flags flags)
+{
+    int            rc;
+    db_conn_t      conn;
+    char           val[128];
+
+    /* store the parameter as a global variable */
+    init_flags = flags;
+
+    /* initialize attr masks for each table */
+    init_attrset_masks(&lmgr_config);
+
+    init_default_field_values();
+
+    /* determine source tables for accounting */
+    acct_info_table = acct_table();
+
+    /* create a database access */
+    rc = db_connect(&conn);
+    if (rc)
+        return rc;
+
+    /* check if tables exist, and check their schema */
+    DisplayLog(LVL_DEBUG, LISTMGR_TAG, "Checking database schema");
+
+    rc = check_create_schema(&conn);
+    if (rc)
+        goto close_conn;
+
+    /* restore normal mode if a bulk load was interrupted */
+    if (!report_only
+        && lmgr_get_var(&conn, VAR_BULK_LOAD, val, sizeof(val)) == DB_SUCCESS)
+    {
+        DisplayLog(LVL_MAJOR, LISTMGR_TAG, "WARNING: bulk load started at %s "
+                   "was not completed", val);
+        rc = bulk_load_finish(&conn);
         if (rc)
             goto close_conn;
     }
 
-    rc = DB_SUCCESS;
+    /* the entry cache is only useful for processes that modify the DB */
+    if (!report_only)
+        rc = ecache_init();
+    else
+        rc = DB_SUCCESS;
 
 close_conn:
     /* close the connection in any case */
@@ -2999,6 +3440,9 @@ int ListMgr_InitAccess( lmgr_t * p_mgr )
     for (i = 0; i < OPCOUNT; i++)
         p_mgr->nbop[i] = 0;
 
+    for (i = 0; i < CHGCOUNT; i++)
+        p_mgr->chg_pending[i] = 0;
+
     return 0;
 }
 
@@ -3010,6 +3454,9 @@ int ListMgr_CloseAccess( lmgr_t * p_mgr )
     /* force to commit queued requests */
     rc = lmgr_flush_commit( p_mgr );
 
+    /* report remaining changes */
+    lmgr_flush_changes(p_mgr);
+
     /* close connexion */
     db_close_conn( &p_mgr->conn );
 
@@ -249,6 +249,15 @@ int listmgr_batch_insert_no_tx(lmgr_t * p_mgr, entry_id_t **p_ids,
         if (rc)
             goto out_free;
     }
+
+    if (update_if_exists
+        && !attr_mask_test_index(&full_mask, ATTR_INDEX_stripe_items))
+    {
+        /* update the indexed time attribute of existing entries */
+        rc = update_ost_lru(p_mgr, pklist, p_attrs, count, false);
+        if (rc)
+            goto out_free;
+    }
 #endif
 
 out_free:
@@ -289,7 +298,11 @@ retry:
 
     /* success, count it */
     if (!rc)
+    {
         p_mgr->nbop[OPIDX_INSERT]++;
+        lmgr_count_changes(p_mgr, &p_info->attr_mask, 1);
+        ecache_store(p_id, p_info, !update_if_exists);
+    }
     return rc;
 }
 
@@ -303,6 +316,7 @@ int            ListMgr_BatchInsert(lmgr_t * p_mgr, entry_id_t ** p_ids,
                                    bool update_if_exists)
 {
     int rc;
+    unsigned int i;
     char err_buff[4096];
 
     if (count == 0)
@@ -353,6 +367,10 @@ retry:
             p_mgr->nbop[OPIDX_UPDATE] += count;
         else
             p_mgr->nbop[OPIDX_INSERT] += count;
+        lmgr_count_changes(p_mgr, &p_attrs[0]->attr_mask, count);
+
+        for (i = 0; i < count; i++)
+            ecache_store(p_ids[i], p_attrs[i], !update_if_exists);
     }
     return rc;
 }
@@ -173,6 +173,45 @@ static inline bool do_sort(table_enum t_sort, unsigned int sort_dirattr)
     return (t_sort != T_NONE) || ((sort_dirattr & ATTR_INDEX_FLG_UNSPEC) == 0);
 }
 
+#ifdef _LUSTRE
+/** Check if OST_LRU table can be used to list the entries of a single OST,
+ * sorted by the indexed time attribute.
+ * This requires a single equality on stripe items in a filter
+ * with no OR'ed criteria.
+ */
+static bool use_ost_lru(const lmgr_filter_t *p_filter,
+                        const lmgr_sort_type_t *p_sort_type,
+                        const struct field_count *fcnt)
+{
+    const lmgr_simple_filter_t *sf;
+    unsigned int i;
+
+    if (!ost_lru_enabled() || p_sort_type == NULL
+        || p_sort_type->order == SORT_NONE
+        || p_sort_type->attr_index != lmgr_config.ost_lru_attr)
+        return false;
+
+    if (p_filter->filter_type != FILTER_SIMPLE || fcnt->nb_main == 0
+        || fcnt->nb_stripe_items != 1)
+        return false;
+
+    sf = &p_filter->filter_simple;
+    for (i = 0; i < sf->filter_count; i++)
+    {
+        if (sf->filter_flags[i] & (FILTER_FLAG_OR | FILTER_FLAG_BEGIN
+                                   | FILTER_FLAG_END))
+            return false;
+
+        if (sf->filter_index[i] == ATTR_INDEX_stripe_items
+            && (sf->filter_compar[i] != EQUAL
+                || (sf->filter_flags[i] & (FILTER_FLAG_NOT
+                                           | FILTER_FLAG_ALLOW_NULL))))
+            return false;
+    }
+    return true;
+}
+#endif
+
 static int select_all_request(lmgr_t *p_mgr, GString *req, table_enum sort_table,
                               unsigned int sort_dirattr, bool distinct)
 {
@@ -198,6 +237,39 @@ static int select_all_request(lmgr_t *p_mgr, GString *req, table_enum sort_table
     return DB_SUCCESS;
 }
 
+/**
+ * Append the condition to get the entries following opt->after_*
+ * in (sort_col, id) order.
+ * @param sort_col NULL if the list is not sorted.
+ */
+static void append_keyset_cond(GString *req, bool has_where,
+                               const char *sort_col, const char *id_tab,
+                               sort_order_t order, const lmgr_iter_opt_t *opt)
+{
+    DEF_PK(pk);
+
+    entry_id2pk(&opt->after_id, PTR_PK(pk));
+    g_string_append(req, has_where ? " AND " : " WHERE ");
+
+    if (sort_col == NULL)
+        g_string_append_printf(req, "%s.id>"DPK, id_tab, pk);
+    /* NULL values come first in ascending order */
+    else if (order == SORT_ASC && opt->after_null)
+        g_string_append_printf(req, "(%s IS NOT NULL OR %s.id>"DPK")",
+                               sort_col, id_tab, pk);
+    else if (order == SORT_ASC)
+        g_string_append_printf(req, "(%s>%lld OR (%s=%lld AND %s.id>"DPK"))",
+                               sort_col, opt->after_val, sort_col,
+                               opt->after_val, id_tab, pk);
+    else if (opt->after_null)
+        g_string_append_printf(req, "(%s IS NULL AND %s.id>"DPK")",
+                               sort_col, id_tab, pk);
+    else
+        g_string_append_printf(req, "(%s<%lld OR %s IS NULL OR (%s=%lld AND "
+                               "%s.id>"DPK"))", sort_col, opt->after_val,
+                               sort_col, sort_col, opt->after_val, id_tab, pk);
+}
+
 /** get an iterator on a list of entries */
 struct lmgr_iterator_t *ListMgr_Iterator(lmgr_t *p_mgr,
                                          const lmgr_filter_t *p_filter,
@@ -212,7 +284,11 @@ struct lmgr_iterator_t *ListMgr_Iterator(lmgr_t *p_mgr,
     unsigned int        sort_dirattr = ATTR_INDEX_FLG_UNSPEC;
     struct field_count  fcnt = {0};
     bool                distinct = false;
+    bool                ost_lru = false;
+    bool                keyset = (p_opt != NULL && p_opt->keyset);
+    bool                has_where = false;
     table_enum          query_tab = T_NONE;
+    const char         *id_tab = MAIN_TABLE;
 
     GString            *from = NULL;
     GString            *where = NULL;
@@ -226,6 +302,18 @@ struct lmgr_iterator_t *ListMgr_Iterator(lmgr_t *p_mgr,
     /* is there a sort order? */
     check_sort(p_sort_type, &sort_table, &sort_dirattr, &distinct);
 
+    /* paging is only possible with a single row per entry
+     * and a sort attribute */
+    if (keyset && (sort_table == T_STRIPE_INFO || sort_table == T_STRIPE_ITEMS
+                   || (sort_dirattr & ATTR_INDEX_FLG_UNSPEC) == 0))
+    {
+        DisplayLog(LVL_CRIT, LISTMGR_TAG, "Paged listing is not supported "
+                   "with this sort order");
+        return NULL;
+    }
+    if (sort_table != T_NONE)
+        id_tab = table2name(sort_table);
+
     /* initialize the request */
     req = g_string_new(NULL);
 
@@ -261,10 +349,27 @@ struct lmgr_iterator_t *ListMgr_Iterator(lmgr_t *p_mgr,
         }
         else
         {
+#ifdef _LUSTRE
+            /* OST_LRU has a single row per entry and OST, and is ordered
+             * by the sort attribute: use it instead of STRIPE_ITEMS */
+            if (filter_dir_type == FILTERDIR_NONE
+                && use_ost_lru(p_filter, p_sort_type, &fcnt))
+            {
+                ost_lru = true;
+                fcnt.nb_stripe_items = 0;
+            }
+#endif
             /* build the FROM clause */
             from = g_string_new(NULL);
             filter_from(p_mgr, &fcnt, from, &query_tab, &distinct, 0);
 
+            /* stripe criteria still apply to "STRIPE_ITEMS" alias */
+            if (ost_lru)
+                g_string_append_printf(from, " INNER JOIN "OST_LRU_TABLE" "
+                                       STRIPE_ITEMS_TABLE" ON %s.id="
+                                       STRIPE_ITEMS_TABLE".id",
+                                       table2name(query_tab));
+
             /* If there is a single table: use the filter as is.
              * Else, build the filter a more ordered way */
             if (nbft > 1)
@@ -287,9 +392,31 @@ struct lmgr_iterator_t *ListMgr_Iterator(lmgr_t *p_mgr,
                                 table2name(query_tab));
 
             g_string_append_printf(req, " FROM %s WHERE %s", from->str, where->str);
+            has_where = true;
+            id_tab = table2name(query_tab);
         }
     }
 
+    if (keyset && p_opt->after_set)
+    {
+        GString *sort_col = NULL;
+
+        if (ost_lru)
+            sort_col = g_string_new(STRIPE_ITEMS_TABLE".lru");
+        else if (sort_table != T_NONE)
+        {
+            sort_col = g_string_new(NULL);
+            g_string_printf(sort_col, "%s.%s", table2name(sort_table),
+                            field_name(p_sort_type->attr_index));
+        }
+
+        append_keyset_cond(req, has_where, sort_col ? sort_col->str : NULL,
+                           id_tab, sort_col ? p_sort_type->order : SORT_NONE,
+                           p_opt);
+        if (sort_col != NULL)
+            g_string_free(sort_col, TRUE);
+    }
+
 #define SORT_ATTR_OPTIM (ATTR_INDEX_FLG_UNSPEC | 0x2)
 #if 0 /** @TODO RBHv3 to be reimplemnted */
                         /* both filter and sort order */
@@ -317,6 +444,8 @@ struct lmgr_iterator_t *ListMgr_Iterator(lmgr_t *p_mgr,
         /* special cases: stripe info stands for pool_name, stripe items for ost_idx */
         if (sort_table == T_STRIPE_INFO)
             g_string_append(req, " ORDER BY "STRIPE_INFO_TABLE".pool_name ");
+        else if (ost_lru)
+            g_string_append(req, " ORDER BY "STRIPE_ITEMS_TABLE".lru ");
         else if (sort_table == T_STRIPE_ITEMS)
             g_string_append(req, " ORDER BY "STRIPE_ITEMS_TABLE".ostidx ");
         else if (sort_table != T_NONE)
@@ -331,7 +460,12 @@ struct lmgr_iterator_t *ListMgr_Iterator(lmgr_t *p_mgr,
             g_string_append(req, "ASC");
         else
             g_string_append(req, "DESC");
+
+        if (keyset)
+            g_string_append_printf(req, ",%s.id ASC", id_tab);
     }
+    else if (keyset)
+        g_string_append_printf(req, " ORDER BY %s.id ASC", id_tab);
 
     /* iterator opt */
     if (p_opt && (p_opt->list_count_max > 0))
@@ -25,6 +25,7 @@
 #include "Memory.h"
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 #include <unistd.h>
 #include <pthread.h>
 
@@ -68,8 +69,11 @@ static inline void append_table_join(GString *fields, GString *tables, GString *
         g_string_printf(where, "%s.id="DPK, talias, pk);
 }
 
-/** removal of a single entry (no transaction management) */
-static int listmgr_remove_single(lmgr_t *p_mgr, PK_ARG_T pk, table_enum exclude_tab)
+/** removal of a single entry (no transaction management)
+ * @param cond additional condition on the main table (alias M), or NULL.
+ */
+static int listmgr_remove_single_cond(lmgr_t *p_mgr, PK_ARG_T pk,
+                                      table_enum exclude_tab, const char *cond)
 {
     const char *first_table = NULL;
     GString *req, *tables, *where;
@@ -90,8 +94,13 @@ static int listmgr_remove_single(lmgr_t *p_mgr, PK_ARG_T pk, table_enum exclude_
         append_table_join(req, tables, where, STRIPE_INFO_TABLE, "I", pk, &first_table);
     if (exclude_tab != T_STRIPE_ITEMS)
         append_table_join(req, tables, where, STRIPE_ITEMS_TABLE, "S", pk, &first_table);
+    if (ost_lru_enabled())
+        append_table_join(req, tables, where, OST_LRU_TABLE, "L", pk, &first_table);
 #endif
 
+    if (cond != NULL && exclude_tab != T_MAIN)
+        g_string_append_printf(where, " AND M.%s", cond);
+
     /* Doing this in a single request instead of 1 DELETE per table
      * results in a huge speed up (246sec -> 59s).  */
     /* - req already contains "DELETE filed_list"
@@ -107,6 +116,12 @@ static int listmgr_remove_single(lmgr_t *p_mgr, PK_ARG_T pk, table_enum exclude_
     return rc;
 }
 
+static inline int listmgr_remove_single(lmgr_t *p_mgr, PK_ARG_T pk,
+                                        table_enum exclude_tab)
+{
+    return listmgr_remove_single_cond(p_mgr, pk, exclude_tab, NULL);
+}
+
 
 int listmgr_remove_no_tx(lmgr_t *p_mgr, const entry_id_t *p_id,
                          const attr_set_t *p_attr_set, bool last)
@@ -206,7 +221,11 @@ retry:
     if (lmgr_delayed_retry(p_mgr, rc))
         goto retry;
     if (!rc)
-         p_mgr->nbop[OPIDX_RM]++;
+    {
+        p_mgr->nbop[OPIDX_RM]++;
+        lmgr_count_changes(p_mgr, NULL, 1);
+        ecache_invalidate(p_id);
+    }
     return rc;
 }
 
@@ -246,6 +265,13 @@ static int listmgr_rm_all(lmgr_t * p_mgr)
 
     /* stripes are only managed for lustre filesystems */
 #ifdef _LUSTRE
+    if (ost_lru_enabled())
+    {
+        rc = db_exec_sql(&p_mgr->conn, "DELETE FROM " OST_LRU_TABLE, NULL);
+        if (rc)
+            return rc;
+    }
+
     rc = db_exec_sql(&p_mgr->conn, "DELETE FROM " STRIPE_ITEMS_TABLE, NULL);
     if (rc)
         return rc;
@@ -462,10 +488,14 @@ static int create_tmp_table_rm(lmgr_t *p_mgr, const lmgr_filter_t *p_filter,
 
 /** Perform removal or soft removal for all entries matching a filter
  * (no transaction management).
+ * @param[out] rm_ids ids of removed entries.
+ * @param[out] ids_unknown set if some entries or names were removed
+ *                         without their id being known.
  */
 static int listmgr_mass_remove_no_tx(lmgr_t *p_mgr, const lmgr_filter_t *p_filter,
                                      bool soft_rm, time_t rm_time, rm_cb_func_t cb_func,
-                                     unsigned int *rm_count)
+                                     unsigned int *rm_count, GArray *rm_ids,
+                                     bool *ids_unknown)
 {
     struct field_count counts = {0};
     table_enum          query_tab;
@@ -485,8 +515,12 @@ static int listmgr_mass_remove_no_tx(lmgr_t *p_mgr, const lmgr_filter_t *p_filte
 
     attr_mask_unset_index(&mask_no_rmtime, ATTR_INDEX_rm_time);
 
+    *ids_unknown = false;
+
     if (no_filter(p_filter))
     {
+        *ids_unknown = true;
+
         if (soft_rm)
         {
             rc = listmgr_softrm_all(p_mgr, rm_time);
@@ -509,6 +543,8 @@ static int listmgr_mass_remove_no_tx(lmgr_t *p_mgr, const lmgr_filter_t *p_filte
         rc = clean_names(p_mgr, p_filter, &counts.nb_names);
         if (rc)
             return rc;
+        if (counts.nb_names > 0)
+            *ids_unknown = true;
     }
     else
     {
@@ -532,6 +568,7 @@ static int listmgr_mass_remove_no_tx(lmgr_t *p_mgr, const lmgr_filter_t *p_filte
         }
 
         /* filter is only on names table */
+        *ids_unknown = true;
         if (soft_rm)
             rc = clean_names(p_mgr, p_filter, &counts.nb_names);
         /* else (no softrm): name cleaning has been done at the beginning of the function */
@@ -650,6 +687,7 @@ static int listmgr_mass_remove_no_tx(lmgr_t *p_mgr, const lmgr_filter_t *p_filte
         if (cb_func)
             cb_func(&id);
 
+        g_array_append_val(rm_ids, id);
         (*rm_count)++;
     }
 
@@ -668,7 +706,11 @@ static int listmgr_mass_remove_no_tx(lmgr_t *p_mgr, const lmgr_filter_t *p_filte
 
     /* Condition on names only (partial scan cleans not found names). */
     if (soft_rm && filter_names)
+    {
         rc = clean_names(p_mgr, p_filter, &counts.nb_names);
+        if (counts.nb_names > 0)
+            *ids_unknown = true;
+    }
     /* else, it has been done at the beginning of the function */
 
     goto free_str;
@@ -696,16 +738,23 @@ static int listmgr_mass_remove(lmgr_t *p_mgr, const lmgr_filter_t *p_filter,
 {
     int             rc;
     unsigned int    rmcount = 0;
+    unsigned int    i;
+    bool            ids_unknown = false;
+    GArray         *rm_ids = g_array_new(FALSE, FALSE, sizeof(entry_id_t));
 
     /* We want the remove operation to be atomic */
 retry:
+    g_array_set_size(rm_ids, 0);
+    rmcount = 0;
+
     rc = lmgr_begin(p_mgr);
     if (lmgr_delayed_retry(p_mgr, rc))
         goto retry;
     else if (rc)
-        return rc;
+        goto out;
 
-    rc = listmgr_mass_remove_no_tx(p_mgr, p_filter, soft_rm, rm_time, cb_func, &rmcount);
+    rc = listmgr_mass_remove_no_tx(p_mgr, p_filter, soft_rm, rm_time, cb_func,
+                                   &rmcount, rm_ids, &ids_unknown);
 
     if (lmgr_delayed_retry(p_mgr, rc))
         goto retry;
@@ -717,12 +766,23 @@ retry:
         goto retry;
 
     if (rc == DB_SUCCESS)
+    {
         p_mgr->nbop[OPIDX_RM] += rmcount;
+        lmgr_count_changes(p_mgr, NULL, rmcount);
 
-    return rc;
+        /* only flush the whole cache if removed ids are not all known */
+        if (ids_unknown)
+            ecache_invalidate(NULL);
+        else
+            for (i = 0; i < rm_ids->len; i++)
+                ecache_invalidate(&g_array_index(rm_ids, entry_id_t, i));
+    }
+    goto out;
 
 rollback:
     lmgr_rollback(p_mgr);
+out:
+    g_array_free(rm_ids, TRUE);
     return rc;
 }
 
@@ -740,6 +800,302 @@ int ListMgr_MassSoftRemove(lmgr_t *p_mgr, const lmgr_filter_t *p_filter,
     return listmgr_mass_remove(p_mgr, p_filter, true, rm_time, cb_func);
 }
 
+/** Remove a chunk of entries not seen since generation 'gen'
+ * (no transaction management).
+ * Entries are read in id order from the position in p_pos.
+ * @param[out] nb_read number of entries read.
+ * @param[out] ids ids of removed entries.
+ */
+static int listmgr_gc_entries_no_tx(lmgr_t *p_mgr, time_t gen, bool soft_rm,
+                                    time_t rm_time, unsigned int max_count,
+                                    rm_cb_func_t cb_func, lmgr_gc_pos_t *p_pos,
+                                    unsigned int *nb_read, entry_id_t *ids,
+                                    unsigned int *rm_count)
+{
+    result_handle_t result;
+    char           *field_tab[1];
+    entry_id_t     *read_ids;
+    unsigned int    nb_ids = 0;
+    unsigned int    nb_rm = 0;
+    unsigned int    i;
+    attr_mask_t     mask_no_rmtime = softrm_attr_set;
+    char            cond[128];
+    DEF_PK(pk);
+    GString        *req;
+    int             rc;
+
+    attr_mask_unset_index(&mask_no_rmtime, ATTR_INDEX_rm_time);
+
+    read_ids = MemCalloc(max_count, sizeof(*read_ids));
+    if (read_ids == NULL)
+        return DB_NO_MEMORY;
+
+    /* entries are removed out of the result loop, as the removal
+     * modifies the table the records are read from */
+    req = g_string_new("SELECT id FROM "MAIN_TABLE" WHERE ");
+    if (p_pos->id_set)
+    {
+        entry_id2pk(&p_pos->last_id, PTR_PK(pk));
+        g_string_append_printf(req, "id>"DPK" AND ", pk);
+    }
+    g_string_append_printf(req, "md_update<%lu ORDER BY id LIMIT %u",
+                           (unsigned long)gen, max_count);
+
+    rc = db_exec_sql(&p_mgr->conn, req->str, &result);
+    if (rc)
+        goto free_str;
+
+    while (nb_ids < max_count
+           && (rc = db_next_record(&p_mgr->conn, &result, field_tab, 1)) == DB_SUCCESS
+           && field_tab[0] != NULL)
+    {
+        rc = parse_entry_id(p_mgr, field_tab[0], PTR_PK(pk), &read_ids[nb_ids]);
+        if (rc)
+            break;
+        nb_ids++;
+    }
+    db_result_free(&p_mgr->conn, &result);
+
+    if (rc == DB_END_OF_LIST || rc == DB_SUCCESS)
+        rc = DB_SUCCESS;
+    else
+        goto free_str;
+
+    /* only remove entries that were not updated since they were read */
+    snprintf(cond, sizeof(cond), "md_update<%lu", (unsigned long)gen);
+
+    for (i = 0; i < nb_ids; i++)
+    {
+        attr_set_t old_attrs = ATTR_SET_INIT;
+
+        if (soft_rm)
+        {
+            /* get attributes before the entry is removed */
+            old_attrs.attr_mask = mask_no_rmtime;
+            if (ListMgr_Get(p_mgr, &read_ids[i], &old_attrs) != DB_SUCCESS)
+                ATTR_MASK_INIT(&old_attrs);
+
+            ATTR_MASK_SET(&old_attrs, rm_time);
+            ATTR(&old_attrs, rm_time) = rm_time;
+        }
+
+        entry_id2pk(&read_ids[i], PTR_PK(pk));
+        rc = listmgr_remove_single_cond(p_mgr, pk, T_NONE, cond);
+        if (rc == DB_SUCCESS && db_affected_rows(&p_mgr->conn) == 0)
+        {
+            /* updated in the meantime: keep it */
+            ListMgr_FreeAttrs(&old_attrs);
+            continue;
+        }
+
+        if (rc == DB_SUCCESS && soft_rm)
+            rc = listmgr_softrm_single(p_mgr, &read_ids[i], &old_attrs);
+        ListMgr_FreeAttrs(&old_attrs);
+        if (rc)
+            goto free_str;
+
+        ids[nb_rm] = read_ids[i];
+        nb_rm++;
+
+        if (cb_func)
+            cb_func(&read_ids[i]);
+    }
+
+    if (nb_ids > 0)
+    {
+        p_pos->last_id = read_ids[nb_ids - 1];
+        p_pos->id_set = true;
+    }
+    if (nb_ids < max_count)
+        p_pos->entries_done = true;
+
+    *nb_read = nb_ids;
+    *rm_count = nb_rm;
+
+free_str:
+    g_string_free(req, TRUE);
+    MemFree(read_ids);
+    return rc;
+}
+
+/** Remove a chunk of names not seen since generation 'gen'
+ * (no transaction management).
+ * Names are read in key order from the position in p_pos.
+ * @param[out] ids ids of the entries of the names read.
+ * @param[out] nb_read number of names read.
+ */
+static int listmgr_gc_names_no_tx(lmgr_t *p_mgr, time_t gen, unsigned int max_count,
+                                  lmgr_gc_pos_t *p_pos, entry_id_t *ids,
+                                  unsigned int *nb_read, unsigned int *rm_count)
+{
+    result_handle_t result;
+    char           *field_tab[2];
+    GString        *req;
+    GString        *del;
+    unsigned int    nb = 0;
+    DEF_PK(pk);
+    int             rc;
+
+    req = g_string_new("SELECT pkn,id FROM "DNAMES_TABLE" WHERE ");
+    if (p_pos->last_pkn[0] != '\0')
+        g_string_append_printf(req, "pkn>'%s' AND ", p_pos->last_pkn);
+    g_string_append_printf(req, "path_update<%lu ORDER BY pkn LIMIT %u",
+                           (unsigned long)gen, max_count);
+
+    rc = db_exec_sql(&p_mgr->conn, req->str, &result);
+    if (rc)
+        goto free_str;
+
+    del = g_string_new("DELETE FROM "DNAMES_TABLE" WHERE pkn IN (");
+    while (nb < max_count
+           && (rc = db_next_record(&p_mgr->conn, &result, field_tab, 2)) == DB_SUCCESS
+           && field_tab[0] != NULL)
+    {
+        g_string_append_printf(del, "%s'%s'", nb == 0 ? "" : ",", field_tab[0]);
+        rh_strncpy(p_pos->last_pkn, field_tab[0], sizeof(p_pos->last_pkn));
+
+        if (field_tab[1] == NULL
+            || parse_entry_id(p_mgr, field_tab[1], PTR_PK(pk), &ids[nb]) != DB_SUCCESS)
+            memset(&ids[nb], 0, sizeof(ids[nb]));
+        nb++;
+    }
+    db_result_free(&p_mgr->conn, &result);
+    /* only remove names that were not updated since they were read */
+    g_string_append_printf(del, ") AND path_update<%lu", (unsigned long)gen);
+
+    if (rc == DB_END_OF_LIST || rc == DB_SUCCESS)
+        rc = DB_SUCCESS;
+
+    if (rc == DB_SUCCESS && nb > 0)
+        rc = db_exec_sql(&p_mgr->conn, del->str, NULL);
+
+    if (rc == DB_SUCCESS)
+    {
+        if (nb < max_count)
+            p_pos->names_done = true;
+        *nb_read = nb;
+        *rm_count = nb > 0 ? db_affected_rows(&p_mgr->conn) : 0;
+    }
+
+    g_string_free(del, TRUE);
+free_str:
+    g_string_free(req, TRUE);
+    return rc;
+}
+
+int ListMgr_GCChunk(lmgr_t *p_mgr, time_t gen, bool soft_rm, time_t rm_time,
+                    unsigned int max_count, rm_cb_func_t cb_func,
+                    lmgr_gc_pos_t *p_pos, unsigned int *rm_entries,
+                    unsigned int *rm_names)
+{
+    lmgr_gc_pos_t   pos;
+    entry_id_t     *ids;
+    unsigned int    nb_read = 0;
+    unsigned int    nb_name_ids = 0;
+    unsigned int    i;
+    int             rc;
+
+    *rm_entries = *rm_names = 0;
+
+    if (max_count == 0)
+        return DB_INVALID_ARG;
+
+    /* ids of removed entries, then ids of entries with removed names */
+    ids = MemCalloc(max_count, sizeof(*ids));
+    if (ids == NULL)
+        return DB_NO_MEMORY;
+
+retry:
+    /* restart from the initial position if the transaction is retried */
+    pos = *p_pos;
+    *rm_entries = *rm_names = 0;
+    nb_read = nb_name_ids = 0;
+
+    rc = lmgr_begin(p_mgr);
+    if (lmgr_delayed_retry(p_mgr, rc))
+        goto retry;
+    else if (rc)
+        goto out;
+
+    /* Entries first: soft removal needs their path, which is built
+     * from the names being cleaned. */
+    if (!pos.entries_done)
+    {
+        rc = listmgr_gc_entries_no_tx(p_mgr, gen, soft_rm, rm_time, max_count,
+                                      cb_func, &pos, &nb_read, ids, rm_entries);
+        if (lmgr_delayed_retry(p_mgr, rc))
+            goto retry;
+        else if (rc)
+            goto rollback;
+    }
+
+    /* then names, once all old entries are cleaned */
+    if (pos.entries_done && nb_read < max_count)
+    {
+        rc = listmgr_gc_names_no_tx(p_mgr, gen, max_count - nb_read, &pos,
+                                    ids + *rm_entries, &nb_name_ids, rm_names);
+        if (lmgr_delayed_retry(p_mgr, rc))
+            goto retry;
+        else if (rc)
+            goto rollback;
+    }
+
+    rc = lmgr_commit(p_mgr);
+    if (lmgr_delayed_retry(p_mgr, rc))
+        goto retry;
+
+    if (rc != DB_SUCCESS)
+        goto out;
+
+    *p_pos = pos;
+
+    if (*rm_entries > 0)
+    {
+        p_mgr->nbop[OPIDX_RM] += *rm_entries;
+        lmgr_count_changes(p_mgr, NULL, *rm_entries);
+    }
+    if (*rm_names > 0)
+        lmgr_count_changes(p_mgr, &names_attr_set, *rm_names);
+
+    /* drop removed entries (and entries with removed names) from cache */
+    for (i = 0; i < *rm_entries + nb_name_ids; i++)
+        ecache_invalidate(&ids[i]);
+
+    goto out;
+
+rollback:
+    lmgr_rollback(p_mgr);
+out:
+    MemFree(ids);
+    return rc;
+}
+
+int ListMgr_GCCount(lmgr_t *p_mgr, time_t gen, uint64_t *count)
+{
+    result_handle_t result;
+    char           *field_tab[1];
+    char            query[256];
+    int             rc;
+
+    snprintf(query, sizeof(query), "SELECT COUNT(*) FROM "MAIN_TABLE
+             " WHERE md_update<%lu", (unsigned long)gen);
+retry:
+    rc = db_exec_sql(&p_mgr->conn, query, &result);
+    if (lmgr_delayed_retry(p_mgr, rc))
+        goto retry;
+    else if (rc)
+        return rc;
+
+    rc = db_next_record(&p_mgr->conn, &result, field_tab, 1);
+    if (rc == DB_SUCCESS && field_tab[0] != NULL)
+        *count = strtoull(field_tab[0], NULL, 10);
+    else if (rc == DB_SUCCESS)
+        *count = 0;
+
+    db_result_free(&p_mgr->conn, &result);
+    return rc;
+}
+
 /**
  * Remove an entry from the main database, and insert it to secondary table
  * for delayed removal.
@@ -815,7 +1171,11 @@ retry:
     if (lmgr_delayed_retry(p_mgr, rc))
         goto retry;
     if (!rc)
-         p_mgr->nbop[OPIDX_RM]++;
+    {
+        p_mgr->nbop[OPIDX_RM]++;
+        lmgr_count_changes(p_mgr, NULL, 1);
+        ecache_invalidate(p_id);
+    }
 
 out:
     ListMgr_FreeAttrs(&all_attrs);
@@ -1037,3 +1397,27 @@ int ListMgr_SoftRemove_Discard(lmgr_t * p_mgr, const entry_id_t * p_id)
     g_string_free(req, TRUE);
     return rc;
 }
+
+int ListMgr_SoftRemove_DiscardBatch(lmgr_t *p_mgr, const entry_id_t *p_ids,
+                                    unsigned int count)
+{
+    int          rc;
+    unsigned int i;
+    GString     *req;
+
+    if (count == 0)
+        return DB_SUCCESS;
+
+    req = g_string_new("DELETE FROM "SOFT_RM_TABLE" WHERE id IN (");
+    for (i = 0; i < count; i++)
+        g_string_append_printf(req, "%s'"DFID_NOBRACE"'", i == 0 ? "" : ",",
+                               PFID(&p_ids[i]));
+    g_string_append_c(req, ')');
+
+    do {
+        rc = db_exec_sql(&p_mgr->conn, req->str, NULL);
+    } while(lmgr_delayed_retry(p_mgr, rc));
+
+    g_string_free(req, TRUE);
+    return rc;
+}
@@ -26,6 +26,21 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <inttypes.h>
+#include <unistd.h>
+#include <pthread.h>
+
+/** prefix of tables holding cached report results */
+#define RPT_CACHE_PREFIX    "RPT_CACHE_"
+/** prefix of tables holding partial results of parallel reports */
+#define RPT_PART_PREFIX     "RPT_PART_"
+/** prefix of VARS holding the generation of cached reports */
+#define RPT_CACHE_VAR       "RptCache_"
+
+/** minimum entry count to split a report across several connections */
+#define RPT_PARALLEL_MIN_COUNT  1000000LL
+
+/** sequence number of partial result tables in this process */
+static unsigned int part_seq = 0;
 
 struct result {
     db_type_e type;
@@ -45,6 +60,9 @@ typedef struct lmgr_report_t
     unsigned int   profile_attr; /* profile attr (if profile_count > 0) */
 
     char         **str_tab;
+
+    /* table of partial results to be dropped when closing the report */
+    char           part_table[128];
 } lmgr_report_t;
 
 
@@ -280,6 +298,502 @@ static bool full_acct(const report_field_descr_t *report_desc_array,
 }
 
 
+/** hash a report request (FNV-1a), to identify its cached results */
+static uint64_t report_hash(const char *str)
+{
+    uint64_t h = 14695981039346656037ULL;
+
+    for (; *str != '\0'; str++)
+    {
+        h ^= (unsigned char)*str;
+        h *= 1099511628211ULL;
+    }
+    return h;
+}
+
+/** get the change counters a report depends on */
+static unsigned int report_chg_mask(bool use_acct_table,
+                                    const struct field_count *fcnt)
+{
+    unsigned int mask = 0;
+
+    /* ACCT table is maintained from the main table */
+    if (use_acct_table)
+        return (1 << CHGIDX_MAIN);
+
+    if (fcnt->nb_main)
+        mask |= (1 << CHGIDX_MAIN);
+    if (fcnt->nb_annex)
+        mask |= (1 << CHGIDX_ANNEX);
+    if (fcnt->nb_names)
+        mask |= (1 << CHGIDX_NAMES);
+    if (fcnt->nb_stripe_info || fcnt->nb_stripe_items)
+        mask |= (1 << CHGIDX_STRIPE);
+
+    /* count only */
+    if (mask == 0)
+        mask = (1 << CHGIDX_MAIN);
+
+    return mask;
+}
+
+/** open the report result from cached table */
+static int report_cache_open(lmgr_report_t *p_report, const char *cache_table,
+                             const GString *order_by)
+{
+    GString *req;
+    int      rc;
+
+    req = g_string_new("SELECT * FROM ");
+    g_string_append(req, cache_table);
+    if (!GSTRING_EMPTY(order_by))
+        g_string_append_printf(req, " ORDER BY %s", order_by->str);
+
+    rc = db_exec_sql_quiet(&p_report->p_mgr->conn, req->str,
+                           &p_report->select_result);
+    g_string_free(req, TRUE);
+    return rc;
+}
+
+/**
+ * Check if a valid cached result exists for a report and open it.
+ * @return DB_SUCCESS if the report result is read from the cache.
+ */
+static int report_cache_lookup(lmgr_report_t *p_report, uint64_t hash,
+                               uint64_t gen, const GString *order_by)
+{
+    char     varname[128];
+    char     cache_table[128];
+    char     val[128];
+    uint64_t cache_gen;
+    int      rc;
+
+    snprintf(varname, sizeof(varname), RPT_CACHE_VAR"%016"PRIx64, hash);
+    snprintf(cache_table, sizeof(cache_table), RPT_CACHE_PREFIX"%016"PRIx64,
+             hash);
+
+    rc = lmgr_get_var(&p_report->p_mgr->conn, varname, val, sizeof(val));
+    if (rc)
+        return rc;
+
+    if (sscanf(val, "%"SCNu64, &cache_gen) != 1 || cache_gen != gen)
+    {
+        DisplayLog(LVL_DEBUG, LISTMGR_TAG, "Cached report %016"PRIx64
+                   " is outdated (generation %s, current=%"PRIu64")",
+                   hash, val, gen);
+        return DB_NOT_EXISTS;
+    }
+
+    rc = report_cache_open(p_report, cache_table, order_by);
+    if (rc == DB_SUCCESS)
+        DisplayLog(LVL_DEBUG, LISTMGR_TAG, "Report %016"PRIx64" read from "
+                   "cache (generation %"PRIu64")", hash, gen);
+    return rc;
+}
+
+/** drop a cached report result and its generation variable */
+static int report_cache_drop(db_conn_t *pconn, const char *varname)
+{
+    char req[256];
+    int  rc;
+
+    rc = lmgr_set_var(pconn, varname, NULL);
+    if (rc)
+        return rc;
+
+    snprintf(req, sizeof(req), "DROP TABLE IF EXISTS "RPT_CACHE_PREFIX"%s",
+             varname + strlen(RPT_CACHE_VAR));
+    return db_exec_sql(pconn, req, NULL);
+}
+
+/**
+ * Drop cached report results that are outdated, so that the tables of
+ * reports that are no longer run do not accumulate in the database.
+ * The VARS entry of each cached report holds the generation of its
+ * result and the change counters it depends on.
+ */
+static void report_cache_gc(db_conn_t *pconn)
+{
+    result_handle_t result;
+    char           *res[2];
+    GPtrArray      *outdated;
+    uint64_t        cache_gen, gen;
+    unsigned int    mask;
+    int             i, rc;
+
+    rc = db_exec_sql(pconn, "SELECT varname,value FROM "VAR_TABLE
+                     " WHERE varname LIKE '"RPT_CACHE_VAR"%'", &result);
+    if (rc)
+        return;
+
+    outdated = g_ptr_array_new_with_free_func(g_free);
+
+    while (db_next_record(pconn, &result, res, 2) == DB_SUCCESS)
+    {
+        if (res[0] == NULL || strlen(res[0]) <= strlen(RPT_CACHE_VAR))
+            continue;
+
+        /* entries without change mask are from an older version */
+        if (res[1] == NULL
+            || sscanf(res[1], "%"SCNu64":%x", &cache_gen, &mask) != 2
+            || lmgr_change_gen(pconn, mask, &gen) != DB_SUCCESS
+            || gen != cache_gen)
+            g_ptr_array_add(outdated, g_strdup(res[0]));
+    }
+    db_result_free(pconn, &result);
+
+    for (i = 0; i < outdated->len; i++)
+    {
+        const char *varname = g_ptr_array_index(outdated, i);
+
+        rc = report_cache_drop(pconn, varname);
+        if (rc)
+            DisplayLog(LVL_VERB, LISTMGR_TAG, "Failed to drop outdated "
+                       "cached report %s: error %d", varname, rc);
+        else
+            DisplayLog(LVL_DEBUG, LISTMGR_TAG, "Dropped outdated cached "
+                       "report %s", varname);
+    }
+    g_ptr_array_free(outdated, TRUE);
+}
+
+/**
+ * Save the result of a report request to the cache and open it.
+ * @return DB_SUCCESS if the report result is read from the cache.
+ */
+static int report_cache_store(lmgr_report_t *p_report, uint64_t hash,
+                              uint64_t gen, unsigned int chg_mask,
+                              const char *query,
+                              const GString *order_by)
+{
+    db_conn_t *pconn = &p_report->p_mgr->conn;
+    char       varname[128];
+    char       cache_table[128];
+    char       val[128];
+    GString   *req;
+    int        rc;
+
+    snprintf(varname, sizeof(varname), RPT_CACHE_VAR"%016"PRIx64, hash);
+    snprintf(cache_table, sizeof(cache_table), RPT_CACHE_PREFIX"%016"PRIx64,
+             hash);
+
+    /* invalidate previous result first */
+    rc = report_cache_drop(pconn, varname);
+    if (rc)
+        return rc;
+
+    /* the request may fail if ACCT table does not exist, so be quiet */
+    req = g_string_new(NULL);
+    g_string_printf(req, "CREATE TABLE %s AS %s", cache_table, query);
+    rc = db_exec_sql_quiet(pconn, req->str, NULL);
+    if (rc)
+        goto out;
+
+    snprintf(val, sizeof(val), "%"PRIu64":%x", gen, chg_mask);
+    rc = lmgr_set_var(pconn, varname, val);
+    if (rc)
+        goto out;
+
+    /* this is a good time to clean the results of other reports */
+    report_cache_gc(pconn);
+
+    DisplayLog(LVL_DEBUG, LISTMGR_TAG, "Report %016"PRIx64" saved to cache "
+               "(generation %"PRIu64")", hash, gen);
+
+    rc = report_cache_open(p_report, cache_table, order_by);
+out:
+    g_string_free(req, TRUE);
+    return rc;
+}
+
+/** check if a report can be computed as merged partial results */
+static bool report_parallel_ok(const report_field_descr_t *report_desc_array,
+                               unsigned int report_descr_count,
+                               const profile_field_descr_t *profile_descr)
+{
+    int i;
+
+    if (lmgr_config.report_parallel <= 1)
+        return false;
+
+    /* ratio can't be merged */
+    if (profile_descr != NULL && profile_descr->range_ratio_len > 0)
+        return false;
+
+    for (i = 0; i < report_descr_count; i++)
+    {
+        /* AVG and COUNT(DISTINCT) can't be merged */
+        if (report_desc_array[i].report_type == REPORT_AVG
+            || report_desc_array[i].report_type == REPORT_COUNT_DISTINCT)
+            return false;
+    }
+    return true;
+}
+
+/** build the field list to merge partial report results */
+static void report_merge_fields(GString *fields,
+                                const report_field_descr_t *report_desc_array,
+                                unsigned int report_descr_count,
+                                unsigned int profile_len)
+{
+    int i;
+
+    for (i = 0; i < report_descr_count; i++)
+    {
+        coma_if_needed(fields);
+
+        switch (report_desc_array[i].report_type)
+        {
+        case REPORT_MIN:
+            g_string_append_printf(fields, "MIN(attr%u) as attr%u", i, i);
+            break;
+        case REPORT_MAX:
+            g_string_append_printf(fields, "MAX(attr%u) as attr%u", i, i);
+            break;
+        case REPORT_SUM:
+        case REPORT_COUNT:
+            g_string_append_printf(fields, "SUM(attr%u) as attr%u", i, i);
+            break;
+        case REPORT_GROUP_BY:
+            g_string_append_printf(fields, "attr%u", i);
+            break;
+        default:
+            RBH_BUG("unexpected report type for parallel report");
+        }
+    }
+
+    for (i = 0; i < profile_len; i++)
+        g_string_append_printf(fields, ",SUM(prof%u) as prof%u", i, i);
+}
+
+/** argument of a partial report thread */
+struct report_part_arg {
+    pthread_t  thread;
+    bool       started;
+    GString   *req;
+    int        rc;
+};
+
+/** compute a partial report result using a dedicated connection */
+static void *report_part_thr(void *arg)
+{
+    struct report_part_arg *part = arg;
+    lmgr_t lmgr;
+
+    part->rc = ListMgr_InitAccess(&lmgr);
+    if (part->rc)
+        return NULL;
+
+retry:
+    part->rc = db_exec_sql(&lmgr.conn, part->req->str, NULL);
+    if (lmgr_delayed_retry(&lmgr, part->rc))
+        goto retry;
+
+    ListMgr_CloseAccess(&lmgr);
+    return NULL;
+}
+
+/** get the id bounds to split a table into nb_parts ranges */
+static int report_split_bounds(lmgr_t *p_mgr, const char *table,
+                               unsigned int nb_parts, char **bounds)
+{
+    GString        *req;
+    result_handle_t result;
+    char           *str_id;
+    uint64_t        count;
+    int             i, rc;
+
+    rc = lmgr_table_count(&p_mgr->conn, table, &count);
+    if (rc)
+        return rc;
+
+    /* not worth splitting */
+    if (count < RPT_PARALLEL_MIN_COUNT)
+        return DB_NOT_SUPPORTED;
+
+    req = g_string_new(NULL);
+
+    /* bounds[i] is the lower bound of range i */
+    for (i = 1; i < nb_parts; i++)
+    {
+        char escaped[2*PK_LEN+1];
+
+        g_string_printf(req, "SELECT id FROM %s ORDER BY id LIMIT 1 OFFSET %"
+                        PRIu64, table, (count * i) / nb_parts);
+
+        rc = db_exec_sql(&p_mgr->conn, req->str, &result);
+        if (rc)
+            goto out;
+
+        rc = db_next_record(&p_mgr->conn, &result, &str_id, 1);
+        if (rc == DB_SUCCESS && str_id != NULL)
+            rc = db_escape_string(&p_mgr->conn, escaped, sizeof(escaped),
+                                  str_id);
+        else if (rc == DB_SUCCESS || rc == DB_END_OF_LIST)
+            rc = DB_REQUEST_FAILED;
+        db_result_free(&p_mgr->conn, &result);
+        if (rc)
+            goto out;
+
+        bounds[i] = MemAlloc(strlen(escaped) + 1);
+        if (bounds[i] == NULL)
+        {
+            rc = DB_NO_MEMORY;
+            goto out;
+        }
+        strcpy(bounds[i], escaped);
+    }
+
+out:
+    g_string_free(req, TRUE);
+    return rc;
+}
+
+/**
+ * Compute the partial results of a GROUP BY report in parallel,
+ * by splitting the query table into ranges of primary keys.
+ * Partial results are stored to a dedicated table and 'req' is replaced
+ * by the request that merges them.
+ * @return DB_NOT_SUPPORTED if the table is too small to be split.
+ */
+static int report_parallel(lmgr_report_t *p_report, uint64_t hash,
+                           table_enum query_tab, const GString *fields,
+                           const GString *from, const GString *where,
+                           const GString *group_by, const GString *merge_fields,
+                           const GString *having, const GString *order_by,
+                           unsigned int limit, GString *req)
+{
+    lmgr_t         *p_mgr = p_report->p_mgr;
+    unsigned int    nb_parts = lmgr_config.report_parallel;
+    const char     *table = table2name(query_tab);
+    struct report_part_arg *parts = NULL;
+    char          **bounds = NULL;
+    GString        *part_req;
+    int             i, rc;
+
+    bounds = MemCalloc(nb_parts, sizeof(char *));
+    if (bounds == NULL)
+        return DB_NO_MEMORY;
+
+    rc = report_split_bounds(p_mgr, table, nb_parts, bounds);
+    if (rc)
+        goto free_bounds;
+
+    /* the same report may run concurrently in this process */
+    snprintf(p_report->part_table, sizeof(p_report->part_table),
+             RPT_PART_PREFIX"%016"PRIx64"_%u_%u", hash,
+             (unsigned int)getpid(),
+             __atomic_add_fetch(&part_seq, 1, __ATOMIC_RELAXED));
+
+    /* create an empty table with the partial result fields */
+    part_req = g_string_new(NULL);
+    g_string_printf(part_req, "CREATE TABLE %s AS SELECT %s FROM %s",
+                    p_report->part_table, fields->str, from->str);
+    if (!GSTRING_EMPTY(where))
+        g_string_append_printf(part_req, " WHERE %s", where->str);
+    if (!GSTRING_EMPTY(group_by))
+        g_string_append_printf(part_req, " GROUP BY %s", group_by->str);
+    g_string_append(part_req, " LIMIT 0");
+
+    rc = db_exec_sql(&p_mgr->conn, part_req->str, NULL);
+    g_string_free(part_req, TRUE);
+    if (rc)
+    {
+        p_report->part_table[0] = '\0';
+        goto free_bounds;
+    }
+
+    parts = MemCalloc(nb_parts, sizeof(*parts));
+    if (parts == NULL)
+    {
+        rc = DB_NO_MEMORY;
+        goto free_bounds;
+    }
+
+    DisplayLog(LVL_DEBUG, LISTMGR_TAG, "Splitting report %016"PRIx64
+               " into %u parts", hash, nb_parts);
+
+    for (i = 0; i < nb_parts; i++)
+    {
+        parts[i].req = g_string_new(NULL);
+        g_string_printf(parts[i].req, "INSERT INTO %s SELECT %s FROM %s WHERE ",
+                        p_report->part_table, fields->str, from->str);
+        if (!GSTRING_EMPTY(where))
+            g_string_append_printf(parts[i].req, "%s AND ", where->str);
+
+        if (i == 0)
+            g_string_append_printf(parts[i].req, "%s.id<'%s'", table,
+                                   bounds[1]);
+        else if (i == nb_parts - 1)
+            g_string_append_printf(parts[i].req, "%s.id>='%s'", table,
+                                   bounds[i]);
+        else
+            g_string_append_printf(parts[i].req, "%s.id>='%s' AND %s.id<'%s'",
+                                   table, bounds[i], table, bounds[i+1]);
+
+        if (!GSTRING_EMPTY(group_by))
+            g_string_append_printf(parts[i].req, " GROUP BY %s", group_by->str);
+
+        parts[i].rc = pthread_create(&parts[i].thread, NULL, report_part_thr,
+                                     &parts[i]);
+        if (parts[i].rc)
+        {
+            DisplayLog(LVL_MAJOR, LISTMGR_TAG, "Failed to start report thread: %s",
+                       strerror(parts[i].rc));
+            /* run it in the current thread */
+            parts[i].rc = db_exec_sql(&p_mgr->conn, parts[i].req->str, NULL);
+        }
+        else
+            parts[i].started = true;
+    }
+
+    for (i = 0; i < nb_parts; i++)
+    {
+        if (parts[i].started)
+            pthread_join(parts[i].thread, NULL);
+        if (parts[i].rc && rc == DB_SUCCESS)
+            rc = parts[i].rc;
+        g_string_free(parts[i].req, TRUE);
+    }
+    MemFree(parts);
+
+    if (rc)
+        goto free_bounds;
+
+    /* build the request to merge partial results */
+    g_string_printf(req, "SELECT %s FROM %s", merge_fields->str,
+                    p_report->part_table);
+    if (!GSTRING_EMPTY(group_by))
+        g_string_append_printf(req, " GROUP BY %s", group_by->str);
+    if (!GSTRING_EMPTY(having))
+        g_string_append_printf(req, " HAVING %s", having->str);
+    if (!GSTRING_EMPTY(order_by))
+        g_string_append_printf(req, " ORDER BY %s", order_by->str);
+    if (limit > 0)
+        g_string_append_printf(req, " LIMIT %u", limit);
+
+free_bounds:
+    for (i = 0; i < nb_parts; i++)
+        if (bounds[i] != NULL)
+            MemFree(bounds[i]);
+    MemFree(bounds);
+    return rc;
+}
+
+/** drop the table of partial results of a report, if any */
+static void report_drop_part(lmgr_report_t *p_report)
+{
+    char req[256];
+
+    if (p_report->part_table[0] == '\0')
+        return;
+
+    snprintf(req, sizeof(req), "DROP TABLE IF EXISTS %s",
+             p_report->part_table);
+    db_exec_sql(&p_report->p_mgr->conn, req, NULL);
+    p_report->part_table[0] = '\0';
+}
+
 /**
  * Builds a report from database.
  */
@@ -308,6 +822,12 @@ struct lmgr_report_t *ListMgr_Report(lmgr_t *p_mgr,
     GString           *group_by = NULL;
     GString           *order_by = NULL;
     GString           *filter_name = NULL;
+    GString           *from = NULL;
+    GString           *merge_fields = NULL;
+    uint64_t           hash;
+    uint64_t           gen = 0;
+    unsigned int       chg_mask = 0;
+    bool               use_cache = false;
 
 
     /* check profile argument and increase output array if needed */
@@ -344,6 +864,7 @@ struct lmgr_report_t *ListMgr_Report(lmgr_t *p_mgr,
 
     /* initially, no char * tab allocated */
     p_report->str_tab = NULL;
+    p_report->part_table[0] = '\0';
 
     if (p_opt)
         opt = *p_opt;
@@ -469,14 +990,16 @@ struct lmgr_report_t *ListMgr_Report(lmgr_t *p_mgr,
         {
             if (profile_descr->attr_index == ATTR_INDEX_size)
             {
+                /* name profile fields, so partial results can be merged */
                 coma_if_needed(fields);
-                g_string_append(fields, "SUM(size=0)");
+                g_string_append(fields, "SUM(size=0) as prof0");
 
                 for (i = 1; i < SZ_PROFIL_COUNT-1; i++)
                     g_string_append_printf(fields,
-                            ",SUM("SZRANGE_FUNC"(size)=%u)", i-1);
+                            ",SUM("SZRANGE_FUNC"(size)=%u) as prof%u", i-1, i);
 
-                g_string_append_printf(fields, ",SUM("SZRANGE_FUNC"(size)>=%u)", SZ_PROFIL_COUNT-1);
+                g_string_append_printf(fields, ",SUM("SZRANGE_FUNC"(size)>=%u) as prof%u",
+                                       SZ_PROFIL_COUNT-1, SZ_PROFIL_COUNT-1);
 
                 for (i = 0; i< SZ_PROFIL_COUNT; i++)
                     p_report->result[i+report_descr_count].type = DB_BIGUINT;
@@ -500,6 +1023,15 @@ struct lmgr_report_t *ListMgr_Report(lmgr_t *p_mgr,
                 }
             }
         }
+
+        /* can it be split into partial reports? */
+        if (report_parallel_ok(report_desc_array, report_descr_count,
+                               profile_descr))
+        {
+            merge_fields = g_string_new(NULL);
+            report_merge_fields(merge_fields, report_desc_array,
+                                report_descr_count, profile_len);
+        }
     }
 
     /* process filter */
@@ -529,25 +1061,22 @@ struct lmgr_report_t *ListMgr_Report(lmgr_t *p_mgr,
         }
     }
 
-    /* start building the whole request */
-    req = g_string_new("SELECT ");
-    g_string_append_printf(req, "%s FROM ", fields->str);
-
     /* FROM clause */
+    from = g_string_new(NULL);
     if (use_acct_table)
     {
-        g_string_append(req, ACCT_TABLE);
+        g_string_append(from, ACCT_TABLE);
         query_tab = T_ACCT;
     }
     else
     {
         bool distinct;
 
-        filter_from(p_mgr, &fcnt, req, &query_tab, &distinct, AOF_SKIP_NAME);
+        filter_from(p_mgr, &fcnt, from, &query_tab, &distinct, AOF_SKIP_NAME);
 
         if (filter_name != NULL && !GSTRING_EMPTY(filter_name))
         {
-            g_string_append_printf(req, " INNER JOIN (SELECT DISTINCT(id)"
+            g_string_append_printf(from, " INNER JOIN (SELECT DISTINCT(id)"
                             " FROM "DNAMES_TABLE" WHERE %s) N"
                             " ON %s.id=N.id", filter_name->str,
                             table2name(query_tab));
@@ -556,6 +1085,10 @@ struct lmgr_report_t *ListMgr_Report(lmgr_t *p_mgr,
         /* FIXME: do the same for stripe items */
     }
 
+    /* start building the whole request */
+    req = g_string_new(NULL);
+    g_string_printf(req, "SELECT %s FROM %s", fields->str, from->str);
+
     /* Build the request */
     if (!GSTRING_EMPTY(where))
         g_string_append_printf(req, " WHERE %s", where->str);
@@ -573,6 +1106,51 @@ struct lmgr_report_t *ListMgr_Report(lmgr_t *p_mgr,
     if (opt.list_count_max > 0)
         g_string_append_printf(req, " LIMIT %u", opt.list_count_max);
 
+    /* the request identifies the report in cache */
+    hash = report_hash(req->str);
+
+    if (lmgr_config.report_cache)
+    {
+        chg_mask = report_chg_mask(use_acct_table, &fcnt);
+        rc = lmgr_change_gen(&p_mgr->conn, chg_mask, &gen);
+        if (rc == DB_SUCCESS)
+        {
+            use_cache = true;
+
+            rc = report_cache_lookup(p_report, hash, gen, order_by);
+            if (rc == DB_SUCCESS)
+                goto free_str;
+        }
+    }
+
+    if (merge_fields != NULL)
+    {
+        rc = report_parallel(p_report, hash, query_tab, fields, from, where,
+                             group_by, merge_fields, having, order_by,
+                             opt.list_count_max, req);
+        if (rc != DB_SUCCESS)
+        {
+            if (rc != DB_NOT_SUPPORTED)
+                DisplayLog(LVL_MAJOR, LISTMGR_TAG, "Failed to split report "
+                           "(error %d): running it sequentially", rc);
+            report_drop_part(p_report);
+        }
+    }
+
+    if (use_cache)
+    {
+        rc = report_cache_store(p_report, hash, gen, chg_mask, req->str,
+                                order_by);
+        if (rc == DB_SUCCESS)
+        {
+            /* partial results are no longer needed */
+            report_drop_part(p_report);
+            goto free_str;
+        }
+        DisplayLog(LVL_DEBUG, LISTMGR_TAG, "Could not save report %016"PRIx64
+                   " to cache (error %d)", hash, rc);
+    }
+
 
 retry:
     /* execute request (expect that ACCT table does not exists) */
@@ -604,8 +1182,11 @@ retry:
         g_string_free(order_by, TRUE);
         g_string_free(having, TRUE);
         g_string_free(where, TRUE);
+        g_string_free(from, TRUE);
         if (filter_name != NULL)
             g_string_free(filter_name, TRUE);
+        if (merge_fields != NULL)
+            g_string_free(merge_fields, TRUE);
 
         return ListMgr_Report(p_mgr, report_desc_array, report_descr_count,
                                profile_descr,
@@ -624,11 +1205,16 @@ free_str:
         g_string_free(req, TRUE);
     if (filter_name != NULL)
         g_string_free(filter_name, TRUE);
+    if (from != NULL)
+        g_string_free(from, TRUE);
+    if (merge_fields != NULL)
+        g_string_free(merge_fields, TRUE);
 
     if (rc == DB_SUCCESS)
         return p_report;
 
 /* error */
+    report_drop_part(p_report);
     MemFree(p_report->result);
 
 free_report:
@@ -726,6 +1312,7 @@ int ListMgr_GetNextReportItem( struct lmgr_report_t *p_iter, db_value_t * p_valu
 void ListMgr_CloseReport(struct lmgr_report_t *p_iter)
 {
     db_result_free(&p_iter->p_mgr->conn, &p_iter->select_result);
+    report_drop_part(p_iter);
 
     if (p_iter->str_tab != NULL)
         MemFree(p_iter->str_tab);
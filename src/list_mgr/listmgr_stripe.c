@@ -189,7 +189,13 @@ int batch_insert_stripe_info(lmgr_t *p_mgr, pktype *pklist, int *validators,
 
     /* only execute it if there was some stripe items */
     if (total_si > 0)
+    {
         rc = db_exec_sql(&p_mgr->conn, req->str, NULL);
+        if (rc)
+            goto out;
+    }
+
+    rc = update_ost_lru(p_mgr, pklist, p_attrs, count, true);
 
 out:
     g_string_free(req, TRUE);
@@ -197,6 +203,65 @@ out:
 }
 
 
+int update_ost_lru(lmgr_t *p_mgr, pktype *pklist, attr_set_t **p_attrs,
+                   unsigned int count, bool stripe_changed)
+{
+    GString *ids;
+    GString *req = NULL;
+    int      i, rc = DB_SUCCESS;
+
+    if (!ost_lru_enabled())
+        return DB_SUCCESS;
+
+    /* list of entries to be updated */
+    ids = g_string_new(NULL);
+    for (i = 0; i < count; i++)
+    {
+        if (stripe_changed ? !ATTR_MASK_TEST(p_attrs[i], stripe_items)
+             : !attr_mask_test_index(&p_attrs[i]->attr_mask,
+                                     lmgr_config.ost_lru_attr))
+            continue;
+
+        g_string_append_printf(ids, "%s"DPK, GSTRING_EMPTY(ids) ? "" : ",",
+                               pklist[i]);
+    }
+    if (GSTRING_EMPTY(ids))
+        goto out;
+
+    req = g_string_new(NULL);
+
+    if (stripe_changed)
+    {
+        /* drop previous OST list and insert the new one */
+        g_string_printf(req, "DELETE FROM "OST_LRU_TABLE" WHERE id IN (%s)",
+                        ids->str);
+        rc = db_exec_sql(&p_mgr->conn, req->str, NULL);
+        if (rc)
+            goto out;
+
+        g_string_printf(req, "INSERT INTO "OST_LRU_TABLE"(id,ostidx,lru) "
+                        "SELECT DISTINCT S.id,S.ostidx,M.%s FROM "
+                        STRIPE_ITEMS_TABLE" S INNER JOIN "MAIN_TABLE" M "
+                        "ON S.id=M.id WHERE S.id IN (%s)",
+                        field_name(lmgr_config.ost_lru_attr), ids->str);
+    }
+    else
+    {
+        /* only the sort attribute changed */
+        g_string_printf(req, "UPDATE "OST_LRU_TABLE" SET lru=(SELECT %s FROM "
+                        MAIN_TABLE" WHERE "MAIN_TABLE".id="OST_LRU_TABLE".id) "
+                        "WHERE id IN (%s)",
+                        field_name(lmgr_config.ost_lru_attr), ids->str);
+    }
+    rc = db_exec_sql(&p_mgr->conn, req->str, NULL);
+
+out:
+    g_string_free(ids, TRUE);
+    if (req != NULL)
+        g_string_free(req, TRUE);
+    return rc;
+}
+
 int get_stripe_info(lmgr_t *p_mgr, PK_ARG_T pk, stripe_info_t *p_stripe_info,
                     stripe_items_t *p_items)
 {
@@ -30,6 +30,15 @@ int batch_insert_stripe_info(lmgr_t *p_mgr, pktype *pklist, int *validators,
                              attr_set_t **p_attrs,
                              unsigned int count, bool update_if_exists);
 
+/**
+ * Maintain the OST_LRU table (if enabled) for a set of entries.
+ * @param stripe_changed  stripe items of entries have been (re)written:
+ *                        rebuild the OST list of these entries.
+ *                        Else, only update the indexed time attribute.
+ */
+int update_ost_lru(lmgr_t *p_mgr, pktype *pklist, attr_set_t **p_attrs,
+                   unsigned int count, bool stripe_changed);
+
 int            get_stripe_info( lmgr_t * p_mgr, PK_ARG_T pk, stripe_info_t * p_stripe,
                                 stripe_items_t * p_items );
 
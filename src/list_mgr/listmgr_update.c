@@ -144,13 +144,34 @@ retry:
         else if (rc)
             goto rollback;
     }
+
+    /* indexed time attribute changed, but not the stripe */
+    if (ost_lru_enabled() && !ATTR_MASK_TEST(p_update_set, stripe_items)
+        && attr_mask_test_index(&p_update_set->attr_mask,
+                                lmgr_config.ost_lru_attr))
+    {
+        attr_set_t *p_attr = (attr_set_t *)p_update_set;
+        pktype list[1];
+
+        rh_strncpy(list[0], pk, sizeof(*list));
+
+        rc = update_ost_lru(p_mgr, list, &p_attr, 1, false);
+        if (lmgr_delayed_retry(p_mgr, rc))
+            goto retry;
+        else if (rc)
+            goto rollback;
+    }
 #endif
 
     rc = lmgr_commit(p_mgr);
     if (lmgr_delayed_retry(p_mgr, rc))
         goto retry;
     if (rc == DB_SUCCESS)
+    {
         p_mgr->nbop[OPIDX_UPDATE]++;
+        lmgr_count_changes(p_mgr, &p_update_set->attr_mask, 1);
+        ecache_store(p_id, p_update_set, false);
+    }
 
     goto free_str;
 
@@ -212,6 +233,12 @@ retry:
         goto retry;
     else
     {
+        if (rc == DB_SUCCESS)
+        {
+            lmgr_count_changes(p_mgr, NULL, 1);
+            /* parent of child entries changed too */
+            ecache_invalidate(NULL);
+        }
         g_string_free(req, TRUE);
         return rc;
     }
@@ -23,7 +23,10 @@
 #include "database.h"
 #include "listmgr_common.h"
 #include "rbh_logs.h"
+#include "rbh_misc.h"
 #include <stdio.h>
+#include <inttypes.h>
+#include <time.h>
 
 int lmgr_get_var(db_conn_t *pconn, const char *varname, char *value, int bufsize)
 {
@@ -135,3 +138,122 @@ retry:
         goto retry;
     return rc;
 }
+
+/** names of the persistent change counters in VARS table */
+static const char *chg_var_name[CHGCOUNT] = {
+    [CHGIDX_MAIN]   = "ChgCount_"MAIN_TABLE,
+    [CHGIDX_ANNEX]  = "ChgCount_"ANNEX_TABLE,
+    [CHGIDX_NAMES]  = "ChgCount_"DNAMES_TABLE,
+    [CHGIDX_STRIPE] = "ChgCount_"STRIPE_INFO_TABLE,
+};
+
+/**
+ * Report pending changes to the persistent change counters.
+ * This is only done out of pending transactions, to avoid holding
+ * a lock on VARS rows until the next commit: the counters are flushed
+ * when the transaction is committed (see _lmgr_commit()).
+ * All counters are updated by a single request.
+ */
+int lmgr_flush_changes(lmgr_t *p_mgr)
+{
+    GString *req;
+    int      i;
+    int      rc = DB_SUCCESS;
+
+    if (p_mgr->last_commit != 0)
+        return DB_SUCCESS;
+
+    req = g_string_new(NULL);
+
+    for (i = 0; i < CHGCOUNT; i++)
+    {
+        if (p_mgr->chg_pending[i] == 0)
+            continue;
+
+        g_string_append_printf(req, "%s('%s','%u')",
+                               GSTRING_EMPTY(req) ?
+                                   "INSERT INTO "VAR_TABLE" (varname,value) VALUES "
+                                   : ",",
+                               chg_var_name[i], p_mgr->chg_pending[i]);
+    }
+
+    if (GSTRING_EMPTY(req))
+        goto out;
+
+    g_string_append(req, " ON DUPLICATE KEY UPDATE value=value+VALUES(value)");
+
+    rc = db_exec_sql(&p_mgr->conn, req->str, NULL);
+    if (rc)
+    {
+        /* keep pending changes for next flush */
+        DisplayLog(LVL_VERB, LISTMGR_TAG, "Failed to update change "
+                   "counters: error %d", rc);
+        goto out;
+    }
+
+    for (i = 0; i < CHGCOUNT; i++)
+        p_mgr->chg_pending[i] = 0;
+out:
+    g_string_free(req, TRUE);
+    return rc;
+}
+
+/**
+ * Account changes to the tables of the given attributes.
+ * Changes are reported to the persistent counters immediately if they
+ * are already committed, else at the end of the current transaction.
+ * Counters are only used to expire cached reports: they are not maintained
+ * if report_cache is disabled.
+ * @param attr_mask attributes that were modified (NULL for all tables).
+ * @param count number of modified entries.
+ */
+void lmgr_count_changes(lmgr_t *p_mgr, const attr_mask_t *attr_mask,
+                        unsigned int count)
+{
+    if (!lmgr_config.report_cache)
+        return;
+
+    if (attr_mask == NULL || main_fields(*attr_mask))
+        p_mgr->chg_pending[CHGIDX_MAIN] += count;
+    if (attr_mask == NULL || annex_fields(*attr_mask))
+        p_mgr->chg_pending[CHGIDX_ANNEX] += count;
+    if (attr_mask == NULL || names_fields(*attr_mask))
+        p_mgr->chg_pending[CHGIDX_NAMES] += count;
+    if (attr_mask == NULL || stripe_fields(*attr_mask))
+        p_mgr->chg_pending[CHGIDX_STRIPE] += count;
+
+    lmgr_flush_changes(p_mgr);
+}
+
+/**
+ * Get the current generation of the given tables, as the sum of
+ * their persistent change counters.
+ * @param chg_mask mask of (1 << CHGIDX_*) values.
+ */
+int lmgr_change_gen(db_conn_t *pconn, unsigned int chg_mask, uint64_t *gen)
+{
+    char     val[128];
+    uint64_t count;
+    int      i, rc;
+
+    *gen = 0;
+
+    for (i = 0; i < CHGCOUNT; i++)
+    {
+        if (!(chg_mask & (1 << i)))
+            continue;
+
+        rc = lmgr_get_var(pconn, chg_var_name[i], val, sizeof(val));
+        if (rc == DB_NOT_EXISTS)
+            /* no change counted yet */
+            continue;
+        else if (rc)
+            return rc;
+
+        if (sscanf(val, "%"SCNu64, &count) != 1)
+            return DB_REQUEST_FAILED;
+
+        *gen += count;
+    }
+    return DB_SUCCESS;
+}
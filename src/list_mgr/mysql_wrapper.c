@@ -380,6 +380,14 @@ unsigned long long db_last_id( db_conn_t * conn )
     return mysql_insert_id( conn );
 }
 
+unsigned long long db_affected_rows(db_conn_t *conn)
+{
+    my_ulonglong n = mysql_affected_rows(conn);
+
+    /* (my_ulonglong)-1 on error */
+    return (n == (my_ulonglong)-1) ? 0 : n;
+}
+
 
 /* escape a string in a SQL request */
 int db_escape_string( db_conn_t * conn, char * str_out, size_t out_size, const char * str_in )
@@ -12,6 +12,27 @@
  * accept its terms.
  */
 
+/**
+ * SQLite database wrapper.
+ *
+ * The database is opened in WAL mode by default: a single writer
+ * (the DB_APPLY stage of the pipeline) and concurrent readers.
+ * Query results are streamed from prepared statements
+ * (rows are not loaded in memory), and single-statement queries are kept
+ * in a per-connection statement cache to save parsing of repeated queries.
+ * As queries are built with inlined values, the literals of DML statements
+ * are turned into bound parameters, so that queries which only differ
+ * by their values (e.g. get/insert/update of an entry by id) share the same
+ * cached statement.
+ *
+ * MySQL upserts (INSERT IGNORE, ON DUPLICATE KEY UPDATE) are translated
+ * to their SQLite equivalent, and the DB functions used in requests
+ * (sz_range, one_path, this_path, sha1) are implemented as C functions.
+ * Upserts without conflict target require SQLite 3.35 or later.
+ * Trigger bodies are not translated: accounting triggers are generated
+ * in SQLite syntax by the list manager.
+ */
+
 #ifdef HAVE_CONFIG_H
 #include "config.h"
 #endif
@@ -19,63 +40,894 @@
 #include "list_mgr.h"
 #include "database.h"
 #include "rbh_logs.h"
+#include "rbh_misc.h"
 #include <stdio.h>
+#include <stdlib.h>
 #include <unistd.h>
+#include <errno.h>
+#include <ctype.h>
+#include <glib.h>
+
+/** don't cache statements for longer queries (e.g. batched inserts) */
+#define STMT_CACHE_MAX_SQL  4096
+
+struct stmt_cache_entry
+{
+    char          *sql;
+    guint          hash;
+    sqlite3_stmt  *stmt;
+    bool           in_use;
+    unsigned long  last_use;
+};
+
+struct sqlite_stmt_cache
+{
+    unsigned int   size;
+    unsigned long  clock;
+    unsigned long  hits;
+    unsigned long  misses;
+    struct stmt_cache_entry entries[];
+};
 
-static int sqlite_error_convert( int err )
+static int sqlite_error_convert(db_conn_t *conn, int err, bool verb)
 {
-    switch ( err )
+    switch (err & 0xff) /* primary result code */
     {
     case SQLITE_OK:
+    case SQLITE_DONE:
         return DB_SUCCESS;
     case SQLITE_NOTFOUND:
         return DB_NOT_EXISTS;
     case SQLITE_CONSTRAINT: /* unique constraint violation */
         return DB_ALREADY_EXISTS;
+    case SQLITE_BUSY:
+    case SQLITE_LOCKED:
+        /* lock timeout or lock upgrade deadlock:
+         * the whole transaction must be retried */
+        if (verb)
+            DisplayLog(LVL_EVENT, LISTMGR_TAG, "DB lock timeout or deadlock "
+                       "detected");
+        return DB_DEADLOCK;
+    case SQLITE_ERROR:
+        if (conn->db != NULL
+            && !strncmp(sqlite3_errmsg(conn->db), "no such table", 13))
+            return DB_NOT_EXISTS;
+        return DB_REQUEST_FAILED;
+    case SQLITE_CANTOPEN:
+    case SQLITE_IOERR:
+    case SQLITE_CORRUPT:
+    case SQLITE_NOTADB:
+        if (verb)
+            DisplayLog(LVL_CRIT, LISTMGR_TAG, "DB file error %d: %s", err,
+                       conn->db ? sqlite3_errmsg(conn->db) : "");
+        return DB_CONNECT_FAILED;
     default:
-        DisplayLog( LVL_MAJOR, LISTMGR_TAG,
-                    "Unhandled error %d: default conversion to DB_REQUEST_FAILED", err );
+        DisplayLog(verb ? LVL_MAJOR : LVL_DEBUG, LISTMGR_TAG,
+                   "Unhandled error %d: default conversion to DB_REQUEST_FAILED", err);
         return DB_REQUEST_FAILED;
     }
 }
 
-static int db_is_busy_err( int rc )
+bool db_is_retryable(int db_err)
+{
+    switch (db_err)
+    {
+        case DB_DEADLOCK: /* Note: the whole transaction must be retryed */
+            return true;
+        default:
+            return false;
+    }
+}
+
+/** wait for locks held by other connections */
+static int busy_handler(void *arg, int count)
 {
-    /* sometimes, SQLITE_CANTOPEN meens the db is busy (locked)... */
-    return ( rc == SQLITE_BUSY ) || ( rc == SQLITE_CANTOPEN );
+    unsigned int delay = lmgr_config.db_config.retry_delay_microsec;
+
+    if (lmgr_config.db_config.busy_timeout != 0
+        && (unsigned long long)count * delay
+            >= lmgr_config.db_config.busy_timeout * 1000000ULL)
+        return 0;
+
+    usleep(delay);
+    return 1;
 }
 
-static int set_cache_size( sqlite3 * conn )
+static int set_pragma(db_conn_t *conn, const char *pragma, const char *value,
+                      const char *expected)
 {
+    char           query[256];
+    sqlite3_stmt  *stmt;
     int            rc;
-    char          *errmsg;
 
-    rc = sqlite3_exec( conn, "PRAGMA cache_size=1000000", NULL, NULL, &errmsg );
-    if ( rc != SQLITE_OK )
+    snprintf(query, sizeof(query), "PRAGMA %s=%s", pragma, value);
+
+    rc = sqlite3_prepare_v2(conn->db, query, -1, &stmt, NULL);
+    if (rc != SQLITE_OK)
     {
-        DisplayLog( LVL_CRIT, LISTMGR_TAG, "SQL error: %s", errmsg );
-        sqlite3_free( errmsg );
+        DisplayLog(LVL_CRIT, LISTMGR_TAG, "SQL error: %s: %s", query,
+                   sqlite3_errmsg(conn->db));
         return DB_REQUEST_FAILED;
     }
 
+    rc = sqlite3_step(stmt);
+    /* some pragmas return the value actually set */
+    if (rc == SQLITE_ROW && expected != NULL)
+    {
+        const char *set = (const char *)sqlite3_column_text(stmt, 0);
+
+        if (set == NULL || strcasecmp(set, expected))
+            DisplayLog(LVL_MAJOR, LISTMGR_TAG, "Failed to set %s=%s "
+                       "(current value: %s)", pragma, value, set ? set : "?");
+    }
+    else if (rc != SQLITE_ROW && rc != SQLITE_DONE)
+        DisplayLog(LVL_MAJOR, LISTMGR_TAG, "SQL error: %s: %s", query,
+                   sqlite3_errmsg(conn->db));
+
+    sqlite3_finalize(stmt);
+    return (rc == SQLITE_ROW || rc == SQLITE_DONE) ? DB_SUCCESS :
+                                                    DB_REQUEST_FAILED;
+}
+
+/* ------------ statement cache ------------ */
+
+static struct sqlite_stmt_cache *stmt_cache_new(unsigned int size)
+{
+    struct sqlite_stmt_cache *cache;
+
+    cache = calloc(1, sizeof(*cache) + size * sizeof(struct stmt_cache_entry));
+    if (cache != NULL)
+        cache->size = size;
+    return cache;
+}
+
+static void stmt_cache_free(struct sqlite_stmt_cache *cache)
+{
+    unsigned int i;
+
+    if (cache == NULL)
+        return;
+
+    DisplayLog(LVL_FULL, LISTMGR_TAG, "Statement cache: %lu hits, %lu misses",
+               cache->hits, cache->misses);
+
+    for (i = 0; i < cache->size; i++)
+    {
+        if (cache->entries[i].stmt != NULL)
+            sqlite3_finalize(cache->entries[i].stmt);
+        free(cache->entries[i].sql);
+    }
+    free(cache);
+}
+
+/**
+ * Get a prepared statement for the first SQL statement of 'query'.
+ * @param[out] tail remaining part of the query.
+ */
+static int stmt_get(db_conn_t *conn, const char *query, sqlite3_stmt **stmt,
+                    const char **tail)
+{
+    struct sqlite_stmt_cache *cache = conn->stmt_cache;
+    guint hash;
+    unsigned int i;
+
+    if (cache != NULL)
+    {
+        hash = g_str_hash(query);
+        for (i = 0; i < cache->size; i++)
+        {
+            struct stmt_cache_entry *e = &cache->entries[i];
+
+            if (e->stmt != NULL && !e->in_use && e->hash == hash
+                && !strcmp(e->sql, query))
+            {
+                e->in_use = true;
+                e->last_use = ++cache->clock;
+                cache->hits++;
+                *stmt = e->stmt;
+                *tail = query + strlen(query);
+                return SQLITE_OK;
+            }
+        }
+        cache->misses++;
+    }
+
+    return sqlite3_prepare_v2(conn->db, query, -1, stmt, tail);
+}
+
+/**
+ * Release a statement got by stmt_get(). It is kept in the cache if
+ * 'sql' is not NULL (single statement query).
+ */
+static void stmt_release(db_conn_t *conn, sqlite3_stmt *stmt, const char *sql)
+{
+    struct sqlite_stmt_cache *cache = conn->stmt_cache;
+    struct stmt_cache_entry  *victim = NULL;
+    unsigned int i;
+
+    sqlite3_reset(stmt);
+
+    if (cache == NULL)
+    {
+        sqlite3_finalize(stmt);
+        return;
+    }
+
+    for (i = 0; i < cache->size; i++)
+    {
+        struct stmt_cache_entry *e = &cache->entries[i];
+
+        /* already in the cache */
+        if (e->stmt == stmt)
+        {
+            e->in_use = false;
+            return;
+        }
+        /* select a free slot, or the least recently used statement */
+        if (e->stmt == NULL)
+        {
+            if (victim == NULL || victim->stmt != NULL)
+                victim = e;
+        }
+        else if (!e->in_use && (victim == NULL || (victim->stmt != NULL
+                                && e->last_use < victim->last_use)))
+            victim = e;
+    }
+
+    if (sql == NULL || victim == NULL || strlen(sql) > STMT_CACHE_MAX_SQL)
+    {
+        sqlite3_finalize(stmt);
+        return;
+    }
+
+    if (victim->stmt != NULL)
+    {
+        sqlite3_finalize(victim->stmt);
+        free(victim->sql);
+    }
+    victim->sql = strdup(sql);
+    if (victim->sql == NULL)
+    {
+        victim->stmt = NULL;
+        sqlite3_finalize(stmt);
+        return;
+    }
+    victim->hash = g_str_hash(sql);
+    victim->stmt = stmt;
+    victim->in_use = false;
+    victim->last_use = ++cache->clock;
+}
+
+/* ------------ query parameterization ------------ */
+
+/** a literal value extracted from a query */
+struct sql_param
+{
+    enum { PARAM_INT, PARAM_FLOAT, PARAM_TEXT } type;
+    union {
+        sqlite3_int64 i;
+        double        d;
+        struct { size_t off; size_t len; } s; /* in text buffer */
+    } val;
+};
+
+/** literals of a parameterized query */
+struct sql_params
+{
+    GArray  *params; /* of struct sql_param */
+    GString *text;   /* unescaped string values */
+};
+
+static inline bool is_ident_char(char c)
+{
+    return isalnum((unsigned char)c) || c == '_' || c == '$';
+}
+
+static bool keyword_is(const char *word, size_t len, const char *kw)
+{
+    return len == strlen(kw) && !strncasecmp(word, kw, len);
+}
+
+static void sql_params_free(struct sql_params *p)
+{
+    if (p->params != NULL)
+        g_array_free(p->params, TRUE);
+    if (p->text != NULL)
+        g_string_free(p->text, TRUE);
+    p->params = NULL;
+    p->text = NULL;
+}
+
+/** copy a quoted literal or identifier as is
+ * @return pointer after the closing quote, NULL if it is not terminated. */
+static const char *copy_quoted(GString *out, const char *c, char quote)
+{
+    const char *start = c;
+
+    for (c++; *c != '\0'; c++)
+    {
+        if (*c == quote)
+        {
+            /* doubled quote */
+            if (c[1] == quote)
+            {
+                c++;
+                continue;
+            }
+            g_string_append_len(out, start, c + 1 - start);
+            return c + 1;
+        }
+    }
+    return NULL;
+}
+
+/**
+ * Replace the literal values of a single DML statement by parameters.
+ * Positional references in ORDER BY and GROUP BY clauses are kept as is.
+ * @param[out] norm the query with '?' instead of literals.
+ * @param[out] p the extracted values, in order.
+ * @return false if the query can't be parameterized (DDL, multiple
+ *         statements, comments...): it must be run as is.
+ */
+static bool sql_parameterize(const char *query, unsigned int max_params,
+                             GString *norm, struct sql_params *p)
+{
+    const char *c = query;
+    bool        first_word = true;
+    bool        by_clause = false; /* in ORDER BY or GROUP BY */
+    bool        want_by = false;
+    int         depth = 0;
+    int         by_depth = 0;
+
+    p->params = g_array_new(FALSE, FALSE, sizeof(struct sql_param));
+    p->text = g_string_new(NULL);
+    g_string_truncate(norm, 0);
+
+    while (*c != '\0')
+    {
+        struct sql_param param;
+
+        if (*c == '\'')
+        {
+            /* string literal */
+            param.type = PARAM_TEXT;
+            param.val.s.off = p->text->len;
+            for (c++; *c != '\0'; c++)
+            {
+                if (*c == '\'')
+                {
+                    if (c[1] != '\'')
+                        break;
+                    c++;
+                }
+                g_string_append_c(p->text, *c);
+            }
+            if (*c == '\0')
+                goto no_param;
+            c++;
+            param.val.s.len = p->text->len - param.val.s.off;
+            g_array_append_val(p->params, param);
+            g_string_append_c(norm, '?');
+        }
+        else if (*c == '"' || *c == '`')
+        {
+            /* quoted identifier */
+            c = copy_quoted(norm, c, *c);
+            if (c == NULL)
+                goto no_param;
+        }
+        else if (isalpha((unsigned char)*c) || *c == '_')
+        {
+            const char *word = c;
+            size_t      len;
+
+            while (is_ident_char(*c))
+                c++;
+            len = c - word;
+
+            if (first_word)
+            {
+                if (!keyword_is(word, len, "SELECT")
+                    && !keyword_is(word, len, "INSERT")
+                    && !keyword_is(word, len, "UPDATE")
+                    && !keyword_is(word, len, "DELETE")
+                    && !keyword_is(word, len, "REPLACE"))
+                    goto no_param;
+                first_word = false;
+            }
+
+            if (keyword_is(word, len, "ORDER") || keyword_is(word, len, "GROUP"))
+                want_by = true;
+            else if (want_by && keyword_is(word, len, "BY"))
+            {
+                by_clause = true;
+                by_depth = depth;
+                want_by = false;
+            }
+            else
+            {
+                want_by = false;
+                if (keyword_is(word, len, "LIMIT")
+                    || keyword_is(word, len, "HAVING")
+                    || keyword_is(word, len, "UNION"))
+                    by_clause = false;
+            }
+
+            g_string_append_len(norm, word, len);
+
+            /* blob literal (x'...') */
+            if (len == 1 && (*word == 'x' || *word == 'X') && *c == '\'')
+            {
+                c = copy_quoted(norm, c, '\'');
+                if (c == NULL)
+                    goto no_param;
+            }
+        }
+        else if (isdigit((unsigned char)*c)
+                 || (*c == '.' && isdigit((unsigned char)c[1])))
+        {
+            const char *num = c;
+            char       *end;
+            bool        is_float = false;
+
+            while (isalnum((unsigned char)*c) || *c == '.'
+                   || ((*c == '+' || *c == '-') && (c[-1] == 'e' || c[-1] == 'E')))
+            {
+                if (*c == '.' || *c == 'e' || *c == 'E')
+                    is_float = true;
+                c++;
+            }
+
+            /* keep column positions, and unusual number formats */
+            if (by_clause)
+            {
+                g_string_append_len(norm, num, c - num);
+                continue;
+            }
+
+            errno = 0;
+            if (is_float)
+            {
+                param.type = PARAM_FLOAT;
+                param.val.d = strtod(num, &end);
+            }
+            else
+            {
+                param.type = PARAM_INT;
+                param.val.i = strtoll(num, &end, 10);
+            }
+            if (end != c || errno != 0)
+                goto no_param;
+
+            g_array_append_val(p->params, param);
+            g_string_append_c(norm, '?');
+        }
+        else if (*c == ';')
+        {
+            const char *t = c;
+
+            /* several statements are not parameterized */
+            while (*t == ';' || isspace((unsigned char)*t))
+                t++;
+            if (*t != '\0')
+                goto no_param;
+            break;
+        }
+        else if (*c == '?' || *c == ':' || *c == '@' || *c == '$'
+                 || (*c == '-' && c[1] == '-') || (*c == '/' && c[1] == '*'))
+        {
+            /* parameters or comments */
+            goto no_param;
+        }
+        else
+        {
+            if (*c == '(')
+                depth++;
+            else if (*c == ')')
+            {
+                depth--;
+                /* end of a sub-query */
+                if (by_clause && depth < by_depth)
+                    by_clause = false;
+            }
+            g_string_append_c(norm, *c);
+            c++;
+        }
+
+        if (p->params->len > max_params)
+            goto no_param;
+    }
+
+    if (first_word || p->params->len == 0)
+        goto no_param;
+
+    return true;
+
+no_param:
+    sql_params_free(p);
+    return false;
+}
+
+/** bind extracted values to a statement */
+static int sql_params_bind(sqlite3_stmt *stmt, const struct sql_params *p)
+{
+    unsigned int i;
+    int          rc = SQLITE_OK;
+
+    if (sqlite3_bind_parameter_count(stmt) != p->params->len)
+        return SQLITE_RANGE;
+
+    for (i = 0; i < p->params->len && rc == SQLITE_OK; i++)
+    {
+        const struct sql_param *param = &g_array_index(p->params,
+                                                       struct sql_param, i);
+        switch (param->type)
+        {
+        case PARAM_INT:
+            rc = sqlite3_bind_int64(stmt, i + 1, param->val.i);
+            break;
+        case PARAM_FLOAT:
+            rc = sqlite3_bind_double(stmt, i + 1, param->val.d);
+            break;
+        case PARAM_TEXT:
+            rc = sqlite3_bind_text(stmt, i + 1,
+                                   p->text->str + param->val.s.off,
+                                   param->val.s.len, SQLITE_TRANSIENT);
+            break;
+        }
+    }
+    return rc;
+}
+
+/* ------------ MySQL compatibility ------------ */
+
+/** match a sequence of keywords separated by blanks
+ * @return pointer after the last keyword, NULL if it doesn't match. */
+static const char *match_keywords(const char *c, const char * const *kw)
+{
+    for (; *kw != NULL; kw++)
+    {
+        size_t len = strlen(*kw);
+
+        while (isspace((unsigned char)*c))
+            c++;
+        if (strncasecmp(c, *kw, len)
+            || (is_ident_char((*kw)[len - 1]) && is_ident_char(c[len])))
+            return NULL;
+        c += len;
+    }
+    return c;
+}
+
+/**
+ * Translate MySQL upserts to SQLite syntax:
+ * - INSERT IGNORE => INSERT OR IGNORE
+ * - ON DUPLICATE KEY UPDATE x=VALUES(x) => ON CONFLICT DO UPDATE SET
+ *   x=excluded.x
+ * @return false if the query has nothing to translate.
+ */
+static bool sql_upsert_convert(const char *query, GString *out)
+{
+    static const char * const insert_ignore[] = { "INSERT", "IGNORE", NULL };
+    static const char * const on_dup[] = { "ON", "DUPLICATE", "KEY", "UPDATE",
+                                           NULL };
+    static const char * const values[] = { "VALUES", "(", NULL };
+    const char *c = query;
+    const char *next;
+    bool        in_update = false;
+    bool        changed = false;
+
+    while (isspace((unsigned char)*c))
+        c++;
+    if (strncasecmp(c, "INSERT", strlen("INSERT")))
+        return false;
+
+    g_string_truncate(out, 0);
+
+    next = match_keywords(c, insert_ignore);
+    if (next != NULL)
+    {
+        g_string_append(out, "INSERT OR IGNORE");
+        c = next;
+        changed = true;
+    }
+
+    while (*c != '\0')
+    {
+        if (*c == '\'' || *c == '"' || *c == '`')
+        {
+            next = copy_quoted(out, c, *c);
+            if (next == NULL)
+                return false;
+            c = next;
+        }
+        else if (isalpha((unsigned char)*c) || *c == '_')
+        {
+            const char *word = c;
+
+            if (!in_update && (next = match_keywords(c, on_dup)) != NULL)
+            {
+                g_string_append(out, "ON CONFLICT DO UPDATE SET");
+                c = next;
+                in_update = changed = true;
+                continue;
+            }
+            /* VALUES(x) => excluded.x */
+            if (in_update && (next = match_keywords(c, values)) != NULL)
+            {
+                const char *field = next;
+
+                while (isspace((unsigned char)*field))
+                    field++;
+                for (next = field; is_ident_char(*next); next++)
+                    ;
+                if (next != field && *next == ')')
+                {
+                    g_string_append(out, "excluded.");
+                    g_string_append_len(out, field, next - field);
+                    c = next + 1;
+                    continue;
+                }
+            }
+            while (is_ident_char(*c))
+                c++;
+            g_string_append_len(out, word, c - word);
+        }
+        else
+        {
+            g_string_append_c(out, *c);
+            c++;
+        }
+    }
+    return changed;
+}
+
+/** SQL function sz_range(size): index of the size profile range */
+static void sql_func_szrange(sqlite3_context *ctx, int argc,
+                             sqlite3_value **argv)
+{
+    uint64_t sz;
+    int      log2 = 0;
+
+    if (sqlite3_value_type(argv[0]) == SQLITE_NULL)
+    {
+        sqlite3_result_null(ctx);
+        return;
+    }
+    sz = sqlite3_value_int64(argv[0]);
+    if (sz == 0)
+    {
+        sqlite3_result_int(ctx, -1);
+        return;
+    }
+    /* FLOOR(LOG2(sz)/5) */
+    while (sz >>= 1)
+        log2++;
+    sqlite3_result_int(ctx, log2 / 5);
+}
+
+/** SQL function sha1(str), as hexadecimal string */
+static void sql_func_sha1(sqlite3_context *ctx, int argc,
+                          sqlite3_value **argv)
+{
+    const unsigned char *data;
+
+    if (sqlite3_value_type(argv[0]) == SQLITE_NULL)
+    {
+        sqlite3_result_null(ctx);
+        return;
+    }
+    data = sqlite3_value_blob(argv[0]);
+    sqlite3_result_text(ctx,
+                        g_compute_checksum_for_data(G_CHECKSUM_SHA1, data,
+                                                sqlite3_value_bytes(argv[0])),
+                        -1, g_free);
+}
+
+/** get the statement to read the newest parent and name of an entry */
+static sqlite3_stmt *names_stmt_get(sqlite3_context *ctx)
+{
+    db_conn_t *conn = sqlite3_user_data(ctx);
+    int        rc;
+
+    if (conn->names_stmt == NULL)
+    {
+        rc = sqlite3_prepare_v2(conn->db, "SELECT parent_id,name FROM "
+                                DNAMES_TABLE" WHERE id=? ORDER BY path_update"
+                                " DESC LIMIT 1", -1, &conn->names_stmt, NULL);
+        if (rc != SQLITE_OK)
+        {
+            sqlite3_result_error_code(ctx, rc);
+            return NULL;
+        }
+    }
+    return conn->names_stmt;
+}
+
+/**
+ * Build the path of an entry by walking up the NAMES table
+ * from the given parent, until a parent is not found.
+ * @param path contains the path relative to pid.
+ * The result is "<first unknown parent id>/<path>", like the MySQL
+ * version of one_path() and this_path().
+ */
+static void path_walk(sqlite3_context *ctx, sqlite3_value *pid_arg,
+                      GString *path)
+{
+    sqlite3_stmt  *stmt;
+    sqlite3_value *pid;
+    int            rc;
+
+    if (sqlite3_value_type(pid_arg) == SQLITE_NULL)
+    {
+        sqlite3_result_null(ctx);
+        return;
+    }
+
+    stmt = names_stmt_get(ctx);
+    if (stmt == NULL)
+        return;
+
+    pid = sqlite3_value_dup(pid_arg);
+    while (pid != NULL && path->len <= RBH_PATH_MAX)
+    {
+        sqlite3_bind_value(stmt, 1, pid);
+        rc = sqlite3_step(stmt);
+        if (rc == SQLITE_ROW)
+        {
+            const char *name = (const char *)sqlite3_column_text(stmt, 1);
+
+            g_string_prepend_c(path, '/');
+            g_string_prepend(path, name ? name : "");
+            sqlite3_value_free(pid);
+            pid = sqlite3_value_dup(sqlite3_column_value(stmt, 0));
+            sqlite3_reset(stmt);
+            continue;
+        }
+        sqlite3_reset(stmt);
+        if (rc != SQLITE_DONE)
+        {
+            sqlite3_result_error_code(ctx, rc);
+            sqlite3_value_free(pid);
+            return;
+        }
+
+        /* parent not found */
+        if (sqlite3_value_type(pid) == SQLITE_NULL)
+            sqlite3_result_null(ctx);
+        else
+        {
+            g_string_prepend_c(path, '/');
+            g_string_prepend(path, (const char *)sqlite3_value_text(pid));
+            sqlite3_result_text(ctx, path->str, path->len, SQLITE_TRANSIENT);
+        }
+        sqlite3_value_free(pid);
+        return;
+    }
+
+    if (pid == NULL)
+        sqlite3_result_error_nomem(ctx);
+    else
+        sqlite3_result_error(ctx, "path is too long (loop in namespace?)", -1);
+    sqlite3_value_free(pid);
+}
+
+/** SQL function one_path(id): one path of the given entry */
+static void sql_func_onepath(sqlite3_context *ctx, int argc,
+                             sqlite3_value **argv)
+{
+    sqlite3_stmt  *stmt;
+    sqlite3_value *pid = NULL;
+    GString       *path = NULL;
+
+    stmt = names_stmt_get(ctx);
+    if (stmt == NULL)
+        return;
+
+    sqlite3_bind_value(stmt, 1, argv[0]);
+    if (sqlite3_step(stmt) == SQLITE_ROW
+        && sqlite3_column_type(stmt, 1) != SQLITE_NULL)
+    {
+        path = g_string_new((const char *)sqlite3_column_text(stmt, 1));
+        pid = sqlite3_value_dup(sqlite3_column_value(stmt, 0));
+    }
+    sqlite3_reset(stmt);
+
+    /* entry not found: NULL */
+    if (path == NULL)
+    {
+        sqlite3_result_null(ctx);
+        return;
+    }
+    if (pid == NULL)
+        sqlite3_result_error_nomem(ctx);
+    else
+        path_walk(ctx, pid, path);
+
+    sqlite3_value_free(pid);
+    g_string_free(path, TRUE);
+}
+
+/** SQL function this_path(parent_id, name): path of the given name */
+static void sql_func_thispath(sqlite3_context *ctx, int argc,
+                              sqlite3_value **argv)
+{
+    GString *path;
+
+    if (sqlite3_value_type(argv[1]) == SQLITE_NULL)
+    {
+        sqlite3_result_null(ctx);
+        return;
+    }
+    path = g_string_new((const char *)sqlite3_value_text(argv[1]));
+    path_walk(ctx, argv[0], path);
+    g_string_free(path, TRUE);
+}
+
+static int register_functions(db_conn_t *conn)
+{
+    static const struct {
+        const char *name;
+        int         argc;
+        int         flags;
+        void      (*func)(sqlite3_context *, int, sqlite3_value **);
+    } funcs[] = {
+        {SZRANGE_FUNC,   1, SQLITE_DETERMINISTIC, sql_func_szrange},
+        {"sha1",         1, SQLITE_DETERMINISTIC, sql_func_sha1},
+        /* same result for the same id in a given request */
+        {ONE_PATH_FUNC,  1, 0, sql_func_onepath},
+        {THIS_PATH_FUNC, 2, 0, sql_func_thispath},
+    };
+    int i, rc;
+
+    for (i = 0; i < sizeof(funcs) / sizeof(funcs[0]); i++)
+    {
+        rc = sqlite3_create_function(conn->db, funcs[i].name, funcs[i].argc,
+                                     SQLITE_UTF8 | funcs[i].flags, conn,
+                                     funcs[i].func, NULL, NULL);
+        if (rc != SQLITE_OK)
+        {
+            DisplayLog(LVL_CRIT, LISTMGR_TAG, "Failed to register SQL "
+                       "function %s: %s", funcs[i].name,
+                       sqlite3_errmsg(conn->db));
+            return DB_REQUEST_FAILED;
+        }
+    }
     return DB_SUCCESS;
 }
 
+/** check there is nothing but blanks and separators after a statement */
+static bool is_last_stmt(const char *tail)
+{
+    if (tail == NULL)
+        return true;
+    while (*tail == ';' || *tail == ' ' || *tail == '\t' || *tail == '\n')
+        tail++;
+    return (*tail == '\0');
+}
+
+/* ------------ connection management ------------ */
 
 /* create client connection */
-int db_connect( db_conn_t * conn )
+int db_connect(db_conn_t *conn)
 {
-    int            rc;
+    char value[64];
+    int  rc;
+
+    memset(conn, 0, sizeof(*conn));
 
     /* Connect to database */
-    rc = sqlite3_open( lmgr_config.db_config.filepath, conn );
-    if ( rc != 0 )
+    rc = sqlite3_open_v2(lmgr_config.db_config.filepath, &conn->db,
+                         SQLITE_OPEN_READWRITE | SQLITE_OPEN_CREATE, NULL);
+    if (rc != SQLITE_OK)
     {
-        if ( *conn )
+        if (conn->db)
         {
             DisplayLog( LVL_CRIT, LISTMGR_TAG,
                         "Failed to connect to SQLite DB (file %s): Error: %s",
-                        lmgr_config.db_config.filepath, sqlite3_errmsg( *conn ) );
+                        lmgr_config.db_config.filepath, sqlite3_errmsg(conn->db));
+            sqlite3_close(conn->db);
+            conn->db = NULL;
         }
         else
         {
@@ -88,210 +940,499 @@ int db_connect( db_conn_t * conn )
 
     DisplayLog( LVL_FULL, LISTMGR_TAG, "Logged on to database successfully" );
 
-    set_cache_size( *conn );
+    sqlite3_busy_handler(conn->db, busy_handler, NULL);
+
+    /* WAL: readers don't block the writer, and the writer doesn't block
+     * readers */
+    if (!EMPTY_STRING(lmgr_config.db_config.journal_mode))
+        set_pragma(conn, "journal_mode", lmgr_config.db_config.journal_mode,
+                   lmgr_config.db_config.journal_mode);
+    if (!EMPTY_STRING(lmgr_config.db_config.synchronous))
+        set_pragma(conn, "synchronous", lmgr_config.db_config.synchronous,
+                   NULL);
+
+    /* negative value: size in KiB */
+    snprintf(value, sizeof(value), "-%llu",
+             lmgr_config.db_config.cache_size / 1024);
+    set_pragma(conn, "cache_size", value, NULL);
+    set_pragma(conn, "temp_store", "MEMORY", NULL);
+
+    if (lmgr_config.db_config.stmt_cache_size > 0)
+        conn->stmt_cache = stmt_cache_new(lmgr_config.db_config.stmt_cache_size);
+
+    if (register_functions(conn) != DB_SUCCESS)
+    {
+        db_close_conn(conn);
+        return DB_CONNECT_FAILED;
+    }
+
+    return DB_SUCCESS;
+}
+
+int db_close_conn(db_conn_t *conn)
+{
+    /* XXX Ensure there is no pending transactions? */
+    stmt_cache_free(conn->stmt_cache);
+    conn->stmt_cache = NULL;
+    if (conn->names_stmt != NULL)
+        sqlite3_finalize(conn->names_stmt);
+    conn->names_stmt = NULL;
+
+    if (sqlite3_close(conn->db) != SQLITE_OK)
+        DisplayLog(LVL_MAJOR, LISTMGR_TAG, "Failed to close database: %s",
+                   sqlite3_errmsg(conn->db));
+    conn->db = NULL;
+
+    DisplayLog( LVL_FULL, LISTMGR_TAG, "Database connection closed" );
 
     return DB_SUCCESS;
 }
 
 /* retrieve error message */
-char          *db_errmsg( db_conn_t * conn, char *errmsg, unsigned int buflen )
+char *db_errmsg(db_conn_t *conn, char *errmsg, unsigned int buflen)
 {
-    if ( *conn == NULL )
+    if (conn->db == NULL)
     {
-        strcpy( errmsg, "Connection not initialized" );
+        rh_strncpy(errmsg, "Connection not initialized", buflen);
         return errmsg;
     }
 
-    if ( strlen( sqlite3_errmsg( *conn ) ) + 1 > buflen )
-        rh_strncpy(errmsg, sqlite3_errmsg(*conn), buflen);
-    else
-        strcpy( errmsg, sqlite3_errmsg( *conn ) );
-
+    rh_strncpy(errmsg, sqlite3_errmsg(conn->db), buflen);
     return errmsg;
 }
 
-int db_exec_sql( db_conn_t * conn, const char *query, result_handle_t * p_result )
+/* ------------ requests ------------ */
+
+static int _db_exec_sql(db_conn_t *conn, const char *query,
+                        result_handle_t *p_result, bool quiet)
 {
-    int            rc;
-    char          *errmsg = NULL;
+    const char        *orig_query = query;
+    const char        *curr = query;
+    const char        *tail = NULL;
+    sqlite3_stmt      *stmt;
+    GString           *norm = NULL;
+    GString           *upsert = NULL;
+    struct sql_params  params = { NULL, NULL };
+    int                rc;
 
 #ifdef _DEBUG_DB
     DisplayLog( LVL_FULL, LISTMGR_TAG, "SQL query: %s", query );
 #endif
 
-    if ( !p_result )
-    {
-        do
-        {
-            rc = sqlite3_exec( *conn, query, NULL, NULL, &errmsg );
-
-            if ( db_is_busy_err( rc ) )
-                usleep( lmgr_config.db_config.retry_delay_microsec );
+    if (p_result)
+        memset(p_result, 0, sizeof(*p_result));
 
-        }
-        while ( db_is_busy_err( rc ) );
+    upsert = g_string_new(NULL);
+    if (sql_upsert_convert(query, upsert))
+        curr = orig_query = query = upsert->str;
 
-        if ( rc != SQLITE_OK )
-        {
-            DisplayLog(  LVL_DEBUG, LISTMGR_TAG,
-                        "SQLite command failed (%d): %s: %s", rc,
-                        errmsg ? errmsg : sqlite3_errmsg( *conn ), query );
-            if ( errmsg )
-                sqlite3_free( errmsg );
-            return sqlite_error_convert( rc );
-        }
-    }
-    else
+    /* bind literal values, so that the cached statement can be reused
+     * for the same query with other values */
+    if (conn->stmt_cache != NULL)
     {
-        p_result->curr_row = 0;
-        p_result->result_array = 0;
+        norm = g_string_new(NULL);
+        if (sql_parameterize(query,
+                             sqlite3_limit(conn->db,
+                                           SQLITE_LIMIT_VARIABLE_NUMBER, -1),
+                             norm, &params))
+            curr = query = norm->str;
+    }
 
-        do
+    /* a query may contain several statements: execute them in turn,
+     * the last one returns the results */
+    do
+    {
+        rc = stmt_get(conn, curr, &stmt, &tail);
+        if (rc != SQLITE_OK && params.params != NULL)
         {
-            rc = sqlite3_get_table( *conn, query, &p_result->result_array,
-                                    &p_result->nb_rows, &p_result->nb_cols, &errmsg );
+            /* failed to parse the parameterized form, run the
+             * original query */
+            sql_params_free(&params);
+            curr = query = orig_query;
+            continue;
+        }
+        if (rc != SQLITE_OK)
+            goto err;
 
-            if ( db_is_busy_err( rc ) )
-                usleep( lmgr_config.db_config.retry_delay_microsec );
+        /* empty statement (trailing spaces...) */
+        if (stmt == NULL)
+            break;
 
+        if (params.params != NULL)
+        {
+            rc = sql_params_bind(stmt, &params);
+            sql_params_free(&params);
+            if (rc != SQLITE_OK)
+            {
+                /* the statement has other parameters than the extracted
+                 * literals: run the original query */
+                stmt_release(conn, stmt, NULL);
+                curr = query = orig_query;
+                continue;
+            }
         }
-        while ( db_is_busy_err( rc ) );
 
+        rc = sqlite3_step(stmt);
 
-        if ( rc != SQLITE_OK )
+        if (p_result && is_last_stmt(tail))
         {
-            DisplayLog( LVL_DEBUG, LISTMGR_TAG,
-                        "SQLite command failed (%d): %s: %s", rc,
-                        errmsg ? errmsg : sqlite3_errmsg( *conn ), query );
-            if ( errmsg )
-                sqlite3_free( errmsg );
-            if ( p_result->result_array )
-                sqlite3_free_table( p_result->result_array );
-            return sqlite_error_convert( rc );
+            if (rc != SQLITE_ROW && rc != SQLITE_DONE)
+            {
+                stmt_release(conn, stmt, NULL);
+                goto err;
+            }
+            p_result->stmt = stmt;
+            p_result->step_rc = rc;
+            p_result->pending = (rc == SQLITE_ROW);
+            p_result->nb_cols = sqlite3_column_count(stmt);
+            goto out;
         }
-    }
 
+        /* ignore results */
+        while (rc == SQLITE_ROW)
+            rc = sqlite3_step(stmt);
+
+        stmt_release(conn, stmt, (curr == query && is_last_stmt(tail)) ?
+                                  query : NULL);
+        if (rc != SQLITE_DONE)
+            goto err;
+
+        curr = tail;
+    } while (!is_last_stmt(curr));
+
+out:
+    if (norm != NULL)
+        g_string_free(norm, TRUE);
+    g_string_free(upsert, TRUE);
     return DB_SUCCESS;
+
+err:
+    rc = sqlite_error_convert(conn, rc, !quiet);
+    if (rc == DB_ALREADY_EXISTS || rc == DB_NOT_EXISTS)
+        DisplayLog(quiet ? LVL_DEBUG : LVL_EVENT, LISTMGR_TAG,
+                   "SQLite command failed: %s: %s",
+                   sqlite3_errmsg(conn->db), orig_query);
+    else if (!db_is_retryable(rc))
+        DisplayLog(quiet ? LVL_DEBUG : LVL_MAJOR, LISTMGR_TAG,
+                   "Error %d executing query '%s': %s", rc, orig_query,
+                   sqlite3_errmsg(conn->db));
+    sql_params_free(&params);
+    if (norm != NULL)
+        g_string_free(norm, TRUE);
+    g_string_free(upsert, TRUE);
+    return rc;
+}
+
+int db_exec_sql(db_conn_t *conn, const char *query, result_handle_t *p_result)
+{
+    return _db_exec_sql(conn, query, p_result, false);
 }
 
-int db_exec_sql_quiet( db_conn_t * conn, const char *query, result_handle_t * p_result )
+int db_exec_sql_quiet(db_conn_t *conn, const char *query,
+                      result_handle_t *p_result)
 {
-    return db_exec_sql( conn, query, p_result);
+    return _db_exec_sql(conn, query, p_result, true);
 }
 
-/* get the next record from result */
-int db_next_record( db_conn_t * conn,
-                    result_handle_t * p_result, char *outtab[], unsigned int outtabsize )
+/* get the next record from result.
+ * Returned strings are valid until the next call. */
+int db_next_record(db_conn_t *conn, result_handle_t *p_result,
+                   char *outtab[], unsigned int outtabsize)
 {
     int            i;
 
-    if ( p_result->curr_row >= p_result->nb_rows )
-        return DB_END_OF_LIST;
+    /* init ouput tab */
+    for (i = 0; i < outtabsize; i++)
+        outtab[i] = NULL;
 
-    if ( p_result->nb_cols > outtabsize )
+    if (p_result->nb_cols > outtabsize)
+    {
+        DisplayLog(LVL_CRIT, LISTMGR_TAG,
+                   "Output array too small: size = %u, num_fields = %u",
+                   outtabsize, p_result->nb_cols);
         return DB_BUFFER_TOO_SMALL;
+    }
+
+    /* rows copied by db_result_nb_records() */
+    if (p_result->result_array != NULL)
+    {
+        if (p_result->curr_row >= p_result->nb_rows)
+            return DB_END_OF_LIST;
+
+        for (i = 0; i < p_result->nb_cols; i++)
+            outtab[i] = p_result->result_array[p_result->curr_row
+                                               * p_result->nb_cols + i];
+        p_result->curr_row++;
+        return DB_SUCCESS;
+    }
+
+    if (p_result->stmt == NULL)
+        return DB_END_OF_LIST;
 
-    for ( i = 0; i < p_result->nb_cols; i++ )
+    if (!p_result->pending)
     {
-        /* /!\ in sqlite, the request retuns columns header as row 0 !!! */
-        outtab[i] = p_result->result_array[( p_result->curr_row + 1 ) * p_result->nb_cols + i];
+        if (p_result->step_rc != SQLITE_ROW)
+            return DB_END_OF_LIST;
+
+        p_result->step_rc = sqlite3_step(p_result->stmt);
+        if (p_result->step_rc == SQLITE_DONE)
+            return DB_END_OF_LIST;
+        if (p_result->step_rc != SQLITE_ROW)
+        {
+            DisplayLog(LVL_MAJOR, LISTMGR_TAG, "Error %d reading results: %s",
+                       p_result->step_rc, sqlite3_errmsg(conn->db));
+            return sqlite_error_convert(conn, p_result->step_rc, true);
+        }
     }
-    p_result->curr_row++;
+    p_result->pending = false;
+
+    for (i = 0; i < p_result->nb_cols; i++)
+        outtab[i] = (char *)sqlite3_column_text(p_result->stmt, i);
 
     return DB_SUCCESS;
 }
 
-
-int db_result_free( db_conn_t * conn, result_handle_t * p_result )
+int db_result_free(db_conn_t *conn, result_handle_t *p_result)
 {
-    if ( p_result->result_array )
-        sqlite3_free_table( p_result->result_array );
-    memset( p_result, 0, sizeof( result_handle_t ) );
+    if (p_result->result_array)
+    {
+        int i;
+
+        for (i = 0; i < p_result->nb_rows * p_result->nb_cols; i++)
+            free(p_result->result_array[i]);
+        free(p_result->result_array);
+    }
+
+    if (p_result->stmt)
+        stmt_release(conn, p_result->stmt, sqlite3_sql(p_result->stmt));
+
+    memset(p_result, 0, sizeof(result_handle_t));
 
     return DB_SUCCESS;
 }
 
+/* retrieve number of records in result.
+ * Remaining rows have to be read, so they are copied to memory. */
+int db_result_nb_records(db_conn_t *conn, result_handle_t *p_result)
+{
+    GPtrArray *rows;
+    int        i;
 
+    if (p_result->result_array != NULL)
+        return p_result->nb_rows;
+    if (p_result->stmt == NULL)
+        return 0;
 
+    rows = g_ptr_array_new();
+
+    while (p_result->pending || p_result->step_rc == SQLITE_ROW)
+    {
+        if (!p_result->pending)
+        {
+            p_result->step_rc = sqlite3_step(p_result->stmt);
+            if (p_result->step_rc != SQLITE_ROW)
+                break;
+        }
+        p_result->pending = false;
+
+        for (i = 0; i < p_result->nb_cols; i++)
+        {
+            const char *val = (const char *)sqlite3_column_text(p_result->stmt, i);
+
+            g_ptr_array_add(rows, val ? strdup(val) : NULL);
+        }
+    }
+
+    if (p_result->step_rc != SQLITE_ROW && p_result->step_rc != SQLITE_DONE)
+        DisplayLog(LVL_MAJOR, LISTMGR_TAG, "Error %d reading results: %s",
+                   p_result->step_rc, sqlite3_errmsg(conn->db));
+
+    stmt_release(conn, p_result->stmt, sqlite3_sql(p_result->stmt));
+    p_result->stmt = NULL;
+
+    p_result->nb_rows = p_result->nb_cols ? rows->len / p_result->nb_cols : 0;
+    p_result->curr_row = 0;
+    /* keep a non-NULL array, even if empty */
+    g_ptr_array_add(rows, NULL);
+    p_result->result_array = (char **)g_ptr_array_free(rows, FALSE);
 
-/* retrieve number of records in result */
-int db_result_nb_records( db_conn_t * conn, result_handle_t * p_result )
-{
     return p_result->nb_rows;
 }
 
-int db_close_conn( db_conn_t * conn )
+int db_list_table_info(db_conn_t *conn, const char *table,
+                       char **field_tab, char **type_tab, char **default_tab,
+                       unsigned int outtabsize,
+                       char *inbuffer, unsigned int inbuffersize)
 {
-    /* XXX Ensure there is no pending transactions? */
-    sqlite3_close( *conn );
+    char            request[4096];
+    result_handle_t result;
+    char           *row[6];
+    int             i, rc, curr_output;
+    char           *curr_ptr = inbuffer;
+
+    snprintf(request, sizeof(request), "PRAGMA table_info(%s)", table);
+    rc = db_exec_sql_quiet(conn, request, &result);
+    if (rc)
+        return rc;
+
+    /* init ouput tabs */
+    for (i = 0; i < outtabsize; i++) {
+        field_tab[i] = NULL;
+        if (type_tab)
+            type_tab[i] = NULL;
+        if (default_tab)
+            default_tab[i] = NULL;
+    }
+
+    /* columns: cid, name, type, notnull, dflt_value, pk */
+    curr_output = 0;
+    while (curr_output < outtabsize
+           && db_next_record(conn, &result, row, 6) == DB_SUCCESS)
+    {
+        strcpy(curr_ptr, row[1]);
+        field_tab[curr_output] = curr_ptr;
+        curr_ptr += strlen(curr_ptr) + 1;
+
+        if (type_tab)
+        {
+            strcpy(curr_ptr, row[2] ? row[2] : "");
+            type_tab[curr_output] = curr_ptr;
+            curr_ptr += strlen(curr_ptr) + 1;
+        }
+
+        if (default_tab && row[4] != NULL)
+        {
+            strcpy(curr_ptr, row[4]);
+            default_tab[curr_output] = curr_ptr;
+            curr_ptr += strlen(curr_ptr) + 1;
+        }
+
+        curr_output++;
+    }
+    db_result_free(conn, &result);
+
+    if (curr_output == 0)
+    {
+        DisplayLog(LVL_DEBUG, LISTMGR_TAG, "%s does not exist", table);
+        return DB_NOT_EXISTS;
+    }
+
     return DB_SUCCESS;
 }
 
+unsigned long long db_last_id(db_conn_t *conn)
+{
+    return sqlite3_last_insert_rowid(conn->db);
+}
 
-int db_list_table_fields( db_conn_t * conn, const char *table,
-                          char **outtab,
-                          unsigned int outtabsize, char *inbuffer, unsigned int inbuffersize )
+unsigned long long db_affected_rows(db_conn_t *conn)
 {
-    char           request[4096];
-    char         **result = NULL;
-    int            rows, cols;
-    char          *errmsg = NULL;
-    int            i, rc, curr_output;
-    char          *curr_ptr = inbuffer;
+    return sqlite3_changes(conn->db);
+}
 
-    sprintf( request, "PRAGMA table_info(%s)", table );
+/* escape a string in a SQL request */
+int db_escape_string(db_conn_t *conn, char *str_out, size_t out_size,
+                     const char *str_in)
+{
+    /* output size must be at least 2 x instrlen + 1 for the worst case */
+    if (out_size < 2 * strlen(str_in) + 1)
+        return DB_BUFFER_TOO_SMALL;
+
+    /* using slqite3_snprintf with "%q" format, to escape strings */
+    sqlite3_snprintf(out_size, str_out, "%q", str_in);
+    return DB_SUCCESS;
+}
 
-    rc = sqlite3_get_table( *conn, request, &result, &rows, &cols, &errmsg );
+/* remove a database component (table, trigger, index) */
+int db_drop_component(db_conn_t *conn, db_object_e obj_type, const char *name)
+{
+    char query[1024];
 
-    if ( rc != SQLITE_OK )
-    {
-        DisplayLog( LVL_DEBUG, LISTMGR_TAG, "SQLite command failed (%d):  "
-                    "%s: %s", rc, errmsg ? errmsg : sqlite3_errmsg( *conn ),
-                    request );
-        if ( errmsg )
-            sqlite3_free( errmsg );
-        if ( result )
-            sqlite3_free_table( result );
-        return sqlite_error_convert( rc );
-    }
-    else if ( rows == 0 )
+    switch (obj_type)
     {
-        if ( errmsg )
-            sqlite3_free( errmsg );
-        if ( result )
-            sqlite3_free_table( result );
-        return DB_NOT_EXISTS;
+        case DBOBJ_TABLE:
+        case DBOBJ_TRIGGER:
+        case DBOBJ_INDEX:
+            break;
+        default:
+            /* no stored functions or procedures in SQLite */
+            DisplayLog(LVL_CRIT, LISTMGR_TAG, "Object type not supported in %s",
+                       __func__);
+            return DB_NOT_SUPPORTED;
     }
 
-    /* init ouput tab */
-    for ( i = 0; i < outtabsize; i++ )
-        outtab[i] = NULL;
+    snprintf(query, sizeof(query), "DROP %s IF EXISTS %s", dbobj2str(obj_type),
+             name);
+    return _db_exec_sql(conn, query, NULL, false);
+}
 
-    curr_output = 0;
+/**
+ * check a component exists in the database
+ * \param arg depends on the object type: src table for triggers, NULL for others.
+ */
+int db_check_component(db_conn_t *conn, db_object_e obj_type, const char *name,
+                       const char *arg)
+{
+    char            query[1024];
+    result_handle_t result;
+    char           *row[1];
+    int             rc;
 
-    /* starting at 1 because first raw contains headers */
-    for ( i = 1; i < rows + 1; i++ )
+    switch (obj_type)
     {
-        strcpy( curr_ptr, result[1 + i * cols] );
-        outtab[curr_output] = curr_ptr;
-        curr_ptr += strlen( curr_ptr ) + 1;
-        curr_output++;
+        case DBOBJ_TABLE:
+        case DBOBJ_TRIGGER:
+        case DBOBJ_INDEX:
+            break;
+        default:
+            return DB_NOT_SUPPORTED;
     }
 
-    sqlite3_free_table( result );
+    snprintf(query, sizeof(query), "SELECT tbl_name FROM sqlite_master "
+             "WHERE type='%s' AND name='%s'",
+             obj_type == DBOBJ_TABLE ? "table" :
+                (obj_type == DBOBJ_TRIGGER ? "trigger" : "index"), name);
 
-    return DB_SUCCESS;
+    rc = _db_exec_sql(conn, query, &result, false);
+    if (rc)
+        return rc;
 
+    if (db_next_record(conn, &result, row, 1) != DB_SUCCESS)
+    {
+        DisplayLog(LVL_DEBUG, LISTMGR_TAG, "%s does not exist", name);
+        rc = DB_NOT_EXISTS;
+    }
+    else if (arg != NULL && (row[0] == NULL || strcmp(arg, row[0])))
+    {
+        DisplayLog(LVL_CRIT, LISTMGR_TAG, "%s %s is on wrong table: expected %s, got %s",
+                   dbobj2str(obj_type), name, arg, row[0] ? row[0] : "<null>");
+        rc = DB_BAD_SCHEMA;
+    }
+    else
+        rc = DB_SUCCESS;
+
+    db_result_free(conn, &result);
+    return rc;
 }
 
-unsigned long long db_last_id( db_conn_t * conn )
+/* create a trigger */
+int db_create_trigger(db_conn_t *conn, const char *name, const char *event,
+                      const char *table, const char *body)
 {
-    return sqlite3_last_insert_rowid( *conn );;
+    int rc;
+    GString *request = g_string_new("CREATE TRIGGER ");
+
+    g_string_append_printf(request, "%s %s ON %s FOR EACH ROW "
+                           "BEGIN %s END", name, event, table, body);
+    rc = _db_exec_sql(conn, request->str, NULL, false);
+    g_string_free(request, TRUE);
+    return rc;
 }
 
-/* escape a string in a SQL request */
-void db_escape_string( db_conn_t * conn, char * str_out, size_t out_size, const char * str_in )
+/** set transaction level (optimize performance or locking).
+ * SQLite transactions are always serializable: nothing to do. */
+int db_transaction_level(db_conn_t *conn, what_trans_e what_tx,
+                         tx_level_e tx_level)
 {
-    /* using slqite3_snprintf with "%q" format, to escape strings */
-    sqlite3_snprintf( out_size, str_out, str_in );
+    return DB_SUCCESS;
 }
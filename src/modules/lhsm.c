@@ -114,21 +114,20 @@ static int lhsm_init(struct sm_instance *smi, run_flags_t flags)
     return init_action_global_info();
 }
 
-/** Trigger an HSM action */
-static int lhsm_action(enum hsm_user_action action, const entry_id_t *p_id,
-                       const attr_set_t *attrs, const action_params_t *params)
+/**
+ * Determine the archive_id to be used for an HSM action.
+ * @return archive_id on success, a negative value on error.
+ */
+static int lhsm_action_archive_id(enum hsm_user_action action,
+                                  const attr_set_t *attrs,
+                                  const action_params_t *params)
 {
-    struct hsm_user_request * req;
     int rc;
-    char *mpath;
-    unsigned int    archive_id = DEFAULT_ARCHIVE_ID; /* default */
-    GString        *args = NULL;
-    const char     *data = NULL;
-    int             data_len = 0;
+    unsigned int archive_id = DEFAULT_ARCHIVE_ID; /* default */
 
     /* if archive_id is explicitely specified in action parameters, use it */
     rc = get_archive_id(params);
-    if (rc == 0)
+    if (rc >= 0)
     {
         archive_id = rc;
     }
@@ -156,9 +155,25 @@ static int lhsm_action(enum hsm_user_action action, const entry_id_t *p_id,
         }
         /* all other cases: keep default */
     }
-    else if (rc < 0)
+    else
         return rc;
 
+    return archive_id;
+}
+
+/** Send an HSM request for a list of entries */
+static int lhsm_request(enum hsm_user_action action, unsigned int archive_id,
+                        const entry_id_t **ids, unsigned int count,
+                        const action_params_t *params)
+{
+    struct hsm_user_request * req;
+    int rc;
+    char *mpath;
+    unsigned int    i;
+    GString        *args = NULL;
+    const char     *data = NULL;
+    int             data_len = 0;
+
     /* Serialize the parameters to pass them to the copytool.
      * exclude archive_id, which is for internal use. */
     args = g_string_new("");
@@ -173,10 +188,15 @@ static int lhsm_action(enum hsm_user_action action, const entry_id_t *p_id,
         data_len = args->len + 1;
     }
 
-    DisplayLog(LVL_DEBUG, LHSM_TAG, "action %s, fid="DFID", archive_id=%u, parameters='%s'",
-               hsm_user_action2name(action), PFID(p_id), archive_id, args->str);
+    if (count == 1)
+        DisplayLog(LVL_DEBUG, LHSM_TAG, "action %s, fid="DFID", archive_id=%u, parameters='%s'",
+                   hsm_user_action2name(action), PFID(ids[0]), archive_id, args->str);
+    else
+        DisplayLog(LVL_DEBUG, LHSM_TAG, "action %s, %u entries (first fid="DFID"), "
+                   "archive_id=%u, parameters='%s'", hsm_user_action2name(action),
+                   count, PFID(ids[0]), archive_id, args->str);
 
-    req = llapi_hsm_user_request_alloc(1, data_len);
+    req = llapi_hsm_user_request_alloc(count, data_len);
     if (!req)
     {
         rc = -errno;
@@ -189,12 +209,15 @@ static int lhsm_action(enum hsm_user_action action, const entry_id_t *p_id,
     req->hur_request.hr_archive_id = archive_id;
     req->hur_request.hr_flags = 0;
 
-    req->hur_user_item[0].hui_fid = *p_id;
-    req->hur_user_item[0].hui_extent.offset = 0 ;
-    /* XXX for now, always transfer entire file */
-    req->hur_user_item[0].hui_extent.length = -1LL;
+    for (i = 0; i < count; i++)
+    {
+        req->hur_user_item[i].hui_fid = *ids[i];
+        req->hur_user_item[i].hui_extent.offset = 0 ;
+        /* XXX for now, always transfer entire file */
+        req->hur_user_item[i].hui_extent.length = -1LL;
+    }
 
-    req->hur_request.hr_itemcount = 1;
+    req->hur_request.hr_itemcount = count;
     req->hur_request.hr_data_len = data_len;
 
     if (data)
@@ -208,14 +231,28 @@ static int lhsm_action(enum hsm_user_action action, const entry_id_t *p_id,
 
     if (rc)
         DisplayLog(LVL_CRIT, LHSM_TAG,
-                   "ERROR performing HSM request(%s, root=%s, fid="DFID"): %s",
+                   "ERROR performing HSM request(%s, root=%s, fid="DFID"%s): %s",
                    hsm_user_action2name(action),
-                   get_mount_point(NULL), PFID(p_id), strerror(-rc));
+                   get_mount_point(NULL), PFID(ids[0]),
+                   count > 1 ? ", ..." : "", strerror(-rc));
 free_args:
     g_string_free(args, TRUE);
     return rc;
 }
 
+/** Trigger an HSM action */
+static int lhsm_action(enum hsm_user_action action, const entry_id_t *p_id,
+                       const attr_set_t *attrs, const action_params_t *params)
+{
+    int archive_id;
+
+    archive_id = lhsm_action_archive_id(action, attrs, params);
+    if (archive_id < 0)
+        return archive_id;
+
+    return lhsm_request(action, archive_id, &p_id, 1, params);
+}
+
 /** perform hsm_release action */
 static int lhsm_release(const entry_id_t *p_entry_id, attr_set_t *p_attrs,
                         const action_params_t *params, post_action_e *after,
@@ -244,6 +281,86 @@ static int lhsm_remove(const entry_id_t *p_entry_id, attr_set_t *p_attrs,
     return rc;
 }
 
+/** get the HSM action that matches a policy action (HUA_NONE if none) */
+static enum hsm_user_action lhsm_policy_action2hua(const policy_action_t *action)
+{
+    if (action == NULL || action->type != ACTION_FUNCTION)
+        return HUA_NONE;
+
+    if (action->action_u.func.call == lhsm_archive)
+        return HUA_ARCHIVE;
+    else if (action->action_u.func.call == lhsm_release)
+        return HUA_RELEASE;
+    else if (action->action_u.func.call == lhsm_remove)
+        return HUA_REMOVE;
+
+    return HUA_NONE;
+}
+
+/** check if the given action can be run in batches */
+static bool lhsm_batch_check(const char *implements,
+                             const policy_action_t *action)
+{
+    return lhsm_policy_action2hua(action) != HUA_NONE;
+}
+
+/**
+ * Send a single HSM request for a batch of entries.
+ * Entries are split in several requests if their archive_id differ.
+ */
+static int lhsm_batch_executor(struct sm_instance *smi,
+                               const char *implements,
+                               const policy_action_t *action,
+                               const action_params_t *params,
+                               unsigned int count,
+                               const entry_id_t **ids, attr_set_t **attrs,
+                               int *rcs, post_action_e *what_after)
+{
+    enum hsm_user_action hua = lhsm_policy_action2hua(action);
+    int          *arch_ids;
+    unsigned int  i, first;
+
+    if (hua == HUA_NONE)
+        return -ENOTSUP;
+
+    arch_ids = calloc(count, sizeof(*arch_ids));
+    if (arch_ids == NULL)
+        return -ENOMEM;
+
+    for (i = 0; i < count; i++)
+        arch_ids[i] = lhsm_action_archive_id(hua, attrs[i], params);
+
+    /* send one request for each range of entries with the same archive_id */
+    first = 0;
+    while (first < count)
+    {
+        unsigned int last = first + 1;
+        int          rc;
+
+        if (arch_ids[first] < 0)
+        {
+            rcs[first] = arch_ids[first];
+            first++;
+            continue;
+        }
+
+        while (last < count && arch_ids[last] == arch_ids[first])
+            last++;
+
+        rc = lhsm_request(hua, arch_ids[first], &ids[first], last - first,
+                          params);
+        /* a HSM request is atomic: same status for all items */
+        for (i = first; i < last; i++)
+            rcs[i] = rc;
+
+        first = last;
+    }
+
+    /* 'what_after' is set in action callback */
+    free(arch_ids);
+    return 0;
+}
+
 /** set of managed status */
 typedef enum {
   STATUS_NEW,                   /* file has no HSM flags (just created) */
@@ -1119,6 +1236,10 @@ static status_manager_t lhsm_sm = {
     .check_action_name = lhsm_check_action_name,
     .action_cb = lhsm_action_callback,
 
+    /* HSM requests can carry multiple entries */
+    .batch_check = lhsm_batch_check,
+    .batch_executor = lhsm_batch_executor,
+
     /* fields for managing deleted entries */
     .softrm_filter_mask = {.std = ATTR_MASK_type, .status = SMI_MASK(0)},
     .softrm_filter_func = lhsm_softrm_filter,
@@ -25,9 +25,11 @@
 #include "xplatform_print.h"
 #include "update_params.h"
 #include "status_manager.h"
+#include "rbh_events.h"
 
 #include <sys/types.h>
 #include <sys/stat.h>
+#include <sys/time.h>
 #include <unistd.h>
 #include <errno.h>
 #include <pthread.h>
@@ -39,6 +41,7 @@
 #define aborted(_p)         ((_p)->aborted)
 #define no_limit(_p)        ((_p)->flags & RUNFLG_NO_LIMIT)
 #define force_run(_p)       ((_p)->flags & RUNFLG_FORCE_RUN)
+#define simulate(_p)        ((_p)->flags & RUNFLG_SIMULATE)
 #define tag(_p)             ((_p)->descr->name)
 
 #define TAG "PolicyRun"
@@ -48,6 +51,11 @@ typedef struct queue_item__
     entry_id_t     entry_id;
     attr_set_t     entry_attr;
     unsigned long  targeted;
+
+    /* result of check_entry(), if it was prefetched */
+    bool           checked;
+    int            check_rc;
+    attr_set_t     check_attr;
 } queue_item_t;
 
 /**
@@ -66,6 +74,9 @@ static queue_item_t *entry2queue_item(entry_id_t *p_entry_id,
     new_entry->entry_id = *p_entry_id;
     new_entry->entry_attr = *p_attr_set;
     new_entry->targeted = targeted;
+    new_entry->checked = false;
+    new_entry->check_rc = 0;
+    new_entry->check_attr = (attr_set_t)ATTR_SET_INIT;
 
     return new_entry;
 }
@@ -76,6 +87,7 @@ static queue_item_t *entry2queue_item(entry_id_t *p_entry_id,
 static void free_queue_item(queue_item_t *item)
 {
     ListMgr_FreeAttrs(&item->entry_attr);
+    ListMgr_FreeAttrs(&item->check_attr);
     MemFree(item);
 }
 
@@ -236,24 +248,24 @@ err:
     return rc;
 }
 
-/** Execute a policy action. */
-static int policy_action(policy_info_t *policy,
-                         const rule_item_t *rule, const fileset_item_t *fileset,
-                         const entry_id_t *id, attr_set_t *p_attr_set,
-                         const action_params_t *params, post_action_e *after)
+/** Get the action to be run for the given policy rule */
+static inline const policy_action_t *get_policy_action(const policy_info_t *policy,
+                                                       const rule_item_t *rule)
 {
-    int rc = 0;
-    sm_instance_t *smi = policy->descr->status_mgr;
-    const policy_action_t *actionp = NULL;
-
     /* Get the action from policy rule, if defined.
      * Else, get the default action for the policy. */
     if (rule != NULL && rule->action.type != ACTION_UNSET)
-        actionp = &rule->action;
+        return &rule->action;
     else
         /* defaults to default_action from */
-        actionp = &policy->config->action;
+        return &policy->config->action;
+}
 
+/** Log the execution of a policy action */
+static void log_policy_action(const policy_info_t *policy, const entry_id_t *id,
+                              const attr_set_t *p_attr_set,
+                              const action_params_t *params)
+{
     /* log as DEBUG level if 'report_actions' is disabled */
     DisplayLog(policy->config->report_actions ? LVL_EVENT : LVL_DEBUG,
                tag(policy),
@@ -263,12 +275,24 @@ static int policy_action(policy_info_t *policy,
     if (log_config.debug_level >= LVL_DEBUG)
     {
         GString *str = g_string_new("");
-        rc = rbh_params_serialize(params, str, NULL, RBH_PARAM_CSV);
-        if (rc == 0)
+        if (rbh_params_serialize(params, str, NULL, RBH_PARAM_CSV) == 0)
             DisplayLog(LVL_DEBUG, tag(policy), DFID": action_params: %s",
                        PFID(id), str->str);
         g_string_free(str, TRUE);
     }
+}
+
+/** Execute a policy action. */
+static int policy_action(policy_info_t *policy,
+                         const rule_item_t *rule, const fileset_item_t *fileset,
+                         const entry_id_t *id, attr_set_t *p_attr_set,
+                         const action_params_t *params, post_action_e *after)
+{
+    int rc = 0;
+    sm_instance_t *smi = policy->descr->status_mgr;
+    const policy_action_t *actionp = get_policy_action(policy, rule);
+
+    log_policy_action(policy, id, p_attr_set, params);
 
     if (dry_run(policy))
         return 0;
@@ -354,32 +378,7 @@ static int policy_action(policy_info_t *policy,
  */
 static inline int get_sort_attr(policy_info_t *p, const attr_set_t *p_attrs)
 {
-    if (p->config->lru_sort_attr == LRU_ATTR_NONE)
-        return -1;
-
-    if (!attr_mask_test_index(&p_attrs->attr_mask, p->config->lru_sort_attr))
-        return -1;
-
-    if (is_sm_info(p->config->lru_sort_attr))
-    {
-        unsigned int idx = attr2sminfo_index(p->config->lru_sort_attr);
-
-        return *((unsigned int *)p_attrs->attr_values.sm_info[idx]);
-    }
-
-    switch(p->config->lru_sort_attr)
-    {
-        case ATTR_INDEX_creation_time:
-            return ATTR(p_attrs, creation_time);
-        case ATTR_INDEX_last_mod:
-            return ATTR(p_attrs, last_mod);
-        case ATTR_INDEX_last_access:
-            return ATTR(p_attrs, last_access);
-        case ATTR_INDEX_rm_time:
-            return ATTR(p_attrs, rm_time);
-        default:
-            return -1;
-    }
+    return sort_attr_value(p->config->lru_sort_attr, p_attrs);
 }
 
 /** set dummy time attributes, to check 'end of list' criteria */
@@ -879,6 +878,261 @@ static int set_optimization_filters(policy_info_t *policy,
     return 0;
 }
 
+/* ---- throttling of policy actions ---- */
+
+/** max burst of a rate limiter, in seconds of its rate */
+#define RATE_BURST_SEC      1
+/** min interval between 2 adjustments of the number of running actions */
+#define ADMIT_ADJUST_SEC    1
+
+static void rate_limiter_init(rate_limiter_t *rl)
+{
+    pthread_mutex_init(&rl->lock, NULL);
+    rl->tokens = 0.0;
+    gettimeofday(&rl->last, NULL);
+    rl->total = 0;
+}
+
+static void throttle_init(policy_info_t *pol)
+{
+    policy_throttle_t *t = &pol->throttle;
+
+    rate_limiter_init(&t->actions);
+    rate_limiter_init(&t->bytes);
+    rate_limiter_init(&t->db_ops);
+
+    pthread_mutex_init(&t->lock, NULL);
+    pthread_cond_init(&t->cond, NULL);
+    t->running = 0;
+    t->admit_max = pol->config->nb_threads;
+    t->latency = 0.0;
+    t->last_adjust = 0;
+}
+
+/** reset the accounting of rate limiters at the beginning of a policy run */
+static void throttle_reset(policy_info_t *pol)
+{
+    rate_limiter_t *rls[] = { &pol->throttle.actions, &pol->throttle.bytes,
+                              &pol->throttle.db_ops };
+    unsigned int i;
+
+    for (i = 0; i < sizeof(rls)/sizeof(rls[0]); i++)
+    {
+        pthread_mutex_lock(&rls[i]->lock);
+        rls[i]->total = 0;
+        pthread_mutex_unlock(&rls[i]->lock);
+    }
+}
+
+/**
+ * Take 'amount' tokens from a token bucket refilled at 'rate' per second.
+ * The bucket can get into debt: the caller then waits until the debt
+ * is paid back, so large amounts (e.g. big files) are accounted
+ * without blocking forever.
+ * If rate is 0, the amount is only accounted.
+ */
+static void rate_take(policy_info_t *pol, rate_limiter_t *rl, double rate,
+                      double amount)
+{
+    struct timeval now, diff;
+    double         wait_sec = 0.0;
+
+    pthread_mutex_lock(&rl->lock);
+    rl->total += amount;
+
+    gettimeofday(&now, NULL);
+    if (rate > 0.0)
+    {
+        timersub(&now, &rl->last, &diff);
+        rl->tokens += rate * (diff.tv_sec + diff.tv_usec / 1000000.0);
+        if (rl->tokens > rate * RATE_BURST_SEC)
+            rl->tokens = rate * RATE_BURST_SEC;
+
+        rl->tokens -= amount;
+        if (rl->tokens < 0.0)
+            wait_sec = -rl->tokens / rate;
+    }
+    rl->last = now;
+    pthread_mutex_unlock(&rl->lock);
+
+    /* wait by steps of 1 sec to take abort requests into account */
+    while (wait_sec > 0.0 && !aborted(pol))
+    {
+        if (wait_sec >= 1.0)
+        {
+            rh_sleep(1);
+            wait_sec -= 1.0;
+        }
+        else
+        {
+            rh_usleep(wait_sec * 1000000);
+            break;
+        }
+    }
+}
+
+/** give back tokens taken for an action that was not run */
+static void rate_refund(rate_limiter_t *rl, double rate, double amount)
+{
+    pthread_mutex_lock(&rl->lock);
+    rl->total -= amount;
+    if (rate > 0.0)
+        rl->tokens += amount;
+    pthread_mutex_unlock(&rl->lock);
+}
+
+/** total number of DB operations of a connection */
+static inline ull_t lmgr_op_count(const lmgr_t *lmgr)
+{
+    ull_t total = 0;
+    int i;
+
+    for (i = 0; i < OPCOUNT; i++)
+        total += lmgr->nbop[i];
+    return total;
+}
+
+/**
+ * Account the DB operations done by a thread since its previous call,
+ * and wait if they exceed max_db_op_rate.
+ */
+static void throttle_db_ops(policy_info_t *pol, const lmgr_t *lmgr,
+                            ull_t *last_count)
+{
+    ull_t count = lmgr_op_count(lmgr);
+
+    if (count > *last_count)
+        rate_take(pol, &pol->throttle.db_ops, pol->config->max_db_op_rate,
+                  count - *last_count);
+    *last_count = count;
+}
+
+/** wait until an action of 'count' entries of 'vol' bytes can be run */
+static void throttle_action_start(policy_info_t *pol, unsigned int count,
+                                  ull_t vol)
+{
+    policy_throttle_t *t = &pol->throttle;
+
+    rate_take(pol, &t->actions, pol->config->max_action_rate, count);
+    rate_take(pol, &t->bytes, pol->config->max_bandwidth, vol);
+
+    if (pol->config->target_action_latency <= 0.0)
+        return;
+
+    pthread_mutex_lock(&t->lock);
+    while (t->running >= t->admit_max && !aborted(pol))
+        pthread_cond_wait(&t->cond, &t->lock);
+    t->running++;
+    pthread_mutex_unlock(&t->lock);
+}
+
+/** cancel the accounting of an action that was not run */
+static void throttle_action_cancel(policy_info_t *pol, unsigned int count,
+                                   ull_t vol)
+{
+    rate_refund(&pol->throttle.actions, pol->config->max_action_rate, count);
+    rate_refund(&pol->throttle.bytes, pol->config->max_bandwidth, vol);
+}
+
+/**
+ * Update the average action latency and adapt the number
+ * of actions that can run at once.
+ */
+static void throttle_action_end(policy_info_t *pol,
+                                const struct timeval *action_start)
+{
+    policy_throttle_t *t = &pol->throttle;
+    double             target = pol->config->target_action_latency;
+    struct timeval     now, diff;
+    double             lat;
+
+    if (target <= 0.0)
+        return;
+
+    gettimeofday(&now, NULL);
+    timersub(&now, action_start, &diff);
+    lat = diff.tv_sec + diff.tv_usec / 1000000.0;
+
+    pthread_mutex_lock(&t->lock);
+    if (t->running > 0)
+        t->running--;
+
+    if (t->latency == 0.0)
+        t->latency = lat;
+    else
+        t->latency = 0.8 * t->latency + 0.2 * lat;
+
+    if (now.tv_sec - t->last_adjust >= ADMIT_ADJUST_SEC)
+    {
+        unsigned int old = t->admit_max;
+
+        if (t->latency > target && t->admit_max > 1)
+        {
+            unsigned int dec = t->admit_max / 4;
+
+            t->admit_max -= (dec > 0 ? dec : 1);
+        }
+        else if (t->latency < 0.8 * target
+                 && t->admit_max < pol->config->nb_threads)
+            t->admit_max++;
+
+        if (t->admit_max != old)
+            DisplayLog(LVL_DEBUG, tag(pol), "Average action latency: %.3fs "
+                       "(target: %.3fs): running actions %u -> %u",
+                       t->latency, target, old, t->admit_max);
+        t->last_adjust = now.tv_sec;
+    }
+    pthread_cond_broadcast(&t->cond);
+    pthread_mutex_unlock(&t->lock);
+}
+
+/** report achieved and configured rates of the current policy run */
+static void report_throttling(policy_info_t *pol, log_level level,
+                              unsigned int spent)
+{
+    policy_throttle_t *t = &pol->throttle;
+    char               buf[128];
+    char               bw[128];
+    char               lim[3][128];
+
+    if (spent == 0)
+        return;
+
+    if (pol->config->max_action_rate > 0.0)
+        snprintf(lim[0], sizeof(lim[0]), "%.2f/sec",
+                 pol->config->max_action_rate);
+    else
+        rh_strncpy(lim[0], "unlimited", sizeof(lim[0]));
+
+    if (pol->config->max_bandwidth > 0)
+    {
+        FormatFileSize(buf, sizeof(buf), pol->config->max_bandwidth);
+        snprintf(lim[1], sizeof(lim[1]), "%s/sec", buf);
+    }
+    else
+        rh_strncpy(lim[1], "unlimited", sizeof(lim[1]));
+
+    if (pol->config->max_db_op_rate > 0.0)
+        snprintf(lim[2], sizeof(lim[2]), "%.2f/sec",
+                 pol->config->max_db_op_rate);
+    else
+        rh_strncpy(lim[2], "unlimited", sizeof(lim[2]));
+
+    FormatFileSize(buf, sizeof(buf), t->bytes.total / spent);
+    snprintf(bw, sizeof(bw), "%s/sec", buf);
+
+    DisplayLog(level, tag(pol), "Action rate: %.2f/sec (limit: %s); "
+               "bandwidth: %s (limit: %s); DB operations: %.2f/sec (limit: %s)",
+               (double)t->actions.total / spent, lim[0], bw, lim[1],
+               (double)t->db_ops.total / spent, lim[2]);
+
+    if (pol->config->target_action_latency > 0.0)
+        DisplayLog(level, tag(pol), "Running actions: %u/%u; "
+                   "average latency: %.3fs (target: %.3fs)",
+                   t->running, t->admit_max, t->latency,
+                   pol->config->target_action_latency);
+}
+
 /**
  * report the current policy run progress at regular interval.
  */
@@ -919,6 +1173,7 @@ static void report_progress(policy_info_t *policy,
                    "skipped: %u; errors: %u",
                    buf1, curr_ctr.count, (float)curr_ctr.count/(float)spent,
                    buf2, buf3, nb_skipped, nb_errors);
+        report_throttling(policy, LVL_EVENT, spent);
         policy->progress.last_report = time(NULL);
     }
 }
@@ -1269,13 +1524,14 @@ static void update_pass_stats(policy_info_t *pol,
 
 /* these types allow generic iteration on std entries or removed entries */
 
-typedef enum {IT_LIST, IT_RMD} it_type_e;
+typedef enum {IT_LIST, IT_RMD, IT_SHARED} it_type_e;
 
 struct policy_iter {
     it_type_e it_type;
     union {
         struct lmgr_iterator_t *std_iter;
         struct lmgr_rm_list_t *rmd_iter;
+        shared_consumer_t *shared;
     } it;
 };
 
@@ -1287,6 +1543,8 @@ static inline int iter_next(struct policy_iter *it, entry_id_t *p_id, attr_set_t
             return ListMgr_GetNext(it->it.std_iter, p_id, p_attrs);
         case IT_RMD:
             return ListMgr_GetNextRmEntry(it->it.rmd_iter, p_id, p_attrs);
+        case IT_SHARED:
+            return shared_scan_next(it->it.shared, p_id, p_attrs);
     }
     return DB_INVALID_ARG;
 }
@@ -1307,6 +1565,12 @@ static inline void iter_close(struct policy_iter *it)
             ListMgr_CloseRmList(it->it.rmd_iter);
             it->it.rmd_iter = NULL;
             break;
+        case IT_SHARED:
+            shared_scan_leave(it->it.shared);
+            /* next requests are private to the policy run */
+            it->it_type = IT_LIST;
+            it->it.std_iter = NULL;
+            break;
     }
 }
 
@@ -1331,6 +1595,9 @@ static inline int iter_open(lmgr_t *lmgr,
             if (it->it.rmd_iter == NULL)
                 return DB_REQUEST_FAILED;
             break;
+
+        case IT_SHARED:
+            RBH_BUG("shared scans are not opened by iter_open()");
     }
     return DB_SUCCESS;
 }
@@ -1409,6 +1676,7 @@ static pass_status_e fill_workers_queue(policy_info_t *pol,
 
             /* if limit = inifinite => END OF LIST */
             if ((*db_current_list_count == 0)
+                 || (it->it_type == IT_SHARED) /* all entries at once */
                  || ((req_opt->list_count_max > 0) &&
                     (*db_current_list_count < req_opt->list_count_max)))
             {
@@ -1534,6 +1802,138 @@ static pass_status_e fill_workers_queue(policy_info_t *pol,
     return st;
 }
 
+/**
+ * Check if an entry would be eligible for a policy action,
+ * according to its attributes from the DB.
+ * Unlike check_entry_action(), this doesn't get fresh attributes
+ * from the filesystem and doesn't update the DB.
+ */
+static bool simulate_entry_match(policy_info_t *pol, const entry_id_t *p_id,
+                                 const attr_set_t *p_attrs)
+{
+    rule_item_t     *rule;
+    fileset_item_t  *fileset = NULL;
+    policy_match_t   match;
+
+    match = match_scope(pol->descr, p_id, p_attrs, false);
+    if (match == POLICY_NO_MATCH)
+        return false;
+    /* for deleted entries, missing attributes are expected */
+    if (match != POLICY_MATCH && !pol->descr->manage_deleted)
+        return false;
+
+    if (!ignore_policies(pol)
+        && is_whitelisted(pol->descr, p_id, p_attrs, &fileset)
+            != POLICY_NO_MATCH)
+        return false;
+
+    rule = policy_case(pol->descr, p_id, p_attrs, &fileset);
+    if (rule == NULL)
+        return false;
+
+    if (!ignore_policies(pol)
+        && entry_matches(p_id, p_attrs, &rule->condition, pol->time_modifier,
+                         pol->descr->status_mgr) != POLICY_MATCH)
+        return false;
+
+    return true;
+}
+
+/**
+ * Simulation mode: list candidates and match them against policy rules,
+ * until the policy limit is reached or the end of list is reached.
+ * Eligible entries are accounted in pol->progress.action_ctr,
+ * other entries in pol->progress.skipped.
+ * As entries are not updated in DB, next requests start after the last
+ * returned entry, in (sort attribute, id) order.
+ */
+static pass_status_e simulate_policy_pass(policy_info_t *pol,
+                                          const policy_param_t *p_param,
+                                          lmgr_t *lmgr,
+                                          struct policy_iter *it,
+                                          lmgr_iter_opt_t *req_opt,
+                                          const lmgr_sort_type_t *sort_type,
+                                          lmgr_filter_t *filter,
+                                          attr_mask_t attr_mask)
+{
+    int          rc;
+    attr_set_t   attr_set;
+    entry_id_t   entry_id;
+    counters_t   entry_amount;
+    unsigned int nb_returned = 0;
+
+    do
+    {
+        memset(&attr_set, 0, sizeof(attr_set_t));
+        attr_set.attr_mask = attr_mask;
+
+        memset(&entry_id, 0, sizeof(entry_id_t));
+
+        rc = iter_next(it, &entry_id, &attr_set);
+
+        if (aborted(pol))
+        {
+            if (rc == 0)
+                ListMgr_FreeAttrs(&attr_set);
+
+            DisplayLog(LVL_MAJOR, tag(pol), "Policy simulation aborted.");
+            return PASS_ABORTED;
+        }
+        else if (rc == DB_END_OF_LIST)
+        {
+            /* last page */
+            if (it->it_type != IT_LIST || req_opt->list_count_max == 0
+                || nb_returned < req_opt->list_count_max)
+                return PASS_EOL;
+
+            iter_close(it);
+
+            DisplayLog(LVL_DEBUG, tag(pol), "Performing new request with a "
+                       "limit of %u entries, after entry "DFID,
+                       req_opt->list_count_max, PFID(&req_opt->after_id));
+
+            nb_returned = 0;
+            rc = iter_open(lmgr, IT_LIST, it, filter, sort_type, req_opt);
+            if (rc != DB_SUCCESS)
+            {
+                DisplayLog(LVL_CRIT, tag(pol), "Error %d retrieving list of "
+                           "candidates from database. Policy simulation "
+                           "cancelled.", rc);
+                return PASS_ERROR;
+            }
+            continue;
+        }
+        else if (rc != 0)
+        {
+            DisplayLog(LVL_CRIT, tag(pol), "Error %d getting next entry of iterator", rc);
+            return PASS_ERROR;
+        }
+
+        /* next request starts after this entry */
+        nb_returned++;
+        rc = get_sort_attr(pol, &attr_set);
+        req_opt->after_set = 1;
+        req_opt->after_null = (rc == -1);
+        req_opt->after_val = rc;
+        req_opt->after_id = entry_id;
+
+        if (!simulate_entry_match(pol, &entry_id, &attr_set)
+            || entry2tgt_amount(p_param, &attr_set, &entry_amount) == -1)
+        {
+            pol->progress.skipped++;
+            ListMgr_FreeAttrs(&attr_set);
+            continue;
+        }
+
+        counters_add(&pol->progress.action_ctr, &entry_amount);
+        ListMgr_FreeAttrs(&attr_set);
+
+    } while (!check_limit(pol, &pol->progress.action_ctr, 0,
+                          &p_param->target_ctr));
+
+    return PASS_LIMIT;
+}
+
 /* forward declaration */
 static void process_entry(policy_info_t *pol, lmgr_t *lmgr,
                           queue_item_t *p_item, bool free_item);
@@ -1557,6 +1957,7 @@ static int single_file_run(policy_info_t *pol, lmgr_t *lmgr,
                        status_before, feedback_before);
 
     pol->progress.policy_start = pol->progress.last_report = time(NULL);
+    throttle_reset(pol);
 
     /* resolve the fid of the target */
     rc = path2id(p_param->optarg_u.name, &item.entry_id, NULL);
@@ -1578,6 +1979,22 @@ static int single_file_run(policy_info_t *pol, lmgr_t *lmgr,
         return rc;
     }
 
+    if (simulate(pol))
+    {
+        counters_t  amount;
+
+        if (simulate_entry_match(pol, &item.entry_id, &item.entry_attr)
+            && entry2tgt_amount(p_param, &item.entry_attr, &amount) == 0)
+            counters_add(&pol->progress.action_ctr, &amount);
+        else
+            pol->progress.skipped++;
+
+        ListMgr_FreeAttrs(&item.entry_attr);
+        if (p_summary)
+            *p_summary = pol->progress;
+        return 0;
+    }
+
     /* apply the policy to the entry */
     process_entry(pol, lmgr, &item, false);
 
@@ -1692,11 +2109,32 @@ int run_policy(policy_info_t *p_pol_info, const policy_param_t *p_param,
 
     /* Do not retrieve all entries at once, as the result may exceed the client memory! */
     opt.list_count_max = p_pol_info->config->db_request_limit;
+    /* In simulation mode, entries are not updated in DB, so next requests
+     * can't rely on md_update to skip the entries already returned */
+    if (simulate(p_pol_info))
+        opt.keyset = 1;
     nb_returned = 0;
     total_returned = 0;
 
-    rc = iter_open(lmgr, p_pol_info->descr->manage_deleted? IT_RMD: IT_LIST,
-                   &it, &filter, &sort_type, &opt);
+    /* list candidates together with other policies starting now? */
+    if (p_pol_info->config->shared_scan && run_cfgs.shared_scan_delay > 0
+        && p_param->target == TGT_FS && !p_pol_info->descr->manage_deleted
+        && !simulate(p_pol_info))
+    {
+        rc = shared_scan_join(p_pol_info, attr_mask, &it.it.shared);
+        if (rc)
+            DisplayLog(LVL_MAJOR, tag(p_pol_info), "Failed to join a shared "
+                       "candidate scan (error %d): listing candidates "
+                       "for this policy only.", rc);
+        else if (it.it.shared != NULL)
+            it.it_type = IT_SHARED;
+    }
+
+    if (it.it_type != IT_SHARED)
+        rc = iter_open(lmgr, p_pol_info->descr->manage_deleted? IT_RMD: IT_LIST,
+                       &it, &filter, &sort_type, &opt);
+    else
+        rc = DB_SUCCESS;
     if (rc != DB_SUCCESS)
     {
         lmgr_simple_filter_free(&filter);
@@ -1708,6 +2146,20 @@ int run_policy(policy_info_t *p_pol_info, const policy_param_t *p_param,
 
     p_pol_info->progress.policy_start = p_pol_info->progress.last_report
         = time(NULL);
+    throttle_reset(p_pol_info);
+
+    if (simulate(p_pol_info))
+    {
+        st = simulate_policy_pass(p_pol_info, p_param, lmgr, &it, &opt,
+                                  &sort_type, &filter, attr_mask);
+        if (st == PASS_ABORTED)
+            rc = ECANCELED;
+        else if (st == PASS_ERROR)
+            rc = -1;
+        else
+            rc = 0;
+        goto out;
+    }
 
     /* start alert batching in case the policy trigger alerts */
     Alert_StartBatching();
@@ -1745,13 +2197,17 @@ int run_policy(policy_info_t *p_pol_info, const policy_param_t *p_param,
              !check_limit(p_pol_info, &p_pol_info->progress.action_ctr,
                           p_pol_info->progress.errors, &p_param->target_ctr));
 
+    /* flush pending alerts */
+    Alert_EndBatching();
+
+    report_throttling(p_pol_info, LVL_VERB,
+                      time(NULL) - p_pol_info->progress.policy_start);
+
+out:
     lmgr_simple_filter_free(&filter);
     /* iterator may have been closed in fill_workers_queue() */
     iter_close(&it);
 
-    /* flush pending alerts */
-    Alert_EndBatching();
-
     if (p_summary)
         *p_summary = p_pol_info->progress;
 
@@ -2115,50 +2571,85 @@ static void log_action_success(const policy_info_t  *pol,
 }
 
 
-/**
- * Manage an entry by path or by fid, depending on FS
- */
-static void process_entry(policy_info_t *pol, lmgr_t * lmgr,
-                          queue_item_t * p_item, bool free_item)
+/** build the feedback array of an acknowledged entry */
+static inline void policy_feedback(unsigned long long *feedback,
+                                   unsigned int status,
+                                   const attr_set_t *p_attrs,
+                                   unsigned long targeted)
 {
-    attr_set_t     new_attr_set = ATTR_SET_INIT;
-    int            rc;
-
-    policy_match_t   match;
-    rule_item_t     *rule;
-    fileset_item_t  *p_fileset;
-    attr_set_t      attr_sav;
-    int lastrm;
-    post_action_e   after_action = PA_NONE;
-    action_params_t params = {0};
-
+    memset(feedback, 0, AF_ENUM_COUNT * sizeof(*feedback));
+    if (status == AS_OK) {
+        feedback[AF_NBR_OK] = 1;
+        feedback[AF_VOL_OK] = ATTR_MASK_TEST(p_attrs,size)?ATTR(p_attrs,size):0;
+        feedback[AF_TARGETED_OK] = targeted;
+        feedback[AF_BLOCKS_OK] = ATTR_MASK_TEST(p_attrs,blocks)?ATTR(p_attrs,blocks):0;
+    } else {
+        feedback[AF_NBR_NOK] = 1;
+        feedback[AF_VOL_NOK] = ATTR_MASK_TEST(p_attrs,size)?ATTR(p_attrs,size):0;
+        feedback[AF_TARGETED_NOK] = targeted;
+        feedback[AF_BLOCKS_NOK] = ATTR_MASK_TEST(p_attrs,blocks)?ATTR(p_attrs,blocks):0;
+    }
+}
 
 /* acknowledging helper */
 #define policy_ack(_q, _status, _pattrs, _tgt)  do {                    \
-                               unsigned long long feedback[AF_ENUM_COUNT]; \
-                               memset(feedback, 0, sizeof(feedback));   \
-                                    if (_status == AS_OK) {             \
-                                        feedback[AF_NBR_OK] = 1;        \
-                                        feedback[AF_VOL_OK] = ATTR_MASK_TEST(_pattrs,size)?ATTR(_pattrs,size):0;     \
-                                        feedback[AF_TARGETED_OK] = _tgt;\
-                                        feedback[AF_BLOCKS_OK] = ATTR_MASK_TEST(_pattrs,blocks)?ATTR(_pattrs,blocks):0; \
-                                    } else {                            \
-                                        feedback[AF_NBR_NOK] = 1;        \
-                                        feedback[AF_VOL_NOK] = ATTR_MASK_TEST(_pattrs,size)?ATTR(_pattrs,size):0;     \
-                                        feedback[AF_TARGETED_NOK] = _tgt;\
-                                        feedback[AF_BLOCKS_NOK] = ATTR_MASK_TEST(_pattrs,blocks)?ATTR(_pattrs,blocks):0; \
-                                    }                                   \
+                                    unsigned long long feedback[AF_ENUM_COUNT]; \
+                                    policy_feedback(feedback, _status, _pattrs, _tgt); \
                                     Queue_Acknowledge(_q, _status, feedback, AF_ENUM_COUNT); \
                                 } while(0)
 
+/** Information about an entry, from its checking to the end of its action */
+typedef struct entry_ctx {
+    queue_item_t    *item;
+    /** up-to-date attributes of the entry */
+    attr_set_t       new_attrs;
+    /** attributes before the action was run */
+    attr_set_t       attr_sav;
+    rule_item_t     *rule;
+    fileset_item_t  *fileset;
+    action_params_t  params;
+    post_action_e    after_action;
+    int              sort_time;
+    /** when the action was started */
+    struct timeval   action_start;
+} entry_ctx_t;
+
+static inline void entry_ctx_init(entry_ctx_t *ctx, queue_item_t *p_item)
+{
+    memset(ctx, 0, sizeof(*ctx));
+    ctx->item = p_item;
+    ctx->after_action = PA_NONE;
+}
+
+/** release the resources of an entry context */
+static inline void entry_ctx_release(entry_ctx_t *ctx, bool free_item)
+{
+    ListMgr_FreeAttrs(&ctx->new_attrs);
+    rbh_params_free(&ctx->params);
+
+    if (free_item)
+        free_queue_item(ctx->item);
+}
+
+/**
+ * Check if an entry is eligible for the policy action,
+ * and build its action parameters.
+ * If the entry is not eligible, the entry is acknowledged by this function.
+ * @return AS_OK if the action must be run on the entry.
+ */
+static int check_entry_action(policy_info_t *pol, lmgr_t *lmgr,
+                              entry_ctx_t *ctx)
+{
+    queue_item_t    *p_item = ctx->item;
+    policy_match_t   match;
+    int              rc;
 
     if (aborted(pol))
     {
        /* migration aborted by a signal, doesn't submit new migrations */
        DisplayLog(LVL_FULL, tag(pol), "Policy run aborted: skipping pending requests");
        policy_ack(&pol->queue, AS_ABORT, &p_item->entry_attr, p_item->targeted);
-       rc = AS_ABORT;
-       goto end;
+       return AS_ABORT;
     }
 
     DisplayLog(LVL_FULL, tag(pol),
@@ -2167,24 +2658,34 @@ static void process_entry(policy_info_t *pol, lmgr_t * lmgr,
 
     if (!pol->descr->manage_deleted)
     {
-        rc = check_entry(pol, lmgr, p_item, &new_attr_set);
+        if (p_item->checked)
+        {
+            /* entry was checked in advance by a prefetch thread */
+            rc = p_item->check_rc;
+            ctx->new_attrs = p_item->check_attr;
+            p_item->check_attr = (attr_set_t)ATTR_SET_INIT;
+            p_item->checked = false;
+        }
+        else
+            rc = check_entry(pol, lmgr, p_item, &ctx->new_attrs);
+
         if (rc != AS_OK)
         {
             policy_ack(&pol->queue, rc, &p_item->entry_attr, p_item->targeted);
-            goto end;
+            return rc;
         }
     }
     /* In any case, complete with missing attrs from database */
-    ListMgr_MergeAttrSets(&new_attr_set, &p_item->entry_attr, false);
+    ListMgr_MergeAttrSets(&ctx->new_attrs, &p_item->entry_attr, false);
 
 #ifdef ATTR_INDEX_invalid
     /* From here, assume that entry is valid */
-    ATTR_MASK_SET(&new_attr_set, invalid);
-    ATTR(&new_attr_set, invalid) = false;
+    ATTR_MASK_SET(&ctx->new_attrs, invalid);
+    ATTR(&ctx->new_attrs, invalid) = false;
 #endif
 
     /* check the entry still matches the policy scope */
-    switch (match_scope(pol->descr, &p_item->entry_id, &new_attr_set,
+    switch (match_scope(pol->descr, &p_item->entry_id, &ctx->new_attrs,
                         !pol->descr->manage_deleted))
     {
         case POLICY_MATCH:
@@ -2192,25 +2693,24 @@ static void process_entry(policy_info_t *pol, lmgr_t * lmgr,
             break;
         case POLICY_NO_MATCH:
             DisplayLog(LVL_DEBUG, tag(pol), "Entry %s doesn't match scope of policy '%s'.",
-                       ATTR(&new_attr_set, fullpath), tag(pol));
+                       ATTR(&ctx->new_attrs, fullpath), tag(pol));
             if (!pol->descr->manage_deleted)
-                update_entry(lmgr, &p_item->entry_id, &new_attr_set);
+                update_entry(lmgr, &p_item->entry_id, &ctx->new_attrs);
             policy_ack(&pol->queue, AS_OUT_OF_SCOPE, &p_item->entry_attr,
                        p_item->targeted);
-            goto end;
-            break;
+            return AS_OUT_OF_SCOPE;
         default:
             if (!pol->descr->manage_deleted)
             {
                 DisplayLog(LVL_MAJOR, tag(pol),
                            "Warning: cannot determine if entry %s matches the "
                            "scope of policy '%s': skipping it.",
-                           ATTR(&new_attr_set, fullpath), tag(pol));
+                           ATTR(&ctx->new_attrs, fullpath), tag(pol));
 
-                update_entry(lmgr, &p_item->entry_id, &new_attr_set);
+                update_entry(lmgr, &p_item->entry_id, &ctx->new_attrs);
                 policy_ack(&pol->queue, AS_MISSING_MD, &p_item->entry_attr,
                            p_item->targeted);
-                goto end;
+                return AS_MISSING_MD;
             }
             else
             {
@@ -2219,7 +2719,7 @@ static void process_entry(policy_info_t *pol, lmgr_t * lmgr,
                 DisplayLog(LVL_DEBUG, tag(pol),
                            "Cannot determine if entry %s matches the "
                            "scope of policy '%s'. Continuing anyway.",
-                           ATTR(&new_attr_set, fullpath), tag(pol));
+                           ATTR(&ctx->new_attrs, fullpath), tag(pol));
             }
     }
 
@@ -2230,19 +2730,20 @@ static void process_entry(policy_info_t *pol, lmgr_t * lmgr,
     if (!ignore_policies(pol))
     {
         /* 4) check whitelist rules */
-        match = is_whitelisted(pol->descr, &p_item->entry_id, &new_attr_set, &p_fileset);
+        match = is_whitelisted(pol->descr, &p_item->entry_id, &ctx->new_attrs,
+                               &ctx->fileset);
 
         if (match == POLICY_MATCH)
         {
             DisplayLog(LVL_DEBUG, tag(pol),
                        "Entry %s matches ignored target %s.",
                        ATTR(&p_item->entry_attr, fullpath),
-                       p_fileset? p_fileset->fileset_id:"(ignore rule)");
+                       ctx->fileset? ctx->fileset->fileset_id:"(ignore rule)");
 
             if (!pol->descr->manage_deleted)
-                update_entry(lmgr, &p_item->entry_id, &new_attr_set);
+                update_entry(lmgr, &p_item->entry_id, &ctx->new_attrs);
             policy_ack(&pol->queue, AS_WHITELISTED, &p_item->entry_attr, p_item->targeted);
-            goto end;
+            return AS_WHITELISTED;
         }
         else if (match != POLICY_NO_MATCH)
         {
@@ -2252,76 +2753,76 @@ static void process_entry(policy_info_t *pol, lmgr_t * lmgr,
                        ATTR(&p_item->entry_attr, fullpath));
 
             if (!pol->descr->manage_deleted)
-                update_entry(lmgr, &p_item->entry_id, &new_attr_set);
+                update_entry(lmgr, &p_item->entry_id, &ctx->new_attrs);
             policy_ack(&pol->queue, AS_MISSING_MD, &p_item->entry_attr, p_item->targeted);
-            goto end;
+            return AS_MISSING_MD;
         }
 
         /* check that time ordering did not change and that time attributes
          * are consistent. */
         rc = check_entry_times(pol, lmgr, &p_item->entry_id, &p_item->entry_attr,
-                               &new_attr_set);
+                               &ctx->new_attrs);
         if (rc != AS_OK)
         {
             /* check_entry_times already updates the entry */
             policy_ack(&pol->queue, rc, &p_item->entry_attr, p_item->targeted);
-            goto end;
+            return rc;
         }
     } /* end if 'don't ignore policies' */
 
     /* get policy rule for the entry */
-    rule = policy_case(pol->descr, &p_item->entry_id, &new_attr_set,
-                       &p_fileset);
-    if (!rule)
+    ctx->rule = policy_case(pol->descr, &p_item->entry_id, &ctx->new_attrs,
+                            &ctx->fileset);
+    if (!ctx->rule)
     {
         DisplayLog(LVL_DEBUG, tag(pol), "Entry %s matches no policy rule",
                    ATTR(&p_item->entry_attr, fullpath));
 
         if (!pol->descr->manage_deleted)
-            update_entry(lmgr, &p_item->entry_id, &new_attr_set);
+            update_entry(lmgr, &p_item->entry_id, &ctx->new_attrs);
 
         policy_ack(&pol->queue, AS_NO_POLICY, &p_item->entry_attr,
                    p_item->targeted);
-        goto end;
+        return AS_NO_POLICY;
     }
 
     /* don't care about policy condition if 'ignore-policies' flag is specified */
     if (!ignore_policies(pol))
     {
         /* check if the entry matches the policy condition */
-        switch(entry_matches(&p_item->entry_id, &new_attr_set, &rule->condition,
-                             pol->time_modifier, pol->descr->status_mgr))
+        switch(entry_matches(&p_item->entry_id, &ctx->new_attrs,
+                             &ctx->rule->condition, pol->time_modifier,
+                             pol->descr->status_mgr))
         {
         case POLICY_NO_MATCH:
             /* entry is not eligible now */
             DisplayLog(LVL_DEBUG, tag(pol), "Entry %s doesn't match condition for policy rule '%s'",
-                       ATTR(&p_item->entry_attr, fullpath), rule->rule_id);
+                       ATTR(&p_item->entry_attr, fullpath), ctx->rule->rule_id);
 
             if (!pol->descr->manage_deleted)
-                update_entry(lmgr, &p_item->entry_id, &new_attr_set);
+                update_entry(lmgr, &p_item->entry_id, &ctx->new_attrs);
 
             policy_ack(&pol->queue, AS_WHITELISTED, &p_item->entry_attr, p_item->targeted);
+            return AS_WHITELISTED;
 
-            goto end;
-            break;
         case POLICY_MATCH:
             /* OK, can be purged */
             DisplayLog(LVL_DEBUG, tag(pol),
                        "Entry %s matches the condition for policy rule '%s'.",
-                       ATTR(&p_item->entry_attr, fullpath), rule->rule_id);
+                       ATTR(&p_item->entry_attr, fullpath), ctx->rule->rule_id);
             break;
         default:
             /* Cannot determine if entry matches the policy condition */
             DisplayLog(LVL_MAJOR, tag(pol),
                        "Warning: cannot determine if entry %s matches the "
                        "condition for policy rule '%s': skipping it.",
-                       ATTR(&p_item->entry_attr, fullpath), rule->rule_id);
+                       ATTR(&p_item->entry_attr, fullpath), ctx->rule->rule_id);
 
             if (!pol->descr->manage_deleted)
-                update_entry(lmgr, &p_item->entry_id, &new_attr_set);
+                update_entry(lmgr, &p_item->entry_id, &ctx->new_attrs);
             policy_ack(&pol->queue, AS_MISSING_MD, &p_item->entry_attr,
                        p_item->targeted);
-            goto end;
+            return AS_MISSING_MD;
         }
     }
 
@@ -2330,30 +2831,58 @@ static void process_entry(policy_info_t *pol, lmgr_t * lmgr,
     if (rc != -1 && (!pol->first_eligible || (rc < pol->first_eligible)))
         pol->first_eligible = rc;
 
-    int time_save = rc;
+    ctx->sort_time = rc;
 
     /* build action parameters */
-    rc = build_action_params(&params, &p_item->entry_id, &new_attr_set, pol,
-                             rule, p_fileset);
+    rc = build_action_params(&ctx->params, &p_item->entry_id, &ctx->new_attrs,
+                             pol, ctx->rule, ctx->fileset);
     if (rc)
     {
         if (!pol->descr->manage_deleted)
-            update_entry(lmgr, &p_item->entry_id, &new_attr_set);
+            update_entry(lmgr, &p_item->entry_id, &ctx->new_attrs);
         policy_ack(&pol->queue, AS_ERROR, &p_item->entry_attr,
                    p_item->targeted);
-        goto end;
+        return AS_ERROR;
     }
 
     /* save attributes before doing the action */
     /* @FIXME this only save scalar value, not values in allocated structures etc. */
-    attr_sav = new_attr_set;
+    ctx->attr_sav = ctx->new_attrs;
 
-    /* apply action to the entry! */
-    /* TODO RBHv3: action must indicate what to do with the entry
-     * => db update, rm from filesystem etc... */
-    rc = policy_action(pol, rule, p_fileset, &p_item->entry_id, &new_attr_set,
-                       &params, &after_action);
-    rbh_params_free(&params);
+    return AS_OK;
+}
+
+/**
+ * Update the database according to the action result,
+ * and acknowledge the entry.
+ * @param rc the action status.
+ * @param[out] ack_status,ack_feedback if not NULL, the acknowledgement
+ *             is returned in these for the caller to acknowledge several
+ *             entries at once.
+ */
+static void entry_action_done(policy_info_t *pol, lmgr_t *lmgr,
+                              entry_ctx_t *ctx, int rc,
+                              unsigned int *ack_status,
+                              unsigned long long *ack_feedback)
+{
+    queue_item_t *p_item = ctx->item;
+    int           lastrm;
+
+    if (EventLogEnabled())
+    {
+        struct timeval now, diff;
+
+        gettimeofday(&now, NULL);
+        timersub(&now, &ctx->action_start, &diff);
+
+        rbh_evt_action(tag(pol), ctx->rule ? ctx->rule->rule_id : NULL,
+                       &p_item->entry_id,
+                       ATTR_MASK_TEST(&ctx->attr_sav, fullpath) ?
+                            ATTR(&ctx->attr_sav, fullpath) : NULL,
+                       ATTR_MASK_TEST(&ctx->attr_sav, size) ?
+                            ATTR(&ctx->attr_sav, size) : 0,
+                       rc, (uint64_t)diff.tv_sec * 1000000 + diff.tv_usec);
+    }
 
     if (rc != 0)
     {
@@ -2365,35 +2894,43 @@ static void process_entry(policy_info_t *pol, lmgr_t * lmgr,
             err_str = "command execution failed";
 
         DisplayLog(LVL_DEBUG, tag(pol), "Error applying action on entry %s: %s",
-                   ATTR(&new_attr_set, fullpath), err_str);
+                   ATTR(&ctx->new_attrs, fullpath), err_str);
 
         /* no update for deleted entries */
         if (!pol->descr->manage_deleted)
-            update_entry(lmgr, &p_item->entry_id, &new_attr_set);
+            update_entry(lmgr, &p_item->entry_id, &ctx->new_attrs);
 
-        policy_ack(&pol->queue, AS_ERROR, &p_item->entry_attr,
-                   p_item->targeted);
+        if (ack_status != NULL)
+        {
+            *ack_status = AS_ERROR;
+            policy_feedback(ack_feedback, AS_ERROR, &p_item->entry_attr,
+                            p_item->targeted);
+        }
+        else
+            policy_ack(&pol->queue, AS_ERROR, &p_item->entry_attr,
+                       p_item->targeted);
     }
     else
     {
-        log_action_success(pol, &attr_sav, rule, p_fileset, time_save);
+        log_action_success(pol, &ctx->attr_sav, ctx->rule, ctx->fileset,
+                           ctx->sort_time);
 
         if (pol->descr->manage_deleted &&
-            (after_action == PA_RM_ONE || after_action == PA_RM_ALL))
+            (ctx->after_action == PA_RM_ONE || ctx->after_action == PA_RM_ALL))
         {
             rc = ListMgr_SoftRemove_Discard(lmgr, &p_item->entry_id);
             if (rc)
                 DisplayLog(LVL_CRIT, tag(pol), "Error %d removing entry from database.", rc);
         }
-        else if (after_action == PA_UPDATE)
+        else if (ctx->after_action == PA_UPDATE)
         {
             if (!pol->descr->manage_deleted)
-                update_entry(lmgr, &p_item->entry_id, &new_attr_set);
+                update_entry(lmgr, &p_item->entry_id, &ctx->new_attrs);
         }
-        else if (after_action ==  PA_RM_ONE)
+        else if (ctx->after_action ==  PA_RM_ONE)
         {
-            lastrm = ATTR_MASK_TEST(&attr_sav, nlink)?
-                        (ATTR(&attr_sav, nlink) <= 1):0;
+            lastrm = ATTR_MASK_TEST(&ctx->attr_sav, nlink)?
+                        (ATTR(&ctx->attr_sav, nlink) <= 1):0;
 
             rc = ListMgr_Remove(lmgr, &p_item->entry_id,
                                 /* must be based on the DB content = old attrs */
@@ -2402,7 +2939,7 @@ static void process_entry(policy_info_t *pol, lmgr_t * lmgr,
             if (rc)
                 DisplayLog(LVL_CRIT, tag(pol), "Error %d removing entry from database.", rc);
         }
-        else if (after_action == PA_RM_ALL)
+        else if (ctx->after_action == PA_RM_ALL)
         {
             rc = ListMgr_Remove(lmgr, &p_item->entry_id,
                                 /* must be based on the DB content = old attrs */
@@ -2412,17 +2949,295 @@ static void process_entry(policy_info_t *pol, lmgr_t * lmgr,
                 DisplayLog(LVL_CRIT, tag(pol), "Error %d removing entry from database.", rc);
         }
 
-        policy_ack(&pol->queue, AS_OK, &new_attr_set, p_item->targeted); /* TODO update target info */
+        /* TODO update target info */
+        if (ack_status != NULL)
+        {
+            *ack_status = AS_OK;
+            policy_feedback(ack_feedback, AS_OK, &ctx->new_attrs,
+                            p_item->targeted);
+        }
+        else
+            policy_ack(&pol->queue, AS_OK, &ctx->new_attrs, p_item->targeted);
     }
+}
 
-  end:
-    ListMgr_FreeAttrs(&new_attr_set);
+/** Run the policy action on a single (already checked) entry */
+static void run_entry_action(policy_info_t *pol, lmgr_t *lmgr, entry_ctx_t *ctx)
+{
+    int rc;
 
-    if (free_item)
-        free_queue_item(p_item);
-    return;
+    /* apply action to the entry! */
+    /* TODO RBHv3: action must indicate what to do with the entry
+     * => db update, rm from filesystem etc... */
+    throttle_action_start(pol, 1, ATTR_MASK_TEST(&ctx->new_attrs, size) ?
+                                  ATTR(&ctx->new_attrs, size) : 0);
+    sched_action_start(pol);
+    gettimeofday(&ctx->action_start, NULL);
+    rc = policy_action(pol, ctx->rule, ctx->fileset, &ctx->item->entry_id,
+                       &ctx->new_attrs, &ctx->params, &ctx->after_action);
+    sched_action_end(pol);
+    throttle_action_end(pol, &ctx->action_start);
+    rbh_params_free(&ctx->params);
+
+    entry_action_done(pol, lmgr, ctx, rc, NULL, NULL);
+}
+
+/**
+ * Manage an entry by path or by fid, depending on FS
+ */
+static void process_entry(policy_info_t *pol, lmgr_t * lmgr,
+                          queue_item_t * p_item, bool free_item)
+{
+    entry_ctx_t ctx;
+
+    entry_ctx_init(&ctx, p_item);
+
+    if (check_entry_action(pol, lmgr, &ctx) == AS_OK)
+        run_entry_action(pol, lmgr, &ctx);
+
+    entry_ctx_release(&ctx, free_item);
+}
+
+/** Check if an (already checked) entry can be part of an action batch */
+static inline bool entry_batchable(const policy_info_t *pol,
+                                   const entry_ctx_t *ctx)
+{
+    return !dry_run(pol)
+        && smi_batch_action(pol->descr->status_mgr, pol->descr->implements,
+                            get_policy_action(pol, ctx->rule));
+}
+
+/** Check if two entries can be part of the same action batch:
+ * they must have the same action and the same action parameters. */
+static bool batch_compatible(const policy_info_t *pol, const entry_ctx_t *c1,
+                             const entry_ctx_t *c2)
+{
+    const policy_action_t *a1 = get_policy_action(pol, c1->rule);
+    const policy_action_t *a2 = get_policy_action(pol, c2->rule);
+
+    if (a1 != a2)
+    {
+        if (a1->type != ACTION_FUNCTION || a2->type != ACTION_FUNCTION
+            || a1->action_u.func.call != a2->action_u.func.call)
+            return false;
+    }
+
+    return rbh_params_equal(&c1->params, &c2->params);
+}
+
+/**
+ * Run the policy action on a batch of checked entries,
+ * then acknowledge all entries at once.
+ * Resources of the entry contexts are released by this function.
+ */
+static void run_batch_action(policy_info_t *pol, lmgr_t *lmgr,
+                             entry_ctx_t *batch, unsigned int count)
+{
+    sm_instance_t         *smi = pol->descr->status_mgr;
+    const policy_action_t *actionp;
+    const entry_id_t     **ids = NULL;
+    attr_set_t           **attrs = NULL;
+    post_action_e         *afters = NULL;
+    int                   *rcs = NULL;
+    unsigned int          *ack_status = NULL;
+    unsigned long long    *ack_feedback = NULL;
+    unsigned int           i;
+    int                    rc = -ENOTSUP;
+    ull_t                  vol = 0;
+    bool                   throttled = false;
+
+    if (count == 0)
+        return;
+
+    actionp = get_policy_action(pol, batch[0].rule);
+
+    if (count > 1)
+    {
+        ids = MemCalloc(count, sizeof(*ids));
+        attrs = MemCalloc(count, sizeof(*attrs));
+        afters = MemCalloc(count, sizeof(*afters));
+        rcs = MemCalloc(count, sizeof(*rcs));
+        ack_status = MemCalloc(count, sizeof(*ack_status));
+        ack_feedback = MemCalloc(count * AF_ENUM_COUNT, sizeof(*ack_feedback));
+    }
+
+    if (ids != NULL && attrs != NULL && afters != NULL && rcs != NULL
+        && ack_status != NULL && ack_feedback != NULL)
+    {
+        for (i = 0; i < count; i++)
+        {
+            log_policy_action(pol, &batch[i].item->entry_id,
+                              &batch[i].new_attrs, &batch[i].params);
+            ids[i] = &batch[i].item->entry_id;
+            attrs[i] = &batch[i].new_attrs;
+            afters[i] = PA_NONE;
+            if (ATTR_MASK_TEST(attrs[i], size))
+                vol += ATTR(attrs[i], size);
+        }
+
+        DisplayLog(LVL_DEBUG, tag(pol), "Submitting a batch of %u actions",
+                   count);
+
+        /* rates are accounted per entry, but a batch is a single
+         * running action */
+        throttle_action_start(pol, count, vol);
+        throttled = true;
+
+        gettimeofday(&batch[0].action_start, NULL);
+        for (i = 1; i < count; i++)
+            batch[i].action_start = batch[0].action_start;
+
+        /* a batch takes a single action slot */
+        sched_action_start(pol);
+        rc = smi->sm->batch_executor(smi, pol->descr->implements, actionp,
+                                     &batch[0].params, count, ids, attrs,
+                                     rcs, afters);
+        sched_action_end(pol);
+        throttle_action_end(pol, &batch[0].action_start);
+    }
+
+    if (rc == -ENOTSUP)
+    {
+        /* not supported for this batch: run actions one by one */
+        if (throttled)
+            throttle_action_cancel(pol, count, vol);
+        for (i = 0; i < count; i++)
+        {
+            run_entry_action(pol, lmgr, &batch[i]);
+            entry_ctx_release(&batch[i], true);
+        }
+        goto out;
+    }
+
+    for (i = 0; i < count; i++)
+    {
+        int entry_rc = (rc != 0) ? rc : rcs[i];
+
+        batch[i].after_action = afters[i];
+
+        /* call action callback for each entry */
+        if (smi->sm->action_cb != NULL)
+        {
+            int tmp_rc = smi->sm->action_cb(smi, pol->descr->implements,
+                                            entry_rc, ids[i], attrs[i],
+                                            &batch[i].after_action);
+            if (tmp_rc)
+                DisplayLog(LVL_MAJOR, tag(pol), "Action callback failed for action '%s': rc=%d",
+                           pol->descr->implements ? pol->descr->implements : "<null>", tmp_rc);
+        }
+
+        entry_action_done(pol, lmgr, &batch[i], entry_rc, &ack_status[i],
+                          &ack_feedback[i * AF_ENUM_COUNT]);
+        entry_ctx_release(&batch[i], true);
+    }
+    Queue_AcknowledgeBatch(&pol->queue, count, ack_status, ack_feedback,
+                           AF_ENUM_COUNT);
+
+out:
+    MemFree(ids);
+    MemFree(attrs);
+    MemFree(afters);
+    MemFree(rcs);
+    MemFree(ack_status);
+    MemFree(ack_feedback);
 }
 
+/** queue workers get their entries from */
+static inline entry_queue_t *worker_queue(policy_info_t *pol)
+{
+    return pol->config->check_prefetch > 0 ? &pol->checked_queue : &pol->queue;
+}
+
+/**
+ * Worker loop for policies with batched actions:
+ * checked entries are gathered until the batch is full, the queue is empty,
+ * or the next entry is not compatible with the current batch.
+ * Entries are taken from the queue by sets of up to the missing count
+ * to fill the batch.
+ */
+static int batch_worker_loop(policy_info_t *pol, lmgr_t *lmgr)
+{
+    unsigned int  batch_max = pol->config->action_batch_size;
+    unsigned int  count = 0;
+    entry_ctx_t  *batch;
+    void        **items;
+    unsigned int  nb_items = 0;
+    unsigned int  next_item = 0;
+    int           rc;
+    ull_t         db_ops = lmgr_op_count(lmgr);
+
+    batch = MemCalloc(batch_max, sizeof(*batch));
+    if (batch == NULL)
+        return ENOMEM;
+
+    items = MemCalloc(batch_max, sizeof(*items));
+    if (items == NULL)
+    {
+        MemFree(batch);
+        return ENOMEM;
+    }
+
+    while (1)
+    {
+        entry_ctx_t *ctx;
+
+        throttle_db_ops(pol, lmgr, &db_ops);
+
+        if (next_item >= nb_items)
+        {
+            next_item = 0;
+            /* don't wait for new entries while a batch is pending */
+            rc = Queue_GetBatch(worker_queue(pol), items, batch_max - count,
+                                &nb_items, count == 0);
+            if (rc == EAGAIN)
+            {
+                run_batch_action(pol, lmgr, batch, count);
+                count = 0;
+                continue;
+            }
+            else if (rc)
+                break;
+        }
+
+        ctx = &batch[count];
+        entry_ctx_init(ctx, (queue_item_t *)items[next_item++]);
+
+        if (check_entry_action(pol, lmgr, ctx) != AS_OK)
+        {
+            /* already acknowledged */
+            entry_ctx_release(ctx, true);
+            continue;
+        }
+
+        if (!entry_batchable(pol, ctx))
+        {
+            run_entry_action(pol, lmgr, ctx);
+            entry_ctx_release(ctx, true);
+            continue;
+        }
+
+        if (count > 0 && !batch_compatible(pol, &batch[0], ctx))
+        {
+            /* submit the current batch and start a new one */
+            entry_ctx_t tmp = *ctx;
+
+            run_batch_action(pol, lmgr, batch, count);
+            batch[0] = tmp;
+            count = 0;
+        }
+        count++;
+
+        if (count >= batch_max)
+        {
+            run_batch_action(pol, lmgr, batch, count);
+            count = 0;
+        }
+    }
+
+    MemFree(items);
+    MemFree(batch);
+    return rc;
+}
 
 /**
  *  Main routine of policy thread
@@ -2433,6 +3248,7 @@ static void   *thr_policy_run(void *arg)
     lmgr_t         lmgr;
     void          *p_queue_entry;
     policy_info_t *pol = (policy_info_t*)arg;
+    ull_t          db_ops;
 
     rc = ListMgr_InitAccess(&lmgr);
     if (rc)
@@ -2440,9 +3256,18 @@ static void   *thr_policy_run(void *arg)
         DisplayLog(LVL_CRIT, tag(pol), "Could not connect to database (error %d). Exiting.", rc);
         exit(rc);
     }
+    db_ops = lmgr_op_count(&lmgr);
 
-    while (Queue_Get(&pol->queue, &p_queue_entry) == 0)
-        process_entry(pol, &lmgr, (queue_item_t *)p_queue_entry, true);
+    if (pol->config->action_batch_size > 1
+        && pol->descr->status_mgr != NULL
+        && pol->descr->status_mgr->sm->batch_executor != NULL)
+        batch_worker_loop(pol, &lmgr);
+    else
+        while (Queue_Get(worker_queue(pol), &p_queue_entry) == 0)
+        {
+            process_entry(pol, &lmgr, (queue_item_t *)p_queue_entry, true);
+            throttle_db_ops(pol, &lmgr, &db_ops);
+        }
 
     /* Error occurred in purge queue management... */
     DisplayLog(LVL_CRIT, tag(pol), "An error occurred in policy run queue management. Exiting.");
@@ -2450,10 +3275,90 @@ static void   *thr_policy_run(void *arg)
     return NULL;                /* for avoiding compiler warnings */
 }
 
+/**
+ * Prefetch thread: check entries of the policy queue in advance
+ * (lstat, status...), so that metadata latency overlaps with the
+ * execution of actions by workers.
+ * The number of checked entries waiting for a worker is bounded by
+ * the size of the checked queue, so checked attributes don't get stale.
+ */
+static void *thr_check_prefetch(void *arg)
+{
+    int            rc;
+    lmgr_t         lmgr;
+    void          *p_queue_entry;
+    policy_info_t *pol = (policy_info_t*)arg;
+    ull_t          db_ops;
+
+    rc = ListMgr_InitAccess(&lmgr);
+    if (rc)
+    {
+        DisplayLog(LVL_CRIT, tag(pol), "Could not connect to database (error %d). Exiting.", rc);
+        exit(rc);
+    }
+    db_ops = lmgr_op_count(&lmgr);
+
+    while (Queue_Get(&pol->queue, &p_queue_entry) == 0)
+    {
+        queue_item_t *p_item = (queue_item_t *)p_queue_entry;
+
+        /* aborted runs and deleted entries are handled by workers */
+        if (!aborted(pol) && !pol->descr->manage_deleted)
+        {
+            p_item->check_rc = check_entry(pol, &lmgr, p_item, &p_item->check_attr);
+            p_item->checked = true;
+            throttle_db_ops(pol, &lmgr, &db_ops);
+        }
+
+        if (Queue_Insert(&pol->checked_queue, p_item) != 0)
+            break;
+    }
+
+    DisplayLog(LVL_CRIT, tag(pol), "An error occurred in policy run queue management. Exiting.");
+    exit(-1);
+    return NULL;                /* for avoiding compiler warnings */
+}
+
 int start_worker_threads(policy_info_t *pol)
 {
     unsigned int i;
 
+    throttle_init(pol);
+
+    if (pol->config->check_prefetch > 0)
+    {
+        int rc;
+
+        /* statuses and feedback are only accounted in the main queue */
+        rc = CreateQueue(&pol->checked_queue, pol->config->check_prefetch, 0, 0);
+        if (rc)
+        {
+            DisplayLog(LVL_CRIT, tag(pol), "Error %d initializing prefetch queue", rc);
+            return rc;
+        }
+
+        pol->prefetch_threads = (pthread_t *)MemCalloc(pol->config->nb_threads,
+                                                       sizeof(pthread_t));
+        if (!pol->prefetch_threads)
+        {
+            DisplayLog(LVL_CRIT, tag(pol), "Memory error in %s", __FUNCTION__);
+            return ENOMEM;
+        }
+
+        for (i = 0; i < pol->config->nb_threads; i++)
+        {
+            if (pthread_create(&pol->prefetch_threads[i], NULL,
+                               thr_check_prefetch, pol) != 0)
+            {
+                rc = errno;
+                DisplayLog(LVL_CRIT, tag(pol),
+                           "Error %d creating prefetch threads in %s: %s", rc,
+                           __FUNCTION__, strerror(rc));
+                return rc;
+            }
+        }
+    }
+
     pol->threads = (pthread_t *)MemCalloc(pol->config->nb_threads,
                                           sizeof(pthread_t));
     if (!pol->threads)
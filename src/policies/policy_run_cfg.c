@@ -24,6 +24,7 @@
 
 #define PARAM_SUFFIX   "_parameters"
 #define TRIGGER_SUFFIX       "_trigger"
+#define SCHED_BLOCK    "policy_scheduler"
 
 #define TAG       "PolicyRunCfg"
 
@@ -37,13 +38,22 @@ static int polrun_set_default(const policy_descr_t *pol, policy_run_config_t *cf
     cfg->nb_threads = 4;
     cfg->queue_size = 4096;
     cfg->db_request_limit = 100000;
+    cfg->action_batch_size = 1; /* no batching */
+    cfg->check_prefetch = 0; /* disabled */
+    cfg->priority = 0;
+    cfg->shared_scan = false;
     cfg->max_action_nbr = 0; /* unlimited */
     cfg->max_action_vol = 0; /* unlimited */
+    cfg->max_action_rate = 0.0; /* unlimited */
+    cfg->max_bandwidth = 0; /* unlimited */
+    cfg->max_db_op_rate = 0.0; /* unlimited */
+    cfg->target_action_latency = 0.0; /* disabled */
 
     cfg->trigger_list = NULL;
     cfg->trigger_count = 0;
 
     cfg->report_interval = 10 * 60; /* 10 min */
+    cfg->usage_cache_max_age = 0; /* disabled */
 
     cfg->pre_maintenance_window = 0; /* disabled */
     cfg->maint_min_apply_delay = 30 * 60; /* 30 min */
@@ -76,6 +86,9 @@ static void policy_run_cfg_set_default(void *module_config)
 
     for (i = 0; i < cfg->count; i++)
         polrun_set_default(&policies.policy_list[i], &cfg->configs[i]);
+
+    cfg->max_running_actions = 0; /* no limit */
+    cfg->shared_scan_delay = 10;
 }
 
 static void *policy_run_cfg_new(void)
@@ -101,9 +114,14 @@ static void policy_run_cfg_write_default(FILE *output)
     print_line(output, 1, "lru_sort_attr           : default_lru_sort_attr (from 'define_policy' block)");
     print_line(output, 1, "max_action_count        : 0 (unlimited)");
     print_line(output, 1, "max_action_volume       : 0 (unlimited)");
+    print_line(output, 1, "max_action_rate         : 0 (unlimited)");
+    print_line(output, 1, "max_bandwidth           : 0 (unlimited)");
+    print_line(output, 1, "max_db_op_rate          : 0 (unlimited)");
+    print_line(output, 1, "target_action_latency   : 0 (disabled)");
     print_line(output, 1, "suspend_error_pct       : disabled (0)");
     print_line(output, 1, "suspend_error_min       : disabled (0)");
     print_line(output, 1, "report_interval         : 10min");
+    print_line(output, 1, "usage_cache_max_age     : 0 (disabled)");
     print_line(output, 1, "check_actions_on_startup: no");
     print_line(output, 1, "check_actions_interval  : 0 (disabled)");
     print_line(output, 1, "action_timeout          : 2h");
@@ -112,10 +130,20 @@ static void policy_run_cfg_write_default(FILE *output)
     print_line(output, 1, "nb_threads              : 4");
     print_line(output, 1, "queue_size              : 4096");
     print_line(output, 1, "db_result_size_max      : 100000");
+    print_line(output, 1, "action_batch_size       : 1 (no batching)");
+    print_line(output, 1, "check_prefetch          : 0 (disabled)");
+    print_line(output, 1, "priority                : 0");
+    print_line(output, 1, "shared_scan             : no");
     print_line(output, 1, "pre_maintenance_window  : 0 (disabled)");
     print_line(output, 1, "maint_min_apply_delay   : 30min");
     print_end_block(output, 0);
     fprintf(output, "\n");
+
+    print_begin_block(output, 0, SCHED_BLOCK, NULL);
+    print_line(output, 1, "max_running_actions     : 0 (unlimited)");
+    print_line(output, 1, "shared_scan_delay       : 10s");
+    print_end_block(output, 0);
+    fprintf(output, "\n");
 }
 
 static void policy_run_cfg_write_template(FILE *output)
@@ -130,6 +158,16 @@ static void policy_run_cfg_write_template(FILE *output)
     print_line(output, 1, "# maximum volume of processed files per policy run (default: no limit)");
     print_line(output, 1, "#max_action_volume = 10TB ;");
     fprintf(output, "\n");
+    print_line(output, 1, "# sustained rate limits while the policy runs (default: no limit):");
+    print_line(output, 1, "# actions per second, processed volume per second,");
+    print_line(output, 1, "# database operations per second");
+    print_line(output, 1, "#max_action_rate = 500 ;");
+    print_line(output, 1, "#max_bandwidth = 1GB ;");
+    print_line(output, 1, "#max_db_op_rate = 2000 ;");
+    print_line(output, 1, "# run less actions at once when their average latency");
+    print_line(output, 1, "# exceeds this value (in seconds, default: disabled)");
+    print_line(output, 1, "#target_action_latency = 0.5 ;");
+    fprintf(output, "\n");
     print_line(output, 1, "# nbr of threads to execute policy actions" );
     print_line(output, 1, "#nb_threads = 8;");
     fprintf(output, "\n");
@@ -138,6 +176,12 @@ static void policy_run_cfg_write_template(FILE *output)
     print_line(output, 1, "#suspend_error_min = 100 ;");
     print_line(output, 1, "# interval to report policy run progress:");
     print_line(output, 1, "#report_interval = 10min;");
+    print_line(output, 1, "# keep user/group usage in memory for checking triggers.");
+    print_line(output, 1, "# It is updated by the entry processor, and fully reloaded");
+    print_line(output, 1, "# from the database after this delay");
+    print_line(output, 1, "# (0 = query the database at each trigger check).");
+    print_line(output, 1, "# Only used if a scan or changelog reader runs in the same process:");
+    print_line(output, 1, "#usage_cache_max_age = 1d;");
     print_line(output, 1, "# cancel an action after a given time:");
     print_line(output, 1, "#action_timeout = 2h;");
     print_line(output, 1, "# interval to check the status of started actions");
@@ -162,6 +206,30 @@ static void policy_run_cfg_write_template(FILE *output)
     print_line(output, 1, "# internal/tuning parameters");
     print_line(output, 1, "#queue_size = 4096;");
     print_line(output, 1, "#db_result_size_max = 100000;");
+    print_line(output, 1, "# max number of entries submitted at once to status");
+    print_line(output, 1, "# managers that support batched actions (e.g. lhsm)");
+    print_line(output, 1, "#action_batch_size = 1;");
+    print_line(output, 1, "# number of queued entries checked in advance (lstat, status)");
+    print_line(output, 1, "# while workers run actions (0 = check entries in workers)");
+    print_line(output, 1, "#check_prefetch = 0;");
+    fprintf(output, "\n");
+    print_line(output, 1, "# priority to run actions when '" SCHED_BLOCK "::max_running_actions'");
+    print_line(output, 1, "# is set (higher first)");
+    print_line(output, 1, "#priority = 0;");
+    print_line(output, 1, "# list candidates in a single DB scan with other policies");
+    print_line(output, 1, "# that start running at the same time");
+    print_line(output, 1, "#shared_scan = no;");
+    print_line(output, 0, "#}");
+    fprintf(output, "\n");
+
+    print_line(output, 0, "#" SCHED_BLOCK " {");
+    print_line(output, 1, "# max number of actions running at once for all policies.");
+    print_line(output, 1, "# Workers of all policies (nb_threads) share these action");
+    print_line(output, 1, "# slots, according to policy priorities (0 = no limit).");
+    print_line(output, 1, "#max_running_actions = 0;");
+    print_line(output, 1, "# time a policy run waits for other policies with 'shared_scan'");
+    print_line(output, 1, "# enabled, to list their candidates in a single DB scan");
+    print_line(output, 1, "#shared_scan_delay = 10s;");
     print_line(output, 0, "#}");
     fprintf(output, "\n");
 
@@ -420,6 +488,7 @@ static int parse_trigger_block(config_item_t config_blk, const char *block_name,
         "high_threshold_cnt", "low_threshold_cnt",
         "alert_high", "alert_low", "post_trigger_wait",
         "action_params", "max_action_count", "max_action_volume",
+        "predict_horizon", "min_check_interval",
         NULL
     };
 
@@ -436,6 +505,10 @@ static int parse_trigger_block(config_item_t config_blk, const char *block_name,
             &p_trigger_item->alert_lw, 0},
         {"post_trigger_wait",   PT_DURATION, 0,
             &p_trigger_item->post_trigger_wait, 0},
+        {"predict_horizon",     PT_DURATION, 0,
+            &p_trigger_item->predict_horizon, 0},
+        {"min_check_interval",  PT_DURATION, PFLG_POSITIVE,
+            &p_trigger_item->min_check_interval, 0},
         END_OF_PARAMS
     };
 
@@ -486,6 +559,34 @@ static int parse_trigger_block(config_item_t config_blk, const char *block_name,
     if (rc)
         return rc;
 
+    if (p_trigger_item->predict_horizon > 0)
+    {
+        /* usage must be sampled with a single statfs-like call */
+        if ((p_trigger_item->trigger_type != TRIG_CONDITION)
+            || (p_trigger_item->hw_type == COUNT_THRESHOLD)
+            || ((p_trigger_item->target_type != TGT_FS)
+#ifdef _LUSTRE
+                && (p_trigger_item->target_type != TGT_OST)
+                && (p_trigger_item->target_type != TGT_POOL)
+#endif
+               ))
+        {
+            strcpy(msg_out, "predict_horizon is only supported for global_usage, "
+                   "ost_usage and pool_usage triggers with volume or percentage "
+                   "thresholds");
+            return EINVAL;
+        }
+
+        /* default: sample up to 10 times per check_interval */
+        if (p_trigger_item->min_check_interval == 0)
+            p_trigger_item->min_check_interval =
+                MAX2(1, p_trigger_item->check_interval / 10);
+        else if (p_trigger_item->min_check_interval >
+                 p_trigger_item->check_interval)
+            p_trigger_item->min_check_interval =
+                p_trigger_item->check_interval;
+    }
+
     /* get action_params subblock */
     bool unique = true;
     params_block = rh_config_GetItemByName(config_blk, "action_params", &unique);
@@ -543,7 +644,11 @@ static int polrun_read_config(config_file_t config, const char *policy_name,
         "check_actions_interval", "check_actions_on_startup",
         "recheck_ignored_entries", "report_actions",
         "pre_maintenance_window", "maint_min_apply_delay", "queue_size",
-        "db_result_size_max", "action_params", "action",
+        "db_result_size_max", "action_batch_size", "usage_cache_max_age",
+        "check_prefetch", "priority", "shared_scan",
+        "max_action_rate", "max_bandwidth", "max_db_op_rate",
+        "target_action_latency",
+        "action_params", "action",
         "recheck_ignored_classes", /* for compat */
         NULL
     };
@@ -554,6 +659,14 @@ static int polrun_read_config(config_file_t config, const char *policy_name,
             &conf->max_action_nbr, 0},
         {"max_action_volume",   PT_SIZE,    PFLG_POSITIVE,
             &conf->max_action_vol, 0},
+        {"max_action_rate",     PT_FLOAT,   PFLG_POSITIVE,
+            &conf->max_action_rate, 0},
+        {"max_bandwidth",       PT_SIZE,    PFLG_POSITIVE,
+            &conf->max_bandwidth, 0},
+        {"max_db_op_rate",      PT_FLOAT,   PFLG_POSITIVE,
+            &conf->max_db_op_rate, 0},
+        {"target_action_latency", PT_FLOAT, PFLG_POSITIVE,
+            &conf->target_action_latency, 0},
         {"nb_threads",          PT_INT,     PFLG_POSITIVE | PFLG_NOT_NULL,
             &conf->nb_threads, 0},
         {"suspend_error_pct",   PT_FLOAT,   PFLG_POSITIVE | PFLG_ALLOW_PCT_SIGN,
@@ -579,6 +692,15 @@ static int polrun_read_config(config_file_t config, const char *policy_name,
             &conf->queue_size, 0},
         {"db_result_size_max",  PT_INT, PFLG_POSITIVE,
             &conf->db_request_limit, 0},
+        {"action_batch_size",   PT_INT, PFLG_POSITIVE | PFLG_NOT_NULL,
+            &conf->action_batch_size, 0},
+        {"usage_cache_max_age", PT_DURATION, PFLG_POSITIVE,
+            &conf->usage_cache_max_age, 0},
+        {"check_prefetch",      PT_INT, PFLG_POSITIVE,
+            &conf->check_prefetch, 0},
+        {"priority",            PT_INT, PFLG_POSITIVE,
+            &conf->priority, 0},
+        {"shared_scan",         PT_BOOL, 0, &conf->shared_scan, 0},
 
         {NULL, 0, 0, NULL, 0}
     };
@@ -714,6 +836,40 @@ static int polrun_read_triggers(config_file_t config, const char *policy_name,
     return 0;
 }
 
+/* read parameters common to all policies */
+static int polsched_read_config(config_file_t config,
+                                policy_run_config_list_t *allconf,
+                                char *msg_out)
+{
+    int            rc;
+    config_item_t  sched_block;
+
+    static const char *allowed[] = {
+        "max_running_actions", "shared_scan_delay", NULL
+    };
+
+    const cfg_param_t cfg_params[] = {
+        {"max_running_actions", PT_INT,      PFLG_POSITIVE,
+            &allconf->max_running_actions, 0},
+        {"shared_scan_delay",   PT_DURATION, PFLG_POSITIVE,
+            &allconf->shared_scan_delay, 0},
+
+        {NULL, 0, 0, NULL, 0}
+    };
+
+    rc = get_cfg_block(config, SCHED_BLOCK, &sched_block, msg_out);
+    if (rc)
+        return rc == ENOENT ? 0 : rc; /* not mandatory */
+
+    rc = read_scalar_params(sched_block, SCHED_BLOCK, cfg_params, msg_out);
+    if (rc)
+        return rc;
+
+    CheckUnknownParameters(sched_block, SCHED_BLOCK, allowed);
+
+    return 0;
+}
+
 /* read the run cfg for all policies */
 static int policy_run_cfg_read(config_file_t config, void *module_config, char *msg_out)
 {
@@ -738,7 +894,7 @@ static int policy_run_cfg_read(config_file_t config, void *module_config, char *
         if (rc)
             return rc;
     }
-    return 0;
+    return polsched_read_config(config, allconf, msg_out);
 }
 
 #define NO_TRIG_UPDT_MSG(_what) DisplayLog(LVL_MAJOR, TAG, _what \
@@ -782,7 +938,8 @@ static void update_triggers(trigger_item_t *trigger_tgt, unsigned int count_tgt,
     }
 
     /* triggers have the same type: update simple parameters:
-     * max_action_count, max_action_volume, check_interval, alert_high, alert_low, post_trigger_wait */
+     * max_action_count, max_action_volume, check_interval, alert_high, alert_low, post_trigger_wait,
+     * predict_horizon, min_check_interval */
     for (i = 0; i < count_new; i++)
     {
         char tname[256];
@@ -817,6 +974,21 @@ static void update_triggers(trigger_item_t *trigger_tgt, unsigned int count_tgt,
             trigger_tgt[i].post_trigger_wait = trigger_new[i].post_trigger_wait;
         }
 
+        if (trigger_new[i].predict_horizon != trigger_tgt[i].predict_horizon)
+        {
+            DisplayLog(LVL_EVENT, TAG, "predict_horizon updated for trigger %s: %lu->%lu",
+                       tname, trigger_tgt[i].predict_horizon, trigger_new[i].predict_horizon);
+            trigger_tgt[i].predict_horizon = trigger_new[i].predict_horizon;
+        }
+
+        if (trigger_new[i].min_check_interval != trigger_tgt[i].min_check_interval)
+        {
+            DisplayLog(LVL_EVENT, TAG, "min_check_interval updated for trigger %s: %lu->%lu",
+                       tname, trigger_tgt[i].min_check_interval,
+                       trigger_new[i].min_check_interval);
+            trigger_tgt[i].min_check_interval = trigger_new[i].min_check_interval;
+        }
+
         if (trigger_new[i].alert_hw != trigger_tgt[i].alert_hw)
         {
             DisplayLog(LVL_EVENT, TAG, "alert_high updated for trigger %s: %s->%s",
@@ -956,6 +1128,33 @@ static int polrun_reload(const char *blkname, policy_run_config_t *cfg_tgt,
     if (cfg_tgt->queue_size != cfg_new->queue_size)
         NO_PARAM_UPDT_MSG(blkname, "queue_size");
 
+    if (cfg_tgt->action_batch_size != cfg_new->action_batch_size)
+        NO_PARAM_UPDT_MSG(blkname, "action_batch_size");
+
+    if (cfg_tgt->check_prefetch != cfg_new->check_prefetch)
+        NO_PARAM_UPDT_MSG(blkname, "check_prefetch");
+
+    /* running actions are only counted if it is enabled */
+    if ((cfg_tgt->target_action_latency == 0.0)
+        != (cfg_new->target_action_latency == 0.0))
+        NO_PARAM_UPDT_MSG(blkname, "target_action_latency");
+    else if (cfg_tgt->target_action_latency != cfg_new->target_action_latency)
+    {
+        PARAM_UPDT_MSG(blkname, "target_action_latency", "%.3f",
+                       cfg_tgt->target_action_latency,
+                       cfg_new->target_action_latency);
+        cfg_tgt->target_action_latency = cfg_new->target_action_latency;
+    }
+
+    /* scans are joined at the beginning of policy runs */
+    if (cfg_tgt->shared_scan != cfg_new->shared_scan)
+    {
+        PARAM_UPDT_MSG(blkname, "shared_scan", "%s",
+                       bool2str(cfg_tgt->shared_scan),
+                       bool2str(cfg_new->shared_scan));
+        cfg_tgt->shared_scan = cfg_new->shared_scan;
+    }
+
 // FIXME can change action functions, but not cmd string
 //    if (strcmp(cfg_new->default_action, cfg_tgt->default_action))
 //        NO_PARAM_UPDT_MSG(blkname, "default_action");
@@ -966,6 +1165,13 @@ static int polrun_reload(const char *blkname, policy_run_config_t *cfg_tgt,
         NO_PARAM_UPDT_MSG(blkname, "lru_sort_attr");
 
     /* dynamic parameters */
+    if (cfg_tgt->priority != cfg_new->priority)
+    {
+        PARAM_UPDT_MSG(blkname, "priority", "%u",
+                       cfg_tgt->priority, cfg_new->priority);
+        cfg_tgt->priority = cfg_new->priority;
+    }
+
     if (cfg_tgt->max_action_nbr != cfg_new->max_action_nbr)
     {
         PARAM_UPDT_MSG(blkname, "max_action_count", "%u",
@@ -980,6 +1186,27 @@ static int polrun_reload(const char *blkname, policy_run_config_t *cfg_tgt,
         cfg_tgt->max_action_vol = cfg_new->max_action_vol;
     }
 
+    if (cfg_tgt->max_action_rate != cfg_new->max_action_rate)
+    {
+        PARAM_UPDT_MSG(blkname, "max_action_rate", "%.2f",
+                       cfg_tgt->max_action_rate, cfg_new->max_action_rate);
+        cfg_tgt->max_action_rate = cfg_new->max_action_rate;
+    }
+
+    if (cfg_tgt->max_bandwidth != cfg_new->max_bandwidth)
+    {
+        PARAM_UPDT_MSG(blkname, "max_bandwidth", "%llu",
+                       cfg_tgt->max_bandwidth, cfg_new->max_bandwidth);
+        cfg_tgt->max_bandwidth = cfg_new->max_bandwidth;
+    }
+
+    if (cfg_tgt->max_db_op_rate != cfg_new->max_db_op_rate)
+    {
+        PARAM_UPDT_MSG(blkname, "max_db_op_rate", "%.2f",
+                       cfg_tgt->max_db_op_rate, cfg_new->max_db_op_rate);
+        cfg_tgt->max_db_op_rate = cfg_new->max_db_op_rate;
+    }
+
     if (cfg_tgt->suspend_error_pct != cfg_new->suspend_error_pct)
     {
         PARAM_UPDT_MSG(blkname, "suspend_error_pct", "%.2f%%",
@@ -1001,6 +1228,13 @@ static int polrun_reload(const char *blkname, policy_run_config_t *cfg_tgt,
         cfg_tgt->report_interval = cfg_new->report_interval;
     }
 
+    if (cfg_tgt->usage_cache_max_age != cfg_new->usage_cache_max_age)
+    {
+        PARAM_UPDT_MSG(blkname, "usage_cache_max_age", "%lu",
+                       cfg_tgt->usage_cache_max_age, cfg_new->usage_cache_max_age);
+        cfg_tgt->usage_cache_max_age = cfg_new->usage_cache_max_age;
+    }
+
     if (cfg_tgt->action_timeout != cfg_new->action_timeout)
     {
         PARAM_UPDT_MSG(blkname, "action_timeout", "%lu",
@@ -1103,6 +1337,17 @@ static int policy_run_cfg_reload(policy_run_config_list_t *conf)
         }
     }
 
+    /* action slots are counted according to the initial limit */
+    if (conf->max_running_actions != run_cfgs.max_running_actions)
+        NO_PARAM_UPDT_MSG(SCHED_BLOCK, "max_running_actions");
+
+    if (conf->shared_scan_delay != run_cfgs.shared_scan_delay)
+    {
+        PARAM_UPDT_MSG(SCHED_BLOCK, "shared_scan_delay", "%lu",
+                       run_cfgs.shared_scan_delay, conf->shared_scan_delay);
+        run_cfgs.shared_scan_delay = conf->shared_scan_delay;
+    }
+
     /* policy runs may not be in the same order as policies and run_cfgs */
 //    FIXME RBHv3
 //    if (chgd && policy_runs.runs != NULL)
@@ -0,0 +1,657 @@
+/* -*- mode: c; c-basic-offset: 4; indent-tabs-mode: nil; -*-
+ * vim:expandtab:shiftwidth=4:tabstop=4:
+ */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the CeCILL License.
+ *
+ * The fact that you are presently reading this means that you have had
+ * knowledge of the CeCILL license (http://www.cecill.info) and that you
+ * accept its terms.
+ */
+
+/**
+ * \file policy_sched.c
+ * \brief Scheduling of concurrent policy runs:
+ *  - action slots shared by the workers of all policies, by priority;
+ *  - candidate scans shared by policy runs starting at the same time.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include "policy_run.h"
+#include "run_policies.h"
+#include "list_mgr.h"
+#include "rbh_logs.h"
+#include "rbh_misc.h"
+#include "Memory.h"
+
+#include <errno.h>
+#include <pthread.h>
+#include <string.h>
+
+#define TAG "PolicySched"
+#define tag(_p)             ((_p)->descr->name)
+
+/* ------------- action slots --------------- */
+
+static pthread_mutex_t slot_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t  slot_cond = PTHREAD_COND_INITIALIZER;
+static unsigned int    running_actions = 0;
+
+/* running policies */
+static policy_info_t **sched_policies = NULL;
+static unsigned int    sched_policy_count = 0;
+
+int sched_register_policy(policy_info_t *pol)
+{
+    policy_info_t **new_list;
+
+    pthread_mutex_lock(&slot_lock);
+    new_list = MemRealloc(sched_policies,
+                          (sched_policy_count + 1) * sizeof(*new_list));
+    if (new_list == NULL)
+    {
+        pthread_mutex_unlock(&slot_lock);
+        return ENOMEM;
+    }
+    new_list[sched_policy_count] = pol;
+    sched_policies = new_list;
+    sched_policy_count++;
+    pthread_mutex_unlock(&slot_lock);
+
+    return 0;
+}
+
+/** check if workers of a policy with a higher priority are waiting.
+ * Must be called with slot_lock held. */
+static bool higher_prio_waiting(unsigned int prio)
+{
+    unsigned int i;
+
+    for (i = 0; i < sched_policy_count; i++)
+    {
+        if (sched_policies[i]->sched_waiting > 0
+            && sched_policies[i]->config->priority > prio)
+            return true;
+    }
+    return false;
+}
+
+void sched_action_start(policy_info_t *pol)
+{
+    if (run_cfgs.max_running_actions == 0)
+        return;
+
+    pthread_mutex_lock(&slot_lock);
+    pol->sched_waiting++;
+    while (running_actions >= run_cfgs.max_running_actions
+           || higher_prio_waiting(pol->config->priority))
+        pthread_cond_wait(&slot_cond, &slot_lock);
+    pol->sched_waiting--;
+    running_actions++;
+    pthread_mutex_unlock(&slot_lock);
+}
+
+void sched_action_end(policy_info_t *pol)
+{
+    if (run_cfgs.max_running_actions == 0)
+        return;
+
+    pthread_mutex_lock(&slot_lock);
+    running_actions--;
+    /* waiters have different conditions, depending on their priority */
+    pthread_cond_broadcast(&slot_cond);
+    pthread_mutex_unlock(&slot_lock);
+}
+
+/* ------------- shared candidate scans --------------- */
+
+/** entry dispatched to a consumer */
+typedef struct shared_item {
+    entry_id_t  id;
+    attr_set_t  attrs;
+} shared_item_t;
+
+struct shared_scan;
+
+/** a policy run listing its candidates from a shared scan */
+struct shared_consumer {
+    policy_info_t        *pol;
+    struct shared_scan   *scan;
+    struct shared_consumer *next;
+
+    /* bounded FIFO of entries (protected by the scan lock) */
+    shared_item_t       **items;
+    unsigned int          size;
+    unsigned int          first;
+    unsigned int          count;
+    pthread_cond_t        not_empty;
+    pthread_cond_t        not_full;
+
+    bool                  detached; /* the policy run stopped listing */
+    unsigned long long    dispatched;
+};
+
+typedef struct shared_scan {
+    pthread_mutex_t     lock;
+    pthread_cond_t      start_cond;
+    unsigned int        sort_attr;
+    attr_mask_t         attr_mask; /* union of consumers' masks */
+
+    struct shared_consumer *consumers;
+    unsigned int        consumer_count;
+    unsigned int        active; /* consumers that are not detached */
+    unsigned int        refcount; /* consumers + scanner thread */
+
+    bool                started;
+    bool                done;
+    int                 rc; /* DB error, if any */
+
+    struct shared_scan *next_pending;
+} shared_scan_t;
+
+/* scans waiting for consumers to join */
+static pthread_mutex_t pending_lock = PTHREAD_MUTEX_INITIALIZER;
+static shared_scan_t  *pending_scans = NULL;
+
+static void free_item(shared_item_t *item)
+{
+    ListMgr_FreeAttrs(&item->attrs);
+    MemFree(item);
+}
+
+static shared_consumer_t *consumer_new(policy_info_t *pol)
+{
+    shared_consumer_t *cons;
+
+    cons = MemCalloc(1, sizeof(*cons));
+    if (cons == NULL)
+        return NULL;
+
+    cons->size = pol->config->queue_size;
+    cons->items = MemCalloc(cons->size, sizeof(*cons->items));
+    if (cons->items == NULL)
+    {
+        MemFree(cons);
+        return NULL;
+    }
+    cons->pol = pol;
+    pthread_cond_init(&cons->not_empty, NULL);
+    pthread_cond_init(&cons->not_full, NULL);
+    return cons;
+}
+
+static void consumer_free(shared_consumer_t *cons)
+{
+    while (cons->count > 0)
+    {
+        free_item(cons->items[cons->first]);
+        cons->first = (cons->first + 1) % cons->size;
+        cons->count--;
+    }
+    pthread_cond_destroy(&cons->not_empty);
+    pthread_cond_destroy(&cons->not_full);
+    MemFree(cons->items);
+    MemFree(cons);
+}
+
+/** release a reference to a scan. Must be called with the scan lock held.
+ * The lock is released. */
+static void scan_release(shared_scan_t *scan)
+{
+    shared_consumer_t *cons, *next;
+
+    scan->refcount--;
+    if (scan->refcount > 0)
+    {
+        pthread_mutex_unlock(&scan->lock);
+        return;
+    }
+    pthread_mutex_unlock(&scan->lock);
+
+    for (cons = scan->consumers; cons != NULL; cons = next)
+    {
+        next = cons->next;
+        consumer_free(cons);
+    }
+    pthread_cond_destroy(&scan->start_cond);
+    pthread_mutex_destroy(&scan->lock);
+    MemFree(scan);
+}
+
+/** check if an entry is worth pushing to the workers of a policy */
+static bool consumer_match(const shared_consumer_t *cons,
+                           const entry_id_t *id, const attr_set_t *attrs)
+{
+    policy_info_t  *pol = cons->pol;
+    fileset_item_t *fileset = NULL;
+
+    if (match_scope(pol->descr, id, attrs, false) == POLICY_NO_MATCH)
+        return false;
+
+    if (pol->flags & RUNFLG_IGNORE_POL)
+        return true;
+
+    return policy_match_all(pol->descr, id, attrs, pol->time_modifier,
+                            &fileset) != POLICY_NO_MATCH;
+}
+
+/** push an entry to a consumer. Must be called with the scan lock held.
+ * Entries for detached consumers are dropped. */
+static void consumer_push(shared_consumer_t *cons, const entry_id_t *id,
+                          const attr_set_t *attrs)
+{
+    shared_scan_t *scan = cons->scan;
+    shared_item_t *item;
+
+    while (cons->count == cons->size && !cons->detached)
+        pthread_cond_wait(&cons->not_full, &scan->lock);
+
+    if (cons->detached)
+        return;
+
+    item = MemAlloc(sizeof(*item));
+    if (item == NULL)
+        return;
+    item->id = *id;
+    /* consumers own their attributes */
+    memset(&item->attrs, 0, sizeof(item->attrs));
+    ListMgr_MergeAttrSets(&item->attrs, attrs, true);
+
+    cons->items[(cons->first + cons->count) % cons->size] = item;
+    cons->count++;
+    cons->dispatched++;
+    pthread_cond_signal(&cons->not_empty);
+}
+
+/** DB filter and request limit for the candidates of all consumers.
+ * Must be called with the scan lock held. */
+static int scan_filter(shared_scan_t *scan, lmgr_filter_t *filter,
+                       unsigned int *req_limit)
+{
+    shared_consumer_t *cons;
+    lmgr_or_expr_t    *scopes;
+    filter_value_t     fval;
+    unsigned int       i = 0;
+    int                rc;
+
+    fval.value.val_bool = false;
+    rc = lmgr_simple_filter_add(filter, ATTR_INDEX_invalid, EQUAL, fval,
+                                FILTER_FLAG_ALLOW_NULL);
+    if (rc)
+        return rc;
+
+    scopes = MemCalloc(scan->consumer_count, sizeof(*scopes));
+    if (scopes == NULL)
+        return DB_NO_MEMORY;
+
+    *req_limit = 0;
+    for (cons = scan->consumers; cons != NULL; cons = cons->next, i++)
+    {
+        policy_info_t *pol = cons->pol;
+
+        scopes[i].boolexpr = &pol->descr->scope;
+        scopes[i].smi = pol->descr->status_mgr;
+        scopes[i].time_mod = pol->time_modifier;
+
+        if (pol->config->db_request_limit > 0
+            && (*req_limit == 0 || pol->config->db_request_limit < *req_limit))
+            *req_limit = pol->config->db_request_limit;
+    }
+
+    /* rules are matched for each policy in consumer_match(),
+     * only the scopes can be pre-filtered by the DB */
+    rc = lmgr_pushdown_or(scopes, scan->consumer_count, filter);
+    if (rc == DB_INVALID_ARG)
+    {
+        DisplayLog(LVL_DEBUG, TAG, "Policy scopes can't be converted "
+                   "to a DB filter: listing all entries");
+        rc = 0;
+    }
+
+    MemFree(scopes);
+    return rc;
+}
+
+static void *shared_scan_thr(void *arg)
+{
+    shared_scan_t          *scan = arg;
+    shared_consumer_t      *cons;
+    struct lmgr_iterator_t *it;
+    lmgr_t                  lmgr;
+    lmgr_filter_t           filter;
+    lmgr_sort_type_t        sort_type;
+    lmgr_iter_opt_t         opt = LMGR_ITER_OPT_INIT;
+    entry_id_t              id;
+    attr_set_t              attrs;
+    attr_mask_t             attr_mask;
+    unsigned long long      listed = 0;
+    unsigned int            nb_returned;
+    bool                    more = true;
+    int                     rc, val;
+
+    rc = ListMgr_InitAccess(&lmgr);
+    if (rc)
+    {
+        DisplayLog(LVL_CRIT, TAG, "Could not connect to database (error %d)",
+                   rc);
+        goto out;
+    }
+
+    lmgr_simple_filter_init(&filter);
+    pthread_mutex_lock(&scan->lock);
+    rc = scan_filter(scan, &filter, &opt.list_count_max);
+    attr_mask = scan->attr_mask;
+    pthread_mutex_unlock(&scan->lock);
+    if (rc)
+        goto close;
+
+    sort_type.attr_index = scan->sort_attr;
+    sort_type.order = (scan->sort_attr == LRU_ATTR_NONE) ?
+                        SORT_NONE : SORT_ASC;
+    /* the sort value is needed to start the next request after
+     * the last listed entry */
+    if (scan->sort_attr != LRU_ATTR_NONE)
+        attr_mask_set_index(&attr_mask, scan->sort_attr);
+
+    /* entries are not updated by the scan: list them by pages
+     * in (sort attribute, id) order */
+    opt.keyset = 1;
+
+    while (more)
+    {
+        it = ListMgr_Iterator(&lmgr, &filter, &sort_type, &opt);
+        if (it == NULL)
+        {
+            DisplayLog(LVL_CRIT, TAG, "Error retrieving list of candidates "
+                       "from database.");
+            rc = DB_REQUEST_FAILED;
+            goto close;
+        }
+        nb_returned = 0;
+
+        do
+        {
+            memset(&attrs, 0, sizeof(attrs));
+            attrs.attr_mask = attr_mask;
+
+            rc = ListMgr_GetNext(it, &id, &attrs);
+            if (rc == DB_END_OF_LIST)
+            {
+                rc = 0;
+                /* last page */
+                if (opt.list_count_max == 0
+                    || nb_returned < opt.list_count_max)
+                    more = false;
+                break;
+            }
+            else if (rc != 0)
+            {
+                DisplayLog(LVL_CRIT, TAG, "Error %d getting next entry of "
+                           "iterator", rc);
+                more = false;
+                break;
+            }
+            listed++;
+            nb_returned++;
+
+            /* next request starts after this entry */
+            val = sort_attr_value(scan->sort_attr, &attrs);
+            opt.after_set = 1;
+            opt.after_null = (val == -1);
+            opt.after_val = val;
+            opt.after_id = id;
+
+            pthread_mutex_lock(&scan->lock);
+            for (cons = scan->consumers; cons != NULL; cons = cons->next)
+            {
+                if (!cons->detached && consumer_match(cons, &id, &attrs))
+                    consumer_push(cons, &id, &attrs);
+            }
+            /* stop when all policy runs stopped (limit reached, aborted...) */
+            more = (scan->active > 0);
+            pthread_mutex_unlock(&scan->lock);
+
+            ListMgr_FreeAttrs(&attrs);
+
+        } while (more);
+
+        ListMgr_CloseIterator(it);
+
+        if (more)
+            DisplayLog(LVL_DEBUG, TAG, "Performing new request with a limit "
+                       "of %u entries, after entry "DFID, opt.list_count_max,
+                       PFID(&opt.after_id));
+    }
+
+close:
+    lmgr_simple_filter_free(&filter);
+    ListMgr_CloseAccess(&lmgr);
+
+out:
+    pthread_mutex_lock(&scan->lock);
+    DisplayLog(LVL_EVENT, TAG, "Shared candidate scan done: %llu entries "
+               "listed", listed);
+    for (cons = scan->consumers; cons != NULL; cons = cons->next)
+    {
+        DisplayLog(LVL_EVENT, tag(cons->pol), "%llu entries dispatched from "
+                   "shared candidate scan", cons->dispatched);
+        pthread_cond_signal(&cons->not_empty);
+    }
+    scan->rc = rc;
+    scan->done = true;
+    scan_release(scan);
+
+    return NULL;
+}
+
+/** start listing candidates for all consumers of a scan */
+static int scan_start(shared_scan_t *scan)
+{
+    pthread_t          thr;
+    pthread_attr_t     attr;
+    shared_consumer_t *cons;
+    GString           *names = g_string_new(NULL);
+    int                rc;
+
+    for (cons = scan->consumers; cons != NULL; cons = cons->next)
+        g_string_append_printf(names, "%s%s", names->len > 0 ? ", " : "",
+                               tag(cons->pol));
+    DisplayLog(LVL_EVENT, TAG, "Starting shared candidate scan for "
+               "policies: %s", names->str);
+    g_string_free(names, TRUE);
+
+    pthread_attr_init(&attr);
+    pthread_attr_setdetachstate(&attr, PTHREAD_CREATE_DETACHED);
+
+    /* reference of the scanner thread */
+    scan->refcount++;
+    rc = pthread_create(&thr, &attr, shared_scan_thr, scan);
+    pthread_attr_destroy(&attr);
+    if (rc)
+    {
+        DisplayLog(LVL_CRIT, TAG, "Error creating shared scan thread: %s",
+                   strerror(rc));
+        scan->refcount--;
+        scan->rc = DB_REQUEST_FAILED;
+        scan->done = true;
+    }
+    return rc;
+}
+
+/** check if other running policies may join a scan of the given policy */
+static bool shared_scan_peers(const policy_info_t *pol)
+{
+    unsigned int i;
+    bool         found = false;
+
+    pthread_mutex_lock(&slot_lock);
+    for (i = 0; i < sched_policy_count && !found; i++)
+    {
+        const policy_info_t *other = sched_policies[i];
+
+        found = (other != pol && other->config->shared_scan
+                 && other->config->lru_sort_attr == pol->config->lru_sort_attr
+                 && !other->descr->manage_deleted
+                 && !(other->flags & (RUNFLG_ONCE | RUNFLG_SIMULATE)));
+    }
+    pthread_mutex_unlock(&slot_lock);
+
+    return found;
+}
+
+int shared_scan_join(policy_info_t *pol, attr_mask_t attr_mask,
+                     shared_consumer_t **p_cons)
+{
+    shared_scan_t     *scan;
+    shared_consumer_t *cons;
+    bool               leader = false;
+
+    *p_cons = NULL;
+
+    /* don't wait for policy runs that will never start */
+    if ((pol->flags & RUNFLG_ONCE) || !shared_scan_peers(pol))
+    {
+        DisplayLog(LVL_DEBUG, tag(pol), "No other policy to share "
+                   "candidate scan");
+        return 0;
+    }
+
+    cons = consumer_new(pol);
+    if (cons == NULL)
+        return ENOMEM;
+
+    pthread_mutex_lock(&pending_lock);
+    for (scan = pending_scans; scan != NULL; scan = scan->next_pending)
+        if (scan->sort_attr == pol->config->lru_sort_attr)
+            break;
+
+    if (scan == NULL)
+    {
+        scan = MemCalloc(1, sizeof(*scan));
+        if (scan == NULL)
+        {
+            pthread_mutex_unlock(&pending_lock);
+            consumer_free(cons);
+            return ENOMEM;
+        }
+        pthread_mutex_init(&scan->lock, NULL);
+        pthread_cond_init(&scan->start_cond, NULL);
+        scan->sort_attr = pol->config->lru_sort_attr;
+        scan->next_pending = pending_scans;
+        pending_scans = scan;
+        leader = true;
+    }
+
+    pthread_mutex_lock(&scan->lock);
+    cons->scan = scan;
+    cons->next = scan->consumers;
+    scan->consumers = cons;
+    scan->consumer_count++;
+    scan->active++;
+    scan->refcount++;
+    scan->attr_mask = attr_mask_or(&scan->attr_mask, &attr_mask);
+    pthread_mutex_unlock(&scan->lock);
+    pthread_mutex_unlock(&pending_lock);
+
+    if (!leader)
+    {
+        DisplayLog(LVL_EVENT, tag(pol), "Joining shared candidate scan");
+
+        pthread_mutex_lock(&scan->lock);
+        while (!scan->started)
+            pthread_cond_wait(&scan->start_cond, &scan->lock);
+        pthread_mutex_unlock(&scan->lock);
+
+        *p_cons = cons;
+        return 0;
+    }
+
+    DisplayLog(LVL_EVENT, tag(pol), "Waiting %lus for other policies to share "
+               "candidate scan", run_cfgs.shared_scan_delay);
+    rh_intr_sleep(run_cfgs.shared_scan_delay, pol->aborted);
+
+    /* no more consumers can join */
+    pthread_mutex_lock(&pending_lock);
+    if (pending_scans == scan)
+        pending_scans = scan->next_pending;
+    else
+    {
+        shared_scan_t *prev;
+
+        for (prev = pending_scans; prev->next_pending != scan;
+             prev = prev->next_pending)
+            ;
+        prev->next_pending = scan->next_pending;
+    }
+    pthread_mutex_unlock(&pending_lock);
+
+    pthread_mutex_lock(&scan->lock);
+    if (scan->consumer_count == 1)
+    {
+        /* nobody joined: the policy lists its own candidates */
+        DisplayLog(LVL_DEBUG, tag(pol), "No other policy to share "
+                   "candidate scan");
+        scan->active--;
+        scan->started = true;
+        scan_release(scan);
+        return 0;
+    }
+
+    scan->started = true;
+    scan_start(scan);
+    pthread_cond_broadcast(&scan->start_cond);
+    pthread_mutex_unlock(&scan->lock);
+
+    *p_cons = cons;
+    return 0;
+}
+
+int shared_scan_next(shared_consumer_t *cons, entry_id_t *p_id,
+                     attr_set_t *p_attrs)
+{
+    shared_scan_t *scan = cons->scan;
+    shared_item_t *item;
+    int            rc;
+
+    pthread_mutex_lock(&scan->lock);
+    while (cons->count == 0 && !scan->done)
+        pthread_cond_wait(&cons->not_empty, &scan->lock);
+
+    if (cons->count == 0)
+    {
+        rc = scan->rc ? scan->rc : DB_END_OF_LIST;
+        pthread_mutex_unlock(&scan->lock);
+        return rc;
+    }
+
+    item = cons->items[cons->first];
+    cons->first = (cons->first + 1) % cons->size;
+    cons->count--;
+    pthread_cond_signal(&cons->not_full);
+    pthread_mutex_unlock(&scan->lock);
+
+    *p_id = item->id;
+    *p_attrs = item->attrs;
+    MemFree(item);
+
+    return DB_SUCCESS;
+}
+
+void shared_scan_leave(shared_consumer_t *cons)
+{
+    shared_scan_t *scan = cons->scan;
+
+    pthread_mutex_lock(&scan->lock);
+    if (!cons->detached)
+    {
+        cons->detached = true;
+        scan->active--;
+    }
+    /* unblock the scanner if it is waiting for room in the FIFO */
+    pthread_cond_signal(&cons->not_full);
+    scan_release(scan);
+}
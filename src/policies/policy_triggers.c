@@ -23,6 +23,7 @@
 #include "rbh_misc.h"
 #include "policy_run.h"
 #include "run_policies.h"
+#include "usage_cache.h"
 #include "queue.h"
 #include "Memory.h"
 #include "xplatform_print.h"
@@ -42,6 +43,7 @@
 #define is_count_trigger(_t_) ((_t_)->hw_type == COUNT_THRESHOLD)
 #define check_only(_p) ((_p)->flags & RUNFLG_CHECK_ONLY)
 #define one_shot(_p) ((_p)->flags & RUNFLG_ONCE)
+#define simulate(_p) ((_p)->flags & RUNFLG_SIMULATE)
 
 static void update_trigger_status(policy_info_t *pol, int i, trigger_status_t state)
 {
@@ -835,6 +837,12 @@ typedef struct target_iterator_t {
         unsigned int is_checked;
         /* for DB report iterator */
         struct lmgr_report_t *db_report;
+        /* for usage cache iterator */
+        struct {
+            usage_item_t *items;
+            unsigned int  count;
+            unsigned int  next;
+        } usage;
 #ifdef _LUSTRE
         /* for OST iterator */
         struct ost_list ost_excl;
@@ -845,6 +853,8 @@ typedef struct target_iterator_t {
    /* for user and groups vol/pct thresholds: save high and low values (in blocks) */
    unsigned long long high_blk512;
    unsigned long long low_blk512;
+   /* user and group usage is read from the usage cache */
+   bool use_cache;
 } target_iterator_t;
 
 /** compute user blocks and save them into it structure */
@@ -889,6 +899,7 @@ static int trig_target_it(target_iterator_t *it, policy_info_t *pol,
      */
     it->trig = *trig;
     it->pol = pol;
+    it->use_cache = false;
 
     if (trig->trigger_type == TRIG_ALWAYS)
     {
@@ -923,6 +934,15 @@ static int trig_target_it(target_iterator_t *it, policy_info_t *pol,
         rc = compute_user_blocks(trig, it);
         if (rc)
             return rc;
+
+        it->use_cache = (pol->config->usage_cache_max_age > 0
+                         && usage_cache_enabled());
+        if (it->use_cache)
+            return usage_cache_select(&pol->lmgr, trig,
+                                      pol->config->usage_cache_max_age,
+                                      it->high_blk512, &it->info_u.usage.items,
+                                      &it->info_u.usage.count);
+
         build_user_report_descr(info, trig, it->high_blk512);
 
         lmgr_simple_filter_init(&filter);
@@ -1062,6 +1082,32 @@ static int trig_target_next(target_iterator_t *it, target_u *tgt,
         db_value_t     result[2];
         unsigned int   result_count = 2;
 
+        if (it->use_cache)
+        {
+            while (it->info_u.usage.next < it->info_u.usage.count)
+            {
+                usage_item_t *item =
+                        &it->info_u.usage.items[it->info_u.usage.next++];
+
+                result[0].value_u = item->id;
+                result[1].value_u.val_biguint = is_count_trigger(&it->trig) ?
+                                                    item->count : item->blocks;
+
+                rc = check_report_thresholds(&it->trig, result, result_count,
+                                             limit, tinfo, it->low_blk512,
+                                             it->high_blk512);
+                if (rc)
+                    return rc;
+
+                if (counter_is_set(limit))
+                {
+                    tgt->name = item->name;
+                    return 0; /* something is to be done */
+                }
+            }
+            return ENOENT;
+        }
+
         while ((rc = ListMgr_GetNextReportItem(it->info_u.db_report,
                         result, &result_count, NULL)) == DB_SUCCESS)
         {
@@ -1109,7 +1155,10 @@ static void trig_target_end(target_iterator_t *it)
 #endif
     case TGT_USER:
     case TGT_GROUP:
-        ListMgr_CloseReport(it->info_u.db_report);
+        if (it->use_cache)
+            usage_items_free(it->info_u.usage.items, it->info_u.usage.count);
+        else
+            ListMgr_CloseReport(it->info_u.db_report);
         break;
     default:
         /* nothing to do */
@@ -1118,6 +1167,284 @@ static void trig_target_end(target_iterator_t *it)
     return;
 }
 
+/* ------------ Predictive triggers ------------ */
+
+#define is_predictive(_t_)  ((_t_)->predict_horizon > 0)
+
+/** value of a threshold, in its own unit (percent or bytes) */
+static inline double threshold_value(trigger_value_type_t type,
+                                     const threshold_u *val)
+{
+    return (type == VOL_THRESHOLD) ? (double)val->volume : val->percent;
+}
+
+/** convert statfs information to the unit of the trigger thresholds */
+static int statfs2value(const trigger_item_t *trig, const struct statfs *stfs,
+                        const char *storage_descr, double *value)
+{
+    unsigned long long used_vol, total;
+    double             used_pct;
+    int                rc;
+
+    rc = statfs2usage(stfs, &used_vol, &used_pct, &total, storage_descr);
+    if (rc)
+        return -rc;
+
+    *value = (trig->hw_type == VOL_THRESHOLD) ? (double)used_vol : used_pct;
+    return 0;
+}
+
+/**
+ * Get the current usage of a trigger target, without querying the DB:
+ * usage of the filesystem, of the fullest OST, or of the fullest pool.
+ */
+static int trigger_sample_usage(policy_info_t *pol, const trigger_item_t *trig,
+                                double *value)
+{
+    struct statfs stfs;
+    int           rc;
+
+    switch (trig->target_type)
+    {
+    case TGT_FS:
+        rc = get_fs_usage(pol, &stfs);
+        if (rc)
+            return rc;
+        return statfs2value(trig, &stfs, "Filesystem", value);
+
+#ifdef _LUSTRE
+    case TGT_OST:
+    {
+        struct ost_list none;
+        int             ost_index;
+
+        ost_list_init(&none);
+        ost_index = get_ost_max(&stfs, trig->hw_type, &none);
+        ost_list_free(&none);
+        if (ost_index < 0)
+            return -ost_index;
+        return statfs2value(trig, &stfs, "OST", value);
+    }
+
+    case TGT_POOL:
+    {
+        unsigned int i;
+        double       pool_val;
+
+        rc = ENOENT;
+        *value = 0.0;
+        for (i = 0; i < trig->list_size; i++)
+        {
+            if (Get_pool_usage(trig->list[i], &stfs) != 0
+                || statfs2value(trig, &stfs, trig->list[i], &pool_val) != 0)
+                continue;
+
+            if (rc != 0 || pool_val > *value)
+                *value = pool_val;
+            rc = 0;
+        }
+        return rc;
+    }
+#endif
+    default:
+        return ENOTSUP;
+    }
+}
+
+static void usage_model_reset(usage_model_t *m)
+{
+    m->first = m->count = 0;
+    m->next_sample = 0;
+    m->fill_rate = 0.0;
+    m->hw_eta = 0;
+}
+
+static void usage_model_add(usage_model_t *m, time_t t, double value)
+{
+    unsigned int idx;
+
+    if (m->count < USAGE_SAMPLES_MAX)
+    {
+        idx = (m->first + m->count) % USAGE_SAMPLES_MAX;
+        m->count++;
+    }
+    else
+    {
+        /* overwrite the oldest sample */
+        idx = m->first;
+        m->first = (m->first + 1) % USAGE_SAMPLES_MAX;
+    }
+    m->samples[idx].time = t;
+    m->samples[idx].value = value;
+}
+
+/**
+ * Least-square fit of usage samples.
+ * @param[out] rate     estimated fill rate (per second)
+ * @param[out] current  estimated usage at the time of the last sample
+ * @return false if there are not enough samples for an estimation.
+ */
+static bool usage_model_fit(const usage_model_t *m, double *rate,
+                            double *current)
+{
+    const usage_sample_t *s;
+    time_t       t0, t_last;
+    double       mean_t = 0.0, mean_v = 0.0;
+    double       sxx = 0.0, sxy = 0.0;
+    unsigned int i;
+
+    if (m->count < 3)
+        return false;
+
+    t0 = m->samples[m->first].time;
+    t_last = m->samples[(m->first + m->count - 1) % USAGE_SAMPLES_MAX].time;
+
+    for (i = 0; i < m->count; i++)
+    {
+        s = &m->samples[(m->first + i) % USAGE_SAMPLES_MAX];
+        mean_t += s->time - t0;
+        mean_v += s->value;
+    }
+    mean_t /= m->count;
+    mean_v /= m->count;
+
+    for (i = 0; i < m->count; i++)
+    {
+        double dt;
+
+        s = &m->samples[(m->first + i) % USAGE_SAMPLES_MAX];
+        dt = (s->time - t0) - mean_t;
+        sxx += dt * dt;
+        sxy += dt * (s->value - mean_v);
+    }
+    if (sxx == 0.0)
+        return false;
+
+    *rate = sxy / sxx;
+    *current = mean_v + *rate * ((t_last - t0) - mean_t);
+    return true;
+}
+
+/**
+ * Sample the usage of a predictive trigger target if it is time to,
+ * and estimate when it will reach the high threshold.
+ * The sampling interval gets shorter as usage comes closer to
+ * the high threshold.
+ * Only global_usage triggers can run early: an early run applies to all
+ * targets over the low threshold, while ost_usage and pool_usage
+ * predictions are only made for the fullest target.
+ * @param[out] early  the policy must run before the high threshold is reached.
+ * @return true if the trigger must be checked now.
+ */
+static bool predict_trigger(policy_info_t *pol, unsigned int trigger_index,
+                            bool *early)
+{
+    const trigger_item_t *trig = &pol->config->trigger_list[trigger_index];
+    usage_model_t        *m = &pol->trigger_info[trigger_index].model;
+    time_t                now = time(NULL);
+    time_t                interval = trig->check_interval;
+    double                value, rate, current, hw, lw;
+    bool                  was_under_hw;
+    char                  buf1[128];
+    int                   rc;
+
+    *early = false;
+
+    if (now < m->next_sample)
+        return false;
+
+    rc = trigger_sample_usage(pol, trig, &value);
+    if (rc)
+    {
+        DisplayLog(LVL_VERB, tag(pol), "Trigger #%u (%s): failed to sample "
+                   "usage: %s", trigger_index, trigger2str(trig), strerror(rc));
+        m->next_sample = now + trig->min_check_interval;
+        return false;
+    }
+    hw = threshold_value(trig->hw_type, &trig->hw_u);
+    lw = threshold_value(trig->lw_type, &trig->lw_u);
+
+    was_under_hw = (m->count > 0) &&
+        (m->samples[(m->first + m->count - 1) % USAGE_SAMPLES_MAX].value < hw);
+    usage_model_add(m, now, value);
+
+    m->fill_rate = 0.0;
+    m->hw_eta = 0;
+
+    if (value >= hw)
+    {
+        m->next_sample = now + trig->min_check_interval;
+        /* threshold just crossed: don't wait for the next check interval.
+         * Then, the trigger is checked at its usual interval. */
+        return was_under_hw;
+    }
+
+    if (usage_model_fit(m, &rate, &current) && rate > 0.0)
+    {
+        time_t eta = (current >= hw) ? 0 : (time_t)((hw - current) / rate);
+
+        m->fill_rate = rate;
+        m->hw_eta = now + eta;
+
+        FormatDuration(buf1, sizeof(buf1), eta);
+        DisplayLog(LVL_DEBUG, tag(pol), "Trigger #%u (%s): high threshold "
+                   "expected to be reached in %s", trigger_index,
+                   trigger2str(trig), buf1);
+
+        /* sample more often as the threshold comes closer */
+        if (eta / 4 < interval)
+            interval = eta / 4;
+
+        if (eta <= trig->predict_horizon && trig->target_type == TGT_FS
+            && now - m->last_early_run >= trig->check_interval)
+        {
+            if (value <= lw)
+                DisplayLog(LVL_MAJOR, tag(pol), "Trigger #%u (%s): high "
+                           "threshold expected to be reached in %s, but usage "
+                           "is under low threshold: nothing to do yet",
+                           trigger_index, trigger2str(trig), buf1);
+            else
+            {
+                DisplayLog(LVL_EVENT, tag(pol), "Trigger #%u (%s): high "
+                           "threshold expected to be reached in %s "
+                           "(horizon: %lus): starting policy run early",
+                           trigger_index, trigger2str(trig), buf1,
+                           trig->predict_horizon);
+                m->last_early_run = now;
+                *early = true;
+            }
+        }
+    }
+
+    if (interval < trig->min_check_interval)
+        interval = trig->min_check_interval;
+    m->next_sample = now + interval;
+
+    return *early;
+}
+
+/** delay until the next trigger check or usage sample */
+static time_t next_check_delay(const policy_info_t *pol)
+{
+    time_t       delay = pol->gcd_interval;
+    time_t       now = time(NULL);
+    unsigned int i;
+
+    for (i = 0; i < pol->config->trigger_count; i++)
+    {
+        const usage_model_t *m = &pol->trigger_info[i].model;
+
+        if (!is_predictive(&pol->config->trigger_list[i]))
+            continue;
+
+        if (m->next_sample <= now)
+            return 1;
+        if (m->next_sample - now < delay)
+            delay = m->next_sample - now;
+    }
+    return delay;
+}
+
 static void sprint_ctr(char *str, int size,
                        const counters_t* ctr, policy_target_t tgt_type)
 {
@@ -1213,9 +1540,13 @@ static void print_done_vs_target(char *str, int size, const counters_t* done,
     }
 }
 
-/** store policy run stats to DB */
+/** store policy run stats to DB
+ * \param summary if not NULL, also store machine-readable stats
+ *        about the run, used to estimate the duration of next runs.
+ */
 static void store_policy_run_stats(policy_info_t *pol, time_t start, time_t end,
-                                   const char *trigger_info, const char *status_info)
+                                   const char *trigger_info, const char *status_info,
+                                   const action_summary_t *summary)
 {
     char var_name[POLICY_NAME_LEN+128]; /* policy name + suffix (oversized) */
     char val_buff[RBH_PATH_MAX];
@@ -1242,6 +1573,17 @@ static void store_policy_run_stats(policy_info_t *pol, time_t start, time_t end,
     /* store status info */
     snprintf(var_name, sizeof(var_name), "%s"LAST_POLICY_STATUS_SUFFIX, tag(pol));
     ListMgr_SetVar(&pol->lmgr, var_name, status_info);
+
+    /* keep stats of the last run that performed actions */
+    if (summary != NULL && summary->action_ctr.count > 0)
+    {
+        snprintf(var_name, sizeof(var_name), "%s"LAST_POLICY_STATS_SUFFIX, tag(pol));
+        snprintf(val_buff, sizeof(val_buff), LAST_POLICY_STATS_FMT,
+                 summary->action_ctr.count, summary->action_ctr.vol,
+                 end > start ? (unsigned int)(end - start) : 1,
+                 pol->config->nb_threads);
+        ListMgr_SetVar(&pol->lmgr, var_name, val_buff);
+    }
 }
 
 static void store_policy_start_stats(policy_info_t *pol, time_t start, const char *trigger_info)
@@ -1259,6 +1601,80 @@ static void store_policy_start_stats(policy_info_t *pol, time_t start, const cha
     ListMgr_SetVar(&pol->lmgr, var_name, trigger_info);
 }
 
+/**
+ * Report the result of a policy simulation: eligible entries,
+ * expected run time and whether the target would be reached.
+ * Run time is modeled from the action rate and the bandwidth
+ * of the last policy run, assuming they scale linearly with
+ * the number of policy threads.
+ */
+static void report_policy_simulation(policy_info_t *pol, policy_param_t *param,
+                                     action_summary_t *summary, lmgr_t *lmgr,
+                                     int policy_rc)
+{
+    char var_name[POLICY_NAME_LEN+128];
+    char buff[MAX_VAR_LEN];
+    char vol_buff[128];
+    char time_buff[128];
+    unsigned long long h_count, h_vol;
+    unsigned int h_duration, h_threads;
+
+    if (policy_rc != 0)
+    {
+        DisplayLog(LVL_CRIT, tag(pol), "Policy simulation on %s failed: %s",
+                   param2targetstr(param, buff, sizeof(buff)),
+                   policy_rc == ENOENT ? "no list is available" :
+                   (policy_rc == ECANCELED ? "aborted" : "error"));
+        return;
+    }
+
+    FormatFileSize(vol_buff, sizeof(vol_buff), summary->action_ctr.vol);
+    DisplayLog(LVL_MAJOR, tag(pol), "Policy simulation summary: target=%s; "
+               "%llu eligible entries; volume: %s; %u entries not eligible.",
+               param2targetstr(param, buff, sizeof(buff)),
+               summary->action_ctr.count, vol_buff, summary->skipped);
+
+    snprintf(var_name, sizeof(var_name), "%s"LAST_POLICY_STATS_SUFFIX, tag(pol));
+    if (ListMgr_GetVar(lmgr, var_name, buff, sizeof(buff)) == DB_SUCCESS
+        && sscanf(buff, LAST_POLICY_STATS_FMT, &h_count, &h_vol,
+                  &h_duration, &h_threads) == 4
+        && h_count > 0 && h_duration > 0 && h_threads > 0)
+    {
+        double scale = (double)pol->config->nb_threads / h_threads;
+        double est, est_vol;
+
+        /* the run is limited either by the action rate or the bandwidth */
+        est = summary->action_ctr.count * (double)h_duration
+              / (h_count * scale);
+        if (h_vol > 0)
+        {
+            est_vol = summary->action_ctr.vol * (double)h_duration
+                      / (h_vol * scale);
+            if (est_vol > est)
+                est = est_vol;
+        }
+
+        FormatDuration(time_buff, sizeof(time_buff), (time_t)(est + 0.5));
+        DisplayLog(LVL_MAJOR, tag(pol), "Estimated run time: %s with %u threads "
+                   "(last run: %llu actions in %us with %u threads)",
+                   time_buff, pol->config->nb_threads, h_count, h_duration,
+                   h_threads);
+    }
+    else
+        DisplayLog(LVL_MAJOR, tag(pol), "Estimated run time: unknown "
+                   "(no previous run with actions)");
+
+    if (counter_not_reached(&summary->action_ctr, &param->target_ctr))
+    {
+        print_done_vs_target(buff, sizeof(buff), &summary->action_ctr,
+                             &param->target_ctr);
+        DisplayLog(LVL_MAJOR, tag(pol), "Policy target would not be reached: %s",
+                   buff);
+    }
+    else if (counter_is_set(&param->target_ctr))
+        DisplayLog(LVL_MAJOR, tag(pol), "Policy target would be reached.");
+}
+
 /** \param trigger_index -1 if this is a manual run */
 static void report_policy_run(policy_info_t *pol, policy_param_t *param,
                               action_summary_t *summary, lmgr_t *lmgr,
@@ -1276,6 +1692,14 @@ static void report_policy_run(policy_info_t *pol, policy_param_t *param,
     print_ctr(LVL_DEBUG, tag(pol), "target", &param->target_ctr, param->target);
     print_ctr(LVL_DEBUG, tag(pol), "done", &summary->action_ctr, param->target);
 
+    /* nothing was done: don't update trigger stats nor DB */
+    if (simulate(pol))
+    {
+        report_policy_simulation(pol, param, summary, lmgr, policy_rc);
+        FlushLogs();
+        return;
+    }
+
     if (trigger_index != -1)
     {
         /* save the summary to trigger_info */
@@ -1398,7 +1822,8 @@ static void report_policy_run(policy_info_t *pol, policy_param_t *param,
     }
 
     store_policy_run_stats(pol, summary->policy_start, time_end,
-                           trigger_buff, status_buff);
+                           trigger_buff, status_buff,
+                           policy_rc == 0 ? summary : NULL);
     free(trigger_buff);
     free(status_buff);
 
@@ -1406,12 +1831,14 @@ static void report_policy_run(policy_info_t *pol, policy_param_t *param,
 }
 
 /** generic function to check a trigger (TODO to be completed) */
-static int check_trigger(policy_info_t *pol, unsigned trigger_index)
+static int check_trigger(policy_info_t *pol, unsigned trigger_index,
+                         bool early)
 {
     policy_param_t param;
     int            rc;
     action_summary_t summary;
     trigger_item_t  *trig = &pol->config->trigger_list[trigger_index];
+    trigger_item_t  early_trig;
     time_modifier_t tmod;
     target_iterator_t it;
     char buff[1024];
@@ -1426,6 +1853,17 @@ static int check_trigger(policy_info_t *pol, unsigned trigger_index)
         return rc;
     param.target = trig->target_type;
 
+    if (early)
+    {
+        /* high threshold is not reached yet: apply the policy
+         * to the filesystem if it is over the low threshold
+         * (only global_usage triggers run early) */
+        early_trig = *trig;
+        early_trig.hw_u = trig->lw_u;
+        early_trig.alert_hw = false;
+        trig = &early_trig;
+    }
+
     update_trigger_status(pol, trigger_index, TRIG_BEING_CHECKED);
 
     // FIXME, for now, does not check start condition */
@@ -1466,7 +1904,8 @@ static int check_trigger(policy_info_t *pol, unsigned trigger_index)
         asprintf(&trigger_buff, "trigger: %s (%s), target: %s",
                  trigger2str(trig), one_shot(pol) ?
                     "one-shot command" : "daemon", buff);
-        store_policy_start_stats(pol, time(NULL), trigger_buff);
+        if (!simulate(pol))
+            store_policy_start_stats(pol, time(NULL), trigger_buff);
         free(trigger_buff);
 
         memset(&summary, 0, sizeof(summary));
@@ -1476,6 +1915,15 @@ static int check_trigger(policy_info_t *pol, unsigned trigger_index)
         report_policy_run(pol, &param, &summary, &pol->lmgr, trigger_index,
                           rc);
 
+        /* cached usage of the target is no longer relevant
+         * after some actions */
+        if (it.use_cache && counter_is_set(&summary.action_ctr))
+            usage_cache_invalidate(trig->target_type, param.optarg_u.name);
+
+        /* previous samples no longer reflect the fill rate */
+        if (is_predictive(trig) && counter_is_set(&summary.action_ctr))
+            usage_model_reset(&pol->trigger_info[trigger_index].model);
+
         /* post apply sleep? */
         if (!pol->aborted && counter_is_set(&summary.action_ctr) &&
             trig->post_trigger_wait > 0)
@@ -1627,7 +2075,8 @@ static int targeted_run(policy_info_t *pol, const policy_opt_t *opt)
         /* insert info to DB about current trigger (for rbh-report --activity) */
         char *trigger_buff;
         asprintf(&trigger_buff, "manual run, target: %s", buff);
-        store_policy_start_stats(pol, time(NULL), trigger_buff);
+        if (!simulate(pol))
+            store_policy_start_stats(pol, time(NULL), trigger_buff);
         free(trigger_buff);
 
         memset(&summary, 0, sizeof(summary));
@@ -1715,6 +2164,8 @@ static void *trigger_check_thr(void *thr_arg)
         for (i = 0; i < pol->config->trigger_count; i++)
         {
             const char *tname = trigger2str(&pol->config->trigger_list[i]);
+            bool        due = false;
+            bool        early = false;
 
             if (pol->aborted)
             {
@@ -1722,8 +2173,15 @@ static void *trigger_check_thr(void *thr_arg)
                 break;
             }
 
+            /* a single sample is useless for predictions */
+            if (is_predictive(&pol->config->trigger_list[i]) && !one_shot(pol))
+                due = predict_trigger(pol, i, &early);
+
             if (time(NULL) - pol->trigger_info[i].last_check >=
                  pol->config->trigger_list[i].check_interval)
+                due = true;
+
+            if (due)
             {
                 if (pol->trigger_info[i].last_check != 0)
                     DisplayLog(LVL_DEBUG, tag(pol),
@@ -1733,7 +2191,7 @@ static void *trigger_check_thr(void *thr_arg)
                     DisplayLog(LVL_DEBUG, tag(pol), "Checking trigger #%u (%s), never checked",
                                i, tname);
 
-                rc = check_trigger(pol, i);
+                rc = check_trigger(pol, i, early);
 
                 /* don't update last_check if trigger check failed */
                 if (rc != 0)
@@ -1768,7 +2226,7 @@ static void *trigger_check_thr(void *thr_arg)
 
         if (!one_shot(pol) && !pol->aborted)
         {
-            rh_intr_sleep(pol->gcd_interval, pol->aborted);
+            rh_intr_sleep(next_check_delay(pol), pol->aborted);
             if (pol->aborted)
                 goto out;
         }
@@ -1900,6 +2358,10 @@ int policy_module_start(policy_info_t *policy, /* out */
         return rc;
     }
 
+    rc = sched_register_policy(policy);
+    if (rc)
+        return rc;
+
     /* start worker threads */
     rc = start_worker_threads(policy);
     if (rc)
@@ -1923,8 +2385,24 @@ int policy_module_start(policy_info_t *policy, /* out */
         }
 
         for (i = 0; i < p_config->trigger_count; i++)
+        {
             policy->trigger_info[i].status = TRIG_NOT_CHECKED;
 
+            if (p_config->usage_cache_max_age == 0
+                || (p_config->trigger_list[i].target_type != TGT_USER
+                    && p_config->trigger_list[i].target_type != TGT_GROUP))
+                continue;
+
+            /* let the entry processor maintain user/group usage */
+            if (usage_cache_maintained())
+                usage_cache_enable();
+            else
+                DisplayLog(LVL_MAJOR, tag(policy), "WARNING: no scan or "
+                           "changelog reader runs in this process to keep "
+                           "the usage cache current: usage_cache_max_age "
+                           "is ignored, quota triggers query the DB.");
+        }
+
         /* start trigger check thread */
         rc = pthread_create(&policy->trigger_thr, NULL, trigger_check_thr,
                             (void*)policy);
@@ -2072,6 +2550,29 @@ void policy_module_dump_stats(policy_info_t *policy)
                 break;
             }
 
+            if (is_predictive(&policy->config->trigger_list[i]))
+            {
+                const usage_model_t *m = &policy->trigger_info[i].model;
+
+                if (m->hw_eta == 0)
+                    DisplayLog(LVL_MAJOR, "STATS", "    fill rate: not estimated "
+                               "(usage is not increasing, or not enough samples)");
+                else
+                {
+                    if (policy->config->trigger_list[i].hw_type == VOL_THRESHOLD)
+                        FormatFileSize(trigstr, sizeof(trigstr),
+                                       m->fill_rate * 3600);
+                    else
+                        snprintf(trigstr, sizeof(trigstr), "%.2f%%",
+                                 m->fill_rate * 3600);
+                    FormatDuration(tmp_buff, sizeof(tmp_buff),
+                                   m->hw_eta > now ? m->hw_eta - now : 0);
+                    DisplayLog(LVL_MAJOR, "STATS", "    fill rate: %s/hour, "
+                               "high threshold expected in %s", trigstr,
+                               tmp_buff);
+                }
+            }
+
             print_ctr(LVL_MAJOR, "STATS", "    last run",
                       &policy->trigger_info[i].last_ctr,
                       policy->config->trigger_list[i].target_type);
@@ -20,6 +20,7 @@
 #define _RUN_POLICIES_H
 
 #include "policy_run.h"
+#include "status_manager.h"
 
 typedef struct policy_runs_t {
     policy_info_t *runs;
@@ -107,6 +108,40 @@ typedef struct policy_param_t
 
 } policy_param_t;
 
+/**
+ * Return the value of a LRU sort attribute (-1 if it is not set).
+ */
+static inline int sort_attr_value(unsigned int sort_attr,
+                                  const attr_set_t *p_attrs)
+{
+    if (sort_attr == LRU_ATTR_NONE)
+        return -1;
+
+    if (!attr_mask_test_index(&p_attrs->attr_mask, sort_attr))
+        return -1;
+
+    if (is_sm_info(sort_attr))
+    {
+        unsigned int idx = attr2sminfo_index(sort_attr);
+
+        return *((unsigned int *)p_attrs->attr_values.sm_info[idx]);
+    }
+
+    switch(sort_attr)
+    {
+        case ATTR_INDEX_creation_time:
+            return ATTR(p_attrs, creation_time);
+        case ATTR_INDEX_last_mod:
+            return ATTR(p_attrs, last_mod);
+        case ATTR_INDEX_last_access:
+            return ATTR(p_attrs, last_access);
+        case ATTR_INDEX_rm_time:
+            return ATTR(p_attrs, rm_time);
+        default:
+            return -1;
+    }
+}
+
 int run_policy(policy_info_t *p_pol_info, const policy_param_t *p_param,
                action_summary_t *p_summary, lmgr_t *lmgr);
 
@@ -115,4 +150,38 @@ int start_worker_threads(policy_info_t *p_pol_info); /* the number of threads is
 int check_current_actions(policy_info_t *p_pol_info, lmgr_t *lmgr, /* the timeout is in p_pol_info->config */
                           unsigned int *p_nb_reset, unsigned int *p_nb_total);
 
+/* defined in policy_sched.c */
+
+/** make a running policy known by the action scheduler */
+int sched_register_policy(policy_info_t *pol);
+
+/** Get an action slot, when the number of running actions
+ * is limited for all policies (policy_scheduler::max_running_actions).
+ * Slots are granted to the policies with the higher priority first. */
+void sched_action_start(policy_info_t *pol);
+/** release an action slot */
+void sched_action_end(policy_info_t *pol);
+
+typedef struct shared_consumer shared_consumer_t;
+
+/**
+ * Join a candidate scan shared with other policy runs starting
+ * in the next 'shared_scan_delay' seconds, with the same sort order.
+ * Nothing is joined for one-shot runs, or if no other running policy
+ * can share the scan.
+ * @param attr_mask attributes needed by the policy run.
+ * @param p_cons is set to NULL if no other policy joined the scan:
+ *        the policy run must list its own candidates.
+ */
+int shared_scan_join(policy_info_t *pol, attr_mask_t attr_mask,
+                     shared_consumer_t **p_cons);
+
+/** get the next entry in policy scope from a shared scan
+ * (same return codes as ListMgr_GetNext()) */
+int shared_scan_next(shared_consumer_t *cons, entry_id_t *p_id,
+                     attr_set_t *p_attrs);
+
+/** stop listing entries from a shared scan */
+void shared_scan_leave(shared_consumer_t *cons);
+
 #endif
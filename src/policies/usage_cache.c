@@ -0,0 +1,642 @@
+/* -*- mode: c; c-basic-offset: 4; indent-tabs-mode: nil; -*-
+ * vim:expandtab:shiftwidth=4:tabstop=4:
+ */
+/*
+ * Copyright (C) 2016 CEA/DAM
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the CeCILL License.
+ *
+ * The fact that you are presently reading this means that you have had
+ * knowledge of the CeCILL license (http://www.cecill.info) and that you
+ * accept its terms.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include "usage_cache.h"
+#include "global_config.h"
+#include "rbh_misc.h"
+#include "rbh_logs.h"
+#include "Memory.h"
+#include <glib.h>
+#include <errno.h>
+#include <pthread.h>
+#include <fnmatch.h>
+
+#define TAG "UsageCache"
+
+/** usage change of a user or group */
+typedef struct usage_delta {
+    long long count;
+    long long blocks;
+} usage_delta_t;
+
+/** table of usage for all users or all groups, shared by all policies */
+typedef struct usage_table {
+    pthread_mutex_t  lock;
+    pthread_cond_t   load_done;
+    /** a thread is loading the table from the DB */
+    bool             loading;
+    /** 0 if the table must be reloaded */
+    time_t           last_update;
+    /** name -> usage_item_t. NULL until the first load. */
+    GHashTable      *items;
+    /** name -> usage_delta_t: changes applied while the table is loaded */
+    GHashTable      *pending;
+    /** names of the items to be reloaded from the DB */
+    GHashTable      *stale;
+} usage_table_t;
+
+static usage_table_t usage_tables[2] = {
+    {PTHREAD_MUTEX_INITIALIZER, PTHREAD_COND_INITIALIZER, false, 0, NULL,
+     NULL, NULL},
+    {PTHREAD_MUTEX_INITIALIZER, PTHREAD_COND_INITIALIZER, false, 0, NULL,
+     NULL, NULL},
+};
+
+#define usage_table(_tgt) (&usage_tables[(_tgt) == TGT_USER ? 0 : 1])
+
+static bool usage_cache_on = false;
+static bool usage_pipeline_on = false;
+
+void usage_cache_set_maintained(void)
+{
+    usage_pipeline_on = true;
+}
+
+bool usage_cache_maintained(void)
+{
+    return usage_pipeline_on;
+}
+
+void usage_cache_enable(void)
+{
+    usage_cache_on = true;
+}
+
+bool usage_cache_enabled(void)
+{
+    return usage_cache_on;
+}
+
+static inline void usage_item_set(usage_item_t *item, const db_type_u *id,
+                                  unsigned long long count,
+                                  unsigned long long blocks)
+{
+    item->name = strdup(id_as_str((db_type_u *)id));
+    if (global_config.uid_gid_as_numbers)
+        item->id = *id;
+    else
+        item->id.val_str = item->name;
+    item->count = count;
+    item->blocks = blocks;
+}
+
+void usage_items_free(usage_item_t *items, unsigned int count)
+{
+    unsigned int i;
+
+    for (i = 0; i < count; i++)
+        free(items[i].name);
+    MemFree(items);
+}
+
+static void usage_item_free(gpointer p)
+{
+    usage_item_t *item = p;
+
+    free(item->name);
+    MemFree(item);
+}
+
+static inline GHashTable *usage_hash_new(void)
+{
+    /* keys are item names */
+    return g_hash_table_new_full(g_str_hash, g_str_equal, NULL,
+                                 usage_item_free);
+}
+
+static inline GHashTable *pending_hash_new(void)
+{
+    return g_hash_table_new_full(g_str_hash, g_str_equal, free, free);
+}
+
+/** printable name of a uid/gid attribute */
+static inline const char *uidgid_key(const uidgid_u *u, char *buf,
+                                     size_t size)
+{
+    if (!global_config.uid_gid_as_numbers)
+        return u->txt;
+
+    snprintf(buf, size, "%d", u->num);
+    return buf;
+}
+
+/** add a usage delta to an item (created if it doesn't exist) */
+static void usage_item_add(GHashTable *items, const char *name,
+                           long long count, long long blocks)
+{
+    usage_item_t *item = g_hash_table_lookup(items, name);
+
+    if (item == NULL)
+    {
+        db_type_u id;
+
+        if (count <= 0 && blocks <= 0)
+            return;
+
+        item = MemAlloc(sizeof(*item));
+        if (item == NULL)
+            return;
+
+        if (global_config.uid_gid_as_numbers)
+            id.val_int = str2int(name);
+        else
+            id.val_str = name;
+        usage_item_set(item, &id, 0, 0);
+        g_hash_table_insert(items, item->name, item);
+    }
+
+    /* the table may be slightly out of sync with the DB:
+     * don't let values wrap */
+    item->count = (count < 0 && item->count < -count) ? 0 : item->count + count;
+    item->blocks = (blocks < 0 && item->blocks < -blocks) ?
+                        0 : item->blocks + blocks;
+}
+
+static void pending_add(GHashTable *pending, const char *name,
+                        long long count, long long blocks)
+{
+    usage_delta_t *delta = g_hash_table_lookup(pending, name);
+
+    if (delta == NULL)
+    {
+        delta = calloc(1, sizeof(*delta));
+        if (delta == NULL)
+            return;
+        g_hash_table_insert(pending, strdup(name), delta);
+    }
+    delta->count += count;
+    delta->blocks += blocks;
+}
+
+/** apply a usage delta to a table (must be called with table lock held) */
+static void usage_table_add(usage_table_t *table, const char *name,
+                            long long count, long long blocks)
+{
+    if (table->items != NULL)
+        usage_item_add(table->items, name, count, blocks);
+    /* also save it for the table being loaded */
+    if (table->loading)
+        pending_add(table->pending, name, count, blocks);
+}
+
+/**
+ * Apply the move of an entry from a user/group to another.
+ * old_id or new_id is NULL for entry creation or removal.
+ */
+static void usage_table_move(usage_table_t *table,
+                             const uidgid_u *old_id, uint64_t old_blocks,
+                             const uidgid_u *new_id, uint64_t new_blocks)
+{
+    char buf[32];
+
+    P(table->lock);
+    /* usage is not maintained until the table is loaded */
+    if (table->items != NULL || table->loading)
+    {
+        if (old_id != NULL)
+            usage_table_add(table, uidgid_key(old_id, buf, sizeof(buf)),
+                            -1, -(long long)old_blocks);
+        if (new_id != NULL)
+            usage_table_add(table, uidgid_key(new_id, buf, sizeof(buf)),
+                            1, new_blocks);
+    }
+    V(table->lock);
+}
+
+static inline bool uidgid_equal(const uidgid_u *u1, const uidgid_u *u2)
+{
+    if (global_config.uid_gid_as_numbers)
+        return u1->num == u2->num;
+    return !strcmp(u1->txt, u2->txt);
+}
+
+#define has_usage_attrs(_a) (((_a)->attr_mask.std & USAGE_CACHE_ATTR_MASK) \
+                             == USAGE_CACHE_ATTR_MASK)
+
+void usage_cache_update(const attr_set_t *old_attrs,
+                        const attr_set_t *new_attrs)
+{
+    const uidgid_u *old_uid = NULL, *old_gid = NULL;
+    const uidgid_u *new_uid = NULL, *new_gid = NULL;
+    uint64_t        old_blocks = 0, new_blocks = 0;
+
+    if (!usage_cache_on)
+        return;
+
+    if (old_attrs != NULL)
+    {
+        /* unknown previous usage: can't compute the delta */
+        if (!has_usage_attrs(old_attrs))
+            return;
+        old_uid = &ATTR(old_attrs, uid);
+        old_gid = &ATTR(old_attrs, gid);
+        old_blocks = ATTR(old_attrs, blocks);
+    }
+
+    if (new_attrs != NULL)
+    {
+        if (old_attrs == NULL && !has_usage_attrs(new_attrs))
+            return;
+
+        /* missing attributes are unchanged */
+        new_uid = ATTR_MASK_TEST(new_attrs, uid) ? &ATTR(new_attrs, uid)
+                                                 : old_uid;
+        new_gid = ATTR_MASK_TEST(new_attrs, gid) ? &ATTR(new_attrs, gid)
+                                                 : old_gid;
+        new_blocks = ATTR_MASK_TEST(new_attrs, blocks) ?
+                        ATTR(new_attrs, blocks) : old_blocks;
+    }
+
+    if (old_uid == NULL || new_uid == NULL
+        || !uidgid_equal(old_uid, new_uid) || old_blocks != new_blocks)
+        usage_table_move(usage_table(TGT_USER), old_uid, old_blocks,
+                         new_uid, new_blocks);
+
+    if (old_gid == NULL || new_gid == NULL
+        || !uidgid_equal(old_gid, new_gid) || old_blocks != new_blocks)
+        usage_table_move(usage_table(TGT_GROUP), old_gid, old_blocks,
+                         new_gid, new_blocks);
+}
+
+/**
+ * Load usage of all users or groups from the DB into a hash table.
+ * @param name    if not NULL, only load the usage of this user or group.
+ * @param p_items hash table to be filled (created if it points to NULL).
+ */
+static int usage_table_load(lmgr_t *lmgr, policy_target_t target_type,
+                            const char *name, GHashTable **p_items)
+{
+    report_field_descr_t  info[3]; /* [0]user/group: [1]count: [2]blocks */
+    struct lmgr_report_t *report;
+    db_value_t            result[3];
+    unsigned int          result_count = 3;
+    lmgr_filter_t         filter;
+    filter_value_t        fv;
+    GHashTable           *items;
+    int                   rc;
+
+    memset(info, 0, sizeof(info));
+    info[0].attr_index = (target_type == TGT_USER ? ATTR_INDEX_uid :
+                          ATTR_INDEX_gid);
+    info[0].report_type = REPORT_GROUP_BY;
+    info[0].sort_flag = SORT_NONE;
+    info[1].attr_index = 0;
+    info[1].report_type = REPORT_COUNT;
+    info[1].sort_flag = SORT_NONE;
+    info[2].attr_index = ATTR_INDEX_blocks;
+    info[2].report_type = REPORT_SUM;
+    info[2].sort_flag = SORT_NONE;
+
+    if (name != NULL)
+    {
+        lmgr_simple_filter_init(&filter);
+        if (global_config.uid_gid_as_numbers)
+            fv.value.val_int = str2int(name);
+        else
+            fv.value.val_str = name;
+        lmgr_simple_filter_add(&filter, info[0].attr_index, EQUAL, fv, 0);
+    }
+
+    report = ListMgr_Report(lmgr, info, 3, NULL,
+                            name != NULL ? &filter : NULL, NULL);
+    if (name != NULL)
+        lmgr_simple_filter_free(&filter);
+    if (report == NULL)
+        return -1;
+
+    items = (*p_items != NULL) ? *p_items : usage_hash_new();
+
+    while ((rc = ListMgr_GetNextReportItem(report, result, &result_count,
+                                           NULL)) == DB_SUCCESS)
+    {
+        usage_item_t *item;
+
+        if (result_count != 3)
+        {
+            DisplayLog(LVL_MAJOR, TAG, "Invalid DB result size %u (3 values expected)",
+                       result_count);
+            rc = EINVAL;
+            break;
+        }
+
+        item = MemAlloc(sizeof(*item));
+        if (item == NULL)
+        {
+            rc = ENOMEM;
+            break;
+        }
+        usage_item_set(item, &result[0].value_u,
+                       result[1].value_u.val_biguint,
+                       result[2].value_u.val_biguint);
+        g_hash_table_insert(items, item->name, item);
+
+        result_count = 3;
+    }
+    ListMgr_CloseReport(report);
+
+    if (rc != DB_END_OF_LIST)
+    {
+        if (*p_items == NULL)
+            g_hash_table_destroy(items);
+        return rc;
+    }
+
+    if (name != NULL)
+        DisplayLog(LVL_FULL, TAG, "%s usage reloaded for '%s'",
+                   target_type == TGT_USER ? "User" : "Group", name);
+    else
+        DisplayLog(LVL_DEBUG, TAG, "%s usage loaded: %u items",
+                   target_type == TGT_USER ? "User" : "Group",
+                   g_hash_table_size(items));
+    *p_items = items;
+    return 0;
+}
+
+/**
+ * Reload the usage of the stale items of the table.
+ * Must be called with the table lock held, and the table loaded.
+ */
+static int usage_table_reload_stale(usage_table_t *table, lmgr_t *lmgr,
+                                    policy_target_t target_type)
+{
+    GHashTable     *stale = table->stale;
+    GHashTable     *items = NULL;
+    GHashTableIter  iter;
+    gpointer        key, value;
+    int             rc = 0;
+
+    table->stale = NULL;
+    table->loading = true;
+    table->pending = pending_hash_new();
+    V(table->lock);
+
+    g_hash_table_iter_init(&iter, stale);
+    while (rc == 0 && g_hash_table_iter_next(&iter, &key, &value))
+        rc = usage_table_load(lmgr, target_type, key, &items);
+
+    P(table->lock);
+    g_hash_table_iter_init(&iter, stale);
+    while (g_hash_table_iter_next(&iter, &key, &value))
+    {
+        usage_item_t  *item;
+        usage_delta_t *delta;
+
+        if (rc != 0)
+        {
+            /* retry at next check */
+            if (table->stale == NULL)
+                table->stale = g_hash_table_new_full(g_str_hash, g_str_equal,
+                                                     free, NULL);
+            g_hash_table_insert(table->stale, strdup(key), NULL);
+            continue;
+        }
+
+        /* replace the item by its DB usage (none if it's not found) */
+        g_hash_table_remove(table->items, key);
+        item = (items != NULL) ? g_hash_table_lookup(items, key) : NULL;
+        if (item != NULL)
+        {
+            g_hash_table_steal(items, key);
+            g_hash_table_insert(table->items, item->name, item);
+        }
+
+        /* apply the changes done while loading */
+        delta = g_hash_table_lookup(table->pending, key);
+        if (delta != NULL)
+            usage_item_add(table->items, key, delta->count, delta->blocks);
+    }
+    g_hash_table_destroy(stale);
+    if (items != NULL)
+        g_hash_table_destroy(items);
+
+    g_hash_table_destroy(table->pending);
+    table->pending = NULL;
+    table->loading = false;
+    pthread_cond_broadcast(&table->load_done);
+
+    return rc;
+}
+
+/**
+ * Make sure the table is loaded and not older than max_age.
+ * The DB is queried without holding the table lock, so the entry processor
+ * and other triggers are not blocked meanwhile. The changes applied
+ * during the query are merged afterwards.
+ * Must be called with the table lock held.
+ */
+static int usage_table_refresh(usage_table_t *table, lmgr_t *lmgr,
+                               policy_target_t target_type, time_t max_age)
+{
+    GHashTable     *items = NULL;
+    GHashTableIter  iter;
+    gpointer        key, value;
+    int             rc;
+
+    while (table->loading)
+        pthread_cond_wait(&table->load_done, &table->lock);
+
+    if (table->items != NULL && table->last_update != 0
+        && time(NULL) - table->last_update <= max_age)
+    {
+        DisplayLog(LVL_FULL, TAG, "Using %s usage table (loaded %lus ago)",
+                   target_type == TGT_USER ? "user" : "group",
+                   time(NULL) - table->last_update);
+        if (table->stale == NULL)
+            return 0;
+        return usage_table_reload_stale(table, lmgr, target_type);
+    }
+
+    /* all items are reloaded */
+    if (table->stale != NULL)
+    {
+        g_hash_table_destroy(table->stale);
+        table->stale = NULL;
+    }
+
+    table->loading = true;
+    table->pending = pending_hash_new();
+    V(table->lock);
+
+    rc = usage_table_load(lmgr, target_type, NULL, &items);
+
+    P(table->lock);
+    if (rc == 0)
+    {
+        /* apply the changes done while loading */
+        g_hash_table_iter_init(&iter, table->pending);
+        while (g_hash_table_iter_next(&iter, &key, &value))
+        {
+            usage_delta_t *delta = value;
+
+            usage_item_add(items, key, delta->count, delta->blocks);
+        }
+
+        if (table->items != NULL)
+            g_hash_table_destroy(table->items);
+        table->items = items;
+        table->last_update = time(NULL);
+    }
+    g_hash_table_destroy(table->pending);
+    table->pending = NULL;
+    table->loading = false;
+    pthread_cond_broadcast(&table->load_done);
+
+    return rc;
+}
+
+void usage_cache_invalidate(policy_target_t target_type, const char *name)
+{
+    usage_table_t *table = usage_table(target_type);
+
+    /* keep applying changes to the current item until it is reloaded */
+    P(table->lock);
+    if (table->items != NULL || table->loading)
+    {
+        if (table->stale == NULL)
+            table->stale = g_hash_table_new_full(g_str_hash, g_str_equal,
+                                                 free, NULL);
+        g_hash_table_insert(table->stale, strdup(name), NULL);
+    }
+    V(table->lock);
+}
+
+/** check if a usage item matches the list of users/groups of a trigger */
+static bool usage_item_match(const usage_item_t *item,
+                             const db_type_u *list, unsigned int list_size)
+{
+    unsigned int i;
+
+    if (list_size == 0)
+        return true;
+
+    for (i = 0; i < list_size; i++)
+    {
+        if (global_config.uid_gid_as_numbers)
+        {
+            if (item->id.val_int == list[i].val_int)
+                return true;
+        }
+        else if (fnmatch(list[i].val_str, item->name, 0) == 0)
+            return true;
+    }
+    return false;
+}
+
+static int cmp_usage_count(const void *i1, const void *i2)
+{
+    const usage_item_t *u1 = i1;
+    const usage_item_t *u2 = i2;
+
+    /* descending order */
+    if (u1->count == u2->count)
+        return 0;
+    return (u1->count < u2->count) ? 1 : -1;
+}
+
+static int cmp_usage_blocks(const void *i1, const void *i2)
+{
+    const usage_item_t *u1 = i1;
+    const usage_item_t *u2 = i2;
+
+    /* descending order */
+    if (u1->blocks == u2->blocks)
+        return 0;
+    return (u1->blocks < u2->blocks) ? 1 : -1;
+}
+
+int usage_cache_select(lmgr_t *lmgr, const trigger_item_t *trig,
+                       time_t max_age, unsigned long long high_blk512,
+                       usage_item_t **items, unsigned int *count)
+{
+    usage_table_t  *table = usage_table(trig->target_type);
+    bool            count_trig = (trig->hw_type == COUNT_THRESHOLD);
+    db_type_u      *list = NULL;
+    GHashTableIter  iter;
+    gpointer        key, value;
+    unsigned int    i;
+    int             rc = 0;
+
+    *items = NULL;
+    *count = 0;
+
+    if (trig->list_size > 0)
+    {
+        list = MemCalloc(trig->list_size, sizeof(*list));
+        if (list == NULL)
+            return ENOMEM;
+
+        for (i = 0; i < trig->list_size; i++)
+        {
+            if (trig->target_type == TGT_USER)
+                rc = set_uid_val(trig->list[i], &list[i]);
+            else
+                rc = set_gid_val(trig->list[i], &list[i]);
+            if (rc)
+            {
+                MemFree(list);
+                return -EINVAL;
+            }
+        }
+    }
+
+    P(table->lock);
+    rc = usage_table_refresh(table, lmgr, trig->target_type, max_age);
+    if (rc)
+        goto out_unlock;
+
+    g_hash_table_iter_init(&iter, table->items);
+    while (g_hash_table_iter_next(&iter, &key, &value))
+    {
+        const usage_item_t *item = value;
+
+        if (count_trig ? item->count <= trig->hw_count
+                       : item->blocks <= high_blk512)
+            continue;
+        if (!usage_item_match(item, list, trig->list_size))
+            continue;
+
+        if (*items == NULL)
+        {
+            *items = MemCalloc(g_hash_table_size(table->items),
+                               sizeof(**items));
+            if (*items == NULL)
+            {
+                rc = ENOMEM;
+                goto out_unlock;
+            }
+        }
+        usage_item_set(&(*items)[*count], &item->id, item->count,
+                       item->blocks);
+        (*count)++;
+    }
+
+out_unlock:
+    V(table->lock);
+    MemFree(list);
+
+    if (rc)
+    {
+        usage_items_free(*items, *count);
+        *items = NULL;
+        *count = 0;
+    }
+    else if (*count > 1)
+        qsort(*items, *count, sizeof(**items),
+              count_trig ? cmp_usage_count : cmp_usage_blocks);
+    return rc;
+}
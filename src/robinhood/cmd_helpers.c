@@ -747,6 +747,32 @@ static const char *print_res_int(const db_value_t *val, bool csv,
     return out;
 }
 
+/* uid/gid stored as numbers: display names like ls (numbers in CSV output,
+ * or if they are unknown) */
+static const char *print_res_uid(const db_value_t *val, bool csv,
+                                 char *out, size_t out_sz)
+{
+    char name[RBH_LOGIN_MAX];
+
+    if (csv)
+        snprintf(out, out_sz, "%d", val->value_u.val_int);
+    else
+        snprintf(out, out_sz, "%s", uid2str(val->value_u.val_int, name));
+    return out;
+}
+
+static const char *print_res_gid(const db_value_t *val, bool csv,
+                                 char *out, size_t out_sz)
+{
+    char name[RBH_LOGIN_MAX];
+
+    if (csv)
+        snprintf(out, out_sz, "%d", val->value_u.val_int);
+    else
+        snprintf(out, out_sz, "%s", gid2str(val->value_u.val_int, name));
+    return out;
+}
+
 static const char *print_res_string(const db_value_t *val, bool csv,
                                     char *out, size_t out_sz)
 {
@@ -843,9 +869,10 @@ static inline struct attr_display_spec *attr_info(int index)
             /* Change the function to print the UID/GID, as the
              * argument is a number, not a string. */
             for (i = 0; attr[i].name != NULL; i++)
-                if (attr[i].attr_index == ATTR_INDEX_uid ||
-                    attr[i].attr_index == ATTR_INDEX_gid)
-                    attr[i].result2str = print_res_int;
+                if (attr[i].attr_index == ATTR_INDEX_uid)
+                    attr[i].result2str = print_res_uid;
+                else if (attr[i].attr_index == ATTR_INDEX_gid)
+                    attr[i].result2str = print_res_gid;
         }
     }
 
@@ -914,6 +941,389 @@ unsigned int attrindex2len(unsigned int index, int csv)
     return 1; /* for '?' */
 }
 
+/* ------------- machine output --------------- */
+
+static out_format_e out_fmt = OUT_HUMAN;
+
+void set_output_format(out_format_e fmt)
+{
+    out_fmt = fmt;
+}
+
+out_format_e get_output_format(void)
+{
+    return out_fmt;
+}
+
+void mach_header(GString *out, unsigned int field_count,
+                 const char * const *names, const mach_type_e *types)
+{
+    unsigned int i;
+
+    if (out_fmt == OUT_NUL)
+    {
+        for (i = 0; i < field_count; i++)
+            g_string_append_len(out, names[i], strlen(names[i]) + 1);
+    }
+    else if (out_fmt == OUT_BINARY)
+    {
+        struct mach_header hdr = {
+            .magic = MACH_MAGIC,
+            .version = MACH_VERSION,
+            .field_count = field_count,
+            .id_size = sizeof(entry_id_t),
+        };
+
+        g_string_append_len(out, (char *)&hdr, sizeof(hdr));
+
+        for (i = 0; i < field_count; i++)
+        {
+            struct mach_field_def def;
+
+            memset(&def, 0, sizeof(def));
+            rh_strncpy(def.name, names[i], sizeof(def.name));
+            def.type = types[i];
+            g_string_append_len(out, (char *)&def, sizeof(def));
+        }
+    }
+}
+
+void mach_rec_start(mach_rec_t *rec, GString *out, unsigned int field_count)
+{
+    rec->out = out;
+    rec->start = out->len;
+    rec->field = 0;
+
+    if (out_fmt == OUT_BINARY)
+    {
+        /* length is set when the record ends */
+        g_string_set_size(out, out->len + sizeof(uint32_t)
+                          + (field_count + 7) / 8);
+        memset(out->str + rec->start, 0, out->len - rec->start);
+    }
+}
+
+/** mark the current field as non-NULL */
+static inline void mach_set_valid(mach_rec_t *rec)
+{
+    rec->out->str[rec->start + sizeof(uint32_t) + rec->field / 8]
+        |= (1 << (rec->field % 8));
+}
+
+void mach_int(mach_rec_t *rec, int64_t val)
+{
+    if (out_fmt == OUT_BINARY)
+    {
+        mach_set_valid(rec);
+        g_string_append_len(rec->out, (char *)&val, sizeof(val));
+    }
+    else
+    {
+        g_string_append_printf(rec->out, "%"PRId64, val);
+        g_string_append_c(rec->out, '\0');
+    }
+    rec->field++;
+}
+
+void mach_str(mach_rec_t *rec, const char *val)
+{
+    if (val == NULL)
+    {
+        mach_null(rec);
+        return;
+    }
+
+    if (out_fmt == OUT_BINARY)
+    {
+        uint32_t len = strlen(val);
+
+        mach_set_valid(rec);
+        g_string_append_len(rec->out, (char *)&len, sizeof(len));
+        g_string_append_len(rec->out, val, len);
+    }
+    else
+        g_string_append_len(rec->out, val, strlen(val) + 1);
+    rec->field++;
+}
+
+void mach_id(mach_rec_t *rec, const entry_id_t *id)
+{
+    if (out_fmt == OUT_BINARY)
+    {
+        mach_set_valid(rec);
+        g_string_append_len(rec->out, (char *)id, sizeof(*id));
+    }
+    else
+    {
+        g_string_append_printf(rec->out, DFID_NOBRACE, PFID(id));
+        g_string_append_c(rec->out, '\0');
+    }
+    rec->field++;
+}
+
+void mach_null(mach_rec_t *rec)
+{
+    /* empty field in text output, nothing in binary output */
+    if (out_fmt != OUT_BINARY)
+        g_string_append_c(rec->out, '\0');
+    rec->field++;
+}
+
+void mach_rec_end(mach_rec_t *rec)
+{
+    uint32_t len;
+
+    if (out_fmt != OUT_BINARY)
+        return;
+
+    len = rec->out->len - rec->start - sizeof(len);
+    memcpy(rec->out->str + rec->start, &len, sizeof(len));
+}
+
+static mach_type_e db2mach_type(db_type_e type)
+{
+    switch (type)
+    {
+        case DB_INT:
+        case DB_UINT:
+        case DB_SHORT:
+        case DB_USHORT:
+        case DB_BIGINT:
+        case DB_BIGUINT:
+        case DB_BOOL:
+            return MACH_INT64;
+        case DB_UIDGID:
+            return global_config.uid_gid_as_numbers ? MACH_INT64 : MACH_STR;
+        case DB_ID:
+            return MACH_ID;
+        default:
+            return MACH_STR;
+    }
+}
+
+mach_type_e mach_attr_type(unsigned int attr_index)
+{
+    if (attr_index == ATTR_INDEX_ID)
+        return MACH_ID;
+    if (attr_index == ATTR_INDEX_COUNT)
+        return MACH_INT64;
+    if (is_status(attr_index))
+        return MACH_STR;
+    if (is_sm_info(attr_index))
+        return db2mach_type(sm_attr_info[attr2sminfo_index(attr_index)]
+                            .def->db_type);
+    if (is_std_attr(attr_index))
+        return db2mach_type(field_infos[attr_index].db_type);
+
+    return MACH_STR;
+}
+
+/** append a typed value to a record */
+static void mach_value(mach_rec_t *rec, db_type_e type, const void *addr)
+{
+    switch (type)
+    {
+        case DB_TEXT:
+        case DB_ENUM_FTYPE:
+            mach_str(rec, (const char *)addr);
+            break;
+        case DB_UIDGID:
+            if (global_config.uid_gid_as_numbers)
+                mach_int(rec, ((const uidgid_u *)addr)->num);
+            else
+                mach_str(rec, ((const uidgid_u *)addr)->txt);
+            break;
+        case DB_ID:
+            mach_id(rec, (const entry_id_t *)addr);
+            break;
+        case DB_INT:
+            mach_int(rec, *(const int *)addr);
+            break;
+        case DB_UINT:
+            mach_int(rec, *(const unsigned int *)addr);
+            break;
+        case DB_SHORT:
+            mach_int(rec, *(const short *)addr);
+            break;
+        case DB_USHORT:
+            mach_int(rec, *(const unsigned short *)addr);
+            break;
+        case DB_BIGINT:
+            mach_int(rec, *(const long long *)addr);
+            break;
+        case DB_BIGUINT:
+            mach_int(rec, *(const unsigned long long *)addr);
+            break;
+        case DB_BOOL:
+            mach_int(rec, *(const bool *)addr);
+            break;
+        default:
+            mach_null(rec);
+    }
+}
+
+void mach_attr(mach_rec_t *rec, const attr_set_t *attrs,
+               const entry_id_t *id, unsigned int attr_index)
+{
+    if (attr_index == ATTR_INDEX_ID)
+    {
+        mach_id(rec, id);
+        return;
+    }
+
+    if (!attr_mask_test_index(&attrs->attr_mask, attr_index))
+    {
+        mach_null(rec);
+        return;
+    }
+
+    if (is_status(attr_index))
+    {
+        mach_str(rec, STATUS_ATTR(attrs, attr2status_index(attr_index)));
+        return;
+    }
+    else if (is_sm_info(attr_index))
+    {
+        unsigned int idx = attr2sminfo_index(attr_index);
+        const void  *val = attrs->attr_values.sm_info[idx];
+
+        if (val == NULL)
+            mach_null(rec);
+        else
+            mach_value(rec, sm_attr_info[idx].def->db_type, val);
+        return;
+    }
+    else if (!is_std_attr(attr_index))
+    {
+        mach_null(rec);
+        return;
+    }
+
+    switch (attr_index)
+    {
+        /* space used is displayed in bytes */
+        case ATTR_INDEX_blocks:
+            mach_int(rec, ATTR(attrs, blocks) * DEV_BSIZE);
+            return;
+
+#ifdef _LUSTRE
+        case ATTR_INDEX_stripe_info:
+        {
+            char tmp[1024];
+
+            snprintf(tmp, sizeof(tmp), "%u,%"PRIu64",%s",
+                     ATTR(attrs, stripe_info).stripe_count,
+                     ATTR(attrs, stripe_info).stripe_size,
+                     ATTR(attrs, stripe_info).pool_name);
+            mach_str(rec, tmp);
+            return;
+        }
+        case ATTR_INDEX_stripe_items:
+        {
+            GString *osts = g_string_new("");
+
+            append_stripe_list(osts, &ATTR(attrs, stripe_items), true);
+            mach_str(rec, osts->str);
+            g_string_free(osts, TRUE);
+            return;
+        }
+#endif
+    }
+
+    mach_value(rec, field_infos[attr_index].db_type,
+               (const char *)&attrs->attr_values
+               + field_infos[attr_index].offset);
+}
+
+/** buffer for machine output of report helpers */
+static GString *mach_out = NULL;
+
+static GString *mach_out_get(void)
+{
+    if (mach_out == NULL)
+        mach_out = g_string_sized_new(4096);
+    else
+        g_string_truncate(mach_out, 0);
+    return mach_out;
+}
+
+static void mach_out_write(void)
+{
+    fwrite(mach_out->str, 1, mach_out->len, stdout);
+}
+
+static void mach_print_attr_list(int rank_field, unsigned int *attr_list,
+                                 int attr_count,
+                                 profile_field_descr_t *p_profile,
+                                 const char *custom_title)
+{
+    /* rank + attrs + profile + custom field */
+    unsigned int max = attr_count + SZ_PROFIL_COUNT + 2;
+    const char *names[max];
+    mach_type_e types[max];
+    unsigned int n = 0;
+    int i;
+
+    if (rank_field)
+    {
+        names[n] = "rank";
+        types[n++] = MACH_INT64;
+    }
+    for (i = 0; i < attr_count; i++)
+    {
+        names[n] = attr_info(attr_list[i])->name;
+        types[n++] = mach_attr_type(attr_list[i]);
+    }
+    /* ratio is not displayed: it can be computed from counts */
+    if (p_profile && p_profile->attr_index == ATTR_INDEX_size)
+    {
+        for (i = 0; i < SZ_PROFIL_COUNT; i++)
+        {
+            names[n] = size_range[i].title;
+            types[n++] = MACH_INT64;
+        }
+    }
+    if (custom_title)
+    {
+        names[n] = custom_title;
+        types[n++] = MACH_STR;
+    }
+
+    mach_header(mach_out_get(), n, names, types);
+    mach_out_write();
+}
+
+static void mach_print_attr_values(int rank, unsigned int *attr_list,
+                                   int attr_count, attr_set_t *attrs,
+                                   const entry_id_t *id,
+                                   name_func name_resolver,
+                                   const char *custom)
+{
+    mach_rec_t rec;
+    char buff[RBH_PATH_MAX];
+    int i;
+
+    mach_rec_start(&rec, mach_out_get(),
+                   attr_count + (rank ? 1 : 0) + (custom ? 1 : 0));
+    if (rank)
+        mach_int(&rec, rank);
+
+    for (i = 0; i < attr_count; i++)
+    {
+        if (attr_list[i] == ATTR_INDEX_fullpath
+            && !ATTR_MASK_TEST(attrs, fullpath))
+            mach_str(&rec, name_resolver ?
+                     name_resolver(id, attrs, buff) : NULL);
+        else
+            mach_attr(&rec, attrs, id, attr_list[i]);
+    }
+    if (custom)
+        mach_str(&rec, custom);
+
+    mach_rec_end(&rec);
+    mach_out_write();
+}
+
 #define PROF_CNT_LEN     8
 #define PROF_RATIO_LEN   7
 
@@ -926,6 +1336,13 @@ void print_attr_list_custom(int rank_field, unsigned int *attr_list, int attr_co
     int coma = 0;
     struct attr_display_spec *rec;
 
+    if (machine_output())
+    {
+        mach_print_attr_list(rank_field, attr_list, attr_count, p_profile,
+                             custom_title);
+        return;
+    }
+
     if (rank_field)
     {
         printf("rank");
@@ -991,6 +1408,13 @@ void print_attr_values_custom(int rank, unsigned int *attr_list, int attr_count,
     char str[24576];
     struct attr_display_spec *rec;
 
+    if (machine_output())
+    {
+        mach_print_attr_values(rank, attr_list, attr_count, attrs, id,
+                               name_resolver, custom);
+        return;
+    }
+
     if (rank)
     {
         printf("%4d", rank);
@@ -1046,6 +1470,143 @@ static inline const char *attrdesc2name(const report_field_descr_t *desc,
     return rec->name;
 }
 
+/** type of a report field in machine output */
+static mach_type_e mach_report_type(const report_field_descr_t *desc)
+{
+    if (desc->report_type == 0 || desc->report_type == REPORT_GROUP_BY)
+        return mach_attr_type(desc->attr_index);
+    /* count, sum, min, max... */
+    return MACH_INT64;
+}
+
+/** append a report value to a record, with the given type */
+static void mach_db_value(mach_rec_t *rec, const db_value_t *val,
+                          mach_type_e type, unsigned int attr_index)
+{
+    const db_type_u *v = &val->value_u;
+    int64_t i;
+
+    if (DB_IS_NULL(val))
+    {
+        mach_null(rec);
+        return;
+    }
+
+    switch (type)
+    {
+        case MACH_INT64:
+            switch (val->type)
+            {
+                case DB_INT:     i = v->val_int; break;
+                case DB_UINT:    i = v->val_uint; break;
+                case DB_SHORT:   i = v->val_short; break;
+                case DB_USHORT:  i = v->val_ushort; break;
+                case DB_BIGINT:  i = v->val_bigint; break;
+                case DB_BIGUINT: i = v->val_biguint; break;
+                case DB_BOOL:    i = v->val_bool; break;
+                case DB_TEXT:    i = strtoll(v->val_str, NULL, 10); break;
+                default:
+                    mach_null(rec);
+                    return;
+            }
+            /* space used is displayed in bytes */
+            if (attr_index == ATTR_INDEX_blocks)
+                i *= DEV_BSIZE;
+            mach_int(rec, i);
+            break;
+
+        case MACH_ID:
+            if (val->type == DB_ID)
+                mach_id(rec, &v->val_id);
+            else
+                mach_null(rec);
+            break;
+
+        case MACH_STR:
+            if (val->type == DB_TEXT)
+                mach_str(rec, v->val_str);
+            else
+            {
+                GString *gs = g_string_new("");
+
+                ListMgr_PrintAttr(gs, val->type, v, "");
+                mach_str(rec, gs->str);
+                g_string_free(gs, TRUE);
+            }
+            break;
+    }
+}
+
+static void mach_display_report(const report_field_descr_t *descr,
+                                unsigned int field_count,
+                                const db_value_t *result,
+                                unsigned int result_count,
+                                const profile_field_descr_t *prof_descr,
+                                profile_u *p_prof, bool header, int rank)
+{
+    unsigned int count = MIN2(field_count, result_count);
+    bool prof = (prof_descr && prof_descr->attr_index == ATTR_INDEX_size);
+    unsigned int i;
+
+    if (header)
+    {
+        /* rank + fields + profile */
+        unsigned int max = count + SZ_PROFIL_COUNT + 1;
+        const char *names[max];
+        mach_type_e types[max];
+        unsigned int n = 0;
+
+        if (rank)
+        {
+            names[n] = "rank";
+            types[n++] = MACH_INT64;
+        }
+        for (i = 0; i < count; i++)
+        {
+            names[n] = attrdesc2name(&descr[i], attr_info(descr[i].attr_index));
+            types[n++] = mach_report_type(&descr[i]);
+        }
+        /* ratio is not displayed: it can be computed from counts */
+        if (prof)
+        {
+            for (i = 0; i < SZ_PROFIL_COUNT; i++)
+            {
+                names[n] = size_range[i].title;
+                types[n++] = MACH_INT64;
+            }
+        }
+        mach_header(mach_out_get(), n, names, types);
+        mach_out_write();
+    }
+
+    if (result)
+    {
+        mach_rec_t rec;
+
+        mach_rec_start(&rec, mach_out_get(),
+                       count + (rank ? 1 : 0) + (prof ? SZ_PROFIL_COUNT : 0));
+        if (rank)
+            mach_int(&rec, rank);
+
+        for (i = 0; i < count; i++)
+            mach_db_value(&rec, &result[i], mach_report_type(&descr[i]),
+                          descr[i].attr_index);
+
+        if (prof)
+        {
+            for (i = 0; i < SZ_PROFIL_COUNT; i++)
+            {
+                if (p_prof)
+                    mach_int(&rec, p_prof->size.file_count[i]);
+                else
+                    mach_null(&rec);
+            }
+        }
+        mach_rec_end(&rec);
+        mach_out_write();
+    }
+}
+
 /**
  * Generic function to display a report
  */
@@ -1057,6 +1618,13 @@ void display_report(const report_field_descr_t *descr, unsigned int field_count,
     unsigned int i;
     struct attr_display_spec *rec;
 
+    if (machine_output())
+    {
+        mach_display_report(descr, field_count, result, result_count,
+                            prof_descr, p_prof, header, rank);
+        return;
+    }
+
     if (header)
     {
         if (rank)
@@ -1141,6 +1709,140 @@ void display_report(const report_field_descr_t *descr, unsigned int field_count,
     }
 }
 
+static inline bool val_is_str(const db_value_t *val)
+{
+    return val->type == DB_TEXT || val->type == DB_ENUM_FTYPE;
+}
+
+/** resolve the names of the uids/gids of report items at once */
+static void report_items_prefetch(const report_items_t *items,
+                                  const report_field_descr_t *descr)
+{
+    uid_t       *uids;
+    gid_t       *gids;
+    unsigned int i, f;
+    unsigned int nb_uids = 0, nb_gids = 0;
+
+    uids = MemCalloc(items->count, sizeof(uid_t));
+    gids = MemCalloc(items->count, sizeof(gid_t));
+    if (uids == NULL || gids == NULL)
+        goto out;
+
+    for (i = 0; i < items->count; i++)
+    {
+        const db_value_t *row = &items->values[i * items->field_count];
+
+        for (f = 0; f < items->field_count; f++)
+        {
+            if (DB_IS_NULL(&row[f]))
+                continue;
+            if (descr[f].attr_index == ATTR_INDEX_uid)
+                uids[nb_uids++] = row[f].value_u.val_int;
+            else if (descr[f].attr_index == ATTR_INDEX_gid)
+                gids[nb_gids++] = row[f].value_u.val_int;
+        }
+    }
+    UidGidCache_Prefetch(uids, nb_uids, gids, nb_gids);
+
+out:
+    if (uids != NULL)
+        MemFree(uids);
+    if (gids != NULL)
+        MemFree(gids);
+}
+
+int report_items_load(struct lmgr_report_t *it,
+                      const report_field_descr_t *descr,
+                      unsigned int field_count, bool profile, bool csv,
+                      report_items_t *items)
+{
+    unsigned int alloc = 0;
+    unsigned int result_count;
+    unsigned int f;
+    int          rc;
+
+    memset(items, 0, sizeof(*items));
+    items->field_count = field_count;
+
+    for (;;)
+    {
+        db_value_t *row;
+
+        if (items->count == alloc)
+        {
+            void *tmp;
+
+            alloc = alloc ? 2 * alloc : 64;
+            tmp = MemRealloc(items->values,
+                             alloc * field_count * sizeof(db_value_t));
+            if (tmp == NULL)
+                goto nomem;
+            items->values = tmp;
+
+            if (profile)
+            {
+                tmp = MemRealloc(items->profiles, alloc * sizeof(profile_u));
+                if (tmp == NULL)
+                    goto nomem;
+                items->profiles = tmp;
+            }
+        }
+
+        row = &items->values[items->count * field_count];
+        result_count = field_count;
+        rc = ListMgr_GetNextReportItem(it, row, &result_count,
+                                       profile ?
+                                       &items->profiles[items->count] : NULL);
+        if (rc != DB_SUCCESS)
+            break;
+
+        /* unset fields are NULL */
+        for (f = result_count; f < field_count; f++)
+        {
+            row[f].type = DB_TEXT;
+            row[f].value_u.val_str = NULL;
+        }
+        /* strings only remain valid until the next item is read */
+        for (f = 0; f < field_count; f++)
+            if (val_is_str(&row[f]) && row[f].value_u.val_str != NULL)
+                row[f].value_u.val_str = strdup(row[f].value_u.val_str);
+
+        items->count++;
+    }
+
+    if (rc != DB_END_OF_LIST)
+    {
+        report_items_free(items);
+        return rc;
+    }
+
+    /* names are only displayed in human-readable output */
+    if (global_config.uid_gid_as_numbers && !csv && !machine_output()
+        && items->count > 0)
+        report_items_prefetch(items, descr);
+
+    return DB_SUCCESS;
+
+nomem:
+    report_items_free(items);
+    return DB_NO_MEMORY;
+}
+
+void report_items_free(report_items_t *items)
+{
+    unsigned int i;
+
+    for (i = 0; i < items->count * items->field_count; i++)
+        if (val_is_str(&items->values[i]))
+            free((char *)items->values[i].value_u.val_str);
+
+    if (items->values != NULL)
+        MemFree(items->values);
+    if (items->profiles != NULL)
+        MemFree(items->profiles);
+    memset(items, 0, sizeof(*items));
+}
+
 /** initialize internal resources (glib, llapi, internal resources...) */
 int rbh_init_internals(void)
 {
@@ -150,6 +150,128 @@ void display_report(const report_field_descr_t *descr, unsigned int field_count,
                     const profile_field_descr_t *prof_descr, profile_u *p_prof,
                     bool csv, bool header, int rank);
 
+/** report items read in advance (see report_items_load()) */
+typedef struct report_items_t {
+    unsigned int  field_count;
+    unsigned int  count;     /**< number of items */
+    db_value_t   *values;    /**< field_count values per item */
+    profile_u    *profiles;  /**< profile of each item (NULL if none) */
+} report_items_t;
+
+/**
+ * Read all the items of a report, so that the user and group names
+ * they contain are resolved at once (in parallel) before they are
+ * displayed by display_report().
+ * @param profile also read the profile of each item.
+ * @param csv     output is CSV (ids are displayed as numbers).
+ * @return DB_SUCCESS, or a DB error (items are then empty).
+ */
+int report_items_load(struct lmgr_report_t *it,
+                      const report_field_descr_t *descr,
+                      unsigned int field_count, bool profile, bool csv,
+                      report_items_t *items);
+
+static inline db_value_t *report_item(const report_items_t *items,
+                                      unsigned int i)
+{
+    return &items->values[i * items->field_count];
+}
+
+void report_items_free(report_items_t *items);
+
+/**
+ * Machine output.
+ *
+ * Instead of human-readable output (padded columns, sizes like "1.2 GB",
+ * formatted dates...), display helpers can produce output to be consumed
+ * by other programs. In this mode, values are raw: integers, sizes in
+ * bytes, times in seconds since the Epoch, modes as integers, FIDs with
+ * no brackets.
+ *
+ * OUT_NUL: each field is terminated by a '\0' character.
+ * Records all have the same number of fields. NULL values are empty
+ * fields. The optional header is a record with field names.
+ *
+ * OUT_BINARY (integers are in host byte order):
+ * - optional schema header: struct mach_header followed by
+ *   struct mach_field_def[field_count].
+ * - records: uint32_t length of the rest of the record, a validity bitmap
+ *   ((field_count + 7) / 8 bytes, bit is 0 for NULL values), then the
+ *   values of non-NULL fields:
+ *      MACH_INT64: int64_t
+ *      MACH_STR:   uint32_t length, followed by the string (no '\0')
+ *      MACH_ID:    raw entry_id_t (id_size bytes)
+ */
+typedef enum {
+    OUT_HUMAN = 0,  /**< human-readable output (default) */
+    OUT_NUL,        /**< raw values, '\0'-terminated fields */
+    OUT_BINARY,     /**< length-prefixed binary records */
+} out_format_e;
+
+/** set the output format of display helpers */
+void set_output_format(out_format_e fmt);
+out_format_e get_output_format(void);
+
+static inline bool machine_output(void)
+{
+    return get_output_format() != OUT_HUMAN;
+}
+
+#define MACH_MAGIC          "RBHOUT01"
+#define MACH_MAGIC_LEN      8
+#define MACH_VERSION        1
+#define MACH_NAME_LEN       64
+
+/** field types of binary output */
+typedef enum {
+    MACH_INT64 = 1,
+    MACH_STR   = 2,
+    MACH_ID    = 3,
+} mach_type_e;
+
+struct mach_header {
+    char     magic[MACH_MAGIC_LEN];
+    uint32_t version;
+    uint32_t field_count;
+    uint32_t id_size;    /**< sizeof(entry_id_t) */
+    uint32_t padding;
+};
+
+struct mach_field_def {
+    char     name[MACH_NAME_LEN];
+    uint32_t type;       /**< mach_type_e */
+    uint32_t padding;
+};
+
+/** record being built */
+typedef struct mach_rec {
+    GString      *out;
+    gsize         start;  /**< offset of the record in out */
+    unsigned int  field;  /**< index of the next field */
+} mach_rec_t;
+
+/** append the header (field names and types) to out */
+void mach_header(GString *out, unsigned int field_count,
+                 const char * const *names, const mach_type_e *types);
+
+void mach_rec_start(mach_rec_t *rec, GString *out, unsigned int field_count);
+void mach_int(mach_rec_t *rec, int64_t val);
+/** a NULL string is a NULL value */
+void mach_str(mach_rec_t *rec, const char *val);
+void mach_id(mach_rec_t *rec, const entry_id_t *id);
+void mach_null(mach_rec_t *rec);
+void mach_rec_end(mach_rec_t *rec);
+
+/** type of an attribute in machine output */
+mach_type_e mach_attr_type(unsigned int attr_index);
+
+/**
+ * Append an attribute value to a record.
+ * Unset attributes are NULL, including fullpath.
+ */
+void mach_attr(mach_rec_t *rec, const attr_set_t *attrs,
+               const entry_id_t *id, unsigned int attr_index);
+
 
 /** convert a list of attribute indexes into a attribute mask. */
 attr_mask_t list2mask(unsigned int *attr_list, int attr_count);
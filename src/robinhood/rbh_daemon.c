@@ -61,6 +61,7 @@ static time_t  boot_time;
 #define TGT_USAGE         267
 #define FORCE_ALL         268
 #define ALTER_DB          269
+#define SIMULATE          273
 
 /* deprecated params */
 #define FORCE_OST_PURGE   270
@@ -126,6 +127,7 @@ static struct option option_tab[] = {
 
     /* behavior flags */
     {"dry-run", no_argument, NULL, DRY_RUN},
+    {"simulate", no_argument, NULL, SIMULATE},
     {"one-shot", no_argument, NULL, 'O'}, /* for backward compatibility */
     {"once", no_argument, NULL, 'O'},
     {"detach", no_argument, NULL, 'd'},
@@ -304,6 +306,11 @@ static const char *run_help =
     "    " _B "--dry-run"B_"\n"
     "        Only report policy actions that would be performed without really doing them.\n"
     "        Note: Robinhood DB is impacted as if the reported actions were really done.\n"
+    "    " _B "--simulate"B_"\n"
+    "        Evaluate policy rules on candidate entries, without running actions\n"
+    "        nor modifying Robinhood DB, and report the expected volume, run time\n"
+    "        (based on previous policy runs) and whether the target is reachable.\n"
+    "        Implies --once.\n"
     "    " _B "--force-all"B_"\n"
     "        Force applying a policy to all eligible entries, without considering\n"
     "        policy limits and rule conditions.\n"
@@ -1099,6 +1106,9 @@ static int rh_read_parameters(const char *bin, int argc, char **argv,
         case DRY_RUN:
             opt->flags |= RUNFLG_DRY_RUN;
             break;
+        case SIMULATE:
+            opt->flags |= RUNFLG_SIMULATE | RUNFLG_ONCE;
+            break;
         case 'I':
             opt->flags |= RUNFLG_IGNORE_POL;
             break;
@@ -1227,6 +1237,14 @@ static int rh_read_parameters(const char *bin, int argc, char **argv,
         return EINVAL;
     }
 
+    /* a simulation must not run on a DB that is being updated */
+    if ((opt->flags & RUNFLG_SIMULATE)
+        && (*action_mask & (ACTION_MASK_SCAN | ACTION_MASK_HANDLE_EVENTS)))
+    {
+        fprintf(stderr, "Error: --simulate cannot be used with --scan or --readlog\n");
+        return EINVAL;
+    }
+
     return 0;
 } /* rh_read_parameters */
 
@@ -38,6 +38,8 @@
 
 #define DU_TAG "du"
 
+#define EXPLAIN_OPT 260
+
 static struct option option_tab[] =
 {
     {"user", required_argument, NULL, 'u'},
@@ -53,6 +55,7 @@ static struct option option_tab[] =
     {"mega", no_argument, NULL, 'm'},
     {"human-readable", no_argument, NULL, 'H'},
     {"details", no_argument, NULL, 'd'},
+    {"explain", no_argument, NULL, EXPLAIN_OPT},
 
     /* config file options */
     {"config-file", required_argument, NULL, 'f'},
@@ -100,6 +103,7 @@ struct du_opt
     display_mode    disp_what;
     display_unit    disp_how;
     unsigned int    sum:1;
+    unsigned int    explain:1;
 
 } prog_options = {
     .user = NULL, .group = NULL, .type = NULL,
@@ -315,16 +319,54 @@ static int mkfilters( void )
     if (is_expr)
     {
         char expr[RBH_PATH_MAX];
+        lmgr_pushdown_t pd;
+        GString *explain = NULL;
+        int rc;
+
         /* for debug */
         if (BoolExpr2str(&match_expr, expr, RBH_PATH_MAX)>0)
             DisplayLog(LVL_FULL, DU_TAG, "Expression matching: %s", expr);
 
+        if (prog_options.explain)
+            explain = g_string_new(NULL);
+
         /* append bool expr to entry filter */
-        /* Do not use 'OR' expression there */
-        convert_boolexpr_to_simple_filter(&match_expr, &entry_filter,
-                                          prog_options.smi, NULL, 0);
-        convert_boolexpr_to_simple_filter(&match_expr, &parent_filter,
-                                          prog_options.smi, NULL, 0);
+        rc = lmgr_pushdown_boolexpr(&match_expr, &entry_filter,
+                                    prog_options.smi, NULL, 0, &pd, explain);
+        if (rc == 0)
+            rc = lmgr_pushdown_boolexpr(&match_expr, &parent_filter,
+                                        prog_options.smi, NULL, 0, NULL,
+                                        NULL);
+        if (rc)
+        {
+            DisplayLog(LVL_CRIT, DU_TAG, "Failed to convert expression "
+                       "to DB filter (error %d)", rc);
+            return rc;
+        }
+
+        /* stats are computed by the DB: they can't be checked locally */
+        if (pd.residual != NULL)
+            DisplayLog(LVL_VERB, DU_TAG, "Some conditions are approximated "
+                       "by the DB request");
+        lmgr_pushdown_free(&pd);
+
+        if (explain != NULL)
+        {
+            printf("Conditions:\n%s", explain->str);
+            g_string_free(explain, TRUE);
+        }
+    }
+
+    if (prog_options.explain)
+    {
+        GString *where = g_string_new(NULL);
+
+        lmgr_filter2sql(&lmgr, &entry_filter, where);
+        printf("DB filter: %s\n", GSTRING_EMPTY(where) ? "(none)"
+                                                       : where->str);
+        printf("(db: evaluated by the DB, db+local: approximated by the DB, "
+               "local: ignored)\n");
+        g_string_free(where, TRUE);
     }
 
     return 0;
@@ -357,6 +399,8 @@ static const char *help_string =
     "    " _B "-d" B_ ", "_B "--details" B_"\n"
     "       show detailed stats: type, count, size, disk usage\n"
     "       (display in bytes by default)\n"
+    "    " _B "--explain" B_"\n"
+    "       display which conditions are evaluated by the DB request, then exit\n"
     "\n"
     _B "Program options:" B_ "\n"
     "    " _B "-f" B_ " " _U "config_file" U_ "\n"
@@ -760,6 +804,9 @@ int main( int argc, char **argv )
             case 'H':
                 prog_options.disp_how = disp_human;
                 break;
+            case EXPLAIN_OPT:
+                prog_options.explain = 1;
+                break;
 
             case 'u':
                 prog_options.match_user = 1;
@@ -901,7 +948,15 @@ int main( int argc, char **argv )
         prog_options.status_value = (char *)strval;
     }
 
-    mkfilters();
+    rc = mkfilters();
+    if (rc)
+        exit(rc);
+
+    if (prog_options.explain)
+    {
+        ListMgr_CloseAccess(&lmgr);
+        exit(0);
+    }
 
     if (argc == optind)
     {
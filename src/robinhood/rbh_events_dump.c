@@ -0,0 +1,218 @@
+/* -*- mode: c; c-basic-offset: 4; indent-tabs-mode: nil; -*-
+ * vim:expandtab:shiftwidth=4:tabstop=4:
+ */
+/*
+ * Copyright (C) 2016 CEA/DAM
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the CeCILL License.
+ *
+ * The fact that you are presently reading this means that you have had
+ * knowledge of the CeCILL license (http://www.cecill.info) and that you
+ * accept its terms.
+ */
+
+/**
+ * Read binary event files (Log::events_file) and convert them
+ * to text or JSON (one record per line).
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include "rbh_events.h"
+#include "rbh_basename.h"
+
+#include <errno.h>
+#include <getopt.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+static struct option option_tab[] = {
+    {"json", no_argument, NULL, 'j'},
+    {"type", required_argument, NULL, 't'},
+
+    /* miscellaneous options */
+    {"help", no_argument, NULL, 'h'},
+    {"version", no_argument, NULL, 'V'},
+
+    {NULL, 0, NULL, 0}
+};
+
+#define SHORT_OPT_STRING    "jt:hV"
+
+/* Bold start character sequence */
+#define _B "[1m"
+/* Bold end character sequence */
+#define B_ "[m"
+
+/* Underline start character sequence */
+#define _U "[4m"
+/* Underline end character sequence */
+#define U_ "[0m"
+
+static const char *help_string =
+    _B "Usage:" B_ " %s [options] [" _U "file" U_ "...]\n"
+    "\n"
+    "Convert robinhood binary event files to text (default) or JSON.\n"
+    "Standard input is read if no file is specified, or for '-'.\n"
+    "\n"
+    _B "Options:" B_ "\n"
+    "    " _B "-j" B_ ", " _B "--json" B_ "\n"
+    "        Output one JSON object per record.\n"
+    "    " _B "-t" B_ " " _U "type" U_ ", " _B "--type" B_ "=" _U "type" U_ "\n"
+    "        Only display records of the given type: changelog, db_op, action.\n"
+    "        This option can be repeated.\n"
+    "\n"
+    _B "Miscellaneous options:" B_ "\n"
+    "    " _B "-h" B_ ", " _B "--help" B_ "\n"
+    "        Display a short help about command line options.\n"
+    "    " _B "-V" B_ ", " _B "--version" B_ "\n"
+    "        Display version info\n";
+
+static inline void display_help(const char *bin_name)
+{
+    printf(help_string, bin_name);
+}
+
+static inline void display_version(const char *bin_name)
+{
+    printf("\n");
+    printf("Product:         " PACKAGE_NAME "\n");
+    printf("Version:         " PACKAGE_VERSION "-"RELEASE"\n");
+    printf("Build:           " COMPIL_DATE "\n");
+    printf("Event format:    %u\n", RBH_EVT_VERSION);
+    printf("\n");
+}
+
+static int str2evt_type(const char *str)
+{
+    if (!strcasecmp(str, "changelog"))
+        return RBH_EVT_CHANGELOG;
+    if (!strcasecmp(str, "db_op"))
+        return RBH_EVT_DB_OP;
+    if (!strcasecmp(str, "action"))
+        return RBH_EVT_ACTION;
+    return -1;
+}
+
+/** bitmap of record types to be displayed (0 = all) */
+static unsigned int type_mask = 0;
+
+static int dump_file(const char *path, rbh_evt_format_t format,
+                     struct rbh_evt_hdr *buf)
+{
+    struct rbh_evt_file_hdr fhdr;
+    FILE *stream;
+    unsigned long long count = 0;
+    int rc;
+
+    if (!strcmp(path, "-"))
+        stream = stdin;
+    else
+    {
+        stream = fopen(path, "r");
+        if (stream == NULL)
+        {
+            rc = errno;
+            fprintf(stderr, "Failed to open %s: %s\n", path, strerror(rc));
+            return rc;
+        }
+    }
+
+    rc = rbh_evt_read_file_hdr(stream, &fhdr);
+    if (rc)
+    {
+        fprintf(stderr, "%s: not a robinhood event file, or unsupported "
+                "format version\n", path);
+        goto close;
+    }
+
+    while ((rc = rbh_evt_read(stream, buf)) == 0)
+    {
+        count++;
+        if (type_mask != 0 && !(type_mask & (1 << buf->type)))
+            continue;
+        rbh_evt_print(stdout, &fhdr, buf, format);
+    }
+
+    if (rc < 0)
+    {
+        fprintf(stderr, "%s: invalid or truncated record after %llu records: %s\n",
+                path, count, strerror(-rc));
+        rc = -rc;
+    }
+    else
+        rc = 0;
+
+close:
+    if (stream != stdin)
+        fclose(stream);
+    return rc;
+}
+
+int main(int argc, char **argv)
+{
+    const char *bin = rh_basename(argv[0]);
+    rbh_evt_format_t format = RBH_EVT_FMT_TEXT;
+    struct rbh_evt_hdr *buf;
+    int c, t, i;
+    int rc = 0;
+
+    while ((c = getopt_long(argc, argv, SHORT_OPT_STRING, option_tab,
+                            NULL)) != -1)
+    {
+        switch (c)
+        {
+        case 'j':
+            format = RBH_EVT_FMT_JSON;
+            break;
+        case 't':
+            t = str2evt_type(optarg);
+            if (t < 0)
+            {
+                fprintf(stderr, "Invalid record type '%s': changelog, db_op "
+                        "or action expected.\n", optarg);
+                exit(EINVAL);
+            }
+            type_mask |= (1 << t);
+            break;
+        case 'h':
+            display_help(bin);
+            exit(0);
+        case 'V':
+            display_version(bin);
+            exit(0);
+        case ':':
+        case '?':
+        default:
+            display_help(bin);
+            exit(1);
+        }
+    }
+
+    /* 8 bytes aligned buffer for records */
+    buf = malloc(RBH_EVT_MAX_SIZE);
+    if (buf == NULL)
+    {
+        fprintf(stderr, "Cannot allocate memory\n");
+        exit(ENOMEM);
+    }
+
+    if (optind >= argc)
+        rc = dump_file("-", format, buf);
+
+    for (i = optind; i < argc; i++)
+    {
+        int rc2 = dump_file(argv[i], format, buf);
+
+        if (rc2 && !rc)
+            rc = rc2;
+    }
+
+    free(buf);
+    fflush(stdout);
+    return rc;
+}
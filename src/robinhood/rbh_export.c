@@ -0,0 +1,554 @@
+/* -*- mode: c; c-basic-offset: 4; indent-tabs-mode: nil; -*-
+ * vim:expandtab:shiftwidth=4:tabstop=4:
+ */
+/*
+ * Copyright (C) 2016 CEA/DAM
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the CeCILL License.
+ *
+ * The fact that you are presently reading this means that you have had
+ * knowledge of the CeCILL license (http://www.cecill.info) and that you
+ * accept its terms.
+ */
+
+/**
+ * Export a consistent snapshot of robinhood DB contents
+ * to a column-oriented file, for offline analysis.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include "list_mgr.h"
+#include "cmd_helpers.h"
+#include "rbh_cfg.h"
+#include "rbh_logs.h"
+#include "rbh_misc.h"
+#include "rbh_snapshot.h"
+#include "status_manager.h"
+#include "Memory.h"
+#include "xplatform_print.h"
+#include "rbh_basename.h"
+
+#include <unistd.h>
+#include <getopt.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <errno.h>
+
+#define EXPORT_TAG "Export"
+
+static struct option option_tab[] =
+{
+    /* output options */
+    {"no-compress", no_argument, NULL, 'Z'},
+    {"group-rows", required_argument, NULL, 'g'},
+
+    /* config file options */
+    {"config-file", required_argument, NULL, 'f'},
+
+    /* log options */
+    {"log-level", required_argument, NULL, 'l'},
+
+    /* miscellaneous options */
+    {"help", no_argument, NULL, 'h'},
+    {"version", no_argument, NULL, 'V'},
+
+    {NULL, 0, NULL, 0}
+
+};
+
+#define SHORT_OPT_STRING    "Zg:f:l:hV"
+
+/* global variables */
+
+static lmgr_t  lmgr;
+
+/* program options */
+struct export_opt
+{
+    unsigned int group_rows;
+    bool         compress;
+} prog_options = {
+    .group_rows = 0, /* default */
+    .compress = true,
+};
+
+/** description of an exported column */
+struct export_col {
+    unsigned int    attr_index;
+    const char     *name;
+    snap_col_type_e type;
+};
+
+/* column 0 is the entry id */
+#define ID_COL  0
+
+static struct export_col *cols = NULL;
+static unsigned int       col_count = 0;
+
+static const char *help_string =
+    _B "Usage:" B_ " %s [options] <output_file>\n"
+    "\n"
+    "Export a consistent snapshot of entries, with their names, fullpath,\n"
+    "fileclasses and status manager information, to a column-oriented file.\n"
+    "\n"
+    _B "Output options:" B_ "\n"
+    "    " _B "-Z" B_ ", " _B "--no-compress" B_ "\n"
+    "        Don't compress columns (the file can then be read in place\n"
+    "        from a memory mapping).\n"
+    "    " _B "-g" B_ " " _U "count" U_ ", " _B "--group-rows" B_ "=" _U "count" U_ "\n"
+    "        Number of entries per group of rows (default: %u).\n"
+    "\n"
+    _B "Program options:" B_ "\n"
+    "    " _B "-f" B_ " " _U "config_file" U_ "\n"
+    "    " _B "-l" B_ " " _U "log_level" U_ "\n"
+    "    " _B "-h" B_ ", " _B "--help" B_ "\n"
+    "        Display a short help about command line options.\n"
+    "    " _B "-V" B_ ", " _B "--version" B_ "\n"
+    "        Display version info\n";
+
+static inline void display_help(const char *bin_name)
+{
+    printf(help_string, bin_name, SNAP_DEFAULT_GROUP_ROWS);
+}
+
+static inline void display_version(const char *bin_name)
+{
+    printf( "\n" );
+    printf( "Product:         " PACKAGE_NAME " export command\n" );
+    printf( "Version:         " PACKAGE_VERSION "-"RELEASE"\n" );
+    printf( "Build:           " COMPIL_DATE "\n" );
+    printf( "\n" );
+#ifdef _MYSQL
+    printf( "Database binding: MySQL\n" );
+#elif defined(_SQLITE)
+    printf( "Database binding: SQLite\n" );
+#else
+#error "No database was specified"
+#endif
+    printf( "\n" );
+    printf( "Report bugs to: <" PACKAGE_BUGREPORT ">\n" );
+    printf( "\n" );
+}
+
+/** column type for a given DB type */
+static snap_col_type_e db2col_type(db_type_e type)
+{
+    switch (type)
+    {
+        case DB_INT:
+        case DB_UINT:
+        case DB_SHORT:
+        case DB_USHORT:
+        case DB_BIGINT:
+        case DB_BIGUINT:
+        case DB_BOOL:
+            return SNAP_COL_INT64;
+        case DB_UIDGID:
+            return global_config.uid_gid_as_numbers ? SNAP_COL_INT64
+                                                    : SNAP_COL_STR;
+        default:
+            return SNAP_COL_STR;
+    }
+}
+
+/** check if a standard attribute is exported */
+static bool std_attr_exported(unsigned int index)
+{
+    /* stripe info, directory aggregates and removed entries
+     * attributes are not exported */
+    if (field_infos[index].db_type == DB_STRIPE_INFO
+        || field_infos[index].db_type == DB_STRIPE_ITEMS)
+        return false;
+
+    return !(field_infos[index].flags & (DIR_ATTR | REMOVED));
+}
+
+/** build the list of exported columns and the related attribute mask */
+static int build_columns(attr_mask_t *mask)
+{
+    int cookie = -1;
+    int i;
+
+    /* id + std attrs + status + sm_info */
+    cols = MemCalloc(1 + ATTR_COUNT + sm_inst_count + sm_attr_count,
+                     sizeof(*cols));
+    if (cols == NULL)
+        return -ENOMEM;
+
+    cols[ID_COL].name = "id";
+    cols[ID_COL].type = SNAP_COL_STR;
+    col_count = 1;
+
+    memset(mask, 0, sizeof(*mask));
+
+    while ((i = attr_index_iter(0, &cookie)) != -1)
+    {
+        struct export_col *col = &cols[col_count];
+
+        if (is_status(i))
+        {
+            col->name = get_sm_instance(attr2status_index(i))->user_name;
+            col->type = SNAP_COL_STR;
+        }
+        else if (is_sm_info(i))
+        {
+            unsigned int idx = attr2sminfo_index(i);
+
+            col->name = sm_attr_info[idx].user_attr_name;
+            col->type = db2col_type(sm_attr_info[idx].def->db_type);
+        }
+        else if (is_std_attr(i) && std_attr_exported(i))
+        {
+            col->name = field_infos[i].field_name;
+            col->type = db2col_type(field_infos[i].db_type);
+        }
+        else
+            continue;
+
+        col->attr_index = i;
+        attr_mask_set_index(mask, i);
+        col_count++;
+    }
+    return 0;
+}
+
+/** store a typed value to the given column */
+static int set_value(snap_writer_t *w, unsigned int col, db_type_e type,
+                     const void *addr)
+{
+    char buff[RBH_PATH_MAX];
+
+    switch (type)
+    {
+        case DB_TEXT:
+        case DB_ENUM_FTYPE:
+            return snap_writer_set_str(w, col, (const char *)addr);
+        case DB_UIDGID:
+            if (global_config.uid_gid_as_numbers)
+                return snap_writer_set_int(w, col, ((uidgid_u *)addr)->num);
+            else
+                return snap_writer_set_str(w, col, ((uidgid_u *)addr)->txt);
+        case DB_ID:
+            snprintf(buff, sizeof(buff), DFID_NOBRACE,
+                     PFID((entry_id_t *)addr));
+            return snap_writer_set_str(w, col, buff);
+        case DB_INT:
+            return snap_writer_set_int(w, col, *(int *)addr);
+        case DB_UINT:
+            return snap_writer_set_int(w, col, *(unsigned int *)addr);
+        case DB_SHORT:
+            return snap_writer_set_int(w, col, *(short *)addr);
+        case DB_USHORT:
+            return snap_writer_set_int(w, col, *(unsigned short *)addr);
+        case DB_BIGINT:
+            return snap_writer_set_int(w, col, *(long long *)addr);
+        case DB_BIGUINT:
+            return snap_writer_set_int(w, col, *(unsigned long long *)addr);
+        case DB_BOOL:
+            return snap_writer_set_int(w, col, *(bool *)addr);
+        default:
+            return EINVAL;
+    }
+}
+
+/** add an entry to the snapshot */
+static int export_entry(snap_writer_t *w, const entry_id_t *id,
+                        attr_set_t *attrs)
+{
+    char buff[RBH_PATH_MAX];
+    int  i, rc;
+
+    snprintf(buff, sizeof(buff), DFID_NOBRACE, PFID(id));
+    rc = snap_writer_set_str(w, ID_COL, buff);
+    if (rc)
+        return rc;
+
+    for (i = ID_COL + 1; i < col_count; i++)
+    {
+        unsigned int index = cols[i].attr_index;
+
+        if (!attr_mask_test_index(&attrs->attr_mask, index))
+            continue;
+
+        if (is_status(index))
+        {
+            const char *status = STATUS_ATTR(attrs, attr2status_index(index));
+
+            if (status != NULL)
+                rc = snap_writer_set_str(w, i, status);
+        }
+        else if (is_sm_info(index))
+        {
+            unsigned int idx = attr2sminfo_index(index);
+            const void  *val = attrs->attr_values.sm_info[idx];
+
+            if (val != NULL)
+                rc = set_value(w, i, sm_attr_info[idx].def->db_type, val);
+        }
+        else
+            rc = set_value(w, i, field_infos[index].db_type,
+                           (char *)&attrs->attr_values
+                           + field_infos[index].offset);
+        if (rc)
+            return rc;
+    }
+
+    return snap_writer_end_row(w);
+}
+
+/**
+ * Export all entries to the given file.
+ */
+static int export_all(const char *path)
+{
+    struct lmgr_iterator_t *it;
+    snap_writer_t  *w;
+    lmgr_filter_t   filter;
+    attr_mask_t     mask;
+    attr_set_t      attrs;
+    entry_id_t      id;
+    const char    **names;
+    snap_col_type_e *types;
+    uint64_t        count = 0;
+    int             i, rc, err = 0;
+
+    rc = build_columns(&mask);
+    if (rc)
+        return rc;
+
+    names = MemCalloc(col_count, sizeof(*names));
+    types = MemCalloc(col_count, sizeof(*types));
+    if (names == NULL || types == NULL)
+        return -ENOMEM;
+
+    for (i = 0; i < col_count; i++)
+    {
+        names[i] = cols[i].name;
+        types[i] = cols[i].type;
+    }
+
+    w = snap_writer_create(path, col_count, names, types,
+                           prog_options.group_rows, prog_options.compress,
+                           &err);
+    MemFree(names);
+    MemFree(types);
+    if (w == NULL)
+    {
+        fprintf(stderr, "Failed to create '%s': %s\n", path, strerror(err));
+        return -err;
+    }
+
+    /* all requests must see the same state of the DB */
+    rc = ListMgr_BeginSnapshot(&lmgr);
+    if (rc)
+    {
+        DisplayLog(LVL_CRIT, EXPORT_TAG, "Failed to start DB snapshot: %s (%d)",
+                   lmgr_err2str(rc), rc);
+        snap_writer_close(w, false);
+        return rc;
+    }
+
+    lmgr_simple_filter_init(&filter);
+
+    it = ListMgr_Iterator(&lmgr, &filter, NULL, NULL);
+    if (it == NULL)
+    {
+        DisplayLog(LVL_CRIT, EXPORT_TAG,
+                   "ERROR: cannot retrieve entry list from database");
+        rc = -1;
+        goto out;
+    }
+
+    attrs.attr_mask = mask;
+    while ((rc = ListMgr_GetNext(it, &id, &attrs)) == DB_SUCCESS)
+    {
+        err = export_entry(w, &id, &attrs);
+        ListMgr_FreeAttrs(&attrs);
+        if (err)
+        {
+            DisplayLog(LVL_CRIT, EXPORT_TAG, "Failed to export entry "DFID": %s",
+                       PFID(&id), strerror(err));
+            break;
+        }
+
+        count++;
+        if (count % 1000000 == 0)
+            DisplayLog(LVL_EVENT, EXPORT_TAG, "%"PRIu64" entries exported",
+                       count);
+
+        /* prepare next call */
+        attrs.attr_mask = mask;
+    }
+    ListMgr_CloseIterator(it);
+
+    if (rc == DB_END_OF_LIST && err == 0)
+        rc = 0;
+    else if (rc == DB_END_OF_LIST || rc == DB_SUCCESS)
+        rc = -err;
+    else
+        DisplayLog(LVL_CRIT, EXPORT_TAG, "Error %d listing entries: %s",
+                   rc, lmgr_err2str(rc));
+
+out:
+    lmgr_simple_filter_free(&filter);
+    ListMgr_EndSnapshot(&lmgr);
+
+    err = snap_writer_close(w, (rc == 0));
+    if (rc == 0 && err != 0)
+        rc = -err;
+
+    if (rc == 0)
+        DisplayLog(LVL_EVENT, EXPORT_TAG, "%"PRIu64" entries exported to '%s'",
+                   count, path);
+    return rc;
+}
+
+#define MAX_OPT_LEN 1024
+
+/**
+ * Main routine
+ */
+int main(int argc, char **argv)
+{
+    int            c, option_index = 0;
+    const char    *bin;
+    char           config_file[MAX_OPT_LEN] = "";
+    bool           force_log_level = false;
+    int            log_level = 0;
+    int            rc;
+    bool           chgd = false;
+    char           err_msg[4096];
+    char           badcfg[RBH_PATH_MAX];
+
+    bin = rh_basename(argv[0]);
+
+    /* parse command line options */
+    while ((c = getopt_long(argc, argv, SHORT_OPT_STRING, option_tab,
+                            &option_index)) != -1)
+    {
+        switch (c)
+        {
+            case 'Z':
+                prog_options.compress = false;
+                break;
+            case 'g':
+                prog_options.group_rows = str2int(optarg);
+                if ((int)prog_options.group_rows <= 0)
+                {
+                    fprintf(stderr, "Invalid value for '--group-rows': "
+                            "positive integer expected.\n");
+                    exit(1);
+                }
+                break;
+            case 'f':
+                rh_strncpy(config_file, optarg, MAX_OPT_LEN);
+                break;
+            case 'l':
+                force_log_level = true;
+                log_level = str2debuglevel(optarg);
+                if (log_level == -1)
+                {
+                    fprintf(stderr,
+                            "Unsupported log level '%s'. CRIT, MAJOR, EVENT, VERB, DEBUG or FULL expected.\n",
+                            optarg);
+                    exit(1);
+                }
+                break;
+            case 'h':
+                display_help(bin);
+                exit(0);
+                break;
+            case 'V':
+                display_version(bin);
+                exit(0);
+                break;
+            case ':':
+            case '?':
+            default:
+                display_help(bin);
+                exit(1);
+                break;
+        }
+    }
+
+    if (optind != argc - 1)
+    {
+        display_help(bin);
+        exit(1);
+    }
+
+    /* initialize internal resources (glib, llapi, internal resources...) */
+    rc = rbh_init_internals();
+    if (rc != 0)
+        exit(rc);
+
+    /* get default config file, if not specified */
+    if (SearchConfig(config_file, config_file, &chgd, badcfg, MAX_OPT_LEN) != 0)
+    {
+        fprintf(stderr, "No config file (or too many) found matching %s\n", badcfg);
+        exit(2);
+    }
+    else if (chgd)
+    {
+        fprintf(stderr, "Using config file '%s'.\n", config_file);
+    }
+
+    /* only read common config (listmgr, ...) (mask=0) */
+    if (rbh_cfg_load(0, config_file, err_msg))
+    {
+        fprintf(stderr, "Error reading configuration file '%s': %s\n",
+                config_file, err_msg);
+        exit(1);
+    }
+
+    if (force_log_level)
+        log_config.debug_level = log_level;
+    else
+        log_config.debug_level = LVL_MAJOR; /* no event message */
+
+    /* Set logging to stderr */
+    strcpy(log_config.log_file, "stderr");
+    strcpy(log_config.report_file, "stderr");
+    strcpy(log_config.alert_file, "stderr");
+
+    /* Initialize logging */
+    rc = InitializeLogs(bin);
+    if (rc)
+    {
+        fprintf(stderr, "Error opening log files: rc=%d, errno=%d: %s\n",
+                rc, errno, strerror(errno));
+        exit(rc);
+    }
+
+    /* Initialize list manager */
+    rc = ListMgr_Init(LIF_REPORT_ONLY);
+    if (rc)
+    {
+        DisplayLog(LVL_CRIT, EXPORT_TAG, "Error initializing list manager: %s (%d)",
+                   lmgr_err2str(rc), rc);
+        exit(rc);
+    }
+    else
+        DisplayLog(LVL_DEBUG, EXPORT_TAG, "ListManager successfully initialized");
+
+    if (CheckLastFS() != 0)
+        exit(1);
+
+    /* Create database access */
+    rc = ListMgr_InitAccess(&lmgr);
+    if (rc)
+    {
+        DisplayLog(LVL_CRIT, EXPORT_TAG, "Error %d: cannot connect to database", rc);
+        exit(rc);
+    }
+
+    rc = export_all(argv[optind]);
+
+    ListMgr_CloseAccess(&lmgr);
+
+    return (rc == 0) ? 0 : 1;
+}
@@ -29,6 +29,7 @@
 #include "Memory.h"
 #include "xplatform_print.h"
 #include "rbh_basename.h"
+#include "uidgidcache.h"
 
 #include <unistd.h>
 #include <getopt.h>
@@ -44,6 +45,10 @@
 #define LSCLASS_OPT 262
 #define ESCAPED_OPT 263
 #define INAME_OPT   264
+#define THREADS_OPT 265
+#define PRINT0_OPT  266
+#define BINARY_OPT  267
+#define EXPLAIN_OPT 268
 
 static struct option option_tab[] =
 {
@@ -75,6 +80,8 @@ static struct option option_tab[] =
     {"ls", no_argument, NULL, 'l'},
     {"print", no_argument, NULL, 'p'},
     {"printf", required_argument, NULL, PRINTF_OPT},
+    {"print0", no_argument, NULL, PRINT0_OPT},
+    {"binary", no_argument, NULL, BINARY_OPT},
     {"escaped", no_argument, NULL, ESCAPED_OPT},
     {"exec", required_argument, NULL, 'E'},
     /* TODO dry-run mode for exec ? */
@@ -82,6 +89,8 @@ static struct option option_tab[] =
     /* query options */
     {"not", no_argument, NULL, '!'},
     {"nobulk", no_argument, NULL, 'b'},
+    {"threads", required_argument, NULL, THREADS_OPT},
+    {"explain", no_argument, NULL, EXPLAIN_OPT},
 
     /* config file options */
     {"config-file", required_argument, NULL, 'f'},
@@ -138,10 +147,20 @@ static lmgr_filter_t    entry_filter;
 static bool_node_t      match_expr;
 static int              is_expr = 0; /* is it set? */
 
+/* part of match_expr that entries returned by entry_filter
+ * must still be checked against */
+static lmgr_pushdown_t  pushdown;
+/* description of entry_filter, for -explain */
+static GString         *explain_str = NULL;
+
 /* printf string, when prog_options.printf is set. */
 const char *printf_str;
 GArray *printf_chunks;
 
+/* fields of machine output (-print0, -binary) */
+static unsigned int *mach_fields = NULL;
+static unsigned int mach_field_count = 0;
+
 /* build filters depending on program options */
 static int mkfilters(bool exclude_dirs)
 {
@@ -388,22 +407,77 @@ static int mkfilters(bool exclude_dirs)
         lmgr_simple_filter_add(&entry_filter, ATTR_INDEX_type, NOTEQUAL, fv, 0);
     }
 
+    lmgr_pushdown_free(&pushdown);
+    if (prog_options.explain)
+    {
+        if (explain_str == NULL)
+            explain_str = g_string_new(NULL);
+        else
+            g_string_truncate(explain_str, 0);
+    }
+
     if (is_expr)
     {
         char expr[RBH_PATH_MAX];
+        int  rc;
+
         /* for debug */
         if (BoolExpr2str(&match_expr, expr, RBH_PATH_MAX)>0)
             DisplayLog(LVL_FULL, FIND_TAG, "Expression matching: %s", expr);
 
-        /* append bool expr to entry filter */
-        /* Do not use 'OR' expression there */
-        convert_boolexpr_to_simple_filter(&match_expr, &entry_filter,
-                                          prog_options.filter_smi, NULL, 0);
+        /* append bool expr to entry filter.
+         * Names are not filtered when listing directory children. */
+        rc = lmgr_pushdown_boolexpr(&match_expr, &entry_filter,
+                                    prog_options.filter_smi, NULL,
+                                    exclude_dirs ? PUSHDOWN_SKIP_NAMES : 0,
+                                    &pushdown, explain_str);
+        if (rc)
+        {
+            DisplayLog(LVL_MAJOR, FIND_TAG, "Failed to convert expression "
+                       "to DB filter (error %d): checking all of it locally",
+                       rc);
+            pushdown.residual = &match_expr;
+        }
     }
 
     return 0;
 }
 
+/** display how entries are filtered (-explain) and exit */
+static void explain_query(bool bulk)
+{
+    GString *where = g_string_new(NULL);
+
+    lmgr_filter2sql(&lmgr, &entry_filter, where);
+
+    printf("Request: %s\n", bulk ? "bulk listing of DB entries"
+                                 : "listing of directory children");
+    printf("Conditions:\n");
+    if (GSTRING_EMPTY(explain_str))
+        printf("    (none)\n");
+    else
+    {
+        char *line, *next;
+
+        for (line = explain_str->str; *line != '\0'; line = next)
+        {
+            next = strchr(line, '\n');
+            if (next == NULL)
+                next = line + strlen(line);
+            else
+                *(next++) = '\0';
+            printf("    %s\n", line);
+        }
+    }
+    printf("DB filter: %s\n", GSTRING_EMPTY(where) ? "(none)" : where->str);
+    printf("(db: evaluated by the DB, db+local: pre-filtered by the DB and "
+           "checked locally, local: checked locally)\n");
+
+    g_string_free(where, TRUE);
+    ListMgr_CloseAccess(&lmgr);
+    exit(0);
+}
+
 static const char *help_string =
     _B "Usage:" B_ " %s [options] [path|fid]...\n"
     "\n"
@@ -476,6 +550,12 @@ static const char *help_string =
     "            " _B "\\n" B_ "\t Newline\n"
     "            " _B "\\t" B_ "\t Tab\n"
     "    " _B "-escaped" B_" \t When -printf is used, escape unprintable characters.\n"
+    "    " _B "-print0" B_" \t Display raw values of matching entries, each terminated by a null character.\n"
+    "       With no other output option, only the fullpath is displayed (like `find -print0`).\n"
+    "       With -ls, -lsost, -lsclass or -lsstatus, the displayed fields are the ones\n"
+    "       of these options (sizes in bytes, times in seconds since the Epoch, modes as integers).\n"
+    "    " _B "-binary" B_" \t Same fields as -print0, as length-prefixed binary records,\n"
+    "       preceded by a schema header.\n"
     "\n"
     _B "Actions:" B_ "\n"
     "    " _B "-exec" B_" "_U "\"cmd\"" U_ "\n"
@@ -490,6 +570,13 @@ static const char *help_string =
     "       This speeds up the query, but this may result in an arbitrary output ordering,\n"
     "       and a single path may be displayed in case of multiple hardlinks.\n"
     "       Use -nobulk to disable this optimization.\n"
+    "    " _B "-threads" B_ " " _U "nbr" U_ "\n"
+    "       In bulk mode, format the output using "_U"nbr"U_" threads, while the main\n"
+    "       thread fetches entries from the DB. Output order is preserved.\n"
+    "       This option is ignored when -exec is used.\n"
+    "    " _B "-explain" B_ "\n"
+    "       Display which conditions are evaluated by the DB request, and which are\n"
+    "       checked locally for each returned entry, then exit.\n"
     "\n"
     _B "Program options:" B_ "\n"
     "    " _B "-f" B_ " " _U "config_file" U_ "\n"
@@ -791,7 +878,135 @@ static int set_time_filter(char * str, unsigned int multiplier,
     return 0;
 }
 
-static void print_entry(const wagon_t *id, const attr_set_t * attrs)
+/**
+ * Build the list of fields for machine output, according to display
+ * options, and write the schema header for binary output.
+ */
+static void build_mach_fields(void)
+{
+    const char **names;
+    mach_type_e *types;
+    int i;
+
+    /* id, type, mode, nlink, uid, gid, size, mtime, path, link,
+     * status(es), fileclass, osts */
+    mach_fields = MemCalloc(12 + sm_inst_count, sizeof(*mach_fields));
+    if (mach_fields == NULL)
+        exit(ENOMEM);
+
+    if (prog_options.ls)
+    {
+        mach_fields[mach_field_count++] = ATTR_INDEX_ID;
+        mach_fields[mach_field_count++] = ATTR_INDEX_type;
+        mach_fields[mach_field_count++] = ATTR_INDEX_mode;
+        mach_fields[mach_field_count++] = ATTR_INDEX_nlink;
+        mach_fields[mach_field_count++] = ATTR_INDEX_uid;
+        mach_fields[mach_field_count++] = ATTR_INDEX_gid;
+        mach_fields[mach_field_count++] = ATTR_INDEX_size;
+        mach_fields[mach_field_count++] = ATTR_INDEX_last_mod;
+        mach_fields[mach_field_count++] = ATTR_INDEX_fullpath;
+        mach_fields[mach_field_count++] = ATTR_INDEX_link;
+    }
+    else if (prog_options.lsost || prog_options.lsclass
+             || prog_options.lsstatus)
+    {
+        mach_fields[mach_field_count++] = ATTR_INDEX_ID;
+        mach_fields[mach_field_count++] = ATTR_INDEX_type;
+        mach_fields[mach_field_count++] = ATTR_INDEX_size;
+        mach_fields[mach_field_count++] = ATTR_INDEX_fullpath;
+    }
+    else
+        /* just the path, like 'find -print0' */
+        mach_fields[mach_field_count++] = ATTR_INDEX_fullpath;
+
+    if (prog_options.lsstatus && prog_options.smi == NULL)
+    {
+        for (i = 0; i < sm_inst_count; i++)
+            mach_fields[mach_field_count++] = ATTR_INDEX_FLG_STATUS | i;
+    }
+    else
+    {
+        if (prog_options.filter_smi)
+            mach_fields[mach_field_count++] = ATTR_INDEX_FLG_STATUS
+                                    | prog_options.filter_smi->smi_index;
+        if (prog_options.lsstatus
+            && prog_options.smi != prog_options.filter_smi)
+            mach_fields[mach_field_count++] = ATTR_INDEX_FLG_STATUS
+                                    | prog_options.smi->smi_index;
+    }
+    if (prog_options.lsclass)
+        mach_fields[mach_field_count++] = ATTR_INDEX_fileclass;
+#ifdef _LUSTRE
+    if (prog_options.lsost)
+        mach_fields[mach_field_count++] = ATTR_INDEX_stripe_items;
+#endif
+
+    /* the schema is needed to read binary output */
+    if (get_output_format() != OUT_BINARY)
+        return;
+
+    names = MemCalloc(mach_field_count, sizeof(*names));
+    types = MemCalloc(mach_field_count, sizeof(*types));
+    if (names == NULL || types == NULL)
+        exit(ENOMEM);
+
+    for (i = 0; i < mach_field_count; i++)
+    {
+        names[i] = attrindex2name(mach_fields[i]);
+        types[i] = mach_attr_type(mach_fields[i]);
+    }
+    mach_header(find_out(), mach_field_count, names, types);
+    find_out_commit();
+
+    MemFree(names);
+    MemFree(types);
+}
+
+/** format an entry for machine output */
+static void mach_format_entry(GString *out, const wagon_t *id,
+                              const attr_set_t *attrs)
+{
+    mach_rec_t rec;
+    int i;
+
+    mach_rec_start(&rec, out, mach_field_count);
+    for (i = 0; i < mach_field_count; i++)
+    {
+        if (mach_fields[i] == ATTR_INDEX_fullpath)
+            mach_str(&rec, id->fullname);
+        else
+            mach_attr(&rec, attrs, &id->id, mach_fields[i]);
+    }
+    mach_rec_end(&rec);
+}
+
+/** execute the -exec command for an entry */
+static void exec_entry(const wagon_t *id, const attr_set_t *attrs)
+{
+    const char *vars[] = {
+        "", id->fullname,
+        NULL, NULL
+    };
+    int rc;
+    char **cmd;
+
+    rc = subst_shell_params(prog_options.exec_cmd, "exec option",
+                            &id->id, attrs, NULL, vars, NULL, true,
+                            &cmd);
+    if (!rc)
+    {
+        /* command output must come after previous entries */
+        find_out_flush();
+        /* display both stdout and stderr */
+        execute_shell_command(cmd, cb_redirect_all, NULL);
+        fflush(stdout);
+        g_strfreev(cmd);
+    }
+}
+
+/** format an entry to the given output buffer */
+static void format_entry(GString *out, const wagon_t *id,
+                         const attr_set_t *attrs)
 {
     char classbuf[1024] = "";
     char statusbuf[1024] = "";
@@ -799,6 +1014,17 @@ static void print_entry(const wagon_t *id, const attr_set_t * attrs)
 
     /* HERE: post-filter attributes that are not part of the DB request */
 
+    if (machine_output())
+    {
+        /* no human-friendly conversion */
+        if (prog_options.print || prog_options.ls || prog_options.lsost
+            || prog_options.lsclass || prog_options.lsstatus)
+            mach_format_entry(out, id, attrs);
+        if (prog_options.exec)
+            exec_entry(id, attrs);
+        return;
+    }
+
 #ifdef _LUSTRE
     /* prepare OST display buffer */
     if (prog_options.lsost && ATTR_MASK_TEST(attrs, stripe_items)
@@ -874,8 +1100,8 @@ static void print_entry(const wagon_t *id, const attr_set_t * attrs)
         const char * type;
         char date_str[128];
         char mode_str[128];
-        char uid_str[20];
-        char gid_str[20];
+        char uid_str[RBH_LOGIN_MAX];
+        char gid_str[RBH_LOGIN_MAX];
         const char *uid;
         const char *gid;
 
@@ -890,10 +1116,9 @@ static void print_entry(const wagon_t *id, const attr_set_t * attrs)
 
         if (global_config.uid_gid_as_numbers)
         {
-            sprintf(uid_str, "%d", ATTR(attrs, uid).num);
-            uid = uid_str;
-            sprintf(gid_str, "%d", ATTR(attrs, gid).num);
-            gid = gid_str;
+            /* display names like ls, or numbers if they are unknown */
+            uid = uid2str(ATTR(attrs, uid).num, uid_str);
+            gid = gid2str(ATTR(attrs, gid).num, gid_str);
         }
         else
         {
@@ -915,13 +1140,13 @@ static void print_entry(const wagon_t *id, const attr_set_t * attrs)
             && !strcmp(ATTR(attrs, type), STR_TYPE_LINK)
             && ATTR_MASK_TEST(attrs, link))
             /* display: id, type, mode, nlink, (status,) owner, group, size, mtime, path -> link */
-            printf(DFID" %-4s %s %3u  %-10s %-10s %15"PRIu64" %20s %s%s%s -> %s\n",
+            g_string_append_printf(out, DFID" %-4s %s %3u  %-10s %-10s %15"PRIu64" %20s %s%s%s -> %s\n",
                    PFID(&id->id), type, mode_str, ATTR(attrs, nlink),
                    uid, gid,
                    ATTR(attrs, size), date_str, statusbuf, classbuf, id->fullname, ATTR(attrs,link));
         else
             /* display all: id, type, mode, nlink, (status,) owner, group, size, mtime, path */
-            printf(DFID" %-4s %s %3u  %-10s %-10s %15"PRIu64" %20s %s%s%s%s\n",
+            g_string_append_printf(out, DFID" %-4s %s %3u  %-10s %-10s %15"PRIu64" %20s %s%s%s%s\n",
                    PFID(&id->id), type, mode_str, ATTR(attrs, nlink),
                    uid, gid,
                    ATTR(attrs, size), date_str, statusbuf,
@@ -938,7 +1163,7 @@ static void print_entry(const wagon_t *id, const attr_set_t * attrs)
             type = type2char(ATTR(attrs, type));
 
         /* display: id, type, size, path */
-        printf(DFID" %-4s %15"PRIu64" %s%s%s%s\n",
+        g_string_append_printf(out, DFID" %-4s %15"PRIu64" %s%s%s%s\n",
                PFID(&id->id), type, ATTR(attrs, size), statusbuf, classbuf,
                     id->fullname, osts ? osts->str : "");
 
@@ -947,38 +1172,66 @@ static void print_entry(const wagon_t *id, const attr_set_t * attrs)
     {
         /* just display name */
         if (id->fullname)
-            printf("%s\n", id->fullname);
+        {
+            g_string_append(out, id->fullname);
+            g_string_append_c(out, '\n');
+        }
         else
-            printf(DFID"\n", PFID(&id->id));
+            g_string_append_printf(out, DFID"\n", PFID(&id->id));
     }
     else if (prog_options.printf)
     {
-        printf_entry(printf_chunks, id, attrs);
+        printf_entry(out, printf_chunks, id, attrs);
     }
 
     if (prog_options.exec)
-    {
-        const char *vars[] = {
-            "", id->fullname,
-            NULL, NULL
-        };
-        int rc;
-        char **cmd;
-
-        rc = subst_shell_params(prog_options.exec_cmd, "exec option",
-                                &id->id, attrs, NULL, vars, NULL, true,
-                                &cmd);
-        if (!rc)
-        {
-            /* display both stdout and stderr */
-            execute_shell_command(cmd, cb_redirect_all, NULL);
-            g_strfreev(cmd);
-        }
-    }
+        exec_entry(id, attrs);
     if (osts)
         g_string_free(osts, TRUE);
 }
 
+/** display an entry (from the main thread) */
+static void print_entry(const wagon_t *id, const attr_set_t *attrs)
+{
+    format_entry(find_out(), id, attrs);
+    find_out_commit();
+}
+
+/**
+ * Resolve owner and group names of a set of entries before displaying them
+ * (only needed for -ls output when uids/gids are stored as numbers).
+ */
+static void prefetch_owners(const attr_set_t *attrs, unsigned int count)
+{
+    uid_t *uids;
+    gid_t *gids;
+    unsigned int i, n = 0;
+
+    if (!prog_options.ls || !global_config.uid_gid_as_numbers || count == 0)
+        return;
+
+    uids = MemAlloc(count * sizeof(uid_t));
+    gids = MemAlloc(count * sizeof(gid_t));
+    if (uids == NULL || gids == NULL)
+        goto out;
+
+    for (i = 0; i < count; i++)
+    {
+        if (!ATTR_MASK_TEST(&attrs[i], uid) || !ATTR_MASK_TEST(&attrs[i], gid))
+            continue;
+        uids[n] = ATTR(&attrs[i], uid).num;
+        gids[n] = ATTR(&attrs[i], gid).num;
+        n++;
+    }
+    UidGidCache_Prefetch(uids, n, gids, n);
+
+out:
+    if (uids != NULL)
+        MemFree(uids);
+    if (gids != NULL)
+        MemFree(gids);
+}
+
 /* directory callback */
 static int dircb(wagon_t * id_list, attr_set_t * attr_list,
                  unsigned int entry_count, void * dummy)
@@ -986,6 +1239,8 @@ static int dircb(wagon_t * id_list, attr_set_t * attr_list,
     /* retrieve child entries for all directories */
     int i, rc;
 
+    prefetch_owners(attr_list, entry_count);
+
     for (i = 0; i < entry_count; i++)
     {
         wagon_t * chids = NULL;
@@ -1015,11 +1270,16 @@ static int dircb(wagon_t * id_list, attr_set_t * attr_list,
                 return rc;
             }
 
+            prefetch_owners(chattrs, chcount);
+
             for (j = 0; j < chcount; j++)
             {
-                if (!is_expr || (entry_matches(&chids[j].id, &chattrs[j],
-                                 &match_expr, NULL, prog_options.filter_smi)
-                                 == POLICY_MATCH))
+                /* only check what the DB request didn't */
+                if (!pushdown.residual
+                    || (entry_matches(&chids[j].id, &chattrs[j],
+                                      pushdown.residual, NULL,
+                                      prog_options.filter_smi)
+                        == POLICY_MATCH))
                     print_entry(&chids[j], &chattrs[j]);
 
                 ListMgr_FreeAttrs(&chattrs[j]);
@@ -1046,6 +1306,35 @@ static int retrieve_root_id(entry_id_t *root_id)
     return rc;
 }
 
+/** format an entry returned by the bulk DB request */
+static void bulk_format_entry(GString *out, const entry_id_t *id,
+                              const attr_set_t *attrs)
+{
+    wagon_t w;
+
+    /* only check what the DB request didn't */
+    if (pushdown.residual && (entry_matches(id, attrs, pushdown.residual, NULL,
+                                            prog_options.filter_smi)
+                              != POLICY_MATCH))
+        return;
+
+    w.id = *id;
+    w.fullname = (char *)ATTR(attrs, fullpath);
+
+    /* don't display dirs if no_dir is specified */
+    if (! (prog_options.no_dir && ATTR_MASK_TEST(attrs, type)
+           && !strcasecmp(ATTR(attrs, type), STR_TYPE_DIR)))
+        format_entry(out, &w, attrs);
+    /* don't display non dirs is dir_only is specified */
+    else if (! (prog_options.dir_only && ATTR_MASK_TEST(attrs, type)
+                && strcasecmp(ATTR(attrs, type), STR_TYPE_DIR)))
+        format_entry(out, &w, attrs);
+    else
+        /* return entry don't match? */
+        DisplayLog(LVL_DEBUG, FIND_TAG, "Warning: returned DB entry doesn't match filter: %s",
+                   ATTR(attrs, fullpath));
+}
+
 /**
  * Bulk filtering in the DB.
  */
@@ -1056,6 +1345,10 @@ static int list_bulk(void)
     int rc;
     struct stat st;
     struct lmgr_iterator_t *it;
+    bool threaded = false;
+
+    if (prog_options.explain)
+        explain_query(true);
 
     /* no transversal => no wagon
      * so we need the path from the DB.
@@ -1103,38 +1396,45 @@ static int list_bulk(void)
         return -1;
     }
 
-    attrs.attr_mask = attr_mask_or(&disp_mask, &query_mask);
-    while ((rc = ListMgr_GetNext(it, &id, &attrs)) == DB_SUCCESS)
+    if (prog_options.fmt_threads > 0 && !prog_options.exec)
     {
-        if (!is_expr || (entry_matches(&id, &attrs, &match_expr, NULL,
-                                       prog_options.filter_smi) == POLICY_MATCH))
+        rc = find_fmt_start(prog_options.fmt_threads, bulk_format_entry);
+        if (rc)
         {
-            /* don't display dirs if no_dir is specified */
-            if (! (prog_options.no_dir && ATTR_MASK_TEST(&attrs, type)
-                   && !strcasecmp(ATTR(&attrs, type), STR_TYPE_DIR))) {
-                wagon_t w;
-                w.id = id;
-                w.fullname = ATTR(&attrs, fullpath);
-                print_entry(&w, &attrs);
-            }
-            /* don't display non dirs is dir_only is specified */
-            else if (! (prog_options.dir_only && ATTR_MASK_TEST(&attrs, type)
-                        && strcasecmp(ATTR(&attrs, type), STR_TYPE_DIR))) {
-                wagon_t w;
-                w.id = id;
-                w.fullname = ATTR(&attrs, fullpath);
-                print_entry(&w, &attrs);
-            }
-            else
-                /* return entry don't match? */
-                DisplayLog(LVL_DEBUG, FIND_TAG, "Warning: returned DB entry doesn't match filter: %s",
-                           ATTR(&attrs, fullpath));
+            DisplayLog(LVL_MAJOR, FIND_TAG, "Error %d starting formatting "
+                       "threads: formatting entries in the main thread", rc);
         }
-        ListMgr_FreeAttrs(&attrs);
+        else
+            threaded = true;
+    }
 
-        /* prepare next call */
-        attrs.attr_mask = attr_mask_or(&disp_mask, &query_mask);
+    while (1)
+    {
+        entry_id_t *p_id = &id;
+        attr_set_t *p_attrs = &attrs;
+
+        /* in threaded mode, entries are directly fetched in batches */
+        if (threaded)
+            p_attrs = find_fmt_next(&p_id);
+
+        p_attrs->attr_mask = attr_mask_or(&disp_mask, &query_mask);
+        rc = ListMgr_GetNext(it, p_id, p_attrs);
+        if (rc != DB_SUCCESS)
+            break;
+
+        if (threaded)
+            find_fmt_push();
+        else
+        {
+            bulk_format_entry(find_out(), p_id, p_attrs);
+            find_out_commit();
+            ListMgr_FreeAttrs(p_attrs);
+        }
     }
+
+    if (threaded)
+        find_fmt_stop();
+
     ListMgr_CloseIterator(it);
 
     return 0;
@@ -1199,6 +1499,9 @@ static int list_contents(char ** id_list, int id_count)
             return list_bulk();
         }
 
+        if (prog_options.explain)
+            explain_query(false);
+
         /* get root attrs to print it (if it matches program options) */
         root_attrs.attr_mask = attr_mask_or(&disp_mask, &query_mask);
         rc = ListMgr_Get(&lmgr, &ids[i].id, &root_attrs);
@@ -1525,6 +1828,23 @@ int main(int argc, char **argv)
             }
             break;
 
+        case PRINT0_OPT:
+            prog_options.print = 1;
+            set_output_format(OUT_NUL);
+            if (neg) {
+                fprintf(stderr, "! (-not) unexpected before -print0 option\n");
+                exit(1);
+            }
+            break;
+
+        case BINARY_OPT:
+            set_output_format(OUT_BINARY);
+            if (neg) {
+                fprintf(stderr, "! (-not) unexpected before -binary option\n");
+                exit(1);
+            }
+            break;
+
         case PRINTF_OPT:
             prog_options.print = 0;
             prog_options.printf = 1;
@@ -1539,6 +1859,21 @@ int main(int argc, char **argv)
             prog_options.escaped = 1;
             break;
 
+        case THREADS_OPT:
+            rc = str2int(optarg);
+            if (rc < 0)
+            {
+                fprintf(stderr, "invalid value '%s' for -threads: positive integer expected\n",
+                        optarg);
+                exit(1);
+            }
+            prog_options.fmt_threads = rc;
+            break;
+
+        case EXPLAIN_OPT:
+            prog_options.explain = 1;
+            break;
+
         case 'E':
             toggle_option(exec, "exec");
             if (!g_shell_parse_argv(optarg, NULL, &prog_options.exec_cmd,
@@ -1703,11 +2038,19 @@ int main(int argc, char **argv)
 
     if (prog_options.printf)
     {
+        if (machine_output())
+        {
+            fprintf(stderr, "-printf can't be used with -print0 or -binary\n");
+            exit(EINVAL);
+        }
         printf_chunks = prepare_printf_format(printf_str);
         if (printf_chunks == NULL)
             exit(EINVAL);
     }
 
+    if (machine_output())
+        build_mach_fields();
+
     if (argc == optind)
     {
         /* no argument: default is root
@@ -1717,7 +2060,7 @@ int main(int argc, char **argv)
         {
             DisplayLog(LVL_DEBUG, FIND_TAG, "Optimization: switching to bulk DB request mode");
             mkfilters(false); /* keep dirs */
-            return list_bulk();
+            rc = list_bulk();
         }
         else
         {
@@ -1733,6 +2076,7 @@ int main(int argc, char **argv)
         rc = list_contents(argv+optind, argc-optind);
     }
 
+    find_out_flush();
     ListMgr_CloseAccess(&lmgr);
 
     return rc;
@@ -102,10 +102,14 @@ struct find_opt
     /* behavior flags */
     unsigned int no_dir:1; /* if -t != dir => no dir to be displayed */
     unsigned int dir_only:1; /* if -t dir => only display dir */
+    unsigned int explain:1; /* display how entries are filtered */
 
     /* actions */
     unsigned int exec:1;
 
+    /* number of threads formatting the output in bulk mode (0: none) */
+    unsigned int fmt_threads;
+
 };
 extern struct find_opt prog_options;
 
@@ -113,7 +117,33 @@ const char *type2char(const char *type);
 const char type2onechar(const char *type);
 
 GArray *prepare_printf_format(const char *format);
-void printf_entry(GArray *chunks, const wagon_t *id, const attr_set_t *attrs);
+void printf_entry(GString *out, GArray *chunks, const wagon_t *id,
+                  const attr_set_t *attrs);
 void free_printf_formats(GArray *chunks);
 
+/* output buffering (rbh_find_output.c) */
+
+/** size of output buffers */
+#define FIND_OUT_BUF_SIZE   (256 * 1024)
+
+/** Get the output buffer of the main thread to append entries to it. */
+GString *find_out(void);
+/** Write output buffers once enough of them are filled. */
+void find_out_commit(void);
+/** Write all buffered output. */
+void find_out_flush(void);
+
+/** Format an entry into an output buffer. */
+typedef void (*find_fmt_cb_t)(GString *out, const entry_id_t *id,
+                              const attr_set_t *attrs);
+
+/** Start threads formatting entries with the given callback. */
+int find_fmt_start(unsigned int nb_threads, find_fmt_cb_t cb);
+/** Get the location where the next entry to be formatted must be fetched. */
+attr_set_t *find_fmt_next(entry_id_t **p_id);
+/** Submit the entry fetched by the last find_fmt_next() call. */
+void find_fmt_push(void);
+/** Format all pushed entries, then stop formatting threads. */
+void find_fmt_stop(void);
+
 #endif
@@ -0,0 +1,332 @@
+/* -*- mode: c; c-basic-offset: 4; indent-tabs-mode: nil; -*-
+ * vim:expandtab:shiftwidth=4:tabstop=4:
+ */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the CeCILL License.
+ *
+ * The fact that you are presently reading this means that you have had
+ * knowledge of the CeCILL license (http://www.cecill.info) and that you
+ * accept its terms.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include "list_mgr.h"
+#include "rbh_logs.h"
+#include "rbh_misc.h"
+#include "Memory.h"
+#include "queue.h"
+#include "status_manager.h"
+
+#include <errno.h>
+#include <pthread.h>
+#include <string.h>
+#include <sys/uio.h>
+#include <unistd.h>
+
+#include "rbh_find.h"
+
+/**
+ * Output of rbh-find.
+ *
+ * Entries are formatted into large memory buffers instead of stdio.
+ * Filled buffers are written together with a single writev().
+ *
+ * When listing entries in bulk mode, formatting can also be done by
+ * a pool of threads, while the main thread fetches entries from the DB.
+ * Entries are handed over to the formatting threads by batches.
+ * Each batch is formatted into its own buffer, and batches are written
+ * in the order they were fetched.
+ */
+
+/** number of output buffers of the main thread */
+#define FIND_OUT_IOV    8
+
+static GString *out_bufs[FIND_OUT_IOV];
+static unsigned int out_filled = 0; /* number of filled buffers */
+static bool out_error = false;
+
+/** Write a set of buffers, handling partial writes. */
+static int write_iov(struct iovec *iov, int cnt)
+{
+    ssize_t sz;
+
+    while (cnt > 0)
+    {
+        sz = writev(STDOUT_FILENO, iov, cnt);
+        if (sz < 0)
+        {
+            if (errno == EINTR)
+                continue;
+            return -errno;
+        }
+
+        /* skip written buffers */
+        while (cnt > 0 && sz >= iov->iov_len)
+        {
+            sz -= iov->iov_len;
+            iov++;
+            cnt--;
+        }
+        if (cnt > 0)
+        {
+            iov->iov_base = (char *)iov->iov_base + sz;
+            iov->iov_len -= sz;
+        }
+    }
+    return 0;
+}
+
+/** Write a set of buffers and empty them. */
+static void write_bufs(GString **bufs, int cnt)
+{
+    struct iovec iov[FIND_OUT_IOV];
+    int i, n = 0, rc;
+
+    for (i = 0; i < cnt; i++)
+    {
+        if (bufs[i]->len == 0)
+            continue;
+        iov[n].iov_base = bufs[i]->str;
+        iov[n].iov_len = bufs[i]->len;
+        n++;
+    }
+
+    if (n > 0 && !out_error)
+    {
+        rc = write_iov(iov, n);
+        if (rc)
+        {
+            /* don't report it for each buffer */
+            DisplayLog(LVL_CRIT, FIND_TAG, "Error writing output: %s",
+                       strerror(-rc));
+            out_error = true;
+        }
+    }
+
+    for (i = 0; i < cnt; i++)
+        g_string_truncate(bufs[i], 0);
+}
+
+GString *find_out(void)
+{
+    if (out_bufs[out_filled] == NULL)
+        out_bufs[out_filled] = g_string_sized_new(FIND_OUT_BUF_SIZE);
+
+    return out_bufs[out_filled];
+}
+
+void find_out_commit(void)
+{
+    if (out_bufs[out_filled] == NULL
+        || out_bufs[out_filled]->len < FIND_OUT_BUF_SIZE)
+        return;
+
+    out_filled++;
+    if (out_filled == FIND_OUT_IOV)
+    {
+        write_bufs(out_bufs, FIND_OUT_IOV);
+        out_filled = 0;
+    }
+}
+
+void find_out_flush(void)
+{
+    /* the current buffer may not be allocated */
+    write_bufs(out_bufs, out_bufs[out_filled] ? out_filled + 1 : out_filled);
+    out_filled = 0;
+}
+
+/* ------------- formatting threads --------------- */
+
+/** max number of entries in a batch */
+#define FIND_BATCH_SIZE     128
+
+struct find_batch {
+    unsigned long seq;
+    unsigned int  count;
+    entry_id_t    ids[FIND_BATCH_SIZE];
+    attr_set_t    attrs[FIND_BATCH_SIZE];
+    GString      *out;
+};
+
+static find_fmt_cb_t fmt_cb;
+static unsigned int fmt_thread_count;
+static pthread_t *fmt_threads;
+
+/* batches to be filled / to be formatted */
+static entry_queue_t free_batches;
+static entry_queue_t full_batches;
+
+/* all allocated batches */
+static struct find_batch *batches;
+static unsigned int batch_count;
+
+static struct find_batch *curr_batch;
+static unsigned long submit_seq = 0;
+
+/* next batch to be written */
+static unsigned long write_seq = 0;
+static pthread_mutex_t write_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t write_cond = PTHREAD_COND_INITIALIZER;
+
+static void *fmt_thr(void *arg)
+{
+    struct find_batch *b;
+    struct iovec iov;
+    unsigned int i;
+    int rc;
+
+    while (Queue_Get(&full_batches, (void **)&b) == 0)
+    {
+        /* end of listing */
+        if (b == NULL)
+            break;
+
+        for (i = 0; i < b->count; i++)
+        {
+            fmt_cb(b->out, &b->ids[i], &b->attrs[i]);
+            ListMgr_FreeAttrs(&b->attrs[i]);
+        }
+
+        /* wait for our turn to keep output order */
+        pthread_mutex_lock(&write_lock);
+        while (write_seq != b->seq)
+            pthread_cond_wait(&write_cond, &write_lock);
+
+        if (b->out->len > 0 && !out_error)
+        {
+            iov.iov_base = b->out->str;
+            iov.iov_len = b->out->len;
+            rc = write_iov(&iov, 1);
+            if (rc)
+            {
+                DisplayLog(LVL_CRIT, FIND_TAG, "Error writing output: %s",
+                           strerror(-rc));
+                out_error = true;
+            }
+        }
+        write_seq++;
+        pthread_cond_broadcast(&write_cond);
+        pthread_mutex_unlock(&write_lock);
+
+        g_string_truncate(b->out, 0);
+        b->count = 0;
+        Queue_Insert(&free_batches, b);
+    }
+    return NULL;
+}
+
+int find_fmt_start(unsigned int nb_threads, find_fmt_cb_t cb)
+{
+    unsigned int i;
+    int rc;
+
+    fmt_cb = cb;
+
+    /* let each thread fill a batch while one is being fetched */
+    batch_count = 2 * nb_threads + 1;
+
+    rc = CreateQueue(&free_batches, batch_count, 0, 0);
+    if (rc)
+        return rc;
+    rc = CreateQueue(&full_batches, batch_count + nb_threads, 0, 0);
+    if (rc)
+        return rc;
+
+    batches = MemCalloc(batch_count, sizeof(*batches));
+    fmt_threads = MemCalloc(nb_threads, sizeof(*fmt_threads));
+    if (batches == NULL || fmt_threads == NULL)
+    {
+        if (batches != NULL)
+            MemFree(batches);
+        if (fmt_threads != NULL)
+            MemFree(fmt_threads);
+        batches = NULL;
+        fmt_threads = NULL;
+        return -ENOMEM;
+    }
+
+    for (i = 0; i < batch_count; i++)
+    {
+        batches[i].out = g_string_sized_new(FIND_OUT_BUF_SIZE);
+        Queue_Insert(&free_batches, &batches[i]);
+    }
+
+    /* previous output must be written first */
+    find_out_flush();
+
+    for (fmt_thread_count = 0; fmt_thread_count < nb_threads;
+         fmt_thread_count++)
+    {
+        rc = pthread_create(&fmt_threads[fmt_thread_count], NULL, fmt_thr,
+                            NULL);
+        if (rc)
+        {
+            DisplayLog(LVL_CRIT, FIND_TAG, "Error creating formatting "
+                       "thread: %s", strerror(rc));
+            break;
+        }
+    }
+    /* at least one thread is needed */
+    if (fmt_thread_count == 0)
+    {
+        for (i = 0; i < batch_count; i++)
+            g_string_free(batches[i].out, TRUE);
+        MemFree(batches);
+        MemFree(fmt_threads);
+        batches = NULL;
+        fmt_threads = NULL;
+        return -rc;
+    }
+
+    return 0;
+}
+
+attr_set_t *find_fmt_next(entry_id_t **p_id)
+{
+    if (curr_batch == NULL)
+        Queue_Get(&free_batches, (void **)&curr_batch);
+
+    *p_id = &curr_batch->ids[curr_batch->count];
+    return &curr_batch->attrs[curr_batch->count];
+}
+
+/** submit the current batch for formatting */
+static void submit_batch(void)
+{
+    curr_batch->seq = submit_seq++;
+    Queue_Insert(&full_batches, curr_batch);
+    curr_batch = NULL;
+}
+
+void find_fmt_push(void)
+{
+    curr_batch->count++;
+    if (curr_batch->count >= FIND_BATCH_SIZE)
+        submit_batch();
+}
+
+void find_fmt_stop(void)
+{
+    unsigned int i;
+
+    if (curr_batch != NULL && curr_batch->count > 0)
+        submit_batch();
+
+    for (i = 0; i < fmt_thread_count; i++)
+        Queue_Insert(&full_batches, NULL);
+    for (i = 0; i < fmt_thread_count; i++)
+        pthread_join(fmt_threads[i], NULL);
+
+    for (i = 0; i < batch_count; i++)
+        g_string_free(batches[i].out, TRUE);
+    MemFree(batches);
+    MemFree(fmt_threads);
+    batches = NULL;
+    fmt_threads = NULL;
+    curr_batch = NULL;
+}
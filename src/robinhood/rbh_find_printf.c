@@ -42,6 +42,11 @@
  *   "file is %s and its archive is "
  *   "%u (neat!)"
  * Their type of argument is stored in one fchunk each.
+ *
+ * The chunks are then compiled (see compile_chunk()) into a literal
+ * prefix, a conversion with its field width, and a literal suffix, so
+ * that entries are formatted directly into the output buffer without
+ * parsing the format again for each entry.
  */
 
 struct fchunk {
@@ -62,6 +67,14 @@ struct fchunk {
     unsigned int attr_index; /**< absolute attr index */
     unsigned int rel_sm_info_index; /**< relative index of sm_info attr */
     const sm_info_def_t *def;
+
+    /* Compiled form of 'format' */
+    GString *prefix;    /**< literal text before the conversion */
+    GString *suffix;    /**< literal text after the conversion */
+    char conv;          /**< printf conversion ('s', 'u', 'o'...), or 0 */
+    bool left;          /**< left-justified field ('-' flag) */
+    bool zero;          /**< pad numbers with zeros ('0' flag) */
+    unsigned int width; /**< minimum field width */
 };
 
 /* The SM status cannot be retrieved or read like the other SM
@@ -70,17 +83,12 @@ struct fchunk {
 
 /* Escape a file name to create a valid string. Valid filenames
  * characters are all except NULL and /. But not everything else is
- * printable. This function returns a statically allocated string
- * which will be overwritten by subsequent calls. */
-static const char *escape_name(const char *fullname)
+ * printable. The escaped name is written to dest. */
+static const char *escape_name(const char *fullname, GString *dest)
 {
     const unsigned char *src = (const unsigned char *)fullname;
-    static GString *dest;
 
-    if (dest == NULL)
-        dest = g_string_sized_new(100);
-    else
-        g_string_truncate(dest, 0);
+    g_string_truncate(dest, 0);
 
     while (*src)
     {
@@ -502,28 +510,170 @@ static const char *extract_chunk(const char *str, struct fchunk *chunk)
     return str;
 }
 
-static void printf_date(const struct fchunk *chunk, time_t date)
+/* Append a value to the output, padded to the chunk field width. */
+static void append_field(GString *out, const struct fchunk *chunk,
+                         const char *val, size_t len, bool numeric)
+{
+    size_t pad = chunk->width > len ? chunk->width - len : 0;
+
+    if (pad > 0 && !chunk->left)
+    {
+        if (numeric && chunk->zero)
+        {
+            /* zeros go after the sign */
+            if (*val == '-')
+            {
+                g_string_append_c(out, '-');
+                val++;
+                len--;
+            }
+            while (pad-- > 0)
+                g_string_append_c(out, '0');
+        }
+        else
+        {
+            while (pad-- > 0)
+                g_string_append_c(out, ' ');
+        }
+        pad = 0;
+    }
+
+    g_string_append_len(out, val, len);
+
+    while (pad-- > 0)
+        g_string_append_c(out, ' ');
+}
+
+static inline void append_prefix(GString *out, const struct fchunk *chunk)
+{
+    g_string_append_len(out, chunk->prefix->str, chunk->prefix->len);
+}
+
+static inline void append_suffix(GString *out, const struct fchunk *chunk)
+{
+    g_string_append_len(out, chunk->suffix->str, chunk->suffix->len);
+}
+
+static void emit_str(GString *out, const struct fchunk *chunk, const char *val)
+{
+    append_prefix(out, chunk);
+    append_field(out, chunk, val, strlen(val), false);
+    append_suffix(out, chunk);
+}
+
+static void emit_char(GString *out, const struct fchunk *chunk, char val)
+{
+    append_prefix(out, chunk);
+    append_field(out, chunk, &val, 1, false);
+    append_suffix(out, chunk);
+}
+
+static void emit_uint(GString *out, const struct fchunk *chunk, uint64_t val)
+{
+    char buff[24];
+    char *curr = buff + sizeof(buff);
+    unsigned int base = (chunk->conv == 'o') ? 8 : 10;
+
+    do {
+        *(--curr) = '0' + (val % base);
+        val /= base;
+    } while (val != 0);
+
+    append_prefix(out, chunk);
+    append_field(out, chunk, curr, buff + sizeof(buff) - curr, true);
+    append_suffix(out, chunk);
+}
+
+static void emit_int(GString *out, const struct fchunk *chunk, int64_t val)
+{
+    char buff[24];
+    char *curr = buff + sizeof(buff);
+    uint64_t abs_val = val < 0 ? -(uint64_t)val : (uint64_t)val;
+
+    do {
+        *(--curr) = '0' + (abs_val % 10);
+        abs_val /= 10;
+    } while (abs_val != 0);
+    if (val < 0)
+        *(--curr) = '-';
+
+    append_prefix(out, chunk);
+    append_field(out, chunk, curr, buff + sizeof(buff) - curr, true);
+    append_suffix(out, chunk);
+}
+
+/* Split the printf format of a chunk into its prefix, conversion
+ * and suffix. */
+static void compile_chunk(struct fchunk *chunk)
+{
+    const char *str = chunk->format->str;
+    GString *lit;
+
+    chunk->prefix = g_string_sized_new(16);
+    chunk->suffix = g_string_sized_new(16);
+    lit = chunk->prefix;
+
+    while (*str)
+    {
+        if (*str != '%')
+        {
+            g_string_append_c(lit, *str);
+            str++;
+            continue;
+        }
+
+        if (str[1] == '%')
+        {
+            g_string_append_c(lit, '%');
+            str += 2;
+            continue;
+        }
+
+        /* the directive of the chunk: [-][0][width][z]conv */
+        str++;
+        if (*str == '-')
+        {
+            chunk->left = true;
+            str++;
+        }
+        if (*str == '0')
+            chunk->zero = true;
+        while (*str >= '0' && *str <= '9')
+        {
+            chunk->width = chunk->width * 10 + (*str - '0');
+            str++;
+        }
+        if (*str == 'z')
+            str++;
+        chunk->conv = *str;
+        if (*str)
+            str++;
+
+        lit = chunk->suffix;
+    }
+}
+
+static void printf_date(GString *out, const struct fchunk *chunk, time_t date)
 {
     char str[1000];
-    struct tm *tmp;
+    struct tm tmp;
     size_t sret;
 
-    tmp = localtime(&date);
-    if (tmp == NULL) {
-        printf("(none)");
+    if (localtime_r(&date, &tmp) == NULL) {
+        g_string_append(out, "(none)");
         return;
     }
 
     if (chunk->time_format)
-        sret = strftime(str, sizeof(str), chunk->time_format->str, tmp);
+        sret = strftime(str, sizeof(str), chunk->time_format->str, &tmp);
     else
-        sret = strftime(str, sizeof(str), chunk->format->str, tmp);
+        sret = strftime(str, sizeof(str), chunk->format->str, &tmp);
 
     if (sret >= sizeof(str)-1)
     {
         /* Overflow. 1000 bytes should be big enough for that to never
          * happen in any locale. */
-        printf("(date output truncated)");
+        g_string_append(out, "(date output truncated)");
     }
     else if (sret == 0)
     {
@@ -533,59 +683,59 @@ static void printf_date(const struct fchunk *chunk, time_t date)
     else
     {
         if (chunk->time_format)
-            printf(chunk->format->str, str);
+            emit_str(out, chunk, str);
         else
-            printf("%s", str);
+            g_string_append_len(out, str, sret);
     }
 }
 
 /**
  * Output the desired information for one file.
  */
-void printf_entry(GArray *chunks, const wagon_t *id, const attr_set_t *attrs)
+void printf_entry(GString *out, GArray *chunks, const wagon_t *id,
+                  const attr_set_t *attrs)
 {
     int i;
 
     for (i = 0; i < chunks->len; i++)
     {
         struct fchunk *chunk = &g_array_index(chunks, struct fchunk, i);
-        const char *format = chunk->format->str;
 
         switch (chunk->directive)
         {
         case 0:
-            printf(format);
+            append_prefix(out, chunk);
             break;
 
         case 'A':
-            printf_date(chunk, ATTR(attrs, last_access));
+            printf_date(out, chunk, ATTR(attrs, last_access));
             break;
 
         case 'b':
-            printf(format, ATTR(attrs, blocks));
+            emit_uint(out, chunk, ATTR(attrs, blocks));
             break;
 
         case 'C':
-            printf_date(chunk, ATTR(attrs, last_mdchange));
+            printf_date(out, chunk, ATTR(attrs, last_mdchange));
             break;
 
         case 'd':
-            printf(format, ATTR(attrs, depth));
+            emit_uint(out, chunk, ATTR(attrs, depth));
             break;
 
         case 'f':
-            printf(format, ATTR(attrs, name));
+            emit_str(out, chunk, ATTR(attrs, name));
             break;
 
         case 'g':
             if (global_config.uid_gid_as_numbers)
-                printf(format, ATTR(attrs, gid).num);
+                emit_int(out, chunk, ATTR(attrs, gid).num);
             else
-                printf(format, ATTR(attrs, gid).txt);
+                emit_str(out, chunk, ATTR(attrs, gid).txt);
             break;
 
         case 'm':
-            printf(format, ATTR(attrs, mode));
+            emit_uint(out, chunk, ATTR(attrs, mode));
             break;
 
         case 'M':
@@ -595,34 +745,39 @@ void printf_entry(GArray *chunks, const wagon_t *id, const attr_set_t *attrs)
             mode_str[9] = 0;
             mode_string(ATTR(attrs, mode), mode_str);
 
-            printf(format, mode_str);
+            emit_str(out, chunk, mode_str);
         }
             break;
 
         case 'n':
-            printf(format, ATTR(attrs, nlink));
+            emit_uint(out, chunk, ATTR(attrs, nlink));
             break;
 
         case 'p':
             if (prog_options.escaped)
-                printf(format, escape_name(id->fullname));
+            {
+                GString *escaped = g_string_sized_new(100);
+
+                emit_str(out, chunk, escape_name(id->fullname, escaped));
+                g_string_free(escaped, TRUE);
+            }
             else
-                printf(format, id->fullname);
+                emit_str(out, chunk, id->fullname);
             break;
 
         case 's':
-            printf(format, ATTR(attrs, size));
+            emit_uint(out, chunk, ATTR(attrs, size));
             break;
 
         case 'T':
-            printf_date(chunk, ATTR(attrs, last_mod));
+            printf_date(out, chunk, ATTR(attrs, last_mod));
             break;
 
         case 'u':
             if (global_config.uid_gid_as_numbers)
-                printf(format, ATTR(attrs, uid).num);
+                emit_int(out, chunk, ATTR(attrs, uid).num);
             else
-                printf(format, ATTR(attrs, uid).txt);
+                emit_str(out, chunk, ATTR(attrs, uid).txt);
             break;
 
         case 'Y':
@@ -634,7 +789,7 @@ void printf_entry(GArray *chunks, const wagon_t *id, const attr_set_t *attrs)
             else
                 type = type2char(ATTR(attrs, type));
 
-            printf(format, type);
+            emit_str(out, chunk, type);
         }
             break;
 
@@ -647,7 +802,7 @@ void printf_entry(GArray *chunks, const wagon_t *id, const attr_set_t *attrs)
             else
                 type = type2onechar(ATTR(attrs, type));
 
-            printf(format, type);
+            emit_char(out, chunk, type);
         }
             break;
 
@@ -656,13 +811,13 @@ void printf_entry(GArray *chunks, const wagon_t *id, const attr_set_t *attrs)
             switch (chunk->sub_directive)
             {
             case 'C':
-                printf_date(chunk, ATTR(attrs, creation_time));
+                printf_date(out, chunk, ATTR(attrs, creation_time));
                 break;
 
             case 'c':
-                printf(format,
-                       class_format(ATTR_MASK_TEST(attrs, fileclass)?
-                                    ATTR(attrs, fileclass) : NULL));
+                emit_str(out, chunk,
+                         class_format(ATTR_MASK_TEST(attrs, fileclass)?
+                                      ATTR(attrs, fileclass) : NULL));
                 break;
 
             case 'f':
@@ -670,7 +825,7 @@ void printf_entry(GArray *chunks, const wagon_t *id, const attr_set_t *attrs)
                     char fid_str[RBH_FID_LEN];
 
                     sprintf(fid_str, DFID_NOBRACE, PFID(&id->id));
-                    printf(format, fid_str);
+                    emit_str(out, chunk, fid_str);
                 }
                 break;
 
@@ -679,19 +834,19 @@ void printf_entry(GArray *chunks, const wagon_t *id, const attr_set_t *attrs)
                 {
                     switch (chunk->def->db_type) {
                     case DB_UINT:
-                        printf(format, *(unsigned int *)SMI_INFO(attrs, chunk->smi, chunk->rel_sm_info_index));
+                        emit_uint(out, chunk, *(unsigned int *)SMI_INFO(attrs, chunk->smi, chunk->rel_sm_info_index));
                         break;
 
                     case DB_INT:
-                        printf(format, *(int *)SMI_INFO(attrs, chunk->smi, chunk->rel_sm_info_index));
+                        emit_int(out, chunk, *(int *)SMI_INFO(attrs, chunk->smi, chunk->rel_sm_info_index));
                         break;
 
                     case DB_BOOL:
-                        printf(format, *(bool *)SMI_INFO(attrs, chunk->smi, chunk->rel_sm_info_index));
+                        emit_uint(out, chunk, *(bool *)SMI_INFO(attrs, chunk->smi, chunk->rel_sm_info_index));
                         break;
 
                     case DB_TEXT:
-                        printf(format, SMI_INFO(attrs, chunk->smi, chunk->rel_sm_info_index));
+                        emit_str(out, chunk, SMI_INFO(attrs, chunk->smi, chunk->rel_sm_info_index));
                         break;
 
                     default:
@@ -703,11 +858,11 @@ void printf_entry(GArray *chunks, const wagon_t *id, const attr_set_t *attrs)
                     switch (chunk->def->db_type) {
                     case DB_UINT:
                     case DB_INT:
-                        printf(format, 0);
+                        emit_uint(out, chunk, 0);
                         break;
 
                     case DB_TEXT:
-                        printf(format, "[n/a]");
+                        emit_str(out, chunk, "[n/a]");
                         break;
 
                     default:
@@ -724,7 +879,7 @@ void printf_entry(GArray *chunks, const wagon_t *id, const attr_set_t *attrs)
                     GString *osts = g_string_new("");
 
                     append_stripe_list(osts, &ATTR(attrs, stripe_items), true);
-                    printf(format, osts->str);
+                    emit_str(out, chunk, osts->str);
                     g_string_free(osts, TRUE);
                 }
                 break;
@@ -734,7 +889,7 @@ void printf_entry(GArray *chunks, const wagon_t *id, const attr_set_t *attrs)
                 char fid_str[RBH_FID_LEN];
 
                 sprintf(fid_str, DFID_NOBRACE, PFID(&ATTR(attrs, parent_id)));
-                printf(format, fid_str);
+                emit_str(out, chunk, fid_str);
 
                 break;
             }
@@ -745,9 +900,9 @@ void printf_entry(GArray *chunks, const wagon_t *id, const attr_set_t *attrs)
                 unsigned int smi_index = chunk->smi->smi_index;
 
                 if (ATTR_MASK_STATUS_TEST(attrs, smi_index))
-                    printf(format, STATUS_ATTR(attrs, smi_index));
+                    emit_str(out, chunk, STATUS_ATTR(attrs, smi_index));
                 else
-                    printf(format, "[n/a]");
+                    emit_str(out, chunk, "[n/a]");
 
                 break;
             }
@@ -772,6 +927,10 @@ void free_printf_formats(GArray *chunks)
         g_string_free(chunk->format, TRUE);
         if (chunk->time_format)
             g_string_free(chunk->time_format, TRUE);
+        if (chunk->prefix)
+            g_string_free(chunk->prefix, TRUE);
+        if (chunk->suffix)
+            g_string_free(chunk->suffix, TRUE);
     }
 
     g_array_unref(chunks);
@@ -793,9 +952,12 @@ GArray *prepare_printf_format(const char *format)
 
     while (*format)
     {
+        memset(&chunk, 0, sizeof(chunk));
         chunk.format = g_string_sized_new(50);
 
         format = extract_chunk(format, &chunk);
+        if (format != NULL)
+            compile_chunk(&chunk);
         g_array_append_val(chunks, chunk);
 
         if (format == NULL)
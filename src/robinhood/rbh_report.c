@@ -67,6 +67,8 @@
 #define OPT_SIZE_PROFILE  330
 #define OPT_BY_SZ_RATIO   331
 
+#define OPT_BINARY        340
+
 /* options flags */
 #define OPT_FLAG_CSV        0x0001
 #define OPT_FLAG_NOHEADER   0x0002
@@ -79,6 +81,7 @@
 #define OPT_FLAG_REVERSE        0x0100
 #define OPT_FLAG_SPROF          0x0200
 #define OPT_FLAG_BY_SZRATIO     0x0400
+#define OPT_FLAG_MACHINE        0x0800
 
 #define CSV(_x) !!((_x)&OPT_FLAG_CSV)
 #define NOHEADER(_x) !!((_x)&OPT_FLAG_NOHEADER)
@@ -90,6 +93,9 @@
 #define SORT_BY_SZRATIO(_x) !!((_x)&OPT_FLAG_BY_SZRATIO)
 #define REVERSE(_x) !!((_x)&OPT_FLAG_REVERSE)
 #define SPROF(_x) !!((_x)&OPT_FLAG_SPROF)
+#define MACHINE(_x) !!((_x)&OPT_FLAG_MACHINE)
+/* filter info and totals are only displayed for humans */
+#define SUMMARY(_x) (!NOHEADER(_x) && !MACHINE(_x))
 
 static profile_field_descr_t size_profile =
 {
@@ -173,6 +179,8 @@ static struct option option_tab[] = {
     /* output format option */
     {"csv", no_argument, NULL, 'c'},
     {"no-header", no_argument, NULL, 'q'},
+    {"null", no_argument, NULL, '0'},
+    {"binary", no_argument, NULL, OPT_BINARY},
 
     /* verbosity level */
     {"log-level", required_argument, NULL, 'l'},
@@ -186,7 +194,7 @@ static struct option option_tab[] = {
 
 };
 
-#define SHORT_OPT_STRING    "aiDe:u:g:d:s:p:rU:P:C:Rf:cql:hVFSo:O:"
+#define SHORT_OPT_STRING    "aiDe:u:g:d:s:p:rU:P:C:Rf:cq0l:hVFSo:O:"
 
 static const char *cmd_help = _B "Usage:" B_ " %s [options]\n";
 
@@ -301,7 +309,16 @@ static const char *output_help =
     "    " _B "-c" B_ " , " _B "--csv" B_ "\n"
     "        Output stats in a csv-like format for parsing\n"
     "    " _B "-q" B_ " , " _B "--no-header" B_ "\n"
-    "        Don't display column headers/footers\n";
+    "        Don't display column headers/footers\n"
+    "    " _B "-0" B_ " , " _B "--null" B_ "\n"
+    "        Machine output: raw values (sizes in bytes, times in seconds since the Epoch),\n"
+    "        each field terminated by a null character. The header is a record\n"
+    "        of field names.\n"
+    "    " _B "--binary" B_ "\n"
+    "        Machine output: length-prefixed binary records, preceded by a schema\n"
+    "        header (unless --no-header is specified).\n"
+    "        Machine output only applies to reports about entries, users, groups,\n"
+    "        classes, status and filesystem contents.\n";
 
 static const char *misc_help =
     _B "Miscellaneous options:" B_ "\n"
@@ -1242,7 +1259,7 @@ static void dump_entries( type_dump type, int int_arg, char * str_arg, value_lis
     lmgr_simple_filter_init( &filter );
 
     /* append global filters */
-    mk_global_filters( &filter, !NOHEADER(flags), NULL );
+    mk_global_filters( &filter, SUMMARY(flags), NULL );
 
     /* what do we dump? */
     switch(type)
@@ -1378,7 +1395,7 @@ static void dump_entries( type_dump type, int int_arg, char * str_arg, value_lis
         free(list);
 
     /* display summary */
-    if ( !NOHEADER(flags) )
+    if ( SUMMARY(flags) )
     {
         char strsz[128];
         FormatFileSize( strsz, 128, total_size );
@@ -1434,7 +1451,7 @@ static void report_fs_info( int flags )
     opt.force_no_acct = FORCE_NO_ACCT(flags);
 
     /* append global filters */
-    mk_global_filters(&filter, !NOHEADER(flags), &is_filter);
+    mk_global_filters(&filter, SUMMARY(flags), &is_filter);
 
     if ( is_filter )
         it = ListMgr_Report( &lmgr, fs_info, FSINFOCOUNT,
@@ -1478,7 +1495,7 @@ static void report_fs_info( int flags )
     ListMgr_CloseReport(it);
 
     /* display summary */
-    if ( !NOHEADER(flags) )
+    if ( SUMMARY(flags) )
     {
         char strsz[128];
         char strus[128];
@@ -1571,7 +1588,7 @@ static inline void set_report_rec_nofilter( report_field_descr_t* ent,
 
 static void report_usergroup_info( char *name, int flags )
 {
-    unsigned int   result_count;
+    unsigned int   i;
     struct lmgr_report_t *it;
     lmgr_filter_t  filter;
     filter_value_t fv;
@@ -1583,8 +1600,8 @@ static void report_usergroup_info( char *name, int flags )
     unsigned long long total_size, total_used, total_count;
     lmgr_iter_opt_t opt;
 #define USERINFOCOUNT_MAX 10
-    db_value_t     result[USERINFOCOUNT_MAX];
-    profile_u   prof;
+    const db_value_t *result;
+    report_items_t items;
 
     total_size = total_used = total_count = 0;
 
@@ -1686,7 +1703,7 @@ static void report_usergroup_info( char *name, int flags )
     }
 
     /* append global filters */
-    mk_global_filters( &filter, !NOHEADER(flags), &is_filter );
+    mk_global_filters( &filter, SUMMARY(flags), &is_filter );
 
     it = ListMgr_Report( &lmgr, user_info, field_count,
                          SPROF(flags)?&size_profile:NULL,
@@ -1701,14 +1718,24 @@ static void report_usergroup_info( char *name, int flags )
         return;
     }
 
-    result_count = field_count;
+    /* resolve all user/group names before displaying them */
+    rc = report_items_load(it, user_info, field_count, SPROF(flags), CSV(flags),
+                           &items);
+    ListMgr_CloseReport(it);
+    if (rc)
+    {
+        DisplayLog(LVL_CRIT, REPORT_TAG, "ERROR %d retrieving user stats "
+                   "from database.", rc);
+        return;
+    }
 
-    while ((rc = ListMgr_GetNextReportItem(it, result, &result_count,
-                                           SPROF(flags)?&prof:NULL)) == DB_SUCCESS)
+    for (i = 0; i < items.count; i++)
     {
-        result_count = field_count;
-        display_report(user_info, result_count, result, result_count,
-                       SPROF(flags)?&size_profile:NULL, SPROF(flags)?&prof:NULL,
+        result = report_item(&items, i);
+
+        display_report(user_info, field_count, result, field_count,
+                       SPROF(flags)?&size_profile:NULL,
+                       SPROF(flags)?&items.profiles[i]:NULL,
                        CSV(flags), display_header, 0);
         display_header = false; /* just display it once */
 
@@ -1718,11 +1745,10 @@ static void report_usergroup_info( char *name, int flags )
         /* this is a block count => multiply by 512 to get the space in bytes */
         total_used += (result[3+shift].value_u.val_biguint * DEV_BSIZE);
     }
-
-    ListMgr_CloseReport( it );
+    report_items_free(&items);
 
     /* display summary */
-    if ( !NOHEADER(flags) )
+    if ( SUMMARY(flags) )
     {
         char strsz[128];
         char strus[128];
@@ -1774,7 +1800,7 @@ static void report_topdirs( unsigned int count, int flags )
     }
 
     /* append global filters */
-    mk_global_filters( &filter, !NOHEADER(flags), NULL );
+    mk_global_filters( &filter, SUMMARY(flags), NULL );
 
     if (SORT_BY_AVGSIZE(flags))
         sorttype.attr_index = ATTR_INDEX_avgsize;
@@ -1863,7 +1889,7 @@ static void report_topsize( unsigned int count, int flags )
     lmgr_simple_filter_add( &filter, ATTR_INDEX_type, EQUAL, fv, 0 );
 
     /* append global filters */
-    mk_global_filters( &filter, !NOHEADER(flags), NULL );
+    mk_global_filters( &filter, SUMMARY(flags), NULL );
 
     /* order by size desc */
     sorttype.attr_index = ATTR_INDEX_size;
@@ -1967,7 +1993,7 @@ static void report_oldest(obj_type_t type, unsigned int count, int flags)
     lmgr_simple_filter_add(&filter, ATTR_INDEX_type, EQUAL, fv, 0);
 
     /* append global filters */
-    mk_global_filters(&filter, !NOHEADER(flags), NULL);
+    mk_global_filters(&filter, SUMMARY(flags), NULL);
 
 #ifndef _HAVE_FID
 #ifdef ATTR_INDEX_invalid
@@ -2020,7 +2046,7 @@ static void report_oldest(obj_type_t type, unsigned int count, int flags)
 
 static void report_topuser( unsigned int count, int flags )
 {
-    unsigned int   result_count;
+    unsigned int   i;
     struct lmgr_report_t *it;
     lmgr_iter_opt_t opt;
     int            rc;
@@ -2028,12 +2054,10 @@ static void report_topuser( unsigned int count, int flags )
     lmgr_filter_t  filter;
     filter_value_t fv;
     bool is_filter = false;
-    profile_u   prof;
+    report_items_t items;
 
 #define TOPUSERCOUNT 7
 
-    db_value_t     result[TOPUSERCOUNT];
-
     /* To be retrieved for each user:
      * - username
      * - SUM(blocks)
@@ -2083,7 +2107,7 @@ static void report_topuser( unsigned int count, int flags )
     lmgr_simple_filter_add( &filter, ATTR_INDEX_type, EQUAL, fv, 0 );
     is_filter = true;
 
-    mk_global_filters( &filter, !NOHEADER(flags), &is_filter );
+    mk_global_filters( &filter, SUMMARY(flags), &is_filter );
 
     /* is a filter specified? */
     it = ListMgr_Report( &lmgr, user_info, TOPUSERCOUNT,
@@ -2095,22 +2119,27 @@ static void report_topuser( unsigned int count, int flags )
         return;
     }
 
-    result_count = TOPUSERCOUNT;
-    while ((rc = ListMgr_GetNextReportItem(it, result, &result_count,
-                                           SPROF(flags)?&prof:NULL)) == DB_SUCCESS)
+    /* resolve all user names before displaying them */
+    rc = report_items_load(it, user_info, TOPUSERCOUNT, SPROF(flags),
+                           CSV(flags), &items);
+    ListMgr_CloseReport(it);
+    if (rc)
     {
-        display_report(user_info, result_count, result, result_count,
-                       SPROF(flags)?&size_profile:NULL, SPROF(flags)?&prof:NULL,
+        DisplayLog(LVL_CRIT, REPORT_TAG, "ERROR %d retrieving top space "
+                   "consumers from database.", rc);
+        return;
+    }
+
+    for (i = 0; i < items.count; i++)
+    {
+        display_report(user_info, TOPUSERCOUNT, report_item(&items, i),
+                       TOPUSERCOUNT, SPROF(flags)?&size_profile:NULL,
+                       SPROF(flags)?&items.profiles[i]:NULL,
                        CSV(flags), (rank == 1) && !NOHEADER(flags), rank); /* display header once */
 
         rank++;
-
-        /* prepare next call */
-        result_count = TOPUSERCOUNT;
-
     }
-
-    ListMgr_CloseReport( it );
+    report_items_free(&items);
 }
 
 static void report_deferred_rm( int flags )
@@ -2143,7 +2172,7 @@ static void report_deferred_rm( int flags )
     lmgr_simple_filter_init( &filter );
 
     /* append global filters */
-    mk_global_filters( &filter, !NOHEADER(flags), &is_filter );
+    mk_global_filters( &filter, SUMMARY(flags), &is_filter );
 
     /* order by rmtime asc */
     sort.attr_index = ATTR_INDEX_rm_time;
@@ -2179,7 +2208,7 @@ static void report_deferred_rm( int flags )
     ListMgr_CloseRmList(rmlist);
 
     /* display summary */
-    if (!NOHEADER(flags))
+    if (SUMMARY(flags))
     {
         char strsz[128];
 
@@ -2224,7 +2253,7 @@ static void report_class_info( int flags )
     };
 
     lmgr_simple_filter_init(&filter);
-    mk_global_filters(&filter, !NOHEADER(flags), &is_filter);
+    mk_global_filters(&filter, SUMMARY(flags), &is_filter);
     result_count = CLASSINFO_FIELDS;
 
     it = ListMgr_Report(&lmgr, class_info, CLASSINFO_FIELDS,
@@ -2260,7 +2289,7 @@ static void report_class_info( int flags )
     lmgr_simple_filter_free( &filter );
 
     /* display summary */
-    if ( !NOHEADER(flags) )
+    if ( SUMMARY(flags) )
     {
         char strsz[128];
         char strus[128];
@@ -2328,7 +2357,7 @@ static void report_status_info(int smi_index, const char* val, int flags)
         is_filter = true;
     }
 
-    mk_global_filters(&filter, !NOHEADER(flags), &is_filter);
+    mk_global_filters(&filter, SUMMARY(flags), &is_filter);
     result_count = STATUSINFO_FIELDS;
 
     opt.force_no_acct = FORCE_NO_ACCT(flags);
@@ -2371,7 +2400,7 @@ static void report_status_info(int smi_index, const char* val, int flags)
     lmgr_simple_filter_free(&filter);
 
     /* display summary */
-    if (!NOHEADER(flags))
+    if (SUMMARY(flags))
     {
         char strsz[128];
         char strus[128];
@@ -2781,6 +2810,14 @@ int main( int argc, char **argv )
         case 'q':
             flags |= OPT_FLAG_NOHEADER;
             break;
+        case '0':
+            flags |= OPT_FLAG_MACHINE;
+            set_output_format(OUT_NUL);
+            break;
+        case OPT_BINARY:
+            flags |= OPT_FLAG_MACHINE;
+            set_output_format(OUT_BINARY);
+            break;
         case 'h':
             display_help( bin );
             exit( 0 );
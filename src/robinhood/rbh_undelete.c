@@ -27,6 +27,8 @@
 #include "xplatform_print.h"
 #include "rbh_basename.h"
 #include "cmd_helpers.h"
+#include "queue.h"
+#include "Memory.h"
 
 #include <unistd.h>
 #include <getopt.h>
@@ -37,6 +39,13 @@
 
 #define LOGTAG "Undelete"
 
+/** max number of restored entries a thread inserts at once to the DB */
+#define UNDELETE_BATCH_SIZE         256
+/** max number of queued entries, per thread */
+#define UNDELETE_QUEUE_PER_THREAD   64
+/** interval for reporting progress (seconds) */
+#define UNDELETE_PROGRESS_INTERVAL  10
+
 static struct option option_tab[] =
 {
     /* options for cancelling remove operation */
@@ -45,6 +54,7 @@ static struct option option_tab[] =
 
     {"statusmgr", required_argument, NULL, 's'},
     {"status-mgr", required_argument, NULL, 's'},
+    {"threads", required_argument, NULL, 't'},
 
     /* config file options */
     {"config-file", required_argument, NULL, 'f'},
@@ -60,13 +70,14 @@ static struct option option_tab[] =
 
 };
 
-#define SHORT_OPT_STRING    "LRs:f:l:hV"
+#define SHORT_OPT_STRING    "LRs:t:f:l:hV"
 
 /* global variables */
 
 static lmgr_t  lmgr;
 char path_filter[RBH_PATH_MAX] = "";
 static sm_instance_t *smi = NULL;
+static unsigned int nb_threads = 1;
 
 /* special character sequences for displaying help */
 
@@ -91,6 +102,8 @@ static const char *help_string =
     "\n"
     _B "Behavior options:" B_ "\n"
     "    " _B "--status-mgr" B_ _U "statusmgr" U_", " _B "-s" B_ _U "statusmgr" U_"\n"
+    "    " _B "--threads" B_ "=" _U "nbr" U_ ", " _B "-t" B_ " " _U "nbr" U_ "\n"
+    "        Restore entries using " _U "nbr" U_ " parallel threads (default: 1).\n"
     "\n"
     _B "Config file options:" B_ "\n"
     "    " _B "-f" B_ " " _U "file" U_ ", " _B "--config-file=" B_ _U "file" U_ "\n"
@@ -382,6 +395,310 @@ static void undelete_helper(const entry_id_t *id,
     }
 }
 
+/** removed entry to be restored */
+typedef struct undelete_item {
+    entry_id_t id;
+    attr_set_t attrs;
+} undelete_item_t;
+
+typedef struct undelete_worker {
+    pthread_t    thread;
+    lmgr_t       lmgr; /* each thread has its own DB connection */
+
+    /* restored entries to be inserted into the DB (all with the same mask)
+     * and discarded from the removed entry list */
+    unsigned int count;
+    entry_id_t   old_ids[UNDELETE_BATCH_SIZE];
+    entry_id_t   new_ids[UNDELETE_BATCH_SIZE];
+    attr_set_t   new_attrs[UNDELETE_BATCH_SIZE];
+} undelete_worker_t;
+
+static entry_queue_t undelete_queue;
+
+/** Update the database for the restored entries of the batch. */
+static void flush_batch(undelete_worker_t *w)
+{
+    entry_id_t   *p_ids[UNDELETE_BATCH_SIZE];
+    attr_set_t   *p_attrs[UNDELETE_BATCH_SIZE];
+    unsigned int  i;
+    int           rc;
+
+    if (w->count == 0)
+        return;
+
+    /* discard entries from remove list */
+    rc = ListMgr_SoftRemove_DiscardBatch(&w->lmgr, w->old_ids, w->count);
+    if (rc)
+    {
+        __atomic_add_fetch(&db_err, w->count, __ATOMIC_RELAXED);
+        fprintf(stderr, "Error: could not remove %u previous ids from "
+                "database\n", w->count);
+    }
+
+    /* insert or update them in the db */
+    for (i = 0; i < w->count; i++)
+    {
+        p_ids[i] = &w->new_ids[i];
+        p_attrs[i] = &w->new_attrs[i];
+    }
+    rc = ListMgr_BatchInsert(&w->lmgr, p_ids, p_attrs, w->count, true);
+    if (rc)
+    {
+        /* insert them one by one to report failing entries */
+        for (i = 0; i < w->count; i++)
+        {
+            rc = ListMgr_Insert(&w->lmgr, p_ids[i], p_attrs[i], true);
+            if (rc)
+            {
+                __atomic_add_fetch(&db_err, 1, __ATOMIC_RELAXED);
+                fprintf(stderr, "ERROR %d inserting entry '%s' in the "
+                        "database\n", rc, ATTR(p_attrs[i], fullpath));
+            }
+        }
+    }
+
+    for (i = 0; i < w->count; i++)
+        ListMgr_FreeAttrs(&w->new_attrs[i]);
+    w->count = 0;
+}
+
+static void undelete_entry(undelete_worker_t *w, undelete_item_t *item)
+{
+    entry_id_t      new_id = {0};
+    attr_set_t      new_attrs = ATTR_SET_INIT;
+    recov_status_t  st;
+    const char     *path = ATTR(&item->attrs, fullpath);
+
+    st = smi->sm->undelete_func(smi, &item->id, &item->attrs, &new_id,
+                                &new_attrs, false);
+
+    switch (st)
+    {
+        case RS_FILE_OK:
+            printf("Restoring '%s': restore OK (file)\n", path);
+            break;
+        case RS_FILE_DELTA:
+            printf("Restoring '%s': restored previous version (file)\n", path);
+            break;
+        case RS_FILE_EMPTY:
+            printf("Restoring '%s': restore OK (empty file)\n", path);
+            break;
+        case RS_NON_FILE:
+            printf("Restoring '%s': restore OK (%s)\n", path,
+                   ATTR(&item->attrs, type));
+            break;
+        case RS_NOBACKUP:
+            printf("Restoring '%s': cannot restore %s (no backup)\n", path,
+                   ATTR(&item->attrs, type));
+            break;
+        case RS_ERROR:
+            printf("Restoring '%s': ERROR\n", path);
+            break;
+        default:
+            printf("Restoring '%s': UNEXPECTED STATUS %d\n", path, st);
+            st = RS_ERROR;
+    }
+
+    if ((st == RS_FILE_OK) || (st == RS_FILE_DELTA) || (st == RS_FILE_EMPTY)
+        || (st == RS_NON_FILE))
+    {
+        /* clean read-only attrs */
+        attr_mask_unset_readonly(&new_attrs.attr_mask);
+
+        /* entries of a batch must have the same attribute mask */
+        if (w->count > 0 && !attr_mask_equal(&new_attrs.attr_mask,
+                                             &w->new_attrs[0].attr_mask))
+            flush_batch(w);
+
+        w->old_ids[w->count] = item->id;
+        w->new_ids[w->count] = new_id;
+        w->new_attrs[w->count] = new_attrs; /* batch takes ownership */
+        w->count++;
+
+        if (w->count >= UNDELETE_BATCH_SIZE)
+            flush_batch(w);
+    }
+    else
+        ListMgr_FreeAttrs(&new_attrs);
+
+    Queue_Acknowledge(&undelete_queue, st, NULL, 0);
+}
+
+static void *undelete_worker_thr(void *arg)
+{
+    undelete_worker_t *w = arg;
+    undelete_item_t   *item;
+    int rc;
+
+    while (1)
+    {
+        rc = Queue_TryGet(&undelete_queue, (void **)&item);
+        if (rc == EAGAIN)
+        {
+            /* nothing to do for now: update the DB before waiting */
+            flush_batch(w);
+            rc = Queue_Get(&undelete_queue, (void **)&item);
+        }
+        if (rc)
+        {
+            DisplayLog(LVL_CRIT, LOGTAG, "ERROR %d getting entry from queue",
+                       rc);
+            continue;
+        }
+
+        /* end of undelete */
+        if (item == NULL)
+            break;
+
+        undelete_entry(w, item);
+
+        ListMgr_FreeAttrs(&item->attrs);
+        MemFree(item);
+    }
+
+    flush_batch(w);
+    return NULL;
+}
+
+/** Display undelete progress, and return the number of processed entries. */
+static unsigned int undelete_progress(unsigned int nb_submitted,
+                                      time_t start, bool display)
+{
+    unsigned int status_tab[RS_COUNT];
+    unsigned int done = 0;
+    recov_status_t st;
+    time_t elapsed;
+
+    RetrieveQueueStats(&undelete_queue, NULL, NULL, NULL, NULL, NULL,
+                       status_tab, NULL);
+    for (st = RS_FILE_OK; st < RS_COUNT; st++)
+        done += status_tab[st];
+
+    if (display)
+    {
+        elapsed = time(NULL) - start;
+        DisplayLog(LVL_EVENT, LOGTAG, "Progress: %u/%u entries processed "
+                   "(%u errors), %.1f entries/sec", done, nb_submitted,
+                   status_tab[RS_ERROR],
+                   elapsed > 0 ? (double)done / elapsed : (double)done);
+    }
+    return done;
+}
+
+/** Restore the entries of the given list using a pool of threads. */
+static int undelete_parallel(struct lmgr_rm_list_t *list, attr_mask_t mask)
+{
+    undelete_worker_t *workers;
+    undelete_item_t   *item;
+    unsigned int       i, nb_started;
+    unsigned int       nb_submitted = 0;
+    unsigned int       status_tab[RS_COUNT];
+    time_t             start = time(NULL);
+    time_t             next_report = start + UNDELETE_PROGRESS_INTERVAL;
+    recov_status_t     st;
+    int                rc;
+
+    rc = CreateQueue(&undelete_queue, nb_threads * UNDELETE_QUEUE_PER_THREAD,
+                     RS_COUNT - 1, 0);
+    if (rc)
+    {
+        DisplayLog(LVL_CRIT, LOGTAG, "Error %d initializing queue", rc);
+        return rc;
+    }
+
+    workers = MemCalloc(nb_threads, sizeof(*workers));
+    if (workers == NULL)
+    {
+        rc = -ENOMEM;
+        goto free_queue;
+    }
+
+    for (nb_started = 0; nb_started < nb_threads; nb_started++)
+    {
+        undelete_worker_t *w = &workers[nb_started];
+
+        rc = ListMgr_InitAccess(&w->lmgr);
+        if (rc)
+        {
+            DisplayLog(LVL_CRIT, LOGTAG, "Error %d: cannot connect to "
+                       "database", rc);
+            break;
+        }
+        rc = pthread_create(&w->thread, NULL, undelete_worker_thr, w);
+        if (rc)
+        {
+            DisplayLog(LVL_CRIT, LOGTAG, "Error %d creating thread: %s",
+                       rc, strerror(rc));
+            ListMgr_CloseAccess(&w->lmgr);
+            break;
+        }
+    }
+    if (nb_started == 0)
+        goto free_workers;
+    rc = 0;
+
+    while (1)
+    {
+        item = MemAlloc(sizeof(*item));
+        if (item == NULL)
+        {
+            rc = -ENOMEM;
+            break;
+        }
+        memset(&item->attrs, 0, sizeof(item->attrs));
+        item->attrs.attr_mask = mask;
+
+        rc = ListMgr_GetNextRmEntry(list, &item->id, &item->attrs);
+        if (rc)
+        {
+            MemFree(item);
+            if (rc == DB_END_OF_LIST)
+                rc = 0;
+            break;
+        }
+
+        Queue_Insert(&undelete_queue, item);
+        nb_submitted++;
+
+        if (time(NULL) >= next_report)
+        {
+            undelete_progress(nb_submitted, start, true);
+            next_report = time(NULL) + UNDELETE_PROGRESS_INTERVAL;
+        }
+    }
+
+    /* wait for queued entries to be processed */
+    while (undelete_progress(nb_submitted, start, false) < nb_submitted)
+    {
+        if (time(NULL) >= next_report)
+        {
+            undelete_progress(nb_submitted, start, true);
+            next_report = time(NULL) + UNDELETE_PROGRESS_INTERVAL;
+        }
+        rh_usleep(10000);
+    }
+
+    /* stop threads (they flush their pending DB updates) */
+    for (i = 0; i < nb_started; i++)
+        Queue_Insert(&undelete_queue, NULL);
+    for (i = 0; i < nb_started; i++)
+    {
+        pthread_join(workers[i].thread, NULL);
+        ListMgr_CloseAccess(&workers[i].lmgr);
+    }
+
+    RetrieveQueueStats(&undelete_queue, NULL, NULL, NULL, NULL, NULL,
+                       status_tab, NULL);
+    for (st = RS_FILE_OK; st < RS_COUNT; st++)
+        counters[st] += status_tab[st];
+
+free_workers:
+    MemFree(workers);
+free_queue:
+    DestroyQueue(&undelete_queue);
+    return rc;
+}
+
 static int undelete(void)
 {
     int            rc;
@@ -435,6 +752,13 @@ static int undelete(void)
             return -1;
         }
 
+        if (nb_threads > 1)
+        {
+            rc = undelete_parallel(list, mask);
+            ListMgr_CloseRmList(list);
+            goto summary;
+        }
+
         while ((rc = ListMgr_GetNextRmEntry(list, &id, &attrs)) == DB_SUCCESS)
         {
             undelete_helper(&id, &attrs);
@@ -447,6 +771,7 @@ static int undelete(void)
         ListMgr_CloseRmList(list);
     }
 
+summary:
     /* display summary */
     printf("\nundelete summary:\n");
     for (st = RS_FILE_OK; st < RS_COUNT; st++)
@@ -570,6 +895,16 @@ int main(int argc, char **argv)
                 rh_strncpy(sm_name, optarg, sizeof(sm_name));
             break;
 
+        case 't':
+            nb_threads = str2int(optarg);
+            if ((int)nb_threads <= 0)
+            {
+                fprintf(stderr, "Invalid value '%s' for --threads: positive "
+                        "integer expected\n", optarg);
+                exit(1);
+            }
+            break;
+
         case 'f':
             rh_strncpy(config_file, optarg, MAX_OPT_LEN);
             break;
@@ -0,0 +1,335 @@
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include "global_config.h"
+global_config_t global_config;
+
+#include "list_mgr.h"
+#include "rbh_logs.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/* The compiled chunks are private to the formatter: include it to compare
+ * its output with the output of the chunk printf formats. */
+#include "../robinhood/rbh_find_printf.c"
+
+/* avoid linking with all robinhood libs */
+log_config_t log_config = { .debug_level = LVL_DEBUG };
+
+void DisplayLogFn(log_level debug_level, const char *tag, const char *format, ...)
+{
+    if (LVL_DEBUG >= debug_level)
+    {
+        va_list args;
+
+        va_start(args, format);
+        vprintf(format, args);
+        va_end(args);
+        printf("\n");
+    }
+}
+
+attr_mask_t disp_mask;
+struct find_opt prog_options;
+unsigned int sm_inst_count;
+unsigned int sm_attr_count;
+
+const char *type2char(const char *type)
+{
+    return type;
+}
+
+const char type2onechar(const char *type)
+{
+    return type[0];
+}
+
+const char *mode_string(mode_t mode, char *buf)
+{
+    int i;
+
+    for (i = 0; i < 9; i++)
+        buf[i] = (mode & (0400 >> i)) ? "rwx"[i % 3] : '-';
+    return buf;
+}
+
+sm_instance_t *smi_by_name(const char *smi_name)
+{
+    return NULL;
+}
+
+int sm_attr_get(const sm_instance_t *smi, const attr_set_t *p_attrs,
+                const char *name, void **val, const sm_info_def_t **ppdef,
+                unsigned int *attr_index)
+{
+    return -1;
+}
+
+#ifdef _LUSTRE
+void append_stripe_list(GString *str, const stripe_items_t *p_stripe_items,
+                        bool brief)
+{
+}
+#endif
+
+/* Output of an entry by the chunk printf formats (former implementation) */
+static void ref_date(GString *out, const struct fchunk *chunk, time_t date)
+{
+    char       str[1000];
+    struct tm  tmp;
+    size_t     sret;
+
+    localtime_r(&date, &tmp);
+    if (chunk->time_format)
+        sret = strftime(str, sizeof(str), chunk->time_format->str, &tmp);
+    else
+        sret = strftime(str, sizeof(str), chunk->format->str, &tmp);
+
+    if (sret == 0)
+        return;
+    if (chunk->time_format)
+        g_string_append_printf(out, chunk->format->str, str);
+    else
+        g_string_append(out, str);
+}
+
+static void ref_entry(GString *out, GArray *chunks, const wagon_t *id,
+                      const attr_set_t *attrs)
+{
+    int i;
+
+    for (i = 0; i < chunks->len; i++)
+    {
+        struct fchunk *chunk = &g_array_index(chunks, struct fchunk, i);
+        const char    *format = chunk->format->str;
+        char           buf[128];
+
+        switch (chunk->directive)
+        {
+        case 0:
+            g_string_append_printf(out, format, NULL);
+            break;
+        case 'A':
+            ref_date(out, chunk, ATTR(attrs, last_access));
+            break;
+        case 'b':
+            g_string_append_printf(out, format, ATTR(attrs, blocks));
+            break;
+        case 'C':
+            ref_date(out, chunk, ATTR(attrs, last_mdchange));
+            break;
+        case 'd':
+            g_string_append_printf(out, format, ATTR(attrs, depth));
+            break;
+        case 'f':
+            g_string_append_printf(out, format, ATTR(attrs, name));
+            break;
+        case 'g':
+            if (global_config.uid_gid_as_numbers)
+                g_string_append_printf(out, format, ATTR(attrs, gid).num);
+            else
+                g_string_append_printf(out, format, ATTR(attrs, gid).txt);
+            break;
+        case 'm':
+            g_string_append_printf(out, format, ATTR(attrs, mode));
+            break;
+        case 'M':
+            buf[9] = '\0';
+            g_string_append_printf(out, format,
+                                   mode_string(ATTR(attrs, mode), buf));
+            break;
+        case 'n':
+            g_string_append_printf(out, format, ATTR(attrs, nlink));
+            break;
+        case 'p':
+            g_string_append_printf(out, format, id->fullname);
+            break;
+        case 's':
+            g_string_append_printf(out, format, ATTR(attrs, size));
+            break;
+        case 'T':
+            ref_date(out, chunk, ATTR(attrs, last_mod));
+            break;
+        case 'u':
+            if (global_config.uid_gid_as_numbers)
+                g_string_append_printf(out, format, ATTR(attrs, uid).num);
+            else
+                g_string_append_printf(out, format, ATTR(attrs, uid).txt);
+            break;
+        case 'Y':
+            g_string_append_printf(out, format, ATTR(attrs, type));
+            break;
+        case 'y':
+            g_string_append_printf(out, format, ATTR(attrs, type)[0]);
+            break;
+        case 'R':
+            switch (chunk->sub_directive)
+            {
+            case 'C':
+                ref_date(out, chunk, ATTR(attrs, creation_time));
+                break;
+            case 'c':
+                g_string_append_printf(out, format,
+                        class_format(ATTR_MASK_TEST(attrs, fileclass) ?
+                                     ATTR(attrs, fileclass) : NULL));
+                break;
+            case 'f':
+                sprintf(buf, DFID_NOBRACE, PFID(&id->id));
+                g_string_append_printf(out, format, buf);
+                break;
+            }
+            break;
+        }
+    }
+}
+
+static const char *formats[] = {
+    "%p\\n",
+    "%f|%-20f|%20f|%05f|%-05f|\\n",
+    "%s %5s %-12s| %012s %b %05b\\n",
+    "%u:%g %8u:%-8g| %08u %-08g|\\n",
+    "%m %04m %-6m| %M %12M %y %3y %Y %-6Y|\\n",
+    "%n %d %3n %-3d|\\n",
+    "100%% %s\\t%%%%\\t%RC{%Y-%m-%d} %TY %A{%H:%M} %-12C{%s}|\\n",
+    "[%Rf] [%-40Rf] [%Rc] [%10Rc]\\n",
+    "no directive at all\\n",
+    "%s%s%s%p%p",
+};
+
+static void fill_entry(wagon_t *id, attr_set_t *attrs, unsigned int i)
+{
+    static char name[64];
+    static char path[128];
+
+    memset(id, 0, sizeof(*id));
+    memset(attrs, 0, sizeof(*attrs));
+
+    snprintf(name, sizeof(name), i == 0 ? "" : "file %u.dat", i * 7919);
+    snprintf(path, sizeof(path), "/fs/dir%u/%s", i, name);
+    id->fullname = path;
+#ifdef _HAVE_FID
+    id->id.f_seq = 0x200000400 + i;
+    id->id.f_oid = i;
+#else
+    id->id.fs_key = 0x812 + i;
+    id->id.inode = i * 1000003;
+#endif
+
+    rh_strncpy(ATTR(attrs, name), name, sizeof(ATTR(attrs, name)));
+    ATTR(attrs, size) = i == 0 ? 0 : (1ULL << (i * 7 % 64)) + i;
+    ATTR(attrs, blocks) = ATTR(attrs, size) / 512;
+    ATTR(attrs, mode) = (i * 0123) & 07777;
+    ATTR(attrs, nlink) = i;
+    ATTR(attrs, depth) = i % 20;
+    if (global_config.uid_gid_as_numbers)
+    {
+        ATTR(attrs, uid).num = i * 1000;
+        ATTR(attrs, gid).num = (i % 2) ? -(int)i : (int)i;
+    }
+    else
+    {
+        rh_strncpy(ATTR(attrs, uid).txt, "user", sizeof(ATTR(attrs, uid).txt));
+        rh_strncpy(ATTR(attrs, gid).txt, i % 2 ? "grp" : "a_longer_group",
+                   sizeof(ATTR(attrs, gid).txt));
+    }
+    rh_strncpy(ATTR(attrs, type), (i % 3) ? "file" : "dir",
+               sizeof(ATTR(attrs, type)));
+    ATTR_MASK_SET(attrs, type);
+    if (i % 4)
+    {
+        rh_strncpy(ATTR(attrs, fileclass), i % 2 ? "small" : "",
+                   sizeof(ATTR(attrs, fileclass)));
+        ATTR_MASK_SET(attrs, fileclass);
+    }
+    ATTR(attrs, last_access) = 1400000000 + i * 86399;
+    ATTR(attrs, last_mod) = 1300000000 + i * 3600;
+    ATTR(attrs, last_mdchange) = 1500000000 + i;
+    ATTR(attrs, creation_time) = 1200000000 + i * 1000000;
+}
+
+static void check_formats(void)
+{
+    GString     *out = g_string_new(NULL);
+    GString     *ref = g_string_new(NULL);
+    wagon_t      id;
+    attr_set_t   attrs;
+    unsigned int f, i;
+
+    for (f = 0; f < sizeof(formats) / sizeof(formats[0]); f++)
+    {
+        GArray *chunks = prepare_printf_format(formats[f]);
+
+        if (chunks == NULL)
+        {
+            fprintf(stderr, "invalid format '%s'\n", formats[f]);
+            abort();
+        }
+
+        for (i = 0; i < 20; i++)
+        {
+            fill_entry(&id, &attrs, i);
+            g_string_truncate(out, 0);
+            g_string_truncate(ref, 0);
+
+            printf_entry(out, chunks, &id, &attrs);
+            ref_entry(ref, chunks, &id, &attrs);
+
+            if (strcmp(out->str, ref->str))
+            {
+                fprintf(stderr, "format '%s', entry %u:\n"
+                        "got:      '%s'\nexpected: '%s'\n", formats[f], i,
+                        out->str, ref->str);
+                abort();
+            }
+        }
+        free_printf_formats(chunks);
+    }
+
+    g_string_free(out, TRUE);
+    g_string_free(ref, TRUE);
+}
+
+int main(int argc, char **argv)
+{
+    static const char *bad_formats[] = { "%", "%Z", "%R", "%Rz", "\\",
+                                         "\\q", "%T", "%Rm{nosuch.attr}" };
+    GString           *out = g_string_new(NULL);
+    wagon_t            id;
+    attr_set_t         attrs;
+    GArray            *chunks;
+    unsigned int       i;
+
+    global_config.uid_gid_as_numbers = false;
+    check_formats();
+    global_config.uid_gid_as_numbers = true;
+    check_formats();
+
+    /* escaped names */
+    prog_options.escaped = 1;
+    fill_entry(&id, &attrs, 1);
+    id.fullname = "/fs/a\\b\tc\n";
+    chunks = prepare_printf_format("%p|%-14p|");
+    printf_entry(out, chunks, &id, &attrs);
+    if (strcmp(out->str, "/fs/a\\134b\\011c\\012|/fs/a\\134b\\011c\\012|"))
+    {
+        fprintf(stderr, "escaped: '%s'\n", out->str);
+        abort();
+    }
+    free_printf_formats(chunks);
+    g_string_free(out, TRUE);
+
+    for (i = 0; i < sizeof(bad_formats) / sizeof(bad_formats[0]); i++)
+    {
+        if (prepare_printf_format(bad_formats[i]) != NULL)
+        {
+            fprintf(stderr, "format '%s' should be rejected\n",
+                    bad_formats[i]);
+            abort();
+        }
+    }
+
+    printf("OK\n");
+    return 0;
+}
@@ -0,0 +1,278 @@
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include "global_config.h"
+global_config_t global_config;
+
+#include "rbh_snapshot.h"
+#include "rbh_logs.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <fcntl.h>
+
+/* avoid linking with all robinhood libs */
+log_config_t log_config = { .debug_level = LVL_DEBUG };
+
+void DisplayLogFn(log_level debug_level, const char *tag, const char *format, ...)
+{
+    if (LVL_DEBUG >= debug_level)
+    {
+        va_list args;
+
+        va_start(args, format);
+        vprintf(format, args);
+        va_end(args);
+        printf("\n");
+    }
+}
+
+#define ROWS        10
+#define GROUP_ROWS  4
+
+static const char *names[ROWS] = { "a.txt", "b.log", NULL, "dir/c.txt",
+                                   "d.txt", "", "e.txt", NULL, "f.txt",
+                                   "g.log" };
+
+/* row i has size i*100, NULL for multiples of 3 */
+static bool size_set(int i)
+{
+    return i % 3 != 0;
+}
+
+static void write_snap(const char *path, bool compress)
+{
+    const char           *col_names[] = { "size", "name" };
+    const snap_col_type_e col_types[] = { SNAP_COL_INT64, SNAP_COL_STR };
+    snap_writer_t        *w;
+    int                   i, err = 0;
+
+    w = snap_writer_create(path, 2, col_names, col_types, GROUP_ROWS,
+                           compress, &err);
+    if (w == NULL)
+    {
+        fprintf(stderr, "snap_writer_create(%s): %s\n", path, strerror(err));
+        abort();
+    }
+
+    for (i = 0; i < ROWS; i++)
+    {
+        if (size_set(i) && snap_writer_set_int(w, 0, i * 100))
+            abort();
+        if (names[i] != NULL && snap_writer_set_str(w, 1, names[i]))
+            abort();
+        if (snap_writer_end_row(w))
+            abort();
+    }
+
+    if (snap_writer_close(w, true))
+        abort();
+}
+
+static void check_snap(const char *path)
+{
+    snap_reader_t  *r;
+    snap_col_data_t size, name;
+    uint64_t        g, i, row = 0;
+    unsigned int    match = 0;
+    int             err = 0;
+
+    r = snap_reader_open(path, &err);
+    if (r == NULL)
+    {
+        fprintf(stderr, "snap_reader_open(%s): %s\n", path, strerror(err));
+        abort();
+    }
+
+    if (snap_reader_row_count(r) != ROWS)
+        abort();
+    if (snap_reader_group_count(r) != (ROWS + GROUP_ROWS - 1) / GROUP_ROWS)
+        abort();
+    if (snap_reader_col_index(r, "name") != 1
+        || snap_reader_col_index(r, "foo") != -1)
+        abort();
+
+    for (g = 0; g < snap_reader_group_count(r); g++)
+    {
+        uint8_t sel[1];
+
+        if (snap_reader_load(r, g, 0, &size) || snap_reader_load(r, g, 1, &name))
+            abort();
+        if (size.row_count != name.row_count)
+            abort();
+
+        for (i = 0; i < size.row_count; i++, row++)
+        {
+            if (snap_is_valid(&size, i) != size_set(row))
+                abort();
+            if (size_set(row) && size.int_values[i] != row * 100)
+                abort();
+
+            if (snap_is_valid(&name, i) != (names[row] != NULL))
+                abort();
+            if (names[row] != NULL
+                && (name.str_offsets[i+1] - name.str_offsets[i]
+                        != strlen(names[row])
+                    || strncmp(name.str_data + name.str_offsets[i], names[row],
+                               strlen(names[row]))))
+                abort();
+        }
+
+        /* select *.txt with size >= 300 */
+        sel[0] = 0xff;
+        snap_filter_int(&size, SNAP_GE, 300, sel);
+        snap_filter_str(&name, "*.txt", false, sel);
+        for (i = 0; i < size.row_count; i++)
+            if ((sel[0] >> i) & 1)
+                match++;
+
+        snap_col_data_release(&size);
+        snap_col_data_release(&name);
+    }
+    if (row != ROWS)
+        abort();
+    /* matching rows: d.txt (400), f.txt (800).
+     * dir/c.txt and e.txt have a NULL size */
+    if (match != 2)
+        abort();
+
+    snap_reader_close(r);
+}
+
+/* overwrite the descriptor of a column chunk in the first row group */
+static void corrupt_chunk(const char *path, unsigned int col,
+                          void (*change)(struct snap_chunk *))
+{
+    struct snap_footer footer;
+    struct snap_chunk  chunk;
+    uint64_t           ghdr_off;
+    off_t              off;
+    int                fd;
+
+    fd = open(path, O_RDWR);
+    if (fd < 0)
+        abort();
+
+    off = lseek(fd, -(off_t)sizeof(footer), SEEK_END);
+    if (pread(fd, &footer, sizeof(footer), off) != sizeof(footer))
+        abort();
+    if (pread(fd, &ghdr_off, sizeof(ghdr_off), footer.index_offset)
+        != sizeof(ghdr_off))
+        abort();
+
+    off = ghdr_off + sizeof(struct snap_group_header) + col * sizeof(chunk);
+    if (pread(fd, &chunk, sizeof(chunk), off) != sizeof(chunk))
+        abort();
+    change(&chunk);
+    if (pwrite(fd, &chunk, sizeof(chunk), off) != sizeof(chunk))
+        abort();
+    close(fd);
+}
+
+/* chunk too small for the row count */
+static void shrink_chunk(struct snap_chunk *chunk)
+{
+    chunk->raw_size = chunk->stored_size = 8;
+}
+
+/* chunk beyond end of file */
+static void move_chunk(struct snap_chunk *chunk)
+{
+    chunk->offset = UINT64_MAX - 7;
+}
+
+/* string offsets beyond string data */
+static void corrupt_offsets(const char *path)
+{
+    struct snap_footer footer;
+    struct snap_chunk  chunk;
+    uint64_t           ghdr_off, bad = 1000000;
+    off_t              off;
+    int                fd;
+
+    fd = open(path, O_RDWR);
+    if (fd < 0)
+        abort();
+
+    off = lseek(fd, -(off_t)sizeof(footer), SEEK_END);
+    if (pread(fd, &footer, sizeof(footer), off) != sizeof(footer))
+        abort();
+    if (pread(fd, &ghdr_off, sizeof(ghdr_off), footer.index_offset)
+        != sizeof(ghdr_off))
+        abort();
+    off = ghdr_off + sizeof(struct snap_group_header) + sizeof(chunk);
+    if (pread(fd, &chunk, sizeof(chunk), off) != sizeof(chunk))
+        abort();
+
+    /* last offset of the first group (bitmap is 8 bytes) */
+    if (pwrite(fd, &bad, sizeof(bad), chunk.offset + 8
+               + GROUP_ROWS * sizeof(uint64_t)) != sizeof(bad))
+        abort();
+    close(fd);
+}
+
+static void check_corrupted(const char *path)
+{
+    snap_reader_t  *r;
+    snap_col_data_t data;
+    int             err = 0;
+
+    r = snap_reader_open(path, &err);
+    if (r == NULL)
+        abort();
+
+    if (snap_reader_load(r, 0, 0, &data) != EINVAL
+        && snap_reader_load(r, 0, 1, &data) != EINVAL)
+        abort();
+
+    /* other groups are still readable */
+    if (snap_reader_load(r, 1, 0, &data))
+        abort();
+    snap_col_data_release(&data);
+
+    snap_reader_close(r);
+}
+
+int main(int argc, char **argv)
+{
+    char path[] = "/tmp/test_snapshot.XXXXXX";
+    int  fd;
+
+    fd = mkstemp(path);
+    if (fd < 0)
+        abort();
+    close(fd);
+
+    write_snap(path, true);
+    check_snap(path);
+
+    write_snap(path, false);
+    check_snap(path);
+
+    corrupt_chunk(path, 0, shrink_chunk);
+    check_corrupted(path);
+
+    write_snap(path, false);
+    corrupt_chunk(path, 1, move_chunk);
+    check_corrupted(path);
+
+    write_snap(path, false);
+    corrupt_offsets(path);
+    check_corrupted(path);
+
+    /* not a snapshot */
+    fd = open(path, O_WRONLY | O_TRUNC);
+    if (fd < 0 || write(fd, "not a snapshot file, really not at all, no\n",
+                        44) != 44)
+        abort();
+    close(fd);
+    if (snap_reader_open(path, &fd) != NULL || fd != EINVAL)
+        abort();
+
+    unlink(path);
+    printf("OK\n");
+    return 0;
+}
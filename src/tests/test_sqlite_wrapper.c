@@ -0,0 +1,230 @@
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include "global_config.h"
+global_config_t global_config;
+
+#include "list_mgr.h"
+#include "database.h"
+#include "rbh_logs.h"
+#include "rbh_misc.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+/* avoid linking with all robinhood libs */
+log_config_t log_config = { .debug_level = LVL_DEBUG };
+lmgr_config_t lmgr_config;
+
+void DisplayLogFn(log_level debug_level, const char *tag, const char *format, ...)
+{
+    if (LVL_DEBUG >= debug_level)
+    {
+        va_list args;
+
+        va_start(args, format);
+        vprintf(format, args);
+        va_end(args);
+        printf("\n");
+    }
+}
+
+#define ENTRIES 100
+
+static void exec(db_conn_t *conn, const char *query)
+{
+    if (db_exec_sql(conn, query, NULL) != DB_SUCCESS)
+    {
+        fprintf(stderr, "query failed: %s\n", query);
+        abort();
+    }
+}
+
+/* run a query returning a single value and compare it */
+static void check_value(db_conn_t *conn, const char *query,
+                        const char *expected)
+{
+    result_handle_t res;
+    char           *val[1];
+
+    if (db_exec_sql(conn, query, &res) != DB_SUCCESS)
+        abort();
+    if (db_next_record(conn, &res, val, 1) != DB_SUCCESS)
+    {
+        fprintf(stderr, "no result for: %s\n", query);
+        abort();
+    }
+    if ((val[0] == NULL) != (expected == NULL)
+        || (val[0] != NULL && strcmp(val[0], expected)))
+    {
+        fprintf(stderr, "%s: got '%s', expected '%s'\n", query,
+                val[0] ? val[0] : "NULL", expected ? expected : "NULL");
+        abort();
+    }
+    if (db_next_record(conn, &res, val, 1) != DB_END_OF_LIST)
+        abort();
+    db_result_free(conn, &res);
+}
+
+/* number of statements prepared on the connection */
+static unsigned int stmt_count(db_conn_t *conn)
+{
+    sqlite3_stmt *stmt = NULL;
+    unsigned int  count = 0;
+
+    while ((stmt = sqlite3_next_stmt(conn->db, stmt)) != NULL)
+        count++;
+    return count;
+}
+
+int main(int argc, char **argv)
+{
+    char            path[] = "/tmp/test_sqlite_wrapper.XXXXXX";
+    char            query[1024];
+    char            expect[128];
+    db_conn_t       conn;
+    result_handle_t res;
+    char           *val[2];
+    unsigned int    i, before;
+    int             fd;
+
+    fd = mkstemp(path);
+    if (fd < 0)
+        abort();
+    close(fd);
+
+    rh_strncpy(lmgr_config.db_config.filepath, path,
+               sizeof(lmgr_config.db_config.filepath));
+    lmgr_config.db_config.cache_size = 1024 * 1024;
+    lmgr_config.db_config.stmt_cache_size = 8;
+
+    if (db_connect(&conn) != DB_SUCCESS)
+        abort();
+
+    exec(&conn, "CREATE TABLE ENTRIES (id TEXT PRIMARY KEY, size BIGINT, "
+                "name VARCHAR(255), ratio REAL)");
+
+    /* same statements with other values must reuse the cached ones */
+    for (i = 0; i < ENTRIES; i++)
+    {
+        snprintf(query, sizeof(query), "INSERT INTO ENTRIES (id,size,name,ratio)"
+                 " VALUES ('0x%x:%u',%u,'it''s %u',%u.5)", i, i, i * 1000, i, i);
+        exec(&conn, query);
+    }
+    before = stmt_count(&conn);
+    for (i = 0; i < ENTRIES; i++)
+    {
+        snprintf(query, sizeof(query), "UPDATE ENTRIES SET size=size+%u "
+                 "WHERE id='0x%x:%u'", i, i, i);
+        exec(&conn, query);
+        snprintf(query, sizeof(query), "SELECT name FROM ENTRIES "
+                 "WHERE id='0x%x:%u'", i, i);
+        snprintf(expect, sizeof(expect), "it's %u", i);
+        check_value(&conn, query, expect);
+    }
+    /* one more statement for UPDATE and one for SELECT */
+    if (stmt_count(&conn) != before + 2)
+    {
+        fprintf(stderr, "statements are not reused: %u cached\n",
+                stmt_count(&conn));
+        abort();
+    }
+
+    /* bound values have the same meaning as literals */
+    check_value(&conn, "SELECT size FROM ENTRIES WHERE id='0x3:3'", "3003");
+    check_value(&conn, "SELECT ratio FROM ENTRIES WHERE id='0x3:3'", "3.5");
+    check_value(&conn, "SELECT COUNT(*) FROM ENTRIES WHERE size>=50000 "
+                       "AND name LIKE 'it''s 9%'", "10");
+    check_value(&conn, "SELECT COUNT(*) FROM ENTRIES WHERE size IN (1001,2002)",
+                "2");
+    check_value(&conn, "SELECT 'x;y' FROM ENTRIES LIMIT 1", "x;y");
+    check_value(&conn, "SELECT \"size\" FROM ENTRIES WHERE name='it''s 1'",
+                "1001");
+
+    /* positional ORDER BY is kept, LIMIT/OFFSET are bound */
+    if (db_exec_sql(&conn, "SELECT id, size FROM ENTRIES WHERE size < 10000 "
+                    "ORDER BY 2 DESC LIMIT 3 OFFSET 1", &res) != DB_SUCCESS)
+        abort();
+    for (i = 0; i < 3; i++)
+    {
+        if (db_next_record(&conn, &res, val, 2) != DB_SUCCESS)
+            abort();
+        snprintf(expect, sizeof(expect), "%u", (8 - i) * 1001);
+        if (strcmp(val[1], expect))
+            abort();
+    }
+    if (db_next_record(&conn, &res, val, 2) != DB_END_OF_LIST)
+        abort();
+    db_result_free(&conn, &res);
+
+    /* sub-query ordering and outer filter */
+    check_value(&conn, "SELECT MAX(size) FROM (SELECT size FROM ENTRIES "
+                       "ORDER BY 1 LIMIT 5) WHERE size > 2", "4004");
+
+    /* results are streamed: a cached statement in use is not reused */
+    if (db_exec_sql(&conn, "SELECT id FROM ENTRIES WHERE size > 0", &res)
+        != DB_SUCCESS)
+        abort();
+    if (db_next_record(&conn, &res, val, 1) != DB_SUCCESS)
+        abort();
+    check_value(&conn, "SELECT COUNT(*) FROM ENTRIES WHERE size > 5000", "95");
+    for (i = 1; i < ENTRIES - 1; i++)
+        if (db_next_record(&conn, &res, val, 1) != DB_SUCCESS)
+            abort();
+    if (db_next_record(&conn, &res, val, 1) != DB_END_OF_LIST)
+        abort();
+    db_result_free(&conn, &res);
+
+    /* multiple statements and errors */
+    exec(&conn, "DELETE FROM ENTRIES WHERE size < 2000; "
+                "DELETE FROM ENTRIES WHERE size > 90000;");
+    check_value(&conn, "SELECT COUNT(*) FROM ENTRIES", "88");
+    if (db_exec_sql_quiet(&conn, "INSERT INTO ENTRIES (id) VALUES ('0x5:5')",
+                          NULL) != DB_ALREADY_EXISTS)
+        abort();
+    if (db_exec_sql_quiet(&conn, "SELECT foo FROM ENTRIES WHERE size=1", NULL)
+        == DB_SUCCESS)
+        abort();
+
+    /* MySQL upserts */
+    exec(&conn, "CREATE TABLE VARS (varname VARCHAR(255) PRIMARY KEY, "
+                "value TEXT)");
+    for (i = 0; i < 3; i++)
+        exec(&conn, "INSERT INTO VARS (varname,value) VALUES ('a',10),"
+                    "('b',1) ON DUPLICATE KEY UPDATE value=value+VALUES(value)");
+    check_value(&conn, "SELECT value FROM VARS WHERE varname='a'", "30");
+    check_value(&conn, "SELECT value FROM VARS WHERE varname='b'", "3");
+    exec(&conn, "INSERT IGNORE INTO VARS (varname,value) VALUES ('a',0)");
+    check_value(&conn, "SELECT value FROM VARS WHERE varname='a'", "30");
+    exec(&conn, "INSERT INTO VARS (varname,value) VALUES "
+                "('c','ON DUPLICATE KEY UPDATE VALUES(x)')");
+    check_value(&conn, "SELECT value FROM VARS WHERE varname='c'",
+                "ON DUPLICATE KEY UPDATE VALUES(x)");
+
+    /* DB functions */
+    check_value(&conn, "SELECT sz_range(0)", "-1");
+    check_value(&conn, "SELECT sz_range(31)", "0");
+    check_value(&conn, "SELECT sz_range(32)", "1");
+    check_value(&conn, "SELECT sz_range(1048576)", "4");
+    check_value(&conn, "SELECT sha1('a')",
+                "86f7e437faa5a7fce15d1ddcb9eaeaea377667b8");
+
+    exec(&conn, "CREATE TABLE NAMES (id TEXT, parent_id TEXT, name TEXT, "
+                "path_update INT)");
+    exec(&conn, "INSERT INTO NAMES VALUES ('R','P','root',1),('A','R','a',1),"
+                "('B','A','b',2),('B','R','old',1)");
+    check_value(&conn, "SELECT one_path('B')", "P/root/a/b");
+    check_value(&conn, "SELECT one_path('R')", "P/root");
+    check_value(&conn, "SELECT one_path('Z')", NULL);
+    check_value(&conn, "SELECT this_path('A','x')", "P/root/a/x");
+    check_value(&conn, "SELECT this_path('Z','x')", "Z/x");
+    check_value(&conn, "SELECT COUNT(*) FROM NAMES WHERE "
+                       "one_path(id) LIKE 'P/root/%'", "3");
+
+    db_close_conn(&conn);
+    unlink(path);
+    printf("OK\n");
+    return 0;
+}
@@ -241,5 +241,17 @@ int main(int argc, char **argv)
     assert(gr_nb_get == 11 * MAX_GID);
     assert(gr_nb_set == MAX_GID);
 
+    /* copies of names */
+    {
+        char name[50];
+
+        assert(GetPwName(42, name, sizeof(name)) == name);
+        assert(strcmp(name, "42") == 0);
+        assert(GetPwName(MAX_UID, name, sizeof(name)) == NULL);
+        assert(GetGrName(43, name, sizeof(name)) == name);
+        assert(strcmp(name, "43") == 0);
+        assert(GetGrName(MAX_GID, name, sizeof(name)) == NULL);
+    }
+
     return 0;
 }